@@ -7,6 +7,9 @@
 
 typedef struct bitmap_s {
   roaring_bitmap_t *rb;
+  // Views only: aligned copy backing `rb`, NULL if `rb` points straight into
+  // the caller's buffer
+  void *view_buf;
 } bitmap_t;
 
 // Function to create a new bitmap
@@ -15,6 +18,9 @@ bitmap_t *bitmap_create(void);
 // Function to add a value to the bitmap
 void bitmap_add(bitmap_t *bm, uint32_t value);
 
+// Add `count` values at once
+void bitmap_add_many(bitmap_t *bm, size_t count, const uint32_t *values);
+
 // Function to remove a value from the bitmap
 void bitmap_remove(bitmap_t *bm, uint32_t value);
 
@@ -41,11 +47,33 @@ void bitmap_xor_inplace(bitmap_t *bm1, const bitmap_t *bm2);
 
 void bitmap_not_inplace(bitmap_t *bm1, const bitmap_t *bm2);
 
+// Union of `count` bitmaps in a single heap merge. returns NULL on error
+bitmap_t *bitmap_or_many(const bitmap_t **bms, uint32_t count);
+
+bool bitmap_is_empty(const bitmap_t *bm);
+
 bitmap_t *bitmap_flip(const bitmap_t *bm1, uint64_t range_start,
                       uint64_t range_end);
 
+// Repeat `pattern` (values < 65536) in every 65536-value block, keeping only
+// [range_start, range_end)
+bitmap_t *bitmap_tile(const bitmap_t *pattern, uint64_t range_start,
+                      uint64_t range_end);
+
+// Intersect `bm` with `bitmap_tile(pattern, range_start, range_end)`, tiling
+// only the blocks `bm` has values in. Returns false on error
+bool bitmap_and_tiled_inplace(bitmap_t *bm, const bitmap_t *pattern,
+                              uint64_t range_start, uint64_t range_end);
+
 uint32_t bitmap_get_cardinality(const bitmap_t *bm);
 
+// Cardinality of the intersection, without materializing it
+uint64_t bitmap_and_cardinality(const bitmap_t *bm1, const bitmap_t *bm2);
+
+// Values in [start, end), without materializing them
+uint64_t bitmap_range_cardinality(const bitmap_t *bm, uint64_t start,
+                                  uint64_t end);
+
 void bitmap_to_uint32_array(const bitmap_t *bm, uint32_t *array);
 
 // Function to free the bitmap
@@ -55,6 +83,20 @@ void *bitmap_serialize(bitmap_t *bm, size_t *out_size);
 
 bitmap_t *bitmap_deserialize(void *buffer, size_t buffer_size);
 
+// The standard portable roaring format, without our header, for clients
+// using any roaring library. Free with `free`.
+void *bitmap_serialize_portable(const bitmap_t *bm, size_t *out_size);
+
+// Read-only view over a buffer written by `bitmap_serialize`. Containers are
+// not copied, so `buffer` must outlive the view (e.g. an LMDB value for the
+// life of its read txn). Never mutate a view; `bitmap_copy` it instead.
+// Free with `bitmap_free`.
+bitmap_t *bitmap_view(const void *buffer, size_t buffer_size);
+
+// Like `bitmap_view`, but over a private aligned copy of `buffer`, so the
+// view can outlive it. Still read-only.
+bitmap_t *bitmap_view_copy(const void *buffer, size_t buffer_size);
+
 bitmap_t *bitmap_copy(bitmap_t *bm);
 
 roaring_uint32_iterator_t *bitmap_iterator_create(const bitmap_t *bm);
@@ -62,4 +104,11 @@ roaring_uint32_iterator_t *bitmap_iterator_create(const bitmap_t *bm);
 // Returns next cursor, or 0 if no more
 uint32_t bitmap_take(bitmap_t *bm, uint32_t limit, uint32_t start_val);
 
+// Like `bitmap_take`, but into a new bitmap, leaving `bm` as is
+bitmap_t *bitmap_page(const bitmap_t *bm, uint32_t limit, uint32_t start_val,
+                      uint32_t *next_cursor_out);
+
+// Portable serialized size, close to the memory the bitmap holds
+size_t bitmap_size_in_bytes(const bitmap_t *bm);
+
 #endif // CORE_BITMAPS_H
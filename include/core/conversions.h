@@ -1,6 +1,7 @@
 #ifndef CONVERSIONS_H
 #define CONVERSIONS_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -15,4 +16,13 @@
  */
 int conv_uint32_to_string(char *buffer, size_t buffer_size, uint32_t value);
 
+/**
+ * @brief Parses a duration such as `500ms`, `30s`, `1m`, `2h` or `1d`.
+ *
+ * @param text The duration, a positive integer and a unit.
+ * @param ms_out Set to the duration in milliseconds.
+ * @return false if `text` is not a duration or overflows.
+ */
+bool conv_duration_to_ms(const char *text, uint64_t *ms_out);
+
 #endif // CONVERSIONS_H
@@ -20,9 +20,48 @@
 #define MAX_TEXT_VAL_LEN 128
 
 #define INT64_MAX_CHARS 19
+// Longest decimal literal, e.g. `amount:99.99`
+#define FLOAT_MAX_CHARS 32
 
 #define MAX_COMMAND_LEN 2048
 #define MAX_CUSTOM_TAGS 32
+// Max number of fields in a query `fields:(...)` projection
+#define MAX_QUERY_FIELDS 32
+
+// Query deadline in ms, for queries without a `timeout:` tag
+#define DEFAULT_QUERY_TIMEOUT_MS 30000
+// Upper bound of a query `timeout:` tag, in ms
+#define MAX_QUERY_TIMEOUT_MS 600000
+// Longest a query waits for its `after:` event, in ms. The wait holds a
+// thread of the pool that also parses events
+#define MAX_AFTER_WAIT_MS 2000
+
+// `sample:` is a percent of event ids
+#define MAX_QUERY_SAMPLE_PCT 100
+
+// Event blobs one query may read for comparisons no index answers
+#define MAX_QUERY_SCAN_EVENTS 1000000
+
+// Values `TOP` returns without an `n:` tag, and its upper bound
+#define DEFAULT_TOP_N 20
+#define MAX_TOP_N 1000
+
+// Upper bound of the buckets of one `HISTOGRAM`, e.g. a week of minutes
+#define MAX_HISTOGRAM_BUCKETS 10080
+
+// Upper bound of the steps of one `FUNNEL`
+#define MAX_FUNNEL_STEPS 16
+
+// Upper bound of the containers and views one `ENTITIES` set combines
+#define MAX_ENTITY_SET_LEAVES 16
+
+// Upper bounds of the `by` keys of one rollup, of the rollups of one
+// container and of the rows one `ROLLUP` read returns
+#define MAX_ROLLUP_KEYS 4
+#define MAX_ROLLUPS 16
+#define MAX_ROLLUP_ROWS 100000
+// Counter row keys longer than this are not counted
+#define MAX_ROLLUP_ROW_KEY_LEN 256
 
 #define MAX_CONTAINER_PATH_LENGTH 128
 
@@ -75,6 +75,14 @@ db_put_result_t db_put(MDB_dbi db, MDB_txn *txn, db_key_t *key,
                        const void *value, size_t value_size, bool auto_commit,
                        bool no_overwrite);
 
+// Like db_put, but appends without searching the tree: `key` must sort after
+// every key in the db. `same_key`: another value of the key appended last,
+// for dbs with duplicate keys, it must sort after that key's values.
+// Out of order input returns DB_PUT_KEY_EXISTS
+db_put_result_t db_put_append(MDB_dbi db, MDB_txn *txn, db_key_t *key,
+                              const void *value, size_t value_size,
+                              bool same_key);
+
 // Function to get a value by key from the database. Caller: Remember to free
 // memory returned by db_get.
 bool db_get(MDB_dbi db, MDB_txn *txn, db_key_t *key,
@@ -82,6 +90,15 @@ bool db_get(MDB_dbi db, MDB_txn *txn, db_key_t *key,
 
 void db_get_result_clear(db_get_result_t *res);
 
+// Delete a key and all of its values. Deleting a missing key succeeds.
+bool db_delete(MDB_dbi db, MDB_txn *txn, db_key_t *key);
+
+// Like db_get, but `result_out->value` points into the LMDB map instead of a
+// copy. It is valid until the txn ends (or, for write txns, the next write).
+// Do not clear or free it.
+bool db_get_view(MDB_dbi db, MDB_txn *txn, db_key_t *key,
+                 db_get_result_t *result_out);
+
 // Function to close and free the database environment
 void db_close(MDB_env *env, MDB_dbi db);
 
@@ -0,0 +1,35 @@
+#ifndef DEADLINE_H
+#define DEADLINE_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+// Cooperative cancellation for long-running work. Holders poll
+// `deadline_status` at points where stopping is safe.
+
+typedef enum {
+  DEADLINE_OK,
+  DEADLINE_EXPIRED,
+  DEADLINE_CANCELLED
+} deadline_status_t;
+
+typedef struct deadline_s {
+  uint64_t expires_ns; // CLOCK_MONOTONIC, 0 = never expires
+  // Optional, owned by the requester. 0 once it is gone (e.g. disconnected)
+  const atomic_int *alive;
+} deadline_t;
+
+// `timeout_ms` of 0 never expires. `alive` may be NULL
+void deadline_init(deadline_t *d, uint64_t timeout_ms,
+                   const atomic_int *alive);
+
+// Makes `d` expire in `timeout_ms` at the latest
+void deadline_cap(deadline_t *d, uint64_t timeout_ms);
+
+// Safe to call from several threads. NULL never expires
+deadline_status_t deadline_status(const deadline_t *d);
+
+// Error message for a status other than DEADLINE_OK
+const char *deadline_err_msg(deadline_status_t status);
+
+#endif
@@ -4,19 +4,38 @@
 // --- Public Engine API --- //
 
 #include "query/ast.h"
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
-enum api_op_type { API_INVALID, API_EVENT, API_QUERY, API_INDEX };
+enum api_op_type {
+  API_INVALID,
+  API_EVENT,
+  API_QUERY,
+  API_INDEX,
+  API_CREATE_VIEW,
+  API_SUBSCRIBE,
+  API_SHOW,
+  API_TOP,
+  API_HISTOGRAM,
+  API_FUNNEL,
+  API_ENTITIES,
+  API_CREATE_ROLLUP,
+  API_ROLLUP
+};
 
 enum api_resp_type {
   API_RESP_TYPE_LIST_U32,
   API_RESP_TYPE_LIST_OBJ,
-  API_RESP_TYPE_ACK
+  API_RESP_TYPE_ACK,
+  API_RESP_TYPE_SUBSCRIPTION,
+  API_RESP_TYPE_HISTOGRAM,
+  API_RESP_TYPE_ID_SET
 };
 
-enum api_obj_type { API_OBJ_TYPE_EVENT };
+// STATUS objects are msgpack maps describing engine state, see `SHOW`
+enum api_obj_type { API_OBJ_TYPE_EVENT, API_OBJ_TYPE_STATUS };
 
 typedef struct api_obj_s {
   uint32_t id;
@@ -29,6 +48,24 @@ typedef struct api_response_type_list_obj_s {
   api_obj_t *objects;
   uint32_t count;
   uint32_t next_cursor;
+  // Set by `sample:` queries, counts are scaled to the whole container
+  bool sampled;
+  uint64_t estimated_count;
+  uint64_t count_error;
+  // Set by `agg:` queries, over all matches of a bsi index's key
+  bool has_agg;
+  uint64_t agg_count;
+  uint64_t agg_sum;
+  uint64_t agg_min;
+  uint64_t agg_max;
+  // Set by `session:` queries while pages are left, see page_session.h
+  uint64_t session;
+  // Set by EXPLAIN and PROFILE, a msgpack map of the plan (see
+  // `eng_profile.h`)
+  char *plan;
+  size_t plan_size;
+  // Set by PROFILE, the serializer adds the time it takes to encode objects
+  bool profiled;
 } api_response_type_list_obj_t;
 
 typedef struct api_response_type_list_u32_s {
@@ -36,6 +73,33 @@ typedef struct api_response_type_list_u32_s {
   uint32_t count;
 } api_response_type_list_u32_t;
 
+// `HISTOGRAM` counts, bucket `i` starting at `from + i * bucket_ms`
+typedef struct api_response_type_histogram_s {
+  int64_t from;
+  uint64_t bucket_ms;
+  uint64_t *counts;
+  uint32_t count;
+} api_response_type_histogram_t;
+
+// `ids_only:` query matches, a portable roaring bitmap of event ids
+typedef struct api_response_type_id_set_s {
+  char *bitmap;
+  size_t bitmap_size;
+  uint64_t count;
+  uint32_t next_cursor;
+  uint64_t session;
+} api_response_type_id_set_t;
+
+// EVENT ack, the event is visible to queries with `after:<event_id>`. Zero
+// for other acks
+typedef struct api_response_type_watermark_s {
+  const char *container_name; // not owned
+  uint32_t event_id;
+} api_response_type_watermark_t;
+
+// Live subscription, owned by the response until taken (see subscription.h)
+struct sub_s;
+
 typedef struct api_response_s {
   enum api_op_type op_type;
   enum api_resp_type resp_type;
@@ -43,6 +107,10 @@ typedef struct api_response_s {
   union {
     api_response_type_list_u32_t list_u32;
     api_response_type_list_obj_t list_obj;
+    api_response_type_histogram_t histogram;
+    api_response_type_id_set_t id_set;
+    api_response_type_watermark_t watermark;
+    struct sub_s *sub;
   } payload;
 
   bool is_ok;
@@ -56,6 +124,9 @@ void api_stop_eng(void);
 
 // The single entry point into the API/Engine layer for executing commands.
 // Takes ownership of ast - caller must not free
-api_response_t *api_exec(ast_node_t *ast, int64_t arrival_ts);
+// `alive` is optional: a running query is cancelled once it reads 0, e.g.
+// after the requesting client disconnects
+api_response_t *api_exec(ast_node_t *ast, int64_t arrival_ts,
+                         const atomic_int *alive);
 
 #endif // API_H
\ No newline at end of file
@@ -147,6 +147,16 @@ static inline void log_global_shutdown(void) { zlog_fini(); }
 #define ACT_CLIENT_CONNECTED "client_connected"
 #define ACT_CLIENT_DISCONNECTED "client_disconnected"
 
+// Live subscriptions
+#define ACT_SUB_STARTED "sub_started"
+#define ACT_SUB_SLOW_CONSUMER "sub_slow_consumer"
+
+// Index backfill
+#define ACT_BACKFILL_STARTED "backfill_started"
+#define ACT_BACKFILL_PROGRESS "backfill_progress"
+#define ACT_BACKFILL_DONE "backfill_done"
+#define ACT_BACKFILL_FAILED "backfill_failed"
+
 // Command processing
 #define ACT_CMD_RECEIVED "cmd_received"
 #define ACT_CMD_PROCESSING "cmd_processing"
@@ -28,6 +28,15 @@ typedef enum {
   AST_KW_CURSOR,
   AST_KW_ID, // event id, for idempotency
   AST_KW_KEY,
+  AST_KW_FIELDS, // value is a list of string literals linked by `next`
+  AST_KW_TIMEOUT, // query deadline in milliseconds
+  AST_KW_SAMPLE, // percent of event ids to evaluate
+  AST_KW_VIEW,   // materialized view name
+  AST_KW_TARGET, // what `SHOW` lists
+  AST_KW_PLAN,   // `explain` or `profile`, see `EXPLAIN QUERY`
+  AST_KW_STEPS,  // value is a list of expressions linked by `next`
+  AST_KW_OF,     // set expression over containers, see `ENTITIES`
+  AST_KW_BY,     // value is a list of string literals linked by `next`
 } ast_reserved_key_t;
 
 typedef enum { AST_TAG_KEY_RESERVED, AST_TAG_KEY_CUSTOM } ast_tag_key_type_t;
@@ -41,16 +50,22 @@ typedef struct {
   ast_node_t *value;
 } ast_tag_node_t;
 
-// Represents a string or number value.
-typedef enum { AST_LITERAL_STRING, AST_LITERAL_NUMBER } ast_literal_type_t;
+// Represents a string, integer or decimal value.
+typedef enum {
+  AST_LITERAL_STRING,
+  AST_LITERAL_NUMBER,
+  AST_LITERAL_FLOAT
+} ast_literal_type_t;
 
 typedef struct {
   ast_literal_type_t type;
   union {
+    // Strings, and the source text of floats
     char *string_value;
     int64_t number_value;
   };
   size_t string_value_len;
+  double float_value;
 } ast_literal_node_t;
 
 typedef enum {
@@ -59,7 +74,8 @@ typedef enum {
   AST_OP_GTE,
   AST_OP_LTE,
   AST_OP_EQ,
-  AST_OP_NEQ
+  AST_OP_NEQ,
+  AST_OP_CONTAINS // `~`, substring of a string value
 } ast_comparison_op_t;
 
 typedef struct {
@@ -84,7 +100,20 @@ typedef struct ast_logical_node_s {
   ast_node_t *right_operand;
 } ast_logical_node_t;
 
-typedef enum { AST_CMD_EVENT, AST_CMD_QUERY, AST_CMD_INDEX } ast_command_type_t;
+typedef enum {
+  AST_CMD_EVENT,
+  AST_CMD_QUERY,
+  AST_CMD_INDEX,
+  AST_CMD_CREATE_VIEW,
+  AST_CMD_SUBSCRIBE,
+  AST_CMD_SHOW,
+  AST_CMD_TOP,
+  AST_CMD_HISTOGRAM,
+  AST_CMD_FUNNEL,
+  AST_CMD_ENTITIES,
+  AST_CMD_CREATE_ROLLUP,
+  AST_CMD_ROLLUP
+} ast_command_type_t;
 
 // The root of the AST. It contains a pointer to the head of a linked list of
 // tags.
@@ -121,6 +150,9 @@ ast_node_t *ast_create_custom_tag_node(const char *key, ast_node_t *value);
 ast_node_t *ast_create_string_literal_node(const char *value,
                                            size_t string_value_len);
 ast_node_t *ast_create_number_literal_node(int64_t value);
+// `text` is the value as written, kept so tag keys stay stable
+ast_node_t *ast_create_float_literal_node(double value, const char *text,
+                                          size_t text_len);
 ast_node_t *ast_create_comparison_node(ast_comparison_op_t op, ast_node_t *key,
                                        ast_node_t *value);
 ast_node_t *ast_create_logical_node(ast_logical_node_op_t op, ast_node_t *left,
@@ -10,6 +10,16 @@ typedef enum {
   TOKEN_CMD_EVENT,
   TOKEN_CMD_QUERY,
   TOKEN_CMD_INDEX,
+  TOKEN_CMD_CREATE,
+  TOKEN_CMD_SUBSCRIBE,
+  TOKEN_CMD_SHOW,
+  TOKEN_CMD_EXPLAIN,
+  TOKEN_CMD_PROFILE,
+  TOKEN_CMD_TOP,
+  TOKEN_CMD_HISTOGRAM,
+  TOKEN_CMD_FUNNEL,
+  TOKEN_CMD_ENTITIES,
+  TOKEN_CMD_ROLLUP,
 
   // --- Reserved Keywords ---
   TOKEN_KW_IN,
@@ -22,12 +32,19 @@ typedef enum {
   TOKEN_KW_HAVING,
   TOKEN_KW_COUNT,
   TOKEN_KW_KEY,
+  TOKEN_KW_FIELDS,
+  TOKEN_KW_TIMEOUT,
+  TOKEN_KW_SAMPLE,
+  TOKEN_KW_VIEW,
+  TOKEN_KW_STEPS,
+  TOKEN_KW_OF,
 
   TOKEN_IDENTIFER, // unquoted text
 
   // --- Literals (Values) ---
   TOKEN_LITERAL_STRING,
   TOKEN_LITERAL_NUMBER,
+  TOKEN_LITERAL_FLOAT, // `text_value` keeps the source text
 
   // --- Operators & Symbols ---
   TOKEN_OP_AND,
@@ -39,9 +56,11 @@ typedef enum {
   TOKEN_OP_NEQ,
   TOKEN_OP_LTE,
   TOKEN_OP_LT,
+  TOKEN_OP_CONTAINS,
   TOKEN_SYM_COLON,
   TOKEN_SYM_LPAREN,
-  TOKEN_SYM_RPAREN
+  TOKEN_SYM_RPAREN,
+  TOKEN_SYM_COMMA
 } token_type;
 
 typedef struct token_s {
@@ -49,6 +68,7 @@ typedef struct token_s {
   char *text_value;
   size_t text_value_len;
   int64_t number_value;
+  double float_value;
 } token_t;
 
 queue_t *tok_tokenize(char *input);
@@ -2,9 +2,11 @@
 #include "roaring.h"
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
 bitmap_t *bitmap_create() {
-  bitmap_t *bm = malloc(sizeof(bitmap_t));
+  bitmap_t *bm = calloc(1, sizeof(bitmap_t));
   if (bm == NULL)
     return NULL;
   bm->rb = roaring_bitmap_create();
@@ -21,6 +23,12 @@ void bitmap_add(bitmap_t *bm, uint32_t value) {
   }
 }
 
+void bitmap_add_many(bitmap_t *bm, size_t count, const uint32_t *values) {
+  if (bm && bm->rb && values) {
+    roaring_bitmap_add_many(bm->rb, count, values);
+  }
+}
+
 void bitmap_remove(bitmap_t *bm, uint32_t value) {
   if (bm && bm->rb) {
     roaring_bitmap_remove(bm->rb, value);
@@ -43,7 +51,7 @@ static bitmap_t *_apply_bitmap_op(const bitmap_t *bm1, const bitmap_t *bm2,
   if (!(bm1 && bm1->rb && bm2 && bm2->rb)) {
     return NULL;
   }
-  bitmap_t *r = malloc(sizeof(bitmap_t));
+  bitmap_t *r = calloc(1, sizeof(bitmap_t));
   if (!r) {
     return NULL;
   }
@@ -98,11 +106,56 @@ void bitmap_not_inplace(bitmap_t *bm1, const bitmap_t *bm2) {
   return _apply_bitmap_inplace_op(bm1, bm2, roaring_bitmap_andnot_inplace);
 }
 
+#define OR_MANY_STACK_COUNT 32
+
+bitmap_t *bitmap_or_many(const bitmap_t **bms, uint32_t count) {
+  if (!bms || count == 0) {
+    return NULL;
+  }
+  const roaring_bitmap_t *stack_rbs[OR_MANY_STACK_COUNT];
+  const roaring_bitmap_t **rbs = stack_rbs;
+  if (count > OR_MANY_STACK_COUNT) {
+    rbs = malloc(count * sizeof(roaring_bitmap_t *));
+    if (!rbs) {
+      return NULL;
+    }
+  }
+
+  bitmap_t *r = NULL;
+  for (uint32_t i = 0; i < count; i++) {
+    if (!bms[i] || !bms[i]->rb) {
+      goto cleanup;
+    }
+    rbs[i] = bms[i]->rb;
+  }
+
+  r = calloc(1, sizeof(bitmap_t));
+  if (!r) {
+    goto cleanup;
+  }
+  r->rb = roaring_bitmap_or_many_heap(count, rbs);
+  if (!r->rb) {
+    free(r);
+    r = NULL;
+  }
+
+cleanup:
+  if (rbs != stack_rbs) {
+    free(rbs);
+  }
+  return r;
+}
+
+bool bitmap_is_empty(const bitmap_t *bm) {
+  return !bm || !bm->rb || roaring_bitmap_is_empty(bm->rb);
+}
+
 void bitmap_free(bitmap_t *bm) {
   if (bm) {
     if (bm->rb) {
       roaring_bitmap_free(bm->rb);
     }
+    free(bm->view_buf);
     free(bm);
   }
 }
@@ -110,7 +163,7 @@ void bitmap_free(bitmap_t *bm) {
 bitmap_t *bitmap_copy(bitmap_t *bm) {
   if (!bm || !bm->rb)
     return NULL;
-  bitmap_t *copy = malloc(sizeof(bitmap_t));
+  bitmap_t *copy = calloc(1, sizeof(bitmap_t));
   if (copy == NULL)
     return NULL;
   roaring_bitmap_t *copy_rb = roaring_bitmap_copy(bm->rb);
@@ -127,13 +180,23 @@ typedef struct {
   uint64_t version;
 } bitmap_serialization_header_t;
 
+// Payload formats
+#define BITMAP_SER_PORTABLE 0
+#define BITMAP_SER_FROZEN 1
+
+// Frozen payloads can only be viewed in place at this alignment. LMDB puts
+// large values on overflow pages right after a 16 byte page header, so with
+// our 16 byte header the payload lands on a 32 byte boundary. Small values
+// sit at arbitrary offsets inside a page and are copied once.
+#define BITMAP_FROZEN_ALIGN 32
+
 void *bitmap_serialize(bitmap_t *bm, size_t *out_size) {
 
   if (!bm || !out_size || !bm->rb)
     return NULL;
 
   *out_size = 0;
-  size_t roaring_bitmap_size = roaring_bitmap_portable_size_in_bytes(bm->rb);
+  size_t roaring_bitmap_size = roaring_bitmap_frozen_size_in_bytes(bm->rb);
   size_t total_size =
       sizeof(bitmap_serialization_header_t) + roaring_bitmap_size;
 
@@ -142,49 +205,118 @@ void *bitmap_serialize(bitmap_t *bm, size_t *out_size) {
     return NULL;
 
   char *p = (char *)buffer;
-  bitmap_serialization_header_t header = {.roaring_bitmap_size =
-                                              roaring_bitmap_size};
+  bitmap_serialization_header_t header = {
+      .roaring_bitmap_size = roaring_bitmap_size, .version = BITMAP_SER_FROZEN};
   memcpy(p, &header, sizeof(header));
   p += sizeof(header);
 
   if (roaring_bitmap_size > 0) {
-    roaring_bitmap_portable_serialize(bm->rb, p);
+    roaring_bitmap_frozen_serialize(bm->rb, p);
   }
 
   *out_size = total_size;
   return buffer;
 }
 
-bitmap_t *bitmap_deserialize(void *buffer, size_t buffer_size) {
+void *bitmap_serialize_portable(const bitmap_t *bm, size_t *out_size) {
+  if (!bm || !out_size || !bm->rb)
+    return NULL;
+
+  size_t size = roaring_bitmap_portable_size_in_bytes(bm->rb);
+  void *buffer = malloc(size);
   if (!buffer)
     return NULL;
+  *out_size = roaring_bitmap_portable_serialize(bm->rb, buffer);
+  return buffer;
+}
 
-  bitmap_t *b = malloc(sizeof(bitmap_t));
-  if (!b) {
+// Returns the payload, or NULL if the buffer is too small for its header
+static const char *_read_header(const void *buffer, size_t buffer_size,
+                                bitmap_serialization_header_t *header) {
+  if (!buffer || buffer_size < sizeof(bitmap_serialization_header_t)) {
+    return NULL;
+  }
+  // Use memcpy to read header (avoids alignment/padding issues)
+  memcpy(header, buffer, sizeof(*header));
+  if (header->roaring_bitmap_size >
+      buffer_size - sizeof(bitmap_serialization_header_t)) {
     return NULL;
   }
+  return (const char *)buffer + sizeof(bitmap_serialization_header_t);
+}
 
-  // Initialize the pointer to NULL immediately so bitmap_free is safe
-  b->rb = NULL;
+static bitmap_t *_view(const void *buffer, size_t buffer_size, bool copy) {
+  bitmap_serialization_header_t header;
+  const char *p = _read_header(buffer, buffer_size, &header);
+  if (!p) {
+    return NULL;
+  }
+  if (header.version == BITMAP_SER_PORTABLE) {
+    // Written before frozen payloads existed, cannot be viewed in place
+    return bitmap_deserialize((void *)buffer, buffer_size);
+  }
+  if (header.version != BITMAP_SER_FROZEN || header.roaring_bitmap_size == 0) {
+    return NULL;
+  }
+
+  bitmap_t *b = calloc(1, sizeof(bitmap_t));
+  if (!b) {
+    return NULL;
+  }
 
-  const char *p = (const char *)buffer;
+  if (copy || (uintptr_t)p % BITMAP_FROZEN_ALIGN != 0) {
+    // aligned_alloc wants a multiple of the alignment
+    size_t alloc_size = (header.roaring_bitmap_size + BITMAP_FROZEN_ALIGN - 1) &
+                        ~((size_t)BITMAP_FROZEN_ALIGN - 1);
+    b->view_buf = aligned_alloc(BITMAP_FROZEN_ALIGN, alloc_size);
+    if (!b->view_buf) {
+      free(b);
+      return NULL;
+    }
+    memcpy(b->view_buf, p, header.roaring_bitmap_size);
+    p = b->view_buf;
+  }
 
-  if (buffer_size < sizeof(bitmap_serialization_header_t)) {
+  b->rb = (roaring_bitmap_t *)roaring_bitmap_frozen_view(
+      p, header.roaring_bitmap_size);
+  if (!b->rb) {
     bitmap_free(b);
     return NULL;
   }
+  return b;
+}
 
-  // Use memcpy to read header (avoids alignment/padding issues)
-  bitmap_serialization_header_t header;
-  memcpy(&header, p, sizeof(header));
+bitmap_t *bitmap_view(const void *buffer, size_t buffer_size) {
+  return _view(buffer, buffer_size, false);
+}
 
-  p += sizeof(bitmap_serialization_header_t);
+bitmap_t *bitmap_view_copy(const void *buffer, size_t buffer_size) {
+  return _view(buffer, buffer_size, true);
+}
 
-  size_t expected_total_size =
-      sizeof(bitmap_serialization_header_t) + header.roaring_bitmap_size;
+bitmap_t *bitmap_deserialize(void *buffer, size_t buffer_size) {
+  bitmap_serialization_header_t header;
+  const char *p = _read_header(buffer, buffer_size, &header);
+  if (!p) {
+    return NULL;
+  }
 
-  if (expected_total_size > buffer_size) {
-    bitmap_free(b); // safe because b->rb is NULL
+  if (header.version == BITMAP_SER_FROZEN) {
+    // Mutable copy of the view
+    bitmap_t *view = bitmap_view(buffer, buffer_size);
+    if (!view) {
+      return NULL;
+    }
+    bitmap_t *b = bitmap_copy(view);
+    bitmap_free(view);
+    return b;
+  }
+  if (header.version != BITMAP_SER_PORTABLE) {
+    return NULL;
+  }
+
+  bitmap_t *b = calloc(1, sizeof(bitmap_t));
+  if (!b) {
     return NULL;
   }
 
@@ -211,7 +343,7 @@ bitmap_t *bitmap_flip(const bitmap_t *bm1, uint64_t range_start,
                       uint64_t range_end) {
   if (!bm1 || !bm1->rb)
     return NULL;
-  bitmap_t *r = malloc(sizeof(bitmap_t));
+  bitmap_t *r = calloc(1, sizeof(bitmap_t));
   if (!r)
     return NULL;
   roaring_bitmap_t *rb = roaring_bitmap_flip(bm1->rb, range_start, range_end);
@@ -223,12 +355,82 @@ bitmap_t *bitmap_flip(const bitmap_t *bm1, uint64_t range_start,
   return r;
 }
 
+bitmap_t *bitmap_tile(const bitmap_t *pattern, uint64_t range_start,
+                      uint64_t range_end) {
+  if (!pattern || !pattern->rb)
+    return NULL;
+  bitmap_t *r = bitmap_create();
+  if (!r || range_start >= range_end)
+    return r;
+
+  uint64_t last_block = (range_end - 1) >> 16;
+  for (uint64_t block = range_start >> 16; block <= last_block; block++) {
+    roaring_bitmap_t *shifted =
+        roaring_bitmap_add_offset(pattern->rb, (int64_t)(block << 16));
+    if (!shifted) {
+      bitmap_free(r);
+      return NULL;
+    }
+    // Blocks are appended in order, so this only adds containers
+    roaring_bitmap_or_inplace(r->rb, shifted);
+    roaring_bitmap_free(shifted);
+  }
+  roaring_bitmap_remove_range(r->rb, 0, range_start);
+  roaring_bitmap_remove_range(r->rb, range_end, (uint64_t)UINT32_MAX + 1);
+  return r;
+}
+
+bool bitmap_and_tiled_inplace(bitmap_t *bm, const bitmap_t *pattern,
+                              uint64_t range_start, uint64_t range_end) {
+  if (!bm || !bm->rb || !pattern || !pattern->rb)
+    return false;
+  roaring_bitmap_remove_range(bm->rb, 0, range_start);
+  roaring_bitmap_remove_range(bm->rb, range_end, (uint64_t)UINT32_MAX + 1);
+  roaring_bitmap_t *tiles = roaring_bitmap_create();
+  roaring_uint32_iterator_t *it = roaring_iterator_create(bm->rb);
+  bool ok = tiles && it;
+  while (ok && it->has_value) {
+    uint32_t block = it->current_value >> 16;
+    roaring_bitmap_t *shifted =
+        roaring_bitmap_add_offset(pattern->rb, (int64_t)block << 16);
+    ok = shifted != NULL;
+    if (ok) {
+      // Blocks are visited in order, so this only adds containers
+      roaring_bitmap_or_inplace(tiles, shifted);
+      roaring_bitmap_free(shifted);
+    }
+    if (block == UINT16_MAX)
+      break;
+    roaring_uint32_iterator_move_equalorlarger(it, (block + 1) << 16);
+  }
+  if (ok)
+    roaring_bitmap_and_inplace(bm->rb, tiles);
+  if (it)
+    roaring_uint32_iterator_free(it);
+  if (tiles)
+    roaring_bitmap_free(tiles);
+  return ok;
+}
+
 uint32_t bitmap_get_cardinality(const bitmap_t *bm) {
   if (!bm || !bm->rb)
     return 0;
   return roaring_bitmap_get_cardinality(bm->rb);
 }
 
+uint64_t bitmap_and_cardinality(const bitmap_t *bm1, const bitmap_t *bm2) {
+  if (!bm1 || !bm1->rb || !bm2 || !bm2->rb)
+    return 0;
+  return roaring_bitmap_and_cardinality(bm1->rb, bm2->rb);
+}
+
+uint64_t bitmap_range_cardinality(const bitmap_t *bm, uint64_t start,
+                                  uint64_t end) {
+  if (!bm || !bm->rb || start >= end)
+    return 0;
+  return roaring_bitmap_range_cardinality(bm->rb, start, end);
+}
+
 void bitmap_to_uint32_array(const bitmap_t *bm, uint32_t *array) {
   if (!bm || !bm->rb)
     return;
@@ -268,4 +470,43 @@ uint32_t bitmap_take(bitmap_t *bm, uint32_t limit, uint32_t start_val) {
   }
 
   return 0; // Should be unreachable given card > limit check
-}
\ No newline at end of file
+}
+
+bitmap_t *bitmap_page(const bitmap_t *bm, uint32_t limit, uint32_t start_val,
+                      uint32_t *next_cursor_out) {
+  *next_cursor_out = 0;
+  if (!bm || !bm->rb)
+    return NULL;
+  bitmap_t *page = bitmap_create();
+  roaring_uint32_iterator_t *it = roaring_iterator_create(bm->rb);
+  if (!page || !it) {
+    bitmap_free(page);
+    roaring_uint32_iterator_free(it);
+    return NULL;
+  }
+
+  uint32_t buf[256];
+  uint32_t left = limit;
+  if (roaring_uint32_iterator_move_equalorlarger(it, start_val)) {
+    while (left > 0) {
+      uint32_t want = left < 256 ? left : 256;
+      uint32_t n = roaring_uint32_iterator_read(it, buf, want);
+      roaring_bitmap_add_many(page->rb, n, buf);
+      left -= n;
+      if (n < want) {
+        break;
+      }
+    }
+  }
+  if (left == 0 && it->has_value) {
+    *next_cursor_out = it->current_value;
+  }
+  roaring_uint32_iterator_free(it);
+  return page;
+}
+
+size_t bitmap_size_in_bytes(const bitmap_t *bm) {
+  if (!bm || !bm->rb)
+    return 0;
+  return roaring_bitmap_portable_size_in_bytes(bm->rb);
+}
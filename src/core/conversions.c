@@ -1,5 +1,9 @@
 #include "core/conversions.h"
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 int conv_uint32_to_string(char *buffer, size_t buffer_size, uint32_t value) {
   if (!buffer)
@@ -11,4 +15,34 @@ int conv_uint32_to_string(char *buffer, size_t buffer_size, uint32_t value) {
   }
 
   return chars_written;
-}
\ No newline at end of file
+}
+
+bool conv_duration_to_ms(const char *text, uint64_t *ms_out) {
+  if (!text || !ms_out || !isdigit((unsigned char)text[0])) {
+    return false;
+  }
+  uint64_t n = 0;
+  const char *p = text;
+  for (; isdigit((unsigned char)*p); p++) {
+    if (__builtin_mul_overflow(n, 10, &n) ||
+        __builtin_add_overflow(n, (uint64_t)(*p - '0'), &n)) {
+      return false;
+    }
+  }
+
+  uint64_t unit;
+  if (strcmp(p, "ms") == 0) {
+    unit = 1;
+  } else if (strcmp(p, "s") == 0) {
+    unit = 1000;
+  } else if (strcmp(p, "m") == 0) {
+    unit = 60 * 1000;
+  } else if (strcmp(p, "h") == 0) {
+    unit = 60 * 60 * 1000;
+  } else if (strcmp(p, "d") == 0) {
+    unit = 24 * 60 * 60 * 1000;
+  } else {
+    return false;
+  }
+  return n > 0 && !__builtin_mul_overflow(n, unit, ms_out);
+}
@@ -153,6 +153,48 @@ db_put_result_t db_put(MDB_dbi db, MDB_txn *txn, db_key_t *key,
   return DB_PUT_OK;
 }
 
+db_put_result_t db_put_append(MDB_dbi db, MDB_txn *txn, db_key_t *key,
+                              const void *value, size_t value_size,
+                              bool same_key) {
+  if (txn == NULL || key == NULL || value == NULL || value_size == 0)
+    return DB_PUT_ERR;
+
+  MDB_val mdb_key, mdb_value;
+  if (!_setup_mdb_key(key, &mdb_key)) {
+    return DB_PUT_ERR;
+  }
+  mdb_value.mv_size = value_size;
+  mdb_value.mv_data = (void *)value;
+
+  // MDB_APPEND rejects a key equal to the last one, even with MDB_DUPSORT
+  int rc = mdb_put(txn, db, &mdb_key, &mdb_value,
+                   same_key ? MDB_APPENDDUP : MDB_APPEND);
+  if (rc == MDB_KEYEXIST) {
+    return DB_PUT_KEY_EXISTS;
+  }
+  if (rc != 0) {
+    fprintf(stderr, "db_put_append: mdb_put failed: %s\n", mdb_strerror(rc));
+    return DB_PUT_ERR;
+  }
+  return DB_PUT_OK;
+}
+
+bool db_delete(MDB_dbi db, MDB_txn *txn, db_key_t *key) {
+  if (txn == NULL || key == NULL) {
+    return false;
+  }
+  MDB_val mdb_key;
+  if (!_setup_mdb_key(key, &mdb_key)) {
+    return false;
+  }
+  int rc = mdb_del(txn, db, &mdb_key, NULL);
+  if (rc != 0 && rc != MDB_NOTFOUND) {
+    fprintf(stderr, "db_delete: mdb_del failed: %s\n", mdb_strerror(rc));
+    return false;
+  }
+  return true;
+}
+
 void db_get_result_clear(db_get_result_t *res) {
   if (res && res->value) {
     free(res->value);
@@ -162,8 +204,8 @@ void db_get_result_clear(db_get_result_t *res) {
 }
 
 // Returns false on error, true if found or not found (check `result_out`)
-bool db_get(MDB_dbi db, MDB_txn *txn, db_key_t *key,
-            db_get_result_t *result_out) {
+static bool _db_get(MDB_dbi db, MDB_txn *txn, db_key_t *key,
+                    db_get_result_t *result_out, bool copy) {
   if (txn == NULL || key == NULL || result_out == NULL)
     return false;
 
@@ -189,12 +231,16 @@ bool db_get(MDB_dbi db, MDB_txn *txn, db_key_t *key,
     return false;
   }
 
-  // Duplicate the data as it's only valid within the transaction
-  result = malloc(mdb_value.mv_size);
-  if (!result) {
-    return false;
+  if (copy) {
+    // Duplicate the data as it's only valid within the transaction
+    result = malloc(mdb_value.mv_size);
+    if (!result) {
+      return false;
+    }
+    memcpy(result, mdb_value.mv_data, mdb_value.mv_size);
+  } else {
+    result = mdb_value.mv_data;
   }
-  memcpy(result, mdb_value.mv_data, mdb_value.mv_size);
   result_out->status = DB_GET_OK;
   result_out->value = result;
   result_out->value_len = mdb_value.mv_size;
@@ -202,6 +248,16 @@ bool db_get(MDB_dbi db, MDB_txn *txn, db_key_t *key,
   return true;
 }
 
+bool db_get(MDB_dbi db, MDB_txn *txn, db_key_t *key,
+            db_get_result_t *result_out) {
+  return _db_get(db, txn, key, result_out, true);
+}
+
+bool db_get_view(MDB_dbi db, MDB_txn *txn, db_key_t *key,
+                 db_get_result_t *result_out) {
+  return _db_get(db, txn, key, result_out, false);
+}
+
 void db_close(MDB_env *env, MDB_dbi db) {
   if (env && db) {
     mdb_dbi_close(env, db);
@@ -272,7 +328,8 @@ db_cursor_get_result_t db_cursor_get(MDB_cursor *cursor,
   if (!cursor || !entry_out)
     return DB_CURSOR_ERR;
 
-  MDB_val mdb_key, value;
+  // Some ops, e.g. MDB_GET_MULTIPLE on a single value, leave them unset
+  MDB_val mdb_key = {0}, value = {0};
   if (db_key && !_setup_mdb_key(db_key, &mdb_key)) {
     return DB_CURSOR_ERR;
   }
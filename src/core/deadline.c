@@ -0,0 +1,54 @@
+#include "core/deadline.h"
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+static uint64_t _now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void deadline_init(deadline_t *d, uint64_t timeout_ms,
+                   const atomic_int *alive) {
+  if (!d) {
+    return;
+  }
+  d->expires_ns = timeout_ms ? _now_ns() + timeout_ms * 1000000ULL : 0;
+  d->alive = alive;
+}
+
+void deadline_cap(deadline_t *d, uint64_t timeout_ms) {
+  if (!d || !timeout_ms) {
+    return;
+  }
+  uint64_t expires_ns = _now_ns() + timeout_ms * 1000000ULL;
+  if (!d->expires_ns || expires_ns < d->expires_ns) {
+    d->expires_ns = expires_ns;
+  }
+}
+
+deadline_status_t deadline_status(const deadline_t *d) {
+  if (!d) {
+    return DEADLINE_OK;
+  }
+  if (d->alive && !atomic_load_explicit(d->alive, memory_order_relaxed)) {
+    return DEADLINE_CANCELLED;
+  }
+  if (d->expires_ns && _now_ns() >= d->expires_ns) {
+    return DEADLINE_EXPIRED;
+  }
+  return DEADLINE_OK;
+}
+
+const char *deadline_err_msg(deadline_status_t status) {
+  switch (status) {
+  case DEADLINE_EXPIRED:
+    return "Query timed out";
+  case DEADLINE_CANCELLED:
+    return "Query cancelled";
+  default:
+    return NULL;
+  }
+}
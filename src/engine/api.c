@@ -1,5 +1,6 @@
 #include "engine/api.h"
 #include "engine.h"
+#include "engine/subscription/subscription.h"
 #include "engine/validator/validator.h"
 #include "query/ast.h"
 #include <ctype.h>
@@ -23,6 +24,16 @@ void free_api_response(api_response_t *r) {
       }
     }
     free(r->payload.list_obj.objects);
+    free(r->payload.list_obj.plan);
+    break;
+  case API_RESP_TYPE_SUBSCRIPTION:
+    sub_release(r->payload.sub);
+    break;
+  case API_RESP_TYPE_HISTOGRAM:
+    free(r->payload.histogram.counts);
+    break;
+  case API_RESP_TYPE_ID_SET:
+    free(r->payload.id_set.bitmap);
     break;
   default:
     break;
@@ -49,10 +60,11 @@ static api_response_t *_api_event(ast_node_t *ast, api_response_t *r,
   return r;
 }
 
-static api_response_t *_api_query(ast_node_t *ast, api_response_t *r) {
+static api_response_t *_api_query(ast_node_t *ast, api_response_t *r,
+                                  const atomic_int *alive) {
   r->op_type = API_QUERY;
 
-  eng_query(r, ast);
+  eng_query(r, ast, alive);
   return r;
 }
 
@@ -63,10 +75,79 @@ static api_response_t *_api_index(ast_node_t *ast, api_response_t *r) {
   return r;
 }
 
+static api_response_t *_api_create_view(ast_node_t *ast, api_response_t *r) {
+  r->op_type = API_CREATE_VIEW;
+
+  eng_create_view(r, ast);
+  return r;
+}
+
+static api_response_t *_api_subscribe(ast_node_t *ast, api_response_t *r) {
+  r->op_type = API_SUBSCRIBE;
+
+  eng_subscribe(r, ast);
+  return r;
+}
+
+static api_response_t *_api_show(ast_node_t *ast, api_response_t *r) {
+  r->op_type = API_SHOW;
+
+  eng_show(r, ast);
+  return r;
+}
+
+static api_response_t *_api_histogram(ast_node_t *ast, api_response_t *r,
+                                      const atomic_int *alive) {
+  r->op_type = API_HISTOGRAM;
+
+  eng_histogram(r, ast, alive);
+  return r;
+}
+
+static api_response_t *_api_funnel(ast_node_t *ast, api_response_t *r,
+                                   const atomic_int *alive) {
+  r->op_type = API_FUNNEL;
+
+  eng_funnel(r, ast, alive);
+  return r;
+}
+
+static api_response_t *_api_entities(ast_node_t *ast, api_response_t *r,
+                                     const atomic_int *alive) {
+  r->op_type = API_ENTITIES;
+
+  eng_entities(r, ast, alive);
+  return r;
+}
+
+static api_response_t *_api_create_rollup(ast_node_t *ast,
+                                          api_response_t *r) {
+  r->op_type = API_CREATE_ROLLUP;
+
+  eng_create_rollup(r, ast);
+  return r;
+}
+
+static api_response_t *_api_rollup(ast_node_t *ast, api_response_t *r) {
+  r->op_type = API_ROLLUP;
+
+  eng_rollup(r, ast);
+  return r;
+}
+
+static api_response_t *_api_top(ast_node_t *ast, api_response_t *r,
+                                const atomic_int *alive) {
+  r->op_type = API_TOP;
+
+  eng_top(r, ast, alive);
+  return r;
+}
+
 // The single entry point into the API/Engine layer.
 // Validates the AST before passing it into the core engine for execution.
 // `api_exec` takes ownership of `ast`.
-api_response_t *api_exec(ast_node_t *ast, int64_t arrival_ts) {
+api_response_t *api_exec(ast_node_t *ast, int64_t arrival_ts,
+                         const atomic_int *alive) {
   api_response_t *r = _create_api_resp(API_INVALID);
   if (!r) {
     ast_free(ast);
@@ -88,7 +169,7 @@ api_response_t *api_exec(ast_node_t *ast, int64_t arrival_ts) {
     break;
 
   case AST_CMD_QUERY:
-    _api_query(ast, r);
+    _api_query(ast, r, alive);
 
     break;
 
@@ -97,6 +178,51 @@ api_response_t *api_exec(ast_node_t *ast, int64_t arrival_ts) {
 
     break;
 
+  case AST_CMD_CREATE_VIEW:
+    _api_create_view(ast, r);
+
+    break;
+
+  case AST_CMD_SUBSCRIBE:
+    _api_subscribe(ast, r);
+
+    break;
+
+  case AST_CMD_SHOW:
+    _api_show(ast, r);
+
+    break;
+
+  case AST_CMD_TOP:
+    _api_top(ast, r, alive);
+
+    break;
+
+  case AST_CMD_HISTOGRAM:
+    _api_histogram(ast, r, alive);
+
+    break;
+
+  case AST_CMD_FUNNEL:
+    _api_funnel(ast, r, alive);
+
+    break;
+
+  case AST_CMD_ENTITIES:
+    _api_entities(ast, r, alive);
+
+    break;
+
+  case AST_CMD_CREATE_ROLLUP:
+    _api_create_rollup(ast, r);
+
+    break;
+
+  case AST_CMD_ROLLUP:
+    _api_rollup(ast, r);
+
+    break;
+
   default:
     r->err_msg = "Unknown command type!";
     ;
@@ -0,0 +1,816 @@
+#include "bulk_load.h"
+#include "core/bitmaps.h"
+#include "core/data_constants.h"
+#include "core/db.h"
+#include "core/map.h"
+#include "core/mmap_array.h"
+#include "engine/cmd_context/cmd_context.h"
+#include "engine/container/container_db.h"
+#include "engine/container/container_types.h"
+#include "engine/eng_key_format/eng_key_format.h"
+#include "engine/index/index.h"
+#include "engine/tag_stats/tag_stats.h"
+#include "engine/worker/encoder.h"
+#include "khash.h"
+#include "lmdb.h"
+#include "query/ast.h"
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Events appended to the events db per txn, keeps dirty pages bounded
+#define BULK_LOAD_EVENTS_PER_TXN 65536
+// Container names hold no `.`, so no container is named like this
+#define BULK_LOAD_TMP_SUFFIX ".load"
+
+KHASH_MAP_INIT_STR(bl_bitmap, bitmap_t *)
+
+// An index db entry. STR keys are owned
+typedef struct bl_index_entry_s {
+  db_key_t key;
+  uint32_t event_id;
+} bl_index_entry_t;
+
+// Entries of a range index, in event order until written
+typedef struct bl_index_s {
+  const char *key; // owned by the container's `key_to_index`
+  index_t index;
+  bl_index_entry_t *entries;
+  size_t count;
+  size_t cap;
+} bl_index_t;
+
+// An inverted index bitmap, for sorting
+typedef struct bl_bitmap_entry_s {
+  MDB_val key;
+  bitmap_t *bm;
+} bl_bitmap_entry_t;
+
+struct bulk_load_s {
+  char *data_dir;
+  char *name;
+  char *tmp_name;
+  eng_container_t *sys_c;
+  // The temporary container
+  eng_container_t *c;
+  kh_key_index_t *key_to_index;
+  // Events txn, renewed every `BULK_LOAD_EVENTS_PER_TXN` events
+  MDB_txn *txn;
+  uint32_t events_in_txn;
+  // Reads existing entity mappings
+  MDB_txn *sys_txn;
+  uint32_t next_event_id;
+  // Entity ids from `first_new_ent_id` on are new to the system container
+  uint32_t first_new_ent_id;
+  uint32_t next_ent_id;
+  // Every mapping the load used
+  khash_t(str_u32) * str_ents;
+  khash_t(i64_u32) * int_ents;
+  khash_t(bl_bitmap) * bitmaps;
+  bitmap_t *entities;
+  bl_index_t *indexes;
+  uint32_t num_indexes;
+  bulk_load_stats_t stats;
+};
+
+// qsort has no context argument, loads run on one thread
+static struct {
+  MDB_txn *txn;
+  MDB_dbi dbi;
+} g_sort;
+
+const char *bulk_load_name(const bulk_load_t *bl) { return bl->name; }
+
+static bool _path_into(char *buf, size_t size, const char *data_dir,
+                       const char *name, const char *suffix) {
+  int r = snprintf(buf, size, "%s/%s%s", data_dir, name, suffix);
+  return r >= 0 && (size_t)r < size;
+}
+
+static bool _exists(const char *path) {
+  // As `_is_new_container`: only a missing file is safe to create
+  return access(path, F_OK) == 0 || errno != ENOENT;
+}
+
+// Files of the temporary container, see `open_user_container`
+static void _remove_tmp_files(bulk_load_t *bl) {
+  char path[MAX_CONTAINER_PATH_LENGTH];
+  const char *suffixes[] = {".mdb", ".mdb-lock", "_evt_ent.bin"};
+  for (size_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); i++) {
+    if (_path_into(path, sizeof(path), bl->data_dir, bl->tmp_name,
+                   suffixes[i])) {
+      unlink(path);
+    }
+  }
+}
+
+// Txns go before their container
+static void _close(bulk_load_t *bl) {
+  if (bl->txn) {
+    db_abort_txn(bl->txn);
+    bl->txn = NULL;
+  }
+  if (bl->sys_txn) {
+    db_abort_txn(bl->sys_txn);
+    bl->sys_txn = NULL;
+  }
+  container_close(bl->c);
+  bl->c = NULL;
+}
+
+static void _free(bulk_load_t *bl) {
+  _close(bl);
+
+  const char *s;
+  uint32_t u;
+  if (bl->str_ents) {
+    kh_foreach(bl->str_ents, s, u, {
+      (void)u;
+      free((char *)s);
+    });
+    kh_destroy(str_u32, bl->str_ents);
+  }
+  if (bl->int_ents) {
+    kh_destroy(i64_u32, bl->int_ents);
+  }
+  bitmap_t *bm;
+  if (bl->bitmaps) {
+    kh_foreach(bl->bitmaps, s, bm, {
+      free((char *)s);
+      bitmap_free(bm);
+    });
+    kh_destroy(bl_bitmap, bl->bitmaps);
+  }
+  bitmap_free(bl->entities);
+  for (uint32_t i = 0; i < bl->num_indexes; i++) {
+    bl_index_t *idx = &bl->indexes[i];
+    for (size_t e = 0; e < idx->count; e++) {
+      if (idx->entries[e].key.type == DB_KEY_STRING) {
+        free(idx->entries[e].key.key.s);
+      }
+    }
+    free(idx->entries);
+  }
+  free(bl->indexes);
+  free(bl->data_dir);
+  free(bl->name);
+  free(bl->tmp_name);
+  free(bl);
+}
+
+void bulk_load_abort(bulk_load_t *bl) {
+  if (!bl) {
+    return;
+  }
+  _close(bl);
+  _remove_tmp_files(bl);
+  _free(bl);
+}
+
+static bool _get_u32(MDB_dbi db, MDB_txn *txn, db_key_t *key,
+                     uint32_t *value_out, bool *found_out) {
+  db_get_result_t r;
+  if (!db_get_view(db, txn, key, &r)) {
+    return false;
+  }
+  *found_out = r.status == DB_GET_OK && r.value_len == sizeof(uint32_t);
+  if (*found_out) {
+    memcpy(value_out, r.value, sizeof(uint32_t));
+  }
+  return true;
+}
+
+// Range indexes get an entry list, BSI ones live in the inverted index
+static bool _init_indexes(bulk_load_t *bl) {
+  uint32_t count = 0;
+  index_get_count(bl->key_to_index, &count);
+  bl->indexes = calloc(count ? count : 1, sizeof(bl_index_t));
+  if (!bl->indexes) {
+    return false;
+  }
+  const char *key;
+  index_t idx;
+  kh_foreach(bl->key_to_index, key, idx, {
+    if (idx.index_def.type != INDEX_TYPE_BSI) {
+      bl->indexes[bl->num_indexes].key = key;
+      bl->indexes[bl->num_indexes].index = idx;
+      bl->num_indexes++;
+    }
+  });
+  return true;
+}
+
+bulk_load_t *bulk_load_begin(const char *data_dir, const char *container_name,
+                             eng_container_t *sys_c, const char **err_out) {
+  if (!data_dir || !container_name || !sys_c ||
+      sys_c->type != CONTAINER_TYPE_SYS) {
+    *err_out = "Invalid args";
+    return NULL;
+  }
+  bulk_load_t *bl = calloc(1, sizeof(bulk_load_t));
+  if (!bl) {
+    *err_out = "Memory allocation failed";
+    return NULL;
+  }
+  size_t tmp_len = strlen(container_name) + sizeof(BULK_LOAD_TMP_SUFFIX);
+  bl->data_dir = strdup(data_dir);
+  bl->name = strdup(container_name);
+  bl->tmp_name = malloc(tmp_len);
+  bl->str_ents = kh_init(str_u32);
+  bl->int_ents = kh_init(i64_u32);
+  bl->bitmaps = kh_init(bl_bitmap);
+  bl->entities = bitmap_create();
+  if (!bl->data_dir || !bl->name || !bl->tmp_name || !bl->str_ents ||
+      !bl->int_ents || !bl->bitmaps || !bl->entities) {
+    _free(bl);
+    *err_out = "Memory allocation failed";
+    return NULL;
+  }
+  snprintf(bl->tmp_name, tmp_len, "%s%s", container_name,
+           BULK_LOAD_TMP_SUFFIX);
+  bl->sys_c = sys_c;
+  bl->next_event_id = USR_NEXT_EVENT_ID_INIT_VAL;
+
+  // The temporary container is another load's, or an interrupted one's
+  const char *names[] = {container_name, container_name, bl->tmp_name};
+  const char *suffixes[] = {".mdb", "_evt_ent.bin", ".mdb"};
+  const char *exists_errs[] = {"Container already exists",
+                               "Container already exists",
+                               "Temporary container of another load exists"};
+  char path[MAX_CONTAINER_PATH_LENGTH];
+  for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+    if (!_path_into(path, sizeof(path), data_dir, names[i], suffixes[i])) {
+      _free(bl);
+      *err_out = "Container path too long";
+      return NULL;
+    }
+    if (_exists(path)) {
+      _free(bl);
+      *err_out = exists_errs[i];
+      return NULL;
+    }
+  }
+
+  bl->sys_txn = db_create_txn(sys_c->env, true);
+  if (!bl->sys_txn) {
+    _free(bl);
+    *err_out = "Failed to begin system txn";
+    return NULL;
+  }
+  db_key_t next_key = {.type = DB_KEY_STRING, .key.s = SYS_NEXT_ENT_ID_KEY};
+  bool found = false;
+  if (!_get_u32(sys_c->data.sys->sys_dc_metadata_db, bl->sys_txn, &next_key,
+                &bl->next_ent_id, &found)) {
+    _free(bl);
+    *err_out = "Failed to read next entity id";
+    return NULL;
+  }
+  if (!found) {
+    bl->next_ent_id = SYS_NEXT_ENT_ID_INIT_VAL;
+  }
+  bl->first_new_ent_id = bl->next_ent_id;
+
+  container_result_t cr = open_user_container(
+      bl->tmp_name, data_dir, MAX_CONTAINER_SIZE, sys_c, bl->sys_txn, true);
+  if (!cr.success) {
+    _remove_tmp_files(bl);
+    _free(bl);
+    *err_out = cr.error_msg;
+    return NULL;
+  }
+  bl->c = cr.container;
+  bl->key_to_index = atomic_load(&bl->c->data.usr->key_to_index);
+  if (!_init_indexes(bl)) {
+    bulk_load_abort(bl);
+    *err_out = "Memory allocation failed";
+    return NULL;
+  }
+  bl->txn = db_create_txn(bl->c->env, false);
+  if (!bl->txn) {
+    bulk_load_abort(bl);
+    *err_out = "Failed to begin txn";
+    return NULL;
+  }
+  return bl;
+}
+
+// Existing mapping, one this load made, or a new id
+static bool _entity_id(bulk_load_t *bl, ast_literal_node_t *ent,
+                       uint32_t *ent_id_out) {
+  bool is_str = ent->type == AST_LITERAL_STRING;
+  khint_t k = is_str ? kh_get(str_u32, bl->str_ents, ent->string_value)
+                     : kh_get(i64_u32, bl->int_ents, ent->number_value);
+  if (is_str ? k != kh_end(bl->str_ents) : k != kh_end(bl->int_ents)) {
+    *ent_id_out = is_str ? kh_value(bl->str_ents, k)
+                         : kh_value(bl->int_ents, k);
+    return true;
+  }
+
+  db_key_t db_key;
+  if (is_str) {
+    db_key.type = DB_KEY_STRING;
+    db_key.key.s = ent->string_value;
+  } else {
+    db_key.type = DB_KEY_I64;
+    db_key.key.i64 = ent->number_value;
+  }
+  eng_sys_dc_t *sys = bl->sys_c->data.sys;
+  bool found = false;
+  if (!_get_u32(is_str ? sys->str_to_entity_id_db : sys->int_to_entity_id_db,
+                bl->sys_txn, &db_key, ent_id_out, &found)) {
+    return false;
+  }
+  if (!found) {
+    if (bl->next_ent_id == UINT32_MAX) {
+      return false;
+    }
+    *ent_id_out = bl->next_ent_id++;
+  }
+
+  int ret;
+  if (is_str) {
+    char *key = strdup(ent->string_value);
+    if (!key) {
+      return false;
+    }
+    k = kh_put(str_u32, bl->str_ents, key, &ret);
+    if (ret < 0) {
+      free(key);
+      return false;
+    }
+    kh_value(bl->str_ents, k) = *ent_id_out;
+  } else {
+    k = kh_put(i64_u32, bl->int_ents, ent->number_value, &ret);
+    if (ret < 0) {
+      return false;
+    }
+    kh_value(bl->int_ents, k) = *ent_id_out;
+  }
+  return true;
+}
+
+static bool _add_to_bitmap(bulk_load_t *bl, const char *key,
+                           uint32_t value) {
+  khint_t k = kh_get(bl_bitmap, bl->bitmaps, key);
+  if (k == kh_end(bl->bitmaps)) {
+    char *owned = strdup(key);
+    bitmap_t *bm = bitmap_create();
+    int ret;
+    if (!owned || !bm ||
+        (k = kh_put(bl_bitmap, bl->bitmaps, owned, &ret), ret < 0)) {
+      free(owned);
+      bitmap_free(bm);
+      return false;
+    }
+    kh_value(bl->bitmaps, k) = bm;
+  }
+  bitmap_add(kh_value(bl->bitmaps, k), value);
+  return true;
+}
+
+// Value of the event for an index on `key`, as the worker resolves it
+static ast_literal_node_t *_index_value(const char *key, cmd_ctx_t *cmd,
+                                        ast_literal_node_t *ts_out) {
+  if (strcmp(key, "ts") == 0) {
+    ts_out->type = AST_LITERAL_NUMBER;
+    ts_out->number_value = cmd->arrival_ts / 1000000L;
+    return ts_out;
+  }
+  ast_node_t *tag = ast_find_custom_tag(&cmd->ast->command, key);
+  return tag ? &tag->tag.value->literal : NULL;
+}
+
+static bool _add_index_entry(bl_index_t *idx, db_key_t *key,
+                             uint32_t event_id) {
+  if (idx->count == idx->cap) {
+    size_t cap = idx->cap ? idx->cap * 2 : 1024;
+    bl_index_entry_t *entries =
+        realloc(idx->entries, cap * sizeof(bl_index_entry_t));
+    if (!entries) {
+      return false;
+    }
+    idx->entries = entries;
+    idx->cap = cap;
+  }
+  idx->entries[idx->count].key = *key;
+  idx->entries[idx->count].event_id = event_id;
+  idx->count++;
+  return true;
+}
+
+// Inverted index keys and index db entries, like `worker_create_ops` and
+// `worker_create_writer_msg`. A new container has no views
+static bool _index_event(bulk_load_t *bl, cmd_ctx_t *cmd, uint32_t ent_id,
+                         uint32_t event_id) {
+  char key[MAX_TEXT_VAL_LEN * 2];
+  ast_node_t *tag = cmd->custom_tags_head;
+  for (uint32_t i = 0; i < cmd->num_custom_tags; i++, tag = tag->next) {
+    if (!custom_tag_into(key, sizeof(key), tag) ||
+        !_add_to_bitmap(bl, key, event_id)) {
+      return false;
+    }
+  }
+  if (!entity_events_key_into(key, sizeof(key), ent_id) ||
+      !_add_to_bitmap(bl, key, event_id)) {
+    return false;
+  }
+
+  ast_literal_node_t ts;
+  const char *idx_key;
+  index_t idx;
+  bool ok = true;
+  kh_foreach(bl->key_to_index, idx_key, idx, {
+    ast_literal_node_t *val = _index_value(idx_key, cmd, &ts);
+    uint64_t value;
+    uint32_t slices[INDEX_BSI_SLICES + 1];
+    if (ok && idx.index_def.type == INDEX_TYPE_BSI && val &&
+        index_bsi_value(val, &value)) {
+      uint32_t num_slices = index_bsi_slices(value, slices);
+      for (uint32_t s = 0; ok && s < num_slices; s++) {
+        ok = bsi_key_into(key, sizeof(key), idx_key, slices[s]) &&
+             _add_to_bitmap(bl, key, event_id);
+      }
+    }
+  });
+  if (!ok) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < bl->num_indexes; i++) {
+    bl_index_t *bl_idx = &bl->indexes[i];
+    ast_literal_node_t *val = _index_value(bl_idx->key, cmd, &ts);
+    db_key_t db_key;
+    if (!val ||
+        !index_key_from_literal(bl_idx->index.index_def.type, val, &db_key)) {
+      continue;
+    }
+    if (!_add_index_entry(bl_idx, &db_key, event_id)) {
+      if (db_key.type == DB_KEY_STRING) {
+        free(db_key.key.s);
+      }
+      return false;
+    }
+  }
+  bitmap_add(bl->entities, ent_id);
+  return true;
+}
+
+bool bulk_load_add(bulk_load_t *bl, cmd_ctx_t *cmd, const char **err_out) {
+  if (!bl || !cmd || !cmd->in_tag_value || !cmd->entity_tag_value) {
+    *err_out = "Invalid event";
+    return false;
+  }
+  if (strcmp(cmd->in_tag_value->literal.string_value, bl->name) != 0) {
+    *err_out = "Event is for another container";
+    return false;
+  }
+  if (bl->next_event_id == UINT32_MAX) {
+    *err_out = "Too many events";
+    return false;
+  }
+
+  uint32_t ent_id;
+  if (!_entity_id(bl, &cmd->entity_tag_value->literal, &ent_id)) {
+    *err_out = "Failed to map entity";
+    return false;
+  }
+  uint32_t event_id = bl->next_event_id++;
+  if (mmap_array_set(&bl->c->data.usr->event_to_entity_map, event_id,
+                     &ent_id) != 0) {
+    *err_out = "Failed to write event entity map";
+    return false;
+  }
+
+  char *data = NULL;
+  size_t size = 0;
+  if (!encode_event(cmd, event_id, &data, &size)) {
+    *err_out = "Failed to encode event";
+    return false;
+  }
+  db_key_t key = {.type = DB_KEY_U32, .key.u32 = event_id};
+  db_put_result_t pr = db_put_append(bl->c->data.usr->events_db, bl->txn,
+                                     &key, data, size, false);
+  free(data);
+  if (pr != DB_PUT_OK) {
+    *err_out = "Failed to write event";
+    return false;
+  }
+
+  if (!_index_event(bl, cmd, ent_id, event_id)) {
+    *err_out = "Failed to index event";
+    return false;
+  }
+  bl->stats.events++;
+
+  if (++bl->events_in_txn == BULK_LOAD_EVENTS_PER_TXN) {
+    bool committed = db_commit_txn(bl->txn);
+    bl->txn = committed ? db_create_txn(bl->c->env, false) : NULL;
+    bl->events_in_txn = 0;
+    if (!bl->txn) {
+      *err_out = "Failed to commit events";
+      return false;
+    }
+  }
+  return true;
+}
+
+static int _cmp_bitmap_entry(const void *a, const void *b) {
+  const bl_bitmap_entry_t *x = a;
+  const bl_bitmap_entry_t *y = b;
+  return mdb_cmp(g_sort.txn, g_sort.dbi, &x->key, &y->key);
+}
+
+static MDB_val _db_key_val(const db_key_t *key) {
+  MDB_val v;
+  if (key->type == DB_KEY_STRING) {
+    v.mv_data = key->key.s;
+    v.mv_size = strlen(key->key.s);
+  } else {
+    v.mv_data = (void *)&key->key.i64;
+    v.mv_size = sizeof(int64_t);
+  }
+  return v;
+}
+
+static int _cmp_index_key(const bl_index_entry_t *x,
+                          const bl_index_entry_t *y) {
+  MDB_val xk = _db_key_val(&x->key);
+  MDB_val yk = _db_key_val(&y->key);
+  return mdb_cmp(g_sort.txn, g_sort.dbi, &xk, &yk);
+}
+
+// Keys in db order, then events in duplicate order
+static int _cmp_index_entry(const void *a, const void *b) {
+  const bl_index_entry_t *x = a;
+  const bl_index_entry_t *y = b;
+  int c = _cmp_index_key(x, y);
+  if (c != 0) {
+    return c;
+  }
+  MDB_val xv = {sizeof(uint32_t), (void *)&x->event_id};
+  MDB_val yv = {sizeof(uint32_t), (void *)&y->event_id};
+  return mdb_dcmp(g_sort.txn, g_sort.dbi, &xv, &yv);
+}
+
+static bool _write_bitmaps(bulk_load_t *bl, MDB_txn *txn) {
+  eng_user_dc_t *usr = bl->c->data.usr;
+  size_t count = kh_size(bl->bitmaps);
+  bl_bitmap_entry_t *sorted = malloc((count ? count : 1) * sizeof(*sorted));
+  if (!sorted) {
+    return false;
+  }
+  size_t n = 0;
+  const char *key;
+  bitmap_t *bm;
+  kh_foreach(bl->bitmaps, key, bm, {
+    sorted[n].key.mv_data = (void *)key;
+    sorted[n].key.mv_size = strlen(key);
+    sorted[n].bm = bm;
+    n++;
+  });
+  g_sort.txn = txn;
+  g_sort.dbi = usr->inverted_event_index_db;
+  qsort(sorted, n, sizeof(*sorted), _cmp_bitmap_entry);
+
+  bool ok = true;
+  for (size_t i = 0; ok && i < n; i++) {
+    size_t size = 0;
+    void *data = bitmap_serialize(sorted[i].bm, &size);
+    db_key_t db_key = {.type = DB_KEY_STRING,
+                       .key.s = sorted[i].key.mv_data};
+    ok = data && db_put_append(usr->inverted_event_index_db, txn, &db_key,
+                               data, size, false) == DB_PUT_OK;
+    free(data);
+    // Stats are committed with the bitmaps, as the consumer does
+    ok = ok && tag_stats_put_cardinality(
+                   txn, usr->tag_stats_db, bl->key_to_index,
+                   sorted[i].key.mv_data,
+                   bitmap_get_cardinality(sorted[i].bm));
+  }
+  free(sorted);
+  bl->stats.bitmaps = ok ? n : 0;
+  return ok;
+}
+
+static bool _write_indexes(bulk_load_t *bl, MDB_txn *txn) {
+  g_sort.txn = txn;
+  for (uint32_t i = 0; i < bl->num_indexes; i++) {
+    bl_index_t *idx = &bl->indexes[i];
+    g_sort.dbi = idx->index.index_db;
+    qsort(idx->entries, idx->count, sizeof(bl_index_entry_t),
+          _cmp_index_entry);
+    for (size_t e = 0; e < idx->count; e++) {
+      bool same_key =
+          e > 0 && _cmp_index_key(&idx->entries[e - 1], &idx->entries[e]) == 0;
+      if (db_put_append(idx->index.index_db, txn, &idx->entries[e].key,
+                        &idx->entries[e].event_id, sizeof(uint32_t),
+                        same_key) != DB_PUT_OK) {
+        return false;
+      }
+    }
+    bl->stats.index_entries += idx->count;
+  }
+  return true;
+}
+
+static bool _write_metadata(bulk_load_t *bl, MDB_txn *txn) {
+  MDB_dbi db = bl->c->data.usr->user_dc_metadata_db;
+  size_t size = 0;
+  void *data = bitmap_serialize(bl->entities, &size);
+  db_key_t key = {.type = DB_KEY_STRING, .key.s = USR_ENTITIES_KEY};
+  bool ok =
+      data && db_put(db, txn, &key, data, size, false, false) == DB_PUT_OK;
+  free(data);
+  // The next id, the online counter reads it back as such
+  key.key.s = USR_NEXT_EVENT_ID_KEY;
+  return ok && db_put(db, txn, &key, &bl->next_event_id, sizeof(uint32_t),
+                      false, false) == DB_PUT_OK;
+}
+
+// Slot of the entity's external id, as the worker writes it
+static void _entity_slot_into(char *slot, const char *str, int64_t num) {
+  memset(slot, 0, SLOT_SIZE);
+  if (str) {
+    slot[0] = VAL_TYPE_STR;
+    strncpy(slot + TAG_UNION_SIZE, str, MAX_ENTITY_STR_LEN);
+    slot[SLOT_SIZE - 1] = '\0';
+  } else {
+    slot[0] = VAL_TYPE_I64;
+    memcpy(slot + TAG_UNION_SIZE, &num, sizeof(int64_t));
+  }
+}
+
+// New entity mappings and the entity counter, in one system txn
+static bool _write_entities(bulk_load_t *bl, const char **err_out) {
+  db_abort_txn(bl->sys_txn);
+  bl->sys_txn = NULL;
+  if (bl->next_ent_id == bl->first_new_ent_id) {
+    return true;
+  }
+  eng_sys_dc_t *sys = bl->sys_c->data.sys;
+  MDB_txn *txn = db_create_txn(bl->sys_c->env, false);
+  if (!txn) {
+    *err_out = "Failed to begin system txn";
+    return false;
+  }
+  db_key_t key = {.type = DB_KEY_STRING, .key.s = SYS_NEXT_ENT_ID_KEY};
+  uint32_t next = 0;
+  bool found = false;
+  if (!_get_u32(sys->sys_dc_metadata_db, txn, &key, &next, &found)) {
+    db_abort_txn(txn);
+    *err_out = "Failed to read next entity id";
+    return false;
+  }
+  if ((found ? next : SYS_NEXT_ENT_ID_INIT_VAL) != bl->first_new_ent_id) {
+    // Ids were handed out meanwhile, the server or another load is running
+    db_abort_txn(txn);
+    *err_out = "Entity ids changed during the load";
+    return false;
+  }
+
+  bool ok = db_put(sys->sys_dc_metadata_db, txn, &key, &bl->next_ent_id,
+                   sizeof(uint32_t), false, false) == DB_PUT_OK;
+  const char *s;
+  int64_t i;
+  uint32_t id;
+  db_key_t k = {.type = DB_KEY_STRING};
+  kh_foreach(bl->str_ents, s, id, {
+    if (ok && id >= bl->first_new_ent_id) {
+      k.key.s = (char *)s;
+      ok = db_put(sys->str_to_entity_id_db, txn, &k, &id, sizeof(uint32_t),
+                  false, false) == DB_PUT_OK;
+    }
+  });
+  k.type = DB_KEY_I64;
+  kh_foreach(bl->int_ents, i, id, {
+    if (ok && id >= bl->first_new_ent_id) {
+      k.key.i64 = i;
+      ok = db_put(sys->int_to_entity_id_db, txn, &k, &id, sizeof(uint32_t),
+                  false, false) == DB_PUT_OK;
+    }
+  });
+  if (!ok || !db_commit_txn(txn)) {
+    if (!ok) {
+      db_abort_txn(txn);
+    }
+    *err_out = "Failed to write entity ids";
+    return false;
+  }
+
+  char slot[SLOT_SIZE];
+  kh_foreach(bl->str_ents, s, id, {
+    if (ok && id >= bl->first_new_ent_id) {
+      _entity_slot_into(slot, s, 0);
+      ok = mmap_array_set(&sys->entity_id_map, id, slot) == 0;
+    }
+  });
+  kh_foreach(bl->int_ents, i, id, {
+    if (ok && id >= bl->first_new_ent_id) {
+      _entity_slot_into(slot, NULL, i);
+      ok = mmap_array_set(&sys->entity_id_map, id, slot) == 0;
+    }
+  });
+  if (!ok) {
+    *err_out = "Failed to write entity map";
+    return false;
+  }
+  bl->stats.new_entities = bl->next_ent_id - bl->first_new_ent_id;
+  return true;
+}
+
+// The event entity map goes first: the container is there once its .mdb is.
+// A failed install moves the map back, so nothing is left under `name`
+static bool _install(bulk_load_t *bl) {
+  char map_from[MAX_CONTAINER_PATH_LENGTH];
+  char map_to[MAX_CONTAINER_PATH_LENGTH];
+  char mdb_from[MAX_CONTAINER_PATH_LENGTH];
+  char mdb_to[MAX_CONTAINER_PATH_LENGTH];
+  if (!_path_into(map_from, sizeof(map_from), bl->data_dir, bl->tmp_name,
+                  "_evt_ent.bin") ||
+      !_path_into(map_to, sizeof(map_to), bl->data_dir, bl->name,
+                  "_evt_ent.bin") ||
+      !_path_into(mdb_from, sizeof(mdb_from), bl->data_dir, bl->tmp_name,
+                  ".mdb") ||
+      !_path_into(mdb_to, sizeof(mdb_to), bl->data_dir, bl->name, ".mdb") ||
+      _exists(map_to) || _exists(mdb_to)) {
+    return false;
+  }
+  if (rename(map_from, map_to) != 0) {
+    return false;
+  }
+  if (rename(mdb_from, mdb_to) != 0) {
+    if (rename(map_to, map_from) != 0) {
+      unlink(map_to);
+    }
+    return false;
+  }
+  char lock[MAX_CONTAINER_PATH_LENGTH];
+  if (_path_into(lock, sizeof(lock), bl->data_dir, bl->tmp_name,
+                 ".mdb-lock")) {
+    unlink(lock);
+  }
+  return true;
+}
+
+bool bulk_load_finish(bulk_load_t *bl, bulk_load_stats_t *stats_out,
+                      const char **err_out) {
+  if (!bl) {
+    *err_out = "Invalid args";
+    return false;
+  }
+  bool committed = db_commit_txn(bl->txn);
+  bl->txn = NULL;
+  if (!committed) {
+    bulk_load_abort(bl);
+    *err_out = "Failed to commit events";
+    return false;
+  }
+
+  MDB_txn *txn = db_create_txn(bl->c->env, false);
+  if (!txn) {
+    bulk_load_abort(bl);
+    *err_out = "Failed to begin txn";
+    return false;
+  }
+  if (!_write_bitmaps(bl, txn) || !_write_indexes(bl, txn) ||
+      !_write_metadata(bl, txn)) {
+    db_abort_txn(txn);
+    bulk_load_abort(bl);
+    *err_out = "Failed to write indexes";
+    return false;
+  }
+  if (!db_commit_txn(txn)) {
+    bulk_load_abort(bl);
+    *err_out = "Failed to commit indexes";
+    return false;
+  }
+  if (mmap_array_sync(&bl->c->data.usr->event_to_entity_map) != 0) {
+    bulk_load_abort(bl);
+    *err_out = "Failed to sync event entity map";
+    return false;
+  }
+
+  // Entities are mapped before the container that refers to them is
+  // installed. A failed install leaves unused mappings, which are harmless
+  if (!_write_entities(bl, err_out)) {
+    bulk_load_abort(bl);
+    return false;
+  }
+
+  _close(bl);
+  if (!_install(bl)) {
+    bulk_load_abort(bl);
+    *err_out = "Failed to install container";
+    return false;
+  }
+  if (stats_out) {
+    *stats_out = bl->stats;
+  }
+  _free(bl);
+  return true;
+}
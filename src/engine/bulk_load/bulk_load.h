@@ -0,0 +1,82 @@
+#ifndef BULK_LOAD_H
+#define BULK_LOAD_H
+
+/**
+Offline bulk loader, builds a new container without the server.
+Events are numbered and encoded as they are added, and appended to the
+events db. Their inverted index bitmaps, index db entries and entities are
+kept in memory, then sorted and appended to the container's dbs at the end.
+Everything is written to a temporary container in the data dir, which is
+renamed into place once complete, so a failed load leaves no container.
+Entity ids are shared through the system container: the server must not be
+running while loading. */
+
+#include "engine/cmd_context/cmd_context.h"
+#include "engine/container/container_types.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct bulk_load_s bulk_load_t;
+
+typedef enum { BULK_LOAD_NDJSON, BULK_LOAD_MSGPACK } bulk_load_format_t;
+
+typedef struct bulk_load_stats_s {
+  uint64_t events;
+  // Entities first seen by this load
+  uint64_t new_entities;
+  // Inverted index bitmaps and index db entries written
+  uint64_t bitmaps;
+  uint64_t index_entries;
+} bulk_load_stats_t;
+
+/**
+ * @brief Starts loading `container_name`, which must not exist yet.
+ *
+ * `sys_c` is the system container of `data_dir`, it must outlive the load.
+ *
+ * @return The load, or NULL with `err_out` set.
+ */
+bulk_load_t *bulk_load_begin(const char *data_dir, const char *container_name,
+                             eng_container_t *sys_c, const char **err_out);
+
+// Name of the container being loaded
+const char *bulk_load_name(const bulk_load_t *bl);
+
+/**
+ * @brief Adds a validated `EVENT` command for the container being loaded.
+ *
+ * Events are numbered in the order they are added, so add them in time
+ * order, as the server would have received them.
+ */
+bool bulk_load_add(bulk_load_t *bl, cmd_ctx_t *cmd, const char **err_out);
+
+/**
+ * @brief Adds every record of `in`.
+ *
+ * NDJSON records are flat objects, one per line. Msgpack records are maps,
+ * one after another. `entity` is required, `ts` is the event time in ms and
+ * defaults to now. `id` and `in` are skipped, so events read back from a
+ * query load as they are. Other keys are custom tags: strings, integers,
+ * decimals and booleans, nulls are skipped.
+ *
+ * @return false with `err_out` set and `record_out` the 1-based record
+ * number on the first invalid record.
+ */
+bool bulk_load_read(bulk_load_t *bl, FILE *in, bulk_load_format_t format,
+                    const char **err_out, uint64_t *record_out);
+
+/**
+ * @brief Writes what is kept in memory, then installs the container.
+ *
+ * Frees `bl`, whether it succeeds or not. On failure nothing is installed.
+ */
+bool bulk_load_finish(bulk_load_t *bl, bulk_load_stats_t *stats_out,
+                      const char **err_out);
+
+/**
+ * Stops a load without installing it and frees `bl`
+ */
+void bulk_load_abort(bulk_load_t *bl);
+
+#endif // BULK_LOAD_H
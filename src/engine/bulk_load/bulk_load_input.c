@@ -0,0 +1,661 @@
+#include "bulk_load.h"
+#include "core/data_constants.h"
+#include "core/queue.h"
+#include "engine/cmd_context/cmd_context.h"
+#include "engine/validator/validator.h"
+#include "khash.h"
+#include "mpack.h"
+#include "query/ast.h"
+#include "query/tokenizer.h"
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Longest NDJSON line
+#define BULK_LOAD_MAX_LINE (1024 * 1024)
+// Longest number of an NDJSON record
+#define BULK_LOAD_MAX_NUMBER 64
+
+// Record key -> custom tag key, NULL if it can't be one
+KHASH_MAP_INIT_STR(bl_key, char *)
+
+typedef enum {
+  BL_VAL_NULL,
+  BL_VAL_STR,
+  BL_VAL_INT,
+  BL_VAL_FLOAT
+} bl_val_type_t;
+
+typedef struct bl_val_s {
+  bl_val_type_t type;
+  // Strings, and the text of decimals
+  const char *str;
+  size_t len;
+  int64_t i;
+  double d;
+} bl_val_t;
+
+// Turns records into `EVENT` commands
+typedef struct bl_reader_s {
+  bulk_load_t *bl;
+  khash_t(bl_key) * keys;
+  // Of the record being read
+  ast_node_t *entity;
+  ast_node_t *custom_tags;
+  uint32_t num_custom_tags;
+  int64_t ts_ms; // -1 for now
+} bl_reader_t;
+
+// As the tokenizer allows in quoted strings
+static bool _valid_str_char(char c) {
+  return isalnum((unsigned char)c) || c == '_' || c == '-' || c == '.' ||
+         c == ' ';
+}
+
+// The key as a query names it, or NULL if a query can't: tags are
+// identifiers, which the tokenizer lowercases
+static const char *_custom_key(bl_reader_t *r, const char *key) {
+  khint_t k = kh_get(bl_key, r->keys, key);
+  if (k != kh_end(r->keys)) {
+    return kh_value(r->keys, k);
+  }
+  char *tag_key = NULL;
+  char *input = strdup(key);
+  queue_t *tokens = input ? tok_tokenize(input) : NULL;
+  if (tokens) {
+    token_t *t = queue_peek(tokens);
+    if (queue_size(tokens) == 1 && t->type == TOKEN_IDENTIFER) {
+      tag_key = strdup(t->text_value);
+    }
+    tok_clear_all(tokens);
+    queue_destroy(tokens);
+  }
+  free(input);
+
+  int ret;
+  char *owned = strdup(key);
+  if (!owned || (k = kh_put(bl_key, r->keys, owned, &ret), ret < 0)) {
+    free(owned);
+    free(tag_key);
+    return NULL;
+  }
+  kh_value(r->keys, k) = tag_key;
+  return tag_key;
+}
+
+static void _reader_clear_record(bl_reader_t *r) {
+  ast_free(r->entity);
+  ast_free(r->custom_tags);
+  r->entity = NULL;
+  r->custom_tags = NULL;
+  r->num_custom_tags = 0;
+  r->ts_ms = -1;
+}
+
+static ast_node_t *_literal(const bl_val_t *val) {
+  switch (val->type) {
+  case BL_VAL_STR:
+    return ast_create_string_literal_node(val->str, val->len);
+  case BL_VAL_INT:
+    return ast_create_number_literal_node(val->i);
+  case BL_VAL_FLOAT:
+    return ast_create_float_literal_node(val->d, val->str, val->len);
+  default:
+    return NULL;
+  }
+}
+
+static bool _add_field(bl_reader_t *r, const char *key, const bl_val_t *val,
+                       const char **err_out) {
+  if (val->type == BL_VAL_NULL || (val->type == BL_VAL_STR && !val->len)) {
+    // No value, no tag
+    return true;
+  }
+  if (strcmp(key, "id") == 0 || strcmp(key, "in") == 0) {
+    // Assigned by the load
+    return true;
+  }
+  if (strcmp(key, "ts") == 0) {
+    if (val->type != BL_VAL_INT || val->i < 0 ||
+        val->i > INT64_MAX / 1000000L) {
+      *err_out = "`ts` must be a time in ms";
+      return false;
+    }
+    r->ts_ms = val->i;
+    return true;
+  }
+  if (val->type == BL_VAL_STR) {
+    for (size_t i = 0; i < val->len; i++) {
+      if (!_valid_str_char(val->str[i])) {
+        *err_out = "Invalid character in value";
+        return false;
+      }
+    }
+  }
+  if (strcmp(key, "entity") == 0) {
+    if (val->type == BL_VAL_FLOAT) {
+      *err_out = "`entity` must be a string or an integer";
+      return false;
+    }
+    ast_free(r->entity);
+    r->entity = _literal(val);
+    if (!r->entity) {
+      *err_out = "Memory allocation failed";
+      return false;
+    }
+    return true;
+  }
+
+  const char *tag_key = _custom_key(r, key);
+  if (!tag_key) {
+    *err_out = "Invalid key";
+    return false;
+  }
+  if (++r->num_custom_tags > MAX_CUSTOM_TAGS) {
+    *err_out = "Too many custom tags";
+    return false;
+  }
+  ast_node_t *lit = _literal(val);
+  ast_node_t *tag = lit ? ast_create_custom_tag_node(tag_key, lit) : NULL;
+  if (!tag) {
+    ast_free(lit);
+    *err_out = "Memory allocation failed";
+    return false;
+  }
+  ast_append_node(&r->custom_tags, tag);
+  return true;
+}
+
+static int64_t _now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (int64_t)ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+// The record as an `EVENT`, validated like one sent to the server
+static bool _load_record(bl_reader_t *r, const char **err_out) {
+  const char *name = bulk_load_name(r->bl);
+  ast_node_t *tags = ast_create_tag_node(
+      AST_KW_IN, ast_create_string_literal_node(name, strlen(name)));
+  if (r->entity) {
+    ast_append_node(&tags, ast_create_tag_node(AST_KW_ENTITY, r->entity));
+    r->entity = NULL;
+  }
+  // Appending cuts a node from what follows, so the list is linked instead
+  ast_node_t *last = tags;
+  while (last && last->next) {
+    last = last->next;
+  }
+  if (last) {
+    last->next = r->custom_tags;
+    r->custom_tags = NULL;
+  }
+  ast_node_t *ast = tags ? ast_create_command_node(AST_CMD_EVENT, tags) : NULL;
+  if (!ast) {
+    ast_free(tags);
+    *err_out = "Memory allocation failed";
+    return false;
+  }
+
+  validator_result_t vr = {0};
+  validator_analyze(ast, &vr);
+  if (!vr.is_valid) {
+    ast_free(ast);
+    *err_out = vr.err_msg;
+    return false;
+  }
+  int64_t ts = r->ts_ms < 0 ? _now_ns() : r->ts_ms * 1000000L;
+  cmd_ctx_t *cmd = build_cmd_context(ast, ts);
+  if (!cmd) {
+    ast_free(ast);
+    *err_out = "Error generating command context";
+    return false;
+  }
+  bool ok = bulk_load_add(r->bl, cmd, err_out);
+  cmd_context_free(cmd);
+  return ok;
+}
+
+// --- NDJSON --- //
+
+static void _json_ws(const char **p, const char *end) {
+  while (*p < end && isspace((unsigned char)**p)) {
+    (*p)++;
+  }
+}
+
+// A string into `out`. Only ASCII escapes, values hold no other characters
+static bool _json_string(const char **p, const char *end, char *out,
+                         size_t size, size_t *len_out, const char **err_out) {
+  *err_out = "Invalid JSON string";
+  if (*p >= end || **p != '"') {
+    return false;
+  }
+  (*p)++;
+  size_t len = 0;
+  while (*p < end && **p != '"') {
+    char c = *(*p)++;
+    if (c == '\\') {
+      if (*p >= end) {
+        return false;
+      }
+      char e = *(*p)++;
+      switch (e) {
+      case '"':
+      case '\\':
+      case '/':
+        c = e;
+        break;
+      case 'b':
+        c = '\b';
+        break;
+      case 'f':
+        c = '\f';
+        break;
+      case 'n':
+        c = '\n';
+        break;
+      case 'r':
+        c = '\r';
+        break;
+      case 't':
+        c = '\t';
+        break;
+      case 'u': {
+        char hex[5] = {0};
+        if (end - *p < 4) {
+          return false;
+        }
+        memcpy(hex, *p, 4);
+        char *hex_end;
+        long cp = strtol(hex, &hex_end, 16);
+        if (hex_end != hex + 4 || cp <= 0 || cp >= 0x80) {
+          *err_out = "Invalid character in value";
+          return false;
+        }
+        *p += 4;
+        c = (char)cp;
+        break;
+      }
+      default:
+        return false;
+      }
+    }
+    if (len + 1 >= size) {
+      *err_out = "String too long";
+      return false;
+    }
+    out[len++] = c;
+  }
+  if (*p >= end) {
+    return false;
+  }
+  (*p)++;
+  out[len] = '\0';
+  *len_out = len;
+  return true;
+}
+
+static bool _json_number(const char **p, const char *end, char *text,
+                         bl_val_t *val_out, const char **err_out) {
+  size_t len = 0;
+  bool is_int = true;
+  while (*p < end && (isdigit((unsigned char)**p) || strchr("+-.eE", **p))) {
+    if (len + 1 >= BULK_LOAD_MAX_NUMBER) {
+      *err_out = "Invalid number";
+      return false;
+    }
+    is_int = is_int && (isdigit((unsigned char)**p) || **p == '-');
+    text[len++] = *(*p)++;
+  }
+  text[len] = '\0';
+
+  char *num_end;
+  errno = 0;
+  if (is_int) {
+    val_out->type = BL_VAL_INT;
+    val_out->i = strtoll(text, &num_end, 10);
+  } else {
+    val_out->type = BL_VAL_FLOAT;
+    val_out->d = strtod(text, &num_end);
+    // Decimals keep their text, as the tokenizer does
+    val_out->str = text;
+    val_out->len = len;
+  }
+  if (!len || *num_end != '\0' || errno == ERANGE ||
+      (!is_int && !isfinite(val_out->d))) {
+    *err_out = "Invalid number";
+    return false;
+  }
+  return true;
+}
+
+static bool _json_literal(const char **p, const char *end, const char *lit) {
+  size_t n = strlen(lit);
+  if ((size_t)(end - *p) < n || strncmp(*p, lit, n) != 0) {
+    return false;
+  }
+  *p += n;
+  return true;
+}
+
+// `buf` holds strings and numbers, it is at least `BULK_LOAD_MAX_NUMBER`
+static bool _json_value(const char **p, const char *end, char *buf,
+                        size_t size, bl_val_t *val_out,
+                        const char **err_out) {
+  memset(val_out, 0, sizeof(bl_val_t));
+  if (*p >= end) {
+    *err_out = "Invalid JSON value";
+    return false;
+  }
+  char c = **p;
+  if (c == '"') {
+    val_out->type = BL_VAL_STR;
+    val_out->str = buf;
+    return _json_string(p, end, buf, size, &val_out->len, err_out);
+  }
+  if (c == '-' || isdigit((unsigned char)c)) {
+    return _json_number(p, end, buf, val_out, err_out);
+  }
+  if (_json_literal(p, end, "true") || _json_literal(p, end, "false")) {
+    // Booleans are the strings a query names them by
+    val_out->type = BL_VAL_STR;
+    val_out->str = c == 't' ? "true" : "false";
+    val_out->len = strlen(val_out->str);
+    return true;
+  }
+  if (_json_literal(p, end, "null")) {
+    val_out->type = BL_VAL_NULL;
+    return true;
+  }
+  *err_out = c == '{' || c == '[' ? "Nested values are not supported"
+                                  : "Invalid JSON value";
+  return false;
+}
+
+static bool _json_record(bl_reader_t *r, const char *line, size_t len,
+                         const char **err_out) {
+  const char *p = line;
+  const char *end = line + len;
+  char key[MAX_TEXT_VAL_LEN + 1];
+  char val_buf[MAX_TEXT_VAL_LEN + 1];
+  size_t key_len;
+  bl_val_t val;
+
+  _json_ws(&p, end);
+  if (p >= end || *p++ != '{') {
+    *err_out = "Record is not a JSON object";
+    return false;
+  }
+  _json_ws(&p, end);
+  if (p < end && *p == '}') {
+    p++;
+  } else {
+    for (;;) {
+      _json_ws(&p, end);
+      if (!_json_string(&p, end, key, sizeof(key), &key_len, err_out)) {
+        return false;
+      }
+      _json_ws(&p, end);
+      if (p >= end || *p++ != ':') {
+        *err_out = "Expected `:`";
+        return false;
+      }
+      _json_ws(&p, end);
+      if (!_json_value(&p, end, val_buf, sizeof(val_buf), &val, err_out) ||
+          !_add_field(r, key, &val, err_out)) {
+        return false;
+      }
+      _json_ws(&p, end);
+      if (p < end && *p == ',') {
+        p++;
+        continue;
+      }
+      if (p < end && *p == '}') {
+        p++;
+        break;
+      }
+      *err_out = "Expected `,` or `}`";
+      return false;
+    }
+  }
+  _json_ws(&p, end);
+  if (p != end) {
+    *err_out = "One JSON object per line";
+    return false;
+  }
+  return _load_record(r, err_out);
+}
+
+// Next line without its newline, false at the end of `in`
+static bool _read_line(FILE *in, char **buf, size_t *cap, size_t *len_out,
+                       const char **err_out) {
+  size_t len = 0;
+  for (;;) {
+    if (*cap - len < 2) {
+      size_t cap_next = *cap ? *cap * 2 : 4096;
+      char *next = cap_next <= BULK_LOAD_MAX_LINE ? realloc(*buf, cap_next)
+                                                  : NULL;
+      if (!next) {
+        *err_out = "Line too long";
+        return false;
+      }
+      *buf = next;
+      *cap = cap_next;
+    }
+    if (!fgets(*buf + len, (int)(*cap - len), in)) {
+      break;
+    }
+    len += strlen(*buf + len);
+    if ((*buf)[len - 1] == '\n') {
+      (*buf)[--len] = '\0';
+      *len_out = len;
+      return true;
+    }
+  }
+  *err_out = ferror(in) ? "Failed to read input" : NULL;
+  *len_out = len;
+  return len > 0 && !ferror(in);
+}
+
+static bool _read_ndjson(bl_reader_t *r, FILE *in, const char **err_out,
+                         uint64_t *record_out) {
+  char *line = NULL;
+  size_t cap = 0;
+  size_t len = 0;
+  bool ok = true;
+  *err_out = NULL;
+  while (ok && _read_line(in, &line, &cap, &len, err_out)) {
+    (*record_out)++;
+    const char *p = line;
+    _json_ws(&p, line + len);
+    if (p == line + len) {
+      // Blank lines count, so errors point at the line
+      continue;
+    }
+    ok = _json_record(r, line, len, err_out);
+    _reader_clear_record(r);
+  }
+  free(line);
+  if (ok && *err_out) {
+    (*record_out)++;
+    ok = false;
+  }
+  return ok;
+}
+
+// --- Msgpack --- //
+
+// Shortest text that reads back as `d`
+static size_t _float_text(double d, char *buf, size_t size) {
+  for (int precision = 1; precision < 17; precision++) {
+    snprintf(buf, size, "%.*g", precision, d);
+    if (strtod(buf, NULL) == d) {
+      break;
+    }
+  }
+  return strlen(buf);
+}
+
+// A string of up to `size - 1` bytes, its tag already read
+static bool _mpack_str(mpack_reader_t *reader, mpack_tag_t tag, char *buf,
+                       size_t size, size_t *len_out, const char **err_out) {
+  uint32_t len = mpack_tag_str_length(&tag);
+  if (len >= size) {
+    *err_out = "String too long";
+    return false;
+  }
+  mpack_read_bytes(reader, buf, len);
+  mpack_done_str(reader);
+  buf[len] = '\0';
+  *len_out = len;
+  return mpack_reader_error(reader) == mpack_ok;
+}
+
+static bool _mpack_value(mpack_reader_t *reader, char *buf, size_t size,
+                         bl_val_t *val_out, const char **err_out) {
+  memset(val_out, 0, sizeof(bl_val_t));
+  mpack_tag_t tag = mpack_read_tag(reader);
+  if (mpack_reader_error(reader) != mpack_ok) {
+    *err_out = "Invalid msgpack";
+    return false;
+  }
+  switch (mpack_tag_type(&tag)) {
+  case mpack_type_str:
+    val_out->type = BL_VAL_STR;
+    val_out->str = buf;
+    return _mpack_str(reader, tag, buf, size, &val_out->len, err_out);
+  case mpack_type_int:
+    val_out->type = BL_VAL_INT;
+    val_out->i = mpack_tag_int_value(&tag);
+    return true;
+  case mpack_type_uint:
+    if (mpack_tag_uint_value(&tag) > INT64_MAX) {
+      *err_out = "Invalid number";
+      return false;
+    }
+    val_out->type = BL_VAL_INT;
+    val_out->i = (int64_t)mpack_tag_uint_value(&tag);
+    return true;
+  case mpack_type_float:
+  case mpack_type_double:
+    val_out->type = BL_VAL_FLOAT;
+    val_out->d = mpack_tag_type(&tag) == mpack_type_float
+                     ? mpack_tag_float_value(&tag)
+                     : mpack_tag_double_value(&tag);
+    if (!isfinite(val_out->d)) {
+      *err_out = "Invalid number";
+      return false;
+    }
+    val_out->str = buf;
+    val_out->len = _float_text(val_out->d, buf, size);
+    return true;
+  case mpack_type_bool:
+    val_out->type = BL_VAL_STR;
+    val_out->str = mpack_tag_bool_value(&tag) ? "true" : "false";
+    val_out->len = strlen(val_out->str);
+    return true;
+  case mpack_type_nil:
+    val_out->type = BL_VAL_NULL;
+    return true;
+  default:
+    *err_out = "Nested values are not supported";
+    return false;
+  }
+}
+
+static bool _mpack_record(bl_reader_t *r, mpack_reader_t *reader,
+                          const char **err_out) {
+  char key[MAX_TEXT_VAL_LEN + 1];
+  char val_buf[MAX_TEXT_VAL_LEN + 1];
+  size_t key_len;
+  bl_val_t val;
+
+  mpack_tag_t tag = mpack_read_tag(reader);
+  if (mpack_reader_error(reader) != mpack_ok) {
+    *err_out = "Invalid msgpack";
+    return false;
+  }
+  if (mpack_tag_type(&tag) != mpack_type_map) {
+    *err_out = "Record is not a map";
+    return false;
+  }
+  uint32_t count = mpack_tag_map_count(&tag);
+  for (uint32_t i = 0; i < count; i++) {
+    mpack_tag_t key_tag = mpack_read_tag(reader);
+    if (mpack_reader_error(reader) != mpack_ok ||
+        mpack_tag_type(&key_tag) != mpack_type_str) {
+      *err_out = "Keys must be strings";
+      return false;
+    }
+    if (!_mpack_str(reader, key_tag, key, sizeof(key), &key_len, err_out) ||
+        !_mpack_value(reader, val_buf, sizeof(val_buf), &val, err_out) ||
+        !_add_field(r, key, &val, err_out)) {
+      return false;
+    }
+  }
+  mpack_done_map(reader);
+  return _load_record(r, err_out);
+}
+
+// True if `in` has more data. The reader's buffer must be empty
+static bool _mpack_more(mpack_reader_t *reader, FILE *in) {
+  if (mpack_reader_remaining(reader, NULL) > 0) {
+    return true;
+  }
+  int c = getc(in);
+  if (c == EOF) {
+    return false;
+  }
+  ungetc(c, in);
+  return true;
+}
+
+static bool _read_msgpack(bl_reader_t *r, FILE *in, const char **err_out,
+                          uint64_t *record_out) {
+  mpack_reader_t reader;
+  mpack_reader_init_stdfile(&reader, in, false);
+  bool ok = true;
+  while (ok && _mpack_more(&reader, in)) {
+    (*record_out)++;
+    ok = _mpack_record(r, &reader, err_out);
+    _reader_clear_record(r);
+  }
+  if (mpack_reader_destroy(&reader) != mpack_ok && ok) {
+    *err_out = "Invalid msgpack";
+    ok = false;
+  }
+  return ok;
+}
+
+bool bulk_load_read(bulk_load_t *bl, FILE *in, bulk_load_format_t format,
+                    const char **err_out, uint64_t *record_out) {
+  *record_out = 0;
+  if (!bl || !in) {
+    *err_out = "Invalid args";
+    return false;
+  }
+  bl_reader_t r = {.bl = bl, .keys = kh_init(bl_key), .ts_ms = -1};
+  if (!r.keys) {
+    *err_out = "Memory allocation failed";
+    return false;
+  }
+  bool ok = format == BULK_LOAD_MSGPACK
+                ? _read_msgpack(&r, in, err_out, record_out)
+                : _read_ndjson(&r, in, err_out, record_out);
+
+  const char *key;
+  char *tag_key;
+  kh_foreach(r.keys, key, tag_key, {
+    free((char *)key);
+    free(tag_key);
+  });
+  kh_destroy(bl_key, r.keys);
+  return ok;
+}
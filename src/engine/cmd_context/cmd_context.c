@@ -40,6 +40,33 @@ cmd_ctx_t *build_cmd_context(ast_node_t *ast, int64_t arrival_ts) {
         case AST_KW_KEY:
           ctx->key_tag_value = tag->value;
           break;
+        case AST_KW_FIELDS:
+          ctx->fields_tag_value = tag->value;
+          break;
+        case AST_KW_TIMEOUT:
+          ctx->timeout_tag_value = tag->value;
+          break;
+        case AST_KW_SAMPLE:
+          ctx->sample_tag_value = tag->value;
+          break;
+        case AST_KW_VIEW:
+          ctx->view_tag_value = tag->value;
+          break;
+        case AST_KW_TARGET:
+          ctx->target_tag_value = tag->value;
+          break;
+        case AST_KW_PLAN:
+          ctx->plan_tag_value = tag->value;
+          break;
+        case AST_KW_STEPS:
+          ctx->steps_tag_value = tag->value;
+          break;
+        case AST_KW_OF:
+          ctx->of_tag_value = tag->value;
+          break;
+        case AST_KW_BY:
+          ctx->by_tag_value = tag->value;
+          break;
         default:
           break;
         }
@@ -15,6 +15,15 @@ typedef struct {
   ast_node_t *take_tag_value;
   ast_node_t *cursor_tag_value;
   ast_node_t *key_tag_value;
+  ast_node_t *fields_tag_value; // list of string literals
+  ast_node_t *timeout_tag_value;
+  ast_node_t *sample_tag_value;
+  ast_node_t *view_tag_value;
+  ast_node_t *target_tag_value;
+  ast_node_t *plan_tag_value;  // `explain` or `profile`
+  ast_node_t *steps_tag_value; // expressions linked by `next`
+  ast_node_t *of_tag_value;
+  ast_node_t *by_tag_value; // string literals linked by `next`
 
   // --- A Single List for All Custom Tags ---
   ast_node_t *custom_tags_head;
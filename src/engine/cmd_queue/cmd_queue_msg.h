@@ -2,10 +2,14 @@
 #define CMD_queue_MSG_H
 
 #include "engine/cmd_context/cmd_context.h"
+#include "engine/watermark/watermark.h"
 #include <stdint.h>
 
 typedef struct cmd_queue_msg_s {
   cmd_ctx_t *command;
+  // Assigned as the event is queued, see watermark.h
+  uint32_t event_id;
+  wm_container_t *wm;
 } cmd_queue_msg_t;
 
 // Takes ownership of `command`
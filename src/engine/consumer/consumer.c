@@ -7,6 +7,7 @@
 #include "core/db.h"
 #include "core/ebr.h"
 #include "engine/consumer/consumer_cache_internal.h"
+#include "engine/consumer/consumer_counters.h"
 #include "engine/consumer/consumer_flush.h"
 #include "engine/container/container.h"
 #include "engine/container/container_types.h"
@@ -14,6 +15,7 @@
 #include "engine/op/op.h"
 #include "engine/op_queue/op_queue.h"
 #include "engine/op_queue/op_queue_msg.h"
+#include "engine/watermark/watermark.h"
 #include "lmdb.h"
 #include "log/log.h"
 #include "sched.h"
@@ -183,6 +185,11 @@ static void _process_bitmap_ops(consumer_t *consumer,
       dirty = true;
       msgs_processed++;
       break;
+    case OP_TYPE_OR:
+      bitmap_or_inplace(bm, msg->op->bm);
+      dirty = true;
+      msgs_processed++;
+      break;
     default:
       LOG_ACTION_ERROR(ACT_OP_REJECTED, "op_type=%d key=\"%s\"",
                        msg->op->op_type, batch_db_key->ser_db_key);
@@ -238,6 +245,37 @@ static void _process_bitmap_ops(consumer_t *consumer,
   }
 }
 
+// Sums the increments of a counter row, the writer adds them on flush
+static void _process_counter_ops(consumer_t *consumer,
+                                 consumer_process_result_t *result,
+                                 consumer_batch_db_key_t *batch_db_key) {
+  uint64_t delta = 0;
+  uint32_t msgs_processed = 0;
+  uint32_t msgs_failed = 0;
+  for (consumer_batch_msg_node_t *batch_node = batch_db_key->head; batch_node;
+       batch_node = batch_node->next) {
+    if (batch_node->msg->op->op_type != OP_TYPE_INCR) {
+      LOG_ACTION_ERROR(ACT_OP_REJECTED, "op_type=%d key=\"%s\"",
+                       batch_node->msg->op->op_type, batch_db_key->ser_db_key);
+      msgs_failed++;
+      continue;
+    }
+    delta += batch_node->msg->op->value;
+    msgs_processed++;
+  }
+
+  if (msgs_processed > 0 &&
+      !consumer_counters_add(&consumer->counters, batch_db_key->ser_db_key,
+                             &batch_db_key->head->msg->op->db_key, delta)) {
+    LOG_ACTION_ERROR(ACT_MEMORY_ALLOC_FAILED,
+                     "context=\"counter_add\" key=\"%s\"",
+                     batch_db_key->ser_db_key);
+    return _fail_all_batch_db_key_msgs(result, batch_db_key);
+  }
+  result->msgs_processed += msgs_processed;
+  result->msgs_failed += msgs_failed;
+}
+
 // Process all messages for a container
 static void _process_op_msgs(consumer_t *consumer, eng_container_t *dc,
                              consumer_batch_db_key_t *key, MDB_txn *txn,
@@ -245,6 +283,11 @@ static void _process_op_msgs(consumer_t *consumer, eng_container_t *dc,
   consumer_batch_msg_node_t *batch_node = key->head;
   bool was_cached;
 
+  // Counter rows are never cached
+  if (batch_node->msg->op->op_type == OP_TYPE_INCR) {
+    return _process_counter_ops(consumer, result, key);
+  }
+
   consumer_cache_entry_t *cache_entry = _get_or_Create_cache_entry(
       dc, &consumer->cache, key, batch_node->msg, txn, &was_cached);
   if (!cache_entry) {
@@ -366,6 +409,32 @@ static void _process_batches(consumer_t *consumer,
   }
 }
 
+// Deltas stay pending if they can't be enqueued, unlike bitmaps their
+// cached value is not a full copy of the row
+static void _flush_counters(consumer_t *c) {
+  if (c->counters.count < 1) {
+    return;
+  }
+  consumer_flush_result_t fr = consumer_counters_flush_prepare(&c->counters);
+  if (!fr.success || !fr.msg) {
+    LOG_ACTION_ERROR(ACT_FLUSH_FAILED, "context=\"counters\" err=\"%s\"",
+                     fr.err_msg);
+    return;
+  }
+  if (fr.entries_skipped > 0) {
+    LOG_ACTION_WARN(ACT_FLUSH_ENTRIES_SKIPPED, "context=\"counters\" count=%u",
+                    fr.entries_skipped);
+  }
+  if (!eng_writer_queue_enqueue(&c->config.writer->queue, fr.msg)) {
+    LOG_ACTION_ERROR(ACT_FLUSH_FAILED,
+                     "context=\"counters_enqueue\" entries_prepared=%u",
+                     fr.entries_prepared);
+    consumer_flush_clear_result(fr);
+    return;
+  }
+  consumer_counters_clear(&c->counters);
+}
+
 static void _flush_dirty(consumer_t *c) {
   uint32_t num_dirty_entries = c->cache.num_dirty_entries;
   if (num_dirty_entries < 1 || !c->cache.dirty_head) {
@@ -447,6 +516,7 @@ static void _consumer_thread_func(void *arg) {
   const uint32_t max_msgs =
       MAX_BATCH_SIZE_PER_OP_QUEUE * config->op_queue_consume_count;
   op_queue_msg_t *op_msgs[max_msgs];
+  uint32_t op_msg_queues[max_msgs]; // op queue of each message
   uint32_t op_msg_count = 0;
 
   while (!consumer->should_stop) {
@@ -466,6 +536,7 @@ static void _consumer_thread_func(void *arg) {
         }
 
         // Track this message for cleanup
+        op_msg_queues[op_msg_count] = op_queue_idx;
         op_msgs[op_msg_count++] = msg;
 
         const char *msg_key =
@@ -523,12 +594,18 @@ static void _consumer_thread_func(void *arg) {
     }
 
     for (uint32_t i = 0; i < op_msg_count; i++) {
+      // Batches are processed, so queries see the op
+      if (op_msgs[i]) {
+        watermark_op_applied(op_msgs[i]->wm, op_msgs[i]->worker_id,
+                             op_msg_queues[i]);
+      }
       op_queue_msg_free(op_msgs[i]);
     }
 
     if (cycle == config->flush_every_n) {
       cycle = 0;
       _flush_dirty(consumer);
+      _flush_counters(consumer);
       _reclamation();
 
       // Periodic stats
@@ -544,6 +621,7 @@ static void _consumer_thread_func(void *arg) {
 
   ebr_unregister();
   consumer_cache_destroy(&consumer->cache);
+  consumer_counters_clear(&consumer->counters);
 
   LOG_ACTION_INFO(ACT_THREAD_STOPPED, "thread_type=consumer total_cycles=%llu",
                   total_cycles);
@@ -565,6 +643,7 @@ consumer_result_t consumer_start(consumer_t *consumer,
   consumer->config = *config;
   consumer->should_stop = false;
   consumer->messages_processed = 0;
+  consumer->counters = (consumer_counters_t){0};
 
   if (uv_thread_create(&consumer->thread, _consumer_thread_func, consumer) !=
       0) {
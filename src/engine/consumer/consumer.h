@@ -7,6 +7,7 @@ sends messages to engine writer for persistence
 */
 
 #include "consumer_cache_internal.h"
+#include "engine/consumer/consumer_counters.h"
 #include "engine/engine_writer/engine_writer.h"
 #include "engine/op_queue/op_queue.h"
 #include "uv.h" // IWYU pragma: keep
@@ -28,6 +29,7 @@ typedef struct consumer_s {
   volatile bool should_stop;
   uint64_t messages_processed; // Stats
   consumer_cache_t cache;
+  consumer_counters_t counters; // Rollup deltas not yet flushed
 } consumer_t;
 
 typedef struct {
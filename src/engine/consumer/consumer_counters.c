@@ -0,0 +1,133 @@
+#include "consumer_counters.h"
+#include "engine/container/container.h"
+#include "engine/container/container_types.h"
+#include "engine/engine_writer/engine_writer_queue_msg.h"
+#include "engine/watermark/watermark.h"
+#include "uthash.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool _copy_db_key(eng_container_db_key_t *dst,
+                         const eng_container_db_key_t *src) {
+  *dst = *src;
+  dst->container_name = NULL;
+  if (src->container_name) {
+    dst->container_name = strdup(src->container_name);
+    if (!dst->container_name) {
+      return false;
+    }
+  }
+  if (src->db_key.type == DB_KEY_STRING) {
+    dst->db_key.key.s = strdup(src->db_key.key.s);
+    if (!dst->db_key.key.s) {
+      free(dst->container_name);
+      dst->container_name = NULL;
+      return false;
+    }
+  }
+  return true;
+}
+
+static void _free_counter(consumer_counter_t *c) {
+  container_free_db_key_contents(&c->db_key);
+  free(c->ser_db_key);
+  free(c);
+}
+
+bool consumer_counters_add(consumer_counters_t *counters,
+                           const char *ser_db_key,
+                           const eng_container_db_key_t *db_key, uint64_t n) {
+  if (!counters || !ser_db_key || !db_key) {
+    return false;
+  }
+  consumer_counter_t *c = NULL;
+  HASH_FIND_STR(counters->table, ser_db_key, c);
+  if (c) {
+    c->delta += n;
+    return true;
+  }
+
+  c = calloc(1, sizeof(consumer_counter_t));
+  if (!c) {
+    return false;
+  }
+  c->ser_db_key = strdup(ser_db_key);
+  if (!c->ser_db_key) {
+    free(c);
+    return false;
+  }
+  if (!_copy_db_key(&c->db_key, db_key)) {
+    free(c->ser_db_key);
+    free(c);
+    return false;
+  }
+  c->delta = n;
+  HASH_ADD_KEYPTR(hh, counters->table, c->ser_db_key, strlen(c->ser_db_key),
+                  c);
+  counters->count++;
+  return true;
+}
+
+consumer_flush_result_t
+consumer_counters_flush_prepare(consumer_counters_t *counters) {
+  if (!counters) {
+    return (consumer_flush_result_t){.success = false,
+                                     .err_msg = "Invalid counters"};
+  }
+  if (counters->count < 1) {
+    return (consumer_flush_result_t){.success = true, .msg = NULL};
+  }
+
+  eng_writer_msg_t *msg = malloc(sizeof(eng_writer_msg_t));
+  if (!msg) {
+    return (consumer_flush_result_t){
+        .success = false, .err_msg = "Failed to allocate writer message"};
+  }
+  msg->entries = calloc(counters->count, sizeof(eng_writer_entry_t));
+  if (!msg->entries) {
+    free(msg);
+    return (consumer_flush_result_t){
+        .success = false, .err_msg = "Failed to allocate entries array"};
+  }
+  msg->count = 0;
+  msg->worker_id = WATERMARK_NO_WORKER;
+  msg->wm = NULL;
+  uint32_t skipped = 0;
+
+  consumer_counter_t *c, *tmp;
+  HASH_ITER(hh, counters->table, c, tmp) {
+    eng_writer_entry_t *e = &msg->entries[msg->count];
+    uint64_t *delta = malloc(sizeof(uint64_t));
+    if (!delta || !_copy_db_key(&e->db_key, &c->db_key)) {
+      free(delta);
+      memset(e, 0, sizeof(eng_writer_entry_t));
+      skipped++;
+      continue;
+    }
+    *delta = c->delta;
+    e->value = delta;
+    e->value_size = sizeof(uint64_t);
+    e->write_condition = WRITE_COND_ADD_U64;
+    msg->count++;
+  }
+
+  return (consumer_flush_result_t){.success = true,
+                                   .msg = msg,
+                                   .entries_prepared = msg->count,
+                                   .entries_skipped = skipped};
+}
+
+void consumer_counters_clear(consumer_counters_t *counters) {
+  if (!counters) {
+    return;
+  }
+  consumer_counter_t *c, *tmp;
+  HASH_ITER(hh, counters->table, c, tmp) {
+    HASH_DEL(counters->table, c);
+    _free_counter(c);
+  }
+  counters->table = NULL;
+  counters->count = 0;
+}
@@ -0,0 +1,40 @@
+#ifndef consumer_counters_h
+#define consumer_counters_h
+
+/**
+Pending counter deltas of a consumer, see `rollup.h`.
+INCR ops of a row are summed here instead of being applied to a cached value,
+the writer adds the sums to the stored counts on flush. */
+
+#include "engine/consumer/consumer_flush.h"
+#include "engine/container/container_types.h"
+#include "uthash.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct consumer_counter_s {
+  UT_hash_handle hh;
+  char *ser_db_key;
+  eng_container_db_key_t db_key; // Owned copy
+  uint64_t delta;
+} consumer_counter_t;
+
+typedef struct {
+  consumer_counter_t *table; // uthash table by `ser_db_key`
+  uint32_t count;
+} consumer_counters_t;
+
+// Add `n` to the pending delta of the row `ser_db_key`
+bool consumer_counters_add(consumer_counters_t *counters,
+                           const char *ser_db_key,
+                           const eng_container_db_key_t *db_key, uint64_t n);
+
+// Prepare a writer message adding every pending delta (doesn't enqueue or
+// clear)
+consumer_flush_result_t
+consumer_counters_flush_prepare(consumer_counters_t *counters);
+
+// Drop all pending deltas, e.g. once they are enqueued
+void consumer_counters_clear(consumer_counters_t *counters);
+
+#endif
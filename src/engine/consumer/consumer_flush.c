@@ -4,6 +4,8 @@
 #include "engine/engine_writer/engine_writer_queue_msg.h"
 #include <stdatomic.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
 void consumer_flush_clear_result(consumer_flush_result_t fr) {
   eng_writer_queue_free_msg(fr.msg);
@@ -53,6 +55,38 @@ static bool _consumer_flush_prepare_entry(consumer_cache_entry_t *cache_entry,
   return true;
 }
 
+// Stats entry carrying the cardinality of an inverted index bitmap, written
+// in the same txn as the bitmap, see `tag_stats.h`
+static bool _consumer_flush_prepare_stats(consumer_cache_entry_t *cache_entry,
+                                          eng_writer_entry_t *writer_entry) {
+  consumer_cache_bitmap_t *cc_bm = atomic_load(&cache_entry->cc_bitmap);
+  uint64_t *card = malloc(sizeof(uint64_t));
+  if (!card) {
+    return false;
+  }
+  *card = bitmap_get_cardinality(cc_bm->bitmap);
+  writer_entry->value = card;
+  writer_entry->value_size = sizeof(uint64_t);
+  writer_entry->db_key = cache_entry->db_key;
+  writer_entry->db_key.usr_db_type = USR_DB_TAG_STATS;
+  writer_entry->db_key.container_name =
+      strdup(cache_entry->db_key.container_name);
+  writer_entry->db_key.db_key.key.s = strdup(cache_entry->db_key.db_key.key.s);
+  if (!writer_entry->db_key.container_name ||
+      !writer_entry->db_key.db_key.key.s) {
+    eng_writer_queue_free_msg_entry(writer_entry);
+    memset(writer_entry, 0, sizeof(eng_writer_entry_t));
+    return false;
+  }
+  return true;
+}
+
+static bool _has_stats(const consumer_cache_entry_t *cache_entry) {
+  return cache_entry->db_key.dc_type == CONTAINER_TYPE_USR &&
+         cache_entry->db_key.usr_db_type == USR_DB_INVERTED_EVENT_INDEX &&
+         cache_entry->db_key.db_key.type == DB_KEY_STRING;
+}
+
 consumer_flush_result_t
 consumer_flush_prepare(consumer_cache_entry_t *dirty_head,
                        uint32_t num_dirty_entries) {
@@ -74,7 +108,8 @@ consumer_flush_prepare(consumer_cache_entry_t *dirty_head,
         .success = false, .err_msg = "Failed to allocate writer message"};
   }
 
-  msg->entries = calloc(num_dirty_entries, sizeof(eng_writer_entry_t));
+  // Room for a stats entry per bitmap
+  msg->entries = calloc(2 * num_dirty_entries, sizeof(eng_writer_entry_t));
   if (!msg->entries) {
     free(msg);
     return (consumer_flush_result_t){
@@ -82,6 +117,9 @@ consumer_flush_prepare(consumer_cache_entry_t *dirty_head,
   }
 
   msg->count = 0;
+  msg->worker_id = WATERMARK_NO_WORKER;
+  msg->wm = NULL;
+  uint32_t prepared = 0;
   uint32_t skipped = 0;
 
   for (consumer_cache_entry_t *entry = dirty_head; entry;
@@ -92,10 +130,16 @@ consumer_flush_prepare(consumer_cache_entry_t *dirty_head,
       continue;
     }
     msg->count++;
+    prepared++;
+    // Stats are best effort, the bitmap is written without them
+    if (_has_stats(entry) &&
+        _consumer_flush_prepare_stats(entry, &msg->entries[msg->count])) {
+      msg->count++;
+    }
   }
 
   return (consumer_flush_result_t){.success = true,
                                    .msg = msg,
-                                   .entries_prepared = msg->count,
+                                   .entries_prepared = prepared,
                                    .entries_skipped = skipped};
 }
@@ -4,7 +4,9 @@
 #include "engine/container/container_types.h"
 #include "lmdb.h"
 #include "uv.h"
+#include <dirent.h>
 #include <errno.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -253,6 +255,17 @@ void container_release(eng_container_t *container) {
   }
 }
 
+void container_bump_commit_seq(eng_container_t *c) {
+  if (!c) {
+    return;
+  }
+  atomic_store(&c->commit_seq, cdb_next_commit_seq());
+}
+
+uint64_t container_get_commit_seq(eng_container_t *c) {
+  return c ? atomic_load(&c->commit_seq) : 0;
+}
+
 bool container_get_db_handle(eng_container_t *c, eng_container_db_key_t *db_key,
                              MDB_dbi *db_out) {
   if (!c || !db_key || !db_out) {
@@ -264,3 +277,57 @@ bool container_get_db_handle(eng_container_t *c, eng_container_db_key_t *db_key,
 void container_free_db_key_contents(eng_container_db_key_t *db_key) {
   cdb_free_db_key_contents(db_key);
 }
+
+bool container_publish_index(eng_container_t *c, const index_def_t *index_def,
+                             bool building) {
+  return cdb_publish_index(c, index_def, building);
+}
+
+bool container_list_user(char ***names_out, uint32_t *count_out) {
+  if (!g_container_state.initialized || !names_out || !count_out) {
+    return false;
+  }
+  DIR *dir = opendir(g_container_state.data_dir);
+  if (!dir) {
+    return false;
+  }
+
+  char **names = NULL;
+  uint32_t count = 0;
+  uint32_t cap = 0;
+  bool ok = true;
+  struct dirent *de;
+  while (ok && (de = readdir(dir)) != NULL) {
+    // `<name>.mdb`, skipping lock files and the system container
+    size_t len = strlen(de->d_name);
+    if (len <= 4 || strcmp(de->d_name + len - 4, ".mdb") != 0 ||
+        (len - 4 == strlen(SYS_CONTAINER_NAME) &&
+         strncmp(de->d_name, SYS_CONTAINER_NAME, len - 4) == 0)) {
+      continue;
+    }
+    if (count == cap) {
+      cap = cap ? cap * 2 : 8;
+      char **grown = realloc(names, cap * sizeof(char *));
+      if (!grown) {
+        ok = false;
+        break;
+      }
+      names = grown;
+    }
+    names[count] = strndup(de->d_name, len - 4);
+    ok = names[count] != NULL;
+    count += ok ? 1 : 0;
+  }
+  closedir(dir);
+
+  if (!ok) {
+    for (uint32_t i = 0; i < count; i++) {
+      free(names[i]);
+    }
+    free(names);
+    return false;
+  }
+  *names_out = names;
+  *count_out = count;
+  return true;
+}
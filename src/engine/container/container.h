@@ -42,6 +42,18 @@ container_result_t container_get_system(void);
  */
 void container_release(eng_container_t *container);
 
+/**
+ * Record a committed write txn on a container. Invalidates read cache entries
+ * tagged with the previous commit seq
+ */
+void container_bump_commit_seq(eng_container_t *c);
+
+/**
+ * Current commit seq of a container. Read it before opening a read txn that
+ * uses read cache entries
+ */
+uint64_t container_get_commit_seq(eng_container_t *c);
+
 /**
  * Get a database handle from a container
  */
@@ -53,4 +65,18 @@ bool container_get_db_handle(eng_container_t *c, eng_container_db_key_t *db_key,
  */
 void container_free_db_key_contents(eng_container_db_key_t *db_key);
 
+/**
+ * Make an index visible to the readers and writers of an open user
+ * container. A `building` index is written by new events but not queried.
+ * Callers serialize publishes on a container
+ */
+bool container_publish_index(eng_container_t *c, const index_def_t *index_def,
+                             bool building);
+
+/**
+ * Names of the user containers on disk, open or not. Caller frees each name
+ * and `*names_out`
+ */
+bool container_list_user(char ***names_out, uint32_t *count_out);
+
 #endif // CONTAINER_H
\ No newline at end of file
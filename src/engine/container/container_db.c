@@ -4,7 +4,10 @@
 #include "core/mmap_array.h"
 #include "engine/container/container_types.h"
 #include "engine/index/index.h"
+#include "engine/rollup/rollup.h"
+#include "engine/view/view.h"
 #include "lmdb.h"
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -13,6 +16,12 @@
 #include <string.h>
 #include <unistd.h>
 
+static _Atomic uint64_t g_commit_seq = 0;
+
+uint64_t cdb_next_commit_seq(void) {
+  return atomic_fetch_add(&g_commit_seq, 1) + 1;
+}
+
 static bool _is_new_container(const char *path) {
   if (access(path, F_OK) == 0) {
     // 0 = File exists
@@ -59,11 +68,23 @@ void container_close(eng_container_t *c) {
       if (c->data.usr->events_db)
         db_close(c->env, c->data.usr->events_db);
 
-      index_close_registry(c->env, &c->data.usr->key_to_index);
+      kh_key_index_t *key_to_index = atomic_load(&c->data.usr->key_to_index);
+      index_close_registry(c->env, &key_to_index);
+      for (uint32_t i = 0; i < c->data.usr->retired_index_count; i++) {
+        index_free_map(c->data.usr->retired_indexes[i]);
+      }
+      view_close_registry(&c->data.usr->views);
+      rollup_close_registry(&c->data.usr->rollups);
 
       if (c->data.usr->index_registry_local_db)
         db_close(c->env, c->data.usr->index_registry_local_db);
 
+      if (c->data.usr->tag_stats_db)
+        db_close(c->env, c->data.usr->tag_stats_db);
+
+      if (c->data.usr->rollup_db)
+        db_close(c->env, c->data.usr->rollup_db);
+
       mmap_array_close(&c->data.usr->event_to_entity_map);
       free(c->data.usr);
     } else {
@@ -101,6 +122,7 @@ eng_container_t *create_container_struct(eng_dc_type_t type) {
   c->env = NULL;
   c->name = NULL;
   c->type = type;
+  atomic_init(&c->commit_seq, cdb_next_commit_seq());
 
   if (type == CONTAINER_TYPE_USR) {
     c->data.usr = calloc(1, sizeof(eng_user_dc_t));
@@ -203,7 +225,13 @@ container_result_t open_user_container(const char *name, const char *data_dir,
   bool ir = db_open(c->env, USR_DB_INDEX_REGISTRY_LOCAL_NAME, false,
                     DB_DUP_NONE, &c->data.usr->index_registry_local_db);
 
-  if (!iei || !meta || !edb || !ir) {
+  bool ts = db_open(c->env, USR_DB_TAG_STATS_NAME, false, DB_DUP_NONE,
+                    &c->data.usr->tag_stats_db);
+
+  bool ru = db_open(c->env, USR_DB_ROLLUP_NAME, false, DB_DUP_NONE,
+                    &c->data.usr->rollup_db);
+
+  if (!iei || !meta || !edb || !ir || !ts || !ru) {
     container_close(c);
     result.error_code = CONTAINER_ERR_DB_OPEN;
     result.error_msg = "Failed to open one or more databases";
@@ -237,13 +265,31 @@ container_result_t open_user_container(const char *name, const char *data_dir,
     return result;
   }
 
+  kh_key_index_t *key_to_index = NULL;
   if (!index_open_registry(c->env, c->data.usr->index_registry_local_db,
-                           &c->data.usr->key_to_index)) {
+                           &key_to_index)) {
     container_close(c);
     result.error_code = CONTAINER_ERR_INDEX;
     result.error_msg = "Failed to initialize indexes";
     return result;
   }
+  atomic_store(&c->data.usr->key_to_index, key_to_index);
+
+  if (!view_open_registry(c->env, c->data.usr->user_dc_metadata_db,
+                          &c->data.usr->views)) {
+    container_close(c);
+    result.error_code = CONTAINER_ERR_DB_OPEN;
+    result.error_msg = "Failed to load views";
+    return result;
+  }
+
+  if (!rollup_open_registry(c->env, c->data.usr->user_dc_metadata_db,
+                            &c->data.usr->rollups)) {
+    container_close(c);
+    result.error_code = CONTAINER_ERR_DB_OPEN;
+    result.error_msg = "Failed to load rollups";
+    return result;
+  }
 
   result.success = true;
   result.container = c;
@@ -356,11 +402,18 @@ static bool _cdb_get_user_db_handle(eng_container_t *c,
   case USR_DB_INDEX_REGISTRY_LOCAL:
     *db_out = c->data.usr->index_registry_local_db;
     break;
+  case USR_DB_TAG_STATS:
+    *db_out = c->data.usr->tag_stats_db;
+    break;
+  case USR_DB_ROLLUP:
+    *db_out = c->data.usr->rollup_db;
+    break;
   case USR_DB_INDEX:
     if (db_key->index_key == NULL)
       return false;
     index_t ind = {0};
-    index_get(db_key->index_key, c->data.usr->key_to_index, &ind);
+    index_get(db_key->index_key, atomic_load(&c->data.usr->key_to_index),
+              &ind);
     *db_out = ind.index_db;
     break;
   default:
@@ -422,4 +475,27 @@ void cdb_free_db_key_contents(eng_container_db_key_t *db_key) {
       db_key->usr_db_type == USR_DB_INDEX && db_key->index_key) {
     free(db_key->index_key);
   }
-}
\ No newline at end of file
+}
+
+bool cdb_publish_index(eng_container_t *c, const index_def_t *index_def,
+                       bool building) {
+  if (!c || c->type != CONTAINER_TYPE_USR || !index_def) {
+    return false;
+  }
+  eng_user_dc_t *usr = c->data.usr;
+  size_t max_retired =
+      sizeof(usr->retired_indexes) / sizeof(usr->retired_indexes[0]);
+  if (usr->retired_index_count == max_retired) {
+    return false;
+  }
+  kh_key_index_t *cur = atomic_load(&usr->key_to_index);
+  kh_key_index_t *next = index_map_with(c->env, cur, index_def, building);
+  if (!next) {
+    return false;
+  }
+  atomic_store(&usr->key_to_index, next);
+  if (cur) {
+    usr->retired_indexes[usr->retired_index_count++] = cur;
+  }
+  return true;
+}
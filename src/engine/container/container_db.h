@@ -3,6 +3,7 @@
 
 #include "container_types.h"
 #include "lmdb.h"
+#include <stdint.h>
 
 void container_close(eng_container_t *c);
 
@@ -21,4 +22,10 @@ bool cdb_get_db_handle(eng_container_t *c, eng_container_db_key_t *db_key,
 
 void cdb_free_db_key_contents(eng_container_db_key_t *db_key);
 
+bool cdb_publish_index(eng_container_t *c, const index_def_t *index_def,
+                       bool building);
+
+// Next value of the global commit sequence
+uint64_t cdb_next_commit_seq(void);
+
 #endif
\ No newline at end of file
@@ -1,9 +1,12 @@
 #ifndef CONTAINER_TYPES_H
 #define CONTAINER_TYPES_H
 
+#include "core/data_constants.h"
 #include "core/db.h"
 #include "core/mmap_array.h"
 #include "engine/index/index.h"
+#include "engine/rollup/rollup.h"
+#include "engine/view/view.h"
 #include "lmdb.h"
 #include "uthash.h"
 #include "uv.h" // IWYU pragma: keep
@@ -32,6 +35,8 @@
 #define USR_DB_METADATA_NAME "user_dc_metadata_db"
 #define USR_DB_EVENTS_NAME "events_db"
 #define USR_DB_INDEX_REGISTRY_LOCAL_NAME "index_registry_local_db"
+#define USR_DB_TAG_STATS_NAME "tag_stats_db"
+#define USR_DB_ROLLUP_NAME "rollup_db"
 
 // ============================================================================
 // Constants - Metadata Keys & Initial Values
@@ -43,6 +48,15 @@
 #define USR_NEXT_EVENT_ID_KEY "next_event_id"
 #define USR_NEXT_EVENT_ID_INIT_VAL 1
 #define USR_ENTITIES_KEY "entities"
+// Prefix of per-entity event posting lists in the inverted event index
+#define USR_ENTITY_EVENTS_KEY_PREFIX "entity"
+// Prefix of materialized view results in the inverted event index, and of
+// view definitions in the metadata db
+#define USR_VIEW_KEY_PREFIX "view"
+// Prefix of BSI index slices in the inverted event index
+#define USR_BSI_KEY_PREFIX "bsi"
+// Prefix of rollup definitions in the metadata db
+#define USR_ROLLUP_KEY_PREFIX "rollup"
 
 // ============================================================================
 // Enums - Container & Database Types
@@ -63,6 +77,8 @@ typedef enum {
   USR_DB_METADATA,
   USR_DB_EVENTS,
   USR_DB_INDEX_REGISTRY_LOCAL,
+  USR_DB_TAG_STATS,
+  USR_DB_ROLLUP,
   USR_DB_INDEX,
   USR_DB_COUNT,
 } eng_dc_user_db_type_t;
@@ -121,7 +137,25 @@ typedef struct {
 
   MDB_dbi index_registry_local_db;
 
-  kh_key_index_t *key_to_index;
+  // Planner statistics, see `tag_stats.h`
+  MDB_dbi tag_stats_db;
+
+  // Rollup counters, see `rollup.h`
+  // Key: `<rollup id>|<bucket>|<values>`, Value: uint64_t count
+  MDB_dbi rollup_db;
+
+  // Replaced as a whole when an index is added while the container is open,
+  // see `container_publish_index`
+  _Atomic(kh_key_index_t *) key_to_index;
+  // Replaced maps, freed on close since readers may still hold them
+  kh_key_index_t *retired_indexes[2 * MAX_NUM_INDEXES];
+  uint32_t retired_index_count;
+
+  // Materialized views, replaced as a whole when one is added
+  _Atomic(view_set_t *) views;
+
+  // Rollup definitions, replaced as a whole when one is added
+  _Atomic(rollup_set_t *) rollups;
 } eng_user_dc_t;
 
 typedef struct container_cache_node_s container_cache_node_t;
@@ -139,6 +173,10 @@ typedef struct eng_container_s {
     eng_user_dc_t *usr;
   } data;
 
+  // Changes on every committed write txn. Drawn from a global sequence, so a
+  // reopened container never repeats a value
+  _Atomic uint64_t commit_seq;
+
   container_cache_node_t *_node; // internal use only
 } eng_container_t;
 
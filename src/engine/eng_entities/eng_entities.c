@@ -0,0 +1,116 @@
+#include "eng_entities.h"
+#include "core/bitmaps.h"
+#include "core/deadline.h"
+#include "core/mmap_array.h"
+#include "query/ast.h"
+#include "roaring.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// Events mapped between deadline checks, also the entity map lock span
+#define ENTITIES_CHUNK 1024
+
+static bitmap_t *_eval_and(ast_node_t *exp, eng_entities_leaf_fn leaf,
+                           void *arg, const char **err_out) {
+  ast_node_t *pos = exp->logical.left_operand;
+  ast_node_t *other = exp->logical.right_operand;
+  // The validator keeps NOT to one side
+  if (pos->type == AST_NOT_NODE) {
+    pos = other;
+    other = exp->logical.left_operand;
+  }
+  bool negated = other->type == AST_NOT_NODE;
+  if (negated) {
+    other = other->not_op.operand;
+  }
+
+  bitmap_t *result = eng_entities_eval(pos, leaf, arg, err_out);
+  if (!result || bitmap_is_empty(result)) {
+    return result;
+  }
+  bitmap_t *rhs = eng_entities_eval(other, leaf, arg, err_out);
+  if (!rhs) {
+    bitmap_free(result);
+    return NULL;
+  }
+  if (negated) {
+    bitmap_not_inplace(result, rhs);
+  } else {
+    bitmap_and_inplace(result, rhs);
+  }
+  bitmap_free(rhs);
+  return result;
+}
+
+bitmap_t *eng_entities_eval(ast_node_t *exp, eng_entities_leaf_fn leaf,
+                            void *arg, const char **err_out) {
+  switch (exp->type) {
+  case AST_LITERAL_NODE:
+    return leaf(exp->literal.string_value, NULL, arg, err_out);
+  case AST_TAG_NODE:
+    return leaf(exp->tag.custom_key, exp->tag.value->literal.string_value, arg,
+                err_out);
+  case AST_LOGICAL_NODE: {
+    if (exp->logical.op == AST_LOGIC_NODE_AND) {
+      return _eval_and(exp, leaf, arg, err_out);
+    }
+    bitmap_t *result =
+        eng_entities_eval(exp->logical.left_operand, leaf, arg, err_out);
+    if (!result) {
+      return NULL;
+    }
+    bitmap_t *rhs =
+        eng_entities_eval(exp->logical.right_operand, leaf, arg, err_out);
+    if (!rhs) {
+      bitmap_free(result);
+      return NULL;
+    }
+    bitmap_or_inplace(result, rhs);
+    bitmap_free(rhs);
+    return result;
+  }
+  default:
+    *err_out = "Invalid entity set";
+    return NULL;
+  }
+}
+
+bitmap_t *eng_entities_of_events(mmap_array_t *event_to_entity_map,
+                                 const bitmap_t *events,
+                                 const deadline_t *deadline,
+                                 const char **err_out) {
+  bitmap_t *entities = bitmap_create();
+  roaring_uint32_iterator_t *it = bitmap_iterator_create(events);
+  if (!entities || !it) {
+    bitmap_free(entities);
+    roaring_uint32_iterator_free(it);
+    *err_out = "OOM error mapping events to entities";
+    return NULL;
+  }
+
+  uint32_t ids[ENTITIES_CHUNK];
+  uint32_t n;
+  while ((n = roaring_uint32_iterator_read(it, ids, ENTITIES_CHUNK)) > 0) {
+    deadline_status_t ds = deadline_status(deadline);
+    if (ds != DEADLINE_OK) {
+      *err_out = deadline_err_msg(ds);
+      bitmap_free(entities);
+      entities = NULL;
+      break;
+    }
+    // Mapped in place, 0 if the event has no entity
+    mmap_array_read_lock(event_to_entity_map);
+    for (uint32_t i = 0; i < n; i++) {
+      uint32_t *ent = MMAP_ARRAY_GET_AS(event_to_entity_map, ids[i], uint32_t);
+      ids[i] = ent ? *ent : 0;
+    }
+    mmap_array_unlock(event_to_entity_map);
+    bitmap_add_many(entities, n, ids);
+  }
+  roaring_uint32_iterator_free(it);
+  if (entities) {
+    bitmap_remove(entities, 0);
+  }
+  return entities;
+}
@@ -0,0 +1,42 @@
+#ifndef ENG_ENTITIES_H
+#define ENG_ENTITIES_H
+
+#include "core/bitmaps.h"
+#include "core/deadline.h"
+#include "core/mmap_array.h"
+#include "query/ast.h"
+#include <stdbool.h>
+
+/**
+Entity set algebra for `ENTITIES`.
+Entity ids are global, so the entities of different containers combine like
+any bitmaps: `(day1 AND NOT day8)` is the entities with events in `day1` and
+none in `day8`. A container leaf is its `entities` bitmap, so the cost tracks
+the number of entities, not of events. A `<container>:<view>` leaf narrows
+the container to the entities of a materialized view's events. */
+
+/**
+ * Entities of one leaf, a bitmap the caller frees. `view` is NULL for all
+ * entities of `container`. Returns NULL and sets `err_out` on failure.
+ */
+typedef bitmap_t *(*eng_entities_leaf_fn)(const char *container,
+                                          const char *view, void *arg,
+                                          const char **err_out);
+
+/**
+ * Entities matching a validated `of:` expression. An AND whose left side
+ * is empty skips its right side.
+ */
+bitmap_t *eng_entities_eval(ast_node_t *exp, eng_entities_leaf_fn leaf,
+                            void *arg, const char **err_out);
+
+/**
+ * Entities of `events`, mapped through the event to entity map. Events
+ * without an entity are left out. `deadline` is optional.
+ */
+bitmap_t *eng_entities_of_events(mmap_array_t *event_to_entity_map,
+                                 const bitmap_t *events,
+                                 const deadline_t *deadline,
+                                 const char **err_out);
+
+#endif
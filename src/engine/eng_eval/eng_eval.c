@@ -1,22 +1,42 @@
 #include "eng_eval.h"
 #include "core/bitmaps.h"
+#include "core/data_constants.h"
 #include "core/db.h"
 #include "engine/consumer/consumer.h"
 #include "engine/consumer/consumer_cache.h"
 #include "engine/container/container.h"
 #include "engine/container/container_types.h"
+#include "engine/eng_fetch/eng_fetch.h"
 #include "engine/eng_key_format/eng_key_format.h"
+#include "engine/eng_sample/eng_sample.h"
+#include "engine/eng_scan/eng_scan.h"
 #include "engine/index/index.h"
+#include "engine/read_cache/read_cache.h"
 #include "engine/routing/routing.h"
+#include "engine/tag_stats/tag_stats.h"
+#include "engine/view/view.h"
 #include "lmdb.h"
 #include "query/ast.h"
 #include "uthash.h"
+#include <math.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #define MAX_EVAL_STACK 128
 
+// Max operands of one fused AND/OR node
+#define MAX_FUSED_OPERANDS MAX_EVAL_STACK
+
+// Index cursor steps between deadline checks
+#define DEADLINE_CHECK_STEPS 4096
+
+static eval_bitmap_t *_eval(ast_node_t *node, eval_ctx_t *ctx,
+                            eng_eval_result_t *result);
+
 // --- Internal Helpers ---
 
 static eval_bitmap_t *_store_intermediate_bitmap(eval_ctx_t *ctx, bitmap_t *bm,
@@ -32,9 +52,14 @@ static eval_bitmap_t *_store_intermediate_bitmap(eval_ctx_t *ctx, bitmap_t *bm,
            ->intermediate_bitmaps[ctx->state->intermediate_bitmaps_count++];
   ebm->bm = bm;
   ebm->own = own;
+  ebm->cached = false;
   return ebm;
 }
 
+static bool _is_mutable(const eval_bitmap_t *ebm) {
+  return ebm->own && !ebm->cached;
+}
+
 static eval_cache_entry_t *_check_eval_local_cache(eval_ctx_t *ctx,
                                                    const char *ser_db_key) {
   if (ctx->state->cache_head == NULL)
@@ -59,6 +84,7 @@ static eval_bitmap_t *_add_to_eval_local_cache(eval_ctx_t *ctx,
 
   eval_bitmap_t *ebm = &ctx->state->cache_bitmaps[entry_idx];
   ebm->own = own;
+  ebm->cached = true;
   ebm->bm = bm;
 
   entry->bm = ebm;
@@ -70,20 +96,14 @@ static eval_bitmap_t *_add_to_eval_local_cache(eval_ctx_t *ctx,
 
 // --- Data Fetching ---
 
-static eval_bitmap_t *_fetch_bitmap_data(eval_ctx_t *ctx,
-                                         eng_container_db_key_t *db_key) {
-  char ser_db_key[512];
-  if (!db_key_into(ser_db_key, sizeof(ser_db_key), db_key)) {
-    return NULL;
-  }
+// Latest bitmap of `db_key`, from the consumer cache, the shared read cache or
+// LMDB. `own_out` is set if the caller must free it, cached bitmaps are
+// borrowed. An absent key reads as an empty bitmap.
+static bitmap_t *_load_bitmap(eval_ctx_t *ctx, eng_container_db_key_t *db_key,
+                              const char *ser_db_key, bool *own_out) {
+  *own_out = false;
 
-  // 1. Check Local Eval Cache
-  eval_cache_entry_t *entry = _check_eval_local_cache(ctx, ser_db_key);
-  if (entry) {
-    return entry->bm;
-  }
-
-  // 2. Check Consumer Cache
+  // 1. Check Consumer Cache
   int consumer_idx =
       route_key_to_consumer(ser_db_key, ctx->config->op_queue_total_count,
                             ctx->config->op_queues_per_consumer);
@@ -94,13 +114,27 @@ static eval_bitmap_t *_fetch_bitmap_data(eval_ctx_t *ctx,
     if (cc) {
       const bitmap_t *cached_bm = consumer_cache_get_bm(cc, ser_db_key);
       if (cached_bm) {
+        eng_profile_read(ctx->config->profile, ENG_PROFILE_SRC_CONSUMER_CACHE,
+                         consumer_idx, 0);
         // We do not own this; it belongs to the cache
-        return _add_to_eval_local_cache(ctx, ser_db_key, (bitmap_t *)cached_bm,
-                                        false);
+        return (bitmap_t *)cached_bm;
       }
     }
   }
 
+  // 2. Check the shared read cache. Seq 0 means the caller did not read one
+  bool shared =
+      db_key->dc_type == CONTAINER_TYPE_USR && ctx->config->commit_seq != 0;
+  if (shared) {
+    const bitmap_t *read_bm =
+        read_cache_get(ser_db_key, ctx->config->commit_seq);
+    if (read_bm) {
+      eng_profile_read(ctx->config->profile, ENG_PROFILE_SRC_READ_CACHE, -1,
+                       0);
+      return (bitmap_t *)read_bm;
+    }
+  }
+
   // 3. Check LMDB
   db_get_result_t r;
   MDB_dbi dbi;
@@ -113,22 +147,53 @@ static eval_bitmap_t *_fetch_bitmap_data(eval_ctx_t *ctx,
                      ? ctx->config->sys_txn
                      : ctx->config->user_txn;
 
-  if (!db_get(dbi, txn, &db_key->db_key, &r)) {
+  // Read txns are held for the whole evaluation, so the value can be viewed
+  // in place instead of deserialized
+  if (!db_get_view(dbi, txn, &db_key->db_key, &r)) {
     return NULL;
   }
+  eng_profile_read(ctx->config->profile, ENG_PROFILE_SRC_LMDB, -1,
+                   r.status == DB_GET_OK ? r.value_len : 0);
 
   bitmap_t *bm = NULL;
   if (r.status == DB_GET_OK) {
-    bm = bitmap_deserialize(r.value, r.value_len);
+    if (shared) {
+      const bitmap_t *read_bm = read_cache_put(
+          ser_db_key, ctx->config->commit_seq, r.value, r.value_len);
+      if (read_bm) {
+        return (bitmap_t *)read_bm;
+      }
+    }
+    bm = bitmap_view(r.value, r.value_len);
   } else {
     bm = bitmap_create();
   }
 
+  // We own the view (not the pages behind it); the cache never mutates it
+  *own_out = bm != NULL;
+  return bm;
+}
+
+static eval_bitmap_t *_fetch_bitmap_data(eval_ctx_t *ctx,
+                                         eng_container_db_key_t *db_key) {
+  char ser_db_key[512];
+  if (!db_key_into(ser_db_key, sizeof(ser_db_key), db_key)) {
+    return NULL;
+  }
+
+  // Check Local Eval Cache first
+  eval_cache_entry_t *entry = _check_eval_local_cache(ctx, ser_db_key);
+  if (entry) {
+    eng_profile_read(ctx->config->profile, ENG_PROFILE_SRC_LOCAL_CACHE, -1, 0);
+    return entry->bm;
+  }
+
+  bool own = false;
+  bitmap_t *bm = _load_bitmap(ctx, db_key, ser_db_key, &own);
   if (!bm)
     return NULL;
 
-  // ownership is true because deserialize created a new object
-  return _add_to_eval_local_cache(ctx, ser_db_key, bm, true);
+  return _add_to_eval_local_cache(ctx, ser_db_key, bm, own);
 }
 
 static uint32_t _get_max_event_id(eval_ctx_t *ctx) {
@@ -174,8 +239,120 @@ static uint32_t _get_max_event_id(eval_ctx_t *ctx) {
   return max_id;
 }
 
+// Resolve external entity id to its int id. `found_out` is false if the
+// entity has never been seen.
+static bool _resolve_entity_id(eval_ctx_t *ctx, ast_literal_node_t *ent,
+                               uint32_t *ent_id_out, bool *found_out) {
+  *found_out = false;
+  if (!ctx->config->sys_container || !ctx->config->sys_txn) {
+    return false;
+  }
+
+  bool ent_is_str = ent->type == AST_LITERAL_STRING;
+  eng_container_db_key_t db_key;
+  db_key.dc_type = CONTAINER_TYPE_SYS;
+  db_key.container_name = SYS_CONTAINER_NAME;
+  db_key.sys_db_type =
+      ent_is_str ? SYS_DB_STR_TO_ENTITY_ID : SYS_DB_INT_TO_ENTITY_ID;
+  if (ent_is_str) {
+    db_key.db_key.type = DB_KEY_STRING;
+    db_key.db_key.key.s = ent->string_value;
+  } else {
+    db_key.db_key.type = DB_KEY_I64;
+    db_key.db_key.key.i64 = ent->number_value;
+  }
+
+  MDB_dbi dbi;
+  if (!container_get_db_handle(ctx->config->sys_container, &db_key, &dbi)) {
+    return false;
+  }
+
+  db_get_result_t r = {0};
+  if (!db_get(dbi, ctx->config->sys_txn, &db_key.db_key, &r)) {
+    return false;
+  }
+  if (r.status == DB_GET_OK && r.value_len == sizeof(uint32_t)) {
+    memcpy(ent_id_out, r.value, sizeof(uint32_t));
+    *found_out = true;
+  }
+  db_get_result_clear(&r);
+  return true;
+}
+
+// `entity:<id>` - read the entity's event posting list
+static eval_bitmap_t *_entity(ast_node_t *tag_node, eval_ctx_t *ctx,
+                              eng_eval_result_t *result) {
+  uint32_t ent_id = 0;
+  bool found = false;
+  if (!_resolve_entity_id(ctx, &tag_node->tag.value->literal, &ent_id,
+                          &found)) {
+    result->err_msg = "Failed to resolve entity";
+    return NULL;
+  }
+
+  if (!found) {
+    bitmap_t *empty = bitmap_create();
+    if (!empty)
+      return NULL;
+    return _store_intermediate_bitmap(ctx, empty, true);
+  }
+
+  char ent_key[128];
+  if (!entity_events_key_into(ent_key, sizeof(ent_key), ent_id)) {
+    result->err_msg = "Failed to format entity key";
+    return NULL;
+  }
+
+  eng_container_db_key_t db_key;
+  db_key.container_name = ctx->config->container->name;
+  db_key.usr_db_type = USR_DB_INVERTED_EVENT_INDEX;
+  db_key.dc_type = CONTAINER_TYPE_USR;
+  db_key.db_key.type = DB_KEY_STRING;
+  db_key.db_key.key.s = ent_key;
+
+  return _fetch_bitmap_data(ctx, &db_key);
+}
+
+// `view:<name>` - read the view's maintained result
+static eval_bitmap_t *_view(ast_node_t *tag_node, eval_ctx_t *ctx,
+                            eng_eval_result_t *result) {
+  const char *name = tag_node->tag.value->literal.string_value;
+  const view_set_t *views =
+      atomic_load(&ctx->config->container->data.usr->views);
+  if (!view_find(views, name)) {
+    result->err_msg = "View does not exist";
+    return NULL;
+  }
+
+  char view_key[MAX_TEXT_VAL_LEN];
+  if (!view_key_into(view_key, sizeof(view_key), name)) {
+    result->err_msg = "Failed to format view key";
+    return NULL;
+  }
+
+  eng_container_db_key_t db_key;
+  db_key.container_name = ctx->config->container->name;
+  db_key.usr_db_type = USR_DB_INVERTED_EVENT_INDEX;
+  db_key.dc_type = CONTAINER_TYPE_USR;
+  db_key.db_key.type = DB_KEY_STRING;
+  db_key.db_key.key.s = view_key;
+
+  return _fetch_bitmap_data(ctx, &db_key);
+}
+
 static eval_bitmap_t *_tag(ast_node_t *tag_node, eval_ctx_t *ctx,
                            eng_eval_result_t *result) {
+  if (tag_node->tag.key_type == AST_TAG_KEY_RESERVED) {
+    if (tag_node->tag.reserved_key == AST_KW_ENTITY) {
+      return _entity(tag_node, ctx, result);
+    }
+    if (tag_node->tag.reserved_key == AST_KW_VIEW) {
+      return _view(tag_node, ctx, result);
+    }
+    result->err_msg = "Unsupported reserved tag in expression";
+    return NULL;
+  }
+
   eng_container_db_key_t db_key;
   db_key.container_name = ctx->config->container->name;
   db_key.usr_db_type = USR_DB_INVERTED_EVENT_INDEX;
@@ -192,10 +369,51 @@ static eval_bitmap_t *_tag(ast_node_t *tag_node, eval_ctx_t *ctx,
   return _fetch_bitmap_data(ctx, &db_key);
 }
 
+// The sample over the whole id space, only for NOT and scans of every event
+static const bitmap_t *_get_sample(eval_ctx_t *ctx) {
+  if (!ctx->state->sample) {
+    ctx->state->sample =
+        eng_sample_bitmap(ctx->config->sample_pct, _get_max_event_id(ctx));
+  }
+  return ctx->state->sample;
+}
+
+// Restrict a leaf to the sample. Every operator keeps its result within the
+// sample as long as its leaves are, so the final result is the exact result
+// intersected with the sample. Costs the size of the leaf, not the id space.
+static eval_bitmap_t *_sampled(eval_bitmap_t *ebm, eval_ctx_t *ctx,
+                               eng_eval_result_t *result) {
+  if (!ebm || !ctx->config->sample_pct) {
+    return ebm;
+  }
+  uint32_t pct = ctx->config->sample_pct;
+  uint32_t last_event_id = _get_max_event_id(ctx);
+  if (_is_mutable(ebm)) {
+    if (!eng_sample_and_inplace(ebm->bm, pct, last_event_id)) {
+      result->err_msg = "Failed to build sample";
+      return NULL;
+    }
+    return ebm;
+  }
+  bitmap_t *bm = bitmap_copy(ebm->bm);
+  if (!bm || !eng_sample_and_inplace(bm, pct, last_event_id)) {
+    bitmap_free(bm);
+    result->err_msg = "Failed to build sample";
+    return NULL;
+  }
+  return _store_intermediate_bitmap(ctx, bm, true);
+}
+
 static eval_bitmap_t *_not(eval_bitmap_t *operand, eval_ctx_t *ctx,
                            eng_eval_result_t *result) {
-  uint32_t max_event_id = _get_max_event_id(ctx);
-  bitmap_t *r = bitmap_flip(operand->bm, 0, max_event_id);
+  bitmap_t *r = NULL;
+  if (ctx->config->sample_pct) {
+    // The sample is the universe
+    const bitmap_t *sample = _get_sample(ctx);
+    r = sample ? bitmap_not(sample, operand->bm) : NULL;
+  } else {
+    r = bitmap_flip(operand->bm, 0, _get_max_event_id(ctx));
+  }
   if (!r) {
     result->err_msg = "Failed to perform NOT operation";
     return NULL;
@@ -203,67 +421,172 @@ static eval_bitmap_t *_not(eval_bitmap_t *operand, eval_ctx_t *ctx,
   return _store_intermediate_bitmap(ctx, r, true);
 }
 
-static eval_bitmap_t *_and(eval_bitmap_t *left, eval_bitmap_t *right,
-                           eval_ctx_t *ctx, eng_eval_result_t *result) {
-  (void)result;
-  if (left->own) {
-    // We own Left, so we can mutate it in-place
-    bitmap_and_inplace(left->bm, right->bm);
-    return left;
-  }
-  if (right->own) {
-    // We own Right, so we can mutate it in-place
-    bitmap_and_inplace(right->bm, left->bm);
-    return right;
+// One end of a range over an index's key order
+typedef struct {
+  bool set;
+  bool inclusive;
+  int64_t num;     // I64 and F64 indexes
+  const char *str; // STR indexes
+} range_bound_t;
+
+typedef struct {
+  range_bound_t lo;
+  range_bound_t hi;
+  // `!=`: every key except the one held by both bounds
+  bool exclude;
+} index_range_t;
+
+static void _comparison_key_val(ast_comparison_node_t *comp, ast_node_t **key,
+                                ast_node_t **val) {
+  // With two strings the left one is the key, see the validator
+  if (comp->left->literal.type == AST_LITERAL_STRING) {
+    *key = comp->left;
+    *val = comp->right;
+  } else {
+    *key = comp->right;
+    *val = comp->left;
   }
-  bitmap_t *res_bm = bitmap_and(left->bm, right->bm);
-  if (!res_bm)
-    return NULL;
+}
 
-  return _store_intermediate_bitmap(ctx, res_bm, true);
+static bool _is_lower_bound_op(ast_comparison_op_t op) {
+  return op == AST_OP_GT || op == AST_OP_GTE;
 }
 
-static eval_bitmap_t *_or(eval_bitmap_t *left, eval_bitmap_t *right,
-                          eval_ctx_t *ctx, eng_eval_result_t *result) {
-  (void)result;
-  if (left->own) {
-    // We own Left, so we can mutate it in-place
-    bitmap_or_inplace(left->bm, right->bm);
-    return left;
-  }
-  if (right->own) {
-    // We own Right, so we can mutate it in-place
-    bitmap_or_inplace(right->bm, left->bm);
-    return right;
-  }
-  bitmap_t *res_bm = bitmap_or(left->bm, right->bm);
-  if (!res_bm)
-    return NULL;
+static bool _is_upper_bound_op(ast_comparison_op_t op) {
+  return op == AST_OP_LT || op == AST_OP_LTE;
+}
 
-  return _store_intermediate_bitmap(ctx, res_bm, true);
+// Key of a comparison value in an index of `type`. Decimals compared against
+// an I64 index are rounded toward the side that keeps the comparison exact:
+// `> 2.5` is `> 2`, `>= 2.5` is `>= 3`, `< 2.5` is `< 3`, `<= 2.5` is `<= 2`.
+static bool _bound_from_literal(const ast_literal_node_t *val,
+                                index_type_t type, ast_comparison_op_t op,
+                                range_bound_t *out, const char **err) {
+  out->set = true;
+  out->inclusive = op != AST_OP_GT && op != AST_OP_LT;
+  switch (type) {
+  case INDEX_TYPE_I64:
+  case INDEX_TYPE_BSI:
+    if (val->type == AST_LITERAL_NUMBER) {
+      out->num = val->number_value;
+      return true;
+    }
+    if (val->type == AST_LITERAL_FLOAT) {
+      bool round_down = op == AST_OP_GT || op == AST_OP_LTE;
+      double r = round_down ? floor(val->float_value) : ceil(val->float_value);
+      if (r >= 9.2e18) {
+        *err = "Comparison value out of range";
+        return false;
+      }
+      out->num = (int64_t)r;
+      return true;
+    }
+    break;
+  case INDEX_TYPE_F64:
+    if (val->type != AST_LITERAL_STRING) {
+      out->num = (int64_t)index_f64_key(val->type == AST_LITERAL_FLOAT
+                                            ? val->float_value
+                                            : (double)val->number_value);
+      return true;
+    }
+    break;
+  case INDEX_TYPE_STR:
+    if (val->type == AST_LITERAL_STRING) {
+      out->str = val->string_value;
+      return true;
+    }
+    break;
+  }
+  *err = "Comparison value does not match index type";
+  return false;
 }
 
-static eval_bitmap_t *_compare(ast_node_t *comparison_node, eval_ctx_t *ctx,
-                               eng_eval_result_t *result) {
+// Narrow `range` by one comparison
+static bool _apply_comparison(ast_comparison_node_t *comp, index_type_t type,
+                              index_range_t *range, const char **err) {
   ast_node_t *key, *val;
-  index_t index;
-  ast_comparison_node_t *comp_node = &comparison_node->comparison;
+  _comparison_key_val(comp, &key, &val);
+  (void)key;
+
+  range_bound_t bound = {0};
+  if (!_bound_from_literal(&val->literal, type, comp->op, &bound, err)) {
+    return false;
+  }
+  switch (comp->op) {
+  case AST_OP_GT:
+  case AST_OP_GTE:
+    range->lo = bound;
+    break;
+  case AST_OP_LT:
+  case AST_OP_LTE:
+    range->hi = bound;
+    break;
+  case AST_OP_EQ:
+  case AST_OP_NEQ: {
+    bool integer_keys = type == INDEX_TYPE_I64 || type == INDEX_TYPE_BSI;
+    bool integral = !integer_keys ||
+                    val->literal.type != AST_LITERAL_FLOAT ||
+                    floor(val->literal.float_value) ==
+                        val->literal.float_value;
+    if (comp->op == AST_OP_NEQ) {
+      // A decimal never equals an integer key, nothing is excluded
+      range->exclude = integral;
+      range->lo = range->hi = bound;
+      range->lo.set = range->hi.set = integral;
+    } else if (integral) {
+      range->lo = range->hi = bound;
+    } else {
+      // Empty: lo is above hi
+      range->lo = range->hi = bound;
+      range->lo.num = bound.num + 1;
+    }
+    break;
+  }
+  case AST_OP_CONTAINS:
+    // Only scans answer it, see `_is_scan`
+    *err = "Scans are disabled for this query";
+    return false;
+  }
+  return true;
+}
 
-  if (comp_node->left->literal.type == AST_LITERAL_STRING) {
-    key = comp_node->left;
-    val = comp_node->right;
+static void _bound_db_key(const range_bound_t *bound, index_type_t type,
+                          db_key_t *out) {
+  if (type == INDEX_TYPE_STR) {
+    out->type = DB_KEY_STRING;
+    out->key.s = (char *)bound->str;
   } else {
-    key = comp_node->right;
-    val = comp_node->left;
+    out->type = DB_KEY_I64;
+    out->key.i64 = bound->num;
   }
+}
 
-  if (!index_get(key->literal.string_value,
-                 ctx->config->container->data.usr->key_to_index, &index)) {
-    result->err_msg = "Index does not exist for tag key.";
-    return NULL;
+// Compare a cursor key against a bound in the index db's own key order
+static int _cmp_bound(MDB_txn *txn, MDB_dbi dbi, const db_cursor_entry_t *e,
+                      const range_bound_t *bound, index_type_t type) {
+  MDB_val a = {.mv_size = e->key_len, .mv_data = e->key};
+  MDB_val b;
+  if (type == INDEX_TYPE_STR) {
+    b.mv_size = strlen(bound->str);
+    b.mv_data = (void *)bound->str;
+  } else {
+    b.mv_size = sizeof(int64_t);
+    b.mv_data = (void *)&bound->num;
   }
+  return mdb_cmp(txn, dbi, &a, &b);
+}
 
-  MDB_cursor *cursor = db_cursor_open(ctx->config->user_txn, index.index_db);
+/**
+ * Bounded scan of an index: seek to the lower bound, then read each key's
+ * event ids a page at a time until the upper bound. Keys outside the range
+ * are never visited, apart from an excluded `!=` key.
+ */
+static eval_bitmap_t *_scan_index(const index_t *index,
+                                  const index_range_t *range, eval_ctx_t *ctx,
+                                  eng_eval_result_t *result) {
+  MDB_txn *txn = ctx->config->user_txn;
+  index_type_t type = index->index_def.type;
+  MDB_cursor *cursor = db_cursor_open(txn, index->index_db);
   if (!cursor) {
     return NULL;
   }
@@ -274,73 +597,84 @@ static eval_bitmap_t *_compare(ast_node_t *comparison_node, eval_ctx_t *ctx,
     return NULL;
   }
 
-  int64_t search_val = val->literal.number_value;
   db_cursor_entry_t entry;
   db_cursor_get_result_t r;
-
-  db_key_t db_key;
-  db_key.type = DB_KEY_I64;
-  db_key.key.i64 = search_val;
-
-  MDB_cursor_op scan_direction;
-  if (comp_node->op == AST_OP_GT || comp_node->op == AST_OP_GTE) {
-    scan_direction = MDB_NEXT;
+  // Cursor reads, for PROFILE
+  uint64_t cursor_steps = 1;
+  if (range->lo.set && !range->exclude) {
+    db_key_t lo_key;
+    _bound_db_key(&range->lo, type, &lo_key);
+    r = db_cursor_get(cursor, &entry, MDB_SET_RANGE, &lo_key);
   } else {
-    scan_direction = MDB_PREV;
+    r = db_cursor_get(cursor, &entry, MDB_FIRST, NULL);
   }
 
-  r = db_cursor_get(cursor, &entry, MDB_SET_RANGE, &db_key);
-
-  if (scan_direction == MDB_NEXT) {
-    if (r == DB_CURSOR_OK) {
-      int64_t found_key =
-          *(int64_t *)entry
-               .key; // If we want GT (>), and we landed on an exact match (==),
-      // we must step forward once to skip it.
-      if (comp_node->op == AST_OP_GT && found_key == search_val) {
-        r = db_cursor_get(cursor, &entry, MDB_NEXT, NULL);
+  deadline_status_t ds = DEADLINE_OK;
+  uint32_t steps = 0;
+  while (r == DB_CURSOR_OK) {
+    if (range->exclude) {
+      if (_cmp_bound(txn, index->index_db, &entry, &range->lo, type) == 0) {
+        r = db_cursor_get(cursor, &entry, MDB_NEXT_NODUP, NULL);
+        cursor_steps++;
+        continue;
       }
-    }
-    // If r == NOTFOUND, it means all keys are < search_val.
-    // Result is empty.
-  } else {
-    if (r == DB_CURSOR_NOTFOUND) {
-      // search_val is larger than any key in the DB.
-      // The "closest" value is the last item in the DB.
-      r = db_cursor_get(cursor, &entry, MDB_LAST, NULL);
-    } else if (r == DB_CURSOR_OK) {
-      int64_t found_key = *(int64_t *)entry.key;
-      // We landed on a key >= search_val.
-      if (found_key > search_val) {
-        // We landed on a larger neighbor. Step back to find the first
-        // key that is <= search_val.
-        r = db_cursor_get(cursor, &entry, MDB_PREV, NULL);
+    } else {
+      if (range->lo.set && !range->lo.inclusive &&
+          _cmp_bound(txn, index->index_db, &entry, &range->lo, type) == 0) {
+        r = db_cursor_get(cursor, &entry, MDB_NEXT_NODUP, NULL);
+        cursor_steps++;
+        continue;
       }
-
-      // Now, if r is OK, current key is <= search_val.
-      // If we specifically want LT (<) and we are currently on (==),
-      // we must step back one more time.
-      if (r == DB_CURSOR_OK) {
-        int64_t current_key = *(int64_t *)entry.key;
-        if (comp_node->op == AST_OP_LT && current_key == search_val) {
-          r = db_cursor_get(cursor, &entry, MDB_PREV, NULL);
+      if (range->hi.set) {
+        int c = _cmp_bound(txn, index->index_db, &entry, &range->hi, type);
+        if (c > 0 || (c == 0 && !range->hi.inclusive)) {
+          break;
         }
       }
     }
-  }
 
-  // At this point, 'entry' is valid and satisfies the condition,
-  // OR 'r' is not OK (empty result).
-  while (r == DB_CURSOR_OK) {
-    uint32_t index_val = *(uint32_t *)entry.value;
-    bitmap_add(event_id_bm, index_val);
+    // All event ids of this key, up to a page per read
+    db_cursor_entry_t page;
+    db_cursor_get_result_t pr =
+        db_cursor_get(cursor, &page, MDB_GET_MULTIPLE, NULL);
+    cursor_steps++;
+    if (pr == DB_CURSOR_OK && page.value_len == 0) {
+      // A key's only value is stored inline, not as a duplicate page
+      page.value = entry.value;
+      page.value_len = entry.value_len;
+    }
+    while (pr == DB_CURSOR_OK) {
+      bitmap_add_many(event_id_bm, page.value_len / sizeof(uint32_t),
+                      (const uint32_t *)page.value);
+      steps += page.value_len / sizeof(uint32_t);
+      pr = db_cursor_get(cursor, &page, MDB_NEXT_MULTIPLE, NULL);
+      cursor_steps++;
+    }
+    if (pr == DB_CURSOR_ERR) {
+      r = pr;
+      break;
+    }
+
+    if (steps >= DEADLINE_CHECK_STEPS) {
+      steps = 0;
+      ds = deadline_status(ctx->config->deadline);
+      if (ds != DEADLINE_OK) {
+        break;
+      }
+    }
 
-    // Just move in the determined direction until end/start of DB
-    r = db_cursor_get(cursor, &entry, scan_direction, NULL);
+    r = db_cursor_get(cursor, &entry, MDB_NEXT_NODUP, NULL);
+    cursor_steps++;
   }
 
   db_cursor_close(cursor);
+  eng_profile_steps(ctx->config->profile, cursor_steps);
 
+  if (ds != DEADLINE_OK) {
+    result->err_msg = deadline_err_msg(ds);
+    bitmap_free(event_id_bm);
+    return NULL;
+  }
   if (r == DB_CURSOR_ERR) {
     bitmap_free(event_id_bm);
     return NULL;
@@ -349,15 +683,718 @@ static eval_bitmap_t *_compare(ast_node_t *comparison_node, eval_ctx_t *ctx,
   return _store_intermediate_bitmap(ctx, event_id_bm, true);
 }
 
-static eval_bitmap_t *_eval(ast_node_t *node, eval_ctx_t *ctx,
-                            eng_eval_result_t *result) {
-  if (!node) {
-    result->err_msg = "Invalid node";
+// --- Bit-Sliced Indexes ---
+
+static bool _bsi_db_key(eval_ctx_t *ctx, const char *key, uint32_t slice,
+                        char *slice_key, size_t size,
+                        eng_container_db_key_t *db_key) {
+  db_key->container_name = ctx->config->container->name;
+  db_key->usr_db_type = USR_DB_INVERTED_EVENT_INDEX;
+  db_key->dc_type = CONTAINER_TYPE_USR;
+  db_key->db_key.type = DB_KEY_STRING;
+  db_key->db_key.key.s = slice_key;
+  return bsi_key_into(slice_key, size, key, slice);
+}
+
+// Events holding a value for the BSI index on `key`
+static eval_bitmap_t *_bsi_exists(eval_ctx_t *ctx, const char *key) {
+  char slice_key[MAX_TEXT_VAL_LEN];
+  eng_container_db_key_t db_key;
+  if (!_bsi_db_key(ctx, key, INDEX_BSI_EXISTS, slice_key, sizeof(slice_key),
+                   &db_key)) {
+    return NULL;
+  }
+  return _fetch_bitmap_data(ctx, &db_key);
+}
+
+// One bit slice, not kept in the local cache: each is read once per pass.
+// See `_load_bitmap` for `own_out`
+static bitmap_t *_bsi_slice(eval_ctx_t *ctx, const char *key, uint32_t slice,
+                            bool *own_out) {
+  char slice_key[MAX_TEXT_VAL_LEN];
+  char ser_db_key[512];
+  eng_container_db_key_t db_key;
+  if (!_bsi_db_key(ctx, key, slice, slice_key, sizeof(slice_key), &db_key) ||
+      !db_key_into(ser_db_key, sizeof(ser_db_key), &db_key)) {
+    return NULL;
+  }
+  return _load_bitmap(ctx, &db_key, ser_db_key, own_out);
+}
+
+/**
+ * Compare the values of the events in `eq` with `c`, from the highest bit
+ * down. Events whose value differs from `c` leave `eq` at the first differing
+ * bit, for `gt` or `lt` (both optional). `eq` ends as the events equal to `c`.
+ * At most one slice read and two bitmap operations per bit, whatever the
+ * range of values.
+ */
+static bool _bsi_split(eval_ctx_t *ctx, const char *key, uint64_t c,
+                       bitmap_t *eq, bitmap_t *gt, bitmap_t *lt) {
+  for (int i = INDEX_BSI_SLICES - 1; i >= 0 && !bitmap_is_empty(eq); i--) {
+    bool own = false;
+    bitmap_t *slice = _bsi_slice(ctx, key, (uint32_t)i, &own);
+    if (!slice) {
+      return false;
+    }
+    bool ok = true;
+    if (c & (1ULL << i)) {
+      if (lt) {
+        bitmap_t *below = bitmap_not(eq, slice);
+        ok = below != NULL;
+        bitmap_or_inplace(lt, below);
+        bitmap_free(below);
+      }
+      bitmap_and_inplace(eq, slice);
+    } else {
+      if (gt) {
+        bitmap_t *above = bitmap_and(eq, slice);
+        ok = above != NULL;
+        bitmap_or_inplace(gt, above);
+        bitmap_free(above);
+      }
+      bitmap_not_inplace(eq, slice);
+    }
+    if (own) {
+      bitmap_free(slice);
+    }
+    if (!ok) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Narrow `set` to the events on the kept side of `bound`. BSI values are
+// never negative
+static bool _bsi_apply_bound(eval_ctx_t *ctx, const char *key,
+                             const range_bound_t *bound, bool lower,
+                             bitmap_t **set) {
+  if (bound->num < 0) {
+    if (!lower) {
+      // Nothing is below a negative bound
+      bitmap_not_inplace(*set, *set);
+    }
+    return true;
+  }
+  bitmap_t *kept = bitmap_create();
+  if (!kept) {
+    return false;
+  }
+  bitmap_t *eq = *set;
+  if (!_bsi_split(ctx, key, (uint64_t)bound->num, eq, lower ? kept : NULL,
+                  lower ? NULL : kept)) {
+    bitmap_free(kept);
+    return false;
+  }
+  if (bound->inclusive) {
+    bitmap_or_inplace(kept, eq);
+  }
+  bitmap_free(eq);
+  *set = kept;
+  return true;
+}
+
+// Range read of a BSI index: a fixed number of slice operations per bound
+static eval_bitmap_t *_bsi_range(const index_t *index,
+                                 const index_range_t *range, eval_ctx_t *ctx,
+                                 eng_eval_result_t *result) {
+  const char *key = index->index_def.key;
+  eval_bitmap_t *exists = _bsi_exists(ctx, key);
+  if (!exists) {
+    return NULL;
+  }
+  bitmap_t *set = bitmap_copy(exists->bm);
+  if (!set) {
+    return NULL;
+  }
+
+  bool ok = true;
+  if (range->exclude) {
+    if (range->lo.num >= 0) {
+      bitmap_t *eq = bitmap_copy(set);
+      ok = eq && _bsi_split(ctx, key, (uint64_t)range->lo.num, eq, NULL, NULL);
+      if (ok) {
+        bitmap_not_inplace(set, eq);
+      }
+      bitmap_free(eq);
+    }
+  } else {
+    if (range->lo.set) {
+      ok = _bsi_apply_bound(ctx, key, &range->lo, true, &set);
+    }
+    if (ok && range->hi.set) {
+      ok = _bsi_apply_bound(ctx, key, &range->hi, false, &set);
+    }
+  }
+  if (!ok) {
+    bitmap_free(set);
+    result->err_msg = "Failed to read bit-sliced index";
+    return NULL;
+  }
+  return _store_intermediate_bitmap(ctx, set, true);
+}
+
+static bool _get_comparison_index(ast_comparison_node_t *comp,
+                                  eval_ctx_t *ctx, index_t *index_out,
+                                  eng_eval_result_t *result) {
+  ast_node_t *key, *val;
+  _comparison_key_val(comp, &key, &val);
+  kh_key_index_t *key_to_index =
+      atomic_load(&ctx->config->container->data.usr->key_to_index);
+  if (!index_get(key->literal.string_value, key_to_index, index_out)) {
+    result->err_msg = "Index does not exist for tag key.";
+    return false;
+  }
+  if (index_out->building) {
+    result->err_msg = "Index is still being built for tag key.";
+    return false;
+  }
+  return true;
+}
+
+// `comparisons` all have the same key, their ranges are intersected
+static eval_bitmap_t *_compare(ast_comparison_node_t **comparisons,
+                               uint32_t count, eval_ctx_t *ctx,
+                               eng_eval_result_t *result) {
+  index_t index;
+  if (!_get_comparison_index(comparisons[0], ctx, &index, result)) {
     return NULL;
   }
+  index_range_t range = {0};
+  for (uint32_t i = 0; i < count; i++) {
+    if (!_apply_comparison(comparisons[i], index.index_def.type, &range,
+                           &result->err_msg)) {
+      return NULL;
+    }
+  }
+  if (index.index_def.type == INDEX_TYPE_BSI) {
+    return _bsi_range(&index, &range, ctx, result);
+  }
+  return _scan_index(&index, &range, ctx, result);
+}
+
+// Comparisons no index answers, `~` and keys without a built index, scan the
+// event blobs instead when the query has a scan budget
+static bool _is_scan(ast_comparison_node_t *comp, eval_ctx_t *ctx) {
+  if (!ctx->config->scan_budget) {
+    return false;
+  }
+  if (comp->op == AST_OP_CONTAINS) {
+    return true;
+  }
+  index_t index;
+  eng_eval_result_t r = {0};
+  return !_get_comparison_index(comp, ctx, &index, &r);
+}
 
+// Every event id, within the sample when sampling. `own_out` is set if the
+// caller must free it
+static const bitmap_t *_universe(eval_ctx_t *ctx, bool *own_out) {
+  *own_out = false;
+  if (ctx->config->sample_pct) {
+    return _get_sample(ctx);
+  }
+  bitmap_t *none = bitmap_create();
+  if (!none) {
+    return NULL;
+  }
+  bitmap_t *all = bitmap_flip(none, 0, _get_max_event_id(ctx));
+  bitmap_free(none);
+  *own_out = all != NULL;
+  return all;
+}
+
+// `comparisons` all have the same key. Reads the blobs of the events in
+// `candidates`, or of every event if NULL, split across threads by id range
+static eval_bitmap_t *_scan(ast_comparison_node_t **comparisons,
+                            uint32_t count, const eval_bitmap_t *candidates,
+                            eval_ctx_t *ctx, eng_eval_result_t *result) {
+  eng_scan_filter_t filter = {.count = count};
+  for (uint32_t i = 0; i < count; i++) {
+    ast_node_t *key, *val;
+    _comparison_key_val(comparisons[i], &key, &val);
+    filter.key = key->literal.string_value;
+    filter.key_len = key->literal.string_value_len;
+    filter.preds[i].op = comparisons[i]->op;
+    filter.preds[i].val = &val->literal;
+  }
+
+  bool own = false;
+  const bitmap_t *cands = candidates ? candidates->bm : _universe(ctx, &own);
+  if (!cands) {
+    result->err_msg = "Failed to scan events";
+    return NULL;
+  }
+  uint32_t n = bitmap_get_cardinality(cands);
+  if (ctx->state->scanned + n > ctx->config->scan_budget) {
+    if (own) {
+      bitmap_free((bitmap_t *)cands);
+    }
+    result->err_msg = "Scan budget exceeded, index the key or narrow the query";
+    return NULL;
+  }
+  ctx->state->scanned += n;
+  eng_profile_steps(ctx->config->profile, n);
+
+  uint32_t *ids = malloc(((size_t)n + 1) * sizeof(uint32_t));
+  uint32_t *hits = malloc(((size_t)n + 1) * sizeof(uint32_t));
+  bitmap_t *bm = bitmap_create();
+  uint32_t num_hits = 0;
+  bool ok = ids && hits && bm;
+  if (ok) {
+    bitmap_to_uint32_array(cands, ids);
+    ok = eng_fetch_match(ctx->config->container->env, ctx->config->user_txn,
+                         ctx->config->container->data.usr->events_db, ids, n,
+                         eng_scan_match, &filter, ctx->config->deadline, hits,
+                         &num_hits);
+  }
+  if (ok) {
+    bitmap_add_many(bm, num_hits, hits);
+  }
+  free(ids);
+  free(hits);
+  if (own) {
+    bitmap_free((bitmap_t *)cands);
+  }
+  if (!ok) {
+    bitmap_free(bm);
+    deadline_status_t ds = deadline_status(ctx->config->deadline);
+    result->err_msg =
+        ds != DEADLINE_OK ? deadline_err_msg(ds) : "Failed to scan events";
+    return NULL;
+  }
+  return _store_intermediate_bitmap(ctx, bm, true);
+}
+
+// Flatten a chain of same-op logical nodes into its operands
+static bool _collect_operands(ast_node_t *node, ast_logical_node_op_t op,
+                              ast_node_t **out, uint32_t *count) {
+  if (node->type == AST_LOGICAL_NODE && node->logical.op == op) {
+    return _collect_operands(node->logical.left_operand, op, out, count) &&
+           _collect_operands(node->logical.right_operand, op, out, count);
+  }
+  if (*count >= MAX_FUSED_OPERANDS) {
+    return false;
+  }
+  out[(*count)++] = node;
+  return true;
+}
+
+// Insertion sort, operand counts are small
+static void _sort_by_cardinality(eval_bitmap_t **ops, uint32_t count) {
+  uint32_t cards[MAX_FUSED_OPERANDS];
+  for (uint32_t i = 0; i < count; i++) {
+    cards[i] = bitmap_get_cardinality(ops[i]->bm);
+  }
+  for (uint32_t i = 1; i < count; i++) {
+    eval_bitmap_t *op = ops[i];
+    uint32_t card = cards[i];
+    uint32_t j = i;
+    while (j > 0 && cards[j - 1] > card) {
+      ops[j] = ops[j - 1];
+      cards[j] = cards[j - 1];
+      j--;
+    }
+    ops[j] = op;
+    cards[j] = card;
+  }
+}
+
+// Index of a comparison after `i` bounding the same key from the other side,
+// or `count` if there is none
+static uint32_t _find_range_pair(ast_node_t **nodes, uint32_t count,
+                                 uint32_t i, const bool *fused) {
+  if (nodes[i]->type != AST_COMPARISON_NODE) {
+    return count;
+  }
+  ast_comparison_node_t *a = &nodes[i]->comparison;
+  bool a_lower = _is_lower_bound_op(a->op);
+  if (!a_lower && !_is_upper_bound_op(a->op)) {
+    return count;
+  }
+  ast_node_t *a_key, *a_val;
+  _comparison_key_val(a, &a_key, &a_val);
+
+  for (uint32_t j = i + 1; j < count; j++) {
+    if (fused[j] || nodes[j]->type != AST_COMPARISON_NODE) {
+      continue;
+    }
+    ast_comparison_node_t *b = &nodes[j]->comparison;
+    bool complements = a_lower ? _is_upper_bound_op(b->op)
+                               : _is_lower_bound_op(b->op);
+    ast_node_t *b_key, *b_val;
+    _comparison_key_val(b, &b_key, &b_val);
+    if (complements &&
+        strcmp(a_key->literal.string_value, b_key->literal.string_value) ==
+            0) {
+      return j;
+    }
+  }
+  return count;
+}
+
+// Matches of an AND operand according to the tag stats, UINT64_MAX if
+// unknown. Stats lag unflushed ops, so this only orders reads
+static uint64_t _estimate(ast_node_t *node, eval_ctx_t *ctx) {
+  if (node->type != AST_TAG_NODE) {
+    return UINT64_MAX;
+  }
+  char key[512];
+  bool formatted;
+  if (node->tag.key_type == AST_TAG_KEY_CUSTOM) {
+    formatted = custom_tag_into(key, sizeof(key), node);
+  } else if (node->tag.reserved_key == AST_KW_VIEW) {
+    formatted = view_key_into(key, sizeof(key),
+                              node->tag.value->literal.string_value);
+  } else {
+    return UINT64_MAX;
+  }
+  uint64_t card;
+  if (!formatted ||
+      !tag_stats_get_cardinality(ctx->config->user_txn,
+                                 ctx->config->container->data.usr->tag_stats_db,
+                                 key, &card)) {
+    return UINT64_MAX;
+  }
+  return card;
+}
+
+// Stable insertion sort of AND operands by estimated matches
+static void _order_by_estimate(ast_node_t **nodes, uint32_t count,
+                               eval_ctx_t *ctx) {
+  uint64_t est[MAX_FUSED_OPERANDS];
+  for (uint32_t i = 0; i < count; i++) {
+    est[i] = _estimate(nodes[i], ctx);
+  }
+  for (uint32_t i = 1; i < count; i++) {
+    ast_node_t *node = nodes[i];
+    uint64_t e = est[i];
+    uint32_t j = i;
+    while (j > 0 && est[j - 1] > e) {
+      nodes[j] = nodes[j - 1];
+      est[j] = est[j - 1];
+      j--;
+    }
+    nodes[j] = node;
+    est[j] = e;
+  }
+}
+
+// --- Plans ---
+
+static const char *_op_symbol(ast_comparison_op_t op) {
+  switch (op) {
+  case AST_OP_GT:
+    return ">";
+  case AST_OP_LT:
+    return "<";
+  case AST_OP_GTE:
+    return ">=";
+  case AST_OP_LTE:
+    return "<=";
+  case AST_OP_EQ:
+    return "=";
+  case AST_OP_NEQ:
+    return "!=";
+  case AST_OP_CONTAINS:
+    return "~";
+  }
+  return "?";
+}
+
+// `<key> <op> <value>`, decimals as written
+static void _comparison_label(ast_comparison_node_t *comp, char *buf,
+                              size_t size) {
+  ast_node_t *key, *val;
+  _comparison_key_val(comp, &key, &val);
+  if (val->literal.type == AST_LITERAL_NUMBER) {
+    snprintf(buf, size, "%s %s %lld", key->literal.string_value,
+             _op_symbol(comp->op), (long long)val->literal.number_value);
+  } else {
+    snprintf(buf, size, "%s %s %s", key->literal.string_value,
+             _op_symbol(comp->op), val->literal.string_value);
+  }
+}
+
+static void _tag_label(ast_node_t *node, char *buf, size_t size) {
+  if (node->tag.key_type == AST_TAG_KEY_CUSTOM) {
+    custom_tag_into(buf, size, node);
+    return;
+  }
+  const char *key = node->tag.reserved_key == AST_KW_VIEW ? "view" : "entity";
+  ast_literal_node_t *val = &node->tag.value->literal;
+  if (val->type == AST_LITERAL_NUMBER) {
+    snprintf(buf, size, "%s:%lld", key, (long long)val->number_value);
+  } else {
+    snprintf(buf, size, "%s:%s", key, val->string_value);
+  }
+}
+
+// How a comparison is read, NULL if it cannot be
+static const char *_index_access(ast_comparison_node_t *comp, eval_ctx_t *ctx) {
+  if (_is_scan(comp, ctx)) {
+    return "scan";
+  }
+  ast_node_t *key, *val;
+  _comparison_key_val(comp, &key, &val);
+  index_t index;
+  if (!index_get(key->literal.string_value,
+                 atomic_load(&ctx->config->container->data.usr->key_to_index),
+                 &index)) {
+    return NULL;
+  }
+  return index.index_def.type == INDEX_TYPE_BSI ? "bsi" : "index_scan";
+}
+
+// Open the profile node of `node`, -1 without a profile
+static int32_t _profile_enter(ast_node_t *node, eval_ctx_t *ctx) {
+  eng_profile_t *p = ctx->config->profile;
+  if (!p) {
+    return -1;
+  }
+  char label[ENG_PROFILE_LABEL_LEN] = "";
+  switch (node->type) {
+  case AST_NOT_NODE:
+    return eng_profile_enter(p, "not", NULL, NULL);
+  case AST_LOGICAL_NODE:
+    return eng_profile_enter(
+        p, node->logical.op == AST_LOGIC_NODE_AND ? "and" : "or", NULL, NULL);
+  case AST_TAG_NODE: {
+    // Before the node opens, so the stats read is not timed with it
+    uint64_t est = _estimate(node, ctx);
+    _tag_label(node, label, sizeof(label));
+    int32_t idx = eng_profile_enter(p, "tag", label, "bitmap");
+    if (est != UINT64_MAX) {
+      eng_profile_estimate(p, idx, est);
+    }
+    return idx;
+  }
+  case AST_COMPARISON_NODE:
+    _comparison_label(&node->comparison, label, sizeof(label));
+    return eng_profile_enter(p, "compare", label,
+                             _index_access(&node->comparison, ctx));
+  default:
+    return -1;
+  }
+}
+
+// Two comparisons read as one range
+static int32_t _profile_enter_range(ast_comparison_node_t **range,
+                                    eval_ctx_t *ctx) {
+  eng_profile_t *p = ctx->config->profile;
+  if (!p) {
+    return -1;
+  }
+  // Both halves and " AND " fit the label
+  char lo[(ENG_PROFILE_LABEL_LEN - 6) / 2];
+  char hi[(ENG_PROFILE_LABEL_LEN - 6) / 2];
+  char label[ENG_PROFILE_LABEL_LEN];
+  _comparison_label(range[0], lo, sizeof(lo));
+  _comparison_label(range[1], hi, sizeof(hi));
+  snprintf(label, sizeof(label), "%s AND %s", lo, hi);
+  return eng_profile_enter(p, "compare", label, _index_access(range[0], ctx));
+}
+
+static void _profile_exit(eval_ctx_t *ctx, int32_t idx,
+                          const eval_bitmap_t *ebm) {
+  if (ctx->config->profile) {
+    eng_profile_exit(ctx->config->profile, idx,
+                     ebm ? bitmap_get_cardinality(ebm->bm) : 0);
+  }
+}
+
+// Intersect the operands `_and` read, see there
+static eval_bitmap_t *_intersect(eval_bitmap_t **ops, uint32_t num_pos,
+                                 uint32_t num_neg, eval_ctx_t *ctx,
+                                 eng_eval_result_t *result) {
+  eval_bitmap_t **pos = ops;
+  eval_bitmap_t **neg = &ops[MAX_FUSED_OPERANDS - num_neg];
+
+  if (num_pos == 1 && num_neg == 0) {
+    return pos[0];
+  }
+
+  eval_bitmap_t *acc = NULL;
+  uint32_t next_pos = 1;
+  uint32_t next_neg = 0;
+
+  if (num_pos == 0) {
+    // Only negations: complement one, subtract the rest
+    acc = _not(neg[0], ctx, result);
+    next_neg = 1;
+  } else {
+    _sort_by_cardinality(pos, num_pos);
+    if (_is_mutable(pos[0])) {
+      acc = pos[0];
+    } else if (num_pos > 1) {
+      bitmap_t *bm = bitmap_and(pos[0]->bm, pos[1]->bm);
+      acc = bm ? _store_intermediate_bitmap(ctx, bm, true) : NULL;
+      next_pos = 2;
+    } else {
+      bitmap_t *bm = bitmap_not(pos[0]->bm, neg[0]->bm);
+      acc = bm ? _store_intermediate_bitmap(ctx, bm, true) : NULL;
+      next_neg = 1;
+    }
+  }
+  if (!acc) {
+    result->err_msg = "Failed to perform AND operation";
+    return NULL;
+  }
+
+  for (; next_pos < num_pos && !bitmap_is_empty(acc->bm); next_pos++) {
+    bitmap_and_inplace(acc->bm, pos[next_pos]->bm);
+  }
+  for (; next_neg < num_neg && !bitmap_is_empty(acc->bm); next_neg++) {
+    bitmap_not_inplace(acc->bm, neg[next_neg]->bm);
+  }
+  return acc;
+}
+
+// Comparison `i` of an AND, and its range pair if `pair` < `count`, as the
+// comparisons of one read
+static uint32_t _range_of(ast_node_t **nodes, uint32_t count, uint32_t i,
+                          uint32_t pair, ast_comparison_node_t **range) {
+  range[0] = &nodes[i]->comparison;
+  if (pair < count) {
+    range[1] = &nodes[pair]->comparison;
+    return 2;
+  }
+  return 1;
+}
+
+// Whether operand `i` of an AND, with its range pair, is scanned
+static bool _is_scan_operand(ast_node_t **nodes, uint32_t count, uint32_t i,
+                             uint32_t pair, eval_ctx_t *ctx) {
+  return (pair < count || nodes[i]->type == AST_COMPARISON_NODE) &&
+         _is_scan(&nodes[i]->comparison, ctx);
+}
+
+static int32_t _profile_enter_read(ast_node_t *node, uint32_t n,
+                                   ast_comparison_node_t **range,
+                                   eval_ctx_t *ctx) {
+  return n == 2 ? _profile_enter_range(range, ctx) : _profile_enter(node, ctx);
+}
+
+// N-ary AND. NOT operands are applied with ANDNOT instead of being flipped
+// against the universe. Positive operands are intersected smallest-first and
+// evaluation stops as soon as the result is empty. `k > a AND k < b` is read
+// as one bounded index scan. Tags are read smallest-first by their stats, so
+// an empty one spares reading the large ones. Comparisons no index answers
+// run last, scanning only the events the other operands left.
+static eval_bitmap_t *_and(ast_node_t **nodes, uint32_t count, eval_ctx_t *ctx,
+                           eng_eval_result_t *result) {
+  _order_by_estimate(nodes, count, ctx);
+  // Positive operands fill from the front, negated ones from the back
+  eval_bitmap_t *ops[MAX_FUSED_OPERANDS];
+  uint32_t num_pos = 0;
+  uint32_t num_neg = 0;
+  // Comparisons already read as part of a range
+  bool fused[MAX_FUSED_OPERANDS] = {false};
+  // Scanned operands and their range pairs, `count` if none
+  uint32_t scans[MAX_FUSED_OPERANDS];
+  uint32_t scan_pairs[MAX_FUSED_OPERANDS];
+  uint32_t num_scans = 0;
+
+  for (uint32_t i = 0; i < count; i++) {
+    if (fused[i]) {
+      continue;
+    }
+    bool negated = nodes[i]->type == AST_NOT_NODE;
+    eval_bitmap_t *ebm = NULL;
+    uint32_t pair = _find_range_pair(nodes, count, i, fused);
+    if (pair < count) {
+      fused[pair] = true;
+    }
+    if (_is_scan_operand(nodes, count, i, pair, ctx)) {
+      scans[num_scans] = i;
+      scan_pairs[num_scans++] = pair;
+      continue;
+    }
+    if (pair < count) {
+      ast_comparison_node_t *range[2];
+      _range_of(nodes, count, i, pair, range);
+      int32_t prof = _profile_enter_range(range, ctx);
+      ebm = _sampled(_compare(range, 2, ctx, result), ctx, result);
+      _profile_exit(ctx, prof, ebm);
+    } else if (negated) {
+      // The node's cardinality is the operand's, before it is subtracted
+      int32_t prof =
+          eng_profile_enter(ctx->config->profile, "andnot", NULL, NULL);
+      ebm = _eval(nodes[i]->not_op.operand, ctx, result);
+      _profile_exit(ctx, prof, ebm);
+    } else {
+      ebm = _eval(nodes[i], ctx, result);
+    }
+    if (!ebm)
+      return NULL;
+    if (negated) {
+      ops[MAX_FUSED_OPERANDS - 1 - num_neg++] = ebm;
+    } else if (bitmap_is_empty(ebm->bm)) {
+      // Empty AND anything is empty
+      return ebm;
+    } else {
+      ops[num_pos++] = ebm;
+    }
+  }
+
+  // NULL scans every event
+  eval_bitmap_t *acc = NULL;
+  if (num_pos > 0 || num_neg > 0) {
+    acc = _intersect(ops, num_pos, num_neg, ctx, result);
+    if (!acc) {
+      return NULL;
+    }
+  }
+  for (uint32_t s = 0; s < num_scans && !(acc && bitmap_is_empty(acc->bm));
+       s++) {
+    ast_comparison_node_t *range[2];
+    ast_node_t *node = nodes[scans[s]];
+    uint32_t n = _range_of(nodes, count, scans[s], scan_pairs[s], range);
+    int32_t prof = _profile_enter_read(node, n, range, ctx);
+    acc = _scan(range, n, acc, ctx, result);
+    _profile_exit(ctx, prof, acc);
+    if (!acc) {
+      return NULL;
+    }
+  }
+  return acc;
+}
+
+// N-ary OR as a single merge of all non-empty operands
+static eval_bitmap_t *_or(ast_node_t **nodes, uint32_t count, eval_ctx_t *ctx,
+                          eng_eval_result_t *result) {
+  const bitmap_t *bms[MAX_FUSED_OPERANDS];
+  eval_bitmap_t *last = NULL;
+  uint32_t n = 0;
+
+  for (uint32_t i = 0; i < count; i++) {
+    eval_bitmap_t *ebm = _eval(nodes[i], ctx, result);
+    if (!ebm)
+      return NULL;
+    if (!last || !bitmap_is_empty(ebm->bm)) {
+      last = ebm;
+    }
+    if (!bitmap_is_empty(ebm->bm)) {
+      bms[n++] = ebm->bm;
+    }
+  }
+
+  if (n <= 1) {
+    // Nothing to merge
+    return last;
+  }
+
+  bitmap_t *res_bm = bitmap_or_many(bms, n);
+  if (!res_bm) {
+    result->err_msg = "Failed to perform OR operation";
+    return NULL;
+  }
+  return _store_intermediate_bitmap(ctx, res_bm, true);
+}
+
+static eval_bitmap_t *_eval_node(ast_node_t *node, eval_ctx_t *ctx,
+                                 eng_eval_result_t *result) {
   eval_bitmap_t *op1 = NULL;
-  eval_bitmap_t *op2 = NULL;
 
   switch (node->type) {
   case AST_NOT_NODE:
@@ -366,31 +1403,165 @@ static eval_bitmap_t *_eval(ast_node_t *node, eval_ctx_t *ctx,
       return NULL;
     return _not(op1, ctx, result);
 
-  case AST_LOGICAL_NODE:
-    op1 = _eval(node->logical.left_operand, ctx, result);
-    if (!op1)
+  case AST_LOGICAL_NODE: {
+    ast_node_t *operands[MAX_FUSED_OPERANDS];
+    uint32_t count = 0;
+    if (!_collect_operands(node, node->logical.op, operands, &count)) {
+      result->err_msg = "Too many operands in expression";
       return NULL;
+    }
+    if (node->logical.op == AST_LOGIC_NODE_AND) {
+      return _and(operands, count, ctx, result);
+    }
+    return _or(operands, count, ctx, result);
+  }
 
-    op2 = _eval(node->logical.right_operand, ctx, result);
-    if (!op2)
-      return NULL;
+  case AST_TAG_NODE:
+    return _sampled(_tag(node, ctx, result), ctx, result);
+
+  case AST_COMPARISON_NODE: {
+    ast_comparison_node_t *comp = &node->comparison;
+    if (_is_scan(comp, ctx)) {
+      return _scan(&comp, 1, NULL, ctx, result);
+    }
+    return _sampled(_compare(&comp, 1, ctx, result), ctx, result);
+  }
+
+  default:
+    result->err_msg = "Invalid node type";
+    return NULL;
+  }
+}
+
+static eval_bitmap_t *_eval(ast_node_t *node, eval_ctx_t *ctx,
+                            eng_eval_result_t *result) {
+  if (!node) {
+    result->err_msg = "Invalid node";
+    return NULL;
+  }
+
+  deadline_status_t ds = deadline_status(ctx->config->deadline);
+  if (ds != DEADLINE_OK) {
+    result->err_msg = deadline_err_msg(ds);
+    return NULL;
+  }
+
+  int32_t prof = _profile_enter(node, ctx);
+  eval_bitmap_t *ebm = _eval_node(node, ctx, result);
+  _profile_exit(ctx, prof, ebm);
+  return ebm;
+}
+
+static bool _explain(ast_node_t *node, eval_ctx_t *ctx, const char **err);
 
+// Comparisons fail at evaluation without a built index, unless scanned
+static bool _explain_index(ast_comparison_node_t *comp, eval_ctx_t *ctx,
+                           const char **err) {
+  if (_is_scan(comp, ctx)) {
+    return true;
+  }
+  index_t index;
+  eng_eval_result_t r = {0};
+  if (!_get_comparison_index(comp, ctx, &index, &r)) {
+    *err = r.err_msg;
+    return false;
+  }
+  return true;
+}
+
+// Same order, fusing and deferred scans as `_and`. Operands are also sorted
+// by their actual cardinality once read, which a plan cannot show
+static bool _explain_and(ast_node_t **nodes, uint32_t count, eval_ctx_t *ctx,
+                         const char **err) {
+  eng_profile_t *p = ctx->config->profile;
+  _order_by_estimate(nodes, count, ctx);
+  bool fused[MAX_FUSED_OPERANDS] = {false};
+  uint32_t scans[MAX_FUSED_OPERANDS];
+  uint32_t scan_pairs[MAX_FUSED_OPERANDS];
+  uint32_t num_scans = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    if (fused[i]) {
+      continue;
+    }
+    bool ok;
+    uint32_t pair = _find_range_pair(nodes, count, i, fused);
+    if (pair < count) {
+      fused[pair] = true;
+    }
+    if (_is_scan_operand(nodes, count, i, pair, ctx)) {
+      scans[num_scans] = i;
+      scan_pairs[num_scans++] = pair;
+      continue;
+    }
+    if (pair < count) {
+      ast_comparison_node_t *range[2];
+      _range_of(nodes, count, i, pair, range);
+      ok = _explain_index(range[0], ctx, err);
+      eng_profile_exit(p, _profile_enter_range(range, ctx), 0);
+    } else if (nodes[i]->type == AST_NOT_NODE) {
+      int32_t prof = eng_profile_enter(p, "andnot", NULL, NULL);
+      ok = _explain(nodes[i]->not_op.operand, ctx, err);
+      eng_profile_exit(p, prof, 0);
+    } else {
+      ok = _explain(nodes[i], ctx, err);
+    }
+    if (!ok) {
+      return false;
+    }
+  }
+  for (uint32_t s = 0; s < num_scans; s++) {
+    ast_comparison_node_t *range[2];
+    ast_node_t *node = nodes[scans[s]];
+    uint32_t n = _range_of(nodes, count, scans[s], scan_pairs[s], range);
+    eng_profile_exit(p, _profile_enter_read(node, n, range, ctx), 0);
+  }
+  return true;
+}
+
+static bool _explain(ast_node_t *node, eval_ctx_t *ctx, const char **err) {
+  bool ok = true;
+  int32_t prof = -1;
+  switch (node->type) {
+  case AST_NOT_NODE:
+    prof = _profile_enter(node, ctx);
+    ok = _explain(node->not_op.operand, ctx, err);
+    break;
+
+  case AST_LOGICAL_NODE: {
+    ast_node_t *operands[MAX_FUSED_OPERANDS];
+    uint32_t count = 0;
+    if (!_collect_operands(node, node->logical.op, operands, &count)) {
+      *err = "Too many operands in expression";
+      return false;
+    }
+    prof = _profile_enter(node, ctx);
     if (node->logical.op == AST_LOGIC_NODE_AND) {
-      return _and(op1, op2, ctx, result);
+      ok = _explain_and(operands, count, ctx, err);
     } else {
-      return _or(op1, op2, ctx, result);
+      for (uint32_t i = 0; ok && i < count; i++) {
+        ok = _explain(operands[i], ctx, err);
+      }
     }
+    break;
+  }
 
   case AST_TAG_NODE:
-    return _tag(node, ctx, result);
+    prof = _profile_enter(node, ctx);
+    break;
 
   case AST_COMPARISON_NODE:
-    return _compare(node, ctx, result);
+    if (!_explain_index(&node->comparison, ctx, err)) {
+      return false;
+    }
+    prof = _profile_enter(node, ctx);
+    break;
 
   default:
-    result->err_msg = "Invalid node type";
-    return NULL;
+    *err = "Invalid node type";
+    return false;
   }
+  eng_profile_exit(ctx->config->profile, prof, 0);
+  return ok;
 }
 
 static void _cleanup_intermediate(eval_state_t *state,
@@ -422,9 +1593,9 @@ eng_eval_result_t eng_eval_resolve_exp_to_events(ast_node_t *exp,
     result.success = true;
 
     // If intermediate bitmap is owned, pass ownership to the result.
-    // If it's from cache (not owned), we MUST copy it so the result owns its
-    // own data.
-    if (ebm->own) {
+    // If it's from a cache (possibly a view over LMDB pages), we MUST copy it
+    // so the result owns its own, mutable data.
+    if (_is_mutable(ebm)) {
       result.events = ebm->bm;
       // Explicitly revoke ownership from the state (cache or intermediate
       // stack) so that subsequent cleanup calls do not double-free this
@@ -448,6 +1619,104 @@ eng_eval_result_t eng_eval_resolve_exp_to_events(ast_node_t *exp,
   return result;
 }
 
+bool eng_eval_explain(ast_node_t *exp, eval_ctx_t *ctx, const char **err_out) {
+  if (!exp || !ctx || !ctx->config || !ctx->config->profile || !err_out) {
+    return false;
+  }
+  *err_out = NULL;
+  if (!_explain(exp, ctx, err_out)) {
+    if (!*err_out) {
+      *err_out = "Failed to explain query";
+    }
+    return false;
+  }
+  return true;
+}
+
+bool eng_eval_bsi_agg(const char *key, bitmap_t *events, eval_ctx_t *ctx,
+                      eng_eval_agg_t *agg_out, const char **err_out) {
+  if (!key || !events || !ctx || !ctx->config || !agg_out || !err_out) {
+    return false;
+  }
+  memset(agg_out, 0, sizeof(eng_eval_agg_t));
+  *err_out = NULL;
+
+  index_t index;
+  kh_key_index_t *key_to_index =
+      atomic_load(&ctx->config->container->data.usr->key_to_index);
+  if (!index_get(key, key_to_index, &index) ||
+      index.index_def.type != INDEX_TYPE_BSI) {
+    *err_out = "Aggregates need a bsi index on the key";
+    return false;
+  }
+  if (index.building) {
+    *err_out = "Index is still being built for tag key.";
+    return false;
+  }
+
+  eval_bitmap_t *exists = _bsi_exists(ctx, key);
+  bitmap_t *set = exists ? bitmap_and(events, exists->bm) : NULL;
+  bitmap_t *min_set = set ? bitmap_copy(set) : NULL;
+  bitmap_t *max_set = set ? bitmap_copy(set) : NULL;
+  bool ok = min_set && max_set;
+  agg_out->count = bitmap_get_cardinality(set);
+
+  // Min and max narrow down from the highest bit: the min takes a 0 bit
+  // whenever some candidate has one, the max a 1 bit
+  for (int i = INDEX_BSI_SLICES - 1; ok && agg_out->count && i >= 0; i--) {
+    bool own = false;
+    bitmap_t *slice = _bsi_slice(ctx, key, (uint32_t)i, &own);
+    if (!slice) {
+      ok = false;
+      break;
+    }
+    uint64_t bit = 1ULL << i;
+    uint64_t ones = bitmap_and_cardinality(set, slice);
+    // Sums past UINT64_MAX are an error rather than wrapping around
+    uint64_t part;
+    if (__builtin_mul_overflow(ones, bit, &part) ||
+        __builtin_add_overflow(agg_out->sum, part, &agg_out->sum)) {
+      *err_out = "Sum out of range";
+      ok = false;
+    }
+
+    if (bitmap_and_cardinality(min_set, slice) <
+        bitmap_get_cardinality(min_set)) {
+      bitmap_not_inplace(min_set, slice);
+    } else {
+      agg_out->min |= bit;
+    }
+    if (bitmap_and_cardinality(max_set, slice) > 0) {
+      bitmap_and_inplace(max_set, slice);
+      agg_out->max |= bit;
+    }
+
+    if (own) {
+      bitmap_free(slice);
+    }
+  }
+
+  bitmap_free(set);
+  bitmap_free(min_set);
+  bitmap_free(max_set);
+  if (!ok && !*err_out) {
+    *err_out = "Failed to read bit-sliced index";
+  }
+  return ok;
+}
+
+bitmap_t *eng_eval_container_entities(eval_ctx_t *ctx) {
+  eng_container_db_key_t db_key;
+  db_key.container_name = ctx->config->container->name;
+  db_key.usr_db_type = USR_DB_METADATA;
+  db_key.dc_type = CONTAINER_TYPE_USR;
+  db_key.db_key.type = DB_KEY_STRING;
+  db_key.db_key.key.s = USR_ENTITIES_KEY;
+
+  eval_bitmap_t *ebm = _fetch_bitmap_data(ctx, &db_key);
+  return ebm ? bitmap_copy(ebm->bm) : NULL;
+}
+
 void eng_eval_cleanup_state(eval_state_t *state) {
   if (!state)
     return;
@@ -463,4 +1732,7 @@ void eng_eval_cleanup_state(eval_state_t *state) {
     free(entry->ser_db_key);
   }
   state->cache_entry_count = 0;
+
+  bitmap_free(state->sample);
+  state->sample = NULL;
 }
\ No newline at end of file
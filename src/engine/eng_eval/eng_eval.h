@@ -1,7 +1,9 @@
 #pragma once
 #include "core/bitmaps.h"
+#include "core/deadline.h"
 #include "engine/consumer/consumer.h"
 #include "engine/container/container_types.h"
+#include "engine/eng_profile/eng_profile.h"
 #include "lmdb.h"
 #include "query/ast.h"
 #include "uthash.h"
@@ -14,7 +16,8 @@ typedef struct eng_eval_result_s {
 
 typedef struct eval_bitmap_s {
   bitmap_t *bm;
-  bool own; // If true, we own and can mutate/free
+  bool own;    // If true, we own and can free
+  bool cached; // Shared through the local cache, never mutated
 } eval_bitmap_t;
 
 typedef struct eval_cache_entry_s {
@@ -26,11 +29,23 @@ typedef struct eval_cache_entry_s {
 // Immutable config
 typedef struct eval_config_s {
   eng_container_t *container;
+  eng_container_t *sys_container;
   MDB_txn *user_txn;
   MDB_txn *sys_txn;
   consumer_t *consumers;
   uint32_t op_queue_total_count;
   uint32_t op_queues_per_consumer;
+  // Container commit seq, read before `user_txn` was opened
+  uint64_t commit_seq;
+  // Optional, evaluation stops with an error once it passes
+  const deadline_t *deadline;
+  // Percent of event ids to evaluate (1-100), 0 evaluates all of them
+  uint32_t sample_pct;
+  // Optional, records the plan for EXPLAIN and PROFILE
+  eng_profile_t *profile;
+  // Event blobs the query may read for comparisons no index answers, 0
+  // fails those comparisons instead
+  uint32_t scan_budget;
 } eval_config_t;
 
 // Mutable state
@@ -46,6 +61,12 @@ typedef struct eval_state_s {
 
   unsigned int max_event_id;
   bool max_event_id_loaded;
+
+  // Sampled event ids, built on first use when `sample_pct` is set
+  bitmap_t *sample;
+
+  // Event blobs read so far, see `scan_budget`
+  uint64_t scanned;
 } eval_state_t;
 
 typedef struct eval_ctx_s {
@@ -57,5 +78,26 @@ typedef struct eval_ctx_s {
 eng_eval_result_t eng_eval_resolve_exp_to_events(ast_node_t *exp,
                                                  eval_ctx_t *ctx);
 
+// Record the plan `eng_eval_resolve_exp_to_events` would run into
+// `config->profile`, without reading any bitmap
+bool eng_eval_explain(ast_node_t *exp, eval_ctx_t *ctx, const char **err_out);
+
+// Aggregates over the values of a BSI index, see `eng_eval_bsi_agg`
+typedef struct eng_eval_agg_s {
+  uint64_t count; // events holding a value
+  uint64_t sum;
+  uint64_t min; // 0 when `count` is 0
+  uint64_t max;
+} eng_eval_agg_t;
+
+// SUM/MIN/MAX of the values `events` hold in the BSI index on `key`, read from
+// its slices without fetching events. Call before `eng_eval_cleanup_state`
+bool eng_eval_bsi_agg(const char *key, bitmap_t *events, eval_ctx_t *ctx,
+                      eng_eval_agg_t *agg_out, const char **err_out);
+
+// Entities holding events in the container, a copy the caller owns. Call
+// within an EBR section, like `eng_eval_resolve_exp_to_events`
+bitmap_t *eng_eval_container_entities(eval_ctx_t *ctx);
+
 // Call this when done with evaluations
 void eng_eval_cleanup_state(eval_state_t *state);
\ No newline at end of file
@@ -0,0 +1,400 @@
+#include "eng_fetch.h"
+#include "core/db.h"
+#include "engine/api.h"
+#include "engine/range_pool/range_pool.h"
+#include "lmdb.h"
+#include "mpack.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Gaps wider than this re-seek with MDB_SET_RANGE instead of stepping
+#define MAX_CURSOR_STEPS 16
+
+// Advise the kernel about the pages following the current value every
+// `PREFETCH_EVERY` events
+#define PREFETCH_BYTES (256 * 1024)
+#define PREFETCH_EVERY 32
+
+// Ids between deadline checks
+#define DEADLINE_CHECK_EVERY 256
+
+typedef struct fetch_range_s {
+  MDB_env *env;
+  MDB_txn *txn;
+  MDB_dbi db;
+  const uint32_t *ids;
+  uint32_t count;
+  api_obj_t *objs; // one slot per id, data is NULL if missing
+  const eng_fetch_fields_t *fields;
+  // Set to test blobs in place of copying them, see `eng_fetch_match`
+  eng_fetch_match_fn match;
+  const void *match_arg;
+  uint32_t *hits; // one slot per id
+  uint32_t num_hits;
+  const deadline_t *deadline;
+  uintptr_t page_mask;
+  bool ok;
+} fetch_range_t;
+
+static void _prefetch(fetch_range_t *fr, const void *addr) {
+  void *start = (void *)((uintptr_t)addr & fr->page_mask);
+  // Best effort, may fail near the end of the map
+  (void)madvise(start, PREFETCH_BYTES, MADV_WILLNEED);
+}
+
+static uint32_t _entry_key(const db_cursor_entry_t *entry) {
+  uint32_t k = 0;
+  memcpy(&k, entry->key, sizeof(uint32_t));
+  return k;
+}
+
+static bool _is_projected(const eng_fetch_fields_t *fields, const char *key,
+                          size_t len) {
+  if (len == 2 && (memcmp(key, "id", 2) == 0 || memcmp(key, "ts", 2) == 0)) {
+    return true;
+  }
+  for (uint32_t i = 0; i < fields->count; i++) {
+    if (fields->lens[i] == len && memcmp(fields->names[i], key, len) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Copy the projected key/value pairs of a msgpack map. Values are copied as
+// raw bytes, never re-encoded. Returns false if the blob is not a map with
+// string keys.
+static bool _project(const eng_fetch_fields_t *fields, const char *data,
+                     size_t size, api_obj_t *o) {
+  struct {
+    size_t off;
+    size_t len;
+  } spans[MAX_QUERY_FIELDS + 2];
+  uint32_t kept = 0;
+  size_t total = 0;
+  uint32_t max_kept = fields->count + 2;
+
+  mpack_reader_t reader;
+  mpack_reader_init_data(&reader, data, size);
+  uint32_t n = mpack_expect_map(&reader);
+
+  for (uint32_t i = 0; i < n && mpack_reader_error(&reader) == mpack_ok;
+       i++) {
+    size_t pair_start = size - mpack_reader_remaining(&reader, NULL);
+    uint32_t key_len = mpack_expect_str(&reader);
+    const char *key = mpack_read_bytes_inplace(&reader, key_len);
+    mpack_done_str(&reader);
+    bool keep = mpack_reader_error(&reader) == mpack_ok && kept < max_kept &&
+                _is_projected(fields, key, key_len);
+    mpack_discard(&reader);
+
+    if (keep && mpack_reader_error(&reader) == mpack_ok) {
+      size_t pair_end = size - mpack_reader_remaining(&reader, NULL);
+      spans[kept].off = pair_start;
+      spans[kept].len = pair_end - pair_start;
+      total += spans[kept].len;
+      kept++;
+    }
+  }
+  mpack_done_map(&reader);
+
+  if (mpack_reader_destroy(&reader) != mpack_ok) {
+    return false;
+  }
+
+  // kept <= MAX_QUERY_FIELDS + 2, so a fixmap or map16 header is enough
+  uint8_t header[3];
+  size_t header_len;
+  if (kept <= 15) {
+    header[0] = (uint8_t)(0x80 | kept);
+    header_len = 1;
+  } else {
+    header[0] = 0xde;
+    header[1] = (uint8_t)(kept >> 8);
+    header[2] = (uint8_t)(kept & 0xff);
+    header_len = 3;
+  }
+
+  o->data = malloc(header_len + total);
+  if (!o->data) {
+    return false;
+  }
+  memcpy(o->data, header, header_len);
+  size_t w = header_len;
+  for (uint32_t i = 0; i < kept; i++) {
+    memcpy(o->data + w, data + spans[i].off, spans[i].len);
+    w += spans[i].len;
+  }
+  o->data_size = w;
+  return true;
+}
+
+static bool _copy_value(fetch_range_t *fr, const db_cursor_entry_t *entry,
+                        api_obj_t *o) {
+  if (fr->fields && _project(fr->fields, entry->value, entry->value_len, o)) {
+    return true;
+  }
+  // No projection, or blob could not be decoded: return it whole
+  o->data = malloc(entry->value_len);
+  if (!o->data) {
+    return false;
+  }
+  memcpy(o->data, entry->value, entry->value_len);
+  o->data_size = entry->value_len;
+  return true;
+}
+
+static bool _fetch_range(fetch_range_t *fr) {
+  MDB_cursor *cursor = db_cursor_open(fr->txn, fr->db);
+  if (!cursor) {
+    return false;
+  }
+
+  db_cursor_entry_t entry;
+  db_cursor_get_result_t r = DB_CURSOR_NOTFOUND;
+  db_key_t seek_key = {.type = DB_KEY_U32, .key = {.u32 = 0}};
+  bool positioned = false;
+  uint32_t cur_key = 0;
+  uint32_t since_prefetch = PREFETCH_EVERY;
+  bool ok = true;
+
+  for (uint32_t i = 0; i < fr->count; i++) {
+    uint32_t id = fr->ids[i];
+
+    if ((i + 1) % DEADLINE_CHECK_EVERY == 0 &&
+        deadline_status(fr->deadline) != DEADLINE_OK) {
+      ok = false;
+      break;
+    }
+
+    // Cursor already moved past `id`: it is not in the db
+    if (positioned && cur_key > id) {
+      continue;
+    }
+
+    if (!positioned || id - cur_key > MAX_CURSOR_STEPS) {
+      seek_key.key.u32 = id;
+      r = db_cursor_get(cursor, &entry, MDB_SET_RANGE, &seek_key);
+      if (r == DB_CURSOR_OK) {
+        cur_key = _entry_key(&entry);
+      }
+    } else {
+      while (r == DB_CURSOR_OK && cur_key < id) {
+        r = db_cursor_get(cursor, &entry, MDB_NEXT, NULL);
+        if (r == DB_CURSOR_OK) {
+          cur_key = _entry_key(&entry);
+        }
+      }
+    }
+
+    if (r == DB_CURSOR_NOTFOUND) {
+      // Past the last event, remaining ids are not written yet
+      break;
+    }
+    if (r == DB_CURSOR_ERR) {
+      ok = false;
+      break;
+    }
+    positioned = true;
+
+    if (cur_key != id) {
+      continue;
+    }
+
+    if (fr->match) {
+      if (fr->match(fr->match_arg, entry.value, entry.value_len)) {
+        fr->hits[fr->num_hits++] = id;
+      }
+    } else {
+      api_obj_t *o = &fr->objs[i];
+      if (!_copy_value(fr, &entry, o)) {
+        ok = false;
+        break;
+      }
+      o->id = id;
+    }
+
+    if (++since_prefetch >= PREFETCH_EVERY) {
+      _prefetch(fr, entry.value);
+      since_prefetch = 0;
+    }
+  }
+
+  db_cursor_close(cursor);
+  return ok;
+}
+
+static void _release_range(fetch_range_t *fr) {
+  if (fr->match) {
+    fr->num_hits = 0;
+    return;
+  }
+  for (uint32_t i = 0; i < fr->count; i++) {
+    free(fr->objs[i].data);
+  }
+  memset(fr->objs, 0, fr->count * sizeof(api_obj_t));
+}
+
+// `arg` is the ranges of `_run_ranges`, each holding the caller's txn
+static void _fetch_range_part(void *arg, uint32_t part, bool on_caller) {
+  fetch_range_t *fr = (fetch_range_t *)arg + part;
+  if (on_caller) {
+    fr->ok = _fetch_range(fr);
+    return;
+  }
+  // LMDB read txns are bound to the thread that opened them
+  MDB_txn *caller_txn = fr->txn;
+  fr->txn = db_create_txn(fr->env, true);
+  if (fr->txn) {
+    fr->ok = _fetch_range(fr);
+    db_abort_txn(fr->txn);
+  } else {
+    fr->ok = false;
+  }
+  fr->txn = caller_txn;
+}
+
+static uint32_t _num_ranges(MDB_env *env, uint32_t count) {
+  uint32_t num_ranges = 1;
+  if (env && count >= ENG_FETCH_PARALLEL_MIN) {
+    num_ranges = count / (ENG_FETCH_PARALLEL_MIN / 2);
+    if (num_ranges > ENG_FETCH_MAX_THREADS) {
+      num_ranges = ENG_FETCH_MAX_THREADS;
+    }
+  }
+  return num_ranges;
+}
+
+// Split the ids of `all` into `num_ranges` consecutive ranges
+static void _split(const fetch_range_t *all, fetch_range_t *ranges,
+                   uint32_t num_ranges) {
+  long page_size = sysconf(_SC_PAGESIZE);
+  uintptr_t page_mask = ~((uintptr_t)(page_size > 0 ? page_size : 4096) - 1);
+  uint32_t per_range = all->count / num_ranges;
+
+  for (uint32_t i = 0; i < num_ranges; i++) {
+    uint32_t start = i * per_range;
+    fetch_range_t *fr = &ranges[i];
+    *fr = *all;
+    fr->txn = NULL;
+    fr->ids = all->ids + start;
+    fr->count = (i == num_ranges - 1) ? all->count - start : per_range;
+    fr->objs = all->objs ? all->objs + start : NULL;
+    fr->hits = all->hits ? all->hits + start : NULL;
+    fr->num_hits = 0;
+    fr->page_mask = page_mask;
+    fr->ok = false;
+  }
+}
+
+// Walk every range on the range pool, with `txn` on the calling thread. On
+// failure nothing is left allocated
+static bool _run_ranges(fetch_range_t *ranges, uint32_t num_ranges,
+                        MDB_txn *txn, const deadline_t *deadline) {
+  for (uint32_t i = 0; i < num_ranges; i++) {
+    ranges[i].txn = txn;
+  }
+  range_pool_run(_fetch_range_part, ranges, num_ranges);
+
+  bool ok = ranges[0].ok;
+  for (uint32_t i = 1; i < num_ranges; i++) {
+    if (!ranges[i].ok && deadline_status(deadline) == DEADLINE_OK) {
+      // A helper could not open a txn, fall back to the caller's
+      _release_range(&ranges[i]);
+      ranges[i].ok = _fetch_range(&ranges[i]);
+    }
+    ok = ok && ranges[i].ok;
+  }
+
+  if (!ok) {
+    for (uint32_t i = 0; i < num_ranges; i++) {
+      _release_range(&ranges[i]);
+    }
+  }
+  return ok;
+}
+
+bool eng_fetch_events(MDB_env *env, MDB_txn *txn, MDB_dbi events_db,
+                      const uint32_t *ids, uint32_t count,
+                      const eng_fetch_fields_t *fields,
+                      const deadline_t *deadline, api_obj_t *objs_out,
+                      uint32_t *found_out) {
+  if (!txn || !found_out || (count > 0 && (!ids || !objs_out))) {
+    return false;
+  }
+  *found_out = 0;
+  if (count == 0) {
+    return true;
+  }
+
+  memset(objs_out, 0, count * sizeof(api_obj_t));
+
+  fetch_range_t all = {.env = env,
+                       .db = events_db,
+                       .ids = ids,
+                       .count = count,
+                       .objs = objs_out,
+                       .fields = fields,
+                       .deadline = deadline};
+  fetch_range_t ranges[ENG_FETCH_MAX_THREADS];
+  uint32_t num_ranges = _num_ranges(env, count);
+  _split(&all, ranges, num_ranges);
+  if (!_run_ranges(ranges, num_ranges, txn, deadline)) {
+    return false;
+  }
+
+  // Compact, dropping ids that were not found
+  uint32_t found = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    if (objs_out[i].data) {
+      objs_out[found++] = objs_out[i];
+    }
+  }
+  memset(objs_out + found, 0, (count - found) * sizeof(api_obj_t));
+  *found_out = found;
+  return true;
+}
+
+bool eng_fetch_match(MDB_env *env, MDB_txn *txn, MDB_dbi events_db,
+                     const uint32_t *ids, uint32_t count,
+                     eng_fetch_match_fn match, const void *match_arg,
+                     const deadline_t *deadline, uint32_t *hits_out,
+                     uint32_t *num_hits_out) {
+  if (!txn || !match || !num_hits_out ||
+      (count > 0 && (!ids || !hits_out))) {
+    return false;
+  }
+  *num_hits_out = 0;
+  if (count == 0) {
+    return true;
+  }
+
+  fetch_range_t all = {.env = env,
+                       .db = events_db,
+                       .ids = ids,
+                       .count = count,
+                       .match = match,
+                       .match_arg = match_arg,
+                       .hits = hits_out,
+                       .deadline = deadline};
+  fetch_range_t ranges[ENG_FETCH_MAX_THREADS];
+  uint32_t num_ranges = _num_ranges(env, count);
+  _split(&all, ranges, num_ranges);
+  if (!_run_ranges(ranges, num_ranges, txn, deadline)) {
+    return false;
+  }
+
+  // Ranges hold their hits at their own start, in id order
+  uint32_t n = 0;
+  for (uint32_t i = 0; i < num_ranges; i++) {
+    memmove(hits_out + n, ranges[i].hits,
+            ranges[i].num_hits * sizeof(uint32_t));
+    n += ranges[i].num_hits;
+  }
+  *num_hits_out = n;
+  return true;
+}
@@ -0,0 +1,67 @@
+#ifndef ENG_FETCH_H
+#define ENG_FETCH_H
+
+#include "core/data_constants.h"
+#include "core/deadline.h"
+#include "engine/api.h"
+#include "lmdb.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Result sets at least this large are split by ID range and walked on the
+// range pool, see range_pool.h
+#define ENG_FETCH_PARALLEL_MIN 2048
+#define ENG_FETCH_MAX_THREADS 4
+
+// Optional projection. Only these top-level keys, plus `id` and `ts`, are
+// kept from each event blob.
+typedef struct eng_fetch_fields_s {
+  const char *names[MAX_QUERY_FIELDS];
+  size_t lens[MAX_QUERY_FIELDS];
+  uint32_t count;
+} eng_fetch_fields_t;
+
+// Tests one event blob, straight from its LMDB page. Called from several
+// threads at once
+typedef bool (*eng_fetch_match_fn)(const void *arg, const char *data,
+                                   size_t size);
+
+/**
+ * Fetch event blobs for `ids` from `events_db`.
+ *
+ * `ids` must be sorted ascending (e.g. from `bitmap_to_uint32_array`). The
+ * events db is walked forward with a single cursor instead of one B-tree
+ * descent per id, and upcoming pages are prefetched.
+ *
+ * Found events are written in order to `objs_out` (capacity >= `count`), each
+ * with a malloc'd copy of its blob. Ids that are not (yet) in the db are
+ * skipped. `txn` is used for the calling thread; range pool helpers open
+ * their own read txns on `env`.
+ *
+ * `fields`: Optional. If set, each blob is decoded once, straight from the
+ * LMDB page, and only the projected key/value pairs are copied out.
+ *
+ * `deadline`: Optional. Checked every few hundred ids; once it passes, the
+ * fetch stops and returns false.
+ */
+bool eng_fetch_events(MDB_env *env, MDB_txn *txn, MDB_dbi events_db,
+                      const uint32_t *ids, uint32_t count,
+                      const eng_fetch_fields_t *fields,
+                      const deadline_t *deadline, api_obj_t *objs_out,
+                      uint32_t *found_out);
+
+/**
+ * Ids of the events among `ids` whose blobs `match`, e.g. `eng_scan_match`.
+ * Walked and split across threads like `eng_fetch_events`, without copying
+ * any blob.
+ *
+ * Matching ids are written in order to `hits_out` (capacity >= `count`).
+ */
+bool eng_fetch_match(MDB_env *env, MDB_txn *txn, MDB_dbi events_db,
+                     const uint32_t *ids, uint32_t count,
+                     eng_fetch_match_fn match, const void *match_arg,
+                     const deadline_t *deadline, uint32_t *hits_out,
+                     uint32_t *num_hits_out);
+
+#endif
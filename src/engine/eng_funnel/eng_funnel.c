@@ -0,0 +1,373 @@
+#include "eng_funnel.h"
+#include "core/bitmaps.h"
+#include "core/data_constants.h"
+#include "core/db.h"
+#include "core/deadline.h"
+#include "core/mmap_array.h"
+#include "engine/range_pool/range_pool.h"
+#include "khash.h"
+#include "lmdb.h"
+#include "mpack.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Events handled between deadline checks, also the entity map lock span
+#define FUNNEL_CHUNK 4096
+
+// Gaps wider than this re-seek with MDB_SET_RANGE instead of stepping
+#define MAX_CURSOR_STEPS 16
+
+// Step not reached
+#define NO_START INT64_MIN
+
+// Entity id -> slot of its state in `funnel_part_t.starts`
+KHASH_MAP_INIT_INT(funnel_ent, uint32_t)
+
+// --- Load ---
+
+// `ts` of an event blob
+static bool _blob_ts(const char *data, size_t size, int64_t *ts_out) {
+  mpack_reader_t reader;
+  mpack_reader_init_data(&reader, data, size);
+  uint32_t n = mpack_expect_map(&reader);
+  bool found = false;
+  for (uint32_t i = 0; i < n && mpack_reader_error(&reader) == mpack_ok;
+       i++) {
+    uint32_t key_len = mpack_expect_str(&reader);
+    const char *key = mpack_read_bytes_inplace(&reader, key_len);
+    mpack_done_str(&reader);
+    if (!found && mpack_reader_error(&reader) == mpack_ok && key_len == 2 &&
+        memcmp(key, "ts", 2) == 0) {
+      *ts_out = mpack_expect_i64(&reader);
+      found = true;
+    } else {
+      mpack_discard(&reader);
+    }
+  }
+  mpack_done_map(&reader);
+  return mpack_reader_destroy(&reader) == mpack_ok && found;
+}
+
+// Entity of each id, 0 if unknown
+static void _load_entities(mmap_array_t *map, const uint32_t *ids,
+                           uint32_t count, uint32_t *entities_out) {
+  for (uint32_t start = 0; start < count; start += FUNNEL_CHUNK) {
+    uint32_t end = count - start > FUNNEL_CHUNK ? start + FUNNEL_CHUNK : count;
+    mmap_array_read_lock(map);
+    for (uint32_t i = start; i < end; i++) {
+      uint32_t *ent = MMAP_ARRAY_GET_AS(map, ids[i], uint32_t);
+      entities_out[i] = ent ? *ent : 0;
+    }
+    mmap_array_unlock(map);
+  }
+}
+
+static uint32_t _step_mask(const eng_funnel_load_args_t *args, uint32_t id) {
+  uint32_t mask = 0;
+  for (uint32_t s = 0; s < args->num_steps; s++) {
+    if (bitmap_contains(args->steps[s], id)) {
+      mask |= 1u << s;
+    }
+  }
+  return mask;
+}
+
+static uint32_t _entry_key(const db_cursor_entry_t *entry) {
+  uint32_t k = 0;
+  memcpy(&k, entry->key, sizeof(uint32_t));
+  return k;
+}
+
+// Walks the events db forward over `ids`, keeping the events it holds
+static bool _load_events(const eng_funnel_load_args_t *args,
+                         const uint32_t *ids, const uint32_t *entities,
+                         uint32_t count, eng_funnel_event_t *events_out,
+                         uint32_t *found_out, const char **err_out) {
+  MDB_cursor *cursor = db_cursor_open(args->txn, args->events_db);
+  if (!cursor) {
+    *err_out = "Error reading events";
+    return false;
+  }
+
+  db_cursor_entry_t entry;
+  db_cursor_get_result_t r = DB_CURSOR_NOTFOUND;
+  db_key_t seek_key = {.type = DB_KEY_U32, .key = {.u32 = 0}};
+  bool positioned = false;
+  uint32_t cur_key = 0;
+  uint32_t found = 0;
+  bool ok = true;
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t id = ids[i];
+    if ((i + 1) % FUNNEL_CHUNK == 0) {
+      deadline_status_t ds = deadline_status(args->deadline);
+      if (ds != DEADLINE_OK) {
+        *err_out = deadline_err_msg(ds);
+        ok = false;
+        break;
+      }
+    }
+    if (entities[i] == 0 || (positioned && cur_key > id)) {
+      continue;
+    }
+
+    if (!positioned || id - cur_key > MAX_CURSOR_STEPS) {
+      seek_key.key.u32 = id;
+      r = db_cursor_get(cursor, &entry, MDB_SET_RANGE, &seek_key);
+    } else {
+      while (r == DB_CURSOR_OK && cur_key < id) {
+        r = db_cursor_get(cursor, &entry, MDB_NEXT, NULL);
+        if (r == DB_CURSOR_OK) {
+          cur_key = _entry_key(&entry);
+        }
+      }
+    }
+    if (r == DB_CURSOR_NOTFOUND) {
+      // Past the last flushed event
+      break;
+    }
+    if (r == DB_CURSOR_ERR) {
+      *err_out = "Error reading events";
+      ok = false;
+      break;
+    }
+    cur_key = _entry_key(&entry);
+    positioned = true;
+
+    int64_t ts;
+    if (cur_key != id || !_blob_ts(entry.value, entry.value_len, &ts)) {
+      continue;
+    }
+    events_out[found].entity_id = entities[i];
+    events_out[found].step_mask = _step_mask(args, id);
+    events_out[found].ts = ts;
+    found++;
+  }
+  db_cursor_close(cursor);
+  *found_out = found;
+  return ok;
+}
+
+bool eng_funnel_load(const eng_funnel_load_args_t *args,
+                     eng_funnel_event_t **events_out, uint32_t *count_out,
+                     const char **err_out) {
+  *err_out = NULL;
+  *events_out = NULL;
+  *count_out = 0;
+  if (!args || !args->txn || !args->steps || args->num_steps == 0 ||
+      args->num_steps > MAX_FUNNEL_STEPS) {
+    *err_out = "Invalid args";
+    return false;
+  }
+
+  bitmap_t *candidates =
+      bitmap_or_many((const bitmap_t **)args->steps, args->num_steps);
+  if (!candidates) {
+    *err_out = "OOM error loading funnel events";
+    return false;
+  }
+  uint32_t count = bitmap_get_cardinality(candidates);
+  if (count == 0) {
+    bitmap_free(candidates);
+    return true;
+  }
+
+  uint32_t *ids = malloc(count * sizeof(uint32_t));
+  uint32_t *entities = malloc(count * sizeof(uint32_t));
+  eng_funnel_event_t *events = malloc(count * sizeof(eng_funnel_event_t));
+  bool ok = ids && entities && events;
+  if (!ok) {
+    *err_out = "OOM error loading funnel events";
+  } else {
+    bitmap_to_uint32_array(candidates, ids);
+    _load_entities(args->event_to_entity_map, ids, count, entities);
+    ok = _load_events(args, ids, entities, count, events, count_out, err_out);
+  }
+  bitmap_free(candidates);
+  free(ids);
+  free(entities);
+
+  if (!ok) {
+    free(events);
+    *count_out = 0;
+    return false;
+  }
+  *events_out = events;
+  return true;
+}
+
+// --- Count ---
+
+typedef struct funnel_part_s {
+  const eng_funnel_event_t *events;
+  uint32_t count;
+  uint32_t num_steps;
+  uint64_t within_ms;
+  const deadline_t *deadline;
+  // Entities with `entity_id % num_parts == part`
+  uint32_t part;
+  uint32_t num_parts;
+  // Per entity, the latest start of the chains reaching each step
+  int64_t *starts;
+  uint32_t num_entities;
+  uint32_t cap;
+  uint64_t counts[MAX_FUNNEL_STEPS];
+  const char *err;
+  bool ok;
+} funnel_part_t;
+
+static int64_t *_entity_starts(funnel_part_t *p, khash_t(funnel_ent) * slots,
+                               uint32_t entity_id) {
+  int ret;
+  khiter_t k = kh_put(funnel_ent, slots, entity_id, &ret);
+  if (ret < 0) {
+    return NULL;
+  }
+  if (ret == 0) {
+    return p->starts + (size_t)kh_value(slots, k) * p->num_steps;
+  }
+
+  if (p->num_entities == p->cap) {
+    uint32_t cap = p->cap ? p->cap * 2 : 1024;
+    int64_t *grown =
+        realloc(p->starts, (size_t)cap * p->num_steps * sizeof(int64_t));
+    if (!grown) {
+      kh_del(funnel_ent, slots, k);
+      return NULL;
+    }
+    p->starts = grown;
+    p->cap = cap;
+  }
+  kh_value(slots, k) = p->num_entities;
+  int64_t *starts = p->starts + (size_t)p->num_entities * p->num_steps;
+  for (uint32_t s = 0; s < p->num_steps; s++) {
+    starts[s] = NO_START;
+  }
+  p->num_entities++;
+  return starts;
+}
+
+// A chain reaching step `s - 1` extends to step `s` when the event comes in
+// time. The latest start leaves the most time for later steps, so only that
+// one is kept. Steps are walked last to first so that one event never
+// extends a chain it just extended.
+static void _advance(int64_t *starts, uint32_t num_steps, uint64_t within_ms,
+                     const eng_funnel_event_t *e) {
+  for (uint32_t s = num_steps; s-- > 0;) {
+    if (!(e->step_mask & (1u << s))) {
+      continue;
+    }
+    int64_t start = s == 0 ? e->ts : starts[s - 1];
+    if (start == NO_START || e->ts < start ||
+        (uint64_t)(e->ts - start) > within_ms) {
+      continue;
+    }
+    if (start > starts[s]) {
+      starts[s] = start;
+    }
+  }
+}
+
+static bool _walk_part(funnel_part_t *p) {
+  khash_t(funnel_ent) *slots = kh_init(funnel_ent);
+  if (!slots) {
+    p->err = "OOM error counting funnel";
+    return false;
+  }
+
+  bool ok = true;
+  for (uint32_t i = 0; i < p->count; i++) {
+    if ((i + 1) % FUNNEL_CHUNK == 0) {
+      deadline_status_t ds = deadline_status(p->deadline);
+      if (ds != DEADLINE_OK) {
+        p->err = deadline_err_msg(ds);
+        ok = false;
+        break;
+      }
+    }
+    const eng_funnel_event_t *e = &p->events[i];
+    if (e->entity_id % p->num_parts != p->part) {
+      continue;
+    }
+    int64_t *starts = _entity_starts(p, slots, e->entity_id);
+    if (!starts) {
+      p->err = "OOM error counting funnel";
+      ok = false;
+      break;
+    }
+    _advance(starts, p->num_steps, p->within_ms, e);
+  }
+
+  if (ok) {
+    for (uint32_t n = 0; n < p->num_entities; n++) {
+      const int64_t *starts = p->starts + (size_t)n * p->num_steps;
+      for (uint32_t s = 0; s < p->num_steps; s++) {
+        if (starts[s] != NO_START) {
+          p->counts[s]++;
+        }
+      }
+    }
+  }
+  kh_destroy(funnel_ent, slots);
+  free(p->starts);
+  p->starts = NULL;
+  return ok;
+}
+
+// `arg` is the parts of `eng_funnel_count`
+static void _walk_part_task(void *arg, uint32_t part, bool on_caller) {
+  (void)on_caller;
+  funnel_part_t *p = (funnel_part_t *)arg + part;
+  p->ok = _walk_part(p);
+}
+
+bool eng_funnel_count(const eng_funnel_event_t *events, uint32_t count,
+                      uint32_t num_steps, uint64_t within_ms,
+                      const deadline_t *deadline, uint64_t *counts_out,
+                      const char **err_out) {
+  *err_out = NULL;
+  if ((count > 0 && !events) || !counts_out || num_steps == 0 ||
+      num_steps > MAX_FUNNEL_STEPS) {
+    *err_out = "Invalid args";
+    return false;
+  }
+
+  uint32_t num_parts = 1;
+  if (count >= ENG_FUNNEL_PARALLEL_MIN) {
+    num_parts = count / (ENG_FUNNEL_PARALLEL_MIN / 2);
+    if (num_parts > ENG_FUNNEL_MAX_THREADS) {
+      num_parts = ENG_FUNNEL_MAX_THREADS;
+    }
+  }
+
+  funnel_part_t parts[ENG_FUNNEL_MAX_THREADS];
+  memset(parts, 0, sizeof(parts));
+  for (uint32_t i = 0; i < num_parts; i++) {
+    parts[i].events = events;
+    parts[i].count = count;
+    parts[i].num_steps = num_steps;
+    parts[i].within_ms = within_ms;
+    parts[i].deadline = deadline;
+    parts[i].part = i;
+    parts[i].num_parts = num_parts;
+  }
+
+  range_pool_run(_walk_part_task, parts, num_parts);
+
+  memset(counts_out, 0, num_steps * sizeof(uint64_t));
+  bool ok = true;
+  for (uint32_t i = 0; i < num_parts; i++) {
+    if (!parts[i].ok) {
+      if (ok) {
+        *err_out = parts[i].err;
+      }
+      ok = false;
+      continue;
+    }
+    for (uint32_t s = 0; s < num_steps; s++) {
+      counts_out[s] += parts[i].counts[s];
+    }
+  }
+  return ok;
+}
@@ -0,0 +1,61 @@
+#ifndef ENG_FUNNEL_H
+#define ENG_FUNNEL_H
+
+#include "core/bitmaps.h"
+#include "core/deadline.h"
+#include "core/mmap_array.h"
+#include "lmdb.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+Per-entity funnels for `FUNNEL`.
+Each step resolves to a bitmap of matching events. The union of the steps is
+walked once in event id order, the order an entity's events arrived in, and
+each event is joined to its entity through the event to entity map and to its
+timestamp through its blob. An entity reaches step `i` once it has events
+matching steps 1..i in that order, the last no later than `within_ms` after
+the first. Entities are split into partitions by id and walked in parallel,
+each partition keeping only the state of its own entities. */
+
+// Candidate sets at least this large are split by entity and walked on the
+// range pool, see range_pool.h
+#define ENG_FUNNEL_PARALLEL_MIN 4096
+#define ENG_FUNNEL_MAX_THREADS 4
+
+// An event matching at least one step
+typedef struct eng_funnel_event_s {
+  uint32_t entity_id;
+  uint32_t step_mask; // bit `i` set if it matches step `i`
+  int64_t ts;         // milliseconds
+} eng_funnel_event_t;
+
+typedef struct eng_funnel_load_args_s {
+  MDB_txn *txn;
+  MDB_dbi events_db;
+  mmap_array_t *event_to_entity_map;
+  bitmap_t *const *steps;
+  uint32_t num_steps;
+  // Optional, checked every few thousand events
+  const deadline_t *deadline;
+} eng_funnel_load_args_t;
+
+/**
+ * Candidate events of `args->steps` in id order, written to a malloc'd
+ * `events_out`. Events not flushed to the events db yet, or without an
+ * entity, are left out.
+ */
+bool eng_funnel_load(const eng_funnel_load_args_t *args,
+                     eng_funnel_event_t **events_out, uint32_t *count_out,
+                     const char **err_out);
+
+/**
+ * Entities reaching each step, `counts_out` holds `num_steps`. `events` are
+ * in id order, as loaded by `eng_funnel_load`.
+ */
+bool eng_funnel_count(const eng_funnel_event_t *events, uint32_t count,
+                      uint32_t num_steps, uint64_t within_ms,
+                      const deadline_t *deadline, uint64_t *counts_out,
+                      const char **err_out);
+
+#endif
@@ -0,0 +1,93 @@
+#include "eng_histogram.h"
+#include "core/bitmaps.h"
+#include "core/db.h"
+#include "lmdb.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// Edge of buckets past the last indexed event
+#define EDGE_END ((uint64_t)UINT32_MAX + 1)
+
+uint64_t eng_histogram_num_buckets(int64_t from, int64_t to,
+                                   uint64_t bucket_ms) {
+  if (to <= from || bucket_ms == 0) {
+    return 0;
+  }
+  uint64_t span = (uint64_t)(to - from);
+  return span / bucket_ms + (span % bucket_ms ? 1 : 0);
+}
+
+// Lowest event id of the first ts key at or after `ts`, EDGE_END if none.
+// Duplicates sort by bytes, not by value, so every page of the key is read
+static bool _first_id_at(MDB_cursor *cursor, int64_t ts, uint64_t *id_out) {
+  db_key_t key = {.type = DB_KEY_I64, .key.i64 = ts};
+  db_cursor_entry_t entry;
+  db_cursor_get_result_t r =
+      db_cursor_get(cursor, &entry, MDB_SET_RANGE, &key);
+  if (r == DB_CURSOR_NOTFOUND) {
+    *id_out = EDGE_END;
+    return true;
+  }
+  if (r != DB_CURSOR_OK) {
+    return false;
+  }
+
+  db_cursor_entry_t page;
+  db_cursor_get_result_t pr =
+      db_cursor_get(cursor, &page, MDB_GET_MULTIPLE, NULL);
+  if (pr == DB_CURSOR_OK && page.value_len == 0) {
+    // A key's only value is stored inline, not as a duplicate page
+    page.value = entry.value;
+    page.value_len = entry.value_len;
+  }
+  uint64_t min_id = EDGE_END;
+  while (pr == DB_CURSOR_OK) {
+    size_t n = page.value_len / sizeof(uint32_t);
+    for (size_t i = 0; i < n; i++) {
+      uint32_t id;
+      memcpy(&id, (const char *)page.value + i * sizeof(uint32_t), sizeof(id));
+      if (id < min_id) {
+        min_id = id;
+      }
+    }
+    pr = db_cursor_get(cursor, &page, MDB_NEXT_MULTIPLE, NULL);
+  }
+  if (pr == DB_CURSOR_ERR) {
+    return false;
+  }
+  *id_out = min_id;
+  return true;
+}
+
+bool eng_histogram_edges(MDB_txn *txn, MDB_dbi ts_db, int64_t from, int64_t to,
+                         uint64_t bucket_ms, uint32_t num_buckets,
+                         uint64_t *edges_out) {
+  if (!txn || !edges_out || bucket_ms == 0 || to <= from) {
+    return false;
+  }
+  MDB_cursor *cursor = db_cursor_open(txn, ts_db);
+  if (!cursor) {
+    return false;
+  }
+
+  bool ok = true;
+  for (uint32_t i = 0; ok && i <= num_buckets; i++) {
+    // The last edge is `to`, cutting the last bucket short
+    int64_t ts = i == num_buckets ? to : from + (int64_t)(i * bucket_ms);
+    ok = _first_id_at(cursor, ts, &edges_out[i]);
+    // Never below the previous edge, should ids and timestamps disagree
+    if (ok && i > 0 && edges_out[i] < edges_out[i - 1]) {
+      edges_out[i] = edges_out[i - 1];
+    }
+  }
+  db_cursor_close(cursor);
+  return ok;
+}
+
+void eng_histogram_counts(const bitmap_t *events, const uint64_t *edges,
+                          uint32_t num_buckets, uint64_t *counts_out) {
+  for (uint32_t i = 0; i < num_buckets; i++) {
+    counts_out[i] = bitmap_range_cardinality(events, edges[i], edges[i + 1]);
+  }
+}
@@ -0,0 +1,35 @@
+#ifndef ENG_HISTOGRAM_H
+#define ENG_HISTOGRAM_H
+
+#include "core/bitmaps.h"
+#include "lmdb.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+Time-bucketed counts for `HISTOGRAM`.
+Event ids follow arrival order, so each bucket edge maps to the first event id
+the `ts` index holds at or after it. A bucket is then one range cardinality on
+the filtered events: a whole chart costs one filter evaluation and a seek per
+edge. Events that arrive within the same few milliseconds through different
+workers may swap ids, so they can land in the neighbouring bucket. */
+
+// Number of `bucket_ms` buckets covering [from, to), the last one may be short
+uint64_t eng_histogram_num_buckets(int64_t from, int64_t to,
+                                   uint64_t bucket_ms);
+
+/**
+ * Event id edges of `num_buckets` buckets starting at `from`, read from the
+ * `ts` index db. `edges_out` holds `num_buckets + 1` ids, bucket `i` covering
+ * [edges_out[i], edges_out[i + 1]). Edges past the last indexed event are
+ * 2^32, so later events fall into the bucket before
+ */
+bool eng_histogram_edges(MDB_txn *txn, MDB_dbi ts_db, int64_t from, int64_t to,
+                         uint64_t bucket_ms, uint32_t num_buckets,
+                         uint64_t *edges_out);
+
+// Events of each bucket, `counts_out` holds `num_buckets`
+void eng_histogram_counts(const bitmap_t *events, const uint64_t *edges,
+                          uint32_t num_buckets, uint64_t *counts_out);
+
+#endif
@@ -12,7 +12,10 @@ bool custom_tag_into(char *out_buf, size_t size, ast_node_t *custom_tag) {
   if (custom_tag->tag.value->type == AST_LITERAL_NODE) {
     ast_literal_node_t *literal = &custom_tag->tag.value->literal;
     int r = -1;
-    if (literal->type == AST_LITERAL_STRING) {
+    // Decimals keep their source text, `amount:99.99` is the same key it was
+    // before decimals were parsed
+    if (literal->type == AST_LITERAL_STRING ||
+        literal->type == AST_LITERAL_FLOAT) {
       r = snprintf(out_buf, size, "%s:%s", custom_tag->tag.custom_key,
                    literal->string_value);
     } else if (literal->type == AST_LITERAL_NUMBER) {
@@ -88,6 +91,17 @@ bool db_key_into(char *buffer, size_t buffer_size,
   return true;
 }
 
+bool view_key_into(char *out_buf, size_t size, const char *view_name) {
+  if (!out_buf || !view_name) {
+    return false;
+  }
+  int r = snprintf(out_buf, size, "%s|%s", USR_VIEW_KEY_PREFIX, view_name);
+  if (r < 0 || (size_t)r >= size) {
+    return false;
+  }
+  return true;
+}
+
 bool tag_count_into(char *out_buf, size_t size, const char *custom_tag,
                     uint32_t count) {
   if (!out_buf || !custom_tag) {
@@ -98,4 +112,31 @@ bool tag_count_into(char *out_buf, size_t size, const char *custom_tag,
     return false;
   }
   return true;
-}
\ No newline at end of file
+}
+
+bool entity_events_key_into(char *out_buf, size_t size, uint32_t entity_id) {
+  if (!out_buf) {
+    return false;
+  }
+  // No ':' in the key, so it cannot collide with a "key:value" tag entry
+  // in the same db
+  int r = snprintf(out_buf, size, "%s|%u", USR_ENTITY_EVENTS_KEY_PREFIX,
+                   entity_id);
+  if (r < 0 || (size_t)r >= size) {
+    return false;
+  }
+  return true;
+}
+
+bool bsi_key_into(char *out_buf, size_t size, const char *index_key,
+                  uint32_t slice) {
+  if (!out_buf || !index_key) {
+    return false;
+  }
+  int r = snprintf(out_buf, size, "%s|%s|%u", USR_BSI_KEY_PREFIX, index_key,
+                   slice);
+  if (r < 0 || (size_t)r >= size) {
+    return false;
+  }
+  return true;
+}
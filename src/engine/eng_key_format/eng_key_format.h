@@ -20,6 +20,16 @@ bool tag_str_entity_id_into(char *out_buf, size_t size, const char *custom_tag,
 // turn custom tag ast node + entity id into a serialized string
 bool tag_entity_id_into(char *out_buf, size_t size, ast_node_t *custom_tag,
                         uint32_t entity_id);
+// turn entity int id into the key of its event posting list
+bool entity_events_key_into(char *out_buf, size_t size, uint32_t entity_id);
+
+// turn view name into the key of its result bitmap / definition
+bool view_key_into(char *out_buf, size_t size, const char *view_name);
+
+// turn a BSI index key + slice number into the key of the slice's bitmap
+bool bsi_key_into(char *out_buf, size_t size, const char *index_key,
+                  uint32_t slice);
+
 // turn custom tag string + count into a serialized string
 bool tag_count_into(char *out_buf, size_t size, const char *custom_tag,
                     uint32_t count);
@@ -0,0 +1,169 @@
+#include "eng_profile.h"
+#include "mpack.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+static const char *const SRC_NAMES[ENG_PROFILE_SRC_COUNT] = {
+    "local_cache", "consumer_cache", "read_cache", "lmdb"};
+
+uint64_t eng_profile_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void eng_profile_init(eng_profile_t *p, bool timed) {
+  memset(p, 0, sizeof(eng_profile_t));
+  p->timed = timed;
+  p->cur = -1;
+}
+
+int32_t eng_profile_enter(eng_profile_t *p, const char *op, const char *label,
+                          const char *access) {
+  if (!p) {
+    return -1;
+  }
+  if (p->count >= ENG_PROFILE_MAX_NODES) {
+    p->truncated = true;
+    return -1;
+  }
+  int32_t idx = (int32_t)p->count++;
+  eng_profile_node_t *n = &p->nodes[idx];
+  memset(n, 0, sizeof(eng_profile_node_t));
+  n->op = op;
+  snprintf(n->label, sizeof(n->label), "%s", label ? label : "");
+  n->access = access;
+  n->parent = p->cur;
+  n->consumer = -1;
+  if (p->timed) {
+    n->start_ns = eng_profile_now_ns();
+  }
+  p->cur = idx;
+  return idx;
+}
+
+void eng_profile_exit(eng_profile_t *p, int32_t idx, uint64_t card) {
+  if (!p || idx < 0) {
+    return;
+  }
+  eng_profile_node_t *n = &p->nodes[idx];
+  if (p->timed) {
+    n->ns = eng_profile_now_ns() - n->start_ns;
+    n->card = card;
+  }
+  p->cur = n->parent;
+}
+
+void eng_profile_estimate(eng_profile_t *p, int32_t idx, uint64_t estimate) {
+  if (!p || idx < 0) {
+    return;
+  }
+  p->nodes[idx].has_estimate = true;
+  p->nodes[idx].estimate = estimate;
+}
+
+void eng_profile_read(eng_profile_t *p, eng_profile_src_t src,
+                      int32_t consumer, uint64_t bytes) {
+  if (!p || p->cur < 0) {
+    return;
+  }
+  eng_profile_node_t *n = &p->nodes[p->cur];
+  n->reads[src]++;
+  n->bytes += bytes;
+  if (src == ENG_PROFILE_SRC_CONSUMER_CACHE) {
+    n->consumer = consumer;
+  }
+}
+
+void eng_profile_steps(eng_profile_t *p, uint64_t steps) {
+  if (!p || p->cur < 0) {
+    return;
+  }
+  p->nodes[p->cur].cursor_steps += steps;
+}
+
+static void _write_node(mpack_writer_t *writer, const eng_profile_t *p,
+                        int32_t idx) {
+  const eng_profile_node_t *n = &p->nodes[idx];
+  uint32_t num_children = 0;
+  for (uint32_t i = (uint32_t)idx + 1; i < p->count; i++) {
+    num_children += p->nodes[i].parent == idx;
+  }
+
+  uint32_t map_size = 1;
+  map_size += n->label[0] ? 1 : 0;
+  map_size += n->access ? 1 : 0;
+  map_size += n->has_estimate ? 1 : 0;
+  map_size += p->timed ? 5 : 0;
+  map_size += p->timed && n->consumer >= 0 ? 1 : 0;
+  map_size += num_children ? 1 : 0;
+  mpack_start_map(writer, map_size);
+  mpack_write_cstr(writer, "op");
+  mpack_write_cstr(writer, n->op);
+  if (n->label[0]) {
+    mpack_write_cstr(writer, "label");
+    mpack_write_cstr(writer, n->label);
+  }
+  if (n->access) {
+    mpack_write_cstr(writer, "access");
+    mpack_write_cstr(writer, n->access);
+  }
+  if (n->has_estimate) {
+    mpack_write_cstr(writer, "estimate");
+    mpack_write_u64(writer, n->estimate);
+  }
+  if (p->timed) {
+    mpack_write_cstr(writer, "ns");
+    mpack_write_u64(writer, n->ns);
+    mpack_write_cstr(writer, "card");
+    mpack_write_u64(writer, n->card);
+    mpack_write_cstr(writer, "reads");
+    mpack_start_map(writer, ENG_PROFILE_SRC_COUNT);
+    for (uint32_t s = 0; s < ENG_PROFILE_SRC_COUNT; s++) {
+      mpack_write_cstr(writer, SRC_NAMES[s]);
+      mpack_write_u32(writer, n->reads[s]);
+    }
+    mpack_finish_map(writer);
+    mpack_write_cstr(writer, "bytes");
+    mpack_write_u64(writer, n->bytes);
+    mpack_write_cstr(writer, "cursor_steps");
+    mpack_write_u64(writer, n->cursor_steps);
+    if (n->consumer >= 0) {
+      mpack_write_cstr(writer, "consumer");
+      mpack_write_i32(writer, n->consumer);
+    }
+  }
+  if (num_children) {
+    mpack_write_cstr(writer, "children");
+    mpack_start_array(writer, num_children);
+    for (uint32_t i = (uint32_t)idx + 1; i < p->count; i++) {
+      if (p->nodes[i].parent == idx) {
+        _write_node(writer, p, (int32_t)i);
+      }
+    }
+    mpack_finish_array(writer);
+  }
+  mpack_finish_map(writer);
+}
+
+void eng_profile_write(mpack_writer_t *writer, const eng_profile_t *p) {
+  mpack_start_map(writer, p->timed ? 4 : 2);
+  mpack_write_cstr(writer, "root");
+  if (p->count) {
+    _write_node(writer, p, 0);
+  } else {
+    mpack_write_nil(writer);
+  }
+  mpack_write_cstr(writer, "truncated");
+  mpack_write_bool(writer, p->truncated);
+  if (p->timed) {
+    mpack_write_cstr(writer, "eval_ns");
+    mpack_write_u64(writer, p->eval_ns);
+    mpack_write_cstr(writer, "fetch_ns");
+    mpack_write_u64(writer, p->fetch_ns);
+  }
+  mpack_finish_map(writer);
+}
@@ -0,0 +1,86 @@
+#ifndef ENG_PROFILE_H
+#define ENG_PROFILE_H
+
+#include "mpack.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+Query plans for `EXPLAIN QUERY` and `PROFILE QUERY`.
+The evaluator opens a node per operator it runs and reports reads and cursor
+steps to the innermost open one. With no profile attached every hook is a
+NULL check, so the hot path runs the same code profiled or not. */
+
+// Nodes past this are dropped and the plan is marked truncated
+#define ENG_PROFILE_MAX_NODES 256
+
+#define ENG_PROFILE_LABEL_LEN 128
+
+// Where a bitmap read was served from
+typedef enum {
+  ENG_PROFILE_SRC_LOCAL_CACHE, // this evaluation's `eval_state_t` cache
+  ENG_PROFILE_SRC_CONSUMER_CACHE,
+  ENG_PROFILE_SRC_READ_CACHE, // shared across queries
+  ENG_PROFILE_SRC_LMDB,
+  ENG_PROFILE_SRC_COUNT
+} eng_profile_src_t;
+
+typedef struct eng_profile_node_s {
+  const char *op; // "and", "or", "not", "tag" or "compare"
+  char label[ENG_PROFILE_LABEL_LEN];
+  // "bitmap", "index_scan", "bsi" or "scan" (event blobs), NULL for
+  // operators
+  const char *access;
+  int32_t parent; // -1 for the root
+  bool has_estimate;
+  uint64_t estimate; // from the tag stats
+  // Set when profiling
+  uint64_t start_ns;
+  uint64_t ns;
+  uint64_t card;
+  uint32_t reads[ENG_PROFILE_SRC_COUNT];
+  int32_t consumer; // last consumer cache that served a read, -1 if none
+  uint64_t bytes;   // read from LMDB
+  uint64_t cursor_steps;
+} eng_profile_node_t;
+
+typedef struct eng_profile_s {
+  // Set for PROFILE: nodes are timed and count their reads
+  bool timed;
+  eng_profile_node_t nodes[ENG_PROFILE_MAX_NODES];
+  uint32_t count;
+  int32_t cur; // innermost open node, -1 if none
+  bool truncated;
+  uint64_t eval_ns;
+  uint64_t fetch_ns;
+} eng_profile_t;
+
+uint64_t eng_profile_now_ns(void);
+
+// Empty profile, `timed` for PROFILE
+void eng_profile_init(eng_profile_t *p, bool timed);
+
+/**
+ * Open a child of the innermost open node. Returns its index, -1 if `p` is
+ * NULL or full; `eng_profile_exit` accepts either
+ */
+int32_t eng_profile_enter(eng_profile_t *p, const char *op, const char *label,
+                          const char *access);
+
+// Close node `idx` with the cardinality of its result
+void eng_profile_exit(eng_profile_t *p, int32_t idx, uint64_t card);
+
+void eng_profile_estimate(eng_profile_t *p, int32_t idx, uint64_t estimate);
+
+// Count a bitmap read against the innermost open node
+void eng_profile_read(eng_profile_t *p, eng_profile_src_t src,
+                      int32_t consumer, uint64_t bytes);
+
+// Count cursor steps, or event blobs read by a scan, against the innermost
+// open node
+void eng_profile_steps(eng_profile_t *p, uint64_t steps);
+
+// The plan tree as a msgpack map, with timings when `timed`
+void eng_profile_write(mpack_writer_t *writer, const eng_profile_t *p);
+
+#endif
@@ -2,10 +2,50 @@
 #include "ck_epoch.h"
 #include "core/bitmaps.h"
 #include "core/ebr.h"
+#include "core/hash.h"
 #include "engine/cmd_context/cmd_context.h"
 #include "engine/eng_eval/eng_eval.h"
+#include "engine/eng_sample/eng_sample.h"
+#include "engine/page_session/page_session.h"
 #include "query/ast.h"
 #include <stdint.h>
+#include <string.h>
+
+// Identifies a `where` expression, so a session is only paged by its query
+static uint64_t _exp_hash(const ast_node_t *node, uint64_t h) {
+  if (!node) {
+    return h;
+  }
+  h = xxhash64(&node->type, sizeof(node->type), h);
+  switch (node->type) {
+  case AST_LITERAL_NODE:
+    if (node->literal.type == AST_LITERAL_NUMBER) {
+      return xxhash64(&node->literal.number_value, sizeof(int64_t), h);
+    }
+    // Floats keep their source text
+    return xxhash64(node->literal.string_value, node->literal.string_value_len,
+                    h);
+  case AST_TAG_NODE:
+    if (node->tag.key_type == AST_TAG_KEY_RESERVED) {
+      h = xxhash64(&node->tag.reserved_key, sizeof(node->tag.reserved_key), h);
+    } else {
+      h = xxhash64(node->tag.custom_key, strlen(node->tag.custom_key), h);
+    }
+    return _exp_hash(node->tag.value, h);
+  case AST_COMPARISON_NODE:
+    h = xxhash64(&node->comparison.op, sizeof(node->comparison.op), h);
+    h = _exp_hash(node->comparison.left, h);
+    return _exp_hash(node->comparison.right, h);
+  case AST_LOGICAL_NODE:
+    h = xxhash64(&node->logical.op, sizeof(node->logical.op), h);
+    h = _exp_hash(node->logical.left_operand, h);
+    return _exp_hash(node->logical.right_operand, h);
+  case AST_NOT_NODE:
+    return _exp_hash(node->not_op.operand, h);
+  default:
+    return h;
+  }
+}
 
 void eng_query_exec(cmd_ctx_t *cmd_ctx, consumer_t *consumers, eval_ctx_t *ctx,
                     eng_query_result_t *r) {
@@ -17,13 +57,59 @@ void eng_query_exec(cmd_ctx_t *cmd_ctx, consumer_t *consumers, eval_ctx_t *ctx,
     return;
   }
 
+  // default to 5k limit to avoid disruption
+  uint32_t limit = 5000;
+  uint32_t start_val = 0;
+  if (cmd_ctx->take_tag_value) {
+    limit = cmd_ctx->take_tag_value->literal.number_value;
+  }
+  if (cmd_ctx->cursor_tag_value) {
+    start_val = cmd_ctx->cursor_tag_value->literal.number_value;
+  }
+
+  ast_node_t *session_tag =
+      ast_find_custom_tag(&cmd_ctx->ast->command, "session");
+  const char *container_name = cmd_ctx->in_tag_value->literal.string_value;
+  uint64_t query_hash =
+      session_tag ? _exp_hash(cmd_ctx->where_tag_value, 0) : 0;
+  if (session_tag &&
+      session_tag->tag.value->literal.type == AST_LITERAL_NUMBER) {
+    // Later pages slice the kept result, evaluating again only if it is gone
+    uint64_t handle = (uint64_t)session_tag->tag.value->literal.number_value;
+    r->events = page_session_page(handle, container_name, query_hash, limit,
+                                  start_val, &r->next_cursor);
+    if (r->events) {
+      r->success = true;
+      r->session = r->next_cursor ? handle : 0;
+      return;
+    }
+  }
+
   ck_epoch_section_t section;
   ebr_begin(&section);
 
   eng_eval_result_t eval_result =
       eng_eval_resolve_exp_to_events(cmd_ctx->where_tag_value, ctx);
 
+  // Aggregates read slices from the same caches, so stay in the section
+  ast_node_t *agg_tag = ast_find_custom_tag(&cmd_ctx->ast->command, "agg");
+  if (eval_result.success && agg_tag) {
+    const char *agg_err = NULL;
+    r->has_agg = eng_eval_bsi_agg(agg_tag->tag.value->literal.string_value,
+                                  eval_result.events, ctx, &r->agg, &agg_err);
+    if (!r->has_agg) {
+      bitmap_free(eval_result.events);
+      eval_result.events = NULL;
+      eval_result.success = false;
+      eval_result.err_msg = agg_err;
+    }
+  }
+
   ebr_end(&section);
+  // Free read cache entries this thread evicted
+  ebr_poll_nonblocking();
+
+  uint32_t last_event_id = ctx->state->max_event_id;
 
   eng_eval_cleanup_state(ctx->state);
 
@@ -35,14 +121,34 @@ void eng_query_exec(cmd_ctx_t *cmd_ctx, consumer_t *consumers, eval_ctx_t *ctx,
     return;
   }
 
-  // default to 5k limit to avoid disruption
-  uint32_t limit = 5000;
-  uint32_t start_val = 0;
-  if (cmd_ctx->take_tag_value) {
-    limit = cmd_ctx->take_tag_value->literal.number_value;
+  if (ctx->config->sample_pct) {
+    // Scale the match count before `take:` trims the result
+    uint32_t sample_size =
+        eng_sample_size(ctx->config->sample_pct, last_event_id);
+    eng_sample_estimate_t e = eng_sample_estimate(
+        bitmap_get_cardinality(r->events), sample_size, last_event_id);
+    r->sampled = true;
+    r->estimated_count = e.count;
+    r->count_error = e.error;
   }
-  if (cmd_ctx->cursor_tag_value) {
-    start_val = cmd_ctx->cursor_tag_value->literal.number_value;
+
+  if (session_tag) {
+    bitmap_t *page = bitmap_page(r->events, limit, start_val, &r->next_cursor);
+    if (!page) {
+      bitmap_free(r->events);
+      r->events = NULL;
+      r->success = false;
+      r->err_msg = "OOM error paging query result";
+      return;
+    }
+    // A single page has nothing to keep
+    if (r->next_cursor) {
+      r->session = page_session_put(container_name, query_hash, r->events);
+    } else {
+      bitmap_free(r->events);
+    }
+    r->events = page;
+    return;
   }
 
   if (limit || start_val) {
@@ -12,6 +12,15 @@ typedef struct eng_query_result_s {
   const char *err_msg;
   bitmap_t *events;
   uint32_t next_cursor;
+  // Set when the query ran over a sample of event ids
+  bool sampled;
+  uint64_t estimated_count;
+  uint64_t count_error;
+  // Set by `agg:<key>`, over all matches before `take:`
+  bool has_agg;
+  eng_eval_agg_t agg;
+  // Set by `session:`, the handle of the kept result, 0 if not kept
+  uint64_t session;
 } eng_query_result_t;
 
 /**
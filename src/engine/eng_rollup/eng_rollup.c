@@ -0,0 +1,174 @@
+#include "eng_rollup.h"
+#include "core/data_constants.h"
+#include "core/db.h"
+#include "engine/rollup/rollup.h"
+#include "lmdb.h"
+#include "query/ast.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool _same_keys(const rollup_t *rollup, ast_node_t *keys) {
+  uint32_t i = 0;
+  for (ast_node_t *k = keys; k; k = k->next, i++) {
+    if (i == rollup->num_keys ||
+        strcmp(rollup->keys[i], k->literal.string_value) != 0) {
+      return false;
+    }
+  }
+  return i == rollup->num_keys;
+}
+
+const rollup_t *eng_rollup_pick(const rollup_set_t *set, ast_node_t *keys,
+                                uint64_t bucket_ms) {
+  if (!set || !keys || bucket_ms == 0) {
+    return NULL;
+  }
+  const rollup_t *best = NULL;
+  for (uint32_t i = 0; i < set->count; i++) {
+    const rollup_t *r = &set->rollups[i];
+    if (bucket_ms % r->bucket_ms == 0 && _same_keys(r, keys) &&
+        (!best || r->bucket_ms > best->bucket_ms)) {
+      best = r;
+    }
+  }
+  return best;
+}
+
+static int _cmp_rows(const void *a, const void *b) {
+  const eng_rollup_row_t *x = a;
+  const eng_rollup_row_t *y = b;
+  if (x->bucket != y->bucket) {
+    return x->bucket < y->bucket ? -1 : 1;
+  }
+  size_t n = x->values_len < y->values_len ? x->values_len : y->values_len;
+  int c = memcmp(x->values, y->values, n);
+  if (c != 0) {
+    return c;
+  }
+  return (x->values_len > y->values_len) - (x->values_len < y->values_len);
+}
+
+// Sum rows of the same bucket and values, `r` sorted
+static void _merge_rows(eng_rollup_result_t *r) {
+  uint32_t n = 0;
+  for (uint32_t i = 0; i < r->count; i++) {
+    if (n > 0 && _cmp_rows(&r->rows[n - 1], &r->rows[i]) == 0) {
+      r->rows[n - 1].count += r->rows[i].count;
+      free(r->rows[i].values);
+      continue;
+    }
+    r->rows[n++] = r->rows[i];
+  }
+  r->count = n;
+}
+
+static bool _append_row(eng_rollup_result_t *r, uint32_t *cap,
+                        uint64_t bucket, const char *values,
+                        size_t values_len, uint64_t count) {
+  if (r->count == *cap) {
+    uint32_t new_cap = *cap ? *cap * 2 : 64;
+    eng_rollup_row_t *grown =
+        realloc(r->rows, new_cap * sizeof(eng_rollup_row_t));
+    if (!grown) {
+      return false;
+    }
+    r->rows = grown;
+    *cap = new_cap;
+  }
+  char *copy = malloc(values_len + 1);
+  if (!copy) {
+    return false;
+  }
+  memcpy(copy, values, values_len);
+  copy[values_len] = '\0';
+  r->rows[r->count++] = (eng_rollup_row_t){.bucket = bucket,
+                                           .values = copy,
+                                           .values_len = values_len,
+                                           .count = count};
+  return true;
+}
+
+bool eng_rollup_read(MDB_txn *txn, MDB_dbi rollup_db, const rollup_t *rollup,
+                     uint64_t from, uint64_t to, uint64_t bucket_ms,
+                     eng_rollup_result_t *out, const char **err_out) {
+  memset(out, 0, sizeof(eng_rollup_result_t));
+  if (!txn || !rollup || bucket_ms == 0) {
+    *err_out = "Invalid rollup read";
+    return false;
+  }
+
+  char start_key[MAX_ROLLUP_ROW_KEY_LEN];
+  if (!rollup_bucket_key_into(start_key, sizeof(start_key), rollup,
+                              from - from % bucket_ms)) {
+    *err_out = "Key formatting failed";
+    return false;
+  }
+  MDB_cursor *cursor = db_cursor_open(txn, rollup_db);
+  if (!cursor) {
+    *err_out = "Error reading rollup";
+    return false;
+  }
+
+  db_key_t seek_key = {.type = DB_KEY_STRING, .key.s = start_key};
+  db_cursor_entry_t entry;
+  uint32_t cap = 0;
+  bool ok = true;
+  db_cursor_get_result_t cr =
+      db_cursor_get(cursor, &entry, MDB_SET_RANGE, &seek_key);
+  while (cr == DB_CURSOR_OK) {
+    uint64_t bucket;
+    const char *values;
+    size_t values_len;
+    // Rows of other rollups, or past `to`, end the range
+    if (!rollup_parse_row_key(rollup, entry.key, entry.key_len, &bucket,
+                              &values, &values_len) ||
+        bucket >= to) {
+      break;
+    }
+    uint64_t count = 0;
+    if (entry.value_len == sizeof(uint64_t)) {
+      memcpy(&count, entry.value, sizeof(uint64_t));
+    }
+    if (out->count == MAX_ROLLUP_ROWS) {
+      *err_out = "Too many rollup rows, narrow the time range";
+      ok = false;
+      break;
+    }
+    if (!_append_row(out, &cap, bucket - bucket % bucket_ms, values,
+                     values_len, count)) {
+      *err_out = "OOM error reading rollup";
+      ok = false;
+      break;
+    }
+    cr = db_cursor_get(cursor, &entry, MDB_NEXT, NULL);
+  }
+  db_cursor_close(cursor);
+
+  if (ok && cr == DB_CURSOR_ERR) {
+    *err_out = "Error reading rollup";
+    ok = false;
+  }
+  if (!ok) {
+    eng_rollup_result_free(out);
+    return false;
+  }
+  if (out->count > 0) {
+    qsort(out->rows, out->count, sizeof(eng_rollup_row_t), _cmp_rows);
+    _merge_rows(out);
+  }
+  return true;
+}
+
+void eng_rollup_result_free(eng_rollup_result_t *r) {
+  if (!r) {
+    return;
+  }
+  for (uint32_t i = 0; i < r->count; i++) {
+    free(r->rows[i].values);
+  }
+  free(r->rows);
+  r->rows = NULL;
+  r->count = 0;
+}
@@ -0,0 +1,48 @@
+#ifndef ENG_ROLLUP_H
+#define ENG_ROLLUP_H
+
+#include "engine/rollup/rollup.h"
+#include "lmdb.h"
+#include "query/ast.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+`ROLLUP` reads, straight off the counter rows of a rollup.
+Rows of a bucket are contiguous and buckets are keyed in time order, so a read
+is one cursor walk over [from, to) that never touches a bitmap. Rows of a
+finer rollup are summed into the read's buckets. Deltas still in a consumer
+are not seen, counts trail writes by up to a flush. */
+
+typedef struct eng_rollup_row_s {
+  uint64_t bucket; // Start, in ms
+  char *values;    // Separated by ROLLUP_VALUE_SEP
+  size_t values_len;
+  uint64_t count;
+} eng_rollup_row_t;
+
+typedef struct eng_rollup_result_s {
+  eng_rollup_row_t *rows; // By bucket, then values
+  uint32_t count;
+} eng_rollup_result_t;
+
+/**
+ * Rollup of `set` to read `keys` (string literals linked by `next`) in
+ * `bucket_ms` buckets from: same keys in the same order, a bucket dividing
+ * `bucket_ms`. The coarsest one wins. NULL if there is none
+ */
+const rollup_t *eng_rollup_pick(const rollup_set_t *set, ast_node_t *keys,
+                                uint64_t bucket_ms);
+
+/**
+ * Counts of `rollup` in `bucket_ms` buckets over [from, to), `from` aligned
+ * down to a bucket. Fails if more than MAX_ROLLUP_ROWS rows are in range
+ */
+bool eng_rollup_read(MDB_txn *txn, MDB_dbi rollup_db, const rollup_t *rollup,
+                     uint64_t from, uint64_t to, uint64_t bucket_ms,
+                     eng_rollup_result_t *out, const char **err_out);
+
+void eng_rollup_result_free(eng_rollup_result_t *r);
+
+#endif
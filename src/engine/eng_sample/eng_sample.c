@@ -0,0 +1,107 @@
+#include "eng_sample.h"
+#include "core/bitmaps.h"
+#include "core/hash.h"
+#include <math.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define SAMPLE_HASH_SEED 0x5a3c
+#define SAMPLE_BLOCK_SIZE 65536
+
+// z for a ~95% two-sided interval
+#define SAMPLE_Z 1.96
+
+// One 65536-bit pattern per rate, built on first use
+static _Atomic(bitmap_t *) g_patterns[MAX_QUERY_SAMPLE_PCT + 1];
+
+static bitmap_t *_build_pattern(uint32_t pct) {
+  bitmap_t *p = bitmap_create();
+  if (!p) {
+    return NULL;
+  }
+  for (uint32_t off = 0; off < SAMPLE_BLOCK_SIZE; off++) {
+    if (xxhash64(&off, sizeof(off), SAMPLE_HASH_SEED) % 100 < pct) {
+      bitmap_add(p, off);
+    }
+  }
+  return p;
+}
+
+static const bitmap_t *_pattern(uint32_t pct) {
+  bitmap_t *p = atomic_load(&g_patterns[pct]);
+  if (p) {
+    return p;
+  }
+  bitmap_t *built = _build_pattern(pct);
+  if (!built) {
+    return NULL;
+  }
+  // Another query may have built it first
+  if (!atomic_compare_exchange_strong(&g_patterns[pct], &p, built)) {
+    bitmap_free(built);
+    return p;
+  }
+  return built;
+}
+
+bitmap_t *eng_sample_bitmap(uint32_t pct, uint32_t last_event_id) {
+  if (pct == 0 || pct > MAX_QUERY_SAMPLE_PCT) {
+    return NULL;
+  }
+  const bitmap_t *pattern = _pattern(pct);
+  if (!pattern) {
+    return NULL;
+  }
+  // Event ids start at 1
+  return bitmap_tile(pattern, 1, (uint64_t)last_event_id + 1);
+}
+
+bool eng_sample_and_inplace(bitmap_t *bm, uint32_t pct,
+                            uint32_t last_event_id) {
+  if (pct == 0 || pct > MAX_QUERY_SAMPLE_PCT) {
+    return false;
+  }
+  const bitmap_t *pattern = _pattern(pct);
+  // Event ids start at 1
+  return pattern && bitmap_and_tiled_inplace(bm, pattern, 1,
+                                             (uint64_t)last_event_id + 1);
+}
+
+uint32_t eng_sample_size(uint32_t pct, uint32_t last_event_id) {
+  if (pct == 0 || pct > MAX_QUERY_SAMPLE_PCT) {
+    return 0;
+  }
+  const bitmap_t *pattern = _pattern(pct);
+  if (!pattern) {
+    return 0;
+  }
+  // Ids [0, last_event_id]: whole blocks, then the start of the last one
+  uint64_t n = (uint64_t)last_event_id + 1;
+  uint64_t size =
+      (n / SAMPLE_BLOCK_SIZE) * bitmap_get_cardinality(pattern) +
+      bitmap_range_cardinality(pattern, 0, n % SAMPLE_BLOCK_SIZE);
+  // Event ids start at 1
+  if (bitmap_contains((bitmap_t *)pattern, 0)) {
+    size--;
+  }
+  return (uint32_t)size;
+}
+
+eng_sample_estimate_t eng_sample_estimate(uint32_t hits, uint32_t sample_size,
+                                          uint32_t universe) {
+  eng_sample_estimate_t e = {.count = hits, .error = 0};
+  if (sample_size == 0 || sample_size >= universe) {
+    return e;
+  }
+  double f = (double)sample_size / (double)universe;
+  // Each id is kept independently with probability f: binomial error
+  e.count = (uint64_t)llround(hits / f);
+  e.error = (uint64_t)ceil(SAMPLE_Z * sqrt(hits * (1.0 - f)) / f);
+  return e;
+}
+
+void eng_sample_shutdown(void) {
+  for (uint32_t i = 0; i <= MAX_QUERY_SAMPLE_PCT; i++) {
+    bitmap_free(atomic_exchange(&g_patterns[i], NULL));
+  }
+}
@@ -0,0 +1,52 @@
+#ifndef ENG_SAMPLE_H
+#define ENG_SAMPLE_H
+
+#include "core/bitmaps.h"
+#include "core/data_constants.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+Sampled evaluation.
+An event id is in the sample at rate `pct` iff a hash of its low 16 bits falls
+under `pct` percent. The per-rate pattern is computed once and repeated in
+every 65536-id block, so every query at the same rate sees the same ids.
+Bitmaps are sampled block by block, so the cost follows the bitmap rather than
+the id space. */
+
+/**
+ * Sample of event ids in [1, last_event_id] at `pct` percent (1-100), as large
+ * as the id space. Caller frees. NULL on error
+ */
+bitmap_t *eng_sample_bitmap(uint32_t pct, uint32_t last_event_id);
+
+/**
+ * Intersect `bm` with `eng_sample_bitmap(pct, last_event_id)` without building
+ * it. False on error
+ */
+bool eng_sample_and_inplace(bitmap_t *bm, uint32_t pct,
+                            uint32_t last_event_id);
+
+/**
+ * Number of ids in [1, last_event_id] in the sample at `pct` percent, without
+ * building it. 0 on error
+ */
+uint32_t eng_sample_size(uint32_t pct, uint32_t last_event_id);
+
+typedef struct eng_sample_estimate_s {
+  uint64_t count; // estimated matches over the whole id space
+  uint64_t error; // half-width of the ~95% confidence interval
+} eng_sample_estimate_t;
+
+/**
+ * Scale `hits` matches among `sample_size` sampled ids up to `universe` ids
+ */
+eng_sample_estimate_t eng_sample_estimate(uint32_t hits, uint32_t sample_size,
+                                          uint32_t universe);
+
+/**
+ * Free cached sample patterns. Call at shutdown
+ */
+void eng_sample_shutdown(void);
+
+#endif
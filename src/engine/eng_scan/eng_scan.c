@@ -0,0 +1,166 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // memmem
+#endif
+#include "eng_scan.h"
+#include "mpack.h"
+#include "query/ast.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// A value read from a blob, strings point into it
+typedef struct {
+  ast_literal_type_t type;
+  int64_t num;
+  double dbl;
+  const char *str;
+  size_t len;
+} scan_val_t;
+
+// Whether every byte string the filter needs is somewhere in the blob
+static bool _may_match(const eng_scan_filter_t *f, const char *data,
+                       size_t size) {
+  if (!memmem(data, size, f->key, f->key_len)) {
+    return false;
+  }
+  for (uint32_t i = 0; i < f->count; i++) {
+    const eng_scan_pred_t *p = &f->preds[i];
+    if ((p->op == AST_OP_EQ || p->op == AST_OP_CONTAINS) &&
+        p->val->type == AST_LITERAL_STRING &&
+        !memmem(data, size, p->val->string_value, p->val->string_value_len)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Value of top-level `key`, the values before it are skipped unread
+static bool _read_value(const eng_scan_filter_t *f, const char *data,
+                        size_t size, scan_val_t *out) {
+  bool found = false;
+  mpack_reader_t reader;
+  mpack_reader_init_data(&reader, data, size);
+  uint32_t n = mpack_expect_map(&reader);
+  for (uint32_t i = 0;
+       i < n && !found && mpack_reader_error(&reader) == mpack_ok; i++) {
+    uint32_t len = mpack_expect_str(&reader);
+    const char *k = mpack_read_bytes_inplace(&reader, len);
+    mpack_done_str(&reader);
+    if (mpack_reader_error(&reader) != mpack_ok) {
+      break;
+    }
+    if (len != f->key_len || memcmp(k, f->key, len) != 0) {
+      mpack_discard(&reader);
+      continue;
+    }
+
+    mpack_tag_t tag = mpack_read_tag(&reader);
+    found = mpack_reader_error(&reader) == mpack_ok;
+    switch (mpack_tag_type(&tag)) {
+    case mpack_type_int:
+      out->type = AST_LITERAL_NUMBER;
+      out->num = mpack_tag_int_value(&tag);
+      break;
+    case mpack_type_uint:
+      out->type = AST_LITERAL_NUMBER;
+      out->num = (int64_t)mpack_tag_uint_value(&tag);
+      break;
+    case mpack_type_double:
+      out->type = AST_LITERAL_FLOAT;
+      out->dbl = mpack_tag_double_value(&tag);
+      break;
+    case mpack_type_float:
+      out->type = AST_LITERAL_FLOAT;
+      out->dbl = mpack_tag_float_value(&tag);
+      break;
+    case mpack_type_str:
+      out->type = AST_LITERAL_STRING;
+      out->len = mpack_tag_str_length(&tag);
+      out->str = mpack_read_bytes_inplace(&reader, out->len);
+      mpack_done_str(&reader);
+      found = found && mpack_reader_error(&reader) == mpack_ok;
+      break;
+    default:
+      // nil, bools and containers never compare
+      found = false;
+      break;
+    }
+    // Only the first value of a repeated key counts
+    break;
+  }
+  mpack_reader_destroy(&reader);
+  return found;
+}
+
+static double _as_double(ast_literal_type_t type, int64_t num, double dbl) {
+  return type == AST_LITERAL_FLOAT ? dbl : (double)num;
+}
+
+// Byte-wise, like `strcmp` and STR index keys
+static int _cmp_bytes(const char *a, size_t a_len, const char *b,
+                      size_t b_len) {
+  int c = memcmp(a, b, a_len < b_len ? a_len : b_len);
+  if (c != 0) {
+    return c;
+  }
+  return (a_len > b_len) - (a_len < b_len);
+}
+
+static bool _holds(const scan_val_t *have, const eng_scan_pred_t *p) {
+  const ast_literal_node_t *want = p->val;
+  bool have_str = have->type == AST_LITERAL_STRING;
+  if (have_str != (want->type == AST_LITERAL_STRING)) {
+    return false;
+  }
+  if (p->op == AST_OP_CONTAINS) {
+    return have_str && memmem(have->str, have->len, want->string_value,
+                              want->string_value_len) != NULL;
+  }
+
+  int c;
+  if (have_str) {
+    c = _cmp_bytes(have->str, have->len, want->string_value,
+                   want->string_value_len);
+  } else if (have->type == AST_LITERAL_NUMBER &&
+             want->type == AST_LITERAL_NUMBER) {
+    c = (have->num > want->number_value) - (have->num < want->number_value);
+  } else {
+    double a = _as_double(have->type, have->num, have->dbl);
+    double b = _as_double(want->type, want->number_value, want->float_value);
+    c = (a > b) - (a < b);
+  }
+  switch (p->op) {
+  case AST_OP_GT:
+    return c > 0;
+  case AST_OP_GTE:
+    return c >= 0;
+  case AST_OP_LT:
+    return c < 0;
+  case AST_OP_LTE:
+    return c <= 0;
+  case AST_OP_EQ:
+    return c == 0;
+  case AST_OP_NEQ:
+    return c != 0;
+  case AST_OP_CONTAINS:
+    break;
+  }
+  return false;
+}
+
+bool eng_scan_match(const void *filter, const char *data, size_t size) {
+  const eng_scan_filter_t *f = filter;
+  if (!f || !data || !_may_match(f, data, size)) {
+    return false;
+  }
+  scan_val_t have = {0};
+  if (!_read_value(f, data, size, &have)) {
+    return false;
+  }
+  for (uint32_t i = 0; i < f->count; i++) {
+    if (!_holds(&have, &f->preds[i])) {
+      return false;
+    }
+  }
+  return true;
+}
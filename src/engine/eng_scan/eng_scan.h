@@ -0,0 +1,40 @@
+#ifndef ENG_SCAN_H
+#define ENG_SCAN_H
+
+#include "query/ast.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+Comparisons answered from event blobs, for keys without a queryable index
+and for `~`, which no index answers.
+Blobs are tested straight from their LMDB pages. The key, and the value of
+`=` and `~` on strings, must appear somewhere in a blob for it to match, which
+memmem checks first; glibc runs it with SIMD, so most blobs are rejected
+without being decoded. The rest have their top-level map walked until the key,
+skipping other values, and only that value is read. */
+
+// `k > a AND k < b` is one filter
+#define ENG_SCAN_MAX_PREDS 2
+
+typedef struct eng_scan_pred_s {
+  ast_comparison_op_t op; // applied as `key op val`
+  const ast_literal_node_t *val;
+} eng_scan_pred_t;
+
+// Comparisons on one top-level key, all of which must hold. Events without
+// the key never match, like events missing from an index
+typedef struct eng_scan_filter_s {
+  const char *key;
+  size_t key_len;
+  eng_scan_pred_t preds[ENG_SCAN_MAX_PREDS];
+  uint32_t count;
+} eng_scan_filter_t;
+
+// Whether the msgpack event blob `data` matches `filter`, an
+// `eng_scan_filter_t`. Numbers compare numerically and strings byte-wise;
+// a number never matches a string
+bool eng_scan_match(const void *filter, const char *data, size_t size);
+
+#endif
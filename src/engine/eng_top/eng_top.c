@@ -0,0 +1,307 @@
+#include "eng_top.h"
+#include "core/bitmaps.h"
+#include "core/data_constants.h"
+#include "core/db.h"
+#include "core/deadline.h"
+#include "lmdb.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Values scanned between deadline checks
+#define TOP_DEADLINE_CHECK_STEPS 1024
+
+// Longest inverted key handed to the cache, `<key>:<value>`
+#define TOP_INV_KEY_LEN (MAX_TEXT_VAL_LEN * 2 + 2)
+
+// --- Bounded Heap ---
+
+// `a` ranks below `b`
+static bool _worse(const eng_top_entry_t *a, const eng_top_entry_t *b) {
+  if (a->count != b->count) {
+    return a->count < b->count;
+  }
+  return strcmp(a->value, b->value) > 0;
+}
+
+static void _swap(eng_top_entry_t *a, eng_top_entry_t *b) {
+  eng_top_entry_t tmp = *a;
+  *a = *b;
+  *b = tmp;
+}
+
+static void _sift_up(eng_top_heap_t *h, uint32_t i) {
+  while (i > 0) {
+    uint32_t parent = (i - 1) / 2;
+    if (!_worse(&h->entries[i], &h->entries[parent])) {
+      break;
+    }
+    _swap(&h->entries[i], &h->entries[parent]);
+    i = parent;
+  }
+}
+
+static void _sift_down(eng_top_heap_t *h, uint32_t i) {
+  for (;;) {
+    uint32_t worst = i;
+    uint32_t l = 2 * i + 1;
+    uint32_t r = l + 1;
+    if (l < h->count && _worse(&h->entries[l], &h->entries[worst])) {
+      worst = l;
+    }
+    if (r < h->count && _worse(&h->entries[r], &h->entries[worst])) {
+      worst = r;
+    }
+    if (worst == i) {
+      return;
+    }
+    _swap(&h->entries[i], &h->entries[worst]);
+    i = worst;
+  }
+}
+
+bool eng_top_heap_init(eng_top_heap_t *h, uint32_t cap) {
+  if (!h || cap == 0) {
+    return false;
+  }
+  memset(h, 0, sizeof(eng_top_heap_t));
+  h->entries = calloc(cap, sizeof(eng_top_entry_t));
+  if (!h->entries) {
+    return false;
+  }
+  h->cap = cap;
+  return true;
+}
+
+bool eng_top_heap_push(eng_top_heap_t *h, const char *value, size_t value_len,
+                       uint64_t count) {
+  if (h->count == h->cap) {
+    // Ties with the worst entry lose, it was offered first
+    if (count <= h->entries[0].count) {
+      return true;
+    }
+    char *copy = strndup(value, value_len);
+    if (!copy) {
+      return false;
+    }
+    free(h->entries[0].value);
+    h->entries[0].value = copy;
+    h->entries[0].count = count;
+    _sift_down(h, 0);
+    return true;
+  }
+
+  char *copy = strndup(value, value_len);
+  if (!copy) {
+    return false;
+  }
+  h->entries[h->count].value = copy;
+  h->entries[h->count].count = count;
+  _sift_up(h, h->count++);
+  return true;
+}
+
+static int _cmp_best_first(const void *a, const void *b) {
+  const eng_top_entry_t *ea = a;
+  const eng_top_entry_t *eb = b;
+  if (ea->count != eb->count) {
+    return ea->count > eb->count ? -1 : 1;
+  }
+  return strcmp(ea->value, eb->value);
+}
+
+void eng_top_heap_sort(eng_top_heap_t *h) {
+  if (h->count > 1) {
+    qsort(h->entries, h->count, sizeof(eng_top_entry_t), _cmp_best_first);
+  }
+}
+
+void eng_top_heap_free(eng_top_heap_t *h) {
+  if (!h) {
+    return;
+  }
+  for (uint32_t i = 0; i < h->count; i++) {
+    free(h->entries[i].value);
+  }
+  free(h->entries);
+  memset(h, 0, sizeof(eng_top_heap_t));
+}
+
+// --- Scans ---
+
+static uint64_t _count(const bitmap_t *bm, const bitmap_t *filter) {
+  return filter ? bitmap_and_cardinality(bm, filter)
+                : bitmap_get_cardinality(bm);
+}
+
+// Events of the value at `entry`, from the cache when it has a newer copy
+static bool _value_count(const eng_top_args_t *args,
+                         const db_cursor_entry_t *entry, uint64_t *count_out) {
+  if (args->cache_get && entry->key_len < TOP_INV_KEY_LEN) {
+    char inv_key[TOP_INV_KEY_LEN];
+    memcpy(inv_key, entry->key, entry->key_len);
+    inv_key[entry->key_len] = '\0';
+    const bitmap_t *cached = args->cache_get(inv_key, args->cache_arg);
+    if (cached) {
+      *count_out = _count(cached, args->filter);
+      return true;
+    }
+  }
+
+  // Read txns outlive the scan, so the value is viewed in place
+  bitmap_t *bm = bitmap_view(entry->value, entry->value_len);
+  if (!bm) {
+    return false;
+  }
+  *count_out = _count(bm, args->filter);
+  bitmap_free(bm);
+  return true;
+}
+
+bool eng_top_values(const eng_top_args_t *args, eng_top_heap_t *heap_out,
+                    const char **err_out) {
+  *err_out = NULL;
+  memset(heap_out, 0, sizeof(eng_top_heap_t));
+  if (!args || !args->txn || !args->key || args->n == 0) {
+    *err_out = "Invalid args";
+    return false;
+  }
+
+  char prefix[MAX_TEXT_VAL_LEN + 2];
+  int plen = snprintf(prefix, sizeof(prefix), "%s:", args->key);
+  if (plen < 0 || (size_t)plen >= sizeof(prefix)) {
+    *err_out = "Tag key too long";
+    return false;
+  }
+  if (!eng_top_heap_init(heap_out, args->n)) {
+    *err_out = "OOM error ranking values";
+    return false;
+  }
+  MDB_cursor *cursor = db_cursor_open(args->txn, args->inverted_db);
+  if (!cursor) {
+    *err_out = "Error reading inverted index";
+    return false;
+  }
+
+  db_key_t start = {.type = DB_KEY_STRING, .key.s = prefix};
+  db_cursor_entry_t entry;
+  db_cursor_get_result_t r =
+      db_cursor_get(cursor, &entry, MDB_SET_RANGE, &start);
+  deadline_status_t ds = DEADLINE_OK;
+  uint32_t steps = 0;
+  bool ok = true;
+  while (r == DB_CURSOR_OK && entry.key_len > (size_t)plen &&
+         memcmp(entry.key, prefix, plen) == 0) {
+    uint64_t count = 0;
+    if (!_value_count(args, &entry, &count)) {
+      *err_out = "Error reading bitmap";
+      ok = false;
+      break;
+    }
+    if (count > 0 &&
+        !eng_top_heap_push(heap_out, (const char *)entry.key + plen,
+                           entry.key_len - plen, count)) {
+      *err_out = "OOM error ranking values";
+      ok = false;
+      break;
+    }
+
+    if (++steps >= TOP_DEADLINE_CHECK_STEPS) {
+      steps = 0;
+      ds = deadline_status(args->deadline);
+      if (ds != DEADLINE_OK) {
+        *err_out = deadline_err_msg(ds);
+        ok = false;
+        break;
+      }
+    }
+    r = db_cursor_get(cursor, &entry, MDB_NEXT, NULL);
+  }
+  db_cursor_close(cursor);
+
+  if (ok && r == DB_CURSOR_ERR) {
+    *err_out = "Error reading inverted index";
+    ok = false;
+  }
+  if (ok) {
+    eng_top_heap_sort(heap_out);
+  }
+  return ok;
+}
+
+bool eng_top_list_keys(MDB_txn *txn, MDB_dbi inverted_db, char ***keys_out,
+                       uint32_t *count_out) {
+  if (!txn || !keys_out || !count_out) {
+    return false;
+  }
+  MDB_cursor *cursor = db_cursor_open(txn, inverted_db);
+  if (!cursor) {
+    return false;
+  }
+
+  char **keys = NULL;
+  uint32_t count = 0;
+  uint32_t cap = 0;
+  bool ok = true;
+  char seek[TOP_INV_KEY_LEN];
+  db_cursor_entry_t entry;
+  db_cursor_get_result_t r = db_cursor_get(cursor, &entry, MDB_FIRST, NULL);
+  while (ok && r == DB_CURSOR_OK) {
+    const char *k = entry.key;
+    size_t n = 0;
+    while (n < entry.key_len && k[n] != ':' && k[n] != '|') {
+      n++;
+    }
+    if (n == entry.key_len || n + 2 > sizeof(seek)) {
+      r = db_cursor_get(cursor, &entry, MDB_NEXT, NULL);
+      continue;
+    }
+
+    // Custom tags are `<key>:<value>`, the rest `<prefix>|...`
+    if (k[n] == ':' && n > 0) {
+      if (count == cap) {
+        cap = cap ? cap * 2 : 16;
+        char **grown = realloc(keys, cap * sizeof(*keys));
+        if (!grown) {
+          ok = false;
+          break;
+        }
+        keys = grown;
+      }
+      keys[count] = strndup(k, n);
+      if (!keys[count]) {
+        ok = false;
+        break;
+      }
+      count++;
+    }
+
+    // Past every key sharing the prefix, e.g. `loc:` seeks to `loc;`
+    memcpy(seek, k, n);
+    seek[n] = (char)(k[n] + 1);
+    seek[n + 1] = '\0';
+    db_key_t next = {.type = DB_KEY_STRING, .key.s = seek};
+    r = db_cursor_get(cursor, &entry, MDB_SET_RANGE, &next);
+  }
+  db_cursor_close(cursor);
+
+  if (!ok || r == DB_CURSOR_ERR) {
+    eng_top_free_keys(keys, count);
+    return false;
+  }
+  *keys_out = keys;
+  *count_out = count;
+  return true;
+}
+
+void eng_top_free_keys(char **keys, uint32_t count) {
+  if (!keys) {
+    return;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    free(keys[i]);
+  }
+  free(keys);
+}
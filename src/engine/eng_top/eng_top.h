@@ -0,0 +1,78 @@
+#ifndef ENG_TOP_H
+#define ENG_TOP_H
+
+#include "core/bitmaps.h"
+#include "core/deadline.h"
+#include "lmdb.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+`TOP <key>` and `SHOW keys`, read straight off the inverted index.
+TOP walks the `<key>:` range once and ranks each value by the cardinality of
+its bitmap, or of its intersection with a filter, without materializing
+either. A bounded min-heap holds the best `n` values, so memory stays flat
+however many values a key has. Values that were never flushed, i.e. only in a
+consumer cache, are not seen. */
+
+typedef struct eng_top_entry_s {
+  char *value;
+  uint64_t count;
+} eng_top_entry_t;
+
+// Best `cap` entries seen so far, `entries[0]` the worst of them
+typedef struct eng_top_heap_s {
+  eng_top_entry_t *entries;
+  uint32_t count;
+  uint32_t cap;
+} eng_top_heap_t;
+
+bool eng_top_heap_init(eng_top_heap_t *h, uint32_t cap);
+
+/**
+ * Offer `value`, copied only if it makes the cut. Higher counts rank first,
+ * equal counts keep the value offered first
+ */
+bool eng_top_heap_push(eng_top_heap_t *h, const char *value, size_t value_len,
+                       uint64_t count);
+
+// Sort the entries best first. The heap is unusable for pushes afterwards
+void eng_top_heap_sort(eng_top_heap_t *h);
+
+void eng_top_heap_free(eng_top_heap_t *h);
+
+// Newer copy of the bitmap at `inv_key`, NULL to read the LMDB one
+typedef const bitmap_t *(*eng_top_cache_fn)(const char *inv_key, void *arg);
+
+typedef struct eng_top_args_s {
+  MDB_txn *txn;
+  MDB_dbi inverted_db;
+  const char *key;
+  uint32_t n;
+  // Optional, counts only the events in it
+  const bitmap_t *filter;
+  // Optional
+  eng_top_cache_fn cache_get;
+  void *cache_arg;
+  // Optional
+  const deadline_t *deadline;
+} eng_top_args_t;
+
+/**
+ * Best `n` values of `key` by event count, best first into `heap_out`.
+ * Values with no matching events are left out. Caller frees the heap with
+ * `eng_top_heap_free`, also on failure
+ */
+bool eng_top_values(const eng_top_args_t *args, eng_top_heap_t *heap_out,
+                    const char **err_out);
+
+/**
+ * Custom tag keys of the inverted index, in key order. Skips over the values
+ * of each key with one seek. Caller frees them with `eng_top_free_keys`
+ */
+bool eng_top_list_keys(MDB_txn *txn, MDB_dbi inverted_db, char ***keys_out,
+                       uint32_t *count_out);
+
+void eng_top_free_keys(char **keys, uint32_t count);
+
+#endif
@@ -2,21 +2,46 @@
 #include "cmd_context/cmd_context.h"
 #include "container/container.h"
 #include "core/bitmaps.h"
+#include "core/conversions.h"
 #include "core/data_constants.h"
 #include "core/db.h"
+#include "core/deadline.h"
+#include "core/ebr.h"
 #include "core/hash.h"
 #include "engine/api.h"
 #include "engine/cmd_queue/cmd_queue.h"
 #include "engine/consumer/consumer.h"
+#include "engine/consumer/consumer_cache.h"
 #include "engine/container/container_types.h"
+#include "engine/eng_entities/eng_entities.h"
 #include "engine/eng_eval/eng_eval.h"
+#include "engine/eng_fetch/eng_fetch.h"
+#include "engine/eng_funnel/eng_funnel.h"
+#include "engine/eng_histogram/eng_histogram.h"
+#include "engine/eng_key_format/eng_key_format.h"
+#include "engine/eng_profile/eng_profile.h"
 #include "engine/eng_query/eng_query.h"
+#include "engine/eng_rollup/eng_rollup.h"
+#include "engine/eng_sample/eng_sample.h"
+#include "engine/eng_top/eng_top.h"
 #include "engine/index/index.h"
+#include "engine/index_backfill/index_backfill.h"
+#include "engine/op/op.h"
 #include "engine/op_queue/op_queue.h"
+#include "engine/page_session/page_session.h"
+#include "engine/range_pool/range_pool.h"
+#include "engine/read_cache/read_cache.h"
+#include "engine/rollup/rollup.h"
+#include "engine/routing/routing.h"
+#include "engine/subscription/subscription.h"
+#include "engine/tag_stats/tag_stats.h"
+#include "engine/view/view.h"
+#include "engine/watermark/watermark.h"
 #include "engine/worker/worker.h"
 #include "engine_writer/engine_writer.h"
 #include "lmdb.h"
 #include "log/log.h"
+#include "mpack.h"
 #include "query/ast.h"
 #include <stdatomic.h>
 #include <stdbool.h>
@@ -29,6 +54,13 @@ LOG_INIT(engine);
 
 #define CONTAINER_FOLDER "data"
 #define DC_CACHE_CAPACITY 128
+// Shared read-side bitmap cache, see read_cache.h
+#define READ_CACHE_MAX_BYTES (256UL * 1024 * 1024)
+// Results kept by `session:` queries, see page_session.h
+#define PAGE_SESSION_MAX_BYTES (64UL * 1024 * 1024)
+#define PAGE_SESSION_TTL_MS (60 * 1000)
+// Events buffered per live subscriber before it is dropped as too slow
+#define SUB_BUFFER_EVENTS 4096
 
 #define NUM_CMD_QUEUEs 16
 #define CMD_QUEUE_MASK (NUM_CMD_QUEUEs - 1)
@@ -42,11 +74,20 @@ LOG_INIT(engine);
 #define NUM_CONSUMERS 4
 #define OP_QUEUES_PER_CONSUMER 4
 
+// Helpers that fetches, scans and funnels split their ranges across, next
+// to the query's own thread. See range_pool.h
+#define RANGE_POOL_THREADS (ENG_FETCH_MAX_THREADS - 1)
+
+// Index backfill pacing, see index_backfill.h
+#define BACKFILL_CHUNK_EVENTS 1024
+#define BACKFILL_THROTTLE_MS 5
+
 cmd_queue_t g_cmd_queues[NUM_CMD_QUEUEs];
 worker_t g_workers[NUM_WORKERS];
 op_queue_t g_op_queues[NUM_OP_QUEUES];
 eng_writer_t g_eng_writer;
 consumer_t g_consumers[NUM_CONSUMERS];
+index_backfill_t g_index_backfill;
 
 // Initialize the db engine. Called at startup.
 bool eng_init(void) {
@@ -71,6 +112,43 @@ bool eng_init(void) {
   LOG_ACTION_INFO(ACT_SUBSYSTEM_INIT, "subsystem=container cache_capacity=%d",
                   DC_CACHE_CAPACITY);
 
+  if (!read_cache_init(READ_CACHE_MAX_BYTES)) {
+    LOG_ACTION_FATAL(ACT_SUBSYSTEM_INIT_FAILED, "subsystem=read_cache");
+    container_shutdown();
+    return NULL;
+  }
+  LOG_ACTION_INFO(ACT_SUBSYSTEM_INIT, "subsystem=read_cache max_bytes=%zu",
+                  (size_t)READ_CACHE_MAX_BYTES);
+
+  if (!page_session_init(PAGE_SESSION_MAX_BYTES, PAGE_SESSION_TTL_MS)) {
+    LOG_ACTION_FATAL(ACT_SUBSYSTEM_INIT_FAILED, "subsystem=page_session");
+    read_cache_destroy();
+    container_shutdown();
+    return NULL;
+  }
+  LOG_ACTION_INFO(ACT_SUBSYSTEM_INIT,
+                  "subsystem=page_session max_bytes=%zu ttl_ms=%d",
+                  (size_t)PAGE_SESSION_MAX_BYTES, PAGE_SESSION_TTL_MS);
+
+  if (!range_pool_init(RANGE_POOL_THREADS)) {
+    LOG_ACTION_FATAL(ACT_SUBSYSTEM_INIT_FAILED, "subsystem=range_pool");
+    page_session_destroy();
+    read_cache_destroy();
+    container_shutdown();
+    return NULL;
+  }
+  LOG_ACTION_INFO(ACT_SUBSYSTEM_INIT, "subsystem=range_pool threads=%d",
+                  RANGE_POOL_THREADS);
+
+  if (!sub_registry_init()) {
+    LOG_ACTION_FATAL(ACT_SUBSYSTEM_INIT_FAILED, "subsystem=subscription");
+    range_pool_destroy();
+    page_session_destroy();
+    read_cache_destroy();
+    container_shutdown();
+    return NULL;
+  }
+
   // Get system container
   container_result_t sys_result = container_get_system();
   if (!sys_result.success) {
@@ -147,6 +225,14 @@ bool eng_init(void) {
                   "thread_type=consumer count=%d status=complete",
                   NUM_CONSUMERS);
 
+  // Event ids are assigned as events are queued, see watermark.h
+  if (!watermark_init(NUM_CMD_QUEUEs, NUM_WORKERS, NUM_OP_QUEUES)) {
+    LOG_ACTION_FATAL(ACT_SUBSYSTEM_INIT_FAILED, "subsystem=watermark");
+    container_shutdown();
+    return NULL;
+  }
+  LOG_ACTION_INFO(ACT_SUBSYSTEM_INIT, "subsystem=watermark");
+
   // Initialize global worker state
   if (!worker_init_global().success) {
     LOG_ACTION_FATAL(ACT_SUBSYSTEM_INIT_FAILED, "subsystem=worker_global");
@@ -165,7 +251,8 @@ bool eng_init(void) {
         .cmd_queue_consume_start = i * CMD_QUEUES_PER_WORKER,
         .cmd_queue_consume_count = CMD_QUEUES_PER_WORKER,
         .op_queues = g_op_queues,
-        .op_queue_total_count = NUM_OP_QUEUES};
+        .op_queue_total_count = NUM_OP_QUEUES,
+        .worker_id = i};
 
     if (!worker_start(&g_workers[i], &worker_config).success) {
       LOG_ACTION_FATAL(ACT_THREAD_START_FAILED,
@@ -185,6 +272,19 @@ bool eng_init(void) {
   LOG_ACTION_INFO(ACT_THREAD_POOL_STARTING,
                   "thread_type=worker count=%d status=complete", NUM_WORKERS);
 
+  // Start index backfill, after the writer that indexes new events
+  index_backfill_config_t backfill_config = {
+      .chunk_events = BACKFILL_CHUNK_EVENTS,
+      .throttle_ms = BACKFILL_THROTTLE_MS,
+      .op_queues = g_op_queues,
+      .op_queue_total_count = NUM_OP_QUEUES};
+  if (!index_backfill_start(&g_index_backfill, &backfill_config)) {
+    LOG_ACTION_FATAL(ACT_THREAD_START_FAILED, "thread_type=backfill");
+    container_shutdown();
+    return NULL;
+  }
+  LOG_ACTION_INFO(ACT_THREAD_STARTED, "thread_type=backfill");
+
   LOG_ACTION_INFO(ACT_SYSTEM_INIT, "component=engine status=complete");
   return true;
 }
@@ -193,6 +293,13 @@ bool eng_init(void) {
 void eng_shutdown(void) {
   LOG_ACTION_INFO(ACT_SYSTEM_SHUTDOWN, "component=engine");
 
+  // Stop index backfill, it holds a container while a job runs
+  LOG_ACTION_INFO(ACT_THREAD_STOPPING, "thread_type=backfill");
+  if (!index_backfill_stop(&g_index_backfill)) {
+    LOG_ACTION_ERROR(ACT_THREAD_STOP_FAILED, "thread_type=backfill");
+  }
+  LOG_ACTION_INFO(ACT_THREAD_STOPPED, "thread_type=backfill");
+
   // Stop worker threads
   LOG_ACTION_INFO(ACT_THREAD_POOL_STOPPING, "thread_type=worker count=%d",
                   NUM_WORKERS);
@@ -205,8 +312,6 @@ void eng_shutdown(void) {
   LOG_ACTION_INFO(ACT_THREAD_POOL_STOPPING,
                   "thread_type=worker status=complete");
 
-  worker_destroy_global();
-
   // Stop engine writer before consumers
   LOG_ACTION_INFO(ACT_THREAD_STOPPING, "thread_type=writer");
   if (!eng_writer_stop(&g_eng_writer)) {
@@ -226,6 +331,33 @@ void eng_shutdown(void) {
   LOG_ACTION_INFO(ACT_THREAD_POOL_STOPPING,
                   "thread_type=consumer status=complete");
 
+  // Nothing is queued or applied anymore
+  watermark_destroy();
+
+  // No queries left, so no readers
+  read_cache_stats_t rc_stats;
+  read_cache_get_stats(&rc_stats);
+  LOG_ACTION_INFO(ACT_SUBSYSTEM_SHUTDOWN,
+                  "subsystem=read_cache hits=%llu misses=%llu evictions=%llu",
+                  (unsigned long long)rc_stats.hits,
+                  (unsigned long long)rc_stats.misses,
+                  (unsigned long long)rc_stats.evictions);
+  read_cache_destroy();
+  page_session_stats_t ps_stats;
+  page_session_get_stats(&ps_stats);
+  LOG_ACTION_INFO(ACT_SUBSYSTEM_SHUTDOWN,
+                  "subsystem=page_session hits=%llu misses=%llu "
+                  "evictions=%llu expirations=%llu",
+                  (unsigned long long)ps_stats.hits,
+                  (unsigned long long)ps_stats.misses,
+                  (unsigned long long)ps_stats.evictions,
+                  (unsigned long long)ps_stats.expirations);
+  page_session_destroy();
+  range_pool_destroy();
+  eng_sample_shutdown();
+  // Writer is stopped, nothing delivers to subscriptions anymore
+  sub_registry_destroy();
+
   // Shutdown container subsystem (closes all containers)
   LOG_ACTION_INFO(ACT_SUBSYSTEM_SHUTDOWN, "subsystem=container");
   container_shutdown();
@@ -245,14 +377,66 @@ void eng_shutdown(void) {
   LOG_ACTION_INFO(ACT_SYSTEM_SHUTDOWN, "component=engine status=complete");
 }
 
-// Takes ownership of `cmd_ctx` (and its contained AST)
-static bool _eng_enqueue_cmd(cmd_ctx_t *command) {
+// Event ids of `container_name`, creating the container on first use like
+// workers do
+static wm_container_t *_get_wm_container(const char *container_name) {
+  wm_container_t *wm = watermark_find(container_name);
+  if (wm) {
+    return wm;
+  }
+
+  container_result_t cr = container_get_user(container_name, true, NULL);
+  if (!cr.success) {
+    LOG_ACTION_ERROR(ACT_CONTAINER_OPEN_FAILED, "container=\"%s\"",
+                     container_name);
+    return NULL;
+  }
+  MDB_txn *txn = db_create_txn(cr.container->env, true);
+  if (!txn) {
+    LOG_ACTION_ERROR(ACT_TXN_BEGIN, "err=\"failed\" container=\"%s\"",
+                     container_name);
+    container_release(cr.container);
+    return NULL;
+  }
+
+  db_get_result_t gr = {0};
+  db_key_t db_key = {.type = DB_KEY_STRING, .key.s = USR_NEXT_EVENT_ID_KEY};
+  bool ok = db_get(cr.container->data.usr->user_dc_metadata_db, txn, &db_key,
+                   &gr);
+  uint32_t next = USR_NEXT_EVENT_ID_INIT_VAL;
+  if (ok && gr.status == DB_GET_OK) {
+    memcpy(&next, gr.value, sizeof(uint32_t));
+  }
+  if (ok) {
+    db_get_result_clear(&gr);
+  }
+  db_abort_txn(txn);
+  container_release(cr.container);
+  if (!ok) {
+    LOG_ACTION_ERROR(ACT_DB_READ_FAILED,
+                     "context=\"next_event_id\" container=\"%s\"",
+                     container_name);
+    return NULL;
+  }
+
+  LOG_ACTION_INFO(ACT_COUNTER_INIT,
+                  "counter_type=event_id container=\"%s\" value=%u",
+                  container_name, next);
+  return watermark_add(container_name, next);
+}
+
+// Takes ownership of `cmd_ctx` (and its contained AST). The event's id is
+// assigned as it is queued, so a cmd queue holds a container's events in id
+// order
+static bool _eng_enqueue_cmd(cmd_ctx_t *command, wm_container_t *wm,
+                             uint32_t *event_id_out) {
   cmd_queue_msg_t *msg = cmd_queue_create_msg(command);
   if (!msg) {
     LOG_ACTION_ERROR(ACT_MSG_CREATE_FAILED, "msg_type=cmd");
     cmd_context_free(command);
     return false;
   }
+  msg->wm = wm;
 
   unsigned long hash = 0;
   if (command->entity_tag_value->literal.type == AST_LITERAL_STRING) {
@@ -273,7 +457,12 @@ static bool _eng_enqueue_cmd(cmd_ctx_t *command) {
     return false;
   }
 
-  if (!cmd_queue_enqueue(queue, msg)) {
+  // `msg` belongs to the worker once queued
+  uint32_t event_id = watermark_assign_begin(wm);
+  msg->event_id = event_id;
+  bool queued = cmd_queue_enqueue(queue, msg);
+  watermark_assign_end(wm, queue_idx, event_id, queued);
+  if (!queued) {
     LOG_ACTION_WARN(ACT_QUEUE_FULL, "queue_type=cmd queue_id=%d", queue_idx);
     cmd_queue_free_msg(msg);
     return false;
@@ -281,6 +470,7 @@ static bool _eng_enqueue_cmd(cmd_ctx_t *command) {
 
   LOG_ACTION_DEBUG(ACT_MSG_ENQUEUED, "msg_type=cmd queue_id=%d status=success",
                    queue_idx);
+  *event_id_out = event_id;
   return true;
 }
 
@@ -294,7 +484,16 @@ void eng_event(api_response_t *r, ast_node_t *ast, int64_t arrival_ts) {
     return;
   }
 
-  if (!_eng_enqueue_cmd(cmd_ctx)) {
+  wm_container_t *wm =
+      _get_wm_container(cmd_ctx->in_tag_value->literal.string_value);
+  if (!wm) {
+    r->err_msg = "Unable to open container";
+    cmd_context_free(cmd_ctx);
+    return;
+  }
+
+  uint32_t event_id = 0;
+  if (!_eng_enqueue_cmd(cmd_ctx, wm, &event_id)) {
     LOG_ACTION_WARN(ACT_CMD_ENQUEUE_FAILED,
                     "context=eng_event reason=rate_limit");
     r->err_msg = "Rate limit error, please try again";
@@ -303,6 +502,9 @@ void eng_event(api_response_t *r, ast_node_t *ast, int64_t arrival_ts) {
 
   r->is_ok = true;
   r->resp_type = API_RESP_TYPE_ACK;
+  // For `after:`, see watermark.h
+  r->payload.watermark.container_name = watermark_container_name(wm);
+  r->payload.watermark.event_id = event_id;
 }
 
 // Takes ownership of `ast`
@@ -317,6 +519,15 @@ void eng_index(api_response_t *r, ast_node_t *ast) {
 
   index_def_t index_def = {.key = cmd_ctx->key_tag_value->literal.string_value,
                            .type = INDEX_TYPE_I64};
+  // Optional `type:<i64|f64|str>`, checked by the validator
+  ast_node_t *type_tag = ast_find_custom_tag(&cmd_ctx->ast->command, "type");
+  if (type_tag &&
+      !index_type_from_str(type_tag->tag.value->literal.string_value,
+                           &index_def.type)) {
+    cmd_context_free(cmd_ctx);
+    r->err_msg = "Unknown index type";
+    return;
+  }
 
   container_result_t scr = container_get_system();
   if (!scr.success) {
@@ -331,6 +542,13 @@ void eng_index(api_response_t *r, ast_node_t *ast) {
 
   switch (pr) {
   case DB_PUT_OK:
+    // Containers created from here on get the index on creation
+    if (!index_backfill_schedule(&g_index_backfill, index_def.key)) {
+      LOG_ACTION_ERROR(ACT_BACKFILL_FAILED, "key=\"%s\" err=\"schedule\"",
+                       index_def.key);
+      r->err_msg = "Error scheduling index backfill";
+      break;
+    }
     r->is_ok = true;
     r->resp_type = API_RESP_TYPE_ACK;
     break;
@@ -346,8 +564,430 @@ void eng_index(api_response_t *r, ast_node_t *ast) {
   cmd_context_free(cmd_ctx);
 }
 
+// One status object per pending index backfill
+static bool _show_backfills(api_response_t *r) {
+  index_backfill_status_t *jobs = NULL;
+  uint32_t count = 0;
+  if (!index_backfill_list(&jobs, &count)) {
+    return false;
+  }
+  api_obj_t *objs = count ? calloc(count, sizeof(api_obj_t)) : NULL;
+  bool ok = count == 0 || objs != NULL;
+  for (uint32_t i = 0; ok && i < count; i++) {
+    mpack_writer_t writer;
+    mpack_writer_init_growable(&writer, &objs[i].data, &objs[i].data_size);
+    mpack_start_map(&writer, 3);
+    mpack_write_cstr(&writer, "container");
+    mpack_write_cstr(&writer, jobs[i].container_name);
+    mpack_write_cstr(&writer, "key");
+    mpack_write_cstr(&writer, jobs[i].key);
+    mpack_write_cstr(&writer, "next_event_id");
+    mpack_write_u32(&writer, jobs[i].next_event_id);
+    mpack_finish_map(&writer);
+    ok = mpack_writer_destroy(&writer) == mpack_ok;
+  }
+  index_backfill_free_list(jobs, count);
+
+  // Freed with the response, partially built objects included
+  r->resp_type = API_RESP_TYPE_LIST_OBJ;
+  r->payload.list_obj.type = API_OBJ_TYPE_STATUS;
+  r->payload.list_obj.objects = objs;
+  r->payload.list_obj.count = objs ? count : 0;
+  return ok;
+}
+
+static void _write_tag_stats(mpack_writer_t *writer,
+                             const tag_stats_entry_t *entry) {
+  uint32_t buckets = 0;
+  for (uint32_t b = 0; entry->stats.has_hist && b < TAG_STATS_HIST_BUCKETS;
+       b++) {
+    buckets += entry->stats.hist[b] > 0;
+  }
+  mpack_start_map(writer, entry->stats.has_hist ? 4 : 3);
+  mpack_write_cstr(writer, "key");
+  mpack_write_cstr(writer, entry->key);
+  mpack_write_cstr(writer, "distinct");
+  mpack_write_u64(writer, entry->stats.distinct);
+  mpack_write_cstr(writer, "events");
+  mpack_write_u64(writer, entry->stats.events);
+  if (entry->stats.has_hist) {
+    // Non-empty log2 buckets, each counting events with values from `min`
+    // up to the next bucket's `min`
+    mpack_write_cstr(writer, "histogram");
+    mpack_start_array(writer, buckets);
+    for (uint32_t b = 0; b < TAG_STATS_HIST_BUCKETS; b++) {
+      if (entry->stats.hist[b] == 0) {
+        continue;
+      }
+      mpack_start_map(writer, 2);
+      mpack_write_cstr(writer, "min");
+      mpack_write_u64(writer, tag_stats_bucket_min(b));
+      mpack_write_cstr(writer, "count");
+      mpack_write_u64(writer, entry->stats.hist[b]);
+      mpack_finish_map(writer);
+    }
+    mpack_finish_array(writer);
+  }
+  mpack_finish_map(writer);
+}
+
+// One object per tag key of the container, from its tag stats
+static bool _show_stats(api_response_t *r, const char *container_name) {
+  container_result_t cr = container_get_user(container_name, false, NULL);
+  if (!cr.success) {
+    r->err_msg =
+        cr.error_msg != NULL ? cr.error_msg : "Error getting user container";
+    return false;
+  }
+  eng_container_t *c = cr.container;
+  MDB_txn *txn = db_create_txn(c->env, true);
+  tag_stats_entry_t *entries = NULL;
+  uint32_t count = 0;
+  bool listed =
+      txn && tag_stats_list(txn, c->data.usr->tag_stats_db, &entries, &count);
+  if (txn) {
+    db_abort_txn(txn);
+  }
+  container_release(c);
+  if (!listed) {
+    r->err_msg = "Error listing stats";
+    return false;
+  }
+
+  api_obj_t *objs = count ? calloc(count, sizeof(api_obj_t)) : NULL;
+  bool ok = count == 0 || objs != NULL;
+  for (uint32_t i = 0; ok && i < count; i++) {
+    mpack_writer_t writer;
+    mpack_writer_init_growable(&writer, &objs[i].data, &objs[i].data_size);
+    _write_tag_stats(&writer, &entries[i]);
+    ok = mpack_writer_destroy(&writer) == mpack_ok;
+  }
+  tag_stats_free_list(entries, count);
+
+  // Freed with the response, partially built objects included
+  r->resp_type = API_RESP_TYPE_LIST_OBJ;
+  r->payload.list_obj.type = API_OBJ_TYPE_STATUS;
+  r->payload.list_obj.objects = objs;
+  r->payload.list_obj.count = objs ? count : 0;
+  if (!ok) {
+    r->err_msg = "Error listing stats";
+  }
+  return ok;
+}
+
+// One object per custom tag key of the container, from its inverted index
+static bool _show_keys(api_response_t *r, const char *container_name) {
+  container_result_t cr = container_get_user(container_name, false, NULL);
+  if (!cr.success) {
+    r->err_msg =
+        cr.error_msg != NULL ? cr.error_msg : "Error getting user container";
+    return false;
+  }
+  eng_container_t *c = cr.container;
+  MDB_txn *txn = db_create_txn(c->env, true);
+  char **keys = NULL;
+  uint32_t count = 0;
+  bool listed =
+      txn && eng_top_list_keys(txn, c->data.usr->inverted_event_index_db,
+                               &keys, &count);
+  if (txn) {
+    db_abort_txn(txn);
+  }
+  container_release(c);
+  if (!listed) {
+    r->err_msg = "Error listing keys";
+    return false;
+  }
+
+  api_obj_t *objs = count ? calloc(count, sizeof(api_obj_t)) : NULL;
+  bool ok = count == 0 || objs != NULL;
+  for (uint32_t i = 0; ok && i < count; i++) {
+    mpack_writer_t writer;
+    mpack_writer_init_growable(&writer, &objs[i].data, &objs[i].data_size);
+    mpack_start_map(&writer, 1);
+    mpack_write_cstr(&writer, "key");
+    mpack_write_cstr(&writer, keys[i]);
+    mpack_finish_map(&writer);
+    ok = mpack_writer_destroy(&writer) == mpack_ok;
+  }
+  eng_top_free_keys(keys, count);
+
+  // Freed with the response, partially built objects included
+  r->resp_type = API_RESP_TYPE_LIST_OBJ;
+  r->payload.list_obj.type = API_OBJ_TYPE_STATUS;
+  r->payload.list_obj.objects = objs;
+  r->payload.list_obj.count = objs ? count : 0;
+  if (!ok) {
+    r->err_msg = "Error listing keys";
+  }
+  return ok;
+}
+
+// Takes ownership of `ast`
+void eng_show(api_response_t *r, ast_node_t *ast) {
+  cmd_ctx_t *cmd_ctx = build_cmd_context(ast, -1);
+  if (!cmd_ctx) {
+    LOG_ACTION_ERROR(ACT_CMD_CTX_BUILD_FAILED, "context=eng_show");
+    r->err_msg = "Error generating command context";
+    ast_free(ast);
+    return;
+  }
+
+  // The validator only lets known targets through
+  const char *target = cmd_ctx->target_tag_value->literal.string_value;
+  if (strcmp(target, "backfills") == 0) {
+    if (_show_backfills(r)) {
+      r->is_ok = true;
+    } else {
+      r->err_msg = "Error listing backfills";
+    }
+  } else if (strcmp(target, "stats") == 0) {
+    r->is_ok = _show_stats(r, cmd_ctx->in_tag_value->literal.string_value);
+  } else if (strcmp(target, "keys") == 0) {
+    r->is_ok = _show_keys(r, cmd_ctx->in_tag_value->literal.string_value);
+  } else {
+    r->err_msg = "Unknown SHOW target";
+  }
+  cmd_context_free(cmd_ctx);
+}
+
+// Comparisons read numeric indexes, which must exist for the backfill. `~`
+// is never answered by one
+static bool _exp_indexes_exist(ast_node_t *node, eng_user_dc_t *usr) {
+  index_t index;
+  switch (node->type) {
+  case AST_COMPARISON_NODE: {
+    if (node->comparison.op == AST_OP_CONTAINS) {
+      return false;
+    }
+    ast_node_t *key = node->comparison.left->literal.type == AST_LITERAL_STRING
+                          ? node->comparison.left
+                          : node->comparison.right;
+    return index_get(key->literal.string_value,
+                     atomic_load(&usr->key_to_index), &index) &&
+           !index.building;
+  }
+  case AST_LOGICAL_NODE:
+    return _exp_indexes_exist(node->logical.left_operand, usr) &&
+           _exp_indexes_exist(node->logical.right_operand, usr);
+  case AST_NOT_NODE:
+    return _exp_indexes_exist(node->not_op.operand, usr);
+  default:
+    return true;
+  }
+}
+
+// Union the view's result over events that are already indexed into the
+// view bitmap. Runs after the view is published, so workers cover newer
+// events. Events processed against the old view set were queued before the
+// publish, and are waited for first.
+static bool _backfill_view(const char *name, ast_node_t *where,
+                           eng_container_t *sys_c, MDB_txn *sys_txn,
+                           eng_container_t *usr_c) {
+  deadline_t deadline;
+  deadline_init(&deadline, 0, NULL);
+  if (watermark_wait_queued(usr_c->name, &deadline) != WATERMARK_REACHED) {
+    return false;
+  }
+
+  uint64_t commit_seq = container_get_commit_seq(usr_c);
+  MDB_txn *user_txn = db_create_txn(usr_c->env, true);
+  if (!user_txn) {
+    return false;
+  }
+
+  eval_config_t config = {.container = usr_c,
+                          .sys_container = sys_c,
+                          .sys_txn = sys_txn,
+                          .user_txn = user_txn,
+                          .consumers = g_consumers,
+                          .op_queue_total_count = NUM_OP_QUEUES,
+                          .op_queues_per_consumer = OP_QUEUES_PER_CONSUMER,
+                          .commit_seq = commit_seq,
+                          .deadline = &deadline};
+  eval_state_t state = {0};
+  eval_ctx_t ctx = {.config = &config, .state = &state};
+
+  ck_epoch_section_t section;
+  ebr_begin(&section);
+  eng_eval_result_t er = eng_eval_resolve_exp_to_events(where, &ctx);
+  ebr_end(&section);
+  ebr_poll_nonblocking();
+  eng_eval_cleanup_state(&state);
+  db_abort_txn(user_txn);
+
+  if (!er.success) {
+    LOG_ACTION_ERROR(ACT_QUERY_ERROR, "context=backfill_view err=\"%s\"",
+                     er.err_msg);
+    return false;
+  }
+  if (bitmap_is_empty(er.events)) {
+    bitmap_free(er.events);
+    return true;
+  }
+
+  char view_key[MAX_TEXT_VAL_LEN];
+  char ser_db_key[512];
+  eng_container_db_key_t db_key = {.dc_type = CONTAINER_TYPE_USR,
+                                   .usr_db_type = USR_DB_INVERTED_EVENT_INDEX};
+  db_key.db_key.type = DB_KEY_STRING;
+  if (!view_key_into(view_key, sizeof(view_key), name)) {
+    bitmap_free(er.events);
+    return false;
+  }
+  db_key.container_name = strdup(usr_c->name);
+  db_key.db_key.key.s = strdup(view_key);
+  if (!db_key.container_name || !db_key.db_key.key.s ||
+      !db_key_into(ser_db_key, sizeof(ser_db_key), &db_key)) {
+    container_free_db_key_contents(&db_key);
+    bitmap_free(er.events);
+    return false;
+  }
+
+  // The op owns the db key contents and the bitmap from here on
+  op_t *op = op_create_or(&db_key, er.events);
+  if (!op) {
+    container_free_db_key_contents(&db_key);
+    bitmap_free(er.events);
+    return false;
+  }
+  op_queue_msg_t *msg = op_queue_msg_create(ser_db_key, op);
+  if (!msg) {
+    op_destroy(op);
+    return false;
+  }
+
+  int queue_idx = route_key_to_queue(ser_db_key, NUM_OP_QUEUES);
+  if (!op_queue_enqueue(&g_op_queues[queue_idx], msg)) {
+    LOG_ACTION_WARN(ACT_QUEUE_FULL, "queue_type=op queue_id=%d", queue_idx);
+    op_queue_msg_free(msg);
+    return false;
+  }
+  return true;
+}
+
+// Takes ownership of `ast`
+void eng_create_view(api_response_t *r, ast_node_t *ast) {
+  cmd_ctx_t *cmd_ctx = build_cmd_context(ast, -1);
+  if (!cmd_ctx) {
+    LOG_ACTION_ERROR(ACT_CMD_CTX_BUILD_FAILED, "context=eng_create_view");
+    r->err_msg = "Error generating command context";
+    ast_free(ast);
+    return;
+  }
+  const char *name = cmd_ctx->view_tag_value->literal.string_value;
+  ast_node_t *where = cmd_ctx->where_tag_value;
+
+  container_result_t scr = container_get_system();
+  if (!scr.success) {
+    cmd_context_free(cmd_ctx);
+    r->err_msg = "Unable to get sys container";
+    return;
+  }
+  MDB_txn *sys_txn = db_create_txn(scr.container->env, true);
+  if (!sys_txn) {
+    cmd_context_free(cmd_ctx);
+    r->err_msg = "Unable to get sys txn";
+    return;
+  }
+  // Views may be defined before the first event arrives
+  container_result_t cr = container_get_user(
+      cmd_ctx->in_tag_value->literal.string_value, true, sys_txn);
+  if (!cr.success) {
+    db_abort_txn(sys_txn);
+    cmd_context_free(cmd_ctx);
+    r->err_msg =
+        cr.error_msg != NULL ? cr.error_msg : "Error getting user container";
+    return;
+  }
+  eng_user_dc_t *usr = cr.container->data.usr;
+
+  char *exp_data = NULL;
+  size_t exp_size = 0;
+  if (!_exp_indexes_exist(where, usr)) {
+    r->err_msg = "Index does not exist for tag key.";
+  } else if (!view_encode_exp(where, &exp_data, &exp_size)) {
+    r->err_msg = "Error encoding view";
+  } else {
+    switch (view_add(name, exp_data, exp_size, cr.container->env,
+                     usr->user_dc_metadata_db)) {
+    case DB_PUT_OK:
+      // Workers match events against the view from here on
+      if (!view_publish(&usr->views, name, exp_data, exp_size)) {
+        r->err_msg = "Error adding view";
+      } else if (!_backfill_view(name, where, scr.container, sys_txn,
+                                 cr.container)) {
+        r->err_msg = "Error backfilling view";
+      } else {
+        r->is_ok = true;
+        r->resp_type = API_RESP_TYPE_ACK;
+      }
+      break;
+    case DB_PUT_KEY_EXISTS:
+      r->err_msg = "Duplicate view";
+      break;
+    case DB_PUT_ERR:
+      r->err_msg = "Error adding view";
+      break;
+    }
+  }
+
+  free(exp_data);
+  container_release(cr.container);
+  db_abort_txn(sys_txn);
+  cmd_context_free(cmd_ctx);
+}
+
+// Takes ownership of `ast`. On success the response holds an unregistered
+// subscription, see subscription.h
+void eng_subscribe(api_response_t *r, ast_node_t *ast) {
+  ast_node_t *where = NULL;
+  const char *container_name = NULL;
+  for (ast_node_t *tag = ast->command.tags; tag; tag = tag->next) {
+    if (tag->tag.key_type != AST_TAG_KEY_RESERVED) {
+      continue;
+    }
+    if (tag->tag.reserved_key == AST_KW_WHERE) {
+      // The subscription keeps the expression
+      where = tag->tag.value;
+      tag->tag.value = NULL;
+    } else if (tag->tag.reserved_key == AST_KW_IN) {
+      container_name = tag->tag.value->literal.string_value;
+    }
+  }
+
+  sub_t *sub = sub_create(container_name, where, SUB_BUFFER_EVENTS);
+  ast_free(ast);
+  if (!sub) {
+    r->err_msg = "Error creating subscription";
+    return;
+  }
+  r->is_ok = true;
+  r->resp_type = API_RESP_TYPE_SUBSCRIPTION;
+  r->payload.sub = sub;
+}
+
+// Returns NULL if the query has no `fields:` option
+static eng_fetch_fields_t *_fetch_fields(ast_node_t *fields_tag_value,
+                                         eng_fetch_fields_t *out) {
+  if (!fields_tag_value) {
+    return NULL;
+  }
+  out->count = 0;
+  for (ast_node_t *f = fields_tag_value; f && out->count < MAX_QUERY_FIELDS;
+       f = f->next) {
+    out->names[out->count] = f->literal.string_value;
+    out->lens[out->count] = f->literal.string_value_len;
+    out->count++;
+  }
+  return out;
+}
+
 static void _handle_query_result(eng_query_result_t *query_r, api_response_t *r,
-                                 MDB_txn *usr_txn, eng_container_t *usr_c) {
+                                 MDB_txn *usr_txn, eng_container_t *usr_c,
+                                 const eng_fetch_fields_t *fields,
+                                 const deadline_t *deadline,
+                                 eng_profile_t *profile) {
   r->is_ok = false;
   r->err_msg = query_r->err_msg;
 
@@ -368,51 +1008,203 @@ static void _handle_query_result(eng_query_result_t *query_r, api_response_t *r,
     return;
   }
 
-  roaring_uint32_iterator_t *it = bitmap_iterator_create(query_r->events);
-  if (!it) {
-    r->err_msg = "Iterator error handling query result";
+  uint32_t *event_ids = malloc(count * sizeof(uint32_t));
+  if (!event_ids) {
+    r->err_msg = "OOM error handling query result";
     bitmap_free(query_r->events);
     return;
   }
+  bitmap_to_uint32_array(query_r->events, event_ids);
 
-  db_get_result_t db_r = {0};
-  db_key_t db_k = {.type = DB_KEY_U32, .key = {.u32 = 0}};
-  MDB_dbi db = usr_c->data.usr->events_db;
-  int i = 0;
-  r->payload.list_obj.count = 0;
-
-  while (it->has_value) {
-    uint32_t event_id = it->current_value;
-    db_k.key.u32 = event_id;
-    if (!db_get(db, usr_txn, &db_k, &db_r) || db_r.status != DB_GET_OK) {
-      LOG_ACTION_DEBUG(ACT_RACE_CONDITION,
-                       "context=handle_query_result msg=\"Event ID indexed but "
-                       "msgpack isn't in LMDB yet\" event_id=%d",
-                       event_id);
-      // TODO: handle error better, skip for now
-      roaring_uint32_iterator_advance(it);
-      continue;
-    }
-
-    api_obj_t *o = &r->payload.list_obj.objects[i++];
-    o->id = event_id;
-    o->data = db_r.value;
-    o->data_size = db_r.value_len;
-
-    // Do not clear db result as we do not want to free `db_r.value`
+  uint32_t found = 0;
+  uint64_t fetch_start = profile ? eng_profile_now_ns() : 0;
+  bool fetched =
+      eng_fetch_events(usr_c->env, usr_txn, usr_c->data.usr->events_db,
+                       event_ids, count, fields, deadline,
+                       r->payload.list_obj.objects, &found);
+  if (profile) {
+    profile->fetch_ns = eng_profile_now_ns() - fetch_start;
+  }
+  free(event_ids);
+  if (!fetched) {
+    deadline_status_t ds = deadline_status(deadline);
+    r->err_msg =
+        ds != DEADLINE_OK ? deadline_err_msg(ds) : "Error fetching events";
+    bitmap_free(query_r->events);
+    return;
+  }
 
-    roaring_uint32_iterator_advance(it);
+  if (found < count) {
+    LOG_ACTION_DEBUG(ACT_RACE_CONDITION,
+                     "context=handle_query_result msg=\"Event IDs indexed but "
+                     "msgpack isn't in LMDB yet\" missing=%u",
+                     count - found);
   }
 
   r->is_ok = true;
-  // set to `i` instead of `count` in case some events are missing
-  r->payload.list_obj.count = i;
+  // set to `found` instead of `count` in case some events are missing
+  r->payload.list_obj.count = found;
   r->payload.list_obj.next_cursor = query_r->next_cursor;
+  r->payload.list_obj.sampled = query_r->sampled;
+  r->payload.list_obj.estimated_count = query_r->estimated_count;
+  r->payload.list_obj.count_error = query_r->count_error;
+  r->payload.list_obj.has_agg = query_r->has_agg;
+  r->payload.list_obj.agg_count = query_r->agg.count;
+  r->payload.list_obj.agg_sum = query_r->agg.sum;
+  r->payload.list_obj.agg_min = query_r->agg.min;
+  r->payload.list_obj.agg_max = query_r->agg.max;
+  r->payload.list_obj.session = query_r->session;
+  bitmap_free(query_r->events);
+}
+
+// `ids_only:true`: the matching ids alone, no event is fetched
+static void _handle_ids_result(eng_query_result_t *query_r,
+                               api_response_t *r) {
+  r->is_ok = false;
+  r->err_msg = query_r->err_msg;
+  if (!query_r->success) {
+    LOG_ACTION_ERROR(ACT_QUERY_ERROR, "err=\"%s\"", query_r->err_msg);
+    return;
+  }
+  api_response_type_id_set_t *set = &r->payload.id_set;
+  r->resp_type = API_RESP_TYPE_ID_SET;
+  set->bitmap = bitmap_serialize_portable(query_r->events, &set->bitmap_size);
+  if (!set->bitmap) {
+    r->err_msg = "OOM error handling query result";
+    bitmap_free(query_r->events);
+    return;
+  }
+  r->is_ok = true;
+  set->count = bitmap_get_cardinality(query_r->events);
+  set->next_cursor = query_r->next_cursor;
+  set->session = query_r->session;
   bitmap_free(query_r->events);
 }
 
+// `EXPLAIN QUERY`: the plan alone, no bitmap is read
+static void _explain_query(cmd_ctx_t *cmd_ctx, eval_ctx_t *ctx,
+                           api_response_t *r) {
+  if (!eng_eval_explain(cmd_ctx->where_tag_value, ctx, &r->err_msg)) {
+    return;
+  }
+  r->is_ok = true;
+  r->resp_type = API_RESP_TYPE_LIST_OBJ;
+}
+
+// Attach the plan of an EXPLAIN or PROFILE to a successful response
+static void _attach_plan(api_response_t *r, const eng_profile_t *profile) {
+  if (!r->is_ok || r->resp_type != API_RESP_TYPE_LIST_OBJ) {
+    return;
+  }
+  api_response_type_list_obj_t *list = &r->payload.list_obj;
+  mpack_writer_t writer;
+  mpack_writer_init_growable(&writer, &list->plan, &list->plan_size);
+  eng_profile_write(&writer, profile);
+  if (mpack_writer_destroy(&writer) != mpack_ok) {
+    r->is_ok = false;
+    r->err_msg = "Error writing query plan";
+    return;
+  }
+  list->profiled = profile->timed;
+}
+
+// Read txns on the system and a user container, held for one read command
+typedef struct read_txns_s {
+  eng_container_t *sys_container;
+  eng_container_t *container;
+  MDB_txn *sys_txn;
+  MDB_txn *user_txn;
+  uint64_t commit_seq;
+} read_txns_t;
+
+static bool _open_read_txns(const char *container_name, read_txns_t *t,
+                            api_response_t *r) {
+  memset(t, 0, sizeof(read_txns_t));
+  container_result_t scr = container_get_system();
+  if (!scr.success) {
+    r->err_msg = "Unable to get sys container";
+    return false;
+  }
+  t->sys_container = scr.container;
+  t->sys_txn = db_create_txn(scr.container->env, true);
+  if (!t->sys_txn) {
+    r->err_msg = "Unable to get sys txn";
+    return false;
+  }
+  container_result_t cr =
+      container_get_user(container_name, false, t->sys_txn);
+  if (!cr.success) {
+    db_abort_txn(t->sys_txn);
+    r->err_msg =
+        cr.error_msg != NULL ? cr.error_msg : "Error getting user container";
+    return false;
+  }
+  t->container = cr.container;
+  // Before the txn: read cache entries tagged with it were read after the
+  // last commit that bumped it
+  t->commit_seq = container_get_commit_seq(cr.container);
+  t->user_txn = db_create_txn(cr.container->env, true);
+  if (!t->user_txn) {
+    db_abort_txn(t->sys_txn);
+    container_release(cr.container);
+    r->err_msg = "Unable to create user txn";
+    return false;
+  }
+  return true;
+}
+
+static void _close_read_txns(read_txns_t *t) {
+  container_release(t->container);
+  db_abort_txn(t->user_txn);
+  db_abort_txn(t->sys_txn);
+}
+
+static eval_config_t _read_eval_config(const read_txns_t *t,
+                                       const deadline_t *deadline) {
+  return (eval_config_t){.container = t->container,
+                         .sys_container = t->sys_container,
+                         .sys_txn = t->sys_txn,
+                         .user_txn = t->user_txn,
+                         .consumers = g_consumers,
+                         .op_queue_total_count = NUM_OP_QUEUES,
+                         .op_queues_per_consumer = OP_QUEUES_PER_CONSUMER,
+                         .commit_seq = t->commit_seq,
+                         .deadline = deadline,
+                         .scan_budget = MAX_QUERY_SCAN_EVENTS};
+}
+
+// `after:<event_id>` waits until the event is visible, for at most
+// MAX_AFTER_WAIT_MS of the query's deadline
+static bool _wait_for_watermark(cmd_ctx_t *cmd_ctx, const deadline_t *deadline,
+                                api_response_t *r) {
+  ast_node_t *after = ast_find_custom_tag(&cmd_ctx->ast->command, "after");
+  if (!after) {
+    return true;
+  }
+  deadline_t wait = *deadline;
+  deadline_cap(&wait, MAX_AFTER_WAIT_MS);
+  watermark_wait_result_t wr = watermark_wait(
+      cmd_ctx->in_tag_value->literal.string_value,
+      (uint32_t)after->tag.value->literal.number_value, &wait);
+  switch (wr) {
+  case WATERMARK_REACHED:
+    return true;
+  case WATERMARK_AHEAD:
+    r->err_msg = "Value of `after` tag is not an event id of the container";
+    return false;
+  case WATERMARK_DEADLINE:
+    if (deadline_status(deadline) != DEADLINE_OK) {
+      r->err_msg = deadline_err_msg(deadline_status(deadline));
+    } else {
+      r->err_msg = "Timed out waiting for the `after` event";
+    }
+    return false;
+  }
+  return false;
+}
+
 // Takes ownership of `ast`
-void eng_query(api_response_t *r, ast_node_t *ast) {
+void eng_query(api_response_t *r, ast_node_t *ast, const atomic_int *alive) {
   cmd_ctx_t *cmd_ctx = build_cmd_context(ast, -1);
   if (!cmd_ctx) {
     LOG_ACTION_ERROR(ACT_CMD_CTX_BUILD_FAILED, "context=eng_query");
@@ -421,50 +1213,721 @@ void eng_query(api_response_t *r, ast_node_t *ast) {
     return;
   }
 
+  // Covers the whole query, including opening containers and txns
+  deadline_t deadline;
+  deadline_init(&deadline,
+                cmd_ctx->timeout_tag_value
+                    ? (uint64_t)cmd_ctx->timeout_tag_value->literal.number_value
+                    : DEFAULT_QUERY_TIMEOUT_MS,
+                alive);
+
+  // Before txns are opened, so they see the events
+  if (!_wait_for_watermark(cmd_ctx, &deadline, r)) {
+    cmd_context_free(cmd_ctx);
+    return;
+  }
+
   eng_query_result_t qr = {0};
+  read_txns_t txns;
+  if (!_open_read_txns(cmd_ctx->in_tag_value->literal.string_value, &txns,
+                       r)) {
+    cmd_context_free(cmd_ctx);
+    return;
+  }
+
+  eval_config_t config = _read_eval_config(&txns, &deadline);
+  config.sample_pct =
+      cmd_ctx->sample_tag_value
+          ? (uint32_t)cmd_ctx->sample_tag_value->literal.number_value
+          : 0;
+
+  // Plans are too large for the stack of a worker
+  eng_profile_t *profile = NULL;
+  if (cmd_ctx->plan_tag_value) {
+    profile = malloc(sizeof(eng_profile_t));
+    if (!profile) {
+      r->err_msg = "OOM error building query plan";
+      cmd_context_free(cmd_ctx);
+      _close_read_txns(&txns);
+      return;
+    }
+    eng_profile_init(profile,
+                     strcmp(cmd_ctx->plan_tag_value->literal.string_value,
+                            "profile") == 0);
+    config.profile = profile;
+  }
+
+  eval_state_t state = {0};
+
+  eval_ctx_t ctx = {.config = &config, .state = &state};
+
+  if (profile && !profile->timed) {
+    _explain_query(cmd_ctx, &ctx, r);
+  } else {
+    uint64_t eval_start = profile ? eng_profile_now_ns() : 0;
+    eng_query_exec(cmd_ctx, g_consumers, &ctx, &qr);
+    if (profile) {
+      profile->eval_ns = eng_profile_now_ns() - eval_start;
+    }
+
+    if (ast_find_custom_tag(&cmd_ctx->ast->command, "ids_only")) {
+      _handle_ids_result(&qr, r);
+    } else {
+      eng_fetch_fields_t fields;
+      _handle_query_result(&qr, r, txns.user_txn, txns.container,
+                           _fetch_fields(cmd_ctx->fields_tag_value, &fields),
+                           &deadline, profile);
+    }
+  }
+  if (profile) {
+    _attach_plan(r, profile);
+    free(profile);
+  }
+
+  cmd_context_free(cmd_ctx);
+  _close_read_txns(&txns);
+}
+
+// Consumer cache copy of an inverted index bitmap, newer than the LMDB one.
+// Call within an EBR section
+static const bitmap_t *_top_cached_bm(const char *inv_key, void *arg) {
+  eng_container_db_key_t db_key = {
+      .container_name = (char *)arg,
+      .usr_db_type = USR_DB_INVERTED_EVENT_INDEX,
+      .dc_type = CONTAINER_TYPE_USR,
+      .db_key = {.type = DB_KEY_STRING, .key.s = (char *)inv_key}};
+  char ser_db_key[512];
+  if (!db_key_into(ser_db_key, sizeof(ser_db_key), &db_key)) {
+    return NULL;
+  }
+  int consumer_idx = route_key_to_consumer(ser_db_key, NUM_OP_QUEUES,
+                                           OP_QUEUES_PER_CONSUMER);
+  consumer_cache_t *cc = consumer_get_cache(&g_consumers[consumer_idx]);
+  return cc ? consumer_cache_get_bm(cc, ser_db_key) : NULL;
+}
+
+// One status object per value, best first
+static bool _top_objects(api_response_t *r, const eng_top_heap_t *heap) {
+  uint32_t count = heap->count;
+  api_obj_t *objs = count ? calloc(count, sizeof(api_obj_t)) : NULL;
+  bool ok = count == 0 || objs != NULL;
+  for (uint32_t i = 0; ok && i < count; i++) {
+    mpack_writer_t writer;
+    mpack_writer_init_growable(&writer, &objs[i].data, &objs[i].data_size);
+    mpack_start_map(&writer, 2);
+    mpack_write_cstr(&writer, "value");
+    mpack_write_cstr(&writer, heap->entries[i].value);
+    mpack_write_cstr(&writer, "count");
+    mpack_write_u64(&writer, heap->entries[i].count);
+    mpack_finish_map(&writer);
+    ok = mpack_writer_destroy(&writer) == mpack_ok;
+  }
+
+  // Freed with the response, partially built objects included
+  r->resp_type = API_RESP_TYPE_LIST_OBJ;
+  r->payload.list_obj.type = API_OBJ_TYPE_STATUS;
+  r->payload.list_obj.objects = objs;
+  r->payload.list_obj.count = objs ? count : 0;
+  return ok;
+}
+
+// Takes ownership of `ast`
+void eng_top(api_response_t *r, ast_node_t *ast, const atomic_int *alive) {
+  cmd_ctx_t *cmd_ctx = build_cmd_context(ast, -1);
+  if (!cmd_ctx) {
+    LOG_ACTION_ERROR(ACT_CMD_CTX_BUILD_FAILED, "context=eng_top");
+    r->err_msg = "Error generating command context";
+    ast_free(ast);
+    return;
+  }
+
+  deadline_t deadline;
+  deadline_init(&deadline,
+                cmd_ctx->timeout_tag_value
+                    ? (uint64_t)cmd_ctx->timeout_tag_value->literal.number_value
+                    : DEFAULT_QUERY_TIMEOUT_MS,
+                alive);
+
+  read_txns_t txns;
+  if (!_open_read_txns(cmd_ctx->in_tag_value->literal.string_value, &txns,
+                       r)) {
+    cmd_context_free(cmd_ctx);
+    return;
+  }
+  eval_config_t config = _read_eval_config(&txns, &deadline);
+  eval_state_t state = {0};
+  eval_ctx_t ctx = {.config = &config, .state = &state};
+
+  ast_node_t *n_tag = ast_find_custom_tag(&cmd_ctx->ast->command, "n");
+  eng_top_args_t args = {
+      .txn = txns.user_txn,
+      .inverted_db = txns.container->data.usr->inverted_event_index_db,
+      .key = cmd_ctx->key_tag_value->literal.string_value,
+      .n = n_tag ? (uint32_t)n_tag->tag.value->literal.number_value
+                 : DEFAULT_TOP_N,
+      .cache_get = _top_cached_bm,
+      .cache_arg = txns.container->name,
+      .deadline = &deadline};
+  eng_top_heap_t heap = {0};
+  const char *err = NULL;
+  bool ok = true;
+
+  // Filter and consumer cache bitmaps are read in the same section
+  ck_epoch_section_t section;
+  ebr_begin(&section);
+  eng_eval_result_t filter = {.success = true};
+  if (cmd_ctx->where_tag_value) {
+    filter = eng_eval_resolve_exp_to_events(cmd_ctx->where_tag_value, &ctx);
+    ok = filter.success;
+    err = filter.err_msg;
+  }
+  if (ok) {
+    args.filter = filter.events;
+    ok = eng_top_values(&args, &heap, &err);
+  }
+  ebr_end(&section);
+  ebr_poll_nonblocking();
+  eng_eval_cleanup_state(&state);
+  bitmap_free(filter.events);
+
+  if (ok && !_top_objects(r, &heap)) {
+    ok = false;
+    err = "Error writing values";
+  }
+  r->is_ok = ok;
+  if (!ok) {
+    r->err_msg = err ? err : "Error ranking values";
+  }
+  eng_top_heap_free(&heap);
+  cmd_context_free(cmd_ctx);
+  _close_read_txns(&txns);
+}
+
+// `bucket:` or `within:` in ms, the validator has checked it
+static uint64_t _duration_ms(ast_node_t *value) {
+  if (value->literal.type == AST_LITERAL_NUMBER) {
+    return (uint64_t)value->literal.number_value;
+  }
+  uint64_t ms = 0;
+  conv_duration_to_ms(value->literal.string_value, &ms);
+  return ms;
+}
+
+// Takes ownership of `ast`
+void eng_histogram(api_response_t *r, ast_node_t *ast,
+                   const atomic_int *alive) {
+  cmd_ctx_t *cmd_ctx = build_cmd_context(ast, -1);
+  if (!cmd_ctx) {
+    LOG_ACTION_ERROR(ACT_CMD_CTX_BUILD_FAILED, "context=eng_histogram");
+    r->err_msg = "Error generating command context";
+    ast_free(ast);
+    return;
+  }
+  ast_command_node_t *cmd = &cmd_ctx->ast->command;
+  int64_t from =
+      ast_find_custom_tag(cmd, "from")->tag.value->literal.number_value;
+  int64_t to = ast_find_custom_tag(cmd, "to")->tag.value->literal.number_value;
+  uint64_t bucket_ms =
+      _duration_ms(ast_find_custom_tag(cmd, "bucket")->tag.value);
+  uint32_t num_buckets =
+      (uint32_t)eng_histogram_num_buckets(from, to, bucket_ms);
+
+  deadline_t deadline;
+  deadline_init(&deadline,
+                cmd_ctx->timeout_tag_value
+                    ? (uint64_t)cmd_ctx->timeout_tag_value->literal.number_value
+                    : DEFAULT_QUERY_TIMEOUT_MS,
+                alive);
+
+  read_txns_t txns;
+  if (!_open_read_txns(cmd_ctx->in_tag_value->literal.string_value, &txns,
+                       r)) {
+    cmd_context_free(cmd_ctx);
+    return;
+  }
+
+  index_t ts_index;
+  kh_key_index_t *key_to_index =
+      atomic_load(&txns.container->data.usr->key_to_index);
+  uint64_t *edges = calloc(num_buckets + 1, sizeof(uint64_t));
+  uint64_t *counts = calloc(num_buckets, sizeof(uint64_t));
+  const char *err = NULL;
+  if (!edges || !counts) {
+    err = "OOM error building histogram";
+  } else if (!index_get("ts", key_to_index, &ts_index) ||
+             ts_index.index_def.type != INDEX_TYPE_I64 || ts_index.building) {
+    err = "Histograms need the `ts` index";
+  } else if (!eng_histogram_edges(txns.user_txn, ts_index.index_db, from, to,
+                                  bucket_ms, num_buckets, edges)) {
+    err = "Error reading `ts` index";
+  }
+
+  if (!err) {
+    eval_config_t config = _read_eval_config(&txns, &deadline);
+    eval_state_t state = {0};
+    eval_ctx_t ctx = {.config = &config, .state = &state};
+    ck_epoch_section_t section;
+    ebr_begin(&section);
+    eng_eval_result_t er =
+        eng_eval_resolve_exp_to_events(cmd_ctx->where_tag_value, &ctx);
+    ebr_end(&section);
+    ebr_poll_nonblocking();
+    eng_eval_cleanup_state(&state);
+    if (er.success) {
+      eng_histogram_counts(er.events, edges, num_buckets, counts);
+    } else {
+      err = er.err_msg ? er.err_msg : "Error evaluating query";
+    }
+    bitmap_free(er.events);
+  }
+
+  free(edges);
+  if (err) {
+    r->err_msg = err;
+    free(counts);
+  } else {
+    r->is_ok = true;
+    r->resp_type = API_RESP_TYPE_HISTOGRAM;
+    r->payload.histogram.from = from;
+    r->payload.histogram.bucket_ms = bucket_ms;
+    r->payload.histogram.counts = counts;
+    r->payload.histogram.count = num_buckets;
+  }
+  cmd_context_free(cmd_ctx);
+  _close_read_txns(&txns);
+}
+
+// One status object per step, in funnel order
+static bool _funnel_objects(api_response_t *r, const uint64_t *counts,
+                            uint32_t num_steps) {
+  api_obj_t *objs = calloc(num_steps, sizeof(api_obj_t));
+  bool ok = objs != NULL;
+  for (uint32_t i = 0; ok && i < num_steps; i++) {
+    mpack_writer_t writer;
+    mpack_writer_init_growable(&writer, &objs[i].data, &objs[i].data_size);
+    mpack_start_map(&writer, 2);
+    mpack_write_cstr(&writer, "step");
+    mpack_write_u32(&writer, i + 1);
+    mpack_write_cstr(&writer, "entities");
+    mpack_write_u64(&writer, counts[i]);
+    mpack_finish_map(&writer);
+    ok = mpack_writer_destroy(&writer) == mpack_ok;
+  }
+
+  // Freed with the response, partially built objects included
+  r->resp_type = API_RESP_TYPE_LIST_OBJ;
+  r->payload.list_obj.type = API_OBJ_TYPE_STATUS;
+  r->payload.list_obj.objects = objs;
+  r->payload.list_obj.count = objs ? num_steps : 0;
+  return ok;
+}
+
+// Events of each step, in `steps_out`
+static bool _funnel_steps(cmd_ctx_t *cmd_ctx, const eval_config_t *config,
+                          bitmap_t **steps_out, uint32_t *num_steps_out,
+                          const char **err_out) {
+  uint32_t n = 0;
+  bool ok = true;
+  ck_epoch_section_t section;
+  ebr_begin(&section);
+  for (ast_node_t *step = cmd_ctx->steps_tag_value; ok && step;
+       step = step->next) {
+    // Steps may share keys, each is resolved with a fresh state
+    eval_state_t state = {0};
+    eval_ctx_t ctx = {.config = config, .state = &state};
+    eng_eval_result_t er = eng_eval_resolve_exp_to_events(step, &ctx);
+    eng_eval_cleanup_state(&state);
+    if (!er.success) {
+      *err_out = er.err_msg;
+      ok = false;
+    } else {
+      steps_out[n++] = er.events;
+    }
+  }
+  ebr_end(&section);
+  ebr_poll_nonblocking();
+  *num_steps_out = n;
+  return ok;
+}
+
+// Takes ownership of `ast`
+void eng_funnel(api_response_t *r, ast_node_t *ast, const atomic_int *alive) {
+  cmd_ctx_t *cmd_ctx = build_cmd_context(ast, -1);
+  if (!cmd_ctx) {
+    LOG_ACTION_ERROR(ACT_CMD_CTX_BUILD_FAILED, "context=eng_funnel");
+    r->err_msg = "Error generating command context";
+    ast_free(ast);
+    return;
+  }
+  uint64_t within_ms = _duration_ms(
+      ast_find_custom_tag(&cmd_ctx->ast->command, "within")->tag.value);
+
+  deadline_t deadline;
+  deadline_init(&deadline,
+                cmd_ctx->timeout_tag_value
+                    ? (uint64_t)cmd_ctx->timeout_tag_value->literal.number_value
+                    : DEFAULT_QUERY_TIMEOUT_MS,
+                alive);
+
+  read_txns_t txns;
+  if (!_open_read_txns(cmd_ctx->in_tag_value->literal.string_value, &txns,
+                       r)) {
+    cmd_context_free(cmd_ctx);
+    return;
+  }
+  eval_config_t config = _read_eval_config(&txns, &deadline);
+
+  bitmap_t *steps[MAX_FUNNEL_STEPS] = {0};
+  uint32_t num_steps = 0;
+  eng_funnel_event_t *events = NULL;
+  uint32_t num_events = 0;
+  uint64_t counts[MAX_FUNNEL_STEPS] = {0};
+  const char *err = NULL;
+  bool ok = _funnel_steps(cmd_ctx, &config, steps, &num_steps, &err);
+  if (ok) {
+    eng_funnel_load_args_t args = {
+        .txn = txns.user_txn,
+        .events_db = txns.container->data.usr->events_db,
+        .event_to_entity_map = &txns.container->data.usr->event_to_entity_map,
+        .steps = steps,
+        .num_steps = num_steps,
+        .deadline = &deadline};
+    ok = eng_funnel_load(&args, &events, &num_events, &err) &&
+         eng_funnel_count(events, num_events, num_steps, within_ms, &deadline,
+                          counts, &err);
+  }
+  for (uint32_t i = 0; i < num_steps; i++) {
+    bitmap_free(steps[i]);
+  }
+  free(events);
+
+  if (ok && !_funnel_objects(r, counts, num_steps)) {
+    ok = false;
+    err = "Error writing funnel";
+  }
+  r->is_ok = ok;
+  if (!ok) {
+    r->err_msg = err ? err : "Error counting funnel";
+  }
+  cmd_context_free(cmd_ctx);
+  _close_read_txns(&txns);
+}
+
+typedef struct entities_leaf_arg_s {
+  api_response_t *r;
+  const deadline_t *deadline;
+} entities_leaf_arg_t;
+
+// Entities of a container, or of a view's events, on txns of its own
+static bitmap_t *_entities_leaf(const char *container_name, const char *view,
+                                void *arg, const char **err_out) {
+  entities_leaf_arg_t *a = arg;
+  read_txns_t txns;
+  if (!_open_read_txns(container_name, &txns, a->r)) {
+    *err_out = a->r->err_msg;
+    return NULL;
+  }
+  eval_config_t config = _read_eval_config(&txns, a->deadline);
+  eval_state_t state = {0};
+  eval_ctx_t ctx = {.config = &config, .state = &state};
+  bitmap_t *entities = NULL;
+
+  ck_epoch_section_t section;
+  ebr_begin(&section);
+  if (!view) {
+    entities = eng_eval_container_entities(&ctx);
+    if (!entities) {
+      // No events yet
+      entities = bitmap_create();
+    }
+  } else {
+    ast_node_t *tag = ast_create_tag_node(
+        AST_KW_VIEW, ast_create_string_literal_node(view, strlen(view)));
+    eng_eval_result_t er = tag ? eng_eval_resolve_exp_to_events(tag, &ctx)
+                               : (eng_eval_result_t){0};
+    if (er.success) {
+      entities = eng_entities_of_events(
+          &txns.container->data.usr->event_to_entity_map, er.events,
+          a->deadline, err_out);
+      bitmap_free(er.events);
+    } else {
+      *err_out = er.err_msg;
+    }
+    ast_free(tag);
+  }
+  eng_eval_cleanup_state(&state);
+  ebr_end(&section);
+  ebr_poll_nonblocking();
+  _close_read_txns(&txns);
+  if (!entities && !*err_out) {
+    *err_out = "Error reading entities";
+  }
+  return entities;
+}
+
+// External id of an entity, from its slot in the entity id map
+static void _write_entity(mpack_writer_t *writer, mmap_array_t *map,
+                          uint32_t entity_id) {
+  char slot[SLOT_SIZE] = {0};
+  mmap_array_read_lock(map);
+  char *p = mmap_array_get(map, entity_id);
+  if (p) {
+    memcpy(slot, p, SLOT_SIZE);
+  }
+  mmap_array_unlock(map);
+
+  if (slot[0] == VAL_TYPE_I64) {
+    int64_t v;
+    memcpy(&v, slot + TAG_UNION_SIZE, sizeof(int64_t));
+    mpack_write_i64(writer, v);
+  } else if (slot[0] == VAL_TYPE_STR) {
+    slot[SLOT_SIZE - 1] = '\0';
+    mpack_write_cstr(writer, slot + TAG_UNION_SIZE);
+  } else {
+    mpack_write_nil(writer);
+  }
+}
+
+// One status object with the count, or one per entity of a page
+static bool _entities_objects(api_response_t *r, bitmap_t *entities,
+                              bool paged) {
+  uint32_t count = paged ? bitmap_get_cardinality(entities) : 1;
+  uint32_t *ids = NULL;
+  mmap_array_t *map = NULL;
+  if (paged) {
+    container_result_t scr = container_get_system();
+    if (!scr.success) {
+      return false;
+    }
+    map = &scr.container->data.sys->entity_id_map;
+    ids = malloc((count ? count : 1) * sizeof(uint32_t));
+    if (!ids) {
+      return false;
+    }
+    bitmap_to_uint32_array(entities, ids);
+  }
+
+  api_obj_t *objs = calloc(count ? count : 1, sizeof(api_obj_t));
+  bool ok = objs != NULL;
+  for (uint32_t i = 0; ok && i < count; i++) {
+    mpack_writer_t writer;
+    mpack_writer_init_growable(&writer, &objs[i].data, &objs[i].data_size);
+    mpack_start_map(&writer, 1);
+    if (paged) {
+      mpack_write_cstr(&writer, "entity");
+      _write_entity(&writer, map, ids[i]);
+    } else {
+      mpack_write_cstr(&writer, "entities");
+      mpack_write_u64(&writer, bitmap_get_cardinality(entities));
+    }
+    mpack_finish_map(&writer);
+    ok = mpack_writer_destroy(&writer) == mpack_ok;
+  }
+  free(ids);
+
+  // Freed with the response, partially built objects included
+  r->resp_type = API_RESP_TYPE_LIST_OBJ;
+  r->payload.list_obj.type = API_OBJ_TYPE_STATUS;
+  r->payload.list_obj.objects = objs;
+  r->payload.list_obj.count = objs ? count : 0;
+  return ok;
+}
+
+// Takes ownership of `ast`
+void eng_entities(api_response_t *r, ast_node_t *ast,
+                  const atomic_int *alive) {
+  cmd_ctx_t *cmd_ctx = build_cmd_context(ast, -1);
+  if (!cmd_ctx) {
+    LOG_ACTION_ERROR(ACT_CMD_CTX_BUILD_FAILED, "context=eng_entities");
+    r->err_msg = "Error generating command context";
+    ast_free(ast);
+    return;
+  }
+
+  deadline_t deadline;
+  deadline_init(&deadline,
+                cmd_ctx->timeout_tag_value
+                    ? (uint64_t)cmd_ctx->timeout_tag_value->literal.number_value
+                    : DEFAULT_QUERY_TIMEOUT_MS,
+                alive);
+
+  entities_leaf_arg_t arg = {.r = r, .deadline = &deadline};
+  const char *err = NULL;
+  bitmap_t *entities =
+      eng_entities_eval(cmd_ctx->of_tag_value, _entities_leaf, &arg, &err);
+  bool ok = entities != NULL;
+  bool paged = cmd_ctx->take_tag_value != NULL;
+  uint32_t next_cursor = 0;
+  if (ok && paged) {
+    uint32_t start_val =
+        cmd_ctx->cursor_tag_value
+            ? (uint32_t)cmd_ctx->cursor_tag_value->literal.number_value
+            : 0;
+    next_cursor = bitmap_take(
+        entities, (uint32_t)cmd_ctx->take_tag_value->literal.number_value,
+        start_val);
+  }
+  if (ok && !_entities_objects(r, entities, paged)) {
+    ok = false;
+    err = "Error writing entities";
+  }
+  bitmap_free(entities);
+
+  r->is_ok = ok;
+  if (ok) {
+    r->err_msg = NULL;
+    r->payload.list_obj.next_cursor = next_cursor;
+  } else {
+    r->err_msg = err ? err : "Error evaluating entity set";
+  }
+  cmd_context_free(cmd_ctx);
+}
+
+// Takes ownership of `ast`. Only events written from here on are counted
+void eng_create_rollup(api_response_t *r, ast_node_t *ast) {
+  cmd_ctx_t *cmd_ctx = build_cmd_context(ast, -1);
+  if (!cmd_ctx) {
+    LOG_ACTION_ERROR(ACT_CMD_CTX_BUILD_FAILED, "context=eng_create_rollup");
+    r->err_msg = "Error generating command context";
+    ast_free(ast);
+    return;
+  }
+  uint64_t bucket_ms = _duration_ms(
+      ast_find_custom_tag(&cmd_ctx->ast->command, "bucket")->tag.value);
+  char id[MAX_TEXT_VAL_LEN * 2];
+  if (!rollup_id_into(id, sizeof(id), cmd_ctx->by_tag_value, bucket_ms)) {
+    cmd_context_free(cmd_ctx);
+    r->err_msg = "Invalid rollup";
+    return;
+  }
+
   container_result_t scr = container_get_system();
   if (!scr.success) {
+    cmd_context_free(cmd_ctx);
     r->err_msg = "Unable to get sys container";
     return;
   }
   MDB_txn *sys_txn = db_create_txn(scr.container->env, true);
   if (!sys_txn) {
+    cmd_context_free(cmd_ctx);
     r->err_msg = "Unable to get sys txn";
     return;
   }
+  // Rollups may be defined before the first event arrives
   container_result_t cr = container_get_user(
-      cmd_ctx->in_tag_value->literal.string_value, false, sys_txn);
+      cmd_ctx->in_tag_value->literal.string_value, true, sys_txn);
   if (!cr.success) {
     db_abort_txn(sys_txn);
+    cmd_context_free(cmd_ctx);
     r->err_msg =
         cr.error_msg != NULL ? cr.error_msg : "Error getting user container";
     return;
   }
-  MDB_txn *user_txn = db_create_txn(cr.container->env, true);
-  if (!user_txn) {
-    db_abort_txn(sys_txn);
-    container_release(cr.container);
-    r->err_msg = "Unable to create user txn";
-    return;
+  eng_user_dc_t *usr = cr.container->data.usr;
+
+  const rollup_set_t *rollups = atomic_load(&usr->rollups);
+  if (rollups && rollups->count >= MAX_ROLLUPS) {
+    r->err_msg = "Too many rollups";
+  } else {
+    switch (rollup_add(id, cr.container->env, usr->user_dc_metadata_db)) {
+    case DB_PUT_OK:
+      // Workers count events towards the rollup from here on
+      if (!rollup_publish(&usr->rollups, id)) {
+        r->err_msg = "Error adding rollup";
+      } else {
+        r->is_ok = true;
+        r->resp_type = API_RESP_TYPE_ACK;
+      }
+      break;
+    case DB_PUT_KEY_EXISTS:
+      r->err_msg = "Duplicate rollup";
+      break;
+    case DB_PUT_ERR:
+      r->err_msg = "Error adding rollup";
+      break;
+    }
   }
 
-  eval_config_t config = {.container = cr.container,
-                          .sys_txn = sys_txn,
-                          .user_txn = user_txn,
-                          .consumers = g_consumers,
-                          .op_queue_total_count = NUM_OP_QUEUES,
-                          .op_queues_per_consumer = OP_QUEUES_PER_CONSUMER};
+  container_release(cr.container);
+  db_abort_txn(sys_txn);
+  cmd_context_free(cmd_ctx);
+}
 
-  eval_state_t state = {0};
+// One status object per row: its bucket, a value per `by` key and the count
+static bool _rollup_objects(api_response_t *r, const rollup_t *rollup,
+                            const eng_rollup_result_t *res) {
+  api_obj_t *objs = res->count ? calloc(res->count, sizeof(api_obj_t)) : NULL;
+  bool ok = res->count == 0 || objs != NULL;
+  for (uint32_t i = 0; ok && i < res->count; i++) {
+    const eng_rollup_row_t *row = &res->rows[i];
+    mpack_writer_t writer;
+    mpack_writer_init_growable(&writer, &objs[i].data, &objs[i].data_size);
+    mpack_start_map(&writer, rollup->num_keys + 2);
+    mpack_write_cstr(&writer, "bucket");
+    mpack_write_u64(&writer, row->bucket);
+    const char *v = row->values;
+    const char *end = row->values + row->values_len;
+    for (uint32_t k = 0; k < rollup->num_keys; k++) {
+      const char *sep = memchr(v, ROLLUP_VALUE_SEP, (size_t)(end - v));
+      size_t len = sep ? (size_t)(sep - v) : (size_t)(end - v);
+      mpack_write_cstr(&writer, rollup->keys[k]);
+      mpack_write_str(&writer, v, (uint32_t)len);
+      v = sep ? sep + 1 : end;
+    }
+    mpack_write_cstr(&writer, "count");
+    mpack_write_u64(&writer, row->count);
+    mpack_finish_map(&writer);
+    ok = mpack_writer_destroy(&writer) == mpack_ok;
+  }
 
-  eval_ctx_t ctx = {.config = &config, .state = &state};
+  // Freed with the response, partially built objects included
+  r->resp_type = API_RESP_TYPE_LIST_OBJ;
+  r->payload.list_obj.type = API_OBJ_TYPE_STATUS;
+  r->payload.list_obj.objects = objs;
+  r->payload.list_obj.count = objs ? res->count : 0;
+  return ok;
+}
+
+// Takes ownership of `ast`
+void eng_rollup(api_response_t *r, ast_node_t *ast) {
+  cmd_ctx_t *cmd_ctx = build_cmd_context(ast, -1);
+  if (!cmd_ctx) {
+    LOG_ACTION_ERROR(ACT_CMD_CTX_BUILD_FAILED, "context=eng_rollup");
+    r->err_msg = "Error generating command context";
+    ast_free(ast);
+    return;
+  }
+  ast_command_node_t *cmd = &cmd_ctx->ast->command;
+  int64_t from =
+      ast_find_custom_tag(cmd, "from")->tag.value->literal.number_value;
+  int64_t to = ast_find_custom_tag(cmd, "to")->tag.value->literal.number_value;
+  uint64_t bucket_ms =
+      _duration_ms(ast_find_custom_tag(cmd, "bucket")->tag.value);
 
-  eng_query_exec(cmd_ctx, g_consumers, &ctx, &qr);
+  read_txns_t txns;
+  if (!_open_read_txns(cmd_ctx->in_tag_value->literal.string_value, &txns,
+                       r)) {
+    cmd_context_free(cmd_ctx);
+    return;
+  }
 
-  _handle_query_result(&qr, r, user_txn, cr.container);
+  eng_user_dc_t *usr = txns.container->data.usr;
+  const rollup_t *rollup = eng_rollup_pick(atomic_load(&usr->rollups),
+                                           cmd_ctx->by_tag_value, bucket_ms);
+  eng_rollup_result_t res = {0};
+  const char *err = NULL;
+  if (!rollup) {
+    err = "No rollup over these keys with a bucket dividing `bucket`";
+  } else if (eng_rollup_read(txns.user_txn, usr->rollup_db, rollup,
+                             (uint64_t)from, (uint64_t)to, bucket_ms, &res,
+                             &err) &&
+             !_rollup_objects(r, rollup, &res)) {
+    err = "Error writing rollup";
+  }
+  eng_rollup_result_free(&res);
 
+  r->is_ok = err == NULL;
+  r->err_msg = err;
   cmd_context_free(cmd_ctx);
-  container_release(cr.container);
-  db_abort_txn(user_txn);
-  db_abort_txn(sys_txn);
-}
\ No newline at end of file
+  _close_read_txns(&txns);
+}
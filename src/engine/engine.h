@@ -2,6 +2,7 @@
 #define ENG_H
 
 #include "query/ast.h"
+#include <stdatomic.h>
 
 typedef struct api_response_s api_response_t;
 
@@ -13,10 +14,38 @@ void eng_shutdown(void);
 // Write an event
 void eng_event(api_response_t *r, ast_node_t *ast, int64_t arrival_ts);
 
-// Query
-void eng_query(api_response_t *r, ast_node_t *ast);
+// Query. Stops early once `alive` (optional) reads 0 or the deadline passes
+void eng_query(api_response_t *r, ast_node_t *ast, const atomic_int *alive);
 
 // Create an index
 void eng_index(api_response_t *r, ast_node_t *ast);
 
+// Create a materialized view
+void eng_create_view(api_response_t *r, ast_node_t *ast);
+void eng_subscribe(api_response_t *r, ast_node_t *ast);
+
+// List engine state, e.g. running index backfills
+void eng_show(api_response_t *r, ast_node_t *ast);
+
+// Most frequent values of a tag key. Stops early like `eng_query`
+void eng_top(api_response_t *r, ast_node_t *ast, const atomic_int *alive);
+
+// Counts of matching events per time bucket. Stops early like `eng_query`
+void eng_histogram(api_response_t *r, ast_node_t *ast,
+                   const atomic_int *alive);
+
+// Entities reaching each step of a funnel. Stops early like `eng_query`
+void eng_funnel(api_response_t *r, ast_node_t *ast, const atomic_int *alive);
+
+// Count or page of entities of a set expression over containers. Stops early
+// like `eng_query`
+void eng_entities(api_response_t *r, ast_node_t *ast,
+                  const atomic_int *alive);
+
+// Define a count rollup, see `rollup.h`
+void eng_create_rollup(api_response_t *r, ast_node_t *ast);
+
+// Counts of a rollup per time bucket and combination of values
+void eng_rollup(api_response_t *r, ast_node_t *ast);
+
 #endif
\ No newline at end of file
@@ -4,6 +4,9 @@
 #include "engine/container/container_types.h"
 #include "engine/engine_writer/engine_writer_queue.h"
 #include "engine/engine_writer/engine_writer_queue_msg.h"
+#include "engine/subscription/subscription.h"
+#include "engine/tag_stats/tag_stats.h"
+#include "engine/watermark/watermark.h"
 #include "lmdb.h"
 #include "log/log.h"
 #include "uthash.h"
@@ -12,6 +15,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 LOG_INIT(writer);
 
@@ -131,6 +135,53 @@ static bool _group_entries_by_container(write_batch_t **b_hash,
   return true;
 }
 
+// WRITE_COND_INT32_GREATER_THAN: event ids are assigned as events are queued,
+// so counters of several workers can arrive out of order
+static bool _skip_not_greater(MDB_dbi db, MDB_txn *txn,
+                              eng_writer_entry_t *entry, bool *skip_out) {
+  *skip_out = false;
+  if (entry->write_condition != WRITE_COND_INT32_GREATER_THAN) {
+    return true;
+  }
+  db_get_result_t r = {0};
+  if (!db_get(db, txn, &entry->db_key.db_key, &r)) {
+    return false;
+  }
+  if (r.status == DB_GET_OK && r.value_len == sizeof(uint32_t)) {
+    uint32_t existing, value;
+    memcpy(&existing, r.value, sizeof(uint32_t));
+    memcpy(&value, entry->value, sizeof(uint32_t));
+    *skip_out = value <= existing;
+  }
+  db_get_result_clear(&r);
+  return true;
+}
+
+// Adds the existing u64 to the entry's value. Earlier entries of the same
+// txn are seen, so deltas of one row in one batch add up
+static bool _add_existing(MDB_dbi db, MDB_txn *txn,
+                          eng_writer_entry_t *entry) {
+  if (entry->write_condition != WRITE_COND_ADD_U64) {
+    return true;
+  }
+  if (entry->value_size != sizeof(uint64_t)) {
+    return false;
+  }
+  db_get_result_t r = {0};
+  if (!db_get(db, txn, &entry->db_key.db_key, &r)) {
+    return false;
+  }
+  if (r.status == DB_GET_OK && r.value_len == sizeof(uint64_t)) {
+    uint64_t existing, value;
+    memcpy(&existing, r.value, sizeof(uint64_t));
+    memcpy(&value, entry->value, sizeof(uint64_t));
+    value += existing;
+    memcpy(entry->value, &value, sizeof(uint64_t));
+  }
+  db_get_result_clear(&r);
+  return true;
+}
+
 static bool _write_to_db(eng_container_t *c, MDB_txn *txn,
                          eng_writer_entry_t *entry) {
   MDB_dbi target_db;
@@ -149,7 +200,35 @@ static bool _write_to_db(eng_container_t *c, MDB_txn *txn,
     return false;
   }
 
-  // TODO: HANDLE WRITE CONDITION
+  if (entry->db_key.dc_type == CONTAINER_TYPE_USR &&
+      entry->db_key.usr_db_type == USR_DB_TAG_STATS) {
+    // The value is a bitmap's cardinality, see `consumer_flush_prepare`
+    uint64_t card;
+    memcpy(&card, entry->value, sizeof(uint64_t));
+    if (!tag_stats_put_cardinality(txn, target_db,
+                                   atomic_load(&c->data.usr->key_to_index),
+                                   entry->db_key.db_key.key.s, card)) {
+      LOG_ACTION_ERROR(ACT_DB_WRITE_FAILED, "container=\"%s\" context=stats",
+                       c->name);
+      return false;
+    }
+    return true;
+  }
+
+  bool skip = false;
+  if (!_skip_not_greater(target_db, txn, entry, &skip)) {
+    LOG_ACTION_ERROR(ACT_DB_READ_FAILED, "container=\"%s\" context=condition",
+                     c->name);
+    return false;
+  }
+  if (skip) {
+    return true;
+  }
+  if (!_add_existing(target_db, txn, entry)) {
+    LOG_ACTION_ERROR(ACT_DB_READ_FAILED, "container=\"%s\" context=counter",
+                     c->name);
+    return false;
+  }
 
   if (db_put(target_db, txn, &entry->db_key.db_key, entry->value,
              entry->value_size, false, false) != DB_PUT_OK) {
@@ -180,6 +259,19 @@ static void _bump_flush_version(write_batch_t *container_batch) {
                    bumped, container_batch->container_name);
 }
 
+// Push committed events to matching subscriptions
+static void _deliver_to_subs(write_batch_t *container_batch) {
+  for (write_batch_item_t *item = container_batch->head; item;
+       item = item->next) {
+    eng_writer_entry_t *entry = item->entry;
+    if (entry->push) {
+      sub_push_deliver(entry->push, entry->db_key.db_key.key.u32,
+                       entry->value, entry->value_size);
+      entry->push = NULL;
+    }
+  }
+}
+
 static void _flush_to_db(write_batch_t *hash) {
   if (!hash)
     return;
@@ -230,7 +322,11 @@ static void _flush_to_db(write_batch_t *hash) {
     }
 
     if (all_successful && db_commit_txn(txn)) {
+      // Before the flush version, so consumers can't evict a key while read
+      // cache entries from before this commit are still valid
+      container_bump_commit_seq(c);
       _bump_flush_version(batch);
+      _deliver_to_subs(batch);
       successful_batches++;
       successful_entries += batch->count;
       LOG_ACTION_DEBUG(ACT_DB_WRITE, "entries_written=%u container=\"%s\"",
@@ -324,14 +420,13 @@ static void _eng_writer_thread_func(void *arg) {
 
       LOG_ACTION_DEBUG(ACT_MSG_DEQUEUED, "msg_type=writer count=%u", dequeued);
 
-      if (!batch_hash) {
+      if (batch_hash) {
+        _flush_to_db(batch_hash);
+        _free_batch_hash(batch_hash);
+      } else {
         LOG_ACTION_WARN(ACT_BATCH_GROUPING_FAILED,
                         "err=\"no_batch_hash_created\"");
-        continue;
       }
-
-      _flush_to_db(batch_hash);
-      _free_batch_hash(batch_hash);
     } else {
       if (spin_count < ENG_WRITER_SPIN_LIMIT) {
         sched_yield();
@@ -344,6 +439,8 @@ static void _eng_writer_thread_func(void *arg) {
     }
 
     for (uint32_t i = 0; i < dequeued; i++) {
+      // Committed, or given up on
+      watermark_write_committed(msgs[i]->wm, msgs[i]->worker_id);
       eng_writer_queue_free_msg(msgs[i]);
     }
 
@@ -6,6 +6,7 @@ void eng_writer_queue_free_msg_entry(eng_writer_entry_t *e) {
   if (!e)
     return;
   free(e->value);
+  sub_push_free(e->push);
   container_free_db_key_contents(&e->db_key);
 }
 
@@ -2,6 +2,8 @@
 #define eng_writer_queue_MSG_H
 
 #include "engine/container/container_types.h"
+#include "engine/subscription/subscription.h"
+#include "engine/watermark/watermark.h"
 #include <stdatomic.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -9,8 +11,9 @@
 typedef enum {
   WRITE_COND_ALWAYS = 0,        // Standard 'put'. Overwrites whatever is there.
   WRITE_COND_NO_OVERWRITE,      // 'put' only if key does not exist
-  WRITE_COND_INT32_GREATER_THAN // 'put' only if new_val > existing_val
-                                // (Monotonic)
+  WRITE_COND_INT32_GREATER_THAN, // 'put' only if new_val > existing_val
+                                 // (Monotonic)
+  WRITE_COND_ADD_U64             // 'put' new_val + existing_val (Counters)
 } write_condition_t;
 
 typedef struct eng_writer_entry_s {
@@ -25,11 +28,18 @@ typedef struct eng_writer_entry_s {
 
   eng_container_db_key_t db_key;
   write_condition_t write_condition;
+
+  // Optional. Subscriptions to deliver `value` to once it is committed
+  sub_push_t *push;
 } eng_writer_entry_t;
 
 typedef struct eng_writer_msg_s {
   eng_writer_entry_t *entries; // pointer to array
   uint32_t count;
+  // Sending worker, or WATERMARK_NO_WORKER, and the container of its event.
+  // See watermark.h
+  int32_t worker_id;
+  wm_container_t *wm;
 } eng_writer_msg_t;
 
 void eng_writer_queue_free_msg_entry(eng_writer_entry_t *e);
@@ -4,6 +4,8 @@
 #include "lmdb.h"
 #include "mpack.h"
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 
 static const index_def_t DEFAULT_INDEXES[] = {
     {.key = "ts", .type = INDEX_TYPE_I64}, {0}};
@@ -12,6 +14,20 @@ static void _format_index_db_name(const char *key, char *out, size_t size) {
   snprintf(out, size, "index_%s_db", key);
 }
 
+static bool _open_index_db(MDB_env *env, const index_def_t *index_def,
+                           MDB_dbi *db_out) {
+  if (index_def->type == INDEX_TYPE_BSI) {
+    // Slices live in the inverted event index
+    *db_out = 0;
+    return true;
+  }
+  char db_name[MAX_TEXT_VAL_LEN];
+  _format_index_db_name(index_def->key, db_name, sizeof(db_name));
+  // String keys use LMDB's default lexicographic order
+  bool int_keys = index_def->type != INDEX_TYPE_STR;
+  return db_open(env, db_name, int_keys, DB_DUP_KEYS_FIXED_SIZE_VALS, db_out);
+}
+
 static bool _decode_index_def(const char *data, size_t len, index_def_t *out) {
   mpack_reader_t reader;
   mpack_reader_init_data(&reader, data, len);
@@ -206,11 +222,7 @@ bool index_open_registry(MDB_env *env, MDB_dbi dbi,
     index_t index = {0};
     index.index_def = defs[i]; // Moves ownership of the allocated key
 
-    char db_name[MAX_TEXT_VAL_LEN];
-    _format_index_db_name(index.index_def.key, db_name, sizeof(db_name));
-
-    if (!db_open(env, db_name, true, DB_DUP_KEYS_FIXED_SIZE_VALS,
-                 &index.index_db)) {
+    if (!_open_index_db(env, &index.index_def, &index.index_db)) {
       // If we can't open an index DB, the registry is inconsistent
       goto cleanup_on_failure;
     }
@@ -218,7 +230,9 @@ bool index_open_registry(MDB_env *env, MDB_dbi dbi,
     int ret;
     khiter_t k = kh_put(key_index, *key_to_index, index.index_def.key, &ret);
     if (ret == -1) { // Hash put failed
-      db_close(env, index.index_db);
+      if (index.index_db) {
+        db_close(env, index.index_db);
+      }
       goto cleanup_on_failure;
     }
 
@@ -264,6 +278,173 @@ db_put_result_t index_add(const index_def_t *index_def, MDB_env *env,
   return db_commit_txn(txn) ? DB_PUT_OK : DB_PUT_ERR;
 }
 
+bool index_find_def(MDB_env *env, MDB_dbi dbi, const char *key,
+                    index_def_t *index_def_out) {
+  if (!env || !key || !index_def_out) {
+    return false;
+  }
+  MDB_txn *txn = db_create_txn(env, true);
+  if (!txn) {
+    return false;
+  }
+  db_key_t db_key = {.type = DB_KEY_STRING, .key.s = (char *)key};
+  db_get_result_t r;
+  bool found = db_get_view(dbi, txn, &db_key, &r) && r.status == DB_GET_OK &&
+               _decode_index_def(r.value, r.value_len, index_def_out);
+  db_abort_txn(txn);
+  return found;
+}
+
+// Insert a copy of `index` that owns its key
+static bool _map_put(khash_t(key_index) * map, const index_t *index) {
+  char *key = strdup(index->index_def.key);
+  if (!key) {
+    return false;
+  }
+  int ret;
+  khiter_t k = kh_put(key_index, map, key, &ret);
+  if (ret == -1) {
+    free(key);
+    return false;
+  }
+  kh_value(map, k) = *index;
+  kh_value(map, k).index_def.key = key;
+  return true;
+}
+
+khash_t(key_index) * index_map_with(MDB_env *env,
+                                    khash_t(key_index) * key_to_index,
+                                    const index_def_t *index_def,
+                                    bool building) {
+  if (!env || !index_def || !index_def->key) {
+    return NULL;
+  }
+  khash_t(key_index) *map = kh_init(key_index);
+  if (!map) {
+    return NULL;
+  }
+
+  bool found = false;
+  for (khint_t i = 0; key_to_index && i != kh_end(key_to_index); ++i) {
+    if (!kh_exist(key_to_index, i)) {
+      continue;
+    }
+    index_t index = kh_val(key_to_index, i);
+    if (strcmp(index.index_def.key, index_def->key) == 0) {
+      index.building = building;
+      found = true;
+    }
+    if (!_map_put(map, &index)) {
+      index_free_map(map);
+      return NULL;
+    }
+  }
+  if (found) {
+    return map;
+  }
+
+  index_t index = {.index_def = *index_def, .building = building};
+  if (!_open_index_db(env, &index.index_def, &index.index_db) ||
+      !_map_put(map, &index)) {
+    index_free_map(map);
+    return NULL;
+  }
+  return map;
+}
+
+void index_free_map(khash_t(key_index) * key_to_index) {
+  if (!key_to_index) {
+    return;
+  }
+  for (khint_t k = kh_begin(key_to_index); k != kh_end(key_to_index); ++k) {
+    if (kh_exist(key_to_index, k)) {
+      free((char *)kh_key(key_to_index, k));
+    }
+  }
+  kh_destroy(key_index, key_to_index);
+}
+
+bool index_key_from_literal(index_type_t type, const ast_literal_node_t *val,
+                            db_key_t *key_out) {
+  switch (type) {
+  case INDEX_TYPE_I64:
+    if (val->type != AST_LITERAL_NUMBER) {
+      return false;
+    }
+    key_out->type = DB_KEY_I64;
+    key_out->key.i64 = val->number_value;
+    return true;
+  case INDEX_TYPE_F64:
+    if (val->type == AST_LITERAL_STRING) {
+      return false;
+    }
+    key_out->type = DB_KEY_I64;
+    key_out->key.i64 = (int64_t)index_f64_key(
+        val->type == AST_LITERAL_FLOAT ? val->float_value
+                                       : (double)val->number_value);
+    return true;
+  case INDEX_TYPE_STR:
+    if (val->type != AST_LITERAL_STRING) {
+      return false;
+    }
+    key_out->type = DB_KEY_STRING;
+    key_out->key.s = strdup(val->string_value);
+    return key_out->key.s != NULL;
+  case INDEX_TYPE_BSI:
+    return false;
+  }
+  return false;
+}
+
+bool index_bsi_value(const ast_literal_node_t *val, uint64_t *value_out) {
+  if (val->type != AST_LITERAL_NUMBER || val->number_value < 0) {
+    return false;
+  }
+  *value_out = (uint64_t)val->number_value;
+  return true;
+}
+
+uint32_t index_bsi_slices(uint64_t value, uint32_t *slices_out) {
+  uint32_t n = 0;
+  for (uint32_t i = 0; i < INDEX_BSI_SLICES; i++) {
+    if (value & (1ULL << i)) {
+      slices_out[n++] = i;
+    }
+  }
+  slices_out[n++] = INDEX_BSI_EXISTS;
+  return n;
+}
+
+bool index_type_from_str(const char *name, index_type_t *type_out) {
+  if (!name || !type_out) {
+    return false;
+  }
+  if (strcmp(name, "i64") == 0) {
+    *type_out = INDEX_TYPE_I64;
+  } else if (strcmp(name, "f64") == 0) {
+    *type_out = INDEX_TYPE_F64;
+  } else if (strcmp(name, "str") == 0) {
+    *type_out = INDEX_TYPE_STR;
+  } else if (strcmp(name, "bsi") == 0) {
+    *type_out = INDEX_TYPE_BSI;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+uint64_t index_f64_key(double value) {
+  uint64_t bits;
+  // -0.0 and 0.0 are the same key
+  if (value == 0) {
+    value = 0;
+  }
+  memcpy(&bits, &value, sizeof(bits));
+  // Negatives: flip all bits so larger magnitudes sort first.
+  // Positives: set the sign bit so they sort after all negatives.
+  return (bits & (1ULL << 63)) ? ~bits : bits | (1ULL << 63);
+}
+
 bool index_get(const char *key, khash_t(key_index) * key_to_index,
                index_t *index_out) {
   if (!key || !key_to_index)
@@ -295,7 +476,9 @@ void index_close_registry(MDB_env *env, khash_t(key_index) * *key_to_index) {
           free((char *)key_ptr);
         }
         index_t ci = kh_val(*key_to_index, k);
-        db_close(env, ci.index_db);
+        if (ci.index_db) {
+          db_close(env, ci.index_db);
+        }
         // Don't free `ci.index_def.key`, already freed as `key_ptr`
       }
     }
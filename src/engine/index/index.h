@@ -4,10 +4,29 @@
 #include "core/db.h"
 #include "khash.h"
 #include "lmdb.h"
+#include "query/ast.h"
 #include <stdbool.h>
 #include <stdint.h>
 
-typedef enum { INDEX_TYPE_I64 } index_type_t;
+// Range index key types. Each index db maps a tag's value to the ids of the
+// events holding it, ordered by value:
+// - I64: integer values, native int64 keys
+// - F64: integer and decimal values, see `index_f64_key`
+// - STR: string values, compared byte-wise
+// BSI indexes have no index db. They are bit-sliced: integer values are kept
+// as one bitmap of event ids per value bit plus one of the events holding a
+// value, stored in the inverted event index, see `index_bsi_slices`
+typedef enum {
+  INDEX_TYPE_I64,
+  INDEX_TYPE_F64,
+  INDEX_TYPE_STR,
+  INDEX_TYPE_BSI
+} index_type_t;
+
+// Bit slices of a BSI index, one per bit of an unsigned 64-bit value
+#define INDEX_BSI_SLICES 64
+// Slice number of the bitmap of events that hold a value
+#define INDEX_BSI_EXISTS INDEX_BSI_SLICES
 
 // Persisted index definition
 typedef struct index_def_s {
@@ -19,6 +38,9 @@ typedef struct index_def_s {
 typedef struct index_s {
   index_def_t index_def;
   MDB_dbi index_db;
+  // Still being backfilled: new events are written to it, queries must not
+  // read it yet
+  bool building;
 } index_t;
 
 KHASH_MAP_INIT_STR(key_index, index_t)
@@ -58,6 +80,58 @@ bool index_open_registry(MDB_env *env, MDB_dbi dbi,
 db_put_result_t index_add(const index_def_t *index_def, MDB_env *env,
                           MDB_dbi dbi);
 
+// Parses an index type name: `i64`, `f64`, `str` or `bsi`
+bool index_type_from_str(const char *name, index_type_t *type_out);
+
+/**
+ * Key of `value` in an F64 index. Keys compare as unsigned integers in the
+ * same order as the values compare as doubles, so F64 indexes use the same
+ * integer-key layout as I64 ones
+ */
+uint64_t index_f64_key(double value);
+
+/**
+ * Reads the definition of `key` from the registry db `dbi`. Caller frees
+ * `index_def_out->key`
+ */
+bool index_find_def(MDB_env *env, MDB_dbi dbi, const char *key,
+                    index_def_t *index_def_out);
+
+/**
+ * Copy of `key_to_index` (may be NULL) holding `index_def` as well, with its
+ * db opened. An index already in the map only gets its `building` flag set.
+ * The copy owns its keys, see `index_free_map`
+ */
+khash_t(key_index) * index_map_with(MDB_env *env,
+                                    khash_t(key_index) * key_to_index,
+                                    const index_def_t *index_def,
+                                    bool building);
+
+// Free a map replaced by `index_map_with`. Its dbs stay open, the newer map
+// uses them
+void index_free_map(khash_t(key_index) * key_to_index);
+
+/**
+ * Index key of a tag value. False if an index of `type` does not hold values
+ * like `val`, e.g. a string in an I64 index, or if it has no index db (BSI).
+ * STR keys are allocated
+ */
+bool index_key_from_literal(index_type_t type, const ast_literal_node_t *val,
+                            db_key_t *key_out);
+
+/**
+ * Value of `val` in a BSI index. False for values it does not hold: decimals,
+ * strings and negative numbers
+ */
+bool index_bsi_value(const ast_literal_node_t *val, uint64_t *value_out);
+
+/**
+ * Slices of a BSI index an event with `value` belongs to: the set bits of
+ * `value`, then `INDEX_BSI_EXISTS`. Returns the number written to
+ * `slices_out`, which holds `INDEX_BSI_SLICES + 1` entries
+ */
+uint32_t index_bsi_slices(uint64_t value, uint32_t *slices_out);
+
 // Destroy the key index map and close registry
 void index_close_registry(MDB_env *env, khash_t(key_index) * *key_to_index);
 #endif
\ No newline at end of file
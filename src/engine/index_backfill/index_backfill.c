@@ -0,0 +1,760 @@
+#include "index_backfill.h"
+#include "core/bitmaps.h"
+#include "core/db.h"
+#include "core/deadline.h"
+#include "engine/container/container.h"
+#include "engine/container/container_types.h"
+#include "engine/eng_key_format/eng_key_format.h"
+#include "engine/index/index.h"
+#include "engine/op/op.h"
+#include "engine/op_queue/op_queue_msg.h"
+#include "engine/routing/routing.h"
+#include "engine/watermark/watermark.h"
+#include "lmdb.h"
+#include "log/log.h"
+#include "mpack.h"
+#include "query/ast.h"
+#include "uv.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+LOG_INIT(backfill);
+
+// Job keys in the system metadata db are `backfill|<container>|<index key>`,
+// valued with the next event id to scan. Container names never hold a `|`
+#define JOB_KEY_PREFIX "backfill|"
+#define JOB_KEY_PREFIX_LEN (sizeof(JOB_KEY_PREFIX) - 1)
+#define JOB_KEY_MAX_LEN 512
+
+// Poll interval while no job is pending, and the delay before a failed job
+// is retried
+#define IDLE_SLEEP_MS 50
+#define RETRY_SLEEP_MS 1000
+// `should_stop` is checked at least this often while sleeping
+#define SLEEP_SLICE_MS 10
+
+typedef struct backfill_job_s {
+  char *container_name;
+  char *key;
+  uint32_t next_event_id;
+} backfill_job_t;
+
+typedef struct backfill_entry_s {
+  db_key_t key;
+  uint32_t event_id;
+} backfill_entry_t;
+
+typedef struct job_list_s {
+  index_backfill_status_t *jobs;
+  uint32_t count;
+  uint32_t cap;
+  bool ok;
+} job_list_t;
+
+// Return false to stop iterating
+typedef bool (*job_cb)(const backfill_job_t *job, void *arg);
+
+static void _sleep_ms(index_backfill_t *bf, uint32_t ms) {
+  while (ms > 0 && !bf->should_stop) {
+    uint32_t slice = ms < SLEEP_SLICE_MS ? ms : SLEEP_SLICE_MS;
+    uv_sleep(slice);
+    ms -= slice;
+  }
+}
+
+static bool _job_key_into(char *buf, size_t size, const char *container_name,
+                          const char *key) {
+  int n = snprintf(buf, size, JOB_KEY_PREFIX "%s|%s", container_name, key);
+  return n > 0 && (size_t)n < size;
+}
+
+// False if `job_key` is not a job key
+static bool _parse_job_key(const char *job_key, size_t len,
+                           backfill_job_t *job_out) {
+  if (len <= JOB_KEY_PREFIX_LEN ||
+      memcmp(job_key, JOB_KEY_PREFIX, JOB_KEY_PREFIX_LEN) != 0) {
+    return false;
+  }
+  const char *name = job_key + JOB_KEY_PREFIX_LEN;
+  const char *end = job_key + len;
+  const char *sep = memchr(name, '|', (size_t)(end - name));
+  if (!sep || sep == name || sep + 1 == end) {
+    return false;
+  }
+  job_out->container_name = strndup(name, (size_t)(sep - name));
+  job_out->key = strndup(sep + 1, (size_t)(end - sep - 1));
+  if (!job_out->container_name || !job_out->key) {
+    free(job_out->container_name);
+    free(job_out->key);
+    return false;
+  }
+  return true;
+}
+
+static void _free_job(backfill_job_t *job) {
+  free(job->container_name);
+  free(job->key);
+  job->container_name = NULL;
+  job->key = NULL;
+}
+
+static bool _foreach_job(job_cb cb, void *arg) {
+  container_result_t scr = container_get_system();
+  if (!scr.success) {
+    return false;
+  }
+  eng_sys_dc_t *sys = scr.container->data.sys;
+  MDB_txn *txn = db_create_txn(scr.container->env, true);
+  if (!txn) {
+    return false;
+  }
+  MDB_cursor *cursor = db_cursor_open(txn, sys->sys_dc_metadata_db);
+  if (!cursor) {
+    db_abort_txn(txn);
+    return false;
+  }
+
+  db_key_t start = {.type = DB_KEY_STRING, .key.s = JOB_KEY_PREFIX};
+  db_cursor_entry_t entry;
+  db_cursor_get_result_t r =
+      db_cursor_get(cursor, &entry, MDB_SET_RANGE, &start);
+  bool ok = true;
+  while (r == DB_CURSOR_OK) {
+    if (entry.key_len < JOB_KEY_PREFIX_LEN ||
+        memcmp(entry.key, JOB_KEY_PREFIX, JOB_KEY_PREFIX_LEN) != 0) {
+      break;
+    }
+    backfill_job_t job = {0};
+    if (entry.value_len == sizeof(uint32_t) &&
+        _parse_job_key(entry.key, entry.key_len, &job)) {
+      memcpy(&job.next_event_id, entry.value, sizeof(uint32_t));
+      bool more = cb(&job, arg);
+      _free_job(&job);
+      if (!more) {
+        break;
+      }
+    }
+    r = db_cursor_get(cursor, &entry, MDB_NEXT, NULL);
+  }
+  if (r == DB_CURSOR_ERR) {
+    ok = false;
+  }
+  db_cursor_close(cursor);
+  db_abort_txn(txn);
+  return ok;
+}
+
+static bool _put_job(MDB_txn *txn, MDB_dbi db, const char *container_name,
+                     const char *key, uint32_t next_event_id,
+                     bool no_overwrite) {
+  char job_key[JOB_KEY_MAX_LEN];
+  if (!_job_key_into(job_key, sizeof(job_key), container_name, key)) {
+    return false;
+  }
+  db_key_t db_key = {.type = DB_KEY_STRING, .key.s = job_key};
+  db_put_result_t pr = db_put(db, txn, &db_key, &next_event_id,
+                              sizeof(uint32_t), false, no_overwrite);
+  return pr == DB_PUT_OK || (no_overwrite && pr == DB_PUT_KEY_EXISTS);
+}
+
+// Record that events below `next_event_id` are indexed, or drop the job once
+// it is done
+static bool _save_job(const backfill_job_t *job, bool done) {
+  container_result_t scr = container_get_system();
+  if (!scr.success) {
+    return false;
+  }
+  MDB_dbi db = scr.container->data.sys->sys_dc_metadata_db;
+  MDB_txn *txn = db_create_txn(scr.container->env, false);
+  if (!txn) {
+    return false;
+  }
+  bool ok;
+  if (done) {
+    char job_key[JOB_KEY_MAX_LEN];
+    db_key_t db_key = {.type = DB_KEY_STRING, .key.s = job_key};
+    ok = _job_key_into(job_key, sizeof(job_key), job->container_name,
+                       job->key) &&
+         db_delete(db, txn, &db_key);
+  } else {
+    ok = _put_job(txn, db, job->container_name, job->key, job->next_event_id,
+                  false);
+  }
+  if (!ok) {
+    db_abort_txn(txn);
+    return false;
+  }
+  return db_commit_txn(txn);
+}
+
+// Value of `key` in a msgpack event, as the writer sees it on a new event.
+// `str_out` holds a copy of string values, the caller frees it
+static bool _event_value(const char *data, size_t size, const char *key,
+                         ast_literal_node_t *val_out, char **str_out) {
+  size_t key_len = strlen(key);
+  bool found = false;
+
+  mpack_reader_t reader;
+  mpack_reader_init_data(&reader, data, size);
+  uint32_t n = mpack_expect_map(&reader);
+  for (uint32_t i = 0;
+       i < n && !found && mpack_reader_error(&reader) == mpack_ok; i++) {
+    uint32_t len = mpack_expect_str(&reader);
+    const char *k = mpack_read_bytes_inplace(&reader, len);
+    mpack_done_str(&reader);
+    if (mpack_reader_error(&reader) != mpack_ok) {
+      break;
+    }
+    if (len != key_len || memcmp(k, key, len) != 0) {
+      mpack_discard(&reader);
+      continue;
+    }
+
+    mpack_tag_t tag = mpack_read_tag(&reader);
+    switch (mpack_tag_type(&tag)) {
+    case mpack_type_int:
+      val_out->type = AST_LITERAL_NUMBER;
+      val_out->number_value = mpack_tag_int_value(&tag);
+      found = true;
+      break;
+    case mpack_type_uint:
+      val_out->type = AST_LITERAL_NUMBER;
+      val_out->number_value = (int64_t)mpack_tag_uint_value(&tag);
+      found = true;
+      break;
+    case mpack_type_double:
+      val_out->type = AST_LITERAL_FLOAT;
+      val_out->float_value = mpack_tag_double_value(&tag);
+      found = true;
+      break;
+    case mpack_type_str: {
+      uint32_t str_len = mpack_tag_str_length(&tag);
+      const char *s = mpack_read_bytes_inplace(&reader, str_len);
+      mpack_done_str(&reader);
+      if (mpack_reader_error(&reader) == mpack_ok) {
+        *str_out = strndup(s, str_len);
+        val_out->type = AST_LITERAL_STRING;
+        val_out->string_value = *str_out;
+        val_out->string_value_len = str_len;
+        found = *str_out != NULL;
+      }
+      break;
+    }
+    default:
+      break;
+    }
+  }
+  mpack_reader_destroy(&reader);
+  return found;
+}
+
+// Only `ts` and custom tags are indexed, see `_idx_resolve_tag_val`
+static bool _is_indexable_key(const char *key) {
+  return strcmp(key, "id") != 0 && strcmp(key, "in") != 0 &&
+         strcmp(key, "entity") != 0;
+}
+
+// Index key order (integer keys compare as unsigned), then event id
+static int _entry_cmp(const void *a, const void *b) {
+  const backfill_entry_t *ea = a;
+  const backfill_entry_t *eb = b;
+  int c;
+  if (ea->key.type == DB_KEY_STRING) {
+    c = strcmp(ea->key.key.s, eb->key.key.s);
+  } else {
+    uint64_t ka = (uint64_t)ea->key.key.i64;
+    uint64_t kb = (uint64_t)eb->key.key.i64;
+    c = ka < kb ? -1 : ka > kb;
+  }
+  if (c != 0) {
+    return c;
+  }
+  return ea->event_id < eb->event_id ? -1 : ea->event_id > eb->event_id;
+}
+
+// OR `bm` into BSI slice `slice` of `key`, through the op queue that owns
+// the bitmap. Takes ownership of `bm`
+static bool _enqueue_bsi_slice(index_backfill_t *bf, eng_container_t *c,
+                               const char *key, uint32_t slice, bitmap_t *bm) {
+  char slice_key[MAX_TEXT_VAL_LEN];
+  char ser_db_key[512];
+  eng_container_db_key_t db_key = {.dc_type = CONTAINER_TYPE_USR,
+                                   .usr_db_type = USR_DB_INVERTED_EVENT_INDEX};
+  db_key.db_key.type = DB_KEY_STRING;
+  if (!bsi_key_into(slice_key, sizeof(slice_key), key, slice)) {
+    bitmap_free(bm);
+    return false;
+  }
+  db_key.container_name = strdup(c->name);
+  db_key.db_key.key.s = strdup(slice_key);
+  if (!db_key.container_name || !db_key.db_key.key.s ||
+      !db_key_into(ser_db_key, sizeof(ser_db_key), &db_key)) {
+    container_free_db_key_contents(&db_key);
+    bitmap_free(bm);
+    return false;
+  }
+
+  // The op owns the db key contents and the bitmap from here on
+  op_t *op = op_create_or(&db_key, bm);
+  if (!op) {
+    container_free_db_key_contents(&db_key);
+    bitmap_free(bm);
+    return false;
+  }
+  op_queue_msg_t *msg = op_queue_msg_create(ser_db_key, op);
+  if (!msg) {
+    op_destroy(op);
+    return false;
+  }
+  int queue_idx =
+      route_key_to_queue(ser_db_key, (int)bf->config.op_queue_total_count);
+  if (!op_queue_enqueue(&bf->config.op_queues[queue_idx], msg)) {
+    LOG_ACTION_WARN(ACT_QUEUE_FULL, "queue_type=op queue_id=%d", queue_idx);
+    op_queue_msg_free(msg);
+    return false;
+  }
+  return true;
+}
+
+// BSI slices of up to one chunk of events, see `_backfill_chunk`. Events the
+// worker already sent are ORed in again, which changes nothing
+static bool _backfill_bsi_chunk(index_backfill_t *bf, eng_container_t *c,
+                                backfill_job_t *job, bool *done_out) {
+  if (!bf->config.op_queues) {
+    return false;
+  }
+  bitmap_t *slices[INDEX_BSI_SLICES + 1] = {0};
+  MDB_txn *txn = db_create_txn(c->env, true);
+  if (!txn) {
+    return false;
+  }
+  MDB_cursor *cursor = db_cursor_open(txn, c->data.usr->events_db);
+  if (!cursor) {
+    db_abort_txn(txn);
+    return false;
+  }
+
+  bool indexable = _is_indexable_key(job->key);
+  bool ok = true;
+  uint32_t scanned = 0;
+  uint32_t last_id = 0;
+  uint32_t set[INDEX_BSI_SLICES + 1];
+  db_key_t start = {.type = DB_KEY_U32, .key.u32 = job->next_event_id};
+  db_cursor_entry_t entry;
+  db_cursor_get_result_t r =
+      db_cursor_get(cursor, &entry, MDB_SET_RANGE, &start);
+  while (ok && r == DB_CURSOR_OK && scanned < bf->config.chunk_events) {
+    memcpy(&last_id, entry.key, sizeof(uint32_t));
+    ast_literal_node_t val = {0};
+    char *str = NULL;
+    uint64_t value;
+    if (indexable &&
+        _event_value(entry.value, entry.value_len, job->key, &val, &str) &&
+        index_bsi_value(&val, &value)) {
+      uint32_t n = index_bsi_slices(value, set);
+      for (uint32_t i = 0; i < n && ok; i++) {
+        if (!slices[set[i]]) {
+          slices[set[i]] = bitmap_create();
+        }
+        ok = slices[set[i]] != NULL;
+        if (ok) {
+          bitmap_add(slices[set[i]], last_id);
+        }
+      }
+    }
+    free(str);
+    scanned++;
+    r = db_cursor_get(cursor, &entry, MDB_NEXT, NULL);
+  }
+  db_cursor_close(cursor);
+  db_abort_txn(txn);
+  ok = ok && r != DB_CURSOR_ERR;
+
+  // The engine writer bumps the commit seq once the consumer flushes these
+  for (uint32_t s = 0; s <= INDEX_BSI_SLICES; s++) {
+    if (!slices[s]) {
+      continue;
+    }
+    if (ok) {
+      ok = _enqueue_bsi_slice(bf, c, job->key, s, slices[s]);
+    } else {
+      bitmap_free(slices[s]);
+    }
+  }
+  if (!ok) {
+    return false;
+  }
+  if (scanned > 0) {
+    job->next_event_id = last_id + 1;
+  }
+  *done_out = r == DB_CURSOR_NOTFOUND;
+  return true;
+}
+
+// Index up to one chunk of events from `job->next_event_id` on. Sets
+// `done_out` once the scan passed the last event
+static bool _backfill_chunk(index_backfill_t *bf, eng_container_t *c,
+                            const index_t *index, backfill_job_t *job,
+                            bool *done_out) {
+  if (index->index_def.type == INDEX_TYPE_BSI) {
+    return _backfill_bsi_chunk(bf, c, job, done_out);
+  }
+  uint32_t max = bf->config.chunk_events;
+  backfill_entry_t *entries = malloc(max * sizeof(backfill_entry_t));
+  if (!entries) {
+    return false;
+  }
+  // Scan under a read txn, the container's write lock is only taken for the
+  // puts
+  MDB_txn *txn = db_create_txn(c->env, true);
+  if (!txn) {
+    free(entries);
+    return false;
+  }
+  MDB_cursor *cursor = db_cursor_open(txn, c->data.usr->events_db);
+  if (!cursor) {
+    db_abort_txn(txn);
+    free(entries);
+    return false;
+  }
+
+  bool indexable = _is_indexable_key(job->key);
+  uint32_t scanned = 0;
+  uint32_t count = 0;
+  uint32_t last_id = 0;
+  db_key_t start = {.type = DB_KEY_U32, .key.u32 = job->next_event_id};
+  db_cursor_entry_t entry;
+  db_cursor_get_result_t r =
+      db_cursor_get(cursor, &entry, MDB_SET_RANGE, &start);
+  while (r == DB_CURSOR_OK && scanned < max) {
+    memcpy(&last_id, entry.key, sizeof(uint32_t));
+    ast_literal_node_t val = {0};
+    char *str = NULL;
+    if (indexable &&
+        _event_value(entry.value, entry.value_len, job->key, &val, &str) &&
+        index_key_from_literal(index->index_def.type, &val,
+                               &entries[count].key)) {
+      entries[count++].event_id = last_id;
+    }
+    free(str);
+    scanned++;
+    r = db_cursor_get(cursor, &entry, MDB_NEXT, NULL);
+  }
+  db_cursor_close(cursor);
+  db_abort_txn(txn);
+
+  // Sorted puts touch each index page once
+  qsort(entries, count, sizeof(backfill_entry_t), _entry_cmp);
+  bool ok = r != DB_CURSOR_ERR;
+  txn = NULL;
+  if (ok && count > 0) {
+    txn = db_create_txn(c->env, false);
+    ok = txn != NULL;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    if (ok) {
+      // Events the writer already indexed are duplicates, which LMDB ignores
+      db_put_result_t pr =
+          db_put(index->index_db, txn, &entries[i].key, &entries[i].event_id,
+                 sizeof(uint32_t), false, false);
+      ok = pr != DB_PUT_ERR;
+    }
+    if (entries[i].key.type == DB_KEY_STRING) {
+      free(entries[i].key.key.s);
+    }
+  }
+  free(entries);
+
+  if (!ok) {
+    db_abort_txn(txn);
+    return false;
+  }
+  if (txn) {
+    if (!db_commit_txn(txn)) {
+      return false;
+    }
+    container_bump_commit_seq(c);
+  }
+  if (scanned > 0) {
+    job->next_event_id = last_id + 1;
+  }
+  *done_out = r == DB_CURSOR_NOTFOUND;
+  return true;
+}
+
+// Register the index in the container and let queries read it
+static bool _finish_job(eng_container_t *c, const index_def_t *index_def,
+                        const backfill_job_t *job) {
+  db_put_result_t pr = index_add(index_def, c->env,
+                                 c->data.usr->index_registry_local_db);
+  if (pr == DB_PUT_ERR || !container_publish_index(c, index_def, false)) {
+    return false;
+  }
+  return _save_job(job, true);
+}
+
+// Returns false if the job should be retried later
+static bool _run_job(index_backfill_t *bf, backfill_job_t *job) {
+  container_result_t scr = container_get_system();
+  if (!scr.success) {
+    return false;
+  }
+  eng_container_t *sys_c = scr.container;
+
+  index_def_t index_def = {0};
+  if (!index_find_def(sys_c->env, sys_c->data.sys->index_registry_global_db,
+                      job->key, &index_def)) {
+    LOG_ACTION_WARN(ACT_BACKFILL_FAILED,
+                    "container=%s key=\"%s\" err=\"Index not registered\"",
+                    job->container_name, job->key);
+    return _save_job(job, true);
+  }
+
+  MDB_txn *sys_txn = db_create_txn(sys_c->env, true);
+  if (!sys_txn) {
+    free(index_def.key);
+    return false;
+  }
+  container_result_t cr =
+      container_get_user(job->container_name, false, sys_txn);
+  db_abort_txn(sys_txn);
+  if (!cr.success) {
+    free(index_def.key);
+    if (cr.error_code == CONTAINER_ERR_NOT_FOUND) {
+      return _save_job(job, true);
+    }
+    return false;
+  }
+  eng_container_t *c = cr.container;
+
+  bool ok = true;
+  index_t index;
+  bool present = index_get(job->key, atomic_load(&c->data.usr->key_to_index),
+                           &index);
+  if (present && !index.building) {
+    // Registered by a finished backfill, or the container is newer than the
+    // index
+    ok = _save_job(job, true);
+    goto cleanup;
+  }
+  if (!present) {
+    if (!container_publish_index(c, &index_def, true)) {
+      ok = false;
+      goto cleanup;
+    }
+    // Workers may have encoded events against the old indexes, wait until
+    // those are committed so the scan cannot pass them
+    deadline_t deadline;
+    deadline_init(&deadline, 0, &bf->alive);
+    if (watermark_wait_queued(job->container_name, &deadline) !=
+        WATERMARK_REACHED) {
+      ok = false;
+      goto cleanup;
+    }
+    index_get(job->key, atomic_load(&c->data.usr->key_to_index), &index);
+  }
+
+  LOG_ACTION_INFO(ACT_BACKFILL_STARTED,
+                  "container=%s key=\"%s\" next_event_id=%u",
+                  job->container_name, job->key, job->next_event_id);
+  bool tail_checked = false;
+  while (!bf->should_stop) {
+    bool done = false;
+    if (!_backfill_chunk(bf, c, &index, job, &done)) {
+      ok = false;
+      break;
+    }
+    if (done && !tail_checked) {
+      // One more pass over events committed while the last chunk was read,
+      // ids arrive out of order. Entries the writer added are duplicates
+      tail_checked = true;
+      continue;
+    }
+    if (done) {
+      ok = _finish_job(c, &index_def, job);
+      if (ok) {
+        LOG_ACTION_INFO(ACT_BACKFILL_DONE, "container=%s key=\"%s\"",
+                        job->container_name, job->key);
+      }
+      break;
+    }
+    if (!_save_job(job, false)) {
+      ok = false;
+      break;
+    }
+    LOG_ACTION_DEBUG(ACT_BACKFILL_PROGRESS,
+                     "container=%s key=\"%s\" next_event_id=%u",
+                     job->container_name, job->key, job->next_event_id);
+    _sleep_ms(bf, bf->config.throttle_ms);
+  }
+
+cleanup:
+  if (!ok) {
+    LOG_ACTION_ERROR(ACT_BACKFILL_FAILED,
+                     "container=%s key=\"%s\" next_event_id=%u",
+                     job->container_name, job->key, job->next_event_id);
+  }
+  container_release(c);
+  free(index_def.key);
+  return ok;
+}
+
+static bool _first_job_cb(const backfill_job_t *job, void *arg) {
+  backfill_job_t *out = arg;
+  out->container_name = strdup(job->container_name);
+  out->key = strdup(job->key);
+  out->next_event_id = job->next_event_id;
+  if (!out->container_name || !out->key) {
+    _free_job(out);
+  }
+  return false;
+}
+
+static void _backfill_thread_func(void *arg) {
+  index_backfill_t *bf = (index_backfill_t *)arg;
+
+  log_init_backfill();
+  if (!LOG_CATEGORY) {
+    fprintf(stderr,
+            "FATAL: Failed to initialize logging for backfill thread\n");
+    return;
+  }
+  LOG_ACTION_INFO(ACT_THREAD_STARTED, "thread_type=backfill");
+
+  while (!bf->should_stop) {
+    if (!atomic_exchange(&bf->pending, false)) {
+      _sleep_ms(bf, IDLE_SLEEP_MS);
+      continue;
+    }
+    backfill_job_t job = {0};
+    if (!_foreach_job(_first_job_cb, &job)) {
+      atomic_store(&bf->pending, true);
+      _sleep_ms(bf, RETRY_SLEEP_MS);
+      continue;
+    }
+    if (!job.container_name) {
+      continue;
+    }
+    // Jobs are run one at a time, others may be waiting
+    atomic_store(&bf->pending, true);
+    if (!_run_job(bf, &job)) {
+      _sleep_ms(bf, RETRY_SLEEP_MS);
+    }
+    _free_job(&job);
+  }
+
+  LOG_ACTION_INFO(ACT_THREAD_STOPPED, "thread_type=backfill");
+}
+
+bool index_backfill_start(index_backfill_t *bf,
+                          const index_backfill_config_t *config) {
+  if (!bf || !config || config->chunk_events == 0) {
+    return false;
+  }
+  bf->config = *config;
+  bf->should_stop = false;
+  atomic_init(&bf->alive, 1);
+  // Resume jobs persisted before a restart
+  atomic_init(&bf->pending, true);
+  return uv_thread_create(&bf->thread, _backfill_thread_func, bf) == 0;
+}
+
+bool index_backfill_stop(index_backfill_t *bf) {
+  if (!bf) {
+    return false;
+  }
+  bf->should_stop = true;
+  atomic_store(&bf->alive, 0);
+  return uv_thread_join(&bf->thread) == 0;
+}
+
+bool index_backfill_schedule(index_backfill_t *bf, const char *key) {
+  if (!bf || !key) {
+    return false;
+  }
+  container_result_t scr = container_get_system();
+  if (!scr.success) {
+    return false;
+  }
+  char **names = NULL;
+  uint32_t count = 0;
+  if (!container_list_user(&names, &count)) {
+    return false;
+  }
+
+  bool ok = true;
+  if (count > 0) {
+    MDB_dbi db = scr.container->data.sys->sys_dc_metadata_db;
+    MDB_txn *txn = db_create_txn(scr.container->env, false);
+    ok = txn != NULL;
+    for (uint32_t i = 0; ok && i < count; i++) {
+      ok = _put_job(txn, db, names[i], key, USR_NEXT_EVENT_ID_INIT_VAL, true);
+    }
+    if (ok) {
+      ok = db_commit_txn(txn);
+    } else if (txn) {
+      db_abort_txn(txn);
+    }
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    free(names[i]);
+  }
+  free(names);
+
+  if (ok && count > 0) {
+    atomic_store(&bf->pending, true);
+  }
+  return ok;
+}
+
+static bool _list_job_cb(const backfill_job_t *job, void *arg) {
+  job_list_t *list = arg;
+  if (list->count == list->cap) {
+    uint32_t cap = list->cap ? list->cap * 2 : 8;
+    index_backfill_status_t *grown =
+        realloc(list->jobs, cap * sizeof(index_backfill_status_t));
+    if (!grown) {
+      list->ok = false;
+      return false;
+    }
+    list->jobs = grown;
+    list->cap = cap;
+  }
+  index_backfill_status_t *s = &list->jobs[list->count];
+  s->container_name = strdup(job->container_name);
+  s->key = strdup(job->key);
+  s->next_event_id = job->next_event_id;
+  list->count++;
+  if (!s->container_name || !s->key) {
+    list->ok = false;
+    return false;
+  }
+  return true;
+}
+
+bool index_backfill_list(index_backfill_status_t **jobs_out,
+                         uint32_t *count_out) {
+  if (!jobs_out || !count_out) {
+    return false;
+  }
+  job_list_t list = {.ok = true};
+  if (!_foreach_job(_list_job_cb, &list) || !list.ok) {
+    index_backfill_free_list(list.jobs, list.count);
+    return false;
+  }
+  *jobs_out = list.jobs;
+  *count_out = list.count;
+  return true;
+}
+
+void index_backfill_free_list(index_backfill_status_t *jobs, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    free(jobs[i].container_name);
+    free(jobs[i].key);
+  }
+  free(jobs);
+}
@@ -0,0 +1,75 @@
+#ifndef INDEX_BACKFILL_H
+#define INDEX_BACKFILL_H
+
+/**
+Online index backfill.
+`INDEX` registers an index globally and containers created afterwards get it
+on creation. Containers that already exist are backfilled by a background
+thread, one job per (container, index key):
+- The index is published to the open container as building, so the writer
+  adds entries for new events while queries keep rejecting it. Events queued
+  before the publish were encoded without the index, the scan starts once
+  they are committed.
+- Older events are scanned from events_db in id order, in throttled chunks.
+  Each chunk is read under a read txn, then its index entries are sorted and
+  written in one write txn, so the writer only waits for the puts. BSI indexes
+  have no index db, their slices of each chunk are ORed in via the op queues.
+- Once the scan reaches the last event the index is registered in the
+  container's local registry and becomes queryable.
+Jobs and their progress live in the system metadata db, so a backfill
+interrupted by a restart resumes from its last chunk. */
+
+#include "engine/op_queue/op_queue.h"
+#include "uv.h" // IWYU pragma: keep
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct index_backfill_config_s {
+  // Events scanned per chunk
+  uint32_t chunk_events;
+  // Pause between chunks, leaves room for the writer
+  uint32_t throttle_ms;
+  // Where BSI slices are sent, BSI backfills fail without them
+  op_queue_t *op_queues;
+  uint32_t op_queue_total_count;
+} index_backfill_config_t;
+
+typedef struct index_backfill_s {
+  index_backfill_config_t config;
+  uv_thread_t thread;
+  volatile bool should_stop;
+  // 0 once stopping, ends waits on the writer
+  atomic_int alive;
+  // Set when jobs may be waiting
+  atomic_bool pending;
+} index_backfill_t;
+
+// A pending job, see `index_backfill_list`
+typedef struct index_backfill_status_s {
+  char *container_name;
+  char *key;
+  // Events below this id are indexed
+  uint32_t next_event_id;
+} index_backfill_status_t;
+
+bool index_backfill_start(index_backfill_t *bf,
+                          const index_backfill_config_t *config);
+bool index_backfill_stop(index_backfill_t *bf);
+
+/**
+ * Queue a backfill of the index on `key` for every user container on disk.
+ * Call after the index was added to the global registry
+ */
+bool index_backfill_schedule(index_backfill_t *bf, const char *key);
+
+/**
+ * Pending jobs in (container, key) order. Caller frees them with
+ * `index_backfill_free_list`
+ */
+bool index_backfill_list(index_backfill_status_t **jobs_out,
+                         uint32_t *count_out);
+
+void index_backfill_free_list(index_backfill_status_t *jobs, uint32_t count);
+
+#endif // INDEX_BACKFILL_H
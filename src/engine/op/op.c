@@ -14,15 +14,26 @@ op_t *op_create(op_type_t op_type, const eng_container_db_key_t *db_key,
   op->op_type = op_type;
   memcpy(&op->db_key, db_key, sizeof(eng_container_db_key_t));
   op->value = value;
+  op->bm = NULL;
 
   return op;
 }
 
+op_t *op_create_or(const eng_container_db_key_t *db_key, bitmap_t *bm) {
+  op_t *op = op_create(OP_TYPE_OR, db_key, 0);
+  if (!op) {
+    return NULL;
+  }
+  op->bm = bm;
+  return op;
+}
+
 void op_destroy(op_t *op) {
   if (!op) {
     return;
   }
 
   container_free_db_key_contents(&op->db_key);
+  bitmap_free(op->bm);
   free(op);
 }
@@ -2,9 +2,10 @@
 #define op_H
 
 /**
- * Operation types for bitmaps
+ * Operation types for bitmaps and counters
  */
 
+#include "core/bitmaps.h"
 #include "engine/container/container_types.h"
 #include <stddef.h>
 #include <stdint.h>
@@ -12,16 +13,21 @@
 typedef enum {
   OP_TYPE_NONE = 0,
   OP_TYPE_ADD,
+  OP_TYPE_OR,   // union `bm` into the bitmap, e.g. a view backfill
+  OP_TYPE_INCR, // add `value` to a counter, see rollup.h
 } op_type_t;
 
 typedef struct {
   op_type_t op_type;
   eng_container_db_key_t db_key;
-  uint32_t value;
+  uint32_t value; // event id, or the increment of OP_TYPE_INCR
+  bitmap_t *bm; // OP_TYPE_OR only, owned by the op
 } op_t;
 
 op_t *op_create(op_type_t op_type, const eng_container_db_key_t *db_key,
                 uint32_t value);
+// Takes ownership of `bm`
+op_t *op_create_or(const eng_container_db_key_t *db_key, bitmap_t *bm);
 void op_destroy(op_t *op);
 
 #endif
\ No newline at end of file
@@ -9,6 +9,8 @@ op_queue_msg_t *op_queue_msg_create(const char *key, op_t *op) {
 
   msg->ser_db_key = strdup(key); // takes ownership of key
   msg->op = op;                  // takes ownership of op
+  msg->worker_id = WATERMARK_NO_WORKER;
+  msg->wm = NULL;
 
   return msg;
 }
@@ -2,12 +2,17 @@
 #define op_queue_MSG_H
 
 #include "engine/op/op.h"
+#include "engine/watermark/watermark.h"
 #include <stdint.h>
 
 typedef struct op_queue_msg_s {
   op_t *op;
   char *ser_db_key; // serialized db key. hashed and mapped to an actual op
                     // queue owned by a dedicated consumer thread
+  // Sending worker, or WATERMARK_NO_WORKER, and the container of its event.
+  // See watermark.h
+  int32_t worker_id;
+  wm_container_t *wm;
 } op_queue_msg_t;
 
 op_queue_msg_t *op_queue_msg_create(const char *ser_db_key, op_t *op);
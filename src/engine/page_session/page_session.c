@@ -0,0 +1,228 @@
+#include "page_session.h"
+#include "core/bitmaps.h"
+#include "uthash.h"
+#include "uv.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct page_session_s {
+  uint64_t handle;
+  char *container_name;
+  uint64_t query_hash;
+  bitmap_t *events;
+  size_t bytes; // charged against the budget
+  uint64_t last_used_ms;
+  UT_hash_handle hh;
+} page_session_t;
+
+// Hash order is use order, the head is the least recently used
+static struct {
+  bool initialized;
+  uv_mutex_t lock;
+  page_session_t *sessions;
+  size_t max_bytes;
+  size_t bytes;
+  uint64_t ttl_ms;
+  // Handles are a counter mixed with a seed, so they can't be guessed
+  uint64_t seed;
+  uint64_t counter;
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+  uint64_t expirations;
+} g_page_session = {0};
+
+static uint64_t _now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL;
+}
+
+static uint64_t _splitmix64(uint64_t x) {
+  x += 0x9E3779B97F4A7C15ULL;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+static void _session_free(page_session_t *s) {
+  bitmap_free(s->events);
+  free(s->container_name);
+  free(s);
+}
+
+// Caller holds the lock
+static void _remove(page_session_t *s) {
+  HASH_DEL(g_page_session.sessions, s);
+  g_page_session.bytes -= s->bytes;
+  _session_free(s);
+}
+
+// Caller holds the lock. Moves `s` to the tail
+static void _touch(page_session_t *s, uint64_t now_ms) {
+  HASH_DEL(g_page_session.sessions, s);
+  HASH_ADD(hh, g_page_session.sessions, handle, sizeof(uint64_t), s);
+  s->last_used_ms = now_ms;
+}
+
+// Caller holds the lock. Expired sessions are the least recently used, a ttl
+// of 0 never expires
+static void _expire(uint64_t now_ms) {
+  page_session_t *s;
+  while (g_page_session.ttl_ms && (s = g_page_session.sessions) &&
+         now_ms - s->last_used_ms >= g_page_session.ttl_ms) {
+    _remove(s);
+    g_page_session.expirations++;
+  }
+}
+
+// Caller holds the lock. Positive, to read back as a number literal
+static uint64_t _new_handle(void) {
+  for (;;) {
+    uint64_t h = _splitmix64(g_page_session.seed + ++g_page_session.counter) &
+                 (uint64_t)INT64_MAX;
+    page_session_t *existing = NULL;
+    HASH_FIND(hh, g_page_session.sessions, &h, sizeof(uint64_t), existing);
+    if (h && !existing) {
+      return h;
+    }
+  }
+}
+
+bool page_session_init(size_t max_bytes, uint64_t ttl_ms) {
+  if (g_page_session.initialized) {
+    return true;
+  }
+  if (max_bytes == 0) {
+    return true;
+  }
+  if (uv_mutex_init(&g_page_session.lock) != 0) {
+    return false;
+  }
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  g_page_session.seed = _splitmix64((uint64_t)ts.tv_sec * 1000000000ULL +
+                                    (uint64_t)ts.tv_nsec) ^
+                        (uint64_t)(uintptr_t)&g_page_session;
+  g_page_session.counter = 0;
+  g_page_session.sessions = NULL;
+  g_page_session.max_bytes = max_bytes;
+  g_page_session.bytes = 0;
+  g_page_session.ttl_ms = ttl_ms;
+  g_page_session.hits = 0;
+  g_page_session.misses = 0;
+  g_page_session.evictions = 0;
+  g_page_session.expirations = 0;
+  g_page_session.initialized = true;
+  return true;
+}
+
+void page_session_destroy(void) {
+  if (!g_page_session.initialized) {
+    return;
+  }
+  g_page_session.initialized = false;
+
+  page_session_t *s, *tmp;
+  HASH_ITER(hh, g_page_session.sessions, s, tmp) {
+    HASH_DEL(g_page_session.sessions, s);
+    _session_free(s);
+  }
+  uv_mutex_destroy(&g_page_session.lock);
+  g_page_session.bytes = 0;
+}
+
+uint64_t page_session_put(const char *container_name, uint64_t query_hash,
+                          bitmap_t *events) {
+  if (!g_page_session.initialized || !container_name || !events) {
+    bitmap_free(events);
+    return 0;
+  }
+
+  size_t bytes = sizeof(page_session_t) + strlen(container_name) +
+                 bitmap_size_in_bytes(events);
+  if (bytes > g_page_session.max_bytes) {
+    bitmap_free(events);
+    return 0;
+  }
+
+  page_session_t *s = calloc(1, sizeof(page_session_t));
+  if (!s) {
+    bitmap_free(events);
+    return 0;
+  }
+  s->events = events;
+  s->container_name = strdup(container_name);
+  if (!s->container_name) {
+    _session_free(s);
+    return 0;
+  }
+  s->query_hash = query_hash;
+  s->bytes = bytes;
+
+  uv_mutex_lock(&g_page_session.lock);
+  uint64_t now_ms = _now_ms();
+  _expire(now_ms);
+  while (g_page_session.sessions &&
+         g_page_session.bytes + bytes > g_page_session.max_bytes) {
+    _remove(g_page_session.sessions);
+    g_page_session.evictions++;
+  }
+  s->handle = _new_handle();
+  s->last_used_ms = now_ms;
+  HASH_ADD(hh, g_page_session.sessions, handle, sizeof(uint64_t), s);
+  g_page_session.bytes += bytes;
+  uint64_t handle = s->handle;
+  uv_mutex_unlock(&g_page_session.lock);
+  return handle;
+}
+
+bitmap_t *page_session_page(uint64_t handle, const char *container_name,
+                            uint64_t query_hash, uint32_t limit,
+                            uint32_t start_val, uint32_t *next_cursor_out) {
+  *next_cursor_out = 0;
+  if (!g_page_session.initialized || !container_name) {
+    return NULL;
+  }
+
+  bitmap_t *page = NULL;
+  uv_mutex_lock(&g_page_session.lock);
+  uint64_t now_ms = _now_ms();
+  _expire(now_ms);
+  page_session_t *s = NULL;
+  HASH_FIND(hh, g_page_session.sessions, &handle, sizeof(uint64_t), s);
+  if (s && s->query_hash == query_hash &&
+      strcmp(s->container_name, container_name) == 0) {
+    page = bitmap_page(s->events, limit, start_val, next_cursor_out);
+  }
+  if (!page) {
+    g_page_session.misses++;
+  } else if (*next_cursor_out == 0) {
+    // Last page, nothing left to keep
+    g_page_session.hits++;
+    _remove(s);
+  } else {
+    g_page_session.hits++;
+    _touch(s, now_ms);
+  }
+  uv_mutex_unlock(&g_page_session.lock);
+  return page;
+}
+
+void page_session_get_stats(page_session_stats_t *stats_out) {
+  memset(stats_out, 0, sizeof(page_session_stats_t));
+  if (!g_page_session.initialized) {
+    return;
+  }
+  uv_mutex_lock(&g_page_session.lock);
+  stats_out->hits = g_page_session.hits;
+  stats_out->misses = g_page_session.misses;
+  stats_out->evictions = g_page_session.evictions;
+  stats_out->expirations = g_page_session.expirations;
+  stats_out->sessions = HASH_COUNT(g_page_session.sessions);
+  stats_out->bytes = g_page_session.bytes;
+  uv_mutex_unlock(&g_page_session.lock);
+}
@@ -0,0 +1,66 @@
+#ifndef PAGE_SESSION_H
+#define PAGE_SESSION_H
+
+/**
+Paging sessions for `session:` queries.
+The first page of a session evaluates the query as usual and keeps the whole
+result bitmap under an opaque handle. Later pages slice the kept bitmap
+instead of evaluating again. Events never change once written, so a kept
+result is a snapshot of the matches at the first page: later events are not
+added, and no LMDB txn is held between pages.
+Bounded by bytes, least recently used first out. A session expires once it
+goes unused for the ttl, and is dropped after its last page. Callers fall
+back to evaluating when a handle is gone. */
+
+#include "core/bitmaps.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct page_session_stats_s {
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+  uint64_t expirations;
+  uint32_t sessions;
+  size_t bytes;
+} page_session_stats_t;
+
+/**
+ * Initialize paging sessions. `max_bytes` of 0 disables them, sessions
+ * never expire with a `ttl_ms` of 0
+ */
+bool page_session_init(size_t max_bytes, uint64_t ttl_ms);
+
+/**
+ * Free all sessions
+ */
+void page_session_destroy(void);
+
+/**
+ * @brief Keeps `events`, the result of a query on `container_name`.
+ *
+ * `query_hash` identifies the query, a later page must pass the same one.
+ * Takes ownership of `events` and frees it if it is not kept (disabled, too
+ * large or allocation failed).
+ *
+ * @return The session handle, a positive int64, or 0 if not kept.
+ */
+uint64_t page_session_put(const char *container_name, uint64_t query_hash,
+                          bitmap_t *events);
+
+/**
+ * @brief A page of a kept result, like `bitmap_page`.
+ *
+ * Drops the session after its last page.
+ *
+ * @return A new bitmap the caller frees, or NULL if the session is unknown,
+ * expired or evicted, or was kept for another container or query.
+ */
+bitmap_t *page_session_page(uint64_t handle, const char *container_name,
+                            uint64_t query_hash, uint32_t limit,
+                            uint32_t start_val, uint32_t *next_cursor_out);
+
+void page_session_get_stats(page_session_stats_t *stats_out);
+
+#endif // PAGE_SESSION_H
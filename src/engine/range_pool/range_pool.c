@@ -0,0 +1,192 @@
+#include "range_pool.h"
+#include "uv.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Lives on the stack of `range_pool_run`
+typedef struct rp_job_s {
+  range_pool_fn fn;
+  void *arg;
+  uint32_t num_parts;
+  uint32_t next_part;
+  // Parts helpers claimed and finished
+  uint32_t claimed;
+  uint32_t finished;
+  struct rp_job_s *next;
+} rp_job_t;
+
+// Parts are claimed under `lock`, jobs leave the queue once every part is
+static struct {
+  bool initialized;
+  bool stopping;
+  uv_mutex_t lock;
+  uv_cond_t work_cond; // a job was queued, or stopping
+  uv_cond_t done_cond; // a helper finished a part
+  rp_job_t *head;
+  rp_job_t *tail;
+  uv_thread_t *threads;
+  uint32_t num_threads;
+} g_rp = {0};
+
+// Caller holds the lock
+static void _unlink(rp_job_t *job) {
+  rp_job_t **link = &g_rp.head;
+  rp_job_t *prev = NULL;
+  while (*link && *link != job) {
+    prev = *link;
+    link = &(*link)->next;
+  }
+  if (!*link) {
+    return;
+  }
+  *link = job->next;
+  if (g_rp.tail == job) {
+    g_rp.tail = prev;
+  }
+  job->next = NULL;
+}
+
+// Caller holds the lock. Returns false once every part is claimed
+static bool _claim(rp_job_t *job, uint32_t *part_out) {
+  if (job->next_part >= job->num_parts) {
+    return false;
+  }
+  *part_out = job->next_part++;
+  if (job->next_part >= job->num_parts) {
+    _unlink(job);
+  }
+  return true;
+}
+
+static void _helper(void *arg) {
+  (void)arg;
+  uv_mutex_lock(&g_rp.lock);
+  while (true) {
+    while (!g_rp.stopping && !g_rp.head) {
+      uv_cond_wait(&g_rp.work_cond, &g_rp.lock);
+    }
+    if (!g_rp.head) {
+      break;
+    }
+    rp_job_t *job = g_rp.head;
+    uint32_t part;
+    if (!_claim(job, &part)) {
+      continue;
+    }
+    job->claimed++;
+    uv_mutex_unlock(&g_rp.lock);
+
+    job->fn(job->arg, part, false);
+
+    uv_mutex_lock(&g_rp.lock);
+    job->finished++;
+    uv_cond_broadcast(&g_rp.done_cond);
+  }
+  uv_mutex_unlock(&g_rp.lock);
+}
+
+static void _stop_threads(uint32_t count) {
+  uv_mutex_lock(&g_rp.lock);
+  g_rp.stopping = true;
+  uv_cond_broadcast(&g_rp.work_cond);
+  uv_mutex_unlock(&g_rp.lock);
+  for (uint32_t i = 0; i < count; i++) {
+    uv_thread_join(&g_rp.threads[i]);
+  }
+}
+
+bool range_pool_init(uint32_t num_threads) {
+  if (g_rp.initialized || !num_threads) {
+    return false;
+  }
+  g_rp.threads = calloc(num_threads, sizeof(uv_thread_t));
+  if (!g_rp.threads) {
+    return false;
+  }
+  if (uv_mutex_init(&g_rp.lock) != 0) {
+    free(g_rp.threads);
+    return false;
+  }
+  if (uv_cond_init(&g_rp.work_cond) != 0) {
+    uv_mutex_destroy(&g_rp.lock);
+    free(g_rp.threads);
+    return false;
+  }
+  if (uv_cond_init(&g_rp.done_cond) != 0) {
+    uv_cond_destroy(&g_rp.work_cond);
+    uv_mutex_destroy(&g_rp.lock);
+    free(g_rp.threads);
+    return false;
+  }
+  g_rp.stopping = false;
+  g_rp.head = NULL;
+  g_rp.tail = NULL;
+  for (uint32_t i = 0; i < num_threads; i++) {
+    if (uv_thread_create(&g_rp.threads[i], _helper, NULL) != 0) {
+      _stop_threads(i);
+      uv_cond_destroy(&g_rp.done_cond);
+      uv_cond_destroy(&g_rp.work_cond);
+      uv_mutex_destroy(&g_rp.lock);
+      free(g_rp.threads);
+      return false;
+    }
+  }
+  g_rp.num_threads = num_threads;
+  g_rp.initialized = true;
+  return true;
+}
+
+void range_pool_destroy(void) {
+  if (!g_rp.initialized) {
+    return;
+  }
+  _stop_threads(g_rp.num_threads);
+  uv_cond_destroy(&g_rp.done_cond);
+  uv_cond_destroy(&g_rp.work_cond);
+  uv_mutex_destroy(&g_rp.lock);
+  free(g_rp.threads);
+  g_rp.threads = NULL;
+  g_rp.num_threads = 0;
+  g_rp.initialized = false;
+}
+
+void range_pool_run(range_pool_fn fn, void *arg, uint32_t num_parts) {
+  if (!fn || num_parts == 0) {
+    return;
+  }
+  if (!g_rp.initialized || num_parts == 1) {
+    for (uint32_t i = 0; i < num_parts; i++) {
+      fn(arg, i, true);
+    }
+    return;
+  }
+
+  // Part 0 is the caller's
+  rp_job_t job = {
+      .fn = fn, .arg = arg, .num_parts = num_parts, .next_part = 1};
+  uv_mutex_lock(&g_rp.lock);
+  if (g_rp.tail) {
+    g_rp.tail->next = &job;
+  } else {
+    g_rp.head = &job;
+  }
+  g_rp.tail = &job;
+  uv_cond_broadcast(&g_rp.work_cond);
+  uv_mutex_unlock(&g_rp.lock);
+
+  fn(arg, 0, true);
+
+  // Run what no helper took, then wait for the ones they did
+  uv_mutex_lock(&g_rp.lock);
+  uint32_t part;
+  while (_claim(&job, &part)) {
+    uv_mutex_unlock(&g_rp.lock);
+    fn(arg, part, true);
+    uv_mutex_lock(&g_rp.lock);
+  }
+  while (job.finished < job.claimed) {
+    uv_cond_wait(&g_rp.done_cond, &g_rp.lock);
+  }
+  uv_mutex_unlock(&g_rp.lock);
+}
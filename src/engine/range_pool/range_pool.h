@@ -0,0 +1,31 @@
+#ifndef RANGE_POOL_H
+#define RANGE_POOL_H
+
+/**
+Persistent helper threads shared by fetches, scans and funnels.
+A query splits its work into parts, e.g. id ranges, and hands them to the
+pool. The calling thread runs part 0, then keeps claiming parts no helper
+took yet, so a busy pool costs parallelism but parts never wait for a
+thread. Without the pool (not started, e.g. in tests) the caller runs every
+part. */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Runs part `part` of `arg`. `on_caller` is false on a helper thread
+typedef void (*range_pool_fn)(void *arg, uint32_t part, bool on_caller);
+
+bool range_pool_init(uint32_t num_threads);
+
+// Stops the helpers. No runs may be active
+void range_pool_destroy(void);
+
+/**
+ * @brief Runs `fn` for parts 0 to `num_parts` - 1, returns once all are done.
+ *
+ * Parts run concurrently, part 0 always on the calling thread. `fn` must not
+ * call `range_pool_run`.
+ */
+void range_pool_run(range_pool_fn fn, void *arg, uint32_t num_parts);
+
+#endif // RANGE_POOL_H
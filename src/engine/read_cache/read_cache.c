@@ -0,0 +1,307 @@
+#include "read_cache.h"
+#include "ck_epoch.h"
+#include "ck_ht.h"
+#include "core/bitmaps.h"
+#include "core/ebr.h"
+#include "uv.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HT_SEED 0
+#define HT_INITIAL_CAPACITY 1024
+
+typedef struct read_cache_entry_s {
+  char *ser_db_key;
+  size_t key_len;
+  uint64_t commit_seq; // never changes, replaced entries are new entries
+  bitmap_t *bm;
+  size_t bytes; // charged against the budget
+
+  // CLOCK reference bit, set by readers
+  atomic_bool referenced;
+
+  // CLOCK ring, only touched under the write lock
+  struct read_cache_entry_s *prev;
+  struct read_cache_entry_s *next;
+
+  ck_epoch_entry_t epoch_entry;
+} read_cache_entry_t;
+
+CK_EPOCH_CONTAINER(read_cache_entry_t, epoch_entry, _entry_from_epoch_entry)
+
+// A retired hash table map, still visible to readers until the next epoch
+typedef struct deferred_free_s {
+  void *p;
+  ck_epoch_entry_t epoch_entry;
+} deferred_free_t;
+
+CK_EPOCH_CONTAINER(deferred_free_t, epoch_entry, _deferred_from_epoch_entry)
+
+static struct {
+  bool initialized;
+  ck_ht_t table;
+  uv_mutex_t write_lock;
+  read_cache_entry_t *hand; // CLOCK hand, NULL if empty
+  size_t max_bytes;
+  size_t bytes;
+  uint32_t n_entries;
+  _Atomic uint64_t hits;
+  _Atomic uint64_t misses;
+  _Atomic uint64_t evictions;
+} g_read_cache = {0};
+
+static void *_ht_malloc(size_t r) { return malloc(r); }
+
+static void _dispose_deferred(ck_epoch_entry_t *e) {
+  deferred_free_t *d = _deferred_from_epoch_entry(e);
+  free(d->p);
+  free(d);
+}
+
+static void _ht_free(void *p, size_t b, bool r) {
+  (void)b;
+  if (!r) {
+    free(p);
+    return;
+  }
+  // Readers may still be probing the old map after a grow
+  deferred_free_t *d = malloc(sizeof(deferred_free_t));
+  if (!d) {
+    return; // leak rather than free under a reader
+  }
+  d->p = p;
+  ebr_call(&d->epoch_entry, _dispose_deferred);
+}
+
+static struct ck_malloc _allocator = {.malloc = _ht_malloc,
+                                      .free = _ht_free};
+
+static void _entry_free(read_cache_entry_t *entry) {
+  bitmap_free(entry->bm);
+  free(entry->ser_db_key);
+  free(entry);
+}
+
+static void _dispose_entry(ck_epoch_entry_t *e) {
+  _entry_free(_entry_from_epoch_entry(e));
+}
+
+static void _ring_add(read_cache_entry_t *entry) {
+  read_cache_entry_t *hand = g_read_cache.hand;
+  if (!hand) {
+    entry->prev = entry->next = entry;
+    g_read_cache.hand = entry;
+    return;
+  }
+  // Just behind the hand, so it is the last to be considered
+  entry->next = hand;
+  entry->prev = hand->prev;
+  hand->prev->next = entry;
+  hand->prev = entry;
+}
+
+static void _ring_remove(read_cache_entry_t *entry) {
+  if (entry->next == entry) {
+    g_read_cache.hand = NULL;
+  } else {
+    entry->prev->next = entry->next;
+    entry->next->prev = entry->prev;
+    if (g_read_cache.hand == entry) {
+      g_read_cache.hand = entry->next;
+    }
+  }
+  entry->prev = entry->next = NULL;
+}
+
+static bool _lookup(const char *ser_db_key, size_t key_len,
+                    read_cache_entry_t **entry_out) {
+  ck_ht_hash_t hash;
+  ck_ht_entry_t ck_entry;
+  ck_ht_hash(&hash, &g_read_cache.table, ser_db_key, key_len);
+  ck_ht_entry_set(&ck_entry, hash, ser_db_key, key_len, NULL);
+  if (!ck_ht_get_spmc(&g_read_cache.table, hash, &ck_entry)) {
+    return false;
+  }
+  *entry_out = ck_ht_entry_value(&ck_entry);
+  return true;
+}
+
+// Caller holds the write lock
+static void _retire(read_cache_entry_t *entry) {
+  ck_ht_hash_t hash;
+  ck_ht_entry_t ck_entry;
+  ck_ht_hash(&hash, &g_read_cache.table, entry->ser_db_key, entry->key_len);
+  ck_ht_entry_set(&ck_entry, hash, entry->ser_db_key, entry->key_len, entry);
+  ck_ht_remove_spmc(&g_read_cache.table, hash, &ck_entry);
+  _ring_remove(entry);
+  g_read_cache.bytes -= entry->bytes;
+  g_read_cache.n_entries--;
+  // Readers may still hold the bitmap
+  ebr_call(&entry->epoch_entry, _dispose_entry);
+}
+
+// Caller holds the write lock. Second chance: referenced entries get their
+// bit cleared and are skipped once.
+static void _evict_one(void) {
+  while (g_read_cache.hand) {
+    read_cache_entry_t *entry = g_read_cache.hand;
+    g_read_cache.hand = entry->next;
+    if (atomic_exchange_explicit(&entry->referenced, false,
+                                 memory_order_relaxed)) {
+      continue;
+    }
+    _retire(entry);
+    atomic_fetch_add_explicit(&g_read_cache.evictions, 1,
+                              memory_order_relaxed);
+    return;
+  }
+}
+
+bool read_cache_init(size_t max_bytes) {
+  if (g_read_cache.initialized) {
+    return true;
+  }
+  if (max_bytes == 0) {
+    return true;
+  }
+  if (uv_mutex_init(&g_read_cache.write_lock) != 0) {
+    return false;
+  }
+  if (!ck_ht_init(&g_read_cache.table, CK_HT_MODE_BYTESTRING, NULL,
+                  &_allocator, HT_INITIAL_CAPACITY, HT_SEED)) {
+    uv_mutex_destroy(&g_read_cache.write_lock);
+    return false;
+  }
+  g_read_cache.hand = NULL;
+  g_read_cache.max_bytes = max_bytes;
+  g_read_cache.bytes = 0;
+  g_read_cache.n_entries = 0;
+  atomic_store(&g_read_cache.hits, 0);
+  atomic_store(&g_read_cache.misses, 0);
+  atomic_store(&g_read_cache.evictions, 0);
+  g_read_cache.initialized = true;
+  return true;
+}
+
+void read_cache_destroy(void) {
+  if (!g_read_cache.initialized) {
+    return;
+  }
+  g_read_cache.initialized = false;
+
+  while (g_read_cache.hand) {
+    read_cache_entry_t *entry = g_read_cache.hand;
+    _ring_remove(entry);
+    _entry_free(entry);
+  }
+  ck_ht_destroy(&g_read_cache.table);
+  uv_mutex_destroy(&g_read_cache.write_lock);
+  g_read_cache.bytes = 0;
+  g_read_cache.n_entries = 0;
+}
+
+const bitmap_t *read_cache_get(const char *ser_db_key, uint64_t commit_seq) {
+  if (!g_read_cache.initialized || !ser_db_key) {
+    return NULL;
+  }
+
+  read_cache_entry_t *entry = NULL;
+  if (!_lookup(ser_db_key, strlen(ser_db_key), &entry) ||
+      entry->commit_seq != commit_seq) {
+    atomic_fetch_add_explicit(&g_read_cache.misses, 1, memory_order_relaxed);
+    return NULL;
+  }
+
+  if (!atomic_load_explicit(&entry->referenced, memory_order_relaxed)) {
+    atomic_store_explicit(&entry->referenced, true, memory_order_relaxed);
+  }
+  atomic_fetch_add_explicit(&g_read_cache.hits, 1, memory_order_relaxed);
+  return entry->bm;
+}
+
+const bitmap_t *read_cache_put(const char *ser_db_key, uint64_t commit_seq,
+                               const void *value, size_t value_len) {
+  if (!g_read_cache.initialized || !ser_db_key || !value) {
+    return NULL;
+  }
+
+  size_t key_len = strlen(ser_db_key);
+  size_t bytes = sizeof(read_cache_entry_t) + key_len + value_len;
+  if (bytes > g_read_cache.max_bytes) {
+    return NULL;
+  }
+
+  // Copy outside the lock
+  read_cache_entry_t *entry = calloc(1, sizeof(read_cache_entry_t));
+  if (!entry) {
+    return NULL;
+  }
+  entry->ser_db_key = strdup(ser_db_key);
+  entry->bm = bitmap_view_copy(value, value_len);
+  if (!entry->ser_db_key || !entry->bm) {
+    _entry_free(entry);
+    return NULL;
+  }
+  entry->key_len = key_len;
+  entry->commit_seq = commit_seq;
+  entry->bytes = bytes;
+  atomic_init(&entry->referenced, false);
+
+  const bitmap_t *result = NULL;
+  uv_mutex_lock(&g_read_cache.write_lock);
+
+  read_cache_entry_t *existing = NULL;
+  if (_lookup(ser_db_key, key_len, &existing)) {
+    if (existing->commit_seq >= commit_seq) {
+      // Raced with another reader, or ours is the older snapshot
+      result = existing->commit_seq == commit_seq ? existing->bm : NULL;
+      uv_mutex_unlock(&g_read_cache.write_lock);
+      _entry_free(entry);
+      return result;
+    }
+    _retire(existing);
+  }
+
+  while (g_read_cache.hand &&
+         g_read_cache.bytes + bytes > g_read_cache.max_bytes) {
+    _evict_one();
+  }
+
+  ck_ht_hash_t hash;
+  ck_ht_entry_t ck_entry;
+  ck_ht_hash(&hash, &g_read_cache.table, entry->ser_db_key, key_len);
+  ck_ht_entry_set(&ck_entry, hash, entry->ser_db_key, key_len, entry);
+  if (ck_ht_put_spmc(&g_read_cache.table, hash, &ck_entry)) {
+    _ring_add(entry);
+    g_read_cache.bytes += bytes;
+    g_read_cache.n_entries++;
+    result = entry->bm;
+    entry = NULL;
+  }
+
+  uv_mutex_unlock(&g_read_cache.write_lock);
+  if (entry) {
+    _entry_free(entry);
+  }
+  return result;
+}
+
+void read_cache_get_stats(read_cache_stats_t *stats_out) {
+  if (!stats_out) {
+    return;
+  }
+  memset(stats_out, 0, sizeof(read_cache_stats_t));
+  if (!g_read_cache.initialized) {
+    return;
+  }
+  stats_out->hits = atomic_load(&g_read_cache.hits);
+  stats_out->misses = atomic_load(&g_read_cache.misses);
+  stats_out->evictions = atomic_load(&g_read_cache.evictions);
+  uv_mutex_lock(&g_read_cache.write_lock);
+  stats_out->entries = g_read_cache.n_entries;
+  stats_out->bytes = g_read_cache.bytes;
+  uv_mutex_unlock(&g_read_cache.write_lock);
+}
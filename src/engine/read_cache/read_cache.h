@@ -0,0 +1,57 @@
+#ifndef READ_CACHE_H
+#define READ_CACHE_H
+
+/**
+Shared read-side bitmap cache.
+Holds bitmaps that queries read from LMDB but no consumer cache holds (keys
+that are read, not written). Entries are tagged with the container commit seq
+they were read under and go stale once it moves. Bounded by bytes, evicted
+with CLOCK. Lookups are lock-free, inserts are serialized. */
+
+#include "core/bitmaps.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct read_cache_stats_s {
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+  uint32_t entries;
+  size_t bytes;
+} read_cache_stats_t;
+
+/**
+ * Initialize the read cache. `max_bytes` of 0 disables it
+ */
+bool read_cache_init(size_t max_bytes);
+
+/**
+ * Free all entries. No readers may be active
+ */
+void read_cache_destroy(void);
+
+/**
+ * @brief Retrieves a read-only bitmap read under `commit_seq`.
+ *
+ * IMPORTANT: Must call this within EBR critical section!
+ *
+ * @return A CONST pointer to the bitmap, or NULL if missing or stale.
+ */
+const bitmap_t *read_cache_get(const char *ser_db_key, uint64_t commit_seq);
+
+/**
+ * @brief Caches a private copy of serialized bitmap `value`, read under
+ * `commit_seq`.
+ *
+ * IMPORTANT: Must call this within EBR critical section!
+ *
+ * @return A CONST pointer to the cached bitmap, or NULL if it was not cached
+ * (too large, a newer entry exists, or allocation failed).
+ */
+const bitmap_t *read_cache_put(const char *ser_db_key, uint64_t commit_seq,
+                               const void *value, size_t value_len);
+
+void read_cache_get_stats(read_cache_stats_t *stats_out);
+
+#endif // READ_CACHE_H
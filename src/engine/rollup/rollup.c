@@ -0,0 +1,337 @@
+#include "rollup.h"
+#include "core/data_constants.h"
+#include "core/db.h"
+#include "engine/container/container_types.h"
+#include "lmdb.h"
+#include "query/ast.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Hex digits of a bucket start in a counter row key
+#define BUCKET_HEX_LEN 16
+
+bool rollup_id_into(char *out_buf, size_t size, ast_node_t *keys,
+                    uint64_t bucket_ms) {
+  if (!out_buf || !keys) {
+    return false;
+  }
+  size_t len = 0;
+  for (ast_node_t *k = keys; k; k = k->next) {
+    int r = snprintf(out_buf + len, size - len, "%s%s", k == keys ? "" : ",",
+                     k->literal.string_value);
+    if (r < 0 || (size_t)r >= size - len) {
+      return false;
+    }
+    len += (size_t)r;
+  }
+  int r = snprintf(out_buf + len, size - len, "|%llu",
+                   (unsigned long long)bucket_ms);
+  return r >= 0 && (size_t)r < size - len;
+}
+
+// --- Registry ---
+
+static void _rollup_free(rollup_t *r) {
+  free(r->id);
+  for (uint32_t i = 0; i < r->num_keys; i++) {
+    free(r->keys[i]);
+  }
+}
+
+static void _set_free(rollup_set_t *set) {
+  free(set->rollups);
+  free(set);
+}
+
+// Fills `out` from the id alone
+static bool _parse_id(const char *id, size_t id_len, rollup_t *out) {
+  memset(out, 0, sizeof(rollup_t));
+  out->id = strndup(id, id_len);
+  if (!out->id) {
+    return false;
+  }
+  const char *bar = strchr(out->id, '|');
+  if (!bar || bar == out->id) {
+    _rollup_free(out);
+    return false;
+  }
+  const char *start = out->id;
+  while (start < bar) {
+    const char *end = memchr(start, ',', (size_t)(bar - start));
+    if (!end) {
+      end = bar;
+    }
+    if (end == start || out->num_keys == MAX_ROLLUP_KEYS) {
+      _rollup_free(out);
+      return false;
+    }
+    out->keys[out->num_keys] = strndup(start, (size_t)(end - start));
+    if (!out->keys[out->num_keys]) {
+      _rollup_free(out);
+      return false;
+    }
+    out->num_keys++;
+    start = end + 1;
+  }
+  char *bucket_end = NULL;
+  out->bucket_ms = strtoull(bar + 1, &bucket_end, 10);
+  if (out->bucket_ms == 0 || *bucket_end != '\0') {
+    _rollup_free(out);
+    return false;
+  }
+  return true;
+}
+
+db_put_result_t rollup_add(const char *id, MDB_env *env, MDB_dbi dbi) {
+  rollup_t parsed;
+  if (!id || !env || !_parse_id(id, strlen(id), &parsed)) {
+    return DB_PUT_ERR;
+  }
+  uint64_t bucket_ms = parsed.bucket_ms;
+  _rollup_free(&parsed);
+
+  char key[MAX_TEXT_VAL_LEN * 2];
+  int r = snprintf(key, sizeof(key), "%s|%s", USR_ROLLUP_KEY_PREFIX, id);
+  if (r < 0 || (size_t)r >= sizeof(key)) {
+    return DB_PUT_ERR;
+  }
+
+  MDB_txn *txn = db_create_txn(env, false);
+  if (!txn) {
+    return DB_PUT_ERR;
+  }
+  db_key_t db_key = {.type = DB_KEY_STRING, .key.s = key};
+  db_put_result_t pr =
+      db_put(dbi, txn, &db_key, &bucket_ms, sizeof(bucket_ms), false, true);
+  if (pr != DB_PUT_OK) {
+    db_abort_txn(txn);
+    return pr;
+  }
+  return db_commit_txn(txn) ? DB_PUT_OK : DB_PUT_ERR;
+}
+
+bool rollup_open_registry(MDB_env *env, MDB_dbi dbi,
+                          _Atomic(rollup_set_t *) *rollups_out) {
+  if (!env || !rollups_out) {
+    return false;
+  }
+
+  rollup_set_t *set = calloc(1, sizeof(rollup_set_t));
+  if (!set) {
+    return false;
+  }
+
+  MDB_txn *read_txn = db_create_txn(env, true);
+  if (!read_txn) {
+    free(set);
+    return false;
+  }
+  MDB_cursor *cursor = db_cursor_open(read_txn, dbi);
+  if (!cursor) {
+    db_abort_txn(read_txn);
+    free(set);
+    return false;
+  }
+
+  char prefix[16];
+  snprintf(prefix, sizeof(prefix), "%s|", USR_ROLLUP_KEY_PREFIX);
+  size_t prefix_len = strlen(prefix);
+  db_key_t seek_key = {.type = DB_KEY_STRING, .key.s = prefix};
+  db_cursor_entry_t entry;
+  uint32_t cap = 0;
+  bool ok = true;
+
+  db_cursor_get_result_t r =
+      db_cursor_get(cursor, &entry, MDB_SET_RANGE, &seek_key);
+  while (r == DB_CURSOR_OK && entry.key_len > prefix_len &&
+         memcmp(entry.key, prefix, prefix_len) == 0) {
+    if (set->count == cap) {
+      uint32_t new_cap = cap ? cap * 2 : 4;
+      rollup_t *grown = realloc(set->rollups, new_cap * sizeof(rollup_t));
+      if (!grown) {
+        ok = false;
+        break;
+      }
+      set->rollups = grown;
+      cap = new_cap;
+    }
+    if (!_parse_id((const char *)entry.key + prefix_len,
+                   entry.key_len - prefix_len, &set->rollups[set->count])) {
+      ok = false;
+      break;
+    }
+    set->count++;
+    r = db_cursor_get(cursor, &entry, MDB_NEXT, NULL);
+  }
+
+  db_cursor_close(cursor);
+  db_abort_txn(read_txn);
+
+  if (!ok || r == DB_CURSOR_ERR) {
+    for (uint32_t i = 0; i < set->count; i++) {
+      _rollup_free(&set->rollups[i]);
+    }
+    _set_free(set);
+    return false;
+  }
+
+  atomic_store(rollups_out, set);
+  return true;
+}
+
+bool rollup_publish(_Atomic(rollup_set_t *) *rollups, const char *id) {
+  if (!rollups || !id) {
+    return false;
+  }
+  rollup_t added;
+  if (!_parse_id(id, strlen(id), &added)) {
+    return false;
+  }
+
+  rollup_set_t *cur = atomic_load(rollups);
+  while (true) {
+    uint32_t count = cur ? cur->count : 0;
+    rollup_set_t *next = calloc(1, sizeof(rollup_set_t));
+    rollup_t *arr = malloc((count + 1) * sizeof(rollup_t));
+    if (!next || !arr) {
+      free(next);
+      free(arr);
+      _rollup_free(&added);
+      return false;
+    }
+    if (count > 0) {
+      // Entries are shared with older sets, only the new one is owned here
+      memcpy(arr, cur->rollups, count * sizeof(rollup_t));
+    }
+    arr[count] = added;
+    next->count = count + 1;
+    next->rollups = arr;
+    next->prev = cur;
+    if (atomic_compare_exchange_weak(rollups, &cur, next)) {
+      return true;
+    }
+    _set_free(next);
+  }
+}
+
+const rollup_t *rollup_find(const rollup_set_t *set, const char *id) {
+  if (!set || !id) {
+    return NULL;
+  }
+  for (uint32_t i = 0; i < set->count; i++) {
+    if (strcmp(set->rollups[i].id, id) == 0) {
+      return &set->rollups[i];
+    }
+  }
+  return NULL;
+}
+
+void rollup_close_registry(_Atomic(rollup_set_t *) *rollups) {
+  if (!rollups) {
+    return;
+  }
+  rollup_set_t *set = atomic_exchange(rollups, NULL);
+  while (set) {
+    rollup_set_t *prev = set->prev;
+    // Rollups [prev->count, count) were added by this set
+    uint32_t first_owned = prev ? prev->count : 0;
+    for (uint32_t i = first_owned; i < set->count; i++) {
+      _rollup_free(&set->rollups[i]);
+    }
+    _set_free(set);
+    set = prev;
+  }
+}
+
+// --- Counter rows ---
+
+// Value of custom tag `key` as the text of index keys, NULL if missing
+static const char *_value_text(cmd_ctx_t *cmd, const char *key, char *buf,
+                               size_t size) {
+  ast_node_t *ct = cmd->custom_tags_head;
+  for (uint32_t i = 0; i < cmd->num_custom_tags && ct; i++, ct = ct->next) {
+    if (strcmp(ct->tag.custom_key, key) != 0) {
+      continue;
+    }
+    ast_literal_node_t *lit = &ct->tag.value->literal;
+    if (lit->type != AST_LITERAL_NUMBER) {
+      return lit->string_value;
+    }
+    snprintf(buf, size, "%lld", (long long)lit->number_value);
+    return buf;
+  }
+  return NULL;
+}
+
+bool rollup_bucket_key_into(char *out_buf, size_t size, const rollup_t *rollup,
+                            uint64_t bucket_start) {
+  if (!out_buf || !rollup) {
+    return false;
+  }
+  int r = snprintf(out_buf, size, "%s|%016llx|", rollup->id,
+                   (unsigned long long)bucket_start);
+  return r >= 0 && (size_t)r < size;
+}
+
+bool rollup_row_key_into(char *out_buf, size_t size, const rollup_t *rollup,
+                         cmd_ctx_t *cmd) {
+  if (!out_buf || !rollup || !cmd) {
+    return false;
+  }
+  uint64_t ts_ms = (uint64_t)cmd->arrival_ts / 1000000ULL; // ns to ms
+  if (!rollup_bucket_key_into(out_buf, size, rollup,
+                              ts_ms - ts_ms % rollup->bucket_ms)) {
+    return false;
+  }
+  size_t len = strlen(out_buf);
+  char num_buf[INT64_MAX_CHARS + 2];
+  for (uint32_t i = 0; i < rollup->num_keys; i++) {
+    const char *v =
+        _value_text(cmd, rollup->keys[i], num_buf, sizeof(num_buf));
+    if (!v || strchr(v, ROLLUP_VALUE_SEP)) {
+      return false;
+    }
+    int r = i == 0 ? snprintf(out_buf + len, size - len, "%s", v)
+                   : snprintf(out_buf + len, size - len, "%c%s",
+                              ROLLUP_VALUE_SEP, v);
+    if (r < 0 || (size_t)r >= size - len) {
+      return false;
+    }
+    len += (size_t)r;
+  }
+  return true;
+}
+
+bool rollup_parse_row_key(const rollup_t *rollup, const char *key,
+                          size_t key_len, uint64_t *bucket_out,
+                          const char **values_out, size_t *values_len_out) {
+  if (!rollup || !key) {
+    return false;
+  }
+  size_t id_len = strlen(rollup->id);
+  // `<id>|`, the bucket and `|`
+  size_t head_len = id_len + 1 + BUCKET_HEX_LEN + 1;
+  if (key_len < head_len || memcmp(key, rollup->id, id_len) != 0 ||
+      key[id_len] != '|' || key[head_len - 1] != '|') {
+    return false;
+  }
+  uint64_t bucket = 0;
+  for (size_t i = id_len + 1; i < head_len - 1; i++) {
+    char c = key[i];
+    uint64_t digit;
+    if (c >= '0' && c <= '9') {
+      digit = (uint64_t)(c - '0');
+    } else if (c >= 'a' && c <= 'f') {
+      digit = (uint64_t)(c - 'a' + 10);
+    } else {
+      return false;
+    }
+    bucket = bucket << 4 | digit;
+  }
+  *bucket_out = bucket;
+  *values_out = key + head_len;
+  *values_len_out = key_len - head_len;
+  return true;
+}
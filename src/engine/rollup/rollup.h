@@ -0,0 +1,83 @@
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+/**
+Count rollups.
+A rollup counts a container's events per time bucket and combination of
+values of its `by` keys, e.g. `by:(action,country) bucket:1m`. Workers emit an
+INCR op on the counter row of each new event, consumers sum the increments of
+a row and the writer adds the sums to the rows in the rollup db, so reading
+counts never evaluates bitmaps. Definitions live in the container metadata db
+under `rollup|<id>`. */
+
+#include "core/data_constants.h"
+#include "core/db.h"
+#include "engine/cmd_context/cmd_context.h"
+#include "lmdb.h"
+#include "query/ast.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Separates the values of a counter row key. Events with it in a value are
+// not counted
+#define ROLLUP_VALUE_SEP '\x1f'
+
+typedef struct rollup_s {
+  // `<key>,<key>|<bucket_ms>`, e.g. `action,country|60000`. Counter rows are
+  // keyed `<id>|<bucket start, 16 hex digits>|<values>`
+  char *id;
+  char *keys[MAX_ROLLUP_KEYS];
+  uint32_t num_keys;
+  uint64_t bucket_ms;
+} rollup_t;
+
+// Immutable once published. A replaced set stays reachable through `prev`
+// until the container closes, so readers never see it freed.
+typedef struct rollup_set_s {
+  uint32_t count;
+  rollup_t *rollups;
+  struct rollup_set_s *prev;
+} rollup_set_t;
+
+// Id of a rollup over `keys`, string literals linked by `next`
+bool rollup_id_into(char *out_buf, size_t size, ast_node_t *keys,
+                    uint64_t bucket_ms);
+
+/**
+ * Persist a rollup definition in `dbi`.
+ * Returns DB_PUT_KEY_EXISTS if the rollup already exists
+ */
+db_put_result_t rollup_add(const char *id, MDB_env *env, MDB_dbi dbi);
+
+// Load all rollup definitions from `dbi`
+bool rollup_open_registry(MDB_env *env, MDB_dbi dbi,
+                          _Atomic(rollup_set_t *) *rollups_out);
+
+// Publish a set holding the current rollups plus a new one. Thread-safe
+bool rollup_publish(_Atomic(rollup_set_t *) *rollups, const char *id);
+
+// Returns NULL if there is no rollup with `id`
+const rollup_t *rollup_find(const rollup_set_t *set, const char *id);
+
+// Free all published sets. No readers may be active
+void rollup_close_registry(_Atomic(rollup_set_t *) *rollups);
+
+// Key of the counter row the event in `cmd` counts towards. False if the
+// event lacks one of the keys or the row key does not fit
+bool rollup_row_key_into(char *out_buf, size_t size, const rollup_t *rollup,
+                         cmd_ctx_t *cmd);
+
+// Lowest key a counter row of `rollup` in a bucket from `bucket_start` on
+// can have
+bool rollup_bucket_key_into(char *out_buf, size_t size, const rollup_t *rollup,
+                            uint64_t bucket_start);
+
+// Split a counter row key of `rollup` into its bucket start and its values,
+// separated by ROLLUP_VALUE_SEP. `*values_out` points into `key`
+bool rollup_parse_row_key(const rollup_t *rollup, const char *key,
+                          size_t key_len, uint64_t *bucket_out,
+                          const char **values_out, size_t *values_len_out);
+
+#endif // ROLLUP_H
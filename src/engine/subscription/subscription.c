@@ -0,0 +1,264 @@
+#include "subscription.h"
+#include "engine/view/view.h"
+#include "query/ast.h"
+#include "uv.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static struct {
+  uv_rwlock_t lock;
+  sub_t *head;
+  // Lets workers skip the lock while nobody is subscribed
+  atomic_uint count;
+  bool initialized;
+} g_subs;
+
+bool sub_registry_init(void) {
+  if (g_subs.initialized) {
+    return true;
+  }
+  if (uv_rwlock_init(&g_subs.lock) != 0) {
+    return false;
+  }
+  g_subs.head = NULL;
+  atomic_init(&g_subs.count, 0);
+  g_subs.initialized = true;
+  return true;
+}
+
+void sub_registry_destroy(void) {
+  if (!g_subs.initialized) {
+    return;
+  }
+  sub_t *sub = g_subs.head;
+  while (sub) {
+    sub_t *next = sub->next;
+    // Owners that close later find nothing to unregister
+    uv_mutex_lock(&sub->lock);
+    sub->closed = true;
+    sub->notify = NULL;
+    uv_mutex_unlock(&sub->lock);
+    sub->prev = sub->next = NULL;
+    sub_release(sub);
+    sub = next;
+  }
+  g_subs.head = NULL;
+  atomic_store(&g_subs.count, 0);
+  uv_rwlock_destroy(&g_subs.lock);
+  g_subs.initialized = false;
+}
+
+static void _sub_free(sub_t *sub) {
+  for (uint32_t i = 0; i < sub->count; i++) {
+    free(sub->ring[(sub->head + i) % sub->capacity].data);
+  }
+  free(sub->ring);
+  ast_free(sub->where);
+  free(sub->container_name);
+  uv_mutex_destroy(&sub->lock);
+  free(sub);
+}
+
+sub_t *sub_create(const char *container_name, ast_node_t *where,
+                  uint32_t capacity) {
+  if (!container_name || !where || capacity == 0) {
+    ast_free(where);
+    return NULL;
+  }
+  sub_t *sub = calloc(1, sizeof(sub_t));
+  if (!sub) {
+    ast_free(where);
+    return NULL;
+  }
+  sub->where = where;
+  sub->container_name = strdup(container_name);
+  sub->ring = calloc(capacity, sizeof(sub_event_t));
+  if (!sub->container_name || !sub->ring ||
+      uv_mutex_init(&sub->lock) != 0) {
+    free(sub->ring);
+    free(sub->container_name);
+    ast_free(where);
+    free(sub);
+    return NULL;
+  }
+  sub->capacity = capacity;
+  atomic_init(&sub->refs, 1);
+  return sub;
+}
+
+bool sub_register(sub_t *sub, sub_notify_fn notify, void *notify_arg) {
+  if (!sub || !notify || !g_subs.initialized) {
+    return false;
+  }
+  uv_mutex_lock(&sub->lock);
+  sub->notify = notify;
+  sub->notify_arg = notify_arg;
+  uv_mutex_unlock(&sub->lock);
+
+  // The registry holds its own reference
+  atomic_fetch_add(&sub->refs, 1);
+  uv_rwlock_wrlock(&g_subs.lock);
+  sub->prev = NULL;
+  sub->next = g_subs.head;
+  if (g_subs.head) {
+    g_subs.head->prev = sub;
+  }
+  g_subs.head = sub;
+  atomic_fetch_add(&g_subs.count, 1);
+  uv_rwlock_wrunlock(&g_subs.lock);
+  return true;
+}
+
+void sub_close(sub_t *sub) {
+  if (!sub) {
+    return;
+  }
+  uv_mutex_lock(&sub->lock);
+  bool was_registered = sub->notify != NULL && !sub->closed;
+  sub->closed = true;
+  sub->notify = NULL;
+  sub->notify_arg = NULL;
+  uv_mutex_unlock(&sub->lock);
+
+  if (!was_registered) {
+    return;
+  }
+  uv_rwlock_wrlock(&g_subs.lock);
+  if (sub->prev) {
+    sub->prev->next = sub->next;
+  } else {
+    g_subs.head = sub->next;
+  }
+  if (sub->next) {
+    sub->next->prev = sub->prev;
+  }
+  sub->prev = sub->next = NULL;
+  atomic_fetch_sub(&g_subs.count, 1);
+  uv_rwlock_wrunlock(&g_subs.lock);
+  sub_release(sub);
+}
+
+void sub_release(sub_t *sub) {
+  if (sub && atomic_fetch_sub(&sub->refs, 1) == 1) {
+    _sub_free(sub);
+  }
+}
+
+sub_push_t *sub_match(const char *container_name, cmd_ctx_t *cmd) {
+  if (!container_name || !cmd || atomic_load(&g_subs.count) == 0) {
+    return NULL;
+  }
+
+  sub_push_t *push = NULL;
+  uint32_t cap = 0;
+
+  uv_rwlock_rdlock(&g_subs.lock);
+  for (sub_t *sub = g_subs.head; sub; sub = sub->next) {
+    if (strcmp(sub->container_name, container_name) != 0 ||
+        !view_matches(sub->where, cmd, NULL)) {
+      continue;
+    }
+    if (!push) {
+      push = calloc(1, sizeof(sub_push_t));
+      if (!push) {
+        break;
+      }
+    }
+    if (push->count == cap) {
+      uint32_t new_cap = cap ? cap * 2 : 4;
+      sub_t **subs = realloc(push->subs, new_cap * sizeof(sub_t *));
+      if (!subs) {
+        break;
+      }
+      push->subs = subs;
+      cap = new_cap;
+    }
+    atomic_fetch_add(&sub->refs, 1);
+    push->subs[push->count++] = sub;
+  }
+  uv_rwlock_rdunlock(&g_subs.lock);
+
+  if (push && push->count == 0) {
+    sub_push_free(push);
+    return NULL;
+  }
+  return push;
+}
+
+static void _buffer_event(sub_t *sub, uint32_t event_id, const void *data,
+                          size_t data_size) {
+  uv_mutex_lock(&sub->lock);
+  if (sub->closed || sub->overflowed) {
+    uv_mutex_unlock(&sub->lock);
+    return;
+  }
+
+  if (sub->count == sub->capacity) {
+    // Slow consumer: stop buffering, the subscriber is dropped on its next
+    // drain
+    sub->overflowed = true;
+  } else {
+    char *copy = malloc(data_size);
+    if (copy) {
+      memcpy(copy, data, data_size);
+      sub_event_t *e = &sub->ring[(sub->head + sub->count) % sub->capacity];
+      e->id = event_id;
+      e->data = copy;
+      e->data_size = data_size;
+      sub->count++;
+    } else {
+      sub->overflowed = true;
+    }
+  }
+  if (sub->notify) {
+    sub->notify(sub->notify_arg);
+  }
+  uv_mutex_unlock(&sub->lock);
+}
+
+void sub_push_deliver(sub_push_t *push, uint32_t event_id, const void *data,
+                      size_t data_size) {
+  if (!push) {
+    return;
+  }
+  if (data) {
+    for (uint32_t i = 0; i < push->count; i++) {
+      _buffer_event(push->subs[i], event_id, data, data_size);
+    }
+  }
+  sub_push_free(push);
+}
+
+void sub_push_free(sub_push_t *push) {
+  if (!push) {
+    return;
+  }
+  for (uint32_t i = 0; i < push->count; i++) {
+    sub_release(push->subs[i]);
+  }
+  free(push->subs);
+  free(push);
+}
+
+uint32_t sub_drain(sub_t *sub, sub_event_t *out, uint32_t max,
+                   bool *overflowed_out) {
+  if (!sub || !out) {
+    return 0;
+  }
+  uv_mutex_lock(&sub->lock);
+  uint32_t n = sub->count < max ? sub->count : max;
+  for (uint32_t i = 0; i < n; i++) {
+    out[i] = sub->ring[sub->head];
+    memset(&sub->ring[sub->head], 0, sizeof(sub_event_t));
+    sub->head = (sub->head + 1) % sub->capacity;
+  }
+  sub->count -= n;
+  if (overflowed_out) {
+    *overflowed_out = sub->overflowed;
+  }
+  uv_mutex_unlock(&sub->lock);
+  return n;
+}
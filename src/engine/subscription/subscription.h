@@ -0,0 +1,103 @@
+#ifndef SUBSCRIPTION_H
+#define SUBSCRIPTION_H
+
+/**
+Live tail subscriptions.
+A subscription is a `where` expression over a container. Workers match each
+new event against the container's subscriptions on its own tags, the same way
+views are matched, and attach the matches to the event's writer entry. Once
+the writer commits the event it is copied into each subscriber's bounded
+buffer and the subscriber is notified. A subscriber that falls a full buffer
+behind is marked overflowed and gets no more events. */
+
+#include "engine/cmd_context/cmd_context.h"
+#include "query/ast.h"
+#include "uv.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Called from the writer thread after events were buffered, with the
+// subscription's lock held. Must not block or call back into the
+// subscription.
+typedef void (*sub_notify_fn)(void *arg);
+
+typedef struct sub_event_s {
+  uint32_t id;
+  char *data;
+  size_t data_size;
+} sub_event_t;
+
+typedef struct sub_s {
+  char *container_name;
+  ast_node_t *where;
+  atomic_int refs;
+
+  // Guards everything below
+  uv_mutex_t lock;
+  sub_event_t *ring;
+  uint32_t capacity;
+  uint32_t head;
+  uint32_t count;
+  bool overflowed;
+  bool closed;
+  sub_notify_fn notify;
+  void *notify_arg;
+
+  // Registry list, guarded by the registry lock
+  struct sub_s *prev;
+  struct sub_s *next;
+} sub_t;
+
+// Subscriptions matched by one event, attached to its writer entry
+typedef struct sub_push_s {
+  sub_t **subs;
+  uint32_t count;
+} sub_push_t;
+
+bool sub_registry_init(void);
+
+// No workers or writers may be active
+void sub_registry_destroy(void);
+
+/**
+ * Create an unregistered subscription buffering up to `capacity` events.
+ * Takes ownership of `where`. The caller holds the only reference
+ */
+sub_t *sub_create(const char *container_name, ast_node_t *where,
+                  uint32_t capacity);
+
+// Start matching new events. `notify` is called whenever events are buffered
+bool sub_register(sub_t *sub, sub_notify_fn notify, void *notify_arg);
+
+/**
+ * Stop matching and notifying. After this returns `notify` is never called
+ * again, even for events already in flight
+ */
+void sub_close(sub_t *sub);
+
+// Drop a reference, freeing the subscription on the last one
+void sub_release(sub_t *sub);
+
+/**
+ * Match an event against the registered subscriptions of its container.
+ * Returns NULL if none match
+ */
+sub_push_t *sub_match(const char *container_name, cmd_ctx_t *cmd);
+
+// Buffer a committed event in each matched subscription and free `push`
+void sub_push_deliver(sub_push_t *push, uint32_t event_id, const void *data,
+                      size_t data_size);
+
+// Free `push` without delivering
+void sub_push_free(sub_push_t *push);
+
+/**
+ * Move up to `max` buffered events, oldest first, into `out`. The caller
+ * frees each event's data. `overflowed_out` is set once events were dropped
+ */
+uint32_t sub_drain(sub_t *sub, sub_event_t *out, uint32_t max,
+                   bool *overflowed_out);
+
+#endif // SUBSCRIPTION_H
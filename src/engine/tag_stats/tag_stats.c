@@ -0,0 +1,247 @@
+#include "tag_stats.h"
+#include "core/db.h"
+#include "engine/index/index.h"
+#include "lmdb.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CARD_PREFIX "c|"
+#define KEY_PREFIX "k|"
+#define KEY_PREFIX_LEN (sizeof(KEY_PREFIX) - 1)
+#define HIST_PREFIX "h|"
+#define STATS_KEY_MAX_LEN 512
+
+// Value of a `k|` entry
+typedef struct key_counts_s {
+  uint64_t distinct;
+  uint64_t events;
+} key_counts_t;
+
+uint32_t tag_stats_bucket(double value) {
+  if (!(value >= 1.0)) {
+    return 0;
+  }
+  int exp;
+  frexp(value, &exp);
+  // value is in [2^(exp-1), 2^exp)
+  return exp < TAG_STATS_HIST_BUCKETS ? (uint32_t)exp
+                                      : TAG_STATS_HIST_BUCKETS - 1;
+}
+
+uint64_t tag_stats_bucket_min(uint32_t b) {
+  return b == 0 ? 0 : 1ULL << (b - 1);
+}
+
+static bool _stats_key_into(char *buf, size_t size, const char *prefix,
+                            const char *key, size_t key_len) {
+  int r = snprintf(buf, size, "%s%.*s", prefix, (int)key_len, key);
+  return r >= 0 && (size_t)r < size;
+}
+
+// Reads a fixed size value, false if missing or on error
+static bool _get(MDB_txn *txn, MDB_dbi db, char *key, void *out,
+                 size_t size) {
+  db_key_t k = {.type = DB_KEY_STRING, .key.s = key};
+  db_get_result_t r;
+  if (!db_get_view(db, txn, &k, &r) || r.status != DB_GET_OK ||
+      r.value_len != size) {
+    return false;
+  }
+  memcpy(out, r.value, size);
+  return true;
+}
+
+static bool _put(MDB_txn *txn, MDB_dbi db, char *key, const void *value,
+                 size_t size) {
+  db_key_t k = {.type = DB_KEY_STRING, .key.s = key};
+  return db_put(db, txn, &k, value, size, false, false) == DB_PUT_OK;
+}
+
+// Tag key length of a custom tag's `<key>:<value>`, 0 for other inverted
+// keys. Tag keys hold no `:` or `|`, see the tokenizer
+static size_t _tag_key_len(const char *inv_key) {
+  size_t n = strcspn(inv_key, ":|");
+  return inv_key[n] == ':' ? n : 0;
+}
+
+static bool _is_numeric_index(kh_key_index_t *key_to_index,
+                              const char *tag_key) {
+  index_t index;
+  if (!key_to_index || !index_get(tag_key, key_to_index, &index)) {
+    return false;
+  }
+  return index.index_def.type == INDEX_TYPE_I64 ||
+         index.index_def.type == INDEX_TYPE_F64 ||
+         index.index_def.type == INDEX_TYPE_BSI;
+}
+
+static bool _parse_number(const char *s, double *out) {
+  if (*s == '\0') {
+    return false;
+  }
+  char *end;
+  *out = strtod(s, &end);
+  return *end == '\0';
+}
+
+static bool _add_to_hist(MDB_txn *txn, MDB_dbi db, const char *tag_key,
+                         size_t tag_key_len, double value, uint64_t old,
+                         uint64_t card) {
+  char key[STATS_KEY_MAX_LEN];
+  if (!_stats_key_into(key, sizeof(key), HIST_PREFIX, tag_key,
+                       tag_key_len)) {
+    return false;
+  }
+  uint64_t hist[TAG_STATS_HIST_BUCKETS];
+  if (!_get(txn, db, key, hist, sizeof(hist))) {
+    memset(hist, 0, sizeof(hist));
+  }
+  // Unsigned wraparound nets out, counts never go below 0
+  hist[tag_stats_bucket(value)] += card - old;
+  return _put(txn, db, key, hist, sizeof(hist));
+}
+
+bool tag_stats_put_cardinality(MDB_txn *txn, MDB_dbi db,
+                               kh_key_index_t *key_to_index,
+                               const char *inv_key, uint64_t card) {
+  if (!txn || !inv_key) {
+    return false;
+  }
+  char key[STATS_KEY_MAX_LEN];
+  if (!_stats_key_into(key, sizeof(key), CARD_PREFIX, inv_key,
+                       strlen(inv_key))) {
+    return false;
+  }
+  uint64_t old = 0;
+  bool existed = _get(txn, db, key, &old, sizeof(old));
+  if (existed && old == card) {
+    return true;
+  }
+  if (!_put(txn, db, key, &card, sizeof(card))) {
+    return false;
+  }
+
+  size_t tag_key_len = _tag_key_len(inv_key);
+  if (tag_key_len == 0) {
+    return true;
+  }
+  if (!_stats_key_into(key, sizeof(key), KEY_PREFIX, inv_key, tag_key_len)) {
+    return false;
+  }
+  key_counts_t counts;
+  if (!_get(txn, db, key, &counts, sizeof(counts))) {
+    memset(&counts, 0, sizeof(counts));
+  }
+  if (old == 0 && card > 0) {
+    counts.distinct++;
+  } else if (old > 0 && card == 0) {
+    counts.distinct--;
+  }
+  counts.events += card - old;
+  if (!_put(txn, db, key, &counts, sizeof(counts))) {
+    return false;
+  }
+
+  char tag_key[STATS_KEY_MAX_LEN];
+  memcpy(tag_key, inv_key, tag_key_len);
+  tag_key[tag_key_len] = '\0';
+  double value;
+  if (_is_numeric_index(key_to_index, tag_key) &&
+      _parse_number(inv_key + tag_key_len + 1, &value)) {
+    return _add_to_hist(txn, db, tag_key, tag_key_len, value, old, card);
+  }
+  return true;
+}
+
+bool tag_stats_get_cardinality(MDB_txn *txn, MDB_dbi db, const char *inv_key,
+                               uint64_t *card_out) {
+  char key[STATS_KEY_MAX_LEN];
+  if (!txn || !inv_key || !card_out ||
+      !_stats_key_into(key, sizeof(key), CARD_PREFIX, inv_key,
+                       strlen(inv_key))) {
+    return false;
+  }
+  return _get(txn, db, key, card_out, sizeof(uint64_t));
+}
+
+bool tag_stats_get_key(MDB_txn *txn, MDB_dbi db, const char *tag_key,
+                       tag_key_stats_t *stats_out) {
+  char key[STATS_KEY_MAX_LEN];
+  if (!txn || !tag_key || !stats_out ||
+      !_stats_key_into(key, sizeof(key), KEY_PREFIX, tag_key,
+                       strlen(tag_key))) {
+    return false;
+  }
+  key_counts_t counts;
+  if (!_get(txn, db, key, &counts, sizeof(counts))) {
+    return false;
+  }
+  memset(stats_out, 0, sizeof(tag_key_stats_t));
+  stats_out->distinct = counts.distinct;
+  stats_out->events = counts.events;
+  key[0] = HIST_PREFIX[0];
+  stats_out->has_hist =
+      _get(txn, db, key, stats_out->hist, sizeof(stats_out->hist));
+  return true;
+}
+
+bool tag_stats_list(MDB_txn *txn, MDB_dbi db, tag_stats_entry_t **entries_out,
+                    uint32_t *count_out) {
+  if (!txn || !entries_out || !count_out) {
+    return false;
+  }
+  MDB_cursor *cursor = db_cursor_open(txn, db);
+  if (!cursor) {
+    return false;
+  }
+
+  tag_stats_entry_t *entries = NULL;
+  uint32_t count = 0;
+  uint32_t cap = 0;
+  bool ok = true;
+  db_key_t start = {.type = DB_KEY_STRING, .key.s = KEY_PREFIX};
+  db_cursor_entry_t entry;
+  db_cursor_get_result_t r =
+      db_cursor_get(cursor, &entry, MDB_SET_RANGE, &start);
+  while (ok && r == DB_CURSOR_OK && entry.key_len > KEY_PREFIX_LEN &&
+         memcmp(entry.key, KEY_PREFIX, KEY_PREFIX_LEN) == 0) {
+    if (count == cap) {
+      cap = cap ? cap * 2 : 16;
+      tag_stats_entry_t *grown = realloc(entries, cap * sizeof(*entries));
+      if (!grown) {
+        ok = false;
+        break;
+      }
+      entries = grown;
+    }
+    char *key = strndup((const char *)entry.key + KEY_PREFIX_LEN,
+                        entry.key_len - KEY_PREFIX_LEN);
+    ok = key && tag_stats_get_key(txn, db, key, &entries[count].stats);
+    if (!ok) {
+      free(key);
+      break;
+    }
+    entries[count++].key = key;
+    r = db_cursor_get(cursor, &entry, MDB_NEXT, NULL);
+  }
+  db_cursor_close(cursor);
+
+  if (!ok || r == DB_CURSOR_ERR) {
+    tag_stats_free_list(entries, count);
+    return false;
+  }
+  *entries_out = entries;
+  *count_out = count;
+  return true;
+}
+
+void tag_stats_free_list(tag_stats_entry_t *entries, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    free(entries[i].key);
+  }
+  free(entries);
+}
@@ -0,0 +1,65 @@
+#ifndef TAG_STATS_H
+#define TAG_STATS_H
+
+/**
+Per-container tag statistics, kept in the container's tag stats db:
+- `c|<inverted key>`: cardinality of an inverted index bitmap. The consumer
+  sends it along with the bitmap on flush, so both commit in one txn.
+- `k|<tag key>`: distinct values of a custom tag key and events holding it,
+  moved by changes in the cardinality of its `<key>:<value>` bitmaps.
+- `h|<tag key>`: log2 histogram of the values of a key with a numeric index.
+Stats trail ops that are not flushed yet. They are estimates to plan with,
+never answers. */
+
+#include "engine/index/index.h"
+#include "lmdb.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Bucket 0 holds values below 1, bucket b > 0 holds [2^(b-1), 2^b)
+#define TAG_STATS_HIST_BUCKETS 65
+
+typedef struct tag_key_stats_s {
+  uint64_t distinct;
+  uint64_t events;
+  // Only keys with a numeric index have a histogram
+  bool has_hist;
+  uint64_t hist[TAG_STATS_HIST_BUCKETS];
+} tag_key_stats_t;
+
+typedef struct tag_stats_entry_s {
+  char *key;
+  tag_key_stats_t stats;
+} tag_stats_entry_t;
+
+uint32_t tag_stats_bucket(double value);
+
+// Smallest value of bucket `b`
+uint64_t tag_stats_bucket_min(uint32_t b);
+
+/**
+ * Record the cardinality of the bitmap at `inv_key` and move the stats of
+ * its tag key by the change. `key_to_index` tells which keys get histograms
+ */
+bool tag_stats_put_cardinality(MDB_txn *txn, MDB_dbi db,
+                               kh_key_index_t *key_to_index,
+                               const char *inv_key, uint64_t card);
+
+// False if `inv_key` has no stats yet, or on error
+bool tag_stats_get_cardinality(MDB_txn *txn, MDB_dbi db, const char *inv_key,
+                               uint64_t *card_out);
+
+// False if `tag_key` has no stats yet, or on error
+bool tag_stats_get_key(MDB_txn *txn, MDB_dbi db, const char *tag_key,
+                       tag_key_stats_t *stats_out);
+
+/**
+ * Stats of every tag key, in key order. Caller frees them with
+ * `tag_stats_free_list`
+ */
+bool tag_stats_list(MDB_txn *txn, MDB_dbi db, tag_stats_entry_t **entries_out,
+                    uint32_t *count_out);
+
+void tag_stats_free_list(tag_stats_entry_t *entries, uint32_t count);
+
+#endif // TAG_STATS_H
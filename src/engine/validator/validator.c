@@ -1,7 +1,9 @@
 #include "validator.h"
+#include "core/conversions.h"
 #include "core/data_constants.h"
 #include "query/ast.h"
 #include <ctype.h>
+#include <stdint.h>
 #include <string.h>
 
 static bool _is_valid_filename(const char *filename) {
@@ -29,6 +31,8 @@ static bool _is_valid_container_name(const char *name) {
   return _is_valid_filename(name);
 }
 
+// One side must be a key. With two strings, e.g. `name > m`, the left one is
+// the key and the right one a string range bound.
 static bool _validate_comparison_op(ast_comparison_node_t *comp_node,
                                     validator_result_t *vr) {
   if (comp_node->left->type != AST_LITERAL_NODE ||
@@ -36,22 +40,227 @@ static bool _validate_comparison_op(ast_comparison_node_t *comp_node,
     vr->err_msg = "Invalid comparison";
     return false;
   }
-  if ((comp_node->left->literal.type == AST_LITERAL_STRING &&
-       comp_node->right->literal.type == AST_LITERAL_STRING) ||
-      (comp_node->left->literal.type == AST_LITERAL_NUMBER &&
-       comp_node->right->literal.type == AST_LITERAL_NUMBER)) {
+  if (comp_node->left->literal.type != AST_LITERAL_STRING &&
+      comp_node->right->literal.type != AST_LITERAL_STRING) {
     vr->err_msg = "Invalid comparison types";
 
     return false;
   }
+  // `key ~ value` only, the value a string
+  if (comp_node->op == AST_OP_CONTAINS &&
+      (comp_node->left->literal.type != AST_LITERAL_STRING ||
+       comp_node->right->literal.type != AST_LITERAL_STRING)) {
+    vr->err_msg = "~ needs a string value";
+    return false;
+  }
 
   return true;
 }
 
-static bool _is_valid_where_exp(ast_node_t *node, validator_result_t *vr) {
+// `SHOW` targets
+static bool _is_valid_show_target(ast_node_t *value) {
+  return value->literal.type == AST_LITERAL_STRING &&
+         (strcmp(value->literal.string_value, "backfills") == 0 ||
+          strcmp(value->literal.string_value, "stats") == 0 ||
+          strcmp(value->literal.string_value, "keys") == 0);
+}
+
+// Targets that read one container
+static bool _show_target_needs_in(ast_node_t *value) {
+  return strcmp(value->literal.string_value, "stats") == 0 ||
+         strcmp(value->literal.string_value, "keys") == 0;
+}
+
+static bool _is_valid_index_type(ast_node_t *value) {
+  if (value->literal.type != AST_LITERAL_STRING) {
+    return false;
+  }
+  const char *name = value->literal.string_value;
+  return strcmp(name, "i64") == 0 || strcmp(name, "f64") == 0 ||
+         strcmp(name, "str") == 0 || strcmp(name, "bsi") == 0;
+}
+
+// Milliseconds or a duration such as `1m`, e.g. `bucket:` of a HISTOGRAM
+static bool _duration_ms(ast_node_t *value, uint64_t *ms_out) {
+  if (value->literal.type == AST_LITERAL_NUMBER) {
+    *ms_out = (uint64_t)value->literal.number_value;
+    return value->literal.number_value > 0;
+  }
+  return value->literal.type == AST_LITERAL_STRING &&
+         conv_duration_to_ms(value->literal.string_value, ms_out);
+}
+
+// Custom tags with a meaning for HISTOGRAM, see `_validate_histogram`
+static bool _is_histogram_tag(const char *key) {
+  return strcmp(key, "bucket") == 0 || strcmp(key, "from") == 0 ||
+         strcmp(key, "to") == 0;
+}
+
+// `bucket`, `from` and `to` are each required once, `from` before `to`
+static void _validate_histogram(ast_node_t *tags, validator_result_t *r) {
+  ast_node_t *bucket = NULL;
+  ast_node_t *from = NULL;
+  ast_node_t *to = NULL;
+  for (ast_node_t *tag = tags; tag; tag = tag->next) {
+    if (tag->tag.key_type != AST_TAG_KEY_CUSTOM) {
+      continue;
+    }
+    const char *key = tag->tag.custom_key;
+    ast_node_t **slot = &to;
+    if (strcmp(key, "bucket") == 0) {
+      slot = &bucket;
+    } else if (strcmp(key, "from") == 0) {
+      slot = &from;
+    }
+    if (*slot) {
+      r->err_msg = "Duplicate tag";
+      return;
+    }
+    *slot = tag->tag.value;
+  }
+  if (!bucket || !from || !to) {
+    r->err_msg = "`bucket`, `from` and `to` tags are required";
+    return;
+  }
+  uint64_t bucket_ms;
+  if (!_duration_ms(bucket, &bucket_ms)) {
+    r->err_msg = "Invalid `bucket` duration";
+    return;
+  }
+  if (from->literal.type != AST_LITERAL_NUMBER ||
+      to->literal.type != AST_LITERAL_NUMBER ||
+      to->literal.number_value <= from->literal.number_value) {
+    r->err_msg = "`from` and `to` must be timestamps, `from` first";
+    return;
+  }
+  uint64_t span =
+      (uint64_t)(to->literal.number_value - from->literal.number_value);
+  if (span / bucket_ms + (span % bucket_ms ? 1 : 0) > MAX_HISTOGRAM_BUCKETS) {
+    r->err_msg = "Too many buckets";
+    return;
+  }
+  r->is_valid = true;
+}
+
+// Custom tags with a meaning for CREATE ROLLUP and ROLLUP
+static bool _is_rollup_tag(ast_command_type_t cmd_type, const char *key) {
+  if (strcmp(key, "bucket") == 0) {
+    return true;
+  }
+  return cmd_type == AST_CMD_ROLLUP &&
+         (strcmp(key, "from") == 0 || strcmp(key, "to") == 0);
+}
+
+// `by:(k1,k2)`: 1 to MAX_ROLLUP_KEYS distinct custom tag keys. Keys are part
+// of the rollup id, so `,` and `|` are not allowed
+static bool _is_valid_rollup_keys(ast_node_t *keys, validator_result_t *r) {
+  uint32_t num_keys = 0;
+  for (ast_node_t *k = keys; k; k = k->next) {
+    const char *key = k->literal.string_value;
+    if (strcmp(key, "in") == 0 || strcmp(key, "id") == 0 ||
+        strcmp(key, "entity") == 0) {
+      r->err_msg = "Rollups count custom tags only";
+      return false;
+    }
+    size_t len = strlen(key);
+    if (len == 0 || len > 64) {
+      r->err_msg = "Invalid `by` key";
+      return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+      unsigned char c = (unsigned char)key[i];
+      if (!isalnum(c) && c != '_' && c != '-' && c != '.') {
+        r->err_msg = "Invalid `by` key";
+        return false;
+      }
+    }
+    for (ast_node_t *prev = keys; prev != k; prev = prev->next) {
+      if (strcmp(prev->literal.string_value, key) == 0) {
+        r->err_msg = "Duplicate `by` key";
+        return false;
+      }
+    }
+    if (++num_keys > MAX_ROLLUP_KEYS) {
+      r->err_msg = "Too many `by` keys";
+      return false;
+    }
+  }
+  return true;
+}
+
+// `bucket` is required once, ROLLUP also needs `from` before `to`
+static void _validate_rollup(ast_node_t *tags, ast_command_type_t cmd_type,
+                             validator_result_t *r) {
+  ast_node_t *bucket = NULL;
+  ast_node_t *from = NULL;
+  ast_node_t *to = NULL;
+  for (ast_node_t *tag = tags; tag; tag = tag->next) {
+    if (tag->tag.key_type != AST_TAG_KEY_CUSTOM) {
+      continue;
+    }
+    const char *key = tag->tag.custom_key;
+    ast_node_t **slot = &to;
+    if (strcmp(key, "bucket") == 0) {
+      slot = &bucket;
+    } else if (strcmp(key, "from") == 0) {
+      slot = &from;
+    }
+    if (*slot) {
+      r->err_msg = "Duplicate tag";
+      return;
+    }
+    *slot = tag->tag.value;
+  }
+  uint64_t bucket_ms;
+  if (!bucket || !_duration_ms(bucket, &bucket_ms)) {
+    r->err_msg = "A `bucket` duration is required";
+    return;
+  }
+  if (cmd_type == AST_CMD_ROLLUP &&
+      (!from || !to || from->literal.type != AST_LITERAL_NUMBER ||
+       to->literal.type != AST_LITERAL_NUMBER ||
+       from->literal.number_value < 0 ||
+       to->literal.number_value <= from->literal.number_value)) {
+    r->err_msg = "`from` and `to` must be timestamps, `from` first";
+    return;
+  }
+  r->is_valid = true;
+}
+
+static bool _is_valid_view_name(ast_node_t *value) {
+  return value->literal.type == AST_LITERAL_STRING &&
+         _is_valid_filename(value->literal.string_value);
+}
+
+static bool _is_valid_where_exp(ast_node_t *node, ast_command_type_t cmd_type,
+                                validator_result_t *vr) {
   bool r = false;
   switch (node->type) {
   case AST_TAG_NODE:
+    if (node->tag.key_type == AST_TAG_KEY_RESERVED &&
+        node->tag.reserved_key == AST_KW_VIEW) {
+      // Views and subscriptions match event tags, not other views
+      if (cmd_type == AST_CMD_CREATE_VIEW) {
+        vr->err_msg = "Views cannot reference other views";
+        return false;
+      }
+      if (cmd_type == AST_CMD_SUBSCRIBE) {
+        vr->err_msg = "Subscriptions cannot reference views";
+        return false;
+      }
+      if (!_is_valid_view_name(node->tag.value)) {
+        vr->err_msg = "Invalid view name";
+        return false;
+      }
+      return true;
+    }
+    if (node->tag.key_type == AST_TAG_KEY_RESERVED &&
+        node->tag.reserved_key == AST_KW_ENTITY &&
+        node->tag.value->literal.type == AST_LITERAL_STRING &&
+        node->tag.value->literal.string_value_len > MAX_ENTITY_STR_LEN) {
+      vr->err_msg = "`entity` value too long";
+      return false;
+    }
     return true;
   case AST_LITERAL_NODE:
     // Literals must be apart of conditions
@@ -59,20 +268,71 @@ static bool _is_valid_where_exp(ast_node_t *node, validator_result_t *vr) {
     return false;
     break;
   case AST_LOGICAL_NODE:
-    r = _is_valid_where_exp(node->logical.left_operand, vr);
+    r = _is_valid_where_exp(node->logical.left_operand, cmd_type, vr);
     if (!r)
       return false;
-    return _is_valid_where_exp(node->logical.right_operand, vr);
+    return _is_valid_where_exp(node->logical.right_operand, cmd_type, vr);
   case AST_COMPARISON_NODE:
     return _validate_comparison_op(&node->comparison, vr);
   case AST_NOT_NODE:
-    return _is_valid_where_exp(node->not_op.operand, vr);
+    return _is_valid_where_exp(node->not_op.operand, cmd_type, vr);
   default:
     vr->err_msg = "Unknown or unsupported system tag";
     return false;
   }
 }
 
+// `ENTITIES of:(...)`: containers, `<container>:<view>` pairs, AND, OR and
+// NOT on one side of an AND, e.g. `(day1 AND NOT day8)`
+static bool _is_valid_entity_set(ast_node_t *node, uint32_t *leaves,
+                                 validator_result_t *vr) {
+  switch (node->type) {
+  case AST_LITERAL_NODE:
+    if (node->literal.type != AST_LITERAL_STRING ||
+        !_is_valid_container_name(node->literal.string_value)) {
+      vr->err_msg = "Invalid container name";
+      return false;
+    }
+    break;
+  case AST_TAG_NODE:
+    if (node->tag.key_type != AST_TAG_KEY_CUSTOM ||
+        !_is_valid_container_name(node->tag.custom_key)) {
+      vr->err_msg = "Invalid container name";
+      return false;
+    }
+    if (!_is_valid_view_name(node->tag.value)) {
+      vr->err_msg = "Invalid view name";
+      return false;
+    }
+    break;
+  case AST_LOGICAL_NODE: {
+    ast_node_t *left = node->logical.left_operand;
+    ast_node_t *right = node->logical.right_operand;
+    if (node->logical.op == AST_LOGIC_NODE_AND) {
+      if (left->type == AST_NOT_NODE && right->type == AST_NOT_NODE) {
+        vr->err_msg = "NOT only applies to one side of AND";
+        return false;
+      }
+      left = left->type == AST_NOT_NODE ? left->not_op.operand : left;
+      right = right->type == AST_NOT_NODE ? right->not_op.operand : right;
+    }
+    return _is_valid_entity_set(left, leaves, vr) &&
+           _is_valid_entity_set(right, leaves, vr);
+  }
+  case AST_NOT_NODE:
+    vr->err_msg = "NOT only applies to one side of AND";
+    return false;
+  default:
+    vr->err_msg = "Invalid entity set";
+    return false;
+  }
+  if (++*leaves > MAX_ENTITY_SET_LEAVES) {
+    vr->err_msg = "Too many containers in entity set";
+    return false;
+  }
+  return true;
+}
+
 static void _validate_ast(ast_node_t *ast, custom_tag_key_t **c_keys,
                           validator_result_t *r) {
   bool seen_in = false;
@@ -81,6 +341,23 @@ static void _validate_ast(ast_node_t *ast, custom_tag_key_t **c_keys,
   bool seen_key = false;
   bool seen_take = false;
   bool seen_cursor = false;
+  bool seen_fields = false;
+  bool seen_timeout = false;
+  bool seen_sample = false;
+  bool seen_view = false;
+  bool seen_index_type = false;
+  bool seen_target = false;
+  bool seen_agg = false;
+  bool seen_plan = false;
+  bool seen_top_n = false;
+  bool seen_steps = false;
+  bool seen_within = false;
+  bool seen_of = false;
+  bool seen_ids_only = false;
+  bool seen_session = false;
+  bool seen_after = false;
+  bool seen_by = false;
+  ast_node_t *target = NULL;
 
   ast_command_type_t cmd_type = ast->command.type;
   custom_tag_key_t *c_key = NULL;
@@ -92,7 +369,11 @@ static void _validate_ast(ast_node_t *ast, custom_tag_key_t **c_keys,
       case AST_KW_IN:
         if (cmd_type == AST_CMD_INDEX) {
           r->err_msg = "Indexing specific containers is not supported yet. "
-                       "Indexes apply globally to new data containers.";
+                       "Indexes apply globally to all data containers.";
+          return;
+        }
+        if (cmd_type == AST_CMD_ENTITIES) {
+          r->err_msg = "Unexpected `in` tag, containers are named in `of`";
           return;
         }
         if (seen_in) {
@@ -113,8 +394,11 @@ static void _validate_ast(ast_node_t *ast, custom_tag_key_t **c_keys,
                 // seen_id = true;
                 // break;
       case AST_KW_WHERE:
-        if (cmd_type != AST_CMD_QUERY) {
-          r->err_msg = "`where` tag only supported for queries";
+        if (cmd_type != AST_CMD_QUERY && cmd_type != AST_CMD_CREATE_VIEW &&
+            cmd_type != AST_CMD_SUBSCRIBE && cmd_type != AST_CMD_TOP &&
+            cmd_type != AST_CMD_HISTOGRAM) {
+          r->err_msg = "`where` tag only supported for queries, views and "
+                       "subscriptions";
           return;
         }
         if (seen_where) {
@@ -122,7 +406,7 @@ static void _validate_ast(ast_node_t *ast, custom_tag_key_t **c_keys,
           return;
         }
         seen_where = true;
-        if (!_is_valid_where_exp(t_node.value, r)) {
+        if (!_is_valid_where_exp(t_node.value, cmd_type, r)) {
           return;
         }
         break;
@@ -148,7 +432,7 @@ static void _validate_ast(ast_node_t *ast, custom_tag_key_t **c_keys,
           r->err_msg = "Duplicate `take` tag";
           return;
         }
-        if (cmd_type != AST_CMD_QUERY) {
+        if (cmd_type != AST_CMD_QUERY && cmd_type != AST_CMD_ENTITIES) {
           r->err_msg = "Unexpected `take` tag";
           return;
         }
@@ -167,7 +451,7 @@ static void _validate_ast(ast_node_t *ast, custom_tag_key_t **c_keys,
           r->err_msg = "Duplicate `cursor` tag";
           return;
         }
-        if (cmd_type != AST_CMD_QUERY) {
+        if (cmd_type != AST_CMD_QUERY && cmd_type != AST_CMD_ENTITIES) {
           r->err_msg = "Unexpected `cursor` tag";
           return;
         }
@@ -182,7 +466,7 @@ static void _validate_ast(ast_node_t *ast, custom_tag_key_t **c_keys,
         seen_cursor = true;
         break;
       case AST_KW_KEY:
-        if (cmd_type != AST_CMD_INDEX) {
+        if (cmd_type != AST_CMD_INDEX && cmd_type != AST_CMD_TOP) {
           r->err_msg = "Unexpected `key` tag";
           return;
         }
@@ -190,11 +474,267 @@ static void _validate_ast(ast_node_t *ast, custom_tag_key_t **c_keys,
           r->err_msg = "Duplicate `key` tag";
           return;
         }
+        if (t_node.value->literal.type == AST_LITERAL_STRING &&
+            t_node.value->literal.string_value_len > MAX_TEXT_VAL_LEN) {
+          r->err_msg = "`key` value too long";
+          return;
+        }
         seen_key = true;
         break;
+      case AST_KW_FIELDS: {
+        if (cmd_type != AST_CMD_QUERY) {
+          r->err_msg = "Unexpected `fields` tag";
+          return;
+        }
+        if (seen_fields) {
+          r->err_msg = "Duplicate `fields` tag";
+          return;
+        }
+        uint32_t num_fields = 0;
+        for (ast_node_t *f = t_node.value; f; f = f->next) {
+          if (++num_fields > MAX_QUERY_FIELDS) {
+            r->err_msg = "Too many fields";
+            return;
+          }
+        }
+        seen_fields = true;
+        break;
+      }
+      case AST_KW_TIMEOUT:
+        if (seen_timeout) {
+          r->err_msg = "Duplicate `timeout` tag";
+          return;
+        }
+        if (cmd_type != AST_CMD_QUERY && cmd_type != AST_CMD_TOP &&
+            cmd_type != AST_CMD_HISTOGRAM && cmd_type != AST_CMD_FUNNEL &&
+            cmd_type != AST_CMD_ENTITIES) {
+          r->err_msg = "Unexpected `timeout` tag";
+          return;
+        }
+        if (t_node.value->literal.type != AST_LITERAL_NUMBER) {
+          r->err_msg = "Value of `timeout` tag must be numeric";
+          return;
+        }
+        if (t_node.value->literal.number_value <= 0 ||
+            t_node.value->literal.number_value > MAX_QUERY_TIMEOUT_MS) {
+          r->err_msg = "Value of `timeout` tag is out of range";
+          return;
+        }
+        seen_timeout = true;
+        break;
+      case AST_KW_SAMPLE:
+        if (seen_sample) {
+          r->err_msg = "Duplicate `sample` tag";
+          return;
+        }
+        if (cmd_type != AST_CMD_QUERY) {
+          r->err_msg = "Unexpected `sample` tag";
+          return;
+        }
+        if (t_node.value->literal.type != AST_LITERAL_NUMBER) {
+          r->err_msg = "Value of `sample` tag must be numeric";
+          return;
+        }
+        if (t_node.value->literal.number_value <= 0 ||
+            t_node.value->literal.number_value > MAX_QUERY_SAMPLE_PCT) {
+          r->err_msg = "Value of `sample` tag is out of range";
+          return;
+        }
+        seen_sample = true;
+        break;
+      case AST_KW_VIEW:
+        if (cmd_type != AST_CMD_CREATE_VIEW) {
+          r->err_msg = "Unexpected `view` tag";
+          return;
+        }
+        if (seen_view) {
+          r->err_msg = "Duplicate `view` tag";
+          return;
+        }
+        if (!_is_valid_view_name(t_node.value)) {
+          r->err_msg = "Invalid view name";
+          return;
+        }
+        seen_view = true;
+        break;
+      case AST_KW_TARGET:
+        if (cmd_type != AST_CMD_SHOW || seen_target) {
+          r->err_msg = "Unexpected `target` tag";
+          return;
+        }
+        if (!_is_valid_show_target(t_node.value)) {
+          r->err_msg = "Unknown SHOW target";
+          return;
+        }
+        seen_target = true;
+        target = t_node.value;
+        break;
+      case AST_KW_PLAN:
+        // Only set by the parser for `EXPLAIN QUERY` and `PROFILE QUERY`
+        if (cmd_type != AST_CMD_QUERY || seen_plan) {
+          r->err_msg = "Unexpected `plan` tag";
+          return;
+        }
+        seen_plan = true;
+        break;
+      case AST_KW_STEPS: {
+        if (cmd_type != AST_CMD_FUNNEL) {
+          r->err_msg = "Unexpected `steps` tag";
+          return;
+        }
+        if (seen_steps) {
+          r->err_msg = "Duplicate `steps` tag";
+          return;
+        }
+        uint32_t num_steps = 0;
+        for (ast_node_t *step = t_node.value; step; step = step->next) {
+          if (!_is_valid_where_exp(step, cmd_type, r)) {
+            return;
+          }
+          num_steps++;
+        }
+        if (num_steps < 2 || num_steps > MAX_FUNNEL_STEPS) {
+          r->err_msg = "A funnel has 2 to 16 steps";
+          return;
+        }
+        seen_steps = true;
+        break;
+      }
+      case AST_KW_OF: {
+        if (cmd_type != AST_CMD_ENTITIES) {
+          r->err_msg = "Unexpected `of` tag";
+          return;
+        }
+        if (seen_of) {
+          r->err_msg = "Duplicate `of` tag";
+          return;
+        }
+        uint32_t leaves = 0;
+        if (!_is_valid_entity_set(t_node.value, &leaves, r)) {
+          return;
+        }
+        seen_of = true;
+        break;
+      }
+      case AST_KW_BY:
+        if (cmd_type != AST_CMD_CREATE_ROLLUP && cmd_type != AST_CMD_ROLLUP) {
+          r->err_msg = "Unexpected `by` tag";
+          return;
+        }
+        if (seen_by) {
+          r->err_msg = "Duplicate `by` tag";
+          return;
+        }
+        if (!_is_valid_rollup_keys(t_node.value, r)) {
+          return;
+        }
+        seen_by = true;
+        break;
       default:
         return;
       }
+    } else if (cmd_type == AST_CMD_INDEX &&
+               strcmp(t_node.custom_key, "type") == 0) {
+      // `type` is not reserved, it only has a meaning for indexes
+      if (seen_index_type) {
+        r->err_msg = "Duplicate `type` tag";
+        return;
+      }
+      if (!_is_valid_index_type(t_node.value)) {
+        r->err_msg = "Index type must be one of i64, f64, str, bsi";
+        return;
+      }
+      seen_index_type = true;
+    } else if (cmd_type == AST_CMD_QUERY &&
+               strcmp(t_node.custom_key, "agg") == 0) {
+      // `agg:<key>` aggregates a bsi index over the matches
+      if (seen_agg) {
+        r->err_msg = "Duplicate `agg` tag";
+        return;
+      }
+      if (t_node.value->literal.type != AST_LITERAL_STRING) {
+        r->err_msg = "Value of `agg` tag must be a tag key";
+        return;
+      }
+      seen_agg = true;
+    } else if (cmd_type == AST_CMD_QUERY &&
+               strcmp(t_node.custom_key, "ids_only") == 0) {
+      // `ids_only:true` returns matching ids as a bitmap, not events
+      if (seen_ids_only) {
+        r->err_msg = "Duplicate `ids_only` tag";
+        return;
+      }
+      if (t_node.value->literal.type != AST_LITERAL_STRING ||
+          strcmp(t_node.value->literal.string_value, "true") != 0) {
+        r->err_msg = "Value of `ids_only` tag must be true";
+        return;
+      }
+      seen_ids_only = true;
+    } else if (cmd_type == AST_CMD_QUERY &&
+               strcmp(t_node.custom_key, "session") == 0) {
+      // `session:new` keeps the result for later pages, `session:<handle>`
+      // pages through it
+      if (seen_session) {
+        r->err_msg = "Duplicate `session` tag";
+        return;
+      }
+      ast_literal_node_t *lit = &t_node.value->literal;
+      bool is_new = lit->type == AST_LITERAL_STRING &&
+                    strcmp(lit->string_value, "new") == 0;
+      if (!is_new &&
+          (lit->type != AST_LITERAL_NUMBER || lit->number_value <= 0)) {
+        r->err_msg = "Value of `session` tag must be new or a session handle";
+        return;
+      }
+      seen_session = true;
+    } else if (cmd_type == AST_CMD_QUERY &&
+               strcmp(t_node.custom_key, "after") == 0) {
+      // `after:<event_id>` waits until the event is visible, see watermark.h
+      if (seen_after) {
+        r->err_msg = "Duplicate `after` tag";
+        return;
+      }
+      if (t_node.value->literal.type != AST_LITERAL_NUMBER ||
+          t_node.value->literal.number_value <= 0 ||
+          t_node.value->literal.number_value > UINT32_MAX) {
+        r->err_msg = "Value of `after` tag must be an event id";
+        return;
+      }
+      seen_after = true;
+    } else if (cmd_type == AST_CMD_TOP &&
+               strcmp(t_node.custom_key, "n") == 0) {
+      // `n:<count>` of values TOP returns
+      if (seen_top_n) {
+        r->err_msg = "Duplicate `n` tag";
+        return;
+      }
+      if (t_node.value->literal.type != AST_LITERAL_NUMBER ||
+          t_node.value->literal.number_value <= 0 ||
+          t_node.value->literal.number_value > MAX_TOP_N) {
+        r->err_msg = "Value of `n` tag is out of range";
+        return;
+      }
+      seen_top_n = true;
+    } else if (cmd_type == AST_CMD_HISTOGRAM &&
+               _is_histogram_tag(t_node.custom_key)) {
+      // Checked together once all tags are seen
+    } else if ((cmd_type == AST_CMD_CREATE_ROLLUP ||
+                cmd_type == AST_CMD_ROLLUP) &&
+               _is_rollup_tag(cmd_type, t_node.custom_key)) {
+      // Checked together once all tags are seen
+    } else if (cmd_type == AST_CMD_FUNNEL &&
+               strcmp(t_node.custom_key, "within") == 0) {
+      // `within:<duration>` from an entity's first step to its last
+      uint64_t within_ms;
+      if (seen_within) {
+        r->err_msg = "Duplicate `within` tag";
+        return;
+      }
+      if (!_duration_ms(t_node.value, &within_ms)) {
+        r->err_msg = "Invalid `within` duration";
+        return;
+      }
+      seen_within = true;
     } else {
       if (cmd_type != AST_CMD_EVENT) {
         r->err_msg = "Unexpected tag";
@@ -217,7 +757,8 @@ static void _validate_ast(ast_node_t *ast, custom_tag_key_t **c_keys,
     tag = tag->next;
   }
 
-  if (!seen_in && cmd_type != AST_CMD_INDEX) {
+  if (!seen_in && cmd_type != AST_CMD_INDEX && cmd_type != AST_CMD_SHOW &&
+      cmd_type != AST_CMD_ENTITIES) {
     r->err_msg = "`in` tag is required";
     return;
   }
@@ -227,16 +768,64 @@ static void _validate_ast(ast_node_t *ast, custom_tag_key_t **c_keys,
     return;
   }
 
-  if (cmd_type == AST_CMD_QUERY && !seen_where) {
+  if ((cmd_type == AST_CMD_QUERY || cmd_type == AST_CMD_CREATE_VIEW ||
+       cmd_type == AST_CMD_SUBSCRIBE || cmd_type == AST_CMD_HISTOGRAM) &&
+      !seen_where) {
     r->err_msg = "`where` tag is required";
     return;
   }
 
-  if (cmd_type == AST_CMD_INDEX && !seen_key) {
+  if ((cmd_type == AST_CMD_INDEX || cmd_type == AST_CMD_TOP) && !seen_key) {
     r->err_msg = "`key` tag is required";
     return;
   }
 
+  if (cmd_type == AST_CMD_FUNNEL && (!seen_steps || !seen_within)) {
+    r->err_msg = "`steps` and `within` tags are required";
+    return;
+  }
+
+  if (seen_ids_only && (seen_fields || seen_agg || seen_plan)) {
+    r->err_msg = "`ids_only` cannot be combined with `fields`, `agg` or "
+                 "EXPLAIN/PROFILE";
+    return;
+  }
+
+  if (seen_session && (seen_agg || seen_sample || seen_plan)) {
+    r->err_msg = "`session` cannot be combined with `agg`, `sample` or "
+                 "EXPLAIN/PROFILE";
+    return;
+  }
+
+  if (cmd_type == AST_CMD_ENTITIES && !seen_of) {
+    r->err_msg = "`of` tag is required";
+    return;
+  }
+
+  if (cmd_type == AST_CMD_SHOW && !seen_target) {
+    r->err_msg = "SHOW target is required";
+    return;
+  }
+
+  if (cmd_type == AST_CMD_SHOW && seen_in != _show_target_needs_in(target)) {
+    r->err_msg = seen_in ? "Unexpected `in` tag" : "`in` tag is required";
+    return;
+  }
+
+  if (cmd_type == AST_CMD_HISTOGRAM) {
+    _validate_histogram(ast->command.tags, r);
+    return;
+  }
+
+  if (cmd_type == AST_CMD_CREATE_ROLLUP || cmd_type == AST_CMD_ROLLUP) {
+    if (!seen_by) {
+      r->err_msg = "`by` tag is required";
+      return;
+    }
+    _validate_rollup(ast->command.tags, cmd_type, r);
+    return;
+  }
+
   r->is_valid = true;
 }
 
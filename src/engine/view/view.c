@@ -0,0 +1,597 @@
+#include "view.h"
+#include "core/data_constants.h"
+#include "core/db.h"
+#include "engine/eng_key_format/eng_key_format.h"
+#include "lmdb.h"
+#include "mpack.h"
+#include "query/ast.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Deeper expressions are rejected when decoding
+#define MAX_EXP_DEPTH 128
+
+// --- Expression encoding ---
+// Each node is an array whose first element is its `ast_node_type`:
+//   tag:        [type, custom key (str) | reserved key (int), value]
+//   literal:    [type, str | int] or, for decimals, [type, text, double]
+//   comparison: [type, op, left, right]
+//   logical:    [type, op, left, right]
+//   not:        [type, operand]
+
+static void _write_exp(mpack_writer_t *w, ast_node_t *node) {
+  switch (node->type) {
+  case AST_TAG_NODE:
+    mpack_start_array(w, 3);
+    mpack_write_u32(w, AST_TAG_NODE);
+    if (node->tag.key_type == AST_TAG_KEY_CUSTOM) {
+      mpack_write_cstr(w, node->tag.custom_key);
+    } else {
+      mpack_write_u32(w, node->tag.reserved_key);
+    }
+    _write_exp(w, node->tag.value);
+    break;
+  case AST_LITERAL_NODE:
+    if (node->literal.type == AST_LITERAL_FLOAT) {
+      mpack_start_array(w, 3);
+      mpack_write_u32(w, AST_LITERAL_NODE);
+      mpack_write_cstr(w, node->literal.string_value);
+      mpack_write_double(w, node->literal.float_value);
+      break;
+    }
+    mpack_start_array(w, 2);
+    mpack_write_u32(w, AST_LITERAL_NODE);
+    if (node->literal.type == AST_LITERAL_STRING) {
+      mpack_write_cstr(w, node->literal.string_value);
+    } else {
+      mpack_write_i64(w, node->literal.number_value);
+    }
+    break;
+  case AST_COMPARISON_NODE:
+    mpack_start_array(w, 4);
+    mpack_write_u32(w, AST_COMPARISON_NODE);
+    mpack_write_u32(w, node->comparison.op);
+    _write_exp(w, node->comparison.left);
+    _write_exp(w, node->comparison.right);
+    break;
+  case AST_LOGICAL_NODE:
+    mpack_start_array(w, 4);
+    mpack_write_u32(w, AST_LOGICAL_NODE);
+    mpack_write_u32(w, node->logical.op);
+    _write_exp(w, node->logical.left_operand);
+    _write_exp(w, node->logical.right_operand);
+    break;
+  case AST_NOT_NODE:
+    mpack_start_array(w, 2);
+    mpack_write_u32(w, AST_NOT_NODE);
+    _write_exp(w, node->not_op.operand);
+    break;
+  default:
+    mpack_writer_flag_error(w, mpack_error_bug);
+    return;
+  }
+  mpack_finish_array(w);
+}
+
+bool view_encode_exp(ast_node_t *exp, char **data_out, size_t *size_out) {
+  if (!exp || !data_out || !size_out) {
+    return false;
+  }
+  mpack_writer_t writer;
+  char *data = NULL;
+  size_t size = 0;
+  mpack_writer_init_growable(&writer, &data, &size);
+  _write_exp(&writer, exp);
+  if (mpack_writer_destroy(&writer) != mpack_ok) {
+    free(data);
+    return false;
+  }
+  *data_out = data;
+  *size_out = size;
+  return true;
+}
+
+static ast_node_t *_read_exp(mpack_reader_t *r, int depth);
+
+static ast_node_t *_read_literal(mpack_reader_t *r, uint32_t len) {
+  if (mpack_peek_tag(r).type == mpack_type_str) {
+    char *s = mpack_expect_cstr_alloc(r, MAX_TEXT_VAL_LEN + 1);
+    if (!s) {
+      return NULL;
+    }
+    ast_node_t *node = NULL;
+    if (len == 3) {
+      double d = mpack_expect_double(r);
+      if (mpack_reader_error(r) == mpack_ok) {
+        node = ast_create_float_literal_node(d, s, strlen(s));
+      }
+    } else {
+      node = ast_create_string_literal_node(s, strlen(s));
+    }
+    free(s);
+    return node;
+  }
+  if (len != 2) {
+    return NULL;
+  }
+  int64_t n = mpack_expect_i64(r);
+  if (mpack_reader_error(r) != mpack_ok) {
+    return NULL;
+  }
+  return ast_create_number_literal_node(n);
+}
+
+static ast_node_t *_read_tag(mpack_reader_t *r, int depth) {
+  char *custom_key = NULL;
+  uint32_t reserved_key = 0;
+  if (mpack_peek_tag(r).type == mpack_type_str) {
+    custom_key = mpack_expect_cstr_alloc(r, MAX_TEXT_VAL_LEN + 1);
+    if (!custom_key) {
+      return NULL;
+    }
+  } else {
+    reserved_key = mpack_expect_u32(r);
+  }
+
+  ast_node_t *value = _read_exp(r, depth + 1);
+  ast_node_t *node = NULL;
+  if (value && value->type == AST_LITERAL_NODE) {
+    node = custom_key ? ast_create_custom_tag_node(custom_key, value)
+                      : ast_create_tag_node(reserved_key, value);
+  }
+  free(custom_key);
+  if (!node) {
+    ast_free(value);
+  }
+  return node;
+}
+
+static ast_node_t *_read_binary(mpack_reader_t *r, uint32_t type, int depth) {
+  uint32_t op = mpack_expect_u32(r);
+  ast_node_t *left = _read_exp(r, depth + 1);
+  ast_node_t *right = left ? _read_exp(r, depth + 1) : NULL;
+  ast_node_t *node = NULL;
+  if (left && right) {
+    node = type == AST_COMPARISON_NODE
+               ? ast_create_comparison_node(op, left, right)
+               : ast_create_logical_node(op, left, right);
+  }
+  if (!node) {
+    ast_free(left);
+    ast_free(right);
+  }
+  return node;
+}
+
+static ast_node_t *_read_exp(mpack_reader_t *r, int depth) {
+  if (depth > MAX_EXP_DEPTH) {
+    mpack_reader_flag_error(r, mpack_error_invalid);
+    return NULL;
+  }
+  uint32_t n = mpack_expect_array(r);
+  uint32_t type = mpack_expect_u32(r);
+  if (mpack_reader_error(r) != mpack_ok) {
+    return NULL;
+  }
+
+  ast_node_t *node = NULL;
+  switch (type) {
+  case AST_TAG_NODE:
+    node = n == 3 ? _read_tag(r, depth) : NULL;
+    break;
+  case AST_LITERAL_NODE:
+    node = n == 2 || n == 3 ? _read_literal(r, n) : NULL;
+    break;
+  case AST_COMPARISON_NODE:
+  case AST_LOGICAL_NODE:
+    node = n == 4 ? _read_binary(r, type, depth) : NULL;
+    break;
+  case AST_NOT_NODE:
+    if (n == 2) {
+      ast_node_t *operand = _read_exp(r, depth + 1);
+      node = operand ? ast_create_not_node(operand) : NULL;
+      if (!node) {
+        ast_free(operand);
+      }
+    }
+    break;
+  default:
+    break;
+  }
+
+  if (!node) {
+    mpack_reader_flag_error(r, mpack_error_invalid);
+    return NULL;
+  }
+  mpack_done_array(r);
+  return node;
+}
+
+ast_node_t *view_decode_exp(const char *data, size_t size) {
+  if (!data) {
+    return NULL;
+  }
+  mpack_reader_t reader;
+  mpack_reader_init_data(&reader, data, size);
+  ast_node_t *exp = _read_exp(&reader, 0);
+  if (mpack_reader_destroy(&reader) != mpack_ok) {
+    ast_free(exp);
+    return NULL;
+  }
+  return exp;
+}
+
+// --- Registry ---
+
+static void _set_free(view_set_t *set) {
+  free(set->views);
+  free(set);
+}
+
+static void _view_free(view_t *v) {
+  free(v->name);
+  ast_free(v->where);
+}
+
+db_put_result_t view_add(const char *name, const char *exp_data,
+                         size_t exp_size, MDB_env *env, MDB_dbi dbi) {
+  if (!name || !exp_data || !env) {
+    return DB_PUT_ERR;
+  }
+  char key[MAX_TEXT_VAL_LEN];
+  if (!view_key_into(key, sizeof(key), name)) {
+    return DB_PUT_ERR;
+  }
+
+  MDB_txn *txn = db_create_txn(env, false);
+  if (!txn) {
+    return DB_PUT_ERR;
+  }
+  db_key_t db_key = {.type = DB_KEY_STRING, .key.s = key};
+  db_put_result_t pr =
+      db_put(dbi, txn, &db_key, exp_data, exp_size, false, true);
+  if (pr != DB_PUT_OK) {
+    db_abort_txn(txn);
+    return pr;
+  }
+  return db_commit_txn(txn) ? DB_PUT_OK : DB_PUT_ERR;
+}
+
+bool view_open_registry(MDB_env *env, MDB_dbi dbi,
+                        _Atomic(view_set_t *) *views_out) {
+  if (!env || !views_out) {
+    return false;
+  }
+
+  view_set_t *set = calloc(1, sizeof(view_set_t));
+  if (!set) {
+    return false;
+  }
+
+  MDB_txn *read_txn = db_create_txn(env, true);
+  if (!read_txn) {
+    free(set);
+    return false;
+  }
+  MDB_cursor *cursor = db_cursor_open(read_txn, dbi);
+  if (!cursor) {
+    db_abort_txn(read_txn);
+    free(set);
+    return false;
+  }
+
+  char prefix[16];
+  view_key_into(prefix, sizeof(prefix), "");
+  size_t prefix_len = strlen(prefix);
+  db_key_t seek_key = {.type = DB_KEY_STRING, .key.s = prefix};
+  db_cursor_entry_t entry;
+  uint32_t cap = 0;
+  bool ok = true;
+
+  db_cursor_get_result_t r =
+      db_cursor_get(cursor, &entry, MDB_SET_RANGE, &seek_key);
+  while (r == DB_CURSOR_OK && entry.key_len > prefix_len &&
+         memcmp(entry.key, prefix, prefix_len) == 0) {
+    if (set->count == cap) {
+      uint32_t new_cap = cap ? cap * 2 : 4;
+      view_t *grown = realloc(set->views, new_cap * sizeof(view_t));
+      if (!grown) {
+        ok = false;
+        break;
+      }
+      set->views = grown;
+      cap = new_cap;
+    }
+    view_t *v = &set->views[set->count];
+    size_t name_len = entry.key_len - prefix_len;
+    v->name = malloc(name_len + 1);
+    if (v->name) {
+      memcpy(v->name, (const char *)entry.key + prefix_len, name_len);
+      v->name[name_len] = '\0';
+    }
+    v->where = view_decode_exp(entry.value, entry.value_len);
+    if (!v->name || !v->where) {
+      _view_free(v);
+      ok = false;
+      break;
+    }
+    set->count++;
+    r = db_cursor_get(cursor, &entry, MDB_NEXT, NULL);
+  }
+
+  db_cursor_close(cursor);
+  db_abort_txn(read_txn);
+
+  if (!ok || r == DB_CURSOR_ERR) {
+    for (uint32_t i = 0; i < set->count; i++) {
+      _view_free(&set->views[i]);
+    }
+    _set_free(set);
+    return false;
+  }
+
+  atomic_store(views_out, set);
+  return true;
+}
+
+bool view_publish(_Atomic(view_set_t *) *views, const char *name,
+                  const char *exp_data, size_t exp_size) {
+  if (!views || !name || !exp_data) {
+    return false;
+  }
+  view_t added = {.name = strdup(name),
+                  .where = view_decode_exp(exp_data, exp_size)};
+  if (!added.name || !added.where) {
+    _view_free(&added);
+    return false;
+  }
+
+  view_set_t *cur = atomic_load(views);
+  while (true) {
+    uint32_t count = cur ? cur->count : 0;
+    view_set_t *next = calloc(1, sizeof(view_set_t));
+    view_t *arr = malloc((count + 1) * sizeof(view_t));
+    if (!next || !arr) {
+      free(next);
+      free(arr);
+      _view_free(&added);
+      return false;
+    }
+    if (count > 0) {
+      // Entries are shared with older sets, only the new one is owned here
+      memcpy(arr, cur->views, count * sizeof(view_t));
+    }
+    arr[count] = added;
+    next->count = count + 1;
+    next->views = arr;
+    next->prev = cur;
+    if (atomic_compare_exchange_weak(views, &cur, next)) {
+      return true;
+    }
+    _set_free(next);
+  }
+}
+
+const view_t *view_find(const view_set_t *set, const char *name) {
+  if (!set || !name) {
+    return NULL;
+  }
+  for (uint32_t i = 0; i < set->count; i++) {
+    if (strcmp(set->views[i].name, name) == 0) {
+      return &set->views[i];
+    }
+  }
+  return NULL;
+}
+
+void view_close_registry(_Atomic(view_set_t *) *views) {
+  if (!views) {
+    return;
+  }
+  view_set_t *set = atomic_exchange(views, NULL);
+  while (set) {
+    view_set_t *prev = set->prev;
+    // Views [prev->count, count) were added by this set
+    uint32_t first_owned = prev ? prev->count : 0;
+    for (uint32_t i = first_owned; i < set->count; i++) {
+      _view_free(&set->views[i]);
+    }
+    _set_free(set);
+    set = prev;
+  }
+}
+
+// --- Matching ---
+
+static bool _literal_eq(const ast_node_t *a, const ast_node_t *b) {
+  if (!a || !b || a->literal.type != b->literal.type) {
+    return false;
+  }
+  if (a->literal.type == AST_LITERAL_NUMBER) {
+    return a->literal.number_value == b->literal.number_value;
+  }
+  return strcmp(a->literal.string_value, b->literal.string_value) == 0;
+}
+
+// Same key text as the inverted index, so a view agrees with a query
+static bool _has_tag(ast_node_t *tag, cmd_ctx_t *cmd) {
+  if (tag->tag.key_type == AST_TAG_KEY_RESERVED) {
+    return tag->tag.reserved_key == AST_KW_ENTITY &&
+           _literal_eq(tag->tag.value, cmd->entity_tag_value);
+  }
+
+  char want[512];
+  char have[512];
+  if (!custom_tag_into(want, sizeof(want), tag)) {
+    return false;
+  }
+  ast_node_t *ct = cmd->custom_tags_head;
+  for (uint32_t i = 0; i < cmd->num_custom_tags && ct; i++, ct = ct->next) {
+    if (custom_tag_into(have, sizeof(have), ct) && strcmp(want, have) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Same values the writer puts in range indexes
+static bool _resolve_val(const char *key, cmd_ctx_t *cmd,
+                         ast_literal_node_t *out_val) {
+  if (strcmp(key, "ts") == 0) {
+    out_val->type = AST_LITERAL_NUMBER;
+    out_val->number_value = cmd->arrival_ts / 1000000L; // Convert ns to ms
+    return true;
+  }
+  ast_node_t *ct = cmd->custom_tags_head;
+  for (uint32_t i = 0; i < cmd->num_custom_tags && ct; i++, ct = ct->next) {
+    if (strcmp(ct->tag.custom_key, key) == 0) {
+      *out_val = ct->tag.value->literal;
+      return true;
+    }
+  }
+  return false;
+}
+
+static double _as_double(const ast_literal_node_t *l) {
+  return l->type == AST_LITERAL_FLOAT ? l->float_value
+                                      : (double)l->number_value;
+}
+
+// Numbers compare numerically and strings byte-wise, like index keys.
+// Returns false if the two cannot be compared.
+static bool _cmp_literals(const ast_literal_node_t *a,
+                          const ast_literal_node_t *b, int *out) {
+  bool a_str = a->type == AST_LITERAL_STRING;
+  bool b_str = b->type == AST_LITERAL_STRING;
+  if (a_str != b_str) {
+    return false;
+  }
+  if (a_str) {
+    *out = strcmp(a->string_value, b->string_value);
+  } else if (a->type == AST_LITERAL_NUMBER && b->type == AST_LITERAL_NUMBER) {
+    *out = (a->number_value > b->number_value) -
+           (a->number_value < b->number_value);
+  } else {
+    double da = _as_double(a);
+    double db = _as_double(b);
+    *out = (da > db) - (da < db);
+  }
+  return true;
+}
+
+// Whether an index of `type` holds `v`, as the writer decides
+static bool _index_holds(index_type_t type, const ast_literal_node_t *v) {
+  if (type == INDEX_TYPE_BSI) {
+    uint64_t value;
+    return index_bsi_value(v, &value);
+  }
+  db_key_t key;
+  if (!index_key_from_literal(type, v, &key)) {
+    return false;
+  }
+  if (key.type == DB_KEY_STRING) {
+    free(key.key.s);
+  }
+  return true;
+}
+
+// Integer indexes round decimal bounds like `_bound_from_literal` in
+// eng_eval.c. Returns 1 or 0 if the comparison is decided without the value,
+// -1 otherwise
+static int _round_bound(ast_comparison_op_t op, ast_literal_node_t *bound) {
+  double f = bound->float_value;
+  if (floor(f) != f && (op == AST_OP_EQ || op == AST_OP_NEQ)) {
+    // A decimal never equals an integer key
+    return op == AST_OP_NEQ;
+  }
+  double r = op == AST_OP_GT || op == AST_OP_LTE ? floor(f) : ceil(f);
+  if (r >= 9.2e18) {
+    return 0;
+  }
+  bound->type = AST_LITERAL_NUMBER;
+  bound->number_value = (int64_t)r;
+  return -1;
+}
+
+static bool _compare(ast_comparison_node_t *comp, cmd_ctx_t *cmd,
+                     kh_key_index_t *key_to_index) {
+  ast_node_t *key, *val;
+  if (comp->left->literal.type == AST_LITERAL_STRING) {
+    key = comp->left;
+    val = comp->right;
+  } else {
+    key = comp->right;
+    val = comp->left;
+  }
+
+  ast_literal_node_t v;
+  ast_literal_node_t bound = val->literal;
+  if (!_resolve_val(key->literal.string_value, cmd, &v)) {
+    return false;
+  }
+  index_t index;
+  if (key_to_index &&
+      index_get(key->literal.string_value, key_to_index, &index)) {
+    // Values the index does not hold never match a query reading it
+    index_type_t type = index.index_def.type;
+    if (!_index_holds(type, &v)) {
+      return false;
+    }
+    if ((type == INDEX_TYPE_I64 || type == INDEX_TYPE_BSI) &&
+        bound.type == AST_LITERAL_FLOAT) {
+      int decided = _round_bound(comp->op, &bound);
+      if (decided >= 0) {
+        return decided;
+      }
+    }
+  }
+  int c = 0;
+  if (!_cmp_literals(&v, &bound, &c)) {
+    return false;
+  }
+  // Applied as `key op value` whichever side the key is on, like queries
+  switch (comp->op) {
+  case AST_OP_GT:
+    return c > 0;
+  case AST_OP_GTE:
+    return c >= 0;
+  case AST_OP_LT:
+    return c < 0;
+  case AST_OP_LTE:
+    return c <= 0;
+  case AST_OP_EQ:
+    return c == 0;
+  case AST_OP_NEQ:
+    return c != 0;
+  case AST_OP_CONTAINS:
+    // Both are strings, see the validator
+    return strstr(v.string_value, val->literal.string_value) != NULL;
+  }
+  return false;
+}
+
+bool view_matches(ast_node_t *where, cmd_ctx_t *cmd,
+                  kh_key_index_t *key_to_index) {
+  if (!where || !cmd) {
+    return false;
+  }
+  switch (where->type) {
+  case AST_TAG_NODE:
+    return _has_tag(where, cmd);
+  case AST_COMPARISON_NODE:
+    return _compare(&where->comparison, cmd, key_to_index);
+  case AST_LOGICAL_NODE:
+    if (where->logical.op == AST_LOGIC_NODE_AND) {
+      return view_matches(where->logical.left_operand, cmd, key_to_index) &&
+             view_matches(where->logical.right_operand, cmd, key_to_index);
+    }
+    return view_matches(where->logical.left_operand, cmd, key_to_index) ||
+           view_matches(where->logical.right_operand, cmd, key_to_index);
+  case AST_NOT_NODE:
+    return !view_matches(where->not_op.operand, cmd, key_to_index);
+  default:
+    return false;
+  }
+}
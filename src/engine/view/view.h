@@ -0,0 +1,68 @@
+#ifndef VIEW_H
+#define VIEW_H
+
+/**
+Materialized views.
+A view is a named `where` expression over a container. Its result is kept in
+the inverted event index under `view|<name>`: workers match each new event
+against the container's views and emit an ADD op for every match, so reading
+a view is a single bitmap lookup. Definitions live in the container metadata
+db under the same key. */
+
+#include "core/db.h"
+#include "engine/cmd_context/cmd_context.h"
+#include "engine/index/index.h"
+#include "lmdb.h"
+#include "query/ast.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct view_s {
+  char *name;
+  ast_node_t *where;
+} view_t;
+
+// Immutable once published. A replaced set stays reachable through `prev`
+// until the container closes, so readers never see it freed.
+typedef struct view_set_s {
+  uint32_t count;
+  view_t *views;
+  struct view_set_s *prev;
+} view_set_t;
+
+// Serialize a `where` expression. Caller frees `*data_out`
+bool view_encode_exp(ast_node_t *exp, char **data_out, size_t *size_out);
+
+// Deserialize a `where` expression. Returns NULL on malformed input
+ast_node_t *view_decode_exp(const char *data, size_t size);
+
+/**
+ * Persist a view definition (encoded with `view_encode_exp`) in `dbi`.
+ * Returns DB_PUT_KEY_EXISTS if a view with `name` already exists
+ */
+db_put_result_t view_add(const char *name, const char *exp_data,
+                         size_t exp_size, MDB_env *env, MDB_dbi dbi);
+
+// Load all view definitions from `dbi`
+bool view_open_registry(MDB_env *env, MDB_dbi dbi,
+                        _Atomic(view_set_t *) *views_out);
+
+// Publish a set holding the current views plus a new one. Thread-safe
+bool view_publish(_Atomic(view_set_t *) *views, const char *name,
+                  const char *exp_data, size_t exp_size);
+
+// Returns NULL if there is no view named `name`
+const view_t *view_find(const view_set_t *set, const char *name);
+
+// Free all published sets. No readers may be active
+void view_close_registry(_Atomic(view_set_t *) *views);
+
+// Whether the event in `cmd` satisfies `where`, evaluated on its own tags.
+// Comparisons on a key indexed in `key_to_index` follow the index, as a query
+// reading it does. Without `key_to_index` values are compared directly
+bool view_matches(ast_node_t *where, cmd_ctx_t *cmd,
+                  kh_key_index_t *key_to_index);
+
+#endif // VIEW_H
@@ -0,0 +1,349 @@
+#include "watermark.h"
+#include "core/deadline.h"
+#include "core/lock_striped_ht.h"
+#include "uv.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Waiters are signalled as counters move. They still wake up this often to
+// see a cancelled deadline
+#define WATERMARK_RECHECK_NS (10 * 1000000ULL)
+
+struct wm_container_s {
+  char *name;
+  uv_mutex_t lock;
+  uint32_t next_event_id; // guarded by `lock`
+  // Last event id per cmd queue
+  atomic_uint_fast32_t *enqueued;
+  atomic_uint_fast32_t *processed;
+  // Ops and writes of the container's events.
+  // [worker * num_op_queues + op queue]
+  atomic_uint_fast64_t *ops_sent;
+  atomic_uint_fast64_t *ops_applied;
+  // [worker]
+  atomic_uint_fast64_t *writes_sent;
+  atomic_uint_fast64_t *writes_committed;
+
+  // Waiters sleep on `cond`. Counters only take `wait_lock` to signal while
+  // `waiters` is set
+  uv_mutex_t wait_lock;
+  uv_cond_t cond;
+  atomic_int waiters;
+};
+
+static struct {
+  bool initialized;
+  lock_striped_ht_t containers;
+  uint32_t num_cmd_queues;
+  uint32_t num_workers;
+  uint32_t num_op_queues;
+} g_wm = {0};
+
+static void _free_counters(wm_container_t *c) {
+  free(c->enqueued);
+  free(c->processed);
+  free(c->ops_sent);
+  free(c->ops_applied);
+  free(c->writes_sent);
+  free(c->writes_committed);
+  free(c->name);
+}
+
+static void _container_free(wm_container_t *c) {
+  if (!c) {
+    return;
+  }
+  uv_mutex_destroy(&c->lock);
+  uv_mutex_destroy(&c->wait_lock);
+  uv_cond_destroy(&c->cond);
+  _free_counters(c);
+  free(c);
+}
+
+static void _container_free_cb(void *key, void *value, void *ctx) {
+  (void)key;
+  (void)ctx;
+  // `key` is the container's `name`
+  _container_free(value);
+}
+
+bool watermark_init(uint32_t num_cmd_queues, uint32_t num_workers,
+                    uint32_t num_op_queues) {
+  if (g_wm.initialized || !num_cmd_queues || !num_workers || !num_op_queues) {
+    return false;
+  }
+  if (!lock_striped_ht_init_string(&g_wm.containers)) {
+    return false;
+  }
+  g_wm.num_cmd_queues = num_cmd_queues;
+  g_wm.num_workers = num_workers;
+  g_wm.num_op_queues = num_op_queues;
+  g_wm.initialized = true;
+  return true;
+}
+
+void watermark_destroy(void) {
+  if (!g_wm.initialized) {
+    return;
+  }
+  lock_striped_ht_iterate(&g_wm.containers, _container_free_cb, NULL);
+  lock_striped_ht_destroy(&g_wm.containers);
+  g_wm.initialized = false;
+}
+
+wm_container_t *watermark_find(const char *container_name) {
+  wm_container_t *c = NULL;
+  if (!g_wm.initialized || !container_name ||
+      !lock_striped_ht_get_string(&g_wm.containers, container_name,
+                                  (void **)&c)) {
+    return NULL;
+  }
+  return c;
+}
+
+const char *watermark_container_name(const wm_container_t *c) {
+  return c ? c->name : NULL;
+}
+
+wm_container_t *watermark_add(const char *container_name,
+                              uint32_t next_event_id) {
+  if (!g_wm.initialized || !container_name) {
+    return NULL;
+  }
+  wm_container_t *c = calloc(1, sizeof(wm_container_t));
+  if (!c) {
+    return NULL;
+  }
+  size_t num_ops = (size_t)g_wm.num_workers * g_wm.num_op_queues;
+  c->name = strdup(container_name);
+  // calloc'd zeroes are valid atomics
+  c->enqueued = calloc(g_wm.num_cmd_queues, sizeof(atomic_uint_fast32_t));
+  c->processed = calloc(g_wm.num_cmd_queues, sizeof(atomic_uint_fast32_t));
+  c->ops_sent = calloc(num_ops, sizeof(atomic_uint_fast64_t));
+  c->ops_applied = calloc(num_ops, sizeof(atomic_uint_fast64_t));
+  c->writes_sent = calloc(g_wm.num_workers, sizeof(atomic_uint_fast64_t));
+  c->writes_committed =
+      calloc(g_wm.num_workers, sizeof(atomic_uint_fast64_t));
+  if (!c->name || !c->enqueued || !c->processed || !c->ops_sent ||
+      !c->ops_applied || !c->writes_sent || !c->writes_committed) {
+    _free_counters(c);
+    free(c);
+    return NULL;
+  }
+  if (uv_mutex_init(&c->lock) != 0) {
+    _free_counters(c);
+    free(c);
+    return NULL;
+  }
+  if (uv_mutex_init(&c->wait_lock) != 0) {
+    uv_mutex_destroy(&c->lock);
+    _free_counters(c);
+    free(c);
+    return NULL;
+  }
+  if (uv_cond_init(&c->cond) != 0) {
+    uv_mutex_destroy(&c->wait_lock);
+    uv_mutex_destroy(&c->lock);
+    _free_counters(c);
+    free(c);
+    return NULL;
+  }
+  c->next_event_id = next_event_id;
+
+  if (lock_striped_ht_put_string(&g_wm.containers, c->name, c)) {
+    return c;
+  }
+  // Race condition - someone else inserted, use theirs
+  _container_free(c);
+  return watermark_find(container_name);
+}
+
+uint32_t watermark_assign_begin(wm_container_t *c) {
+  uv_mutex_lock(&c->lock);
+  return c->next_event_id++;
+}
+
+void watermark_assign_end(wm_container_t *c, uint32_t cmd_queue,
+                          uint32_t event_id, bool queued) {
+  if (queued) {
+    atomic_store_explicit(&c->enqueued[cmd_queue], event_id,
+                          memory_order_release);
+  } else {
+    // Still the last one assigned, since the lock is held
+    c->next_event_id = event_id;
+  }
+  uv_mutex_unlock(&c->lock);
+}
+
+// Wakes the waiters of `c` after a counter they check moved
+static void _notify(wm_container_t *c) {
+  // Pairs with the fence in `_wait`: either the waiter sees the counter, or
+  // this sees the waiter
+  atomic_thread_fence(memory_order_seq_cst);
+  if (atomic_load_explicit(&c->waiters, memory_order_relaxed) > 0) {
+    uv_mutex_lock(&c->wait_lock);
+    uv_cond_broadcast(&c->cond);
+    uv_mutex_unlock(&c->wait_lock);
+  }
+}
+
+void watermark_processed(wm_container_t *c, uint32_t cmd_queue,
+                         uint32_t event_id) {
+  if (!c || cmd_queue >= g_wm.num_cmd_queues) {
+    return;
+  }
+  atomic_store_explicit(&c->processed[cmd_queue], event_id,
+                        memory_order_release);
+  _notify(c);
+}
+
+static atomic_uint_fast64_t *_op_counter(wm_container_t *c,
+                                         atomic_uint_fast64_t *counters,
+                                         int32_t worker_id, uint32_t op_queue) {
+  if (!c || worker_id < 0 || (uint32_t)worker_id >= g_wm.num_workers ||
+      op_queue >= g_wm.num_op_queues) {
+    return NULL;
+  }
+  return &counters[(size_t)worker_id * g_wm.num_op_queues + op_queue];
+}
+
+static atomic_uint_fast64_t *_write_counter(wm_container_t *c,
+                                            atomic_uint_fast64_t *counters,
+                                            int32_t worker_id) {
+  if (!c || worker_id < 0 || (uint32_t)worker_id >= g_wm.num_workers) {
+    return NULL;
+  }
+  return &counters[worker_id];
+}
+
+static bool _bump(atomic_uint_fast64_t *counter) {
+  if (!counter) {
+    return false;
+  }
+  atomic_fetch_add_explicit(counter, 1, memory_order_release);
+  return true;
+}
+
+void watermark_op_sent(wm_container_t *c, int32_t worker_id,
+                       uint32_t op_queue) {
+  _bump(c ? _op_counter(c, c->ops_sent, worker_id, op_queue) : NULL);
+}
+
+void watermark_op_applied(wm_container_t *c, int32_t worker_id,
+                          uint32_t op_queue) {
+  if (c && _bump(_op_counter(c, c->ops_applied, worker_id, op_queue))) {
+    _notify(c);
+  }
+}
+
+void watermark_write_sent(wm_container_t *c, int32_t worker_id) {
+  _bump(c ? _write_counter(c, c->writes_sent, worker_id) : NULL);
+}
+
+void watermark_write_committed(wm_container_t *c, int32_t worker_id) {
+  if (c && _bump(_write_counter(c, c->writes_committed, worker_id))) {
+    _notify(c);
+  }
+}
+
+static bool _workers_done(wm_container_t *c, uint32_t event_id,
+                          const uint32_t *enqueued) {
+  for (uint32_t q = 0; q < g_wm.num_cmd_queues; q++) {
+    // A cmd queue holds events in id order, later ones are not waited for
+    uint32_t target = enqueued[q] < event_id ? enqueued[q] : event_id;
+    if (atomic_load_explicit(&c->processed[q], memory_order_acquire) <
+        target) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool _reached(atomic_uint_fast64_t *done, const uint64_t *sent,
+                     size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    if (atomic_load_explicit(&done[i], memory_order_acquire) < sent[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void _snapshot(atomic_uint_fast64_t *counters, uint64_t *out,
+                      size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    out[i] = atomic_load_explicit(&counters[i], memory_order_acquire);
+  }
+}
+
+watermark_wait_result_t watermark_wait(const char *container_name,
+                                       uint32_t event_id,
+                                       const deadline_t *deadline) {
+  wm_container_t *c = watermark_find(container_name);
+  if (!c) {
+    // Nothing was queued since startup
+    return WATERMARK_REACHED;
+  }
+
+  uint32_t enqueued[g_wm.num_cmd_queues];
+  // Ids are queued while the lock is held, so this sees every id below next
+  uv_mutex_lock(&c->lock);
+  uint32_t next = c->next_event_id;
+  for (uint32_t q = 0; q < g_wm.num_cmd_queues; q++) {
+    enqueued[q] = atomic_load_explicit(&c->enqueued[q], memory_order_acquire);
+  }
+  uv_mutex_unlock(&c->lock);
+  if (event_id >= next) {
+    return WATERMARK_AHEAD;
+  }
+
+  size_t num_ops = (size_t)g_wm.num_workers * g_wm.num_op_queues;
+  uint64_t ops_sent[num_ops];
+  uint64_t writes_sent[g_wm.num_workers];
+  bool workers_done = false;
+  watermark_wait_result_t result = WATERMARK_REACHED;
+
+  uv_mutex_lock(&c->wait_lock);
+  atomic_fetch_add_explicit(&c->waiters, 1, memory_order_relaxed);
+  // Pairs with the fence in `_notify`
+  atomic_thread_fence(memory_order_seq_cst);
+  while (true) {
+    if (!workers_done && _workers_done(c, event_id, enqueued)) {
+      // Everything sent so far covers the events, later sends only add to it
+      _snapshot(c->ops_sent, ops_sent, num_ops);
+      _snapshot(c->writes_sent, writes_sent, g_wm.num_workers);
+      workers_done = true;
+    }
+    if (workers_done && _reached(c->ops_applied, ops_sent, num_ops) &&
+        _reached(c->writes_committed, writes_sent, g_wm.num_workers)) {
+      break;
+    }
+    if (deadline_status(deadline) != DEADLINE_OK) {
+      result = WATERMARK_DEADLINE;
+      break;
+    }
+    uv_cond_timedwait(&c->cond, &c->wait_lock, WATERMARK_RECHECK_NS);
+  }
+  atomic_fetch_sub_explicit(&c->waiters, 1, memory_order_relaxed);
+  uv_mutex_unlock(&c->wait_lock);
+  return result;
+}
+
+watermark_wait_result_t watermark_wait_queued(const char *container_name,
+                                              const deadline_t *deadline) {
+  wm_container_t *c = watermark_find(container_name);
+  if (!c) {
+    // Nothing was queued since startup
+    return WATERMARK_REACHED;
+  }
+  uv_mutex_lock(&c->lock);
+  uint32_t next = c->next_event_id;
+  uv_mutex_unlock(&c->lock);
+  if (next == 0) {
+    return WATERMARK_REACHED;
+  }
+  return watermark_wait(container_name, next - 1, deadline);
+}
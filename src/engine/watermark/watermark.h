@@ -0,0 +1,96 @@
+#ifndef WATERMARK_H
+#define WATERMARK_H
+
+/**
+Read-your-writes watermarks for `after:` queries.
+An event gets its id as it is queued, under a lock of its container, so each
+cmd queue holds a container's events in id order. Every stage after that
+records how far it got, and the FIFO order of the queues turns those records
+into watermarks:
+- cmd queues: per container and queue, the last event id queued and the last
+  one a worker is done with
+- op queues and the writer queue: per container and worker, the ops and writes
+  it sent for the container's events, and how many of them consumers applied
+  and the writer committed
+Once workers are done with every event up to a watermark, the ops and writes
+sent until then cover those events, so waiting until they are applied is
+enough. Ops and writes that are not from a worker are not counted. Waiters
+sleep until a counter of their container moves. */
+
+#include "core/deadline.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// `worker_id` of ops and writes that are not from a worker
+#define WATERMARK_NO_WORKER -1
+
+typedef struct wm_container_s wm_container_t;
+
+typedef enum {
+  WATERMARK_REACHED,
+  // No such event was queued yet
+  WATERMARK_AHEAD,
+  // See `deadline_status`
+  WATERMARK_DEADLINE
+} watermark_wait_result_t;
+
+bool watermark_init(uint32_t num_cmd_queues, uint32_t num_workers,
+                    uint32_t num_op_queues);
+
+// Call once workers, consumers and the writer are stopped
+void watermark_destroy(void);
+
+// Ids of `container_name`, NULL if none were assigned since startup
+wm_container_t *watermark_find(const char *container_name);
+
+// Lives until `watermark_destroy`
+const char *watermark_container_name(const wm_container_t *c);
+
+// Adds `container_name`, its next event id being `next_event_id`. Returns the
+// one added meanwhile if another thread was first
+wm_container_t *watermark_add(const char *container_name,
+                              uint32_t next_event_id);
+
+/**
+ * @brief Assigns the next event id of `c` and holds its lock.
+ *
+ * Queue the event, then call `watermark_assign_end` with the outcome. A
+ * failed one gives its id back.
+ */
+uint32_t watermark_assign_begin(wm_container_t *c);
+void watermark_assign_end(wm_container_t *c, uint32_t cmd_queue,
+                          uint32_t event_id, bool queued);
+
+// A worker is done with `event_id` of `cmd_queue`, whether it succeeded or
+// not. Its ops and writes must be sent first
+void watermark_processed(wm_container_t *c, uint32_t cmd_queue,
+                         uint32_t event_id);
+
+// Ops and writes of an event of `c`. A NULL `c` is not counted
+void watermark_op_sent(wm_container_t *c, int32_t worker_id,
+                       uint32_t op_queue);
+void watermark_op_applied(wm_container_t *c, int32_t worker_id,
+                          uint32_t op_queue);
+void watermark_write_sent(wm_container_t *c, int32_t worker_id);
+void watermark_write_committed(wm_container_t *c, int32_t worker_id);
+
+/**
+ * @brief Waits until events of `container_name` up to `event_id` are applied
+ * to the consumer caches and committed by the writer.
+ */
+watermark_wait_result_t watermark_wait(const char *container_name,
+                                       uint32_t event_id,
+                                       const deadline_t *deadline);
+
+/**
+ * @brief Waits until every event of `container_name` queued so far is applied
+ * to the consumer caches and committed by the writer.
+ *
+ * A barrier for state workers read as they process events: once it is
+ * published, events processed with the old state are all queued before the
+ * call.
+ */
+watermark_wait_result_t watermark_wait_queued(const char *container_name,
+                                              const deadline_t *deadline);
+
+#endif // WATERMARK_H
@@ -78,6 +78,8 @@ bool encode_event(cmd_ctx_t *cmd_ctx, uint32_t event_id, char **data_out,
         mpack_write_cstr(&writer, node->tag.value->literal.string_value);
       } else if (node->tag.value->literal.type == AST_LITERAL_NUMBER) {
         mpack_write_i64(&writer, node->tag.value->literal.number_value);
+      } else if (node->tag.value->literal.type == AST_LITERAL_FLOAT) {
+        mpack_write_double(&writer, node->tag.value->literal.float_value);
       } else {
         mpack_write_nil(&writer);
       }
@@ -1,7 +1,6 @@
 #include "worker.h"
 #include "core/data_constants.h"
 #include "core/db.h"
-#include "core/lock_striped_ht.h"
 #include "core/mmap_array.h"
 #include "engine/cmd_queue/cmd_queue.h"
 #include "engine/cmd_queue/cmd_queue_msg.h"
@@ -12,6 +11,7 @@
 #include "engine/op_queue/op_queue.h"
 #include "engine/op_queue/op_queue_msg.h"
 #include "engine/routing/routing.h"
+#include "engine/watermark/watermark.h"
 #include "engine/worker/worker_ops.h"
 #include "engine/worker/worker_writer.h"
 #include "lmdb.h"
@@ -34,8 +34,6 @@ LOG_INIT(worker);
 atomic_uint_fast32_t g_next_entity_id =
     ATOMIC_VAR_INIT(SYS_NEXT_ENT_ID_INIT_VAL);
 
-lock_striped_ht_t g_next_event_id_by_container;
-
 static uint32_t _get_next_entity_id() {
   return atomic_fetch_add(&g_next_entity_id, 1);
 }
@@ -114,10 +112,14 @@ static bool _get_entity_mapping(worker_t *worker, eng_container_t **sys_c_ptr,
     db_key.key.i64 = ent_node->number_value;
   }
 
-  if (!db_get((*sys_c_ptr)->data.sys->sys_dc_metadata_db, *sys_txn_ptr, &db_key,
-              &r)) {
+  // Same dbs the writer persists new mappings to (see worker_writer.c)
+  MDB_dbi ent_db = ent_is_str ? (*sys_c_ptr)->data.sys->str_to_entity_id_db
+                              : (*sys_c_ptr)->data.sys->int_to_entity_id_db;
+  if (!db_get(ent_db, *sys_txn_ptr, &db_key, &r)) {
     LOG_ENT_ERROR(ACT_DB_READ_FAILED, ent_node,
-                  "context=entity_metadata db=sys_dc_metadata");
+                  "context=entity_metadata db=%s",
+                  ent_is_str ? SYS_DB_STR_TO_ENTITY_NAME
+                             : SYS_DB_INT_TO_ENTITY_NAME);
     return false;
   }
 
@@ -223,88 +225,6 @@ static bool _get_user_dc(worker_t *worker, const char *container_name,
   return true;
 }
 
-static bool _get_next_event_id_for_container(worker_user_dc_t *user_dc,
-                                             const char *container_name,
-                                             uint32_t *event_id_out) {
-  atomic_uint_fast32_t *next_event_id = NULL;
-
-  // Check cache first
-  if (lock_striped_ht_get_string(&g_next_event_id_by_container, container_name,
-                                 (void **)&next_event_id)) {
-    *event_id_out = atomic_fetch_add(next_event_id, 1);
-    LOG_ACTION_DEBUG(ACT_CACHE_HIT,
-                     "context=\"event_id\" container=\"%s\" event_id=%u",
-                     container_name, *event_id_out);
-    return true;
-  }
-
-  LOG_ACTION_DEBUG(ACT_CACHE_MISS,
-                   "context=get_next_event_id_for_container container=\"%s\"",
-                   container_name);
-
-  // Cache miss - need to load from DB
-  MDB_dbi db = user_dc->dc->data.usr->user_dc_metadata_db;
-
-  db_get_result_t r = {0};
-  db_key_t db_key;
-  db_key.type = DB_KEY_STRING;
-  db_key.key.s = USR_NEXT_EVENT_ID_KEY;
-
-  if (!db_get(db, user_dc->txn, &db_key, &r)) {
-    LOG_ACTION_ERROR(ACT_DB_READ_FAILED,
-                     "context=\"next_event_id\" container=\"%s\"",
-                     container_name);
-    return false;
-  }
-
-  uint32_t next =
-      r.status == DB_GET_OK ? *(uint32_t *)r.value : USR_NEXT_EVENT_ID_INIT_VAL;
-  db_get_result_clear(&r);
-
-  next_event_id = malloc(sizeof(atomic_uint_fast32_t));
-  if (!next_event_id) {
-    LOG_ACTION_ERROR(ACT_MEMORY_ALLOC_FAILED,
-                     "context=\"event_id_counter\" container=\"%s\"",
-                     container_name);
-    return false;
-  }
-
-  atomic_init(next_event_id, next);
-  LOG_ACTION_INFO(ACT_COUNTER_INIT,
-                  "counter_type=event_id container=\"%s\" value=%u",
-                  container_name, next);
-
-  // duplicate `container_name` since it belongs to msg
-  char *cache_key = strdup(container_name);
-
-  // Try to insert into cache
-  if (lock_striped_ht_put_string(&g_next_event_id_by_container, cache_key,
-                                 next_event_id)) {
-    *event_id_out = atomic_fetch_add(next_event_id, 1);
-    return true;
-  }
-
-  // Race condition - someone else inserted, use theirs
-  LOG_ACTION_DEBUG(ACT_RACE_CONDITION,
-                   "context=\"event_id_insert\" container=\"%s\"",
-                   container_name);
-  free(next_event_id);
-  free(cache_key);
-
-  if (lock_striped_ht_get_string(&g_next_event_id_by_container, container_name,
-                                 (void **)&next_event_id)) {
-    *event_id_out = atomic_fetch_add(next_event_id, 1);
-    return true;
-  }
-
-  // Something went very wrong
-  LOG_ACTION_ERROR(ACT_RACE_CONDITION,
-                   "context=\"event_id_retrieve_after_race\" container=\"%s\" "
-                   "err=\"failed\"",
-                   container_name);
-  return false;
-}
-
 worker_init_result_t worker_init_global(void) {
   container_result_t cr = container_get_system();
   if (!cr.success) {
@@ -338,20 +258,18 @@ worker_init_result_t worker_init_global(void) {
 
   atomic_store(&g_next_entity_id, next_ent_id);
 
-  if (!lock_striped_ht_init_string(&g_next_event_id_by_container)) {
-    return (worker_init_result_t){
-        .success = false, .msg = "Failed to initialize event ID hash table"};
-  }
-
   return (worker_init_result_t){.success = true, .next_ent_id = next_ent_id};
 }
 
-static bool _queue_up_ops(worker_t *worker, worker_ops_t *ops) {
+static bool _queue_up_ops(worker_t *worker, worker_ops_t *ops,
+                          wm_container_t *wm) {
   for (uint32_t i = 0; i < ops->num_ops; i++) {
     op_queue_msg_t *msg = ops->ops[i];
     int queue_idx = route_key_to_queue(msg->ser_db_key,
                                        worker->config.op_queue_total_count);
     op_queue_t *queue = &worker->config.op_queues[queue_idx];
+    msg->worker_id = worker->config.worker_id;
+    msg->wm = wm;
 
     if (!op_queue_enqueue(queue, msg)) {
       LOG_ACTION_ERROR(ACT_MSG_ENQUEUE_FAILED,
@@ -363,6 +281,7 @@ static bool _queue_up_ops(worker_t *worker, worker_ops_t *ops) {
       }
       return false;
     }
+    watermark_op_sent(wm, worker->config.worker_id, queue_idx);
     LOG_ACTION_DEBUG(ACT_MSG_ENQUEUED, "msg_type=op queue_id=%d key=\"%s\"",
                      queue_idx, msg->ser_db_key);
   }
@@ -380,15 +299,19 @@ static bool _write_to_event_ent_map(worker_user_dc_t *user_dc, uint32_t ent_id,
   return true;
 }
 
-static bool _send_to_writer(eng_writer_msg_t *writer_msg, worker_t *worker) {
+static bool _send_to_writer(eng_writer_msg_t *writer_msg, worker_t *worker,
+                            wm_container_t *wm) {
   if (!writer_msg)
     return false;
+  writer_msg->worker_id = worker->config.worker_id;
+  writer_msg->wm = wm;
   if (!eng_writer_queue_enqueue(&worker->config.writer->queue, writer_msg)) {
     LOG_ACTION_ERROR(ACT_FLUSH_FAILED,
                      "context=\"send_to_writer\" entries_prepared=%u",
                      writer_msg->count);
     return false;
   }
+  watermark_write_sent(wm, worker->config.worker_id);
   LOG_ACTION_INFO(ACT_PERF_FLUSH_COMPLETE, "entries_flushed=%u",
                   writer_msg->count);
   return true;
@@ -421,13 +344,7 @@ static bool _process_msg(worker_t *worker, cmd_queue_msg_t *msg,
     return false;
   }
 
-  uint32_t event_id = 0;
-  if (!_get_next_event_id_for_container(user_dc, container_name, &event_id)) {
-    LOG_ENT_ERROR(ACT_EVENT_ID_FAILED, ent_node, "container=\"%s\"",
-                  container_name);
-    return false;
-  }
-
+  uint32_t event_id = msg->event_id;
   if (!_write_to_event_ent_map(user_dc, ent_int_id, event_id)) {
     LOG_ENT_ERROR(ACT_EVENT_ID_FAILED, ent_node, "container=\"%s\"",
                   container_name);
@@ -444,14 +361,19 @@ static bool _process_msg(worker_t *worker, cmd_queue_msg_t *msg,
   }
 
   // TODO: consider batching multiple groups of entries
-  if (!_send_to_writer(writer_msg, worker)) {
+  if (!_send_to_writer(writer_msg, worker, msg->wm)) {
     eng_writer_queue_free_msg(writer_msg);
     return false;
   }
 
   worker_ops_t ops = {0};
+  const view_set_t *views = atomic_load(&user_dc->dc->data.usr->views);
+  kh_key_index_t *key_to_index =
+      atomic_load(&user_dc->dc->data.usr->key_to_index);
+  const rollup_set_t *rollups = atomic_load(&user_dc->dc->data.usr->rollups);
   worker_ops_result_t ops_result =
-      worker_create_ops(msg, container_name, ent_int_id, event_id, &ops);
+      worker_create_ops(msg, container_name, ent_int_id, event_id, views,
+                        key_to_index, rollups, &ops);
 
   if (!ops_result.success) {
     LOG_ENT_ERROR(ACT_OP_CREATE_FAILED, ent_node,
@@ -463,7 +385,7 @@ static bool _process_msg(worker_t *worker, cmd_queue_msg_t *msg,
   LOG_ENT_DEBUG(ACT_OP_CREATED, ent_node, "num_ops=%u event_id=%u", ops.num_ops,
                 event_id);
 
-  bool success = _queue_up_ops(worker, &ops);
+  bool success = _queue_up_ops(worker, &ops, msg->wm);
 
   // ops are now owned by queues if successful, but we still need
   // to free the ops array itself
@@ -491,6 +413,8 @@ static int _do_work(worker_t *worker, eng_container_t **sys_c,
         } else {
           LOG_ACTION_WARN(ACT_MSG_PROCESS_FAILED, "queue_id=%u", cmd_queue_idx);
         }
+        // After its ops and writes are sent, see watermark.h
+        watermark_processed(msg->wm, cmd_queue_idx, msg->event_id);
 
         cmd_queue_free_msg(msg);
         msg = NULL;
@@ -642,26 +566,3 @@ worker_result_t worker_stop(worker_t *worker) {
 
   return (worker_result_t){.success = true};
 }
-
-static void _global_event_id_cleanup_cb(void *key, void *value, void *ctx) {
-  (void)ctx;
-  char *container_name_key = (char *)key;
-  atomic_uint_fast32_t *next_id_val = (atomic_uint_fast32_t *)value;
-
-  if (container_name_key) {
-    free(container_name_key);
-  }
-
-  if (next_id_val) {
-    free(next_id_val);
-  }
-}
-
-void worker_destroy_global(void) {
-  // Note: lock_striped_ht_iterate is not thread-safe,
-  // which is why we must ensure all workers are joined before calling this.
-  lock_striped_ht_iterate(&g_next_event_id_by_container,
-                          _global_event_id_cleanup_cb, NULL);
-
-  lock_striped_ht_destroy(&g_next_event_id_by_container);
-}
\ No newline at end of file
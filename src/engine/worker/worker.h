@@ -26,6 +26,7 @@ typedef struct worker_config_s {
   uint32_t cmd_queue_consume_count; // Number of cmd queues to consume from
   op_queue_t *op_queues;
   uint32_t op_queue_total_count; // Total count of op queues
+  int32_t worker_id;             // Counts its ops and writes, see watermark.h
 } worker_config_t;
 
 typedef struct worker_s {
@@ -49,10 +50,6 @@ typedef struct {
 // Call this before `worker_start` - sets up environment for worker threads
 worker_init_result_t worker_init_global(void);
 
-// Call this AFTER all worker threads have been stopped and joined.
-// It cleans up shared static resources (like the event ID cache).
-void worker_destroy_global(void);
-
 typedef struct {
   bool success;
   const char *msg;
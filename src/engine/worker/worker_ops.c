@@ -1,10 +1,13 @@
 #include "engine/worker/worker_ops.h"
+#include "core/data_constants.h"
 #include "core/db.h"
 #include "engine/cmd_queue/cmd_queue_msg.h"
 #include "engine/container/container_types.h"
 #include "engine/eng_key_format/eng_key_format.h"
+#include "engine/index/index.h"
 #include "engine/op/op.h"
 #include "engine/op_queue/op_queue_msg.h"
+#include "engine/rollup/rollup.h"
 #include "worker_ops.h"
 #include <stdbool.h>
 #include <stddef.h>
@@ -135,22 +138,326 @@ static worker_ops_result_t _create_container_entity_op(char *container_name,
   return WORKER_OPS_SUCCESS();
 }
 
+// Appends `event_id` to the entity's event posting list
+static worker_ops_result_t _create_entity_events_op(char *container_name,
+                                                    uint32_t entity_id_int32,
+                                                    uint32_t event_id,
+                                                    worker_ops_t *ops, int *i) {
+  char ent_key[128];
+  char ser_db_key[512];
+
+  if (!entity_events_key_into(ent_key, sizeof(ent_key), entity_id_int32)) {
+    return WORKER_OPS_ERROR("Key formatting failed", "entity_events_key_into");
+  }
+
+  eng_container_db_key_t db_key;
+  db_key.dc_type = CONTAINER_TYPE_USR;
+  db_key.usr_db_type = USR_DB_INVERTED_EVENT_INDEX;
+  db_key.db_key.type = DB_KEY_STRING;
+
+  db_key.container_name = strdup(container_name);
+  if (!db_key.container_name) {
+    return WORKER_OPS_ERROR("Memory allocation failed", "container_name_dup");
+  }
+
+  db_key.db_key.key.s = strdup(ent_key);
+  if (!db_key.db_key.key.s) {
+    free(db_key.container_name);
+    return WORKER_OPS_ERROR("Memory allocation failed", "db_key_dup");
+  }
+
+  if (!db_key_into(ser_db_key, sizeof(ser_db_key), &db_key)) {
+    free(db_key.container_name);
+    free(db_key.db_key.key.s);
+    return WORKER_OPS_ERROR("Key formatting failed", "db_key_into");
+  }
+
+  op_t *o = op_create(OP_TYPE_ADD, &db_key, event_id);
+  if (!o) {
+    free(db_key.container_name);
+    free(db_key.db_key.key.s);
+    return WORKER_OPS_ERROR("Operation creation failed", "op_create");
+  }
+
+  if (!_append_op(ops, ser_db_key, o, i)) {
+    // op owns the db key contents
+    op_destroy(o);
+    return WORKER_OPS_ERROR("Failed to append operation", "append_op");
+  }
+
+  return WORKER_OPS_SUCCESS();
+}
+
+// Appends `event_id` to the result of each matching view
+static worker_ops_result_t
+_create_view_ops(char *container_name, uint32_t event_id,
+                 const view_t **matched, uint32_t num_matched,
+                 worker_ops_t *ops, int *i) {
+  char view_key[MAX_TEXT_VAL_LEN];
+  char ser_db_key[512];
+
+  for (uint32_t v_i = 0; v_i < num_matched; v_i++) {
+    if (!view_key_into(view_key, sizeof(view_key), matched[v_i]->name)) {
+      return WORKER_OPS_ERROR("Key formatting failed", "view_key_into");
+    }
+
+    eng_container_db_key_t db_key;
+    db_key.dc_type = CONTAINER_TYPE_USR;
+    db_key.usr_db_type = USR_DB_INVERTED_EVENT_INDEX;
+    db_key.db_key.type = DB_KEY_STRING;
+
+    db_key.container_name = strdup(container_name);
+    if (!db_key.container_name) {
+      return WORKER_OPS_ERROR("Memory allocation failed", "container_name_dup");
+    }
+
+    db_key.db_key.key.s = strdup(view_key);
+    if (!db_key.db_key.key.s) {
+      free(db_key.container_name);
+      return WORKER_OPS_ERROR("Memory allocation failed", "db_key_dup");
+    }
+
+    if (!db_key_into(ser_db_key, sizeof(ser_db_key), &db_key)) {
+      free(db_key.container_name);
+      free(db_key.db_key.key.s);
+      return WORKER_OPS_ERROR("Key formatting failed", "db_key_into");
+    }
+
+    op_t *o = op_create(OP_TYPE_ADD, &db_key, event_id);
+    if (!o) {
+      free(db_key.container_name);
+      free(db_key.db_key.key.s);
+      return WORKER_OPS_ERROR("Operation creation failed", "op_create");
+    }
+
+    if (!_append_op(ops, ser_db_key, o, i)) {
+      // op owns the db key contents
+      op_destroy(o);
+      return WORKER_OPS_ERROR("Failed to append operation", "append_op");
+    }
+  }
+
+  return WORKER_OPS_SUCCESS();
+}
+
+// Value of the event for a BSI index on `key`. False if it holds none
+static bool _bsi_value(const char *key, cmd_queue_msg_t *msg,
+                       uint64_t *value_out) {
+  if (strcmp(key, "ts") == 0) {
+    // Convert ns to ms
+    int64_t ts_ms = msg->command->arrival_ts / 1000000L;
+    if (ts_ms < 0) {
+      return false;
+    }
+    *value_out = (uint64_t)ts_ms;
+    return true;
+  }
+  ast_node_t *tag = ast_find_custom_tag(&msg->command->ast->command, key);
+  return tag && index_bsi_value(&tag->tag.value->literal, value_out);
+}
+
+// Number of ops `_create_bsi_ops` appends
+static uint32_t _count_bsi_ops(cmd_queue_msg_t *msg,
+                               kh_key_index_t *key_to_index) {
+  if (!key_to_index) {
+    return 0;
+  }
+  uint32_t count = 0;
+  uint32_t slices[INDEX_BSI_SLICES + 1];
+  const char *idx_key;
+  index_t idx;
+  kh_foreach(key_to_index, idx_key, idx, {
+    uint64_t value;
+    if (idx.index_def.type == INDEX_TYPE_BSI &&
+        _bsi_value(idx_key, msg, &value)) {
+      count += index_bsi_slices(value, slices);
+    }
+  });
+  return count;
+}
+
+// Appends `event_id` to each BSI slice its values belong to. Indexes still
+// being built are written too, like range indexes
+static worker_ops_result_t _create_bsi_ops(char *container_name,
+                                           uint32_t event_id,
+                                           cmd_queue_msg_t *msg,
+                                           kh_key_index_t *key_to_index,
+                                           worker_ops_t *ops, int *i) {
+  if (!key_to_index) {
+    return WORKER_OPS_SUCCESS();
+  }
+  char slice_key[MAX_TEXT_VAL_LEN];
+  char ser_db_key[512];
+  uint32_t slices[INDEX_BSI_SLICES + 1];
+  const char *idx_key;
+  index_t idx;
+
+  kh_foreach(key_to_index, idx_key, idx, {
+    uint64_t value;
+    if (idx.index_def.type != INDEX_TYPE_BSI ||
+        !_bsi_value(idx_key, msg, &value)) {
+      continue;
+    }
+    uint32_t num_slices = index_bsi_slices(value, slices);
+    for (uint32_t s_i = 0; s_i < num_slices; s_i++) {
+      if (!bsi_key_into(slice_key, sizeof(slice_key), idx_key, slices[s_i])) {
+        return WORKER_OPS_ERROR("Key formatting failed", "bsi_key_into");
+      }
+
+      eng_container_db_key_t db_key;
+      db_key.dc_type = CONTAINER_TYPE_USR;
+      db_key.usr_db_type = USR_DB_INVERTED_EVENT_INDEX;
+      db_key.db_key.type = DB_KEY_STRING;
+
+      db_key.container_name = strdup(container_name);
+      if (!db_key.container_name) {
+        return WORKER_OPS_ERROR("Memory allocation failed",
+                                "container_name_dup");
+      }
+
+      db_key.db_key.key.s = strdup(slice_key);
+      if (!db_key.db_key.key.s) {
+        free(db_key.container_name);
+        return WORKER_OPS_ERROR("Memory allocation failed", "db_key_dup");
+      }
+
+      if (!db_key_into(ser_db_key, sizeof(ser_db_key), &db_key)) {
+        free(db_key.container_name);
+        free(db_key.db_key.key.s);
+        return WORKER_OPS_ERROR("Key formatting failed", "db_key_into");
+      }
+
+      op_t *o = op_create(OP_TYPE_ADD, &db_key, event_id);
+      if (!o) {
+        free(db_key.container_name);
+        free(db_key.db_key.key.s);
+        return WORKER_OPS_ERROR("Operation creation failed", "op_create");
+      }
+
+      if (!_append_op(ops, ser_db_key, o, i)) {
+        // op owns the db key contents
+        op_destroy(o);
+        return WORKER_OPS_ERROR("Failed to append operation", "append_op");
+      }
+    }
+  });
+
+  return WORKER_OPS_SUCCESS();
+}
+
+// Number of ops `_create_rollup_ops` appends
+static uint32_t _count_rollup_ops(cmd_queue_msg_t *msg,
+                                  const rollup_set_t *rollups) {
+  if (!rollups) {
+    return 0;
+  }
+  uint32_t count = 0;
+  char row_key[MAX_ROLLUP_ROW_KEY_LEN];
+  for (uint32_t r_i = 0; r_i < rollups->count; r_i++) {
+    if (rollup_row_key_into(row_key, sizeof(row_key), &rollups->rollups[r_i],
+                            msg->command)) {
+      count++;
+    }
+  }
+  return count;
+}
+
+// Counts the event once in the row of each rollup it has all keys of
+static worker_ops_result_t _create_rollup_ops(char *container_name,
+                                              cmd_queue_msg_t *msg,
+                                              const rollup_set_t *rollups,
+                                              worker_ops_t *ops, int *i) {
+  if (!rollups) {
+    return WORKER_OPS_SUCCESS();
+  }
+  char row_key[MAX_ROLLUP_ROW_KEY_LEN];
+  char ser_db_key[512];
+
+  for (uint32_t r_i = 0; r_i < rollups->count; r_i++) {
+    if (!rollup_row_key_into(row_key, sizeof(row_key), &rollups->rollups[r_i],
+                             msg->command)) {
+      continue;
+    }
+
+    eng_container_db_key_t db_key;
+    db_key.dc_type = CONTAINER_TYPE_USR;
+    db_key.usr_db_type = USR_DB_ROLLUP;
+    db_key.db_key.type = DB_KEY_STRING;
+
+    db_key.container_name = strdup(container_name);
+    if (!db_key.container_name) {
+      return WORKER_OPS_ERROR("Memory allocation failed", "container_name_dup");
+    }
+
+    db_key.db_key.key.s = strdup(row_key);
+    if (!db_key.db_key.key.s) {
+      free(db_key.container_name);
+      return WORKER_OPS_ERROR("Memory allocation failed", "db_key_dup");
+    }
+
+    if (!db_key_into(ser_db_key, sizeof(ser_db_key), &db_key)) {
+      free(db_key.container_name);
+      free(db_key.db_key.key.s);
+      return WORKER_OPS_ERROR("Key formatting failed", "db_key_into");
+    }
+
+    op_t *o = op_create(OP_TYPE_INCR, &db_key, 1);
+    if (!o) {
+      free(db_key.container_name);
+      free(db_key.db_key.key.s);
+      return WORKER_OPS_ERROR("Operation creation failed", "op_create");
+    }
+
+    if (!_append_op(ops, ser_db_key, o, i)) {
+      // op owns the db key contents
+      op_destroy(o);
+      return WORKER_OPS_ERROR("Failed to append operation", "append_op");
+    }
+  }
+
+  return WORKER_OPS_SUCCESS();
+}
+
 static worker_ops_result_t
 _create_ops(cmd_queue_msg_t *msg, char *container_name,
             uint32_t entity_id_int32, uint32_t event_id,
-            worker_ops_t *ops_out) {
+            const view_set_t *views, kh_key_index_t *key_to_index,
+            const rollup_set_t *rollups, worker_ops_t *ops_out) {
   worker_ops_result_t result;
   int ops_created = 0;
   uint32_t num_custom_tags = msg->command->num_custom_tags;
 
+  const view_t **matched = NULL;
+  uint32_t num_matched = 0;
+  if (views && views->count > 0) {
+    matched = malloc(views->count * sizeof(view_t *));
+    if (!matched) {
+      return WORKER_OPS_ERROR("Memory allocation failed", "matched_views");
+    }
+    for (uint32_t v_i = 0; v_i < views->count; v_i++) {
+      if (view_matches(views->views[v_i].where, msg->command, key_to_index)) {
+        matched[num_matched++] = &views->views[v_i];
+      }
+    }
+  }
+
   uint32_t num_ops =
       // _create_container_entity_op
       1
+      // _create_entity_events_op
+      + 1
       // _create_write_to_event_index_ops = `num_custom_tags` ops
-      + num_custom_tags;
+      + num_custom_tags
+      // _create_view_ops = one op per matching view
+      + num_matched
+      // _create_bsi_ops = one op per BSI slice the event belongs to
+      + _count_bsi_ops(msg, key_to_index)
+      // _create_rollup_ops = one op per rollup the event counts towards
+      + _count_rollup_ops(msg, rollups);
 
   ops_out->ops = malloc(num_ops * sizeof(op_queue_msg_t *));
   if (!ops_out->ops) {
+    free(matched);
     return WORKER_OPS_ERROR("Memory allocation failed", "ops_array");
   }
   ops_out->num_ops = num_ops;
@@ -160,14 +467,36 @@ _create_ops(cmd_queue_msg_t *msg, char *container_name,
   if (!result.success)
     goto cleanup;
 
+  result = _create_entity_events_op(container_name, entity_id_int32, event_id,
+                                    ops_out, &ops_created);
+  if (!result.success)
+    goto cleanup;
+
   result = _create_write_to_event_index_ops(container_name, event_id, msg,
                                             ops_out, &ops_created);
   if (!result.success)
     goto cleanup;
 
+  result = _create_view_ops(container_name, event_id, matched, num_matched,
+                            ops_out, &ops_created);
+  if (!result.success)
+    goto cleanup;
+
+  result = _create_bsi_ops(container_name, event_id, msg, key_to_index,
+                           ops_out, &ops_created);
+  if (!result.success)
+    goto cleanup;
+
+  result =
+      _create_rollup_ops(container_name, msg, rollups, ops_out, &ops_created);
+  if (!result.success)
+    goto cleanup;
+
+  free(matched);
   return WORKER_OPS_SUCCESS();
 
 cleanup:
+  free(matched);
   if (ops_out->ops) {
     for (int i = 0; i < ops_created; i++) {
       op_queue_msg_free(ops_out->ops[i]);
@@ -183,6 +512,9 @@ worker_ops_result_t worker_create_ops(cmd_queue_msg_t *msg,
                                       char *container_name,
                                       uint32_t entity_id_int32,
                                       uint32_t event_id,
+                                      const view_set_t *views,
+                                      kh_key_index_t *key_to_index,
+                                      const rollup_set_t *rollups,
                                       worker_ops_t *ops_out) {
   if (!msg || !container_name  || !ops_out) {
     return WORKER_OPS_ERROR("Invalid arguments", "worker_create_ops");
@@ -190,6 +522,6 @@ worker_ops_result_t worker_create_ops(cmd_queue_msg_t *msg,
 
   memset(ops_out, 0, sizeof(worker_ops_t));
 
-  return _create_ops(msg, container_name, entity_id_int32,
-                     event_id, ops_out);
+  return _create_ops(msg, container_name, entity_id_int32, event_id, views,
+                     key_to_index, rollups, ops_out);
 }
\ No newline at end of file
@@ -3,6 +3,9 @@
 
 #include "engine/cmd_queue/cmd_queue_msg.h"
 #include "engine/op_queue/op_queue_msg.h"
+#include "engine/index/index.h"
+#include "engine/rollup/rollup.h"
+#include "engine/view/view.h"
 #include <stdint.h>
 
 typedef struct {
@@ -22,10 +25,17 @@ typedef struct worker_ops_s {
   uint32_t num_ops;
 } worker_ops_t;
 
+// `views` (optional) are the container's views, matching ones get the event.
+// `key_to_index` (optional) are its indexes, BSI ones get the event's values.
+// `rollups` (optional) are its rollups, each counts the event once
 worker_ops_result_t worker_create_ops(cmd_queue_msg_t *msg,
                                       char *container_name,
                                       uint32_t entity_id_int32,
-                                      uint32_t event_id, worker_ops_t *ops_out);
+                                      uint32_t event_id,
+                                      const view_set_t *views,
+                                      kh_key_index_t *key_to_index,
+                                      const rollup_set_t *rollups,
+                                      worker_ops_t *ops_out);
 
 // Free ops array
 void worker_ops_clear(worker_ops_t *ops);
@@ -4,6 +4,7 @@
 #include "engine/container/container_types.h"
 #include "engine/engine_writer/engine_writer_queue_msg.h"
 #include "engine/index/index.h"
+#include "engine/subscription/subscription.h"
 #include "engine/worker/encoder.h"
 #include "query/ast.h"
 #include <stdbool.h>
@@ -40,6 +41,8 @@ static bool _create_mpack_entry(cmd_queue_msg_t *cmd_msg, char *container_name,
   entry->value = msgpack;
   entry->value_size = msgpack_size;
   entry->write_condition = WRITE_COND_ALWAYS;
+  // Live subscribers get the event once the writer commits it
+  entry->push = sub_match(container_name, cmd_msg->command);
   return true;
 }
 
@@ -130,46 +133,51 @@ static bool _create_ent_entry(uint32_t ent_id, ast_literal_node_t *ent_node,
   return true;
 }
 
-static bool _idx_resolve_tag_val(const char *key, cmd_queue_msg_t *cmd_msg,
-                                 int64_t *out_val) {
+// Index key for the event's value of `key`. False if the event has no value
+// the index type can hold, e.g. a string for an I64 index.
+static bool _idx_resolve_tag_val(const char *key, index_type_t type,
+                                 cmd_queue_msg_t *cmd_msg, db_key_t *out_key) {
+  ast_literal_node_t ts_val = {.type = AST_LITERAL_NUMBER};
+  ast_literal_node_t *val = NULL;
   if (strcmp(key, "ts") == 0) {
-    *out_val = cmd_msg->command->arrival_ts / 1000000L; // Convert ns to ms
-    return true;
-  }
-
-  ast_node_t *ast_node =
-      ast_find_custom_tag(&cmd_msg->command->ast->command, key);
-
-  // we only support int64 index for now
-  if (ast_node && ast_node->tag.value->literal.type == AST_LITERAL_NUMBER) {
-    *out_val = ast_node->tag.value->literal.number_value;
-    return true;
+    // Convert ns to ms
+    ts_val.number_value = cmd_msg->command->arrival_ts / 1000000L;
+    val = &ts_val;
+  } else {
+    ast_node_t *ast_node =
+        ast_find_custom_tag(&cmd_msg->command->ast->command, key);
+    if (!ast_node) {
+      return false;
+    }
+    val = &ast_node->tag.value->literal;
   }
-
-  return false;
+  return index_key_from_literal(type, val, out_key);
 }
 
 static bool _create_index_entries(uint32_t event_id, cmd_queue_msg_t *cmd_msg,
                                   char *container_name,
-                                  eng_container_t *user_dc,
+                                  kh_key_index_t *key_to_index,
                                   eng_writer_msg_t *msg) {
   const char *idx_key;
   index_t idx_info;
   eng_container_db_key_t db_key = {0};
 
-  kh_foreach(user_dc->data.usr->key_to_index, idx_key, idx_info, {
-    int64_t val = 0;
-
-    if (_idx_resolve_tag_val(idx_key, cmd_msg, &val)) {
+  // Indexes still being built are written too, so backfills see no gap.
+  // BSI indexes have no index db, see `worker_create_ops`
+  kh_foreach(key_to_index, idx_key, idx_info, {
+    if (idx_info.index_def.type != INDEX_TYPE_BSI &&
+        _idx_resolve_tag_val(idx_key, idx_info.index_def.type, cmd_msg,
+                             &db_key.db_key)) {
       db_key.dc_type = CONTAINER_TYPE_USR;
       db_key.container_name = strdup(container_name);
       if (!db_key.container_name) {
+        if (db_key.db_key.type == DB_KEY_STRING) {
+          free(db_key.db_key.key.s);
+        }
         return false;
       }
       db_key.index_key = strdup(idx_key);
       db_key.usr_db_type = USR_DB_INDEX;
-      db_key.db_key.type = DB_KEY_I64;
-      db_key.db_key.key.i64 = val;
       uint32_t i = msg->count++;
       eng_writer_entry_t *entry = &msg->entries[i];
       entry->db_key = db_key;
@@ -194,8 +202,10 @@ eng_writer_msg_t *worker_create_writer_msg(cmd_queue_msg_t *cmd_msg,
   if (!msg) {
     return NULL;
   }
+  // One snapshot, an index published meanwhile is picked up by its backfill
+  kh_key_index_t *key_to_index = atomic_load(&user_dc->data.usr->key_to_index);
   uint32_t index_count = 0;
-  index_get_count(user_dc->data.usr->key_to_index, &index_count);
+  index_get_count(key_to_index, &index_count);
 
   // Greedy: At most 4 entries (sys entity counter, usr event counter, event
   // data, entity external id -> int) + num indexes
@@ -220,7 +230,8 @@ eng_writer_msg_t *worker_create_writer_msg(cmd_queue_msg_t *cmd_msg,
   }
 
   if (index_count > 0 &&
-      !_create_index_entries(event_id, cmd_msg, container_name, user_dc, msg)) {
+      !_create_index_entries(event_id, cmd_msg, container_name, key_to_index,
+                             msg)) {
     eng_writer_queue_free_msg(msg);
     return NULL;
   }
@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 void serializer_encode(const enum serializer_resp_status status,
                        const char *raw_data, const size_t raw_data_size,
@@ -117,6 +118,112 @@ static void _encode_list_u32(const api_response_t *api_resp,
   free(data);
 }
 
+static void _encode_histogram(const api_response_t *api_resp,
+                              serializer_result_t *sr) {
+  char *data = NULL;
+  size_t data_size = 0;
+
+  const api_response_type_histogram_t *h = &api_resp->payload.histogram;
+
+  mpack_writer_t writer;
+  mpack_writer_init_growable(&writer, &data, &data_size);
+  mpack_start_map(&writer, 3);
+  mpack_write_cstr(&writer, "from");
+  mpack_write_i64(&writer, h->from);
+  mpack_write_cstr(&writer, "bucket_ms");
+  mpack_write_u64(&writer, h->bucket_ms);
+  mpack_write_cstr(&writer, "counts");
+  mpack_start_array(&writer, h->count);
+  for (uint32_t i = 0; i < h->count; i++) {
+    mpack_write_u64(&writer, h->counts[i]);
+  }
+  mpack_finish_array(&writer);
+  mpack_finish_map(&writer);
+
+  if (mpack_writer_destroy(&writer) != mpack_ok) {
+    fprintf(stderr, "_encode_histogram: Serializer error\n");
+    sr->response = NULL;
+    sr->response_size = 0;
+    sr->success = false;
+  } else {
+    serializer_encode(SER_RESP_OK, data, data_size, sr);
+  }
+
+  free(data);
+}
+
+static void _encode_id_set(const api_response_t *api_resp,
+                           serializer_result_t *sr) {
+  char *data = NULL;
+  size_t data_size = 0;
+
+  const api_response_type_id_set_t *set = &api_resp->payload.id_set;
+
+  mpack_writer_t writer;
+  mpack_writer_init_growable(&writer, &data, &data_size);
+  mpack_start_map(&writer,
+                  2 + (set->next_cursor ? 1 : 0) + (set->session ? 1 : 0));
+  if (set->next_cursor) {
+    mpack_write_cstr(&writer, "next_cursor");
+    mpack_write_u32(&writer, set->next_cursor);
+  }
+  if (set->session) {
+    mpack_write_cstr(&writer, "session");
+    mpack_write_u64(&writer, set->session);
+  }
+  mpack_write_cstr(&writer, "count");
+  mpack_write_u64(&writer, set->count);
+  // Portable roaring format, readable by any roaring library
+  mpack_write_cstr(&writer, "ids");
+  mpack_write_bin(&writer, set->bitmap, (uint32_t)set->bitmap_size);
+  mpack_finish_map(&writer);
+
+  if (mpack_writer_destroy(&writer) != mpack_ok) {
+    fprintf(stderr, "_encode_id_set: Serializer error\n");
+    sr->response = NULL;
+    sr->response_size = 0;
+    sr->success = false;
+  } else {
+    serializer_encode(SER_RESP_OK, data, data_size, sr);
+  }
+
+  free(data);
+}
+
+static void _encode_watermark(const api_response_t *api_resp,
+                              serializer_result_t *sr) {
+  char *data = NULL;
+  size_t data_size = 0;
+
+  const api_response_type_watermark_t *wm = &api_resp->payload.watermark;
+
+  mpack_writer_t writer;
+  mpack_writer_init_growable(&writer, &data, &data_size);
+  mpack_start_map(&writer, 2);
+  mpack_write_cstr(&writer, "in");
+  mpack_write_cstr(&writer, wm->container_name);
+  mpack_write_cstr(&writer, "event_id");
+  mpack_write_u32(&writer, wm->event_id);
+  mpack_finish_map(&writer);
+
+  if (mpack_writer_destroy(&writer) != mpack_ok) {
+    fprintf(stderr, "_encode_watermark: Serializer error\n");
+    sr->response = NULL;
+    sr->response_size = 0;
+    sr->success = false;
+  } else {
+    serializer_encode(SER_RESP_OK, data, data_size, sr);
+  }
+
+  free(data);
+}
+
+static uint64_t _now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
 static void _encode_list_obj(const api_response_t *api_resp,
                              serializer_result_t *sr) {
   // Initialize to NULL/0 so mpack allocates memory
@@ -127,11 +234,50 @@ static void _encode_list_obj(const api_response_t *api_resp,
 
   mpack_writer_t writer;
   mpack_writer_init_growable(&writer, &data, &data_size);
-  mpack_start_map(&writer, list->next_cursor ? 2 : 1);
+  uint32_t map_size = 1;
+  map_size += list->next_cursor ? 1 : 0;
+  map_size += list->session ? 1 : 0;
+  map_size += list->sampled ? 2 : 0;
+  map_size += list->has_agg ? 1 : 0;
+  map_size += list->plan ? 1 : 0;
+  map_size += list->profiled ? 1 : 0;
+  mpack_start_map(&writer, map_size);
+  if (list->plan) {
+    // plan is already a valid MsgPack map
+    mpack_write_cstr(&writer, "plan");
+    mpack_write_object_bytes(&writer, list->plan, list->plan_size);
+  }
   if (list->next_cursor) {
     mpack_write_cstr(&writer, "next_cursor");
     mpack_write_u32(&writer, list->next_cursor);
   }
+  if (list->session) {
+    mpack_write_cstr(&writer, "session");
+    mpack_write_u64(&writer, list->session);
+  }
+  if (list->sampled) {
+    mpack_write_cstr(&writer, "estimated_count");
+    mpack_write_u64(&writer, list->estimated_count);
+    mpack_write_cstr(&writer, "count_error");
+    mpack_write_u64(&writer, list->count_error);
+  }
+  if (list->has_agg) {
+    mpack_write_cstr(&writer, "agg");
+    mpack_start_map(&writer, list->agg_count ? 4 : 2);
+    mpack_write_cstr(&writer, "count");
+    mpack_write_u64(&writer, list->agg_count);
+    mpack_write_cstr(&writer, "sum");
+    mpack_write_u64(&writer, list->agg_sum);
+    // No min or max without values
+    if (list->agg_count) {
+      mpack_write_cstr(&writer, "min");
+      mpack_write_u64(&writer, list->agg_min);
+      mpack_write_cstr(&writer, "max");
+      mpack_write_u64(&writer, list->agg_max);
+    }
+    mpack_finish_map(&writer);
+  }
+  uint64_t objects_start = list->profiled ? _now_ns() : 0;
   mpack_write_cstr(&writer, "objects");
   mpack_start_array(&writer, list->count);
 
@@ -146,6 +292,10 @@ static void _encode_list_obj(const api_response_t *api_resp,
   }
 
   mpack_finish_array(&writer);
+  if (list->profiled) {
+    mpack_write_cstr(&writer, "serialize_ns");
+    mpack_write_u64(&writer, _now_ns() - objects_start);
+  }
   mpack_finish_map(&writer);
 
   if (mpack_writer_destroy(&writer) != mpack_ok) {
@@ -179,6 +329,13 @@ void serializer_encode_api_resp(const api_response_t *api_resp,
 
   switch (api_resp->resp_type) {
   case API_RESP_TYPE_ACK:
+    if (api_resp->payload.watermark.event_id) {
+      _encode_watermark(api_resp, sr);
+    } else {
+      serializer_encode(SER_RESP_OK, NULL, 0, sr);
+    }
+    break;
+  case API_RESP_TYPE_SUBSCRIPTION:
     serializer_encode(SER_RESP_OK, NULL, 0, sr);
     break;
   case API_RESP_TYPE_LIST_U32:
@@ -187,6 +344,12 @@ void serializer_encode_api_resp(const api_response_t *api_resp,
   case API_RESP_TYPE_LIST_OBJ:
     _encode_list_obj(api_resp, sr);
     break;
+  case API_RESP_TYPE_HISTOGRAM:
+    _encode_histogram(api_resp, sr);
+    break;
+  case API_RESP_TYPE_ID_SET:
+    _encode_id_set(api_resp, sr);
+    break;
   default:
     sr->err_msg = "Unknown response type";
     break;
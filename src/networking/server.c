@@ -14,12 +14,14 @@
 #include "core/queue.h"
 #include "core/version.h"
 #include "engine/api.h"
+#include "engine/subscription/subscription.h"
 #include "log/log.h"
 #include "networking/serializer.h"
 #include "query/parser.h"
 #include "query/tokenizer.h"
 #include "uv.h"
 #include <signal.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -33,6 +35,9 @@ LOG_INIT(server);
 #define CONNECTION_IDLE_TIMEOUT 600000  // 10 minutes in milliseconds
 #define READ_BUFFER_SIZE 65536          // 64KB per-client read buffer
 #define SERVER_BACKLOG 511              // Listen backlog connections
+// Subscribers whose unsent pushes exceed this are disconnected
+#define SUB_MAX_WRITE_QUEUE_BYTES (8 * 1024 * 1024)
+#define SUB_DRAIN_BATCH 256 // Max events per push
 
 #define INTERNAL_SERVER_ERROR_MSG "[E0] Error: Internal server error\n"
 static const char *internal_server_error_msg = INTERNAL_SERVER_ERROR_MSG;
@@ -68,8 +73,14 @@ typedef struct {
   // Incremented when we queue background work; decremented when work completes.
   int work_refs;
 
-  // Simple 'connected' flag. Set to 0 in on_close.
-  int connected;
+  // Simple 'connected' flag. Set to 0 in on_close. Atomic because running
+  // queries poll it from the thread pool to cancel themselves.
+  atomic_int connected;
+
+  // Live subscription, NULL unless the client subscribed. `sub_async` is
+  // signalled from the writer thread when events are buffered.
+  sub_t *sub;
+  uv_async_t sub_async;
 } client_t;
 
 // Forward declarations for callbacks
@@ -98,6 +109,8 @@ typedef struct {
   // Points to the memory to free (NULL if static, same as response if heap)
   char *response_to_free;
   int64_t arrival_ts;
+  // Taken from a SUBSCRIBE response, started on the loop thread
+  sub_t *sub;
 } work_ctx_t;
 
 /**
@@ -118,6 +131,22 @@ static void _close_client_connection(client_t *client) {
   }
 }
 
+/**
+ * @brief Stops a client's subscription, if any. After `sub_close` the writer
+ * no longer signals `sub_async`, so it can be closed.
+ */
+static void _end_subscription(client_t *client) {
+  if (!client->sub) {
+    return;
+  }
+  sub_close(client->sub);
+  sub_release(client->sub);
+  client->sub = NULL;
+  if (!uv_is_closing((uv_handle_t *)&client->sub_async)) {
+    uv_close((uv_handle_t *)&client->sub_async, on_close);
+  }
+}
+
 /**
  * @brief Callback function for when a client's idle timer fires.
  *
@@ -176,6 +205,7 @@ void on_close(uv_handle_t *handle) {
   // mark disconnected if the TCP handle closed
   if (handle->type == UV_TCP) {
     client->connected = 0;
+    _end_subscription(client);
   }
 
   // Centralized cleanup logic. Check if this is the last reference.
@@ -310,7 +340,8 @@ static void _work_cb(uv_work_t *req) {
     goto cleanup;
   }
 
-  api_resp = api_exec(parsed->ast, ctx->arrival_ts);
+  api_resp =
+      api_exec(parsed->ast, ctx->arrival_ts, &ctx->client->connected);
 
   if (!api_resp) {
     LOG_ACTION_ERROR(ACT_API_EXEC_FAILED,
@@ -326,6 +357,10 @@ static void _work_cb(uv_work_t *req) {
     _encode_err(ctx, &sr, err);
 
   } else {
+    if (api_resp->resp_type == API_RESP_TYPE_SUBSCRIPTION) {
+      ctx->sub = api_resp->payload.sub;
+      api_resp->payload.sub = NULL;
+    }
     serializer_encode_api_resp(api_resp, &sr);
     if (!sr.success) {
       LOG_ACTION_ERROR(ACT_SERIALIZER_ERROR, "client_id=%lld err=\"%s\"",
@@ -355,6 +390,116 @@ cleanup:
   ctx->command = NULL;
 }
 
+static void _send_err_and_close(client_t *client, const char *err_msg) {
+  serializer_result_t sr = {0};
+  serializer_encode_err(err_msg, &sr);
+  if (sr.success) {
+    send_response(client, sr.response, sr.response_size);
+  }
+  free(sr.response);
+  _close_client_connection(client);
+}
+
+// Writer thread: events were buffered for the client's subscription
+static void _notify_sub(void *arg) {
+  client_t *client = arg;
+  uv_async_send(&client->sub_async);
+}
+
+/**
+ * @brief Pushes buffered subscription events to the client, in batches of
+ * up to SUB_DRAIN_BATCH. Slow consumers are disconnected: those whose buffer
+ * overflowed, and those with too many bytes still waiting to be written.
+ */
+static void _on_sub_ready(uv_async_t *handle) {
+  client_t *client = handle->data;
+  if (!client->sub || !client->connected) {
+    return;
+  }
+
+  sub_event_t events[SUB_DRAIN_BATCH];
+  api_obj_t objs[SUB_DRAIN_BATCH];
+  uint32_t n;
+  do {
+    if (uv_stream_get_write_queue_size((uv_stream_t *)&client->handle) >
+        SUB_MAX_WRITE_QUEUE_BYTES) {
+      LOG_ACTION_WARN(ACT_SUB_SLOW_CONSUMER, "client_id=%lld reason=backlog",
+                      client->client_id);
+      _send_err_and_close(client, "Subscriber too slow");
+      return;
+    }
+
+    bool overflowed = false;
+    n = sub_drain(client->sub, events, SUB_DRAIN_BATCH, &overflowed);
+    for (uint32_t i = 0; i < n; i++) {
+      objs[i].id = events[i].id;
+      objs[i].data = events[i].data;
+      objs[i].data_size = events[i].data_size;
+    }
+
+    if (overflowed) {
+      for (uint32_t i = 0; i < n; i++) {
+        free(events[i].data);
+      }
+      LOG_ACTION_WARN(ACT_SUB_SLOW_CONSUMER, "client_id=%lld reason=overflow",
+                      client->client_id);
+      _send_err_and_close(client, "Subscriber too slow");
+      return;
+    }
+    if (n == 0) {
+      return;
+    }
+
+    api_response_t resp = {.op_type = API_SUBSCRIBE,
+                           .resp_type = API_RESP_TYPE_LIST_OBJ,
+                           .is_ok = true};
+    resp.payload.list_obj.type = API_OBJ_TYPE_EVENT;
+    resp.payload.list_obj.objects = objs;
+    resp.payload.list_obj.count = n;
+    serializer_result_t sr = {0};
+    serializer_encode_api_resp(&resp, &sr);
+    if (sr.success) {
+      send_response(client, sr.response, sr.response_size);
+    } else {
+      LOG_ACTION_ERROR(ACT_SERIALIZER_ERROR, "client_id=%lld err=\"%s\"",
+                       client->client_id, sr.err_msg);
+    }
+    free(sr.response);
+    for (uint32_t i = 0; i < n; i++) {
+      free(events[i].data);
+    }
+  } while (n == SUB_DRAIN_BATCH);
+}
+
+/**
+ * @brief Turns the client into a live subscriber. One subscription per
+ * connection. Runs on the loop thread.
+ */
+static bool _start_subscription(client_t *client, sub_t *sub) {
+  if (!client->connected || client->sub) {
+    return false;
+  }
+  if (uv_async_init(client->handle.loop, &client->sub_async, _on_sub_ready) !=
+      0) {
+    return false;
+  }
+  client->sub_async.data = client;
+  client->open_handles++;
+  client->sub = sub;
+
+  if (!sub_register(sub, _notify_sub, client)) {
+    client->sub = NULL;
+    uv_close((uv_handle_t *)&client->sub_async, on_close);
+    return false;
+  }
+
+  // Subscribers may go quiet for long stretches
+  uv_timer_stop(&client->timeout_timer);
+  LOG_ACTION_INFO(ACT_SUB_STARTED, "client_id=%lld container=\"%s\"",
+                  client->client_id, sub->container_name);
+  return true;
+}
+
 /**
  * @brief after_work_cb: runs on the loop thread after work_cb completes
  * Sends the response back to the client.
@@ -370,6 +515,16 @@ static void _after_work_cb(uv_work_t *req, int status) {
                      client->client_id, uv_strerror(status));
     send_response(client, internal_server_error_msg,
                   internal_server_error_msg_len);
+  } else if (ctx->sub && !_start_subscription(client, ctx->sub)) {
+    serializer_result_t sr = {0};
+    serializer_encode_err(client->sub ? "Already subscribed"
+                                      : "Error starting subscription",
+                          &sr);
+    if (sr.success) {
+      send_response(client, sr.response, sr.response_size);
+    }
+    free(sr.response);
+    sub_release(ctx->sub);
   } else if (ctx->response) {
     send_response(client, ctx->response, ctx->response_size);
   } else {
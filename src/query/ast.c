@@ -29,7 +29,8 @@ void ast_free(ast_node_t *node) {
     ast_free(node->tag.value);
     break;
   case AST_LITERAL_NODE:
-    if (node->literal.type == AST_LITERAL_STRING) {
+    if (node->literal.type == AST_LITERAL_STRING ||
+        node->literal.type == AST_LITERAL_FLOAT) {
       free(node->literal.string_value); // Free string copied for literal
     }
     break;
@@ -158,6 +159,17 @@ ast_node_t *ast_create_number_literal_node(int64_t value) {
   return node;
 }
 
+ast_node_t *ast_create_float_literal_node(double value, const char *text,
+                                          size_t text_len) {
+  ast_node_t *node = ast_create_string_literal_node(text, text_len);
+  if (!node) {
+    return NULL;
+  }
+  node->literal.type = AST_LITERAL_FLOAT;
+  node->literal.float_value = value;
+  return node;
+}
+
 ast_node_t *ast_create_comparison_node(ast_comparison_op_t op, ast_node_t *left,
                                        ast_node_t *right) {
   ast_node_t *node = malloc(sizeof(ast_node_t));
@@ -17,7 +17,8 @@
   case TOKEN_OP_GT:                                                            \
   case TOKEN_OP_GTE:                                                           \
   case TOKEN_OP_LT:                                                            \
-  case TOKEN_OP_LTE:
+  case TOKEN_OP_LTE:                                                           \
+  case TOKEN_OP_CONTAINS:
 
 static bool _is_comparison_op(token_type type) {
   switch (type) {
@@ -28,6 +29,25 @@ static bool _is_comparison_op(token_type type) {
   }
 }
 
+static bool _is_literal_or_identifier(token_t *tok) {
+  return tok->type == TOKEN_IDENTIFER || tok->type == TOKEN_LITERAL_STRING ||
+         tok->type == TOKEN_LITERAL_NUMBER || tok->type == TOKEN_LITERAL_FLOAT;
+}
+
+// Literal node for a token accepted by `_is_literal_or_identifier`
+static ast_node_t *_literal_from_token(token_t *tok) {
+  switch (tok->type) {
+  case TOKEN_LITERAL_NUMBER:
+    return ast_create_number_literal_node(tok->number_value);
+  case TOKEN_LITERAL_FLOAT:
+    return ast_create_float_literal_node(tok->float_value, tok->text_value,
+                                         tok->text_value_len);
+  default:
+    return ast_create_string_literal_node(tok->text_value,
+                                          tok->text_value_len);
+  }
+}
+
 // Parse the next tag, if it exists
 static ast_node_t *_parse_tag(queue_t *tokens, parse_result_t *r);
 
@@ -113,6 +133,9 @@ static bool _apply_operator(c_stack_t *value_stack, c_stack_t *op_stack) {
       case TOKEN_OP_LTE:
         comp_op = AST_OP_LTE;
         break;
+      case TOKEN_OP_CONTAINS:
+        comp_op = AST_OP_CONTAINS;
+        break;
       default:
         comp_op = AST_OP_EQ;
         break; // fallback
@@ -208,13 +231,26 @@ static ast_node_t *_parse_exp(queue_t *tokens, parse_result_t *r) {
 
     if (expecting_primary) {
       if (token->type == TOKEN_IDENTIFER ||
-          token->type == TOKEN_LITERAL_NUMBER) {
+          token->type == TOKEN_LITERAL_STRING ||
+          token->type == TOKEN_LITERAL_NUMBER ||
+          token->type == TOKEN_LITERAL_FLOAT ||
+          token->type == TOKEN_KW_ENTITY || token->type == TOKEN_KW_VIEW) {
         token_t *operand_tok = queue_dequeue(tokens);
         ast_node_t *node;
         token_t *next_tok = queue_peek(tokens);
+        bool is_entity = operand_tok->type == TOKEN_KW_ENTITY;
+        bool is_view = operand_tok->type == TOKEN_KW_VIEW;
+
+        if ((is_entity || is_view) &&
+            (!next_tok || next_tok->type != TOKEN_SYM_COLON)) {
+          tok_free(operand_tok);
+          r->error_message = is_entity ? "Expected ':' after `entity`"
+                                       : "Expected ':' after `view`";
+          return _cleanup_stacks_and_return_null(value_stack, op_stack);
+        }
 
-        if (operand_tok->type == TOKEN_IDENTIFER && next_tok &&
-            next_tok->type == TOKEN_SYM_COLON) {
+        if ((operand_tok->type == TOKEN_IDENTIFER || is_entity || is_view) &&
+            next_tok && next_tok->type == TOKEN_SYM_COLON) {
           // consume colon
           tok_free(queue_dequeue(tokens));
 
@@ -225,16 +261,7 @@ static ast_node_t *_parse_exp(queue_t *tokens, parse_result_t *r) {
             return _cleanup_stacks_and_return_null(value_stack, op_stack);
           }
 
-          char *final_val_str = NULL;
-          size_t final_val_str_len = 0;
-          int64_t final_val_int64 = 0;
-          if (val_tok->type == TOKEN_IDENTIFER ||
-              val_tok->type == TOKEN_LITERAL_STRING) {
-            final_val_str = val_tok->text_value;
-            final_val_str_len = val_tok->text_value_len;
-          } else if (val_tok->type == TOKEN_LITERAL_NUMBER) {
-            final_val_int64 = val_tok->number_value;
-          } else {
+          if (!_is_literal_or_identifier(val_tok)) {
             tok_free(operand_tok);
             tok_free(val_tok);
             r->error_message =
@@ -242,19 +269,25 @@ static ast_node_t *_parse_exp(queue_t *tokens, parse_result_t *r) {
             return _cleanup_stacks_and_return_null(value_stack, op_stack);
           }
 
-          ast_node_t *tag_val_node =
-              final_val_str != NULL
-                  ? ast_create_string_literal_node(final_val_str,
-                                                   final_val_str_len)
-                  : ast_create_number_literal_node(final_val_int64);
-          node =
-              ast_create_custom_tag_node(operand_tok->text_value, tag_val_node);
+          // Only custom tags hold decimals
+          if ((is_entity || is_view) && val_tok->type == TOKEN_LITERAL_FLOAT) {
+            val_tok->type = TOKEN_LITERAL_STRING;
+          }
+          ast_node_t *tag_val_node = _literal_from_token(val_tok);
+          // `entity:<id>` resolves to the entity's event timeline,
+          // `view:<name>` to a materialized view
+          if (is_entity) {
+            node = ast_create_tag_node(AST_KW_ENTITY, tag_val_node);
+          } else if (is_view) {
+            node = ast_create_tag_node(AST_KW_VIEW, tag_val_node);
+          } else {
+            node = ast_create_custom_tag_node(operand_tok->text_value,
+                                              tag_val_node);
+          }
           tok_free(val_tok);
-        } else if (operand_tok->type == TOKEN_IDENTIFER) {
-          node = ast_create_string_literal_node(operand_tok->text_value,
-                                                operand_tok->text_value_len);
         } else {
-          node = ast_create_number_literal_node(operand_tok->number_value);
+          // Comparison operand
+          node = _literal_from_token(operand_tok);
         }
 
         tok_free(operand_tok);
@@ -267,7 +300,10 @@ static ast_node_t *_parse_exp(queue_t *tokens, parse_result_t *r) {
         expecting_primary = false; // After an operand, we expect an operator.
       } else if (token->type == TOKEN_OP_NOT ||
                  token->type == TOKEN_SYM_LPAREN) {
-        paren_depth++;
+        // NOT is applied when its enclosing ')' unwinds the stack
+        if (token->type == TOKEN_SYM_LPAREN) {
+          paren_depth++;
+        }
         token_t *op_to_push = queue_dequeue(tokens);
         if (!stack_push(op_stack, op_to_push)) {
           tok_free(op_to_push);
@@ -355,6 +391,152 @@ static ast_node_t *_parse_exp(queue_t *tokens, parse_result_t *r) {
   return exp_tree;
 }
 
+// Event fields that are tokenized as keywords
+static const char *_field_name(token_t *t) {
+  switch (t->type) {
+  case TOKEN_IDENTIFER:
+  case TOKEN_LITERAL_STRING:
+    return t->text_value;
+  case TOKEN_KW_ID:
+    return "id";
+  case TOKEN_KW_IN:
+    return "in";
+  case TOKEN_KW_ENTITY:
+    return "entity";
+  default:
+    return NULL;
+  }
+}
+
+// Field list parser: `(a, b, c)` -> string literals linked by `next`
+static ast_node_t *_parse_field_list(queue_t *tokens, parse_result_t *r) {
+  token_t *lparen = queue_dequeue(tokens);
+  if (!lparen || lparen->type != TOKEN_SYM_LPAREN) {
+    tok_free(lparen);
+    r->error_message = "Field list must start with '('";
+    return NULL;
+  }
+  tok_free(lparen);
+
+  ast_node_t *head = NULL;
+  bool expecting_field = true;
+
+  while (true) {
+    token_t *t = queue_dequeue(tokens);
+    if (!t) {
+      r->error_message = "Unterminated field list";
+      ast_free(head);
+      return NULL;
+    }
+
+    if (expecting_field) {
+      const char *name = _field_name(t);
+      if (!name) {
+        tok_free(t);
+        r->error_message = "Invalid field name";
+        ast_free(head);
+        return NULL;
+      }
+      ast_node_t *field = ast_create_string_literal_node(name, strlen(name));
+      tok_free(t);
+      if (!field) {
+        ast_free(head);
+        return NULL;
+      }
+      ast_append_node(&head, field);
+      expecting_field = false;
+    } else if (t->type == TOKEN_SYM_COMMA) {
+      tok_free(t);
+      expecting_field = true;
+    } else if (t->type == TOKEN_SYM_RPAREN) {
+      tok_free(t);
+      break;
+    } else {
+      tok_free(t);
+      r->error_message = "Expected ',' or ')' in field list";
+      ast_free(head);
+      return NULL;
+    }
+  }
+
+  return head;
+}
+
+// Step list parser: `(<exp>, <exp>, ...)` -> expressions linked by `next`.
+// Each step is cut out at its top-level `,` and parsed as `(<exp>)`
+static ast_node_t *_parse_step_list(queue_t *tokens, parse_result_t *r) {
+  token_t *open = queue_dequeue(tokens);
+  if (!open || open->type != TOKEN_SYM_LPAREN) {
+    tok_free(open);
+    r->error_message = "Step list must start with '('";
+    return NULL;
+  }
+
+  ast_node_t *head = NULL;
+  bool done = false;
+  while (!done) {
+    queue_t *step_tokens = queue_create();
+    if (!step_tokens) {
+      tok_free(open);
+      ast_free(head);
+      return NULL;
+    }
+    queue_enqueue(step_tokens, open);
+    open = NULL;
+
+    int depth = 0;
+    token_t *t = NULL;
+    while ((t = queue_dequeue(tokens))) {
+      if (depth == 0 &&
+          (t->type == TOKEN_SYM_COMMA || t->type == TOKEN_SYM_RPAREN)) {
+        break;
+      }
+      if (t->type == TOKEN_SYM_LPAREN) {
+        depth++;
+      } else if (t->type == TOKEN_SYM_RPAREN) {
+        depth--;
+      }
+      queue_enqueue(step_tokens, t);
+    }
+    if (!t) {
+      tok_clear_all(step_tokens);
+      queue_destroy(step_tokens);
+      r->error_message = "Unterminated step list";
+      ast_free(head);
+      return NULL;
+    }
+
+    // The separator closes this step
+    done = t->type == TOKEN_SYM_RPAREN;
+    t->type = TOKEN_SYM_RPAREN;
+    queue_enqueue(step_tokens, t);
+    ast_node_t *step = _parse_exp(step_tokens, r);
+    bool complete = step && queue_empty(step_tokens);
+    tok_clear_all(step_tokens);
+    queue_destroy(step_tokens);
+    if (!complete) {
+      if (step && !r->error_message) {
+        r->error_message = "Invalid step expression";
+      }
+      ast_free(step);
+      ast_free(head);
+      return NULL;
+    }
+    ast_append_node(&head, step);
+
+    if (!done) {
+      open = calloc(1, sizeof(token_t));
+      if (!open) {
+        ast_free(head);
+        return NULL;
+      }
+      open->type = TOKEN_SYM_LPAREN;
+    }
+  }
+
+  return head;
+}
+
 static parse_result_t *_create_result(void) {
   parse_result_t *r = malloc(sizeof(parse_result_t));
   r->ast = NULL;
@@ -363,11 +545,113 @@ static parse_result_t *_create_result(void) {
   return r;
 }
 
+// `CREATE VIEW <name>`: the name becomes a `view` tag
+static ast_node_t *_parse_view_name(queue_t *tokens, parse_result_t *r) {
+  token_t *view_tok = queue_dequeue(tokens);
+  if (!view_tok || view_tok->type != TOKEN_KW_VIEW) {
+    tok_free(view_tok);
+    r->error_message = "Expected `view` after `create`";
+    return NULL;
+  }
+  tok_free(view_tok);
+
+  token_t *name_tok = queue_dequeue(tokens);
+  if (!name_tok || (name_tok->type != TOKEN_IDENTIFER &&
+                    name_tok->type != TOKEN_LITERAL_STRING)) {
+    tok_free(name_tok);
+    r->error_message = "Expected view name";
+    return NULL;
+  }
+
+  ast_node_t *name = ast_create_string_literal_node(name_tok->text_value,
+                                                    name_tok->text_value_len);
+  tok_free(name_tok);
+  if (!name) {
+    return NULL;
+  }
+  ast_node_t *tag = ast_create_tag_node(AST_KW_VIEW, name);
+  if (!tag) {
+    ast_free(name);
+  }
+  return tag;
+}
+
+// `SHOW <target>`: the target becomes a `target` tag
+static ast_node_t *_parse_show_target(queue_t *tokens, parse_result_t *r) {
+  token_t *target_tok = queue_dequeue(tokens);
+  if (!target_tok || target_tok->type != TOKEN_IDENTIFER) {
+    tok_free(target_tok);
+    r->error_message = "Expected target after `show`";
+    return NULL;
+  }
+
+  ast_node_t *target = ast_create_string_literal_node(
+      target_tok->text_value, target_tok->text_value_len);
+  tok_free(target_tok);
+  if (!target) {
+    return NULL;
+  }
+  ast_node_t *tag = ast_create_tag_node(AST_KW_TARGET, target);
+  if (!tag) {
+    ast_free(target);
+  }
+  return tag;
+}
+
+// `TOP <key>`: the tag key becomes a `key` tag
+static ast_node_t *_parse_top_key(queue_t *tokens, parse_result_t *r) {
+  token_t *key_tok = queue_dequeue(tokens);
+  if (!key_tok || (key_tok->type != TOKEN_IDENTIFER &&
+                   key_tok->type != TOKEN_LITERAL_STRING)) {
+    tok_free(key_tok);
+    r->error_message = "Expected tag key after `top`";
+    return NULL;
+  }
+
+  ast_node_t *key = ast_create_string_literal_node(key_tok->text_value,
+                                                   key_tok->text_value_len);
+  tok_free(key_tok);
+  if (!key) {
+    return NULL;
+  }
+  ast_node_t *tag = ast_create_tag_node(AST_KW_KEY, key);
+  if (!tag) {
+    ast_free(key);
+  }
+  return tag;
+}
+
+// `EXPLAIN QUERY` and `PROFILE QUERY`: the prefix becomes a `plan` tag
+static ast_node_t *_parse_plan_prefix(token_t *prefix_tok, queue_t *tokens,
+                                      parse_result_t *r) {
+  token_t *query_tok = queue_dequeue(tokens);
+  if (!query_tok || query_tok->type != TOKEN_CMD_QUERY) {
+    tok_free(query_tok);
+    r->error_message = "Expected `query` after `explain` or `profile`";
+    return NULL;
+  }
+  tok_free(query_tok);
+
+  const char *mode =
+      prefix_tok->type == TOKEN_CMD_EXPLAIN ? "explain" : "profile";
+  ast_node_t *value = ast_create_string_literal_node(mode, strlen(mode));
+  if (!value) {
+    return NULL;
+  }
+  ast_node_t *tag = ast_create_tag_node(AST_KW_PLAN, value);
+  if (!tag) {
+    ast_free(value);
+  }
+  return tag;
+}
+
 static bool _resolve_cmd_type(token_t *token, ast_command_type_t *type_out) {
   if (!token || !type_out)
     return false;
   switch (token->type) {
   case TOKEN_CMD_QUERY:
+  case TOKEN_CMD_EXPLAIN:
+  case TOKEN_CMD_PROFILE:
     *type_out = AST_CMD_QUERY;
     break;
   case TOKEN_CMD_EVENT:
@@ -376,6 +660,30 @@ static bool _resolve_cmd_type(token_t *token, ast_command_type_t *type_out) {
   case TOKEN_CMD_INDEX:
     *type_out = AST_CMD_INDEX;
     break;
+  case TOKEN_CMD_CREATE:
+    *type_out = AST_CMD_CREATE_VIEW;
+    break;
+  case TOKEN_CMD_SUBSCRIBE:
+    *type_out = AST_CMD_SUBSCRIBE;
+    break;
+  case TOKEN_CMD_SHOW:
+    *type_out = AST_CMD_SHOW;
+    break;
+  case TOKEN_CMD_TOP:
+    *type_out = AST_CMD_TOP;
+    break;
+  case TOKEN_CMD_HISTOGRAM:
+    *type_out = AST_CMD_HISTOGRAM;
+    break;
+  case TOKEN_CMD_FUNNEL:
+    *type_out = AST_CMD_FUNNEL;
+    break;
+  case TOKEN_CMD_ENTITIES:
+    *type_out = AST_CMD_ENTITIES;
+    break;
+  case TOKEN_CMD_ROLLUP:
+    *type_out = AST_CMD_ROLLUP;
+    break;
   default:
     return false;
   }
@@ -406,8 +714,40 @@ parse_result_t *parse(queue_t *tokens) {
     return r;
   }
 
-  ast_node_t *cmd_node = ast_create_command_node(cmd_type, NULL);
+  // `CREATE ROLLUP` takes only tags
+  token_t *next_tok = queue_peek(tokens);
+  if (cmd_type == AST_CMD_CREATE_VIEW && next_tok->type == TOKEN_CMD_ROLLUP) {
+    tok_free(queue_dequeue(tokens));
+    cmd_type = AST_CMD_CREATE_ROLLUP;
+  }
+
+  // Commands naming their subject before the tags
+  ast_node_t *lead_tag = NULL;
+  bool plan_prefix = cmd_token->type == TOKEN_CMD_EXPLAIN ||
+                     cmd_token->type == TOKEN_CMD_PROFILE;
+  if (cmd_type == AST_CMD_CREATE_VIEW || cmd_type == AST_CMD_SHOW ||
+      cmd_type == AST_CMD_TOP || plan_prefix) {
+    if (plan_prefix) {
+      lead_tag = _parse_plan_prefix(cmd_token, tokens, r);
+    } else if (cmd_type == AST_CMD_TOP) {
+      lead_tag = _parse_top_key(tokens, r);
+    } else {
+      lead_tag = cmd_type == AST_CMD_CREATE_VIEW
+                     ? _parse_view_name(tokens, r)
+                     : _parse_show_target(tokens, r);
+    }
+    if (!lead_tag) {
+      if (!r->error_message)
+        r->error_message = "Failed to allocate command tag";
+      tok_free(cmd_token);
+      tok_clear_all(tokens);
+      return r;
+    }
+  }
+
+  ast_node_t *cmd_node = ast_create_command_node(cmd_type, lead_tag);
   if (!cmd_node) {
+    ast_free(lead_tag);
     r->error_message = "Failed to allocate command node";
   } else if (!_parse_tags(tokens, cmd_node, r)) {
     ast_free(cmd_node);
@@ -441,17 +781,17 @@ static bool _is_token_kw(token_t *t) {
   case TOKEN_KW_COUNT:
   case TOKEN_KW_HAVING:
   case TOKEN_KW_KEY:
+  case TOKEN_KW_FIELDS:
+  case TOKEN_KW_TIMEOUT:
+  case TOKEN_KW_SAMPLE:
+  case TOKEN_KW_STEPS:
+  case TOKEN_KW_OF:
     return true;
   default:
     return false;
   }
 }
 
-static bool _is_literal_or_identifier(token_t *tok) {
-  return tok->type == TOKEN_IDENTIFER || tok->type == TOKEN_LITERAL_STRING ||
-         tok->type == TOKEN_LITERAL_NUMBER;
-}
-
 static ast_node_t *_parse_tag(queue_t *tokens, parse_result_t *r) {
   ast_node_t *tag = NULL;
   ast_node_t *tag_val = NULL;
@@ -491,6 +831,24 @@ static ast_node_t *_parse_tag(queue_t *tokens, parse_result_t *r) {
     case TOKEN_KW_KEY:
       kt = AST_KW_KEY;
       break;
+    case TOKEN_KW_FIELDS:
+      kt = AST_KW_FIELDS;
+      break;
+    case TOKEN_KW_TIMEOUT:
+      kt = AST_KW_TIMEOUT;
+      break;
+    case TOKEN_KW_SAMPLE:
+      kt = AST_KW_SAMPLE;
+      break;
+    case TOKEN_KW_STEPS:
+      kt = AST_KW_STEPS;
+      break;
+    case TOKEN_KW_OF:
+      kt = AST_KW_OF;
+      break;
+    case TOKEN_KW_BY:
+      kt = AST_KW_BY;
+      break;
     default:
       free(key_token);
       return NULL;
@@ -523,7 +881,12 @@ static ast_node_t *_parse_tag(queue_t *tokens, parse_result_t *r) {
   if (tag->tag.key_type == AST_TAG_KEY_RESERVED) {
     switch (tag->tag.reserved_key) {
     case AST_KW_WHERE:
-      // where: must be followed by a parenthesized expression
+    case AST_KW_FIELDS:
+    case AST_KW_STEPS:
+    case AST_KW_OF:
+    case AST_KW_BY:
+      // where:, fields:, steps:, of: and by: must be followed by a
+      // parenthesized list
       if (first_val_token->type != TOKEN_SYM_LPAREN) {
         ast_free(tag);
         return NULL;
@@ -575,6 +938,39 @@ static ast_node_t *_parse_tag(queue_t *tokens, parse_result_t *r) {
     }
     tag->tag.value = tag_val;
 
+  } else if (first_val_token->type == TOKEN_LITERAL_FLOAT) {
+    first_val_token = queue_dequeue(tokens);
+
+    // Only custom tags hold decimals, e.g. `entity:1.5` stays a string
+    if (tag->tag.key_type == AST_TAG_KEY_RESERVED) {
+      first_val_token->type = TOKEN_LITERAL_STRING;
+    }
+    tag_val = _literal_from_token(first_val_token);
+    tok_free(first_val_token);
+
+    if (!tag_val) {
+      ast_free(tag);
+      return NULL;
+    }
+    tag->tag.value = tag_val;
+
+  } else if (tag->tag.key_type == AST_TAG_KEY_RESERVED &&
+             (tag->tag.reserved_key == AST_KW_FIELDS ||
+              tag->tag.reserved_key == AST_KW_BY)) {
+    ast_node_t *fields = _parse_field_list(tokens, r);
+    if (!fields) {
+      ast_free(tag);
+      return NULL;
+    }
+    tag->tag.value = fields;
+  } else if (tag->tag.key_type == AST_TAG_KEY_RESERVED &&
+             tag->tag.reserved_key == AST_KW_STEPS) {
+    ast_node_t *steps = _parse_step_list(tokens, r);
+    if (!steps) {
+      ast_free(tag);
+      return NULL;
+    }
+    tag->tag.value = steps;
   } else {
     ast_node_t *exp_tree = _parse_exp(tokens, r);
     if (!exp_tree) {
@@ -3,6 +3,7 @@
 #include "core/queue.h"
 #include <ctype.h>
 #include <errno.h>
+#include <math.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -43,6 +44,7 @@ static token_t *_create_token(token_type type, char *text_value,
   t->type = type;
   t->text_value = text_value ? strdup(text_value) : NULL;
   t->number_value = number_value;
+  t->float_value = 0;
   t->text_value_len = text_value_len;
   return t;
 }
@@ -113,6 +115,40 @@ static bool _parse_int64(const char *str, size_t len, int64_t *out_value) {
   return true;
 }
 
+// Parses unsigned decimals like `99.99`: digits, one '.', digits. Anything
+// else with a '.' (versions, hosts) stays an identifier.
+static bool _parse_float(const char *str, size_t len, double *out_value) {
+  if (len > FLOAT_MAX_CHARS) {
+    return false;
+  }
+  size_t dot = len;
+  for (size_t k = 0; k < len; k++) {
+    if (str[k] == '.') {
+      if (dot != len) {
+        return false;
+      }
+      dot = k;
+    } else if (!isdigit((unsigned char)str[k])) {
+      return false;
+    }
+  }
+  if (dot == 0 || dot == len || dot == len - 1) {
+    return false;
+  }
+
+  char buf[FLOAT_MAX_CHARS + 1];
+  memcpy(buf, str, len);
+  buf[len] = '\0';
+  char *endptr;
+  errno = 0;
+  double value = strtod(buf, &endptr);
+  if (*endptr != '\0' || errno == ERANGE || !isfinite(value)) {
+    return false;
+  }
+  *out_value = value;
+  return true;
+}
+
 static void _to_lowercase(char *dest, const char *src, size_t max_len) {
   size_t i;
   for (i = 0; i < max_len - 1 && src[i]; i++) {
@@ -131,7 +167,21 @@ struct {
               {"entity", TOKEN_KW_ENTITY}, {"cursor", TOKEN_KW_CURSOR},
               {"take", TOKEN_KW_TAKE},     {"where", TOKEN_KW_WHERE},
               {"by", TOKEN_KW_BY},         {"having", TOKEN_KW_HAVING},
-              {"count", TOKEN_KW_COUNT},   {"key", TOKEN_KW_KEY}};
+              {"count", TOKEN_KW_COUNT},   {"key", TOKEN_KW_KEY},
+              {"fields", TOKEN_KW_FIELDS}, {"timeout", TOKEN_KW_TIMEOUT},
+              {"sample", TOKEN_KW_SAMPLE}, {"create", TOKEN_CMD_CREATE},
+              {"view", TOKEN_KW_VIEW},
+              {"subscribe", TOKEN_CMD_SUBSCRIBE},
+              {"show", TOKEN_CMD_SHOW},
+              {"explain", TOKEN_CMD_EXPLAIN},
+              {"profile", TOKEN_CMD_PROFILE},
+              {"top", TOKEN_CMD_TOP},
+              {"histogram", TOKEN_CMD_HISTOGRAM},
+              {"funnel", TOKEN_CMD_FUNNEL},
+              {"steps", TOKEN_KW_STEPS},
+              {"entities", TOKEN_CMD_ENTITIES},
+              {"rollup", TOKEN_CMD_ROLLUP},
+              {"of", TOKEN_KW_OF}};
 
 // Return tokens from input string.
 // TODO: Create an iterator/stream, i.e. get_next_token()
@@ -165,6 +215,11 @@ queue_t *tok_tokenize(char *input) {
         return NULL;
     }
 
+    else if (c == ',') {
+      if (!_enqueue(q, &num_tokens, TOKEN_SYM_COMMA, &t, &i, 1, NULL, 0, 0))
+        return NULL;
+    }
+
     else if (c == '>' && has_next_char && input[i + 1] == '=') {
       if (!_enqueue(q, &num_tokens, TOKEN_OP_GTE, &t, &i, 2, NULL, 0, 0))
         return NULL;
@@ -195,6 +250,11 @@ queue_t *tok_tokenize(char *input) {
         return NULL;
     }
 
+    else if (c == '~') {
+      if (!_enqueue(q, &num_tokens, TOKEN_OP_CONTAINS, &t, &i, 1, NULL, 0, 0))
+        return NULL;
+    }
+
     else if (c == ':') {
       if (!_enqueue(q, &num_tokens, TOKEN_SYM_COLON, &t, &i, 1, NULL, 0, 0))
         return NULL;
@@ -259,6 +319,7 @@ queue_t *tok_tokenize(char *input) {
           }
         }
 
+        double f_val = 0;
         if (all_digits) {
           if (len > INT64_MAX_CHARS)
             return _cleanup_on_err(q);
@@ -268,6 +329,13 @@ queue_t *tok_tokenize(char *input) {
           if (!parse_r || !_enqueue(q, &num_tokens, TOKEN_LITERAL_NUMBER, &t,
                                     &i, 0, NULL, n_val, 0))
             return NULL;
+        } else if (_parse_float(val, len, &f_val)) {
+          bool ok = _enqueue(q, &num_tokens, TOKEN_LITERAL_FLOAT, &t, &i, 0,
+                             val, 0, len);
+          free(val);
+          if (!ok)
+            return NULL;
+          t->float_value = f_val;
         } else {
           char *lower_text_value = malloc(len + 1);
           if (!lower_text_value) {
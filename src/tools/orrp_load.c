@@ -0,0 +1,155 @@
+#include "core/data_constants.h"
+#include "engine/bulk_load/bulk_load.h"
+#include "engine/container/container.h"
+#include "engine/container/container_types.h"
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_DATA_DIR "data"
+#define LOAD_CACHE_CAPACITY 1
+
+// orrp_load.c
+// Builds a new container from NDJSON or msgpack files, with the server
+// stopped.
+static void _usage(void) {
+  fprintf(stderr,
+          "usage: orrp_load [-d data_dir] [-f ndjson|msgpack] <container> "
+          "<file>...\n"
+          "  `-` reads stdin. The format defaults to msgpack for .msgpack and\n"
+          "  .mpk files, ndjson otherwise.\n");
+}
+
+// As the server allows for `in`
+static bool _valid_container_name(const char *name) {
+  size_t len = strlen(name);
+  if (!len || len > 64 || name[0] == '.' ||
+      strcmp(name, SYS_CONTAINER_NAME) == 0) {
+    return false;
+  }
+  for (size_t i = 0; i < len; i++) {
+    unsigned char c = (unsigned char)name[i];
+    if (!isalnum(c) && c != '_' && c != '-') {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool _has_suffix(const char *s, const char *suffix) {
+  size_t len = strlen(s);
+  size_t suffix_len = strlen(suffix);
+  return len >= suffix_len && strcmp(s + len - suffix_len, suffix) == 0;
+}
+
+static bulk_load_format_t _format_of(const char *path, const char *format) {
+  if (format) {
+    return strcmp(format, "msgpack") == 0 ? BULK_LOAD_MSGPACK
+                                          : BULK_LOAD_NDJSON;
+  }
+  return _has_suffix(path, ".msgpack") || _has_suffix(path, ".mpk")
+             ? BULK_LOAD_MSGPACK
+             : BULK_LOAD_NDJSON;
+}
+
+static bool _load_file(bulk_load_t *bl, const char *path, const char *format) {
+  bool is_stdin = strcmp(path, "-") == 0;
+  FILE *in = is_stdin ? stdin : fopen(path, "rb");
+  if (!in) {
+    fprintf(stderr, "%s: Failed to open\n", path);
+    return false;
+  }
+  const char *err = NULL;
+  uint64_t record = 0;
+  bool ok = bulk_load_read(bl, in, _format_of(path, format), &err, &record);
+  if (!ok) {
+    fprintf(stderr, "%s:%llu: %s\n", is_stdin ? "<stdin>" : path,
+            (unsigned long long)record, err);
+  }
+  if (!is_stdin) {
+    fclose(in);
+  }
+  return ok;
+}
+
+static double _now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+  const char *data_dir = DEFAULT_DATA_DIR;
+  const char *format = NULL;
+  int i = 1;
+  for (; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; i += 2) {
+    if (i + 1 >= argc) {
+      _usage();
+      return 1;
+    }
+    if (strcmp(argv[i], "-d") == 0) {
+      data_dir = argv[i + 1];
+    } else if (strcmp(argv[i], "-f") == 0 &&
+               (strcmp(argv[i + 1], "ndjson") == 0 ||
+                strcmp(argv[i + 1], "msgpack") == 0)) {
+      format = argv[i + 1];
+    } else {
+      _usage();
+      return 1;
+    }
+  }
+  if (argc - i < 2) {
+    _usage();
+    return 1;
+  }
+  const char *name = argv[i++];
+  if (!_valid_container_name(name)) {
+    fprintf(stderr, "Invalid container name\n");
+    return 1;
+  }
+
+  if (!container_init(LOAD_CACHE_CAPACITY, data_dir, MAX_CONTAINER_SIZE)) {
+    fprintf(stderr, "Failed to open data dir %s\n", data_dir);
+    return 1;
+  }
+  container_result_t cr = container_get_system();
+  if (!cr.success) {
+    fprintf(stderr, "%s\n", cr.error_msg);
+    container_shutdown();
+    return 1;
+  }
+
+  double start = _now_s();
+  const char *err = NULL;
+  bulk_load_t *bl = bulk_load_begin(data_dir, name, cr.container, &err);
+  bool ok = bl != NULL;
+  for (; ok && i < argc; i++) {
+    ok = _load_file(bl, argv[i], format);
+  }
+  bulk_load_stats_t stats = {0};
+  if (ok) {
+    ok = bulk_load_finish(bl, &stats, &err);
+  } else if (bl) {
+    bulk_load_abort(bl);
+    err = NULL;
+  }
+  if (!ok && err) {
+    fprintf(stderr, "%s\n", err);
+  }
+
+  double secs = _now_s() - start;
+  if (ok) {
+    printf("Loaded %llu events, %llu new entities into %s in %.2fs "
+           "(%.0f events/s)\n",
+           (unsigned long long)stats.events,
+           (unsigned long long)stats.new_entities, name, secs,
+           secs > 0 ? (double)stats.events / secs : 0.0);
+  }
+  container_release(cr.container);
+  container_shutdown();
+  return ok ? 0 : 1;
+}
@@ -282,6 +282,29 @@ void test_bitmap_serialize_null_inputs(void) {
   bitmap_free(bm);
 }
 
+void test_bitmap_serialize_portable_roundtrip(void) {
+  bitmap_t *bm = bitmap_create();
+  bitmap_add(bm, 7);
+  for (uint32_t i = 1000; i < 5000; i++) {
+    bitmap_add(bm, i);
+  }
+
+  size_t size = 0;
+  void *buffer = bitmap_serialize_portable(bm, &size);
+  TEST_ASSERT_NOT_NULL(buffer);
+  // Any roaring library reads it without our header
+  roaring_bitmap_t *rb = roaring_bitmap_portable_deserialize_safe(buffer, size);
+  TEST_ASSERT_NOT_NULL(rb);
+  TEST_ASSERT_EQUAL_UINT64(4001, roaring_bitmap_get_cardinality(rb));
+  TEST_ASSERT_TRUE(roaring_bitmap_contains(rb, 7));
+  TEST_ASSERT_TRUE(roaring_bitmap_contains(rb, 4999));
+  TEST_ASSERT_EQUAL_size_t(roaring_bitmap_portable_size_in_bytes(rb), size);
+
+  roaring_bitmap_free(rb);
+  free(buffer);
+  bitmap_free(bm);
+}
+
 void test_bitmap_deserialize_empty_bitmap(void) {
   bitmap_t *original = bitmap_create();
   TEST_ASSERT_NOT_NULL(original);
@@ -356,6 +379,125 @@ void test_bitmap_deserialize_invalid_size(void) {
   bitmap_free(original);
 }
 
+// Room for `size` bytes plus 64 bytes of slack, 32 byte aligned
+static char *_aligned_buf(size_t size) {
+  return aligned_alloc(32, (size + 64 + 31) & ~(size_t)31);
+}
+
+static bitmap_t *_large_bitmap(void) {
+  bitmap_t *bm = bitmap_create();
+  TEST_ASSERT_NOT_NULL(bm);
+  for (uint32_t i = 0; i < 100000; i += 3) {
+    bitmap_add(bm, i);
+  }
+  bitmap_add(bm, 5000000); // array container
+  return bm;
+}
+
+void test_bitmap_view_in_place(void) {
+  bitmap_t *original = _large_bitmap();
+  size_t size;
+  void *ser = bitmap_serialize(original, &size);
+  TEST_ASSERT_NOT_NULL(ser);
+
+  // Place the header 16 bytes before a 32 byte boundary, like LMDB overflow
+  // pages do
+  char *buf = _aligned_buf(size);
+  TEST_ASSERT_NOT_NULL(buf);
+  memcpy(buf + 16, ser, size);
+
+  bitmap_t *view = bitmap_view(buf + 16, size);
+  TEST_ASSERT_NOT_NULL(view);
+  TEST_ASSERT_NULL(view->view_buf); // no copy
+  TEST_ASSERT_EQUAL_UINT32(bitmap_get_cardinality(original),
+                           bitmap_get_cardinality(view));
+  TEST_ASSERT_TRUE(bitmap_contains(view, 99999));
+  TEST_ASSERT_TRUE(bitmap_contains(view, 5000000));
+  TEST_ASSERT_FALSE(bitmap_contains(view, 1));
+
+  // Read-only operations work on views
+  bitmap_t *other = bitmap_create();
+  bitmap_add(other, 3);
+  bitmap_add(other, 4);
+  bitmap_t *inter = bitmap_and(view, other);
+  TEST_ASSERT_EQUAL_UINT32(1, bitmap_get_cardinality(inter));
+  bitmap_and_inplace(other, view);
+  TEST_ASSERT_EQUAL_UINT32(1, bitmap_get_cardinality(other));
+
+  bitmap_free(inter);
+  bitmap_free(other);
+  bitmap_free(view);
+  free(buf);
+  free(ser);
+  bitmap_free(original);
+}
+
+void test_bitmap_view_unaligned(void) {
+  bitmap_t *original = _large_bitmap();
+  size_t size;
+  void *ser = bitmap_serialize(original, &size);
+  TEST_ASSERT_NOT_NULL(ser);
+
+  char *buf = _aligned_buf(size);
+  TEST_ASSERT_NOT_NULL(buf);
+  memcpy(buf + 3, ser, size);
+
+  bitmap_t *view = bitmap_view(buf + 3, size);
+  TEST_ASSERT_NOT_NULL(view);
+  TEST_ASSERT_NOT_NULL(view->view_buf); // copied once to an aligned buffer
+  TEST_ASSERT_EQUAL_UINT32(bitmap_get_cardinality(original),
+                           bitmap_get_cardinality(view));
+
+  // A mutable copy is independent of the view
+  bitmap_t *copy = bitmap_copy(view);
+  bitmap_add(copy, 1);
+  TEST_ASSERT_FALSE(bitmap_contains(view, 1));
+  TEST_ASSERT_TRUE(bitmap_contains(copy, 1));
+
+  bitmap_free(copy);
+  bitmap_free(view);
+  free(buf);
+  free(ser);
+  bitmap_free(original);
+}
+
+void test_bitmap_view_rejects_truncated(void) {
+  bitmap_t *original = _large_bitmap();
+  size_t size;
+  void *ser = bitmap_serialize(original, &size);
+  TEST_ASSERT_NULL(bitmap_view(ser, size - 1));
+  TEST_ASSERT_NULL(bitmap_view(ser, 8));
+  TEST_ASSERT_NULL(bitmap_view(NULL, size));
+  free(ser);
+  bitmap_free(original);
+}
+
+void test_bitmap_reads_portable_format(void) {
+  // Layout written before frozen payloads: {size, version 0} + portable
+  bitmap_t *original = _large_bitmap();
+  size_t payload = roaring_bitmap_portable_size_in_bytes(original->rb);
+  size_t size = 16 + payload;
+  char *buf = malloc(size);
+  TEST_ASSERT_NOT_NULL(buf);
+  uint64_t header[2] = {payload, 0};
+  memcpy(buf, header, sizeof(header));
+  roaring_bitmap_portable_serialize(original->rb, buf + 16);
+
+  bitmap_t *view = bitmap_view(buf, size);
+  TEST_ASSERT_NOT_NULL(view);
+  TEST_ASSERT_EQUAL_UINT32(bitmap_get_cardinality(original),
+                           bitmap_get_cardinality(view));
+  bitmap_t *deserialized = bitmap_deserialize(buf, size);
+  TEST_ASSERT_NOT_NULL(deserialized);
+  bitmap_add(deserialized, 1);
+  TEST_ASSERT_TRUE(bitmap_contains(deserialized, 1));
+
+  bitmap_free(deserialized);
+  bitmap_free(view);
+  free(buf);
+  bitmap_free(original);
+}
+
 // Test serialization round-trip
 void test_bitmap_serialize_deserialize_roundtrip(void) {
   bitmap_t *original = bitmap_create();
@@ -440,6 +582,91 @@ void test_bitmap_or_basic(void) {
   bitmap_free(result);
 }
 
+void test_bitmap_or_many(void) {
+  // More inputs than fit in the stack buffer
+  bitmap_t *bms[40];
+  for (uint32_t i = 0; i < 40; i++) {
+    bms[i] = bitmap_create();
+    bitmap_add(bms[i], i * 3);
+    bitmap_add(bms[i], 1000); // shared by all
+  }
+  bitmap_t *result = bitmap_or_many((const bitmap_t **)bms, 40);
+  TEST_ASSERT_NOT_NULL(result);
+  TEST_ASSERT_EQUAL_UINT32(41, bitmap_get_cardinality(result));
+  TEST_ASSERT_TRUE(bitmap_contains(result, 39 * 3));
+  TEST_ASSERT_FALSE(bitmap_contains(result, 1));
+  TEST_ASSERT_FALSE(bitmap_is_empty(result));
+
+  TEST_ASSERT_NULL(bitmap_or_many((const bitmap_t **)bms, 0));
+  for (uint32_t i = 0; i < 40; i++) {
+    bitmap_free(bms[i]);
+  }
+  bitmap_free(result);
+
+  bitmap_t *empty = bitmap_create();
+  TEST_ASSERT_TRUE(bitmap_is_empty(empty));
+  bitmap_free(empty);
+}
+
+void test_bitmap_tile(void) {
+  bitmap_t *pattern = bitmap_create();
+  bitmap_add(pattern, 0);
+  bitmap_add(pattern, 7);
+  bitmap_add(pattern, 65535);
+
+  // Spans three blocks, trimmed at both ends
+  bitmap_t *r = bitmap_tile(pattern, 5, 2 * 65536 + 8);
+  TEST_ASSERT_NOT_NULL(r);
+  TEST_ASSERT_EQUAL_UINT32(7, bitmap_get_cardinality(r));
+  TEST_ASSERT_FALSE(bitmap_contains(r, 0));
+  TEST_ASSERT_TRUE(bitmap_contains(r, 7));
+  TEST_ASSERT_TRUE(bitmap_contains(r, 65535));
+  TEST_ASSERT_TRUE(bitmap_contains(r, 65536 + 7));
+  TEST_ASSERT_TRUE(bitmap_contains(r, 2 * 65536));
+  TEST_ASSERT_TRUE(bitmap_contains(r, 2 * 65536 + 7));
+  TEST_ASSERT_FALSE(bitmap_contains(r, 2 * 65536 + 65535));
+  bitmap_free(r);
+
+  r = bitmap_tile(pattern, 10, 10);
+  TEST_ASSERT_NOT_NULL(r);
+  TEST_ASSERT_TRUE(bitmap_is_empty(r));
+  bitmap_free(r);
+
+  TEST_ASSERT_NULL(bitmap_tile(NULL, 0, 10));
+  bitmap_free(pattern);
+}
+
+void test_bitmap_and_tiled_inplace(void) {
+  bitmap_t *pattern = bitmap_create();
+  bitmap_add(pattern, 7);
+  bitmap_add(pattern, 65535);
+
+  bitmap_t *bm = bitmap_create();
+  bitmap_add(bm, 6);
+  bitmap_add(bm, 7);
+  bitmap_add(bm, 5 * 65536 + 7);
+  bitmap_add(bm, 5 * 65536 + 8);
+  bitmap_add(bm, UINT32_MAX);
+  TEST_ASSERT_TRUE(
+      bitmap_and_tiled_inplace(bm, pattern, 0, (uint64_t)UINT32_MAX + 1));
+  TEST_ASSERT_EQUAL_UINT32(3, bitmap_get_cardinality(bm));
+  TEST_ASSERT_TRUE(bitmap_contains(bm, 7));
+  TEST_ASSERT_TRUE(bitmap_contains(bm, 5 * 65536 + 7));
+  TEST_ASSERT_TRUE(bitmap_contains(bm, UINT32_MAX));
+  // Trimmed at both ends
+  TEST_ASSERT_TRUE(bitmap_and_tiled_inplace(bm, pattern, 8, UINT32_MAX));
+  TEST_ASSERT_EQUAL_UINT32(1, bitmap_get_cardinality(bm));
+  TEST_ASSERT_TRUE(bitmap_contains(bm, 5 * 65536 + 7));
+  bitmap_free(bm);
+
+  bitmap_t *empty = bitmap_create();
+  TEST_ASSERT_TRUE(bitmap_and_tiled_inplace(empty, pattern, 0, 10));
+  TEST_ASSERT_TRUE(bitmap_is_empty(empty));
+  TEST_ASSERT_FALSE(bitmap_and_tiled_inplace(empty, NULL, 0, 10));
+  bitmap_free(empty);
+  bitmap_free(pattern);
+}
+
 void test_bitmap_xor_basic(void) {
   bitmap_t *bm1 = bitmap_create();
   bitmap_t *bm2 = bitmap_create();
@@ -535,6 +762,65 @@ void test_bitmap_not_inplace(void) {
   bitmap_free(bm2);
 }
 
+void test_bitmap_and_cardinality(void) {
+  bitmap_t *bm1 = bitmap_create();
+  bitmap_t *bm2 = bitmap_create();
+  for (uint32_t i = 0; i < 100; i++) {
+    bitmap_add(bm1, i);
+    bitmap_add(bm2, i * 2);
+  }
+  TEST_ASSERT_EQUAL_UINT64(50, bitmap_and_cardinality(bm1, bm2));
+  TEST_ASSERT_EQUAL_UINT64(0, bitmap_and_cardinality(bm1, NULL));
+  bitmap_free(bm1);
+  bitmap_free(bm2);
+}
+
+void test_bitmap_range_cardinality(void) {
+  bitmap_t *bm = bitmap_create();
+  for (uint32_t i = 0; i < 100; i++) {
+    bitmap_add(bm, i * 2);
+  }
+  bitmap_add(bm, UINT32_MAX);
+  TEST_ASSERT_EQUAL_UINT64(5, bitmap_range_cardinality(bm, 0, 10));
+  TEST_ASSERT_EQUAL_UINT64(1, bitmap_range_cardinality(bm, 9, 11));
+  TEST_ASSERT_EQUAL_UINT64(0, bitmap_range_cardinality(bm, 10, 10));
+  // The end is exclusive, past the last 32-bit value
+  TEST_ASSERT_EQUAL_UINT64(
+      1, bitmap_range_cardinality(bm, 200, (uint64_t)UINT32_MAX + 1));
+  bitmap_free(bm);
+}
+
+void test_bitmap_page_leaves_source(void) {
+  bitmap_t *bm = bitmap_create();
+  for (uint32_t i = 1; i <= 1000; i++) {
+    bitmap_add(bm, i * 3);
+  }
+  uint32_t next = 0;
+  bitmap_t *page = bitmap_page(bm, 300, 0, &next);
+  TEST_ASSERT_NOT_NULL(page);
+  TEST_ASSERT_EQUAL_UINT64(300, bitmap_get_cardinality(page));
+  TEST_ASSERT_EQUAL_UINT32(903, next);
+  bitmap_free(page);
+
+  // Last page, the cursor need not be a member
+  page = bitmap_page(bm, 300, 2902, &next);
+  TEST_ASSERT_EQUAL_UINT64(33, bitmap_get_cardinality(page));
+  TEST_ASSERT_TRUE(bitmap_contains(page, 2904));
+  TEST_ASSERT_EQUAL_UINT32(0, next);
+  bitmap_free(page);
+
+  // Exactly the rest
+  page = bitmap_page(bm, 2, 2997, &next);
+  TEST_ASSERT_EQUAL_UINT64(2, bitmap_get_cardinality(page));
+  TEST_ASSERT_EQUAL_UINT32(0, next);
+  bitmap_free(page);
+
+  TEST_ASSERT_EQUAL_UINT64(1000, bitmap_get_cardinality(bm));
+  TEST_ASSERT_EQUAL_size_t(roaring_bitmap_portable_size_in_bytes(bm->rb),
+                           bitmap_size_in_bytes(bm));
+  bitmap_free(bm);
+}
+
 void test_bitmap_op_null_inputs(void) {
   // All ops should return NULL or do nothing if any input is NULL
   TEST_ASSERT_NULL(bitmap_and(NULL, NULL));
@@ -599,12 +885,17 @@ int main(void) {
   RUN_TEST(test_bitmap_serialize_empty_bitmap);
   RUN_TEST(test_bitmap_serialize_populated_bitmap);
   RUN_TEST(test_bitmap_serialize_null_inputs);
+  RUN_TEST(test_bitmap_serialize_portable_roundtrip);
 
   // bitmap_deserialize tests
   RUN_TEST(test_bitmap_deserialize_empty_bitmap);
   RUN_TEST(test_bitmap_deserialize_populated_bitmap);
   RUN_TEST(test_bitmap_deserialize_null_buffer);
   RUN_TEST(test_bitmap_deserialize_invalid_size);
+  RUN_TEST(test_bitmap_view_in_place);
+  RUN_TEST(test_bitmap_view_unaligned);
+  RUN_TEST(test_bitmap_view_rejects_truncated);
+  RUN_TEST(test_bitmap_reads_portable_format);
 
   // Round-trip tests
   RUN_TEST(test_bitmap_serialize_deserialize_roundtrip);
@@ -616,12 +907,18 @@ int main(void) {
   // bitmap operation tests
   RUN_TEST(test_bitmap_and_basic);
   RUN_TEST(test_bitmap_or_basic);
+  RUN_TEST(test_bitmap_or_many);
+  RUN_TEST(test_bitmap_tile);
+  RUN_TEST(test_bitmap_and_tiled_inplace);
   RUN_TEST(test_bitmap_xor_basic);
   RUN_TEST(test_bitmap_not_basic);
   RUN_TEST(test_bitmap_and_inplace);
   RUN_TEST(test_bitmap_or_inplace);
   RUN_TEST(test_bitmap_xor_inplace);
   RUN_TEST(test_bitmap_not_inplace);
+  RUN_TEST(test_bitmap_and_cardinality);
+  RUN_TEST(test_bitmap_range_cardinality);
+  RUN_TEST(test_bitmap_page_leaves_source);
   RUN_TEST(test_bitmap_op_null_inputs);
 
   return UNITY_END();
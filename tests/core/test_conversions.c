@@ -249,6 +249,31 @@ void test_conv_uint32_to_string_return_value_matches_strlen(void) {
 }
 
 // Main test runner
+void test_conv_duration_to_ms_units(void) {
+  uint64_t ms = 0;
+  TEST_ASSERT_TRUE(conv_duration_to_ms("500ms", &ms));
+  TEST_ASSERT_EQUAL_UINT64(500, ms);
+  TEST_ASSERT_TRUE(conv_duration_to_ms("30s", &ms));
+  TEST_ASSERT_EQUAL_UINT64(30000, ms);
+  TEST_ASSERT_TRUE(conv_duration_to_ms("1m", &ms));
+  TEST_ASSERT_EQUAL_UINT64(60000, ms);
+  TEST_ASSERT_TRUE(conv_duration_to_ms("2h", &ms));
+  TEST_ASSERT_EQUAL_UINT64(7200000, ms);
+  TEST_ASSERT_TRUE(conv_duration_to_ms("1d", &ms));
+  TEST_ASSERT_EQUAL_UINT64(86400000, ms);
+}
+
+void test_conv_duration_to_ms_invalid(void) {
+  uint64_t ms = 0;
+  TEST_ASSERT_FALSE(conv_duration_to_ms("0m", &ms));
+  TEST_ASSERT_FALSE(conv_duration_to_ms("m", &ms));
+  TEST_ASSERT_FALSE(conv_duration_to_ms("5", &ms));
+  TEST_ASSERT_FALSE(conv_duration_to_ms("5w", &ms));
+  TEST_ASSERT_FALSE(conv_duration_to_ms("1.5h", &ms));
+  TEST_ASSERT_FALSE(conv_duration_to_ms("99999999999999999999d", &ms));
+  TEST_ASSERT_FALSE(conv_duration_to_ms(NULL, &ms));
+}
+
 int main(void) {
   UNITY_BEGIN();
 
@@ -285,5 +310,9 @@ int main(void) {
   RUN_TEST(test_conv_uint32_to_string_no_buffer_overflow);
   RUN_TEST(test_conv_uint32_to_string_return_value_matches_strlen);
 
+  // Durations
+  RUN_TEST(test_conv_duration_to_ms_units);
+  RUN_TEST(test_conv_duration_to_ms_invalid);
+
   return UNITY_END();
 }
\ No newline at end of file
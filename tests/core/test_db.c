@@ -320,6 +320,42 @@ void test_db_put_get_binary_data(void) {
   db_abort_txn(get_txn);
 }
 
+void test_db_get_view(void) {
+  MDB_txn *put_txn = db_create_txn(test_env, false);
+  TEST_ASSERT_NOT_NULL(put_txn);
+
+  // Large enough to land on an overflow page
+  size_t size = 16 * 1024;
+  char *data = malloc(size);
+  TEST_ASSERT_NOT_NULL(data);
+  for (size_t i = 0; i < size; i++) {
+    data[i] = (char)(i % 251);
+  }
+  db_key_t key = {.type = DB_KEY_STRING, .key.s = "view_key"};
+  TEST_ASSERT_EQUAL(DB_PUT_OK,
+                    db_put(test_db, put_txn, &key, data, size, true, false));
+
+  MDB_txn *get_txn = db_create_txn(test_env, true);
+  TEST_ASSERT_NOT_NULL(get_txn);
+
+  db_get_result_t result;
+  TEST_ASSERT_TRUE(db_get_view(test_db, get_txn, &key, &result));
+  TEST_ASSERT_EQUAL(DB_GET_OK, result.status);
+  TEST_ASSERT_EQUAL(size, result.value_len);
+  TEST_ASSERT_EQUAL_MEMORY(data, result.value, size);
+  // Overflow values start right after the 16 byte page header, which
+  // bitmap_view relies on for in-place frozen views
+  TEST_ASSERT_EQUAL_UINT(16, (uintptr_t)result.value % 32);
+
+  db_key_t missing = {.type = DB_KEY_STRING, .key.s = "view_missing"};
+  TEST_ASSERT_TRUE(db_get_view(test_db, get_txn, &missing, &result));
+  TEST_ASSERT_EQUAL(DB_GET_NOT_FOUND, result.status);
+  TEST_ASSERT_NULL(result.value);
+
+  db_abort_txn(get_txn);
+  free(data);
+}
+
 // Test large data storage
 void test_db_put_get_large_data(void) {
   MDB_txn *put_txn = db_create_txn(test_env, false);
@@ -429,6 +465,62 @@ void test_db_put_overwrite_value(void) {
   db_abort_txn(get_txn);
 }
 
+void test_db_delete(void) {
+  MDB_txn *txn = db_create_txn(test_env, false);
+  TEST_ASSERT_NOT_NULL(txn);
+  db_key_t key = {.type = DB_KEY_STRING, .key.s = "delete_key"};
+  const char *value = "value";
+  TEST_ASSERT_EQUAL(DB_PUT_OK,
+                    db_put(test_db, txn, &key, value, strlen(value), false,
+                           false));
+  TEST_ASSERT_TRUE(db_delete(test_db, txn, &key));
+  // Missing keys are not an error
+  TEST_ASSERT_TRUE(db_delete(test_db, txn, &key));
+  TEST_ASSERT_FALSE(db_delete(test_db, NULL, &key));
+  TEST_ASSERT_TRUE(db_commit_txn(txn));
+
+  MDB_txn *get_txn = db_create_txn(test_env, true);
+  db_get_result_t result;
+  TEST_ASSERT_TRUE(db_get(test_db, get_txn, &key, &result));
+  TEST_ASSERT_EQUAL(DB_GET_NOT_FOUND, result.status);
+  db_abort_txn(get_txn);
+}
+
+void test_db_put_append(void) {
+  MDB_dbi dup_db;
+  TEST_ASSERT_TRUE(
+      db_open(test_env, "dup_db", false, DB_DUP_KEYS_FIXED_SIZE_VALS, &dup_db));
+  MDB_txn *txn = db_create_txn(test_env, false);
+  TEST_ASSERT_NOT_NULL(txn);
+
+  db_key_t a = {.type = DB_KEY_STRING, .key.s = "a"};
+  db_key_t b = {.type = DB_KEY_STRING, .key.s = "b"};
+  uint32_t v1 = 1, v2 = 2;
+  TEST_ASSERT_EQUAL(DB_PUT_OK,
+                    db_put_append(dup_db, txn, &a, &v1, sizeof(v1), false));
+  TEST_ASSERT_EQUAL(DB_PUT_OK,
+                    db_put_append(dup_db, txn, &a, &v2, sizeof(v2), true));
+  TEST_ASSERT_EQUAL(DB_PUT_OK,
+                    db_put_append(dup_db, txn, &b, &v1, sizeof(v1), false));
+  // Out of order: a key before the last one, a value before the last one
+  TEST_ASSERT_EQUAL(DB_PUT_KEY_EXISTS,
+                    db_put_append(dup_db, txn, &a, &v1, sizeof(v1), false));
+  TEST_ASSERT_EQUAL(DB_PUT_KEY_EXISTS,
+                    db_put_append(dup_db, txn, &b, &v1, sizeof(v1), true));
+  TEST_ASSERT_TRUE(db_commit_txn(txn));
+
+  MDB_txn *get_txn = db_create_txn(test_env, true);
+  MDB_cursor *cursor = db_cursor_open(get_txn, dup_db);
+  db_cursor_entry_t entry;
+  uint32_t count = 0;
+  while (db_cursor_get(cursor, &entry, MDB_NEXT, NULL) == DB_CURSOR_OK) {
+    count++;
+  }
+  TEST_ASSERT_EQUAL_UINT32(3, count);
+  db_cursor_close(cursor);
+  db_abort_txn(get_txn);
+}
+
 // Test db_get_result_clear
 void test_db_get_result_clear_null(void) {
   // Should not crash
@@ -850,9 +942,12 @@ int main(void) {
 
   // Advanced functionality tests
   RUN_TEST(test_db_put_get_binary_data);
+  RUN_TEST(test_db_get_view);
   RUN_TEST(test_db_put_get_large_data);
   RUN_TEST(test_db_integer_key_ordering);
   RUN_TEST(test_db_put_overwrite_value);
+  RUN_TEST(test_db_delete);
+  RUN_TEST(test_db_put_append);
 
   // Memory management tests
   RUN_TEST(test_db_get_result_clear_null);
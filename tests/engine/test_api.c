@@ -1,5 +1,6 @@
 #include "engine/api.h"
 #include "engine/engine.h"
+#include "engine/subscription/subscription.h"
 #include "query/ast.h"
 #include "query/parser.h"
 #include "query/tokenizer.h"
@@ -30,7 +31,9 @@ void eng_event(api_response_t *resp, ast_node_t *ast, int64_t arrival_ts) {
   resp->op_type = API_EVENT;
 }
 
-void eng_query(api_response_t *resp, ast_node_t *ast) {
+void eng_query(api_response_t *resp, ast_node_t *ast,
+               const atomic_int *alive) {
+  (void)alive;
   mock_state.called++;
   mock_state.last_ast = ast;
   resp->is_ok = true;
@@ -46,6 +49,87 @@ void eng_index(api_response_t *resp, ast_node_t *ast) {
   resp->op_type = API_INDEX;
 }
 
+void eng_create_view(api_response_t *resp, ast_node_t *ast) {
+  mock_state.called++;
+  mock_state.last_ast = ast;
+  resp->is_ok = true;
+  resp->err_msg = NULL;
+  resp->op_type = API_CREATE_VIEW;
+}
+
+void eng_subscribe(api_response_t *resp, ast_node_t *ast) {
+  mock_state.called++;
+  mock_state.last_ast = ast;
+  resp->is_ok = true;
+  resp->err_msg = NULL;
+  resp->op_type = API_SUBSCRIBE;
+}
+
+void eng_show(api_response_t *resp, ast_node_t *ast) {
+  mock_state.called++;
+  mock_state.last_ast = ast;
+  resp->is_ok = true;
+  resp->err_msg = NULL;
+  resp->op_type = API_SHOW;
+}
+
+void eng_top(api_response_t *resp, ast_node_t *ast, const atomic_int *alive) {
+  (void)alive;
+  mock_state.called++;
+  mock_state.last_ast = ast;
+  resp->is_ok = true;
+  resp->err_msg = NULL;
+  resp->op_type = API_TOP;
+}
+
+void eng_histogram(api_response_t *resp, ast_node_t *ast,
+                   const atomic_int *alive) {
+  (void)alive;
+  mock_state.called++;
+  mock_state.last_ast = ast;
+  resp->is_ok = true;
+  resp->err_msg = NULL;
+  resp->op_type = API_HISTOGRAM;
+}
+
+void eng_funnel(api_response_t *resp, ast_node_t *ast,
+                const atomic_int *alive) {
+  (void)alive;
+  mock_state.called++;
+  mock_state.last_ast = ast;
+  resp->is_ok = true;
+  resp->err_msg = NULL;
+  resp->op_type = API_FUNNEL;
+}
+
+void eng_entities(api_response_t *resp, ast_node_t *ast,
+                  const atomic_int *alive) {
+  (void)alive;
+  mock_state.called++;
+  mock_state.last_ast = ast;
+  resp->is_ok = true;
+  resp->err_msg = NULL;
+  resp->op_type = API_ENTITIES;
+}
+
+void eng_create_rollup(api_response_t *resp, ast_node_t *ast) {
+  mock_state.called++;
+  mock_state.last_ast = ast;
+  resp->is_ok = true;
+  resp->err_msg = NULL;
+  resp->op_type = API_CREATE_ROLLUP;
+}
+
+void eng_rollup(api_response_t *resp, ast_node_t *ast) {
+  mock_state.called++;
+  mock_state.last_ast = ast;
+  resp->is_ok = true;
+  resp->err_msg = NULL;
+  resp->op_type = API_ROLLUP;
+}
+
+void sub_release(sub_t *sub) { (void)sub; }
+
 bool eng_init(void) { return true; }
 
 void eng_shutdown(void) {}
@@ -83,7 +167,7 @@ static api_response_t *_exec_from_string(const char *input, int64_t ts) {
   }
 
   // 3. Execute API with real AST
-  return api_exec(last_parse_res->ast, ts);
+  return api_exec(last_parse_res->ast, ts, NULL);
 }
 
 // --- Tests ---
@@ -127,6 +211,31 @@ void test_api_index_success(void) {
   free_api_response(resp);
 }
 
+void test_api_create_view_success(void) {
+  api_response_t *resp = _exec_from_string(
+      "create view errors in:metrics where:(status:error)", 0);
+
+  TEST_ASSERT_NOT_NULL(resp);
+  TEST_ASSERT_TRUE(resp->is_ok);
+  TEST_ASSERT_EQUAL(API_CREATE_VIEW, resp->op_type);
+  TEST_ASSERT_EQUAL(1, mock_state.called);
+
+  free_api_response(resp);
+}
+
+void test_api_create_view_invalid_nested_view(void) {
+  api_response_t *resp = _exec_from_string(
+      "create view v2 in:metrics where:(view:errors)", 0);
+
+  TEST_ASSERT_NOT_NULL(resp);
+  TEST_ASSERT_FALSE(resp->is_ok);
+  TEST_ASSERT_EQUAL_STRING("Views cannot reference other views",
+                           resp->err_msg);
+  TEST_ASSERT_EQUAL(0, mock_state.called);
+
+  free_api_response(resp);
+}
+
 void test_api_event_invalid_ast_missing_in(void) {
   // Grammatically valid (Parser OK), Semantically invalid (Validator Fail)
   api_response_t *resp = _exec_from_string("event entity:user-1", 0);
@@ -226,7 +335,7 @@ void test_api_event_invalid_ast_where_tag(void) {
 // We cannot use the parser for this, as the parser always returns a valid
 // result or error.
 void test_api_event_invalid_ast_null(void) {
-  api_response_t *resp = api_exec(NULL, 0);
+  api_response_t *resp = api_exec(NULL, 0, NULL);
   TEST_ASSERT_NOT_NULL(resp);
   TEST_ASSERT_FALSE(resp->is_ok);
   free_api_response(resp);
@@ -237,6 +346,8 @@ int main(void) {
   RUN_TEST(test_api_event_success);
   RUN_TEST(test_api_query_success);
   RUN_TEST(test_api_index_success);
+  RUN_TEST(test_api_create_view_success);
+  RUN_TEST(test_api_create_view_invalid_nested_view);
   RUN_TEST(test_api_event_invalid_ast_missing_in);
   RUN_TEST(test_api_event_invalid_ast_missing_entity);
   RUN_TEST(test_api_query_invalid_missing_where);
@@ -0,0 +1,274 @@
+#include "core/bitmaps.h"
+#include "core/db.h"
+#include "core/mmap_array.h"
+#include "engine/bulk_load/bulk_load.h"
+#include "engine/container/container_db.h"
+#include "engine/container/container_types.h"
+#include "engine/eng_key_format/eng_key_format.h"
+#include "lmdb.h"
+#include "mpack.h"
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TEST_DATA_DIR "test_bulk_load_data"
+#define TEST_CONTAINER_SIZE (10 * 1024 * 1024) // 10MB
+
+static eng_container_t *g_sys_c = NULL;
+
+static void _remove_files(void) {
+  const char *names[] = {"system.mdb",       "system.mdb-lock",
+                         "system_ent.bin",   "loaded.mdb",
+                         "loaded.mdb-lock",  "loaded_evt_ent.bin",
+                         "loaded.load.mdb",  "loaded.load.mdb-lock",
+                         "loaded.load_evt_ent.bin", NULL};
+  char path[256];
+  for (int i = 0; names[i]; i++) {
+    snprintf(path, sizeof(path), "%s/%s", TEST_DATA_DIR, names[i]);
+    unlink(path);
+  }
+  rmdir(TEST_DATA_DIR);
+}
+
+static bool _exists(const char *file) {
+  char path[256];
+  snprintf(path, sizeof(path), "%s/%s", TEST_DATA_DIR, file);
+  return access(path, F_OK) == 0;
+}
+
+void setUp(void) {
+  _remove_files();
+  mkdir(TEST_DATA_DIR, 0700);
+  container_result_t cr =
+      create_system_container(TEST_DATA_DIR, TEST_CONTAINER_SIZE);
+  TEST_ASSERT_TRUE(cr.success);
+  g_sys_c = cr.container;
+}
+
+void tearDown(void) {
+  container_close(g_sys_c);
+  g_sys_c = NULL;
+  _remove_files();
+}
+
+static FILE *_file_of(const void *data, size_t size) {
+  FILE *f = tmpfile();
+  TEST_ASSERT_NOT_NULL(f);
+  TEST_ASSERT_EQUAL_size_t(size, fwrite(data, 1, size, f));
+  rewind(f);
+  return f;
+}
+
+// Loads `data` into "loaded"
+static bool _load(const char *data, size_t size, bulk_load_format_t format,
+                  bulk_load_stats_t *stats_out, const char **err_out,
+                  uint64_t *record_out) {
+  bulk_load_t *bl =
+      bulk_load_begin(TEST_DATA_DIR, "loaded", g_sys_c, err_out);
+  if (!bl) {
+    return false;
+  }
+  FILE *f = _file_of(data, size);
+  bool ok = bulk_load_read(bl, f, format, err_out, record_out);
+  fclose(f);
+  if (!ok) {
+    bulk_load_abort(bl);
+    return false;
+  }
+  return bulk_load_finish(bl, stats_out, err_out);
+}
+
+static bool _load_ndjson(const char *ndjson, bulk_load_stats_t *stats_out) {
+  const char *err = NULL;
+  uint64_t record = 0;
+  return _load(ndjson, strlen(ndjson), BULK_LOAD_NDJSON, stats_out, &err,
+               &record);
+}
+
+static eng_container_t *_open_loaded(void) {
+  container_result_t cr = open_user_container(
+      "loaded", TEST_DATA_DIR, TEST_CONTAINER_SIZE, g_sys_c, NULL, false);
+  TEST_ASSERT_TRUE(cr.success);
+  return cr.container;
+}
+
+// The inverted index bitmap of `key`, NULL if there is none
+static bitmap_t *_bitmap(eng_container_t *c, MDB_txn *txn, char *key) {
+  db_key_t k = {.type = DB_KEY_STRING, .key.s = key};
+  db_get_result_t r;
+  TEST_ASSERT_TRUE(
+      db_get_view(c->data.usr->inverted_event_index_db, txn, &k, &r));
+  if (r.status != DB_GET_OK) {
+    return NULL;
+  }
+  return bitmap_deserialize(r.value, r.value_len);
+}
+
+static uint32_t _u32(MDB_dbi db, MDB_txn *txn, db_key_t *key) {
+  db_get_result_t r;
+  TEST_ASSERT_TRUE(db_get_view(db, txn, key, &r));
+  TEST_ASSERT_EQUAL(DB_GET_OK, r.status);
+  uint32_t v;
+  memcpy(&v, r.value, sizeof(uint32_t));
+  return v;
+}
+
+static const char *NDJSON =
+    "{\"entity\":\"alice\",\"ts\":1000,\"plan\":\"paid\",\"amount\":5}\n"
+    "\n"
+    "{\"entity\":\"bob\",\"ts\":2000,\"plan\":\"free\",\"id\":9,\"n\":null}\n"
+    "{\"entity\":7,\"Plan\":\"paid\",\"price\":9.50,\"ok\":true}\n"
+    "{\"entity\":\"alice\",\"plan\":\"paid\"}\n";
+
+void test_loads_ndjson(void) {
+  bulk_load_stats_t stats = {0};
+  TEST_ASSERT_TRUE(_load_ndjson(NDJSON, &stats));
+  TEST_ASSERT_EQUAL_UINT64(4, stats.events);
+  TEST_ASSERT_EQUAL_UINT64(3, stats.new_entities);
+  TEST_ASSERT_FALSE(_exists("loaded.load.mdb"));
+
+  eng_container_t *c = _open_loaded();
+  MDB_txn *txn = db_create_txn(c->env, true);
+  MDB_stat st;
+  TEST_ASSERT_EQUAL(0, mdb_stat(txn, c->data.usr->events_db, &st));
+  TEST_ASSERT_EQUAL(4, st.ms_entries);
+
+  // Keys are lowercased as a query names them
+  bitmap_t *bm = _bitmap(c, txn, "plan:paid");
+  TEST_ASSERT_NOT_NULL(bm);
+  TEST_ASSERT_EQUAL_UINT64(3, bitmap_get_cardinality(bm));
+  TEST_ASSERT_TRUE(bitmap_contains(bm, 1));
+  TEST_ASSERT_TRUE(bitmap_contains(bm, 3));
+  TEST_ASSERT_TRUE(bitmap_contains(bm, 4));
+  bitmap_free(bm);
+  bm = _bitmap(c, txn, "price:9.50");
+  TEST_ASSERT_NOT_NULL(bm);
+  TEST_ASSERT_TRUE(bitmap_contains(bm, 3));
+  bitmap_free(bm);
+  bm = _bitmap(c, txn, "ok:true");
+  TEST_ASSERT_NOT_NULL(bm);
+  bitmap_free(bm);
+  TEST_ASSERT_NULL(_bitmap(c, txn, "id:9"));
+
+  db_key_t key = {.type = DB_KEY_STRING, .key.s = USR_NEXT_EVENT_ID_KEY};
+  TEST_ASSERT_EQUAL_UINT32(5,
+                           _u32(c->data.usr->user_dc_metadata_db, txn, &key));
+
+  // alice's events share her entity id, which the system container maps
+  uint32_t *first = MMAP_ARRAY_GET_AS(&c->data.usr->event_to_entity_map, 1,
+                                      uint32_t);
+  uint32_t *last = MMAP_ARRAY_GET_AS(&c->data.usr->event_to_entity_map, 4,
+                                     uint32_t);
+  TEST_ASSERT_EQUAL_UINT32(*first, *last);
+  char ent_key[64];
+  TEST_ASSERT_TRUE(entity_events_key_into(ent_key, sizeof(ent_key), *first));
+  bm = _bitmap(c, txn, ent_key);
+  TEST_ASSERT_NOT_NULL(bm);
+  TEST_ASSERT_EQUAL_UINT64(2, bitmap_get_cardinality(bm));
+  bitmap_free(bm);
+  db_abort_txn(txn);
+
+  MDB_txn *sys_txn = db_create_txn(g_sys_c->env, true);
+  key.key.s = "alice";
+  TEST_ASSERT_EQUAL_UINT32(
+      *first, _u32(g_sys_c->data.sys->str_to_entity_id_db, sys_txn, &key));
+  db_abort_txn(sys_txn);
+  container_close(c);
+}
+
+void test_loads_msgpack(void) {
+  char *data = NULL;
+  size_t size = 0;
+  mpack_writer_t writer;
+  mpack_writer_init_growable(&writer, &data, &size);
+  for (int i = 0; i < 3; i++) {
+    mpack_build_map(&writer);
+    mpack_write_cstr(&writer, "entity");
+    mpack_write_int(&writer, 100 + i);
+    mpack_write_cstr(&writer, "ts");
+    mpack_write_int(&writer, 1000 + i);
+    mpack_write_cstr(&writer, "score");
+    mpack_write_double(&writer, 0.25);
+    mpack_write_cstr(&writer, "even");
+    mpack_write_bool(&writer, i % 2 == 0);
+    mpack_complete_map(&writer);
+  }
+  TEST_ASSERT_EQUAL(mpack_ok, mpack_writer_destroy(&writer));
+
+  bulk_load_stats_t stats = {0};
+  const char *err = NULL;
+  uint64_t record = 0;
+  bool ok = _load(data, size, BULK_LOAD_MSGPACK, &stats, &err, &record);
+  free(data);
+  TEST_ASSERT_TRUE(ok);
+  TEST_ASSERT_EQUAL_UINT64(3, stats.events);
+  TEST_ASSERT_EQUAL_UINT64(3, stats.new_entities);
+
+  eng_container_t *c = _open_loaded();
+  MDB_txn *txn = db_create_txn(c->env, true);
+  bitmap_t *bm = _bitmap(c, txn, "score:0.25");
+  TEST_ASSERT_NOT_NULL(bm);
+  TEST_ASSERT_EQUAL_UINT64(3, bitmap_get_cardinality(bm));
+  bitmap_free(bm);
+  bm = _bitmap(c, txn, "even:true");
+  TEST_ASSERT_NOT_NULL(bm);
+  TEST_ASSERT_EQUAL_UINT64(2, bitmap_get_cardinality(bm));
+  bitmap_free(bm);
+  db_abort_txn(txn);
+  container_close(c);
+}
+
+void test_invalid_record_leaves_nothing(void) {
+  const char *ndjson = "{\"entity\":\"a\",\"plan\":\"paid\"}\n"
+                       "\n"
+                       "{\"entity\":\"b\",\"nested\":{\"x\":1}}\n";
+  const char *err = NULL;
+  uint64_t record = 0;
+  TEST_ASSERT_FALSE(_load(ndjson, strlen(ndjson), BULK_LOAD_NDJSON, NULL,
+                          &err, &record));
+  TEST_ASSERT_EQUAL_UINT64(3, record);
+  TEST_ASSERT_EQUAL_STRING("Nested values are not supported", err);
+  TEST_ASSERT_FALSE(_exists("loaded.mdb"));
+  TEST_ASSERT_FALSE(_exists("loaded.load.mdb"));
+  TEST_ASSERT_FALSE(_exists("loaded.load_evt_ent.bin"));
+
+  TEST_ASSERT_FALSE(_load("{\"plan\":\"paid\"}", 15, BULK_LOAD_NDJSON, NULL,
+                          &err, &record));
+  TEST_ASSERT_EQUAL_UINT64(1, record);
+  TEST_ASSERT_FALSE(_load("{\"entity\":\"a\",\"bad key\":1}", 26,
+                          BULK_LOAD_NDJSON, NULL, &err, &record));
+  TEST_ASSERT_EQUAL_STRING("Invalid key", err);
+}
+
+void test_refuses_existing_container(void) {
+  TEST_ASSERT_TRUE(_load_ndjson(NDJSON, NULL));
+  const char *err = NULL;
+  TEST_ASSERT_NULL(bulk_load_begin(TEST_DATA_DIR, "loaded", g_sys_c, &err));
+  TEST_ASSERT_EQUAL_STRING("Container already exists", err);
+}
+
+void test_reuses_entity_ids_of_system(void) {
+  TEST_ASSERT_TRUE(_load_ndjson("{\"entity\":\"alice\"}\n", NULL));
+  char path[256];
+  snprintf(path, sizeof(path), "%s/loaded.mdb", TEST_DATA_DIR);
+  unlink(path);
+  snprintf(path, sizeof(path), "%s/loaded_evt_ent.bin", TEST_DATA_DIR);
+  unlink(path);
+
+  bulk_load_stats_t stats = {0};
+  TEST_ASSERT_TRUE(_load_ndjson(NDJSON, &stats));
+  TEST_ASSERT_EQUAL_UINT64(2, stats.new_entities);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_loads_ndjson);
+  RUN_TEST(test_loads_msgpack);
+  RUN_TEST(test_invalid_record_leaves_nothing);
+  RUN_TEST(test_refuses_existing_container);
+  RUN_TEST(test_reuses_entity_ids_of_system);
+  return UNITY_END();
+}
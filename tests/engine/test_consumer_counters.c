@@ -0,0 +1,108 @@
+#include "engine/consumer/consumer_counters.h"
+#include "engine/container/container_types.h"
+#include "engine/engine_writer/engine_writer_queue_msg.h"
+#include "unity.h"
+#include <stdlib.h>
+#include <string.h>
+
+void container_free_db_key_contents(eng_container_db_key_t *db_key) {
+  free(db_key->container_name);
+  if (db_key->db_key.type == DB_KEY_STRING) {
+    free(db_key->db_key.key.s);
+  }
+}
+
+void sub_push_free(sub_push_t *push) { (void)push; }
+
+static consumer_counters_t counters;
+
+void setUp(void) { memset(&counters, 0, sizeof(counters)); }
+
+void tearDown(void) { consumer_counters_clear(&counters); }
+
+static eng_container_db_key_t _row(const char *row_key) {
+  eng_container_db_key_t k = {0};
+  k.dc_type = CONTAINER_TYPE_USR;
+  k.usr_db_type = USR_DB_ROLLUP;
+  k.container_name = "shop";
+  k.db_key.type = DB_KEY_STRING;
+  k.db_key.key.s = (char *)row_key;
+  return k;
+}
+
+static const eng_writer_entry_t *_entry_for(const eng_writer_msg_t *msg,
+                                            const char *row_key) {
+  for (uint32_t i = 0; i < msg->count; i++) {
+    if (strcmp(msg->entries[i].db_key.db_key.key.s, row_key) == 0) {
+      return &msg->entries[i];
+    }
+  }
+  return NULL;
+}
+
+void test_sums_deltas_per_row(void) {
+  eng_container_db_key_t a = _row("action|1000|0|buy");
+  eng_container_db_key_t b = _row("action|1000|0|view");
+  TEST_ASSERT_TRUE(consumer_counters_add(&counters, "shop|a", &a, 1));
+  TEST_ASSERT_TRUE(consumer_counters_add(&counters, "shop|b", &b, 2));
+  TEST_ASSERT_TRUE(consumer_counters_add(&counters, "shop|a", &a, 3));
+  TEST_ASSERT_EQUAL_UINT32(2, counters.count);
+
+  consumer_flush_result_t fr = consumer_counters_flush_prepare(&counters);
+  TEST_ASSERT_TRUE(fr.success);
+  TEST_ASSERT_NOT_NULL(fr.msg);
+  TEST_ASSERT_EQUAL_UINT32(2, fr.entries_prepared);
+  TEST_ASSERT_EQUAL_UINT32(0, fr.entries_skipped);
+
+  const eng_writer_entry_t *ea = _entry_for(fr.msg, "action|1000|0|buy");
+  const eng_writer_entry_t *eb = _entry_for(fr.msg, "action|1000|0|view");
+  TEST_ASSERT_NOT_NULL(ea);
+  TEST_ASSERT_NOT_NULL(eb);
+  TEST_ASSERT_EQUAL(WRITE_COND_ADD_U64, ea->write_condition);
+  TEST_ASSERT_EQUAL_size_t(sizeof(uint64_t), ea->value_size);
+  TEST_ASSERT_EQUAL_UINT64(4, *(uint64_t *)ea->value);
+  TEST_ASSERT_EQUAL_UINT64(2, *(uint64_t *)eb->value);
+  TEST_ASSERT_FALSE(ea->bump_flush_version);
+  TEST_ASSERT_EQUAL(USR_DB_ROLLUP, ea->db_key.usr_db_type);
+  // Entries own copies of the keys
+  TEST_ASSERT_EQUAL_STRING("shop", ea->db_key.container_name);
+  TEST_ASSERT_NOT_EQUAL(a.container_name, ea->db_key.container_name);
+
+  // Preparing keeps the deltas, e.g. for a failed enqueue
+  TEST_ASSERT_EQUAL_UINT32(2, counters.count);
+  eng_writer_queue_free_msg(fr.msg);
+}
+
+void test_clear_drops_deltas(void) {
+  eng_container_db_key_t a = _row("action|1000|0|buy");
+  TEST_ASSERT_TRUE(consumer_counters_add(&counters, "shop|a", &a, 5));
+  consumer_counters_clear(&counters);
+  TEST_ASSERT_EQUAL_UINT32(0, counters.count);
+  TEST_ASSERT_NULL(counters.table);
+
+  consumer_flush_result_t fr = consumer_counters_flush_prepare(&counters);
+  TEST_ASSERT_TRUE(fr.success);
+  TEST_ASSERT_NULL(fr.msg);
+
+  // Deltas start over from zero
+  TEST_ASSERT_TRUE(consumer_counters_add(&counters, "shop|a", &a, 1));
+  fr = consumer_counters_flush_prepare(&counters);
+  TEST_ASSERT_EQUAL_UINT64(1, *(uint64_t *)fr.msg->entries[0].value);
+  eng_writer_queue_free_msg(fr.msg);
+}
+
+void test_invalid_args(void) {
+  eng_container_db_key_t a = _row("x");
+  TEST_ASSERT_FALSE(consumer_counters_add(NULL, "k", &a, 1));
+  TEST_ASSERT_FALSE(consumer_counters_add(&counters, NULL, &a, 1));
+  TEST_ASSERT_FALSE(consumer_counters_add(&counters, "k", NULL, 1));
+  TEST_ASSERT_FALSE(consumer_counters_flush_prepare(NULL).success);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_sums_deltas_per_row);
+  RUN_TEST(test_clear_drops_deltas);
+  RUN_TEST(test_invalid_args);
+  return UNITY_END();
+}
@@ -12,6 +12,8 @@ void container_free_db_key_contents(eng_container_db_key_t db_key) {
   (void)db_key;
 }
 
+void sub_push_free(sub_push_t *push) { (void)push; }
+
 // ============================================================================
 // Test Setup & Teardown Helpers
 // ============================================================================
@@ -149,10 +151,34 @@ void test_flush_prepare_list_with_skips(void) {
   consumer_flush_clear_result(res);
 }
 
+void test_flush_prepare_adds_stats_for_inverted_index(void) {
+  consumer_cache_entry_t *e = create_bm("c1", "loc:ca");
+  e->db_key.dc_type = CONTAINER_TYPE_USR;
+  e->db_key.usr_db_type = USR_DB_INVERTED_EVENT_INDEX;
+  bitmap_add(atomic_load(&e->cc_bitmap)->bitmap, 456);
+
+  consumer_flush_result_t res = consumer_flush_prepare(e, 1);
+  TEST_ASSERT_TRUE(res.success);
+  TEST_ASSERT_EQUAL_UINT32(1, res.entries_prepared);
+  TEST_ASSERT_EQUAL_UINT32(2, res.msg->count);
+
+  // The stats entry follows its bitmap and does not bump the flush version
+  eng_writer_entry_t *stats = &res.msg->entries[1];
+  TEST_ASSERT_EQUAL(USR_DB_TAG_STATS, stats->db_key.usr_db_type);
+  TEST_ASSERT_EQUAL_STRING("c1", stats->db_key.container_name);
+  TEST_ASSERT_EQUAL_STRING("loc:ca", stats->db_key.db_key.key.s);
+  TEST_ASSERT_FALSE(stats->bump_flush_version);
+  TEST_ASSERT_EQUAL_size_t(sizeof(uint64_t), stats->value_size);
+  TEST_ASSERT_EQUAL_UINT64(2, *(uint64_t *)stats->value);
+
+  consumer_flush_clear_result(res);
+}
+
 int main(void) {
   UNITY_BEGIN();
   RUN_TEST(test_flush_prepare_handles_null_or_empty);
   RUN_TEST(test_flush_prepare_deep_copies_bitmaps);
   RUN_TEST(test_flush_prepare_list_with_skips);
+  RUN_TEST(test_flush_prepare_adds_stats_for_inverted_index);
   return UNITY_END();
 }
\ No newline at end of file
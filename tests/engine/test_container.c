@@ -233,6 +233,32 @@ void test_get_user_container_without_sys_txn(void) {
   container_release(result.container);
 }
 
+void test_list_user_containers(void) {
+  container_init(TEST_CACHE_CAPACITY, TEST_DATA_DIR, TEST_CONTAINER_SIZE);
+
+  const char *names[] = {"c1", "c2"};
+  for (int i = 0; i < 2; i++) {
+    container_result_t result = container_get_user(names[i], true, NULL);
+    TEST_ASSERT_TRUE(result.success);
+    container_release(result.container);
+  }
+
+  char **listed = NULL;
+  uint32_t count = 0;
+  TEST_ASSERT_TRUE(container_list_user(&listed, &count));
+  // The system container is not listed
+  TEST_ASSERT_EQUAL_UINT32(2, count);
+  bool seen[2] = {false, false};
+  for (uint32_t i = 0; i < count; i++) {
+    for (int j = 0; j < 2; j++) {
+      seen[j] = seen[j] || strcmp(listed[i], names[j]) == 0;
+    }
+    free(listed[i]);
+  }
+  free(listed);
+  TEST_ASSERT_TRUE(seen[0] && seen[1]);
+}
+
 void test_get_user_container_txn_reuse(void) {
   container_init(TEST_CACHE_CAPACITY, TEST_DATA_DIR, TEST_CONTAINER_SIZE);
 
@@ -786,6 +812,7 @@ int main(void) {
   RUN_TEST(test_get_user_container_success);
   RUN_TEST(test_get_user_container_with_sys_txn);
   RUN_TEST(test_get_user_container_without_sys_txn);
+  RUN_TEST(test_list_user_containers);
   RUN_TEST(test_get_user_container_txn_reuse);
   RUN_TEST(test_get_user_container_cached_no_txn_needed);
   RUN_TEST(test_get_user_container_without_init);
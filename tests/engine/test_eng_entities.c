@@ -0,0 +1,138 @@
+#include "core/bitmaps.h"
+#include "core/mmap_array.h"
+#include "engine/eng_entities/eng_entities.h"
+#include "query/ast.h"
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static mmap_array_t ent_map;
+static char test_map_path[256];
+
+// Leaves resolved, to check skipped sides
+static int leaf_calls;
+
+void setUp(void) {
+  srand((unsigned int)time(NULL));
+  snprintf(test_map_path, sizeof(test_map_path),
+           "/tmp/test_eng_entities_%d_%d.bin", getpid(), rand());
+  mmap_array_config_t cfg = {
+      .path = test_map_path, .item_size = sizeof(uint32_t), .initial_cap = 64};
+  TEST_ASSERT_EQUAL_INT(0, mmap_array_open(&ent_map, &cfg));
+  leaf_calls = 0;
+}
+
+void tearDown(void) {
+  mmap_array_close(&ent_map);
+  unlink(test_map_path);
+}
+
+static bitmap_t *_of(const uint32_t *ids, uint32_t count) {
+  bitmap_t *bm = bitmap_create();
+  bitmap_add_many(bm, count, ids);
+  return bm;
+}
+
+// day1: 1..5, day7: 2 4 5, day8: 5, day7:signups: 2 4
+static bitmap_t *_fake_leaf(const char *container, const char *view,
+                            void *arg, const char **err_out) {
+  (void)arg;
+  leaf_calls++;
+  if (strcmp(container, "day1") == 0) {
+    return _of((uint32_t[]){1, 2, 3, 4, 5}, 5);
+  }
+  if (strcmp(container, "day7") == 0) {
+    return view ? _of((uint32_t[]){2, 4}, 2) : _of((uint32_t[]){2, 4, 5}, 3);
+  }
+  if (strcmp(container, "day8") == 0) {
+    return _of((uint32_t[]){5}, 1);
+  }
+  if (strcmp(container, "empty") == 0) {
+    return bitmap_create();
+  }
+  *err_out = "Container not found";
+  return NULL;
+}
+
+static ast_node_t *_ns(const char *name) {
+  return ast_create_string_literal_node(name, strlen(name));
+}
+
+static ast_node_t *_and(ast_node_t *l, ast_node_t *r) {
+  return ast_create_logical_node(AST_LOGIC_NODE_AND, l, r);
+}
+
+static void _assert_set(ast_node_t *exp, const uint32_t *expected,
+                        uint32_t count) {
+  const char *err = NULL;
+  bitmap_t *bm = eng_entities_eval(exp, _fake_leaf, NULL, &err);
+  TEST_ASSERT_NOT_NULL(bm);
+  TEST_ASSERT_EQUAL_UINT32(count, bitmap_get_cardinality(bm));
+  for (uint32_t i = 0; i < count; i++) {
+    TEST_ASSERT_TRUE(bitmap_contains(bm, expected[i]));
+  }
+  bitmap_free(bm);
+  ast_free(exp);
+}
+
+void test_eval_and_not_or(void) {
+  // Retained on day 7 but not day 8
+  _assert_set(
+      _and(_and(_ns("day1"), _ns("day7")), ast_create_not_node(_ns("day8"))),
+      (uint32_t[]){2, 4}, 2);
+  // NOT on the left
+  _assert_set(_and(ast_create_not_node(_ns("day7")), _ns("day1")),
+              (uint32_t[]){1, 3}, 2);
+  _assert_set(
+      ast_create_logical_node(AST_LOGIC_NODE_OR, _ns("day8"), _ns("day7")),
+      (uint32_t[]){2, 4, 5}, 3);
+}
+
+void test_eval_view_leaf(void) {
+  ast_node_t *signups =
+      ast_create_custom_tag_node("day7", _ns("signups"));
+  _assert_set(_and(signups, _ns("day1")), (uint32_t[]){2, 4}, 2);
+}
+
+void test_eval_empty_side_skips_other(void) {
+  _assert_set(_and(_ns("empty"), _ns("day1")), NULL, 0);
+  TEST_ASSERT_EQUAL_INT(1, leaf_calls);
+}
+
+void test_eval_leaf_error(void) {
+  ast_node_t *exp = _and(_ns("day1"), _ns("nope"));
+  const char *err = NULL;
+  TEST_ASSERT_NULL(eng_entities_eval(exp, _fake_leaf, NULL, &err));
+  TEST_ASSERT_EQUAL_STRING("Container not found", err);
+  ast_free(exp);
+}
+
+void test_of_events(void) {
+  // Events 1 and 3 share entity 7, event 4 has none
+  TEST_ASSERT_EQUAL_INT(0, mmap_array_set(&ent_map, 1, &(uint32_t){7}));
+  TEST_ASSERT_EQUAL_INT(0, mmap_array_set(&ent_map, 2, &(uint32_t){8}));
+  TEST_ASSERT_EQUAL_INT(0, mmap_array_set(&ent_map, 3, &(uint32_t){7}));
+  TEST_ASSERT_EQUAL_INT(0, mmap_array_set(&ent_map, 4, &(uint32_t){0}));
+
+  bitmap_t *events = _of((uint32_t[]){1, 3, 4, 100000}, 4);
+  const char *err = NULL;
+  bitmap_t *entities = eng_entities_of_events(&ent_map, events, NULL, &err);
+  TEST_ASSERT_NOT_NULL(entities);
+  TEST_ASSERT_EQUAL_UINT32(1, bitmap_get_cardinality(entities));
+  TEST_ASSERT_TRUE(bitmap_contains(entities, 7));
+  bitmap_free(entities);
+  bitmap_free(events);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_eval_and_not_or);
+  RUN_TEST(test_eval_view_leaf);
+  RUN_TEST(test_eval_empty_side_skips_other);
+  RUN_TEST(test_eval_leaf_error);
+  RUN_TEST(test_of_events);
+  return UNITY_END();
+}
@@ -1,6 +1,9 @@
 #include "core/bitmaps.h"
 #include "core/db.h"
 #include "engine/eng_eval/eng_eval.h"
+#include "engine/eng_fetch/eng_fetch.h"
+#include "engine/eng_sample/eng_sample.h"
+#include "mpack.h"
 #include "query/ast.h"
 #include "unity.h"
 #include <stdio.h>
@@ -15,6 +18,8 @@ static MDB_txn *sys_txn = (MDB_txn *)0xDEADBEEF;
 static MDB_txn *user_txn = (MDB_txn *)0xCAFEBABE;
 
 static eng_container_t mock_container;
+static eng_container_t mock_sys_container;
+static eng_user_dc_t mock_usr_dc;
 static consumer_t mock_consumers[1];
 static consumer_cache_t mock_consumer_cache;
 static eval_state_t state;
@@ -24,6 +29,21 @@ static eval_ctx_t ctx;
 // Helper to allow tests to inject "Cached" bitmaps
 static bitmap_t *injected_cache_bm = NULL;
 
+// Keys read from the mock DB, in order
+static char db_reads[8][64];
+static uint32_t db_read_count = 0;
+
+// Cardinality the mock tag stats report for `stats_key`
+static const char *stats_key = NULL;
+static uint64_t stats_card = 0;
+
+// Events 1..`scan_events` exist, each with `amt` = id * 10
+static uint32_t scan_events = 0;
+// Blobs read by the mock scan, and the first and last id it read
+static uint32_t scanned = 0;
+static uint32_t scanned_first = 0;
+static uint32_t scanned_last = 0;
+
 // --- In-Memory Mock Database ---
 typedef struct mock_db_entry_s {
   char *key;
@@ -65,6 +85,19 @@ bool index_get(const char *key, khash_t(key_index) * key_to_index,
   return false;
 }
 
+uint64_t index_f64_key(double value) {
+  (void)value;
+  return 0;
+}
+
+int mdb_cmp(MDB_txn *txn, MDB_dbi dbi, const MDB_val *a, const MDB_val *b) {
+  (void)txn;
+  (void)dbi;
+  (void)a;
+  (void)b;
+  return 0;
+}
+
 // Create a cursor for iterating over database entries
 // Returns NULL on failure
 MDB_cursor *db_cursor_open(MDB_txn *txn, MDB_dbi db) { return NULL; }
@@ -82,6 +115,44 @@ db_cursor_get_result_t db_cursor_get(MDB_cursor *cursor,
   return 0;
 }
 
+// Mock events db: blobs are built on demand, see `scan_events`
+bool eng_fetch_match(MDB_env *env, MDB_txn *txn, MDB_dbi events_db,
+                     const uint32_t *ids, uint32_t count,
+                     eng_fetch_match_fn match, const void *match_arg,
+                     const deadline_t *deadline, uint32_t *hits_out,
+                     uint32_t *num_hits_out) {
+  (void)env;
+  (void)txn;
+  (void)events_db;
+  (void)deadline;
+  *num_hits_out = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    if (ids[i] == 0 || ids[i] > scan_events) {
+      continue;
+    }
+    char blob[32];
+    mpack_writer_t w;
+    mpack_writer_init(&w, blob, sizeof(blob));
+    mpack_start_map(&w, 2);
+    mpack_write_cstr(&w, "id");
+    mpack_write_u32(&w, ids[i]);
+    mpack_write_cstr(&w, "amt");
+    mpack_write_i64(&w, (int64_t)ids[i] * 10);
+    mpack_finish_map(&w);
+    size_t size = mpack_writer_buffer_used(&w);
+    mpack_writer_destroy(&w);
+
+    if (scanned++ == 0) {
+      scanned_first = ids[i];
+    }
+    scanned_last = ids[i];
+    if (match(match_arg, blob, size)) {
+      hits_out[(*num_hits_out)++] = ids[i];
+    }
+  }
+  return true;
+}
+
 // Mock Routing: Always route to consumer 0
 int route_key_to_consumer(const char *key, uint32_t total,
                           uint32_t per_consumer) {
@@ -107,6 +178,29 @@ const bitmap_t *consumer_cache_get_bm(consumer_cache_t *cache,
   return NULL;
 }
 
+// Read cache is not initialized in these tests
+const bitmap_t *read_cache_get(const char *ser_db_key, uint64_t commit_seq) {
+  (void)ser_db_key;
+  (void)commit_seq;
+  return NULL;
+}
+
+const bitmap_t *read_cache_put(const char *ser_db_key, uint64_t commit_seq,
+                               const void *value, size_t value_len) {
+  (void)ser_db_key;
+  (void)commit_seq;
+  (void)value;
+  (void)value_len;
+  return NULL;
+}
+
+// Mock view lookup: only `errors` exists
+const view_t *view_find(const view_set_t *set, const char *name) {
+  (void)set;
+  static const view_t errors = {.name = "errors", .where = NULL};
+  return strcmp(name, "errors") == 0 ? &errors : NULL;
+}
+
 // Mock Container DB Handle Retrieval
 bool container_get_db_handle(eng_container_t *container,
                              eng_container_db_key_t *key, MDB_dbi *dbi) {
@@ -143,6 +237,45 @@ bool db_get(MDB_dbi dbi, MDB_txn *txn, db_key_t *key, db_get_result_t *result) {
   return true;
 }
 
+// Mock tag stats: only `stats_key` has any
+bool tag_stats_get_cardinality(MDB_txn *txn, MDB_dbi db, const char *inv_key,
+                               uint64_t *card_out) {
+  (void)txn;
+  (void)db;
+  if (!stats_key || strcmp(inv_key, stats_key) != 0) {
+    return false;
+  }
+  *card_out = stats_card;
+  return true;
+}
+
+// Mock view lookup: points at the mock entry's data, which lives until the
+// mock DB is cleared
+bool db_get_view(MDB_dbi dbi, MDB_txn *txn, db_key_t *key,
+                 db_get_result_t *result) {
+  (void)dbi;
+  (void)txn;
+  if (key->type != DB_KEY_STRING)
+    return false;
+  if (db_read_count < 8) {
+    snprintf(db_reads[db_read_count++], sizeof(db_reads[0]), "%s",
+             key->key.s);
+  }
+
+  for (mock_db_entry_t *curr = mock_db_head; curr; curr = curr->next) {
+    if (strcmp(curr->key, key->key.s) == 0) {
+      result->status = DB_GET_OK;
+      result->value_len = curr->len;
+      result->value = curr->data;
+      return true;
+    }
+  }
+
+  result->status = DB_GET_NOT_FOUND;
+  result->value = NULL;
+  return true;
+}
+
 // Mock result cleanup
 void db_get_result_clear(db_get_result_t *r) {
   if (r->value) {
@@ -179,9 +312,12 @@ void setUp(void) {
   // Setup Context
   memset(&mock_container, 0, sizeof(eng_container_t));
   mock_container.name = TEST_CONTAINER_NAME;
+  memset(&mock_usr_dc, 0, sizeof(eng_user_dc_t));
+  mock_container.data.usr = &mock_usr_dc;
 
   memset(&config, 0, sizeof(eval_config_t));
   config.container = &mock_container;
+  config.sys_container = &mock_sys_container;
   config.user_txn = user_txn;
   config.sys_txn = sys_txn;
   config.consumers = mock_consumers;
@@ -194,6 +330,13 @@ void setUp(void) {
   ctx.state = &state;
 
   injected_cache_bm = NULL;
+  db_read_count = 0;
+  stats_key = NULL;
+  stats_card = 0;
+  scan_events = 0;
+  scanned = 0;
+  scanned_first = 0;
+  scanned_last = 0;
 }
 
 void tearDown(void) {
@@ -512,6 +655,531 @@ void test_nested_not_logic(void) {
   ast_free(root);
 }
 
+void test_entity_timeline(void) {
+  // Entity "user1" -> int id 7
+  uint32_t ent_id = 7;
+  add_to_mock_db("user1", &ent_id, sizeof(uint32_t));
+
+  bitmap_t *bm = bitmap_create();
+  bitmap_add(bm, 3);
+  bitmap_add(bm, 8);
+  setup_db_bitmap("entity|7", bm);
+  bitmap_free(bm);
+
+  bm = bitmap_create();
+  bitmap_add(bm, 8);
+  bitmap_add(bm, 9);
+  setup_db_bitmap("loc:ca", bm);
+  bitmap_free(bm);
+
+  // entity:user1 AND loc:ca -> (8)
+  ast_node_t *ent = ast_create_tag_node(
+      AST_KW_ENTITY, ast_create_string_literal_node("user1", 5));
+  ast_node_t *ast = ast_create_logical_node(AST_LOGIC_NODE_AND, ent,
+                                            make_test_tag("loc", "ca"));
+
+  eng_eval_result_t r = eng_eval_resolve_exp_to_events(ast, &ctx);
+
+  TEST_ASSERT_TRUE(r.success);
+  TEST_ASSERT_EQUAL_UINT64(1, bitmap_get_cardinality(r.events));
+  TEST_ASSERT_TRUE(bitmap_contains(r.events, 8));
+
+  bitmap_free(r.events);
+  ast_free(ast);
+}
+
+void test_entity_unknown_is_empty(void) {
+  ast_node_t *ast = ast_create_tag_node(
+      AST_KW_ENTITY, ast_create_string_literal_node("nobody", 6));
+
+  eng_eval_result_t r = eng_eval_resolve_exp_to_events(ast, &ctx);
+
+  TEST_ASSERT_TRUE(r.success);
+  TEST_ASSERT_NOT_NULL(r.events);
+  TEST_ASSERT_EQUAL_UINT64(0, bitmap_get_cardinality(r.events));
+
+  bitmap_free(r.events);
+  ast_free(ast);
+}
+
+void test_view_reads_maintained_result(void) {
+  bitmap_t *bm = bitmap_create();
+  bitmap_add(bm, 3);
+  bitmap_add(bm, 9);
+  setup_db_bitmap("view|errors", bm);
+  bitmap_free(bm);
+
+  ast_node_t *ast = ast_create_tag_node(
+      AST_KW_VIEW, ast_create_string_literal_node("errors", 6));
+  eng_eval_result_t r = eng_eval_resolve_exp_to_events(ast, &ctx);
+
+  TEST_ASSERT_TRUE(r.success);
+  TEST_ASSERT_EQUAL_UINT64(2, bitmap_get_cardinality(r.events));
+  TEST_ASSERT_TRUE(bitmap_contains(r.events, 9));
+
+  bitmap_free(r.events);
+  ast_free(ast);
+}
+
+void test_unknown_view_fails(void) {
+  ast_node_t *ast = ast_create_tag_node(
+      AST_KW_VIEW, ast_create_string_literal_node("missing", 7));
+  eng_eval_result_t r = eng_eval_resolve_exp_to_events(ast, &ctx);
+
+  TEST_ASSERT_FALSE(r.success);
+  TEST_ASSERT_EQUAL_STRING("View does not exist", r.err_msg);
+
+  ast_free(ast);
+}
+
+static void _setup_range_bitmap(const char *key, uint32_t from, uint32_t to) {
+  bitmap_t *bm = bitmap_create();
+  for (uint32_t i = from; i <= to; i++) {
+    bitmap_add(bm, i);
+  }
+  setup_db_bitmap(key, bm);
+  bitmap_free(bm);
+}
+
+void test_nary_and_with_andnot(void) {
+  setup_db_max_id(100);
+  _setup_range_bitmap("tag:A", 0, 50);
+  _setup_range_bitmap("tag:B", 10, 90);
+  _setup_range_bitmap("tag:C", 20, 30);
+  _setup_range_bitmap("tag:D", 25, 26);
+
+  // A AND (NOT D) AND B AND C -> 20..30 minus 25..26
+  ast_node_t *root = ast_create_logical_node(
+      AST_LOGIC_NODE_AND,
+      ast_create_logical_node(
+          AST_LOGIC_NODE_AND,
+          ast_create_logical_node(
+              AST_LOGIC_NODE_AND, make_test_tag("tag", "A"),
+              ast_create_not_node(make_test_tag("tag", "D"))),
+          make_test_tag("tag", "B")),
+      make_test_tag("tag", "C"));
+
+  eng_eval_result_t r = eng_eval_resolve_exp_to_events(root, &ctx);
+
+  TEST_ASSERT_TRUE(r.success);
+  TEST_ASSERT_EQUAL_UINT32(9, bitmap_get_cardinality(r.events));
+  TEST_ASSERT_TRUE(bitmap_contains(r.events, 20));
+  TEST_ASSERT_FALSE(bitmap_contains(r.events, 25));
+  TEST_ASSERT_TRUE(bitmap_contains(r.events, 30));
+
+  bitmap_free(r.events);
+  ast_free(root);
+}
+
+void test_nary_and_only_negations(void) {
+  setup_db_max_id(10);
+  _setup_range_bitmap("tag:A", 0, 4);
+  _setup_range_bitmap("tag:B", 8, 9);
+
+  // NOT A AND NOT B -> 5, 6, 7
+  ast_node_t *root = ast_create_logical_node(
+      AST_LOGIC_NODE_AND, ast_create_not_node(make_test_tag("tag", "A")),
+      ast_create_not_node(make_test_tag("tag", "B")));
+
+  eng_eval_result_t r = eng_eval_resolve_exp_to_events(root, &ctx);
+
+  TEST_ASSERT_TRUE(r.success);
+  TEST_ASSERT_EQUAL_UINT32(3, bitmap_get_cardinality(r.events));
+  TEST_ASSERT_TRUE(bitmap_contains(r.events, 5));
+  TEST_ASSERT_TRUE(bitmap_contains(r.events, 7));
+
+  bitmap_free(r.events);
+  ast_free(root);
+}
+
+void test_nary_and_empty_operand(void) {
+  _setup_range_bitmap("tag:A", 0, 10);
+
+  // tag:missing is empty, so the AND is empty
+  ast_node_t *root = ast_create_logical_node(
+      AST_LOGIC_NODE_AND,
+      ast_create_logical_node(AST_LOGIC_NODE_AND, make_test_tag("tag", "A"),
+                              make_test_tag("tag", "missing")),
+      make_test_tag("tag", "A"));
+
+  eng_eval_result_t r = eng_eval_resolve_exp_to_events(root, &ctx);
+
+  TEST_ASSERT_TRUE(r.success);
+  TEST_ASSERT_NOT_NULL(r.events);
+  TEST_ASSERT_EQUAL_UINT32(0, bitmap_get_cardinality(r.events));
+
+  bitmap_free(r.events);
+  ast_free(root);
+}
+
+void test_nary_and_reads_smallest_tag_first(void) {
+  _setup_range_bitmap("tag:A", 0, 10);
+
+  // Stats say tag:empty is empty, so tag:A is never read
+  stats_key = "tag:empty";
+  stats_card = 0;
+  ast_node_t *root = ast_create_logical_node(
+      AST_LOGIC_NODE_AND, make_test_tag("tag", "A"),
+      make_test_tag("tag", "empty"));
+
+  eng_eval_result_t r = eng_eval_resolve_exp_to_events(root, &ctx);
+
+  TEST_ASSERT_TRUE(r.success);
+  TEST_ASSERT_EQUAL_UINT32(0, bitmap_get_cardinality(r.events));
+  TEST_ASSERT_EQUAL_UINT32(1, db_read_count);
+  TEST_ASSERT_EQUAL_STRING("tag:empty", db_reads[0]);
+
+  bitmap_free(r.events);
+  ast_free(root);
+}
+
+void test_profile_records_tree_and_sources(void) {
+  _setup_range_bitmap("tag:A", 0, 10);
+  injected_cache_bm = bitmap_create();
+  bitmap_add(injected_cache_bm, 5);
+  bitmap_add(injected_cache_bm, 50);
+
+  eng_profile_t profile;
+  eng_profile_init(&profile, true);
+  config.profile = &profile;
+
+  // (tag:A AND type:cached_tag) OR tag:A, the second tag:A is cached
+  ast_node_t *root = ast_create_logical_node(
+      AST_LOGIC_NODE_OR,
+      ast_create_logical_node(AST_LOGIC_NODE_AND, make_test_tag("tag", "A"),
+                              make_test_tag("type", "cached_tag")),
+      make_test_tag("tag", "A"));
+
+  eng_eval_result_t r = eng_eval_resolve_exp_to_events(root, &ctx);
+
+  TEST_ASSERT_TRUE(r.success);
+  TEST_ASSERT_EQUAL_UINT32(5, profile.count);
+  TEST_ASSERT_EQUAL_INT32(-1, profile.cur);
+  eng_profile_node_t *n = profile.nodes;
+  TEST_ASSERT_EQUAL_STRING("or", n[0].op);
+  TEST_ASSERT_EQUAL_UINT64(11, n[0].card);
+  TEST_ASSERT_EQUAL_STRING("and", n[1].op);
+  TEST_ASSERT_EQUAL_INT32(0, n[1].parent);
+  TEST_ASSERT_EQUAL_UINT64(1, n[1].card);
+
+  TEST_ASSERT_EQUAL_STRING("tag:A", n[2].label);
+  TEST_ASSERT_EQUAL_INT32(1, n[2].parent);
+  TEST_ASSERT_EQUAL_UINT32(1, n[2].reads[ENG_PROFILE_SRC_LMDB]);
+  TEST_ASSERT_TRUE(n[2].bytes > 0);
+
+  TEST_ASSERT_EQUAL_STRING("type:cached_tag", n[3].label);
+  TEST_ASSERT_EQUAL_UINT32(1, n[3].reads[ENG_PROFILE_SRC_CONSUMER_CACHE]);
+  TEST_ASSERT_EQUAL_INT32(0, n[3].consumer);
+
+  TEST_ASSERT_EQUAL_STRING("tag:A", n[4].label);
+  TEST_ASSERT_EQUAL_INT32(0, n[4].parent);
+  TEST_ASSERT_EQUAL_UINT32(1, n[4].reads[ENG_PROFILE_SRC_LOCAL_CACHE]);
+  TEST_ASSERT_EQUAL_UINT32(0, n[4].reads[ENG_PROFILE_SRC_LMDB]);
+
+  bitmap_free(r.events);
+  ast_free(root);
+}
+
+void test_explain_reads_no_bitmaps(void) {
+  _setup_range_bitmap("tag:A", 0, 10);
+  stats_key = "tag:empty";
+  stats_card = 0;
+
+  eng_profile_t profile;
+  eng_profile_init(&profile, false);
+  config.profile = &profile;
+
+  ast_node_t *root = ast_create_logical_node(
+      AST_LOGIC_NODE_AND, make_test_tag("tag", "A"),
+      ast_create_not_node(make_test_tag("tag", "empty")));
+  const char *err = NULL;
+  TEST_ASSERT_TRUE(eng_eval_explain(root, &ctx, &err));
+  TEST_ASSERT_EQUAL_UINT32(0, db_read_count);
+
+  // and -> tag:A, andnot -> tag:empty. NOT operands keep their place
+  TEST_ASSERT_EQUAL_UINT32(4, profile.count);
+  eng_profile_node_t *n = profile.nodes;
+  TEST_ASSERT_EQUAL_STRING("and", n[0].op);
+  TEST_ASSERT_EQUAL_STRING("tag:A", n[1].label);
+  TEST_ASSERT_FALSE(n[1].has_estimate);
+  TEST_ASSERT_EQUAL_STRING("andnot", n[2].op);
+  TEST_ASSERT_EQUAL_STRING("tag:empty", n[3].label);
+  TEST_ASSERT_EQUAL_INT32(2, n[3].parent);
+  TEST_ASSERT_TRUE(n[3].has_estimate);
+  TEST_ASSERT_EQUAL_UINT64(0, n[3].estimate);
+  ast_free(root);
+
+  // Comparisons fail as they would when evaluated
+  eng_profile_init(&profile, false);
+  root = ast_create_comparison_node(AST_OP_GT,
+                                    ast_create_string_literal_node("amt", 3),
+                                    ast_create_number_literal_node(5));
+  TEST_ASSERT_FALSE(eng_eval_explain(root, &ctx, &err));
+  TEST_ASSERT_EQUAL_STRING("Index does not exist for tag key.", err);
+  ast_free(root);
+}
+
+void test_nary_or(void) {
+  _setup_range_bitmap("tag:A", 0, 1);
+  _setup_range_bitmap("tag:B", 10, 11);
+  _setup_range_bitmap("tag:C", 20, 21);
+
+  // A OR missing OR B OR C
+  ast_node_t *root = ast_create_logical_node(
+      AST_LOGIC_NODE_OR,
+      ast_create_logical_node(
+          AST_LOGIC_NODE_OR,
+          ast_create_logical_node(AST_LOGIC_NODE_OR, make_test_tag("tag", "A"),
+                                  make_test_tag("tag", "missing")),
+          make_test_tag("tag", "B")),
+      make_test_tag("tag", "C"));
+
+  eng_eval_result_t r = eng_eval_resolve_exp_to_events(root, &ctx);
+
+  TEST_ASSERT_TRUE(r.success);
+  TEST_ASSERT_EQUAL_UINT32(6, bitmap_get_cardinality(r.events));
+  TEST_ASSERT_TRUE(bitmap_contains(r.events, 0));
+  TEST_ASSERT_TRUE(bitmap_contains(r.events, 11));
+  TEST_ASSERT_TRUE(bitmap_contains(r.events, 21));
+
+  bitmap_free(r.events);
+  ast_free(root);
+}
+
+void test_repeated_tag_is_not_mutated(void) {
+  _setup_range_bitmap("tag:A", 0, 9);
+  _setup_range_bitmap("tag:B", 0, 1);
+  _setup_range_bitmap("tag:C", 8, 9);
+
+  // (A AND B) OR (A AND C) -> 0, 1, 8, 9. Both ANDs read the same cached A.
+  ast_node_t *root = ast_create_logical_node(
+      AST_LOGIC_NODE_OR,
+      ast_create_logical_node(AST_LOGIC_NODE_AND, make_test_tag("tag", "A"),
+                              make_test_tag("tag", "B")),
+      ast_create_logical_node(AST_LOGIC_NODE_AND, make_test_tag("tag", "A"),
+                              make_test_tag("tag", "C")));
+
+  eng_eval_result_t r = eng_eval_resolve_exp_to_events(root, &ctx);
+
+  TEST_ASSERT_TRUE(r.success);
+  TEST_ASSERT_EQUAL_UINT32(4, bitmap_get_cardinality(r.events));
+  TEST_ASSERT_TRUE(bitmap_contains(r.events, 1));
+  TEST_ASSERT_TRUE(bitmap_contains(r.events, 8));
+
+  bitmap_free(r.events);
+  ast_free(root);
+}
+
+void test_expired_deadline_fails(void) {
+  _setup_range_bitmap("tag:A", 0, 9);
+  _setup_range_bitmap("tag:B", 0, 1);
+  deadline_t deadline = {.expires_ns = 1, .alive = NULL};
+  config.deadline = &deadline;
+
+  ast_node_t *root = ast_create_logical_node(
+      AST_LOGIC_NODE_AND, make_test_tag("tag", "A"), make_test_tag("tag", "B"));
+  eng_eval_result_t r = eng_eval_resolve_exp_to_events(root, &ctx);
+
+  TEST_ASSERT_FALSE(r.success);
+  TEST_ASSERT_NULL(r.events);
+  TEST_ASSERT_EQUAL_STRING("Query timed out", r.err_msg);
+  ast_free(root);
+}
+
+void test_cancelled_deadline_fails(void) {
+  _setup_range_bitmap("tag:A", 0, 9);
+  atomic_int alive = 1;
+  deadline_t deadline;
+  deadline_init(&deadline, 0, &alive);
+  config.deadline = &deadline;
+
+  ast_node_t *tag = make_test_tag("tag", "A");
+  eng_eval_result_t r = eng_eval_resolve_exp_to_events(tag, &ctx);
+  TEST_ASSERT_TRUE(r.success);
+  bitmap_free(r.events);
+  eng_eval_cleanup_state(&state);
+
+  atomic_store(&alive, 0);
+  r = eng_eval_resolve_exp_to_events(tag, &ctx);
+  TEST_ASSERT_FALSE(r.success);
+  TEST_ASSERT_EQUAL_STRING("Query cancelled", r.err_msg);
+  ast_free(tag);
+}
+
+// Result of `root` over every event, then over a sample
+static void _assert_sampled_matches_exact(ast_node_t *root, uint32_t pct,
+                                          uint32_t last_event_id) {
+  eng_eval_result_t exact = eng_eval_resolve_exp_to_events(root, &ctx);
+  TEST_ASSERT_TRUE(exact.success);
+  eng_eval_cleanup_state(&state);
+
+  config.sample_pct = pct;
+  eng_eval_result_t r = eng_eval_resolve_exp_to_events(root, &ctx);
+  TEST_ASSERT_TRUE(r.success);
+
+  bitmap_t *sample = eng_sample_bitmap(pct, last_event_id);
+  bitmap_t *expected = bitmap_and(exact.events, sample);
+  uint32_t card = bitmap_get_cardinality(r.events);
+  TEST_ASSERT_EQUAL_UINT32(bitmap_get_cardinality(expected), card);
+  bitmap_and_inplace(expected, r.events);
+  TEST_ASSERT_EQUAL_UINT32(card, bitmap_get_cardinality(expected));
+  TEST_ASSERT_TRUE(card < bitmap_get_cardinality(exact.events));
+
+  bitmap_free(expected);
+  bitmap_free(sample);
+  bitmap_free(r.events);
+  bitmap_free(exact.events);
+}
+
+void test_sampled_and_not(void) {
+  setup_db_max_id(1000);
+  _setup_range_bitmap("tag:A", 1, 600);
+  _setup_range_bitmap("tag:B", 400, 1000);
+
+  // A AND NOT B
+  ast_node_t *root = ast_create_logical_node(
+      AST_LOGIC_NODE_AND, make_test_tag("tag", "A"),
+      ast_create_not_node(make_test_tag("tag", "B")));
+  _assert_sampled_matches_exact(root, 50, 1000);
+  ast_free(root);
+}
+
+void test_sampled_leaf_skips_full_sample(void) {
+  setup_db_max_id(1000);
+  _setup_range_bitmap("tag:A", 1, 600);
+
+  ast_node_t *root = make_test_tag("tag", "A");
+  _assert_sampled_matches_exact(root, 50, 1000);
+  // Only the leaf is sampled, the id space is never tiled
+  TEST_ASSERT_NULL(state.sample);
+  ast_free(root);
+}
+
+void test_sampled_not_uses_sample_as_universe(void) {
+  setup_db_max_id(1000);
+  _setup_range_bitmap("tag:A", 1, 100);
+  _setup_range_bitmap("tag:B", 900, 1000);
+
+  // NOT A OR B
+  ast_node_t *root = ast_create_logical_node(
+      AST_LOGIC_NODE_OR, ast_create_not_node(make_test_tag("tag", "A")),
+      make_test_tag("tag", "B"));
+  _assert_sampled_matches_exact(root, 10, 1000);
+  ast_free(root);
+}
+
+static ast_node_t *_amt(ast_comparison_op_t op, int64_t value) {
+  return ast_create_comparison_node(op,
+                                    ast_create_string_literal_node("amt", 3),
+                                    ast_create_number_literal_node(value));
+}
+
+void test_scan_unindexed_comparison(void) {
+  scan_events = 20;
+  setup_db_max_id(21);
+  config.scan_budget = 100;
+
+  ast_node_t *root = _amt(AST_OP_GTE, 150);
+  eng_eval_result_t r = eng_eval_resolve_exp_to_events(root, &ctx);
+  TEST_ASSERT_TRUE(r.success);
+  // Every event is read
+  TEST_ASSERT_EQUAL_UINT32(20, scanned);
+  TEST_ASSERT_EQUAL_UINT32(6, bitmap_get_cardinality(r.events));
+  TEST_ASSERT_TRUE(bitmap_contains(r.events, 15));
+  TEST_ASSERT_TRUE(bitmap_contains(r.events, 20));
+  bitmap_free(r.events);
+  ast_free(root);
+}
+
+void test_scan_reads_what_the_tags_left(void) {
+  scan_events = 20;
+  setup_db_max_id(21);
+  config.scan_budget = 100;
+  _setup_range_bitmap("tag:A", 5, 9);
+
+  // amt > 40 AND amt <= 80 AND tag:A, the range is one scan run last
+  ast_node_t *root = ast_create_logical_node(
+      AST_LOGIC_NODE_AND,
+      ast_create_logical_node(AST_LOGIC_NODE_AND, _amt(AST_OP_GT, 40),
+                              _amt(AST_OP_LTE, 80)),
+      make_test_tag("tag", "A"));
+  eng_eval_result_t r = eng_eval_resolve_exp_to_events(root, &ctx);
+  TEST_ASSERT_TRUE(r.success);
+  TEST_ASSERT_EQUAL_UINT32(5, scanned);
+  TEST_ASSERT_EQUAL_UINT32(5, scanned_first);
+  TEST_ASSERT_EQUAL_UINT32(9, scanned_last);
+  TEST_ASSERT_EQUAL_UINT32(4, bitmap_get_cardinality(r.events));
+  TEST_ASSERT_FALSE(bitmap_contains(r.events, 9));
+  TEST_ASSERT_EQUAL_UINT64(5, state.scanned);
+  bitmap_free(r.events);
+  ast_free(root);
+}
+
+void test_scan_skipped_after_empty_operand(void) {
+  scan_events = 20;
+  setup_db_max_id(21);
+  config.scan_budget = 100;
+
+  ast_node_t *root = ast_create_logical_node(
+      AST_LOGIC_NODE_AND, _amt(AST_OP_GT, 40), make_test_tag("tag", "none"));
+  eng_eval_result_t r = eng_eval_resolve_exp_to_events(root, &ctx);
+  TEST_ASSERT_TRUE(r.success);
+  TEST_ASSERT_TRUE(bitmap_is_empty(r.events));
+  TEST_ASSERT_EQUAL_UINT32(0, scanned);
+  bitmap_free(r.events);
+  ast_free(root);
+}
+
+void test_scan_budget(void) {
+  scan_events = 20;
+  setup_db_max_id(21);
+  config.scan_budget = 30;
+
+  // Two scans of every event, 21 ids each
+  ast_node_t *root = ast_create_logical_node(
+      AST_LOGIC_NODE_OR, _amt(AST_OP_GT, 40), _amt(AST_OP_LT, 20));
+  eng_eval_result_t r = eng_eval_resolve_exp_to_events(root, &ctx);
+  TEST_ASSERT_FALSE(r.success);
+  TEST_ASSERT_EQUAL_STRING(
+      "Scan budget exceeded, index the key or narrow the query", r.err_msg);
+  ast_free(root);
+
+  // Without a budget comparisons need an index
+  eng_eval_cleanup_state(&state);
+  memset(&state, 0, sizeof(eval_state_t));
+  config.scan_budget = 0;
+  root = _amt(AST_OP_GT, 40);
+  r = eng_eval_resolve_exp_to_events(root, &ctx);
+  TEST_ASSERT_FALSE(r.success);
+  TEST_ASSERT_EQUAL_STRING("Index does not exist for tag key.", r.err_msg);
+  ast_free(root);
+}
+
+void test_explain_shows_scans_last(void) {
+  config.scan_budget = 100;
+  eng_profile_t profile;
+  eng_profile_init(&profile, false);
+  config.profile = &profile;
+
+  ast_node_t *root = ast_create_logical_node(
+      AST_LOGIC_NODE_AND,
+      ast_create_comparison_node(AST_OP_CONTAINS,
+                                 ast_create_string_literal_node("path", 4),
+                                 ast_create_string_literal_node("pay", 3)),
+      make_test_tag("tag", "A"));
+  const char *err = NULL;
+  TEST_ASSERT_TRUE(eng_eval_explain(root, &ctx, &err));
+  TEST_ASSERT_EQUAL_UINT32(0, scanned);
+
+  TEST_ASSERT_EQUAL_UINT32(3, profile.count);
+  eng_profile_node_t *n = profile.nodes;
+  TEST_ASSERT_EQUAL_STRING("tag:A", n[1].label);
+  TEST_ASSERT_EQUAL_STRING("compare", n[2].op);
+  TEST_ASSERT_EQUAL_STRING("path ~ pay", n[2].label);
+  TEST_ASSERT_EQUAL_STRING("scan", n[2].access);
+  ast_free(root);
+}
+
 int main(void) {
   UNITY_BEGIN();
   RUN_TEST(test_resolve_single_tag_from_db);
@@ -524,5 +1192,27 @@ int main(void) {
   RUN_TEST(test_stack_overflow_protection);
   RUN_TEST(test_deeply_nested_mixed_logic);
   RUN_TEST(test_nested_not_logic);
+  RUN_TEST(test_entity_timeline);
+  RUN_TEST(test_entity_unknown_is_empty);
+  RUN_TEST(test_view_reads_maintained_result);
+  RUN_TEST(test_unknown_view_fails);
+  RUN_TEST(test_nary_and_with_andnot);
+  RUN_TEST(test_nary_and_only_negations);
+  RUN_TEST(test_nary_and_empty_operand);
+  RUN_TEST(test_nary_and_reads_smallest_tag_first);
+  RUN_TEST(test_profile_records_tree_and_sources);
+  RUN_TEST(test_explain_reads_no_bitmaps);
+  RUN_TEST(test_nary_or);
+  RUN_TEST(test_repeated_tag_is_not_mutated);
+  RUN_TEST(test_expired_deadline_fails);
+  RUN_TEST(test_cancelled_deadline_fails);
+  RUN_TEST(test_sampled_and_not);
+  RUN_TEST(test_sampled_leaf_skips_full_sample);
+  RUN_TEST(test_sampled_not_uses_sample_as_universe);
+  RUN_TEST(test_scan_unindexed_comparison);
+  RUN_TEST(test_scan_reads_what_the_tags_left);
+  RUN_TEST(test_scan_skipped_after_empty_operand);
+  RUN_TEST(test_scan_budget);
+  RUN_TEST(test_explain_shows_scans_last);
   return UNITY_END();
 }
\ No newline at end of file
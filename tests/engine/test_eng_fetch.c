@@ -0,0 +1,344 @@
+#include "core/db.h"
+#include "core/deadline.h"
+#include "engine/api.h"
+#include "engine/eng_fetch/eng_fetch.h"
+#include "engine/range_pool/range_pool.h"
+#include "lmdb.h"
+#include "mpack.h"
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static MDB_env *test_env = NULL;
+static MDB_dbi events_db;
+static char test_db_path[256];
+
+static void _put_events(uint32_t from, uint32_t to, uint32_t step) {
+  MDB_txn *txn = db_create_txn(test_env, false);
+  TEST_ASSERT_NOT_NULL(txn);
+  for (uint32_t id = from; id <= to; id += step) {
+    char val[32];
+    int len = snprintf(val, sizeof(val), "event-%u", id);
+    db_key_t key = {.type = DB_KEY_U32, .key = {.u32 = id}};
+    TEST_ASSERT_EQUAL(DB_PUT_OK,
+                      db_put(events_db, txn, &key, val, len, false, false));
+  }
+  TEST_ASSERT_TRUE(db_commit_txn(txn));
+}
+
+static void _assert_obj(api_obj_t *o, uint32_t expected_id) {
+  char expected[32];
+  int len = snprintf(expected, sizeof(expected), "event-%u", expected_id);
+  TEST_ASSERT_EQUAL_UINT32(expected_id, o->id);
+  TEST_ASSERT_EQUAL_size_t(len, o->data_size);
+  TEST_ASSERT_EQUAL_MEMORY(expected, o->data, len);
+}
+
+static void _free_objs(api_obj_t *objs, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    free(objs[i].data);
+  }
+}
+
+void setUp(void) {
+  srand((unsigned int)time(NULL));
+  snprintf(test_db_path, sizeof(test_db_path), "/tmp/test_eng_fetch_%d_%d",
+           getpid(), rand());
+  test_env = db_create_env(test_db_path, 64 * 1024 * 1024, 4);
+  TEST_ASSERT_NOT_NULL(test_env);
+  TEST_ASSERT_TRUE(db_open(test_env, "events", true, DB_DUP_NONE, &events_db));
+}
+
+void tearDown(void) {
+  if (test_env) {
+    db_close(test_env, events_db);
+    db_env_close(test_env);
+    test_env = NULL;
+  }
+  char lock_path[300];
+  snprintf(lock_path, sizeof(lock_path), "%s-lock", test_db_path);
+  unlink(test_db_path);
+  unlink(lock_path);
+}
+
+void test_fetch_sequential_ids(void) {
+  _put_events(1, 10, 1);
+  uint32_t ids[] = {1, 2, 3, 4, 5};
+  api_obj_t objs[5];
+  uint32_t found = 0;
+
+  MDB_txn *txn = db_create_txn(test_env, true);
+  TEST_ASSERT_TRUE(eng_fetch_events(test_env, txn, events_db, ids, 5, NULL,
+                                    NULL, objs, &found));
+  db_abort_txn(txn);
+
+  TEST_ASSERT_EQUAL_UINT32(5, found);
+  for (uint32_t i = 0; i < found; i++) {
+    _assert_obj(&objs[i], ids[i]);
+  }
+  _free_objs(objs, found);
+}
+
+void test_fetch_skips_gaps_and_missing(void) {
+  // Only even ids exist
+  _put_events(2, 200, 2);
+  // 3 and 5 are missing, 150 requires a re-seek, 999 is past the end
+  uint32_t ids[] = {2, 3, 4, 5, 6, 150, 200, 999};
+  api_obj_t objs[8];
+  uint32_t found = 0;
+
+  MDB_txn *txn = db_create_txn(test_env, true);
+  TEST_ASSERT_TRUE(eng_fetch_events(test_env, txn, events_db, ids, 8, NULL,
+                                    NULL, objs, &found));
+  db_abort_txn(txn);
+
+  uint32_t expected[] = {2, 4, 6, 150, 200};
+  TEST_ASSERT_EQUAL_UINT32(5, found);
+  for (uint32_t i = 0; i < found; i++) {
+    _assert_obj(&objs[i], expected[i]);
+  }
+  _free_objs(objs, found);
+}
+
+void test_fetch_empty(void) {
+  _put_events(1, 1, 1);
+  uint32_t found = 1;
+  MDB_txn *txn = db_create_txn(test_env, true);
+  TEST_ASSERT_TRUE(eng_fetch_events(test_env, txn, events_db, NULL, 0, NULL,
+                                    NULL, NULL, &found));
+  db_abort_txn(txn);
+  TEST_ASSERT_EQUAL_UINT32(0, found);
+}
+
+void test_fetch_parallel_preserves_order(void) {
+  uint32_t n = ENG_FETCH_PARALLEL_MIN * 3;
+  _put_events(1, n, 1);
+
+  // Every other id, so each range has gaps
+  uint32_t count = n / 2;
+  uint32_t *ids = malloc(count * sizeof(uint32_t));
+  api_obj_t *objs = malloc(count * sizeof(api_obj_t));
+  TEST_ASSERT_NOT_NULL(ids);
+  TEST_ASSERT_NOT_NULL(objs);
+  for (uint32_t i = 0; i < count; i++) {
+    ids[i] = 1 + i * 2;
+  }
+
+  uint32_t found = 0;
+  MDB_txn *txn = db_create_txn(test_env, true);
+  TEST_ASSERT_TRUE(eng_fetch_events(test_env, txn, events_db, ids, count, NULL,
+                                    NULL, objs, &found));
+  db_abort_txn(txn);
+
+  TEST_ASSERT_EQUAL_UINT32(count, found);
+  for (uint32_t i = 0; i < found; i++) {
+    _assert_obj(&objs[i], ids[i]);
+  }
+
+  _free_objs(objs, found);
+  free(objs);
+  free(ids);
+}
+
+static void _put_msgpack_event(uint32_t id) {
+  char *data = NULL;
+  size_t size = 0;
+  mpack_writer_t writer;
+  mpack_writer_init_growable(&writer, &data, &size);
+  mpack_build_map(&writer);
+  mpack_write_cstr(&writer, "id");
+  mpack_write_u32(&writer, id);
+  mpack_write_cstr(&writer, "in");
+  mpack_write_cstr(&writer, "analytics");
+  mpack_write_cstr(&writer, "entity");
+  mpack_write_cstr(&writer, "user-1");
+  mpack_write_cstr(&writer, "ts");
+  mpack_write_i64(&writer, 1700000000000LL);
+  mpack_write_cstr(&writer, "color");
+  mpack_write_cstr(&writer, "blue");
+  mpack_write_cstr(&writer, "tags");
+  mpack_start_array(&writer, 2);
+  mpack_write_cstr(&writer, "a");
+  mpack_write_cstr(&writer, "b");
+  mpack_finish_array(&writer);
+  mpack_complete_map(&writer);
+  TEST_ASSERT_EQUAL(mpack_ok, mpack_writer_destroy(&writer));
+
+  MDB_txn *txn = db_create_txn(test_env, false);
+  TEST_ASSERT_NOT_NULL(txn);
+  db_key_t key = {.type = DB_KEY_U32, .key = {.u32 = id}};
+  TEST_ASSERT_EQUAL(DB_PUT_OK,
+                    db_put(events_db, txn, &key, data, size, false, false));
+  TEST_ASSERT_TRUE(db_commit_txn(txn));
+  free(data);
+}
+
+void test_fetch_projects_fields(void) {
+  _put_msgpack_event(1);
+  eng_fetch_fields_t fields = {
+      .names = {"tags", "missing"}, .lens = {4, 7}, .count = 2};
+  uint32_t ids[] = {1};
+  api_obj_t objs[1];
+  uint32_t found = 0;
+
+  MDB_txn *txn = db_create_txn(test_env, true);
+  TEST_ASSERT_TRUE(eng_fetch_events(test_env, txn, events_db, ids, 1, &fields,
+                                    NULL, objs, &found));
+  db_abort_txn(txn);
+  TEST_ASSERT_EQUAL_UINT32(1, found);
+
+  mpack_tree_t tree;
+  mpack_tree_init_data(&tree, objs[0].data, objs[0].data_size);
+  mpack_tree_parse(&tree);
+  mpack_node_t root = mpack_tree_root(&tree);
+  // `id` and `ts` are always kept
+  TEST_ASSERT_EQUAL_UINT32(3, mpack_node_map_count(root));
+  TEST_ASSERT_EQUAL_UINT32(1, mpack_node_u32(mpack_node_map_cstr(root, "id")));
+  TEST_ASSERT_EQUAL_INT64(1700000000000LL,
+                          mpack_node_i64(mpack_node_map_cstr(root, "ts")));
+  mpack_node_t tags = mpack_node_map_cstr(root, "tags");
+  TEST_ASSERT_EQUAL_UINT32(2, mpack_node_array_length(tags));
+  TEST_ASSERT_FALSE(mpack_node_map_contains_cstr(root, "color"));
+  TEST_ASSERT_FALSE(mpack_node_map_contains_cstr(root, "entity"));
+  TEST_ASSERT_EQUAL(mpack_ok, mpack_tree_destroy(&tree));
+  _free_objs(objs, found);
+}
+
+void test_fetch_projection_keeps_undecodable_blob(void) {
+  // Plain strings are not msgpack maps, returned as-is
+  _put_events(1, 1, 1);
+  eng_fetch_fields_t fields = {.names = {"color"}, .lens = {5}, .count = 1};
+  uint32_t ids[] = {1};
+  api_obj_t objs[1];
+  uint32_t found = 0;
+
+  MDB_txn *txn = db_create_txn(test_env, true);
+  TEST_ASSERT_TRUE(eng_fetch_events(test_env, txn, events_db, ids, 1, &fields,
+                                    NULL, objs, &found));
+  db_abort_txn(txn);
+  TEST_ASSERT_EQUAL_UINT32(1, found);
+  _assert_obj(&objs[0], 1);
+  _free_objs(objs, found);
+}
+
+static void _assert_fetch_stops(const deadline_t *deadline) {
+  uint32_t count = 1000;
+  _put_events(1, count, 1);
+  uint32_t *ids = malloc(count * sizeof(uint32_t));
+  api_obj_t *objs = malloc(count * sizeof(api_obj_t));
+  TEST_ASSERT_NOT_NULL(ids);
+  TEST_ASSERT_NOT_NULL(objs);
+  for (uint32_t i = 0; i < count; i++) {
+    ids[i] = i + 1;
+  }
+
+  uint32_t found = 0;
+  MDB_txn *txn = db_create_txn(test_env, true);
+  TEST_ASSERT_FALSE(eng_fetch_events(test_env, txn, events_db, ids, count,
+                                     NULL, deadline, objs, &found));
+  db_abort_txn(txn);
+  TEST_ASSERT_EQUAL_UINT32(0, found);
+  free(objs);
+  free(ids);
+}
+
+void test_fetch_stops_at_expired_deadline(void) {
+  deadline_t deadline = {.expires_ns = 1, .alive = NULL};
+  _assert_fetch_stops(&deadline);
+}
+
+void test_fetch_stops_when_cancelled(void) {
+  atomic_int alive = 0;
+  deadline_t deadline;
+  deadline_init(&deadline, 0, &alive);
+  _assert_fetch_stops(&deadline);
+}
+
+// Blobs `event-<id>` whose id ends with the digit `arg` points to
+static bool _ends_with(const void *arg, const char *data, size_t size) {
+  return size > 0 && data[size - 1] == *(const char *)arg;
+}
+
+void test_match_keeps_matching_ids_in_order(void) {
+  uint32_t n = ENG_FETCH_PARALLEL_MIN * 3;
+  _put_events(1, n, 1);
+
+  // Every other id plus ids past the last event, so ranges have gaps
+  uint32_t count = n / 2 + 10;
+  uint32_t *ids = malloc(count * sizeof(uint32_t));
+  uint32_t *hits = malloc(count * sizeof(uint32_t));
+  TEST_ASSERT_NOT_NULL(ids);
+  TEST_ASSERT_NOT_NULL(hits);
+  for (uint32_t i = 0; i < count; i++) {
+    ids[i] = 1 + i * 2;
+  }
+
+  char digit = '5';
+  uint32_t num_hits = 0;
+  MDB_txn *txn = db_create_txn(test_env, true);
+  TEST_ASSERT_TRUE(eng_fetch_match(test_env, txn, events_db, ids, count,
+                                   _ends_with, &digit, NULL, hits,
+                                   &num_hits));
+  db_abort_txn(txn);
+
+  // Odd ids up to n ending in 5
+  TEST_ASSERT_EQUAL_UINT32(n / 10, num_hits);
+  for (uint32_t i = 0; i < num_hits; i++) {
+    TEST_ASSERT_EQUAL_UINT32(5 + i * 10, hits[i]);
+  }
+  free(hits);
+  free(ids);
+}
+
+void test_match_empty(void) {
+  char digit = '1';
+  uint32_t num_hits = 1;
+  MDB_txn *txn = db_create_txn(test_env, true);
+  TEST_ASSERT_TRUE(eng_fetch_match(test_env, txn, events_db, NULL, 0,
+                                   _ends_with, &digit, NULL, NULL, &num_hits));
+  TEST_ASSERT_FALSE(eng_fetch_match(test_env, txn, events_db, NULL, 0, NULL,
+                                    NULL, NULL, NULL, &num_hits));
+  db_abort_txn(txn);
+  TEST_ASSERT_EQUAL_UINT32(0, num_hits);
+}
+
+void test_match_stops_at_expired_deadline(void) {
+  _put_events(1, 1000, 1);
+  uint32_t ids[1000];
+  uint32_t hits[1000];
+  for (uint32_t i = 0; i < 1000; i++) {
+    ids[i] = i + 1;
+  }
+  char digit = '1';
+  uint32_t num_hits = 0;
+  deadline_t deadline = {.expires_ns = 1, .alive = NULL};
+  MDB_txn *txn = db_create_txn(test_env, true);
+  TEST_ASSERT_FALSE(eng_fetch_match(test_env, txn, events_db, ids, 1000,
+                                    _ends_with, &digit, &deadline, hits,
+                                    &num_hits));
+  db_abort_txn(txn);
+  TEST_ASSERT_EQUAL_UINT32(0, num_hits);
+}
+
+int main(void) {
+  // Parallel walks run on the pool, as in the server
+  TEST_ASSERT_TRUE(range_pool_init(ENG_FETCH_MAX_THREADS - 1));
+  UNITY_BEGIN();
+  RUN_TEST(test_fetch_sequential_ids);
+  RUN_TEST(test_fetch_skips_gaps_and_missing);
+  RUN_TEST(test_fetch_empty);
+  RUN_TEST(test_fetch_parallel_preserves_order);
+  RUN_TEST(test_fetch_projects_fields);
+  RUN_TEST(test_fetch_projection_keeps_undecodable_blob);
+  RUN_TEST(test_fetch_stops_at_expired_deadline);
+  RUN_TEST(test_fetch_stops_when_cancelled);
+  RUN_TEST(test_match_keeps_matching_ids_in_order);
+  RUN_TEST(test_match_empty);
+  RUN_TEST(test_match_stops_at_expired_deadline);
+  int failures = UNITY_END();
+  range_pool_destroy();
+  return failures;
+}
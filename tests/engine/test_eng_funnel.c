@@ -0,0 +1,183 @@
+#include "core/bitmaps.h"
+#include "core/db.h"
+#include "core/mmap_array.h"
+#include "engine/eng_funnel/eng_funnel.h"
+#include "engine/range_pool/range_pool.h"
+#include "lmdb.h"
+#include "mpack.h"
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static MDB_env *test_env = NULL;
+static MDB_dbi events_db;
+static mmap_array_t ent_map;
+static char test_db_path[256];
+static char test_map_path[300];
+
+void setUp(void) {
+  srand((unsigned int)time(NULL));
+  snprintf(test_db_path, sizeof(test_db_path), "/tmp/test_eng_funnel_%d_%d",
+           getpid(), rand());
+  test_env = db_create_env(test_db_path, 16 * 1024 * 1024, 4);
+  TEST_ASSERT_NOT_NULL(test_env);
+  TEST_ASSERT_TRUE(db_open(test_env, "events", true, DB_DUP_NONE, &events_db));
+
+  snprintf(test_map_path, sizeof(test_map_path), "%s.bin", test_db_path);
+  mmap_array_config_t cfg = {
+      .path = test_map_path, .item_size = sizeof(uint32_t), .initial_cap = 64};
+  TEST_ASSERT_EQUAL_INT(0, mmap_array_open(&ent_map, &cfg));
+}
+
+void tearDown(void) {
+  if (test_env) {
+    db_close(test_env, events_db);
+    db_env_close(test_env);
+    test_env = NULL;
+  }
+  mmap_array_close(&ent_map);
+  char lock_path[300];
+  snprintf(lock_path, sizeof(lock_path), "%s-lock", test_db_path);
+  unlink(test_db_path);
+  unlink(lock_path);
+  unlink(test_map_path);
+}
+
+// Event blob like the encoder's, `ts` after `id`
+static void _put_event(uint32_t id, uint32_t entity_id, int64_t ts) {
+  char *data = NULL;
+  size_t size = 0;
+  mpack_writer_t writer;
+  mpack_writer_init_growable(&writer, &data, &size);
+  mpack_start_map(&writer, 3);
+  mpack_write_cstr(&writer, "id");
+  mpack_write_u32(&writer, id);
+  mpack_write_cstr(&writer, "ts");
+  mpack_write_i64(&writer, ts);
+  mpack_write_cstr(&writer, "page");
+  mpack_write_cstr(&writer, "home");
+  mpack_finish_map(&writer);
+  TEST_ASSERT_EQUAL(mpack_ok, mpack_writer_destroy(&writer));
+
+  MDB_txn *txn = db_create_txn(test_env, false);
+  db_key_t key = {.type = DB_KEY_U32, .key = {.u32 = id}};
+  TEST_ASSERT_EQUAL(DB_PUT_OK,
+                    db_put(events_db, txn, &key, data, size, false, false));
+  TEST_ASSERT_TRUE(db_commit_txn(txn));
+  free(data);
+  TEST_ASSERT_EQUAL_INT(0, mmap_array_set(&ent_map, id, &entity_id));
+}
+
+static eng_funnel_event_t _ev(uint32_t entity_id, uint32_t mask, int64_t ts) {
+  return (eng_funnel_event_t){
+      .entity_id = entity_id, .step_mask = mask, .ts = ts};
+}
+
+void test_count_orders_and_window(void) {
+  eng_funnel_event_t events[] = {
+      // Entity 1 completes A, B, C
+      _ev(1, 1, 0), _ev(1, 2, 10), _ev(1, 4, 20),
+      // Entity 2 does B too late
+      _ev(2, 1, 0), _ev(2, 4, 5), _ev(2, 2, 40),
+      // Entity 3 does B before A, then again after
+      _ev(3, 2, 0), _ev(3, 1, 5), _ev(3, 2, 10),
+      // One event is never two steps
+      _ev(4, 3, 0),
+      // A later A restarts the window
+      _ev(5, 1, 0), _ev(5, 1, 100), _ev(5, 2, 110)};
+  uint64_t counts[3];
+  const char *err = NULL;
+  TEST_ASSERT_TRUE(eng_funnel_count(events, 13, 3, 30, NULL, counts, &err));
+  TEST_ASSERT_EQUAL_UINT64(5, counts[0]);
+  TEST_ASSERT_EQUAL_UINT64(3, counts[1]);
+  TEST_ASSERT_EQUAL_UINT64(1, counts[2]);
+}
+
+void test_count_parallel_partitions(void) {
+  // Enough events for every thread, entities interleaved
+  uint32_t count = 4 * ENG_FUNNEL_PARALLEL_MIN;
+  eng_funnel_event_t *events = malloc(count * sizeof(eng_funnel_event_t));
+  TEST_ASSERT_NOT_NULL(events);
+  uint32_t num_entities = count / 2;
+  for (uint32_t i = 0; i < num_entities; i++) {
+    events[i] = _ev(i + 1, 1, i);
+    // Every third entity converts too late
+    int64_t delay = (i % 3 == 0) ? 5000 : 10;
+    events[num_entities + i] = _ev(i + 1, 2, i + delay);
+  }
+  uint64_t counts[2];
+  const char *err = NULL;
+  TEST_ASSERT_TRUE(
+      eng_funnel_count(events, count, 2, 1000, NULL, counts, &err));
+  TEST_ASSERT_EQUAL_UINT64(num_entities, counts[0]);
+  TEST_ASSERT_EQUAL_UINT64(num_entities - (num_entities + 2) / 3, counts[1]);
+  free(events);
+}
+
+void test_load_joins_entities_and_ts(void) {
+  _put_event(1, 7, 1000);
+  _put_event(2, 8, 1500);
+  _put_event(4, 7, 1400);
+  _put_event(40, 8, 2500);
+  // Id 3 is not flushed, id 5 has no entity
+  uint32_t no_entity = 0;
+  TEST_ASSERT_EQUAL_INT(0, mmap_array_set(&ent_map, 3, &(uint32_t){9}));
+  TEST_ASSERT_EQUAL_INT(0, mmap_array_set(&ent_map, 5, &no_entity));
+
+  bitmap_t *a = bitmap_create();
+  bitmap_t *b = bitmap_create();
+  bitmap_add(a, 1);
+  bitmap_add(a, 2);
+  bitmap_add(a, 3);
+  bitmap_add(b, 4);
+  bitmap_add(b, 5);
+  bitmap_add(b, 40);
+  bitmap_t *steps[] = {a, b};
+
+  MDB_txn *txn = db_create_txn(test_env, true);
+  eng_funnel_load_args_t args = {.txn = txn,
+                                 .events_db = events_db,
+                                 .event_to_entity_map = &ent_map,
+                                 .steps = steps,
+                                 .num_steps = 2};
+  eng_funnel_event_t *events = NULL;
+  uint32_t count = 0;
+  const char *err = NULL;
+  TEST_ASSERT_TRUE(eng_funnel_load(&args, &events, &count, &err));
+  db_abort_txn(txn);
+
+  TEST_ASSERT_EQUAL_UINT32(4, count);
+  TEST_ASSERT_EQUAL_UINT32(7, events[0].entity_id);
+  TEST_ASSERT_EQUAL_UINT32(1, events[0].step_mask);
+  TEST_ASSERT_EQUAL_INT64(1000, events[0].ts);
+  TEST_ASSERT_EQUAL_UINT32(8, events[1].entity_id);
+  TEST_ASSERT_EQUAL_UINT32(7, events[2].entity_id);
+  TEST_ASSERT_EQUAL_UINT32(2, events[2].step_mask);
+  TEST_ASSERT_EQUAL_INT64(1400, events[2].ts);
+  TEST_ASSERT_EQUAL_UINT32(8, events[3].entity_id);
+  TEST_ASSERT_EQUAL_INT64(2500, events[3].ts);
+
+  uint64_t counts[2];
+  TEST_ASSERT_TRUE(eng_funnel_count(events, count, 2, 600, NULL, counts, &err));
+  TEST_ASSERT_EQUAL_UINT64(2, counts[0]);
+  // Entity 8 takes 1000ms
+  TEST_ASSERT_EQUAL_UINT64(1, counts[1]);
+  free(events);
+  bitmap_free(a);
+  bitmap_free(b);
+}
+
+int main(void) {
+  // Parallel walks run on the pool, as in the server
+  TEST_ASSERT_TRUE(range_pool_init(ENG_FUNNEL_MAX_THREADS - 1));
+  UNITY_BEGIN();
+  RUN_TEST(test_count_orders_and_window);
+  RUN_TEST(test_count_parallel_partitions);
+  RUN_TEST(test_load_joins_entities_and_ts);
+  int failures = UNITY_END();
+  range_pool_destroy();
+  return failures;
+}
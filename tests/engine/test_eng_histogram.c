@@ -0,0 +1,98 @@
+#include "core/bitmaps.h"
+#include "core/db.h"
+#include "engine/eng_histogram/eng_histogram.h"
+#include "lmdb.h"
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static MDB_env *test_env = NULL;
+static MDB_dbi ts_db;
+static char test_db_path[256];
+
+void setUp(void) {
+  srand((unsigned int)time(NULL));
+  snprintf(test_db_path, sizeof(test_db_path), "/tmp/test_eng_histogram_%d_%d",
+           getpid(), rand());
+  test_env = db_create_env(test_db_path, 16 * 1024 * 1024, 8);
+  TEST_ASSERT_NOT_NULL(test_env);
+  // Like the `ts` index: integer keys, event ids as fixed size duplicates
+  TEST_ASSERT_TRUE(
+      db_open(test_env, "ts", true, DB_DUP_KEYS_FIXED_SIZE_VALS, &ts_db));
+}
+
+void tearDown(void) {
+  if (test_env) {
+    db_close(test_env, ts_db);
+    db_env_close(test_env);
+    test_env = NULL;
+  }
+  char lock_path[300];
+  snprintf(lock_path, sizeof(lock_path), "%s-lock", test_db_path);
+  unlink(test_db_path);
+  unlink(lock_path);
+}
+
+static void _put(int64_t ts, uint32_t event_id) {
+  MDB_txn *txn = db_create_txn(test_env, false);
+  db_key_t key = {.type = DB_KEY_I64, .key.i64 = ts};
+  TEST_ASSERT_EQUAL(DB_PUT_OK, db_put(ts_db, txn, &key, &event_id,
+                                      sizeof(event_id), false, false));
+  TEST_ASSERT_TRUE(db_commit_txn(txn));
+}
+
+void test_num_buckets(void) {
+  TEST_ASSERT_EQUAL_UINT64(3, eng_histogram_num_buckets(0, 3000, 1000));
+  // The last bucket may be short
+  TEST_ASSERT_EQUAL_UINT64(4, eng_histogram_num_buckets(0, 3001, 1000));
+  TEST_ASSERT_EQUAL_UINT64(0, eng_histogram_num_buckets(10, 10, 1000));
+}
+
+void test_edges_and_counts(void) {
+  // Event i arrives at 1000 + 100 * i
+  for (uint32_t i = 0; i < 30; i++) {
+    _put(1000 + 100 * (int64_t)i, i);
+  }
+  // Duplicates sort by bytes, so 256 comes before 10 on an edge
+  _put(2000, 256);
+
+  MDB_txn *txn = db_create_txn(test_env, true);
+  uint64_t edges[4];
+  TEST_ASSERT_TRUE(
+      eng_histogram_edges(txn, ts_db, 1000, 3500, 1000, 3, edges));
+  TEST_ASSERT_EQUAL_UINT64(0, edges[0]);
+  TEST_ASSERT_EQUAL_UINT64(10, edges[1]);
+  TEST_ASSERT_EQUAL_UINT64(20, edges[2]);
+  TEST_ASSERT_EQUAL_UINT64(25, edges[3]);
+
+  bitmap_t *events = bitmap_create();
+  for (uint32_t i = 0; i < 30; i += 2) {
+    bitmap_add(events, i);
+  }
+  uint64_t counts[3];
+  eng_histogram_counts(events, edges, 3, counts);
+  TEST_ASSERT_EQUAL_UINT64(5, counts[0]);
+  TEST_ASSERT_EQUAL_UINT64(5, counts[1]);
+  TEST_ASSERT_EQUAL_UINT64(3, counts[2]);
+
+  // Edges past the last timestamp take in every later event
+  TEST_ASSERT_TRUE(
+      eng_histogram_edges(txn, ts_db, 3000, 5000, 1000, 2, edges));
+  TEST_ASSERT_EQUAL_UINT64(20, edges[0]);
+  TEST_ASSERT_EQUAL_UINT64((uint64_t)UINT32_MAX + 1, edges[1]);
+  eng_histogram_counts(events, edges, 2, counts);
+  TEST_ASSERT_EQUAL_UINT64(5, counts[0]);
+  TEST_ASSERT_EQUAL_UINT64(0, counts[1]);
+  db_abort_txn(txn);
+  bitmap_free(events);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_num_buckets);
+  RUN_TEST(test_edges_and_counts);
+  return UNITY_END();
+}
@@ -136,6 +136,38 @@ void test_db_key_into_invalid_type(void) {
   TEST_ASSERT_FALSE(db_key_into(buffer, sizeof(buffer), &db_key));
 }
 
+// ====================================================================
+// Entity Events Key Tests
+// ====================================================================
+
+void test_entity_events_key_into_success(void) {
+  char buffer[64];
+  TEST_ASSERT_TRUE(entity_events_key_into(buffer, sizeof(buffer), 42));
+  TEST_ASSERT_EQUAL_STRING("entity|42", buffer);
+}
+
+void test_entity_events_key_into_buffer_too_small(void) {
+  char buffer[8];
+  TEST_ASSERT_FALSE(entity_events_key_into(buffer, sizeof(buffer), 123456));
+}
+
+// ====================================================================
+// BSI Key Tests
+// ====================================================================
+
+void test_bsi_key_into_success(void) {
+  char buffer[64];
+  TEST_ASSERT_TRUE(bsi_key_into(buffer, sizeof(buffer), "amount", 7));
+  TEST_ASSERT_EQUAL_STRING("bsi|amount|7", buffer);
+  TEST_ASSERT_TRUE(bsi_key_into(buffer, sizeof(buffer), "amount", 64));
+  TEST_ASSERT_EQUAL_STRING("bsi|amount|64", buffer);
+}
+
+void test_bsi_key_into_buffer_too_small(void) {
+  char buffer[8];
+  TEST_ASSERT_FALSE(bsi_key_into(buffer, sizeof(buffer), "amount", 12));
+}
+
 // --- Main Test Runner ---
 int main(void) {
   UNITY_BEGIN();
@@ -152,5 +184,13 @@ int main(void) {
   RUN_TEST(test_db_key_into_buffer_too_small);
   RUN_TEST(test_db_key_into_invalid_type);
 
+  // entity_events_key_into tests
+  RUN_TEST(test_entity_events_key_into_success);
+  RUN_TEST(test_entity_events_key_into_buffer_too_small);
+
+  // bsi_key_into tests
+  RUN_TEST(test_bsi_key_into_success);
+  RUN_TEST(test_bsi_key_into_buffer_too_small);
+
   return UNITY_END();
 }
\ No newline at end of file
@@ -0,0 +1,96 @@
+#include "engine/eng_profile/eng_profile.h"
+#include "mpack.h"
+#include "unity.h"
+#include <stdlib.h>
+#include <string.h>
+
+static eng_profile_t profile;
+
+void setUp(void) { eng_profile_init(&profile, true); }
+
+void tearDown(void) {}
+
+void test_nodes_nest_and_count_reads(void) {
+  int32_t and_idx = eng_profile_enter(&profile, "and", NULL, NULL);
+  int32_t tag_idx = eng_profile_enter(&profile, "tag", "loc:ca", "bitmap");
+  eng_profile_read(&profile, ENG_PROFILE_SRC_LMDB, -1, 40);
+  eng_profile_read(&profile, ENG_PROFILE_SRC_CONSUMER_CACHE, 3, 0);
+  eng_profile_exit(&profile, tag_idx, 7);
+  eng_profile_steps(&profile, 2);
+  eng_profile_exit(&profile, and_idx, 7);
+
+  TEST_ASSERT_EQUAL_INT32(-1, profile.cur);
+  TEST_ASSERT_EQUAL_UINT32(2, profile.count);
+  TEST_ASSERT_EQUAL_INT32(and_idx, profile.nodes[tag_idx].parent);
+  TEST_ASSERT_EQUAL_UINT64(40, profile.nodes[tag_idx].bytes);
+  TEST_ASSERT_EQUAL_INT32(3, profile.nodes[tag_idx].consumer);
+  TEST_ASSERT_EQUAL_UINT64(7, profile.nodes[tag_idx].card);
+  // Steps go to the innermost open node
+  TEST_ASSERT_EQUAL_UINT64(2, profile.nodes[and_idx].cursor_steps);
+
+  // Reads outside any node are dropped
+  eng_profile_read(&profile, ENG_PROFILE_SRC_LMDB, -1, 8);
+  TEST_ASSERT_EQUAL_UINT64(40, profile.nodes[tag_idx].bytes);
+}
+
+void test_full_profile_truncates(void) {
+  for (uint32_t i = 0; i < ENG_PROFILE_MAX_NODES; i++) {
+    eng_profile_exit(&profile, eng_profile_enter(&profile, "tag", "a:1", NULL),
+                     0);
+  }
+  TEST_ASSERT_FALSE(profile.truncated);
+  int32_t idx = eng_profile_enter(&profile, "tag", "a:2", NULL);
+  TEST_ASSERT_EQUAL_INT32(-1, idx);
+  TEST_ASSERT_TRUE(profile.truncated);
+  eng_profile_exit(&profile, idx, 0);
+  TEST_ASSERT_EQUAL_INT32(-1, profile.cur);
+}
+
+void test_write_plan_tree(void) {
+  eng_profile_init(&profile, false);
+  int32_t or_idx = eng_profile_enter(&profile, "or", NULL, NULL);
+  int32_t a = eng_profile_enter(&profile, "tag", "loc:ca", "bitmap");
+  eng_profile_estimate(&profile, a, 12);
+  eng_profile_exit(&profile, a, 0);
+  eng_profile_exit(&profile, eng_profile_enter(&profile, "compare",
+                                               "amount > 5", "index_scan"),
+                   0);
+  eng_profile_exit(&profile, or_idx, 0);
+
+  char *data = NULL;
+  size_t size = 0;
+  mpack_writer_t writer;
+  mpack_writer_init_growable(&writer, &data, &size);
+  eng_profile_write(&writer, &profile);
+  TEST_ASSERT_EQUAL(mpack_ok, mpack_writer_destroy(&writer));
+
+  mpack_tree_t tree;
+  mpack_tree_init_data(&tree, data, size);
+  mpack_tree_parse(&tree);
+  mpack_node_t plan = mpack_tree_root(&tree);
+  // EXPLAIN plans have no timings
+  TEST_ASSERT_FALSE(mpack_node_map_contains_cstr(plan, "eval_ns"));
+  mpack_node_t root = mpack_node_map_cstr(plan, "root");
+  TEST_ASSERT_FALSE(mpack_node_map_contains_cstr(root, "ns"));
+  mpack_node_t children = mpack_node_map_cstr(root, "children");
+  TEST_ASSERT_EQUAL_UINT32(2, mpack_node_array_length(children));
+  mpack_node_t tag = mpack_node_array_at(children, 0);
+  TEST_ASSERT_EQUAL_UINT64(
+      12, mpack_node_u64(mpack_node_map_cstr(tag, "estimate")));
+  mpack_node_t cmp = mpack_node_array_at(children, 1);
+  char access[32];
+  mpack_node_copy_cstr(mpack_node_map_cstr(cmp, "access"), access,
+                       sizeof(access));
+  TEST_ASSERT_EQUAL_STRING("index_scan", access);
+  TEST_ASSERT_FALSE(mpack_node_map_contains_cstr(cmp, "children"));
+  TEST_ASSERT_EQUAL(mpack_ok, mpack_tree_destroy(&tree));
+  free(data);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_nodes_nest_and_count_reads);
+  RUN_TEST(test_full_profile_truncates);
+  RUN_TEST(test_write_plan_tree);
+  return UNITY_END();
+}
@@ -0,0 +1,158 @@
+#include "core/db.h"
+#include "engine/eng_rollup/eng_rollup.h"
+#include "engine/rollup/rollup.h"
+#include "lmdb.h"
+#include "query/ast.h"
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static MDB_env *test_env = NULL;
+static MDB_dbi rollup_db;
+static char test_db_path[256];
+
+// Counts `action` per second
+static rollup_t by_action = {
+    .id = "action|1000", .keys = {"action"}, .num_keys = 1, .bucket_ms = 1000};
+static rollup_t by_action_country = {.id = "action,country|1000",
+                                     .keys = {"action", "country"},
+                                     .num_keys = 2,
+                                     .bucket_ms = 1000};
+
+static void _put_row(const rollup_t *r, uint64_t bucket, const char *values,
+                     uint64_t count) {
+  char key[MAX_ROLLUP_ROW_KEY_LEN];
+  TEST_ASSERT_TRUE(rollup_bucket_key_into(key, sizeof(key), r, bucket));
+  strcat(key, values);
+  MDB_txn *txn = db_create_txn(test_env, false);
+  db_key_t k = {.type = DB_KEY_STRING, .key.s = key};
+  TEST_ASSERT_EQUAL(DB_PUT_OK,
+                    db_put(rollup_db, txn, &k, &count, sizeof(count), false,
+                           false));
+  TEST_ASSERT_TRUE(db_commit_txn(txn));
+}
+
+static bool _read(const rollup_t *r, uint64_t from, uint64_t to,
+                  uint64_t bucket_ms, eng_rollup_result_t *out) {
+  MDB_txn *txn = db_create_txn(test_env, true);
+  const char *err = NULL;
+  bool ok = eng_rollup_read(txn, rollup_db, r, from, to, bucket_ms, out, &err);
+  db_abort_txn(txn);
+  return ok;
+}
+
+static void _assert_row(const eng_rollup_row_t *row, uint64_t bucket,
+                        const char *values, uint64_t count) {
+  TEST_ASSERT_EQUAL_UINT64(bucket, row->bucket);
+  TEST_ASSERT_EQUAL_STRING(values, row->values);
+  TEST_ASSERT_EQUAL_UINT64(count, row->count);
+}
+
+void setUp(void) {
+  srand((unsigned int)time(NULL));
+  snprintf(test_db_path, sizeof(test_db_path), "/tmp/test_eng_rollup_%d_%d",
+           getpid(), rand());
+  test_env = db_create_env(test_db_path, 16 * 1024 * 1024, 4);
+  TEST_ASSERT_NOT_NULL(test_env);
+  TEST_ASSERT_TRUE(
+      db_open(test_env, "rollup", false, DB_DUP_NONE, &rollup_db));
+}
+
+void tearDown(void) {
+  if (test_env) {
+    db_close(test_env, rollup_db);
+    db_env_close(test_env);
+    test_env = NULL;
+  }
+  char lock_path[300];
+  snprintf(lock_path, sizeof(lock_path), "%s-lock", test_db_path);
+  unlink(test_db_path);
+  unlink(lock_path);
+}
+
+void test_reads_rows_in_range(void) {
+  _put_row(&by_action, 1000, "view", 3);
+  _put_row(&by_action, 2000, "buy", 1);
+  _put_row(&by_action, 2000, "view", 5);
+  _put_row(&by_action, 5000, "view", 7);
+  // Another rollup's rows sort right after
+  _put_row(&by_action_country, 2000, "view\x1fnl", 9);
+
+  eng_rollup_result_t res;
+  TEST_ASSERT_TRUE(_read(&by_action, 1500, 5000, 1000, &res));
+  TEST_ASSERT_EQUAL_UINT32(3, res.count);
+  // `from` is aligned down, `to` is exclusive
+  _assert_row(&res.rows[0], 1000, "view", 3);
+  _assert_row(&res.rows[1], 2000, "buy", 1);
+  _assert_row(&res.rows[2], 2000, "view", 5);
+  eng_rollup_result_free(&res);
+}
+
+void test_sums_rows_into_coarser_buckets(void) {
+  _put_row(&by_action, 0, "view", 1);
+  _put_row(&by_action, 1000, "buy", 2);
+  _put_row(&by_action, 59000, "view", 4);
+  _put_row(&by_action, 60000, "view", 8);
+
+  eng_rollup_result_t res;
+  TEST_ASSERT_TRUE(_read(&by_action, 0, 120000, 60000, &res));
+  TEST_ASSERT_EQUAL_UINT32(3, res.count);
+  _assert_row(&res.rows[0], 0, "buy", 2);
+  _assert_row(&res.rows[1], 0, "view", 5);
+  _assert_row(&res.rows[2], 60000, "view", 8);
+  eng_rollup_result_free(&res);
+}
+
+void test_empty_range(void) {
+  _put_row(&by_action, 1000, "view", 3);
+  eng_rollup_result_t res;
+  TEST_ASSERT_TRUE(_read(&by_action, 2000, 9000, 1000, &res));
+  TEST_ASSERT_EQUAL_UINT32(0, res.count);
+  eng_rollup_result_free(&res);
+  TEST_ASSERT_TRUE(_read(&by_action_country, 0, 9000, 1000, &res));
+  TEST_ASSERT_EQUAL_UINT32(0, res.count);
+  eng_rollup_result_free(&res);
+}
+
+void test_pick_coarsest_dividing_bucket(void) {
+  rollup_t rs[4] = {
+      {.id = "action|1000", .keys = {"action"}, .num_keys = 1,
+       .bucket_ms = 1000},
+      {.id = "action|60000", .keys = {"action"}, .num_keys = 1,
+       .bucket_ms = 60000},
+      {.id = "action|7000", .keys = {"action"}, .num_keys = 1,
+       .bucket_ms = 7000},
+      {.id = "country,action|60000", .keys = {"country", "action"},
+       .num_keys = 2, .bucket_ms = 60000},
+  };
+  rollup_set_t set = {.count = 4, .rollups = rs};
+  ast_node_t *action = ast_create_string_literal_node("action", 6);
+
+  TEST_ASSERT_EQUAL_PTR(&rs[1], eng_rollup_pick(&set, action, 3600000));
+  TEST_ASSERT_EQUAL_PTR(&rs[0], eng_rollup_pick(&set, action, 30000));
+  TEST_ASSERT_EQUAL_PTR(&rs[2], eng_rollup_pick(&set, action, 14000));
+  TEST_ASSERT_NULL(eng_rollup_pick(&set, action, 1500));
+
+  // Keys must match in order
+  ast_node_t *keys = ast_create_string_literal_node("action", 6);
+  keys->next = ast_create_string_literal_node("country", 7);
+  TEST_ASSERT_NULL(eng_rollup_pick(&set, keys, 60000));
+  ast_free(keys);
+  keys = ast_create_string_literal_node("country", 7);
+  keys->next = action;
+  TEST_ASSERT_EQUAL_PTR(&rs[3], eng_rollup_pick(&set, keys, 60000));
+  ast_free(keys);
+  TEST_ASSERT_NULL(eng_rollup_pick(NULL, NULL, 60000));
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_reads_rows_in_range);
+  RUN_TEST(test_sums_rows_into_coarser_buckets);
+  RUN_TEST(test_empty_range);
+  RUN_TEST(test_pick_coarsest_dividing_bucket);
+  return UNITY_END();
+}
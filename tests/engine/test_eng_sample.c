@@ -0,0 +1,111 @@
+#include "core/bitmaps.h"
+#include "engine/eng_sample/eng_sample.h"
+#include "unity.h"
+#include <stdint.h>
+
+void setUp(void) {}
+
+void tearDown(void) { eng_sample_shutdown(); }
+
+void test_sample_rate_is_close_to_pct(void) {
+  uint32_t n = 200000;
+  bitmap_t *s = eng_sample_bitmap(10, n);
+  TEST_ASSERT_NOT_NULL(s);
+  uint32_t card = bitmap_get_cardinality(s);
+  // 10% of 200k ids, within 5%
+  TEST_ASSERT_UINT32_WITHIN(1000, 20000, card);
+  TEST_ASSERT_FALSE(bitmap_contains(s, 0));
+  bitmap_free(s);
+}
+
+void test_sample_is_deterministic_and_nested(void) {
+  bitmap_t *a = eng_sample_bitmap(25, 100000);
+  bitmap_t *b = eng_sample_bitmap(25, 150000);
+  bitmap_t *wide = eng_sample_bitmap(50, 100000);
+
+  // A larger id space only adds ids past the old end
+  bitmap_t *common = bitmap_and(a, b);
+  TEST_ASSERT_EQUAL_UINT32(bitmap_get_cardinality(a),
+                           bitmap_get_cardinality(common));
+
+  // Every id kept at 25% is kept at 50%
+  bitmap_t *nested = bitmap_and(a, wide);
+  TEST_ASSERT_EQUAL_UINT32(bitmap_get_cardinality(a),
+                           bitmap_get_cardinality(nested));
+
+  bitmap_free(nested);
+  bitmap_free(common);
+  bitmap_free(wide);
+  bitmap_free(b);
+  bitmap_free(a);
+}
+
+void test_sample_full_and_invalid(void) {
+  bitmap_t *all = eng_sample_bitmap(100, 1000);
+  TEST_ASSERT_NOT_NULL(all);
+  TEST_ASSERT_EQUAL_UINT32(1000, bitmap_get_cardinality(all));
+  bitmap_free(all);
+
+  bitmap_t *empty = eng_sample_bitmap(50, 0);
+  TEST_ASSERT_NOT_NULL(empty);
+  TEST_ASSERT_TRUE(bitmap_is_empty(empty));
+  bitmap_free(empty);
+
+  TEST_ASSERT_NULL(eng_sample_bitmap(0, 100));
+  TEST_ASSERT_NULL(eng_sample_bitmap(101, 100));
+}
+
+void test_sample_leaves_and_size_match_full_sample(void) {
+  const uint32_t last_ids[] = {0, 1000, 65535, 65536, 200000};
+  for (uint32_t i = 0; i < 5; i++) {
+    bitmap_t *full = eng_sample_bitmap(30, last_ids[i]);
+    TEST_ASSERT_EQUAL_UINT32(bitmap_get_cardinality(full),
+                             eng_sample_size(30, last_ids[i]));
+    bitmap_free(full);
+  }
+
+  bitmap_t *full = eng_sample_bitmap(30, 300000);
+  bitmap_t *leaf = bitmap_create();
+  // Ids past the last one are dropped, as the full sample has none
+  for (uint32_t id = 1; id <= 400000; id += 7) {
+    bitmap_add(leaf, id);
+  }
+  bitmap_t *expected = bitmap_and(leaf, full);
+  TEST_ASSERT_TRUE(eng_sample_and_inplace(leaf, 30, 300000));
+  TEST_ASSERT_EQUAL_UINT32(bitmap_get_cardinality(expected),
+                           bitmap_get_cardinality(leaf));
+  TEST_ASSERT_EQUAL_UINT64(bitmap_get_cardinality(leaf),
+                           bitmap_and_cardinality(expected, leaf));
+  TEST_ASSERT_FALSE(eng_sample_and_inplace(leaf, 0, 300000));
+  TEST_ASSERT_EQUAL_UINT32(0, eng_sample_size(101, 100));
+
+  bitmap_free(expected);
+  bitmap_free(leaf);
+  bitmap_free(full);
+}
+
+void test_estimate_scales_hits(void) {
+  eng_sample_estimate_t e = eng_sample_estimate(100, 1000, 10000);
+  TEST_ASSERT_EQUAL_UINT64(1000, e.count);
+  // 1.96 * sqrt(100 * 0.9) / 0.1 = 185.9
+  TEST_ASSERT_EQUAL_UINT64(186, e.error);
+
+  // Whole id space sampled: exact
+  e = eng_sample_estimate(42, 1000, 1000);
+  TEST_ASSERT_EQUAL_UINT64(42, e.count);
+  TEST_ASSERT_EQUAL_UINT64(0, e.error);
+
+  e = eng_sample_estimate(0, 0, 1000);
+  TEST_ASSERT_EQUAL_UINT64(0, e.count);
+  TEST_ASSERT_EQUAL_UINT64(0, e.error);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_sample_rate_is_close_to_pct);
+  RUN_TEST(test_sample_is_deterministic_and_nested);
+  RUN_TEST(test_sample_full_and_invalid);
+  RUN_TEST(test_sample_leaves_and_size_match_full_sample);
+  RUN_TEST(test_estimate_scales_hits);
+  return UNITY_END();
+}
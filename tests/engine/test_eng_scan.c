@@ -0,0 +1,169 @@
+#include "engine/eng_scan/eng_scan.h"
+#include "mpack.h"
+#include "query/ast.h"
+#include "unity.h"
+#include <stdlib.h>
+#include <string.h>
+
+static char *blob = NULL;
+static size_t blob_size = 0;
+
+void setUp(void) {}
+
+void tearDown(void) {
+  free(blob);
+  blob = NULL;
+  blob_size = 0;
+}
+
+// An event like the encoder writes, with custom tags `path` and `price`
+static void _event(const char *path, double price, bool price_is_float) {
+  mpack_writer_t w;
+  mpack_writer_init_growable(&w, &blob, &blob_size);
+  mpack_start_map(&w, 5);
+  mpack_write_cstr(&w, "id");
+  mpack_write_u32(&w, 7);
+  mpack_write_cstr(&w, "in");
+  mpack_write_cstr(&w, "shop");
+  mpack_write_cstr(&w, "entity");
+  mpack_write_cstr(&w, "user1");
+  mpack_write_cstr(&w, "path");
+  mpack_write_cstr(&w, path);
+  mpack_write_cstr(&w, "price");
+  if (price_is_float) {
+    mpack_write_double(&w, price);
+  } else {
+    mpack_write_i64(&w, (int64_t)price);
+  }
+  mpack_finish_map(&w);
+  TEST_ASSERT_EQUAL(mpack_ok, mpack_writer_destroy(&w));
+}
+
+static ast_literal_node_t _str(const char *s) {
+  ast_literal_node_t l = {.type = AST_LITERAL_STRING};
+  l.string_value = (char *)s;
+  l.string_value_len = strlen(s);
+  return l;
+}
+
+static ast_literal_node_t _num(int64_t n) {
+  ast_literal_node_t l = {.type = AST_LITERAL_NUMBER};
+  l.number_value = n;
+  return l;
+}
+
+static ast_literal_node_t _float(double d) {
+  ast_literal_node_t l = {.type = AST_LITERAL_FLOAT};
+  l.float_value = d;
+  return l;
+}
+
+static bool _match(const char *key, ast_comparison_op_t op,
+                   const ast_literal_node_t *val) {
+  eng_scan_filter_t f = {.key = key, .key_len = strlen(key), .count = 1};
+  f.preds[0].op = op;
+  f.preds[0].val = val;
+  return eng_scan_match(&f, blob, blob_size);
+}
+
+void test_numbers_compare_numerically(void) {
+  _event("/cart", 42, false);
+  ast_literal_node_t n42 = _num(42);
+  ast_literal_node_t n9 = _num(9);
+  ast_literal_node_t f41_5 = _float(41.5);
+  TEST_ASSERT_TRUE(_match("price", AST_OP_EQ, &n42));
+  TEST_ASSERT_FALSE(_match("price", AST_OP_NEQ, &n42));
+  // 42 > 9, not "42" < "9"
+  TEST_ASSERT_TRUE(_match("price", AST_OP_GT, &n9));
+  TEST_ASSERT_TRUE(_match("price", AST_OP_GTE, &f41_5));
+  TEST_ASSERT_FALSE(_match("price", AST_OP_LTE, &f41_5));
+  TEST_ASSERT_TRUE(_match("id", AST_OP_LT, &n9));
+}
+
+void test_decimal_values(void) {
+  _event("/cart", 2.5, true);
+  ast_literal_node_t n2 = _num(2);
+  ast_literal_node_t n3 = _num(3);
+  ast_literal_node_t f2_5 = _float(2.5);
+  TEST_ASSERT_TRUE(_match("price", AST_OP_GT, &n2));
+  TEST_ASSERT_TRUE(_match("price", AST_OP_LT, &n3));
+  TEST_ASSERT_TRUE(_match("price", AST_OP_EQ, &f2_5));
+}
+
+void test_range_needs_every_pred(void) {
+  _event("/cart", 42, false);
+  ast_literal_node_t lo = _num(40);
+  ast_literal_node_t hi = _num(42);
+  eng_scan_filter_t f = {.key = "price", .key_len = 5, .count = 2};
+  f.preds[0] = (eng_scan_pred_t){.op = AST_OP_GT, .val = &lo};
+  f.preds[1] = (eng_scan_pred_t){.op = AST_OP_LTE, .val = &hi};
+  TEST_ASSERT_TRUE(eng_scan_match(&f, blob, blob_size));
+  f.preds[1].op = AST_OP_LT;
+  TEST_ASSERT_FALSE(eng_scan_match(&f, blob, blob_size));
+}
+
+void test_strings_compare_bytewise(void) {
+  _event("/checkout/pay", 1, false);
+  ast_literal_node_t exact = _str("/checkout/pay");
+  ast_literal_node_t prefix = _str("/checkout");
+  ast_literal_node_t later = _str("/d");
+  TEST_ASSERT_TRUE(_match("path", AST_OP_EQ, &exact));
+  TEST_ASSERT_FALSE(_match("path", AST_OP_EQ, &prefix));
+  TEST_ASSERT_TRUE(_match("path", AST_OP_GT, &prefix));
+  TEST_ASSERT_TRUE(_match("path", AST_OP_LT, &later));
+  TEST_ASSERT_TRUE(_match("entity", AST_OP_NEQ, &exact));
+}
+
+void test_contains(void) {
+  _event("/checkout/pay", 1, false);
+  ast_literal_node_t mid = _str("out/p");
+  ast_literal_node_t whole = _str("/checkout/pay");
+  ast_literal_node_t elsewhere = _str("shop");
+  TEST_ASSERT_TRUE(_match("path", AST_OP_CONTAINS, &mid));
+  TEST_ASSERT_TRUE(_match("path", AST_OP_CONTAINS, &whole));
+  // In the blob, but not in the value of `path`
+  TEST_ASSERT_FALSE(_match("path", AST_OP_CONTAINS, &elsewhere));
+  // Numbers hold no substrings
+  TEST_ASSERT_FALSE(_match("price", AST_OP_CONTAINS, &mid));
+}
+
+void test_missing_key_never_matches(void) {
+  _event("/price", 1, false);
+  ast_literal_node_t n1 = _num(1);
+  ast_literal_node_t s = _str("x");
+  TEST_ASSERT_FALSE(_match("qty", AST_OP_NEQ, &n1));
+  // `pric` is in the blob, only as part of other strings
+  TEST_ASSERT_FALSE(_match("pric", AST_OP_NEQ, &n1));
+  TEST_ASSERT_FALSE(_match("qty", AST_OP_NEQ, &s));
+}
+
+void test_types_never_mix(void) {
+  _event("/cart", 42, false);
+  ast_literal_node_t s42 = _str("42");
+  ast_literal_node_t n1 = _num(1);
+  TEST_ASSERT_FALSE(_match("price", AST_OP_EQ, &s42));
+  TEST_ASSERT_FALSE(_match("price", AST_OP_NEQ, &s42));
+  TEST_ASSERT_FALSE(_match("path", AST_OP_NEQ, &n1));
+}
+
+void test_undecodable_blob(void) {
+  const char junk[] = "price price price";
+  ast_literal_node_t n1 = _num(1);
+  eng_scan_filter_t f = {.key = "price", .key_len = 5, .count = 1};
+  f.preds[0] = (eng_scan_pred_t){.op = AST_OP_NEQ, .val = &n1};
+  TEST_ASSERT_FALSE(eng_scan_match(&f, junk, sizeof(junk) - 1));
+  TEST_ASSERT_FALSE(eng_scan_match(&f, NULL, 0));
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_numbers_compare_numerically);
+  RUN_TEST(test_decimal_values);
+  RUN_TEST(test_range_needs_every_pred);
+  RUN_TEST(test_strings_compare_bytewise);
+  RUN_TEST(test_contains);
+  RUN_TEST(test_missing_key_never_matches);
+  RUN_TEST(test_types_never_mix);
+  RUN_TEST(test_undecodable_blob);
+  return UNITY_END();
+}
@@ -0,0 +1,163 @@
+#include "core/bitmaps.h"
+#include "core/db.h"
+#include "engine/eng_top/eng_top.h"
+#include "lmdb.h"
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static MDB_env *test_env = NULL;
+static MDB_dbi inv_db;
+static char test_db_path[256];
+
+void setUp(void) {
+  srand((unsigned int)time(NULL));
+  snprintf(test_db_path, sizeof(test_db_path), "/tmp/test_eng_top_%d_%d",
+           getpid(), rand());
+  test_env = db_create_env(test_db_path, 16 * 1024 * 1024, 8);
+  TEST_ASSERT_NOT_NULL(test_env);
+  TEST_ASSERT_TRUE(db_open(test_env, "inv", false, DB_DUP_NONE, &inv_db));
+}
+
+void tearDown(void) {
+  if (test_env) {
+    db_close(test_env, inv_db);
+    db_env_close(test_env);
+    test_env = NULL;
+  }
+  char lock_path[300];
+  snprintf(lock_path, sizeof(lock_path), "%s-lock", test_db_path);
+  unlink(test_db_path);
+  unlink(lock_path);
+}
+
+// Bitmap of event ids [first, first + count)
+static void _put(const char *inv_key, uint32_t first, uint32_t count) {
+  bitmap_t *bm = bitmap_create();
+  for (uint32_t i = 0; i < count; i++) {
+    bitmap_add(bm, first + i);
+  }
+  size_t size = 0;
+  void *data = bitmap_serialize(bm, &size);
+  bitmap_free(bm);
+  TEST_ASSERT_NOT_NULL(data);
+
+  MDB_txn *txn = db_create_txn(test_env, false);
+  db_key_t key = {.type = DB_KEY_STRING, .key.s = (char *)inv_key};
+  TEST_ASSERT_EQUAL(DB_PUT_OK,
+                    db_put(inv_db, txn, &key, data, size, false, false));
+  TEST_ASSERT_TRUE(db_commit_txn(txn));
+  free(data);
+}
+
+static const bitmap_t *cached = NULL;
+
+static const bitmap_t *_cache_get(const char *inv_key, void *arg) {
+  return strcmp(inv_key, (const char *)arg) == 0 ? cached : NULL;
+}
+
+void test_heap_keeps_best_in_order(void) {
+  eng_top_heap_t h;
+  TEST_ASSERT_TRUE(eng_top_heap_init(&h, 3));
+  const char *values[] = {"a", "b", "c", "d", "e"};
+  uint64_t counts[] = {5, 1, 5, 9, 5};
+  for (int i = 0; i < 5; i++) {
+    TEST_ASSERT_TRUE(eng_top_heap_push(&h, values[i], 1, counts[i]));
+  }
+  eng_top_heap_sort(&h);
+
+  TEST_ASSERT_EQUAL_UINT32(3, h.count);
+  TEST_ASSERT_EQUAL_STRING("d", h.entries[0].value);
+  // Ties with the cut keep the values offered first
+  TEST_ASSERT_EQUAL_STRING("a", h.entries[1].value);
+  TEST_ASSERT_EQUAL_STRING("c", h.entries[2].value);
+  TEST_ASSERT_EQUAL_UINT64(5, h.entries[2].count);
+  eng_top_heap_free(&h);
+}
+
+void test_values_ranked_with_filter_and_cache(void) {
+  _put("country:us", 0, 10);
+  _put("country:ca", 100, 4);
+  _put("country:mx", 5, 3);
+  _put("countryside:x", 0, 50);
+  _put("entity|1", 0, 50);
+
+  MDB_txn *txn = db_create_txn(test_env, true);
+  eng_top_args_t args = {
+      .txn = txn, .inverted_db = inv_db, .key = "country", .n = 2};
+  eng_top_heap_t heap;
+  const char *err = NULL;
+  TEST_ASSERT_TRUE(eng_top_values(&args, &heap, &err));
+  TEST_ASSERT_EQUAL_UINT32(2, heap.count);
+  TEST_ASSERT_EQUAL_STRING("us", heap.entries[0].value);
+  TEST_ASSERT_EQUAL_UINT64(10, heap.entries[0].count);
+  TEST_ASSERT_EQUAL_STRING("ca", heap.entries[1].value);
+  eng_top_heap_free(&heap);
+
+  // Only events in the filter count, values with none are left out
+  bitmap_t *filter = bitmap_create();
+  for (uint32_t i = 6; i < 20; i++) {
+    bitmap_add(filter, i);
+  }
+  args.filter = filter;
+  args.n = 5;
+  TEST_ASSERT_TRUE(eng_top_values(&args, &heap, &err));
+  TEST_ASSERT_EQUAL_UINT32(2, heap.count);
+  TEST_ASSERT_EQUAL_STRING("us", heap.entries[0].value);
+  TEST_ASSERT_EQUAL_UINT64(4, heap.entries[0].count);
+  TEST_ASSERT_EQUAL_STRING("mx", heap.entries[1].value);
+  TEST_ASSERT_EQUAL_UINT64(2, heap.entries[1].count);
+  eng_top_heap_free(&heap);
+
+  // A cached copy wins over the LMDB one
+  bitmap_t *newer = bitmap_create();
+  for (uint32_t i = 0; i < 20; i++) {
+    bitmap_add(newer, 200 + i);
+  }
+  cached = newer;
+  args.filter = NULL;
+  args.cache_get = _cache_get;
+  args.cache_arg = "country:ca";
+  TEST_ASSERT_TRUE(eng_top_values(&args, &heap, &err));
+  TEST_ASSERT_EQUAL_STRING("ca", heap.entries[0].value);
+  TEST_ASSERT_EQUAL_UINT64(20, heap.entries[0].count);
+  eng_top_heap_free(&heap);
+  db_abort_txn(txn);
+
+  cached = NULL;
+  bitmap_free(newer);
+  bitmap_free(filter);
+}
+
+void test_list_keys_skips_values(void) {
+  _put("amount:5", 0, 1);
+  _put("bsi|amount|0", 0, 1);
+  _put("country:ca", 0, 1);
+  _put("country:us", 0, 1);
+  _put("entity|7", 0, 1);
+  _put("loc:ny", 0, 1);
+  _put("view|errors", 0, 1);
+
+  MDB_txn *txn = db_create_txn(test_env, true);
+  char **keys = NULL;
+  uint32_t count = 0;
+  TEST_ASSERT_TRUE(eng_top_list_keys(txn, inv_db, &keys, &count));
+  db_abort_txn(txn);
+
+  TEST_ASSERT_EQUAL_UINT32(3, count);
+  TEST_ASSERT_EQUAL_STRING("amount", keys[0]);
+  TEST_ASSERT_EQUAL_STRING("country", keys[1]);
+  TEST_ASSERT_EQUAL_STRING("loc", keys[2]);
+  eng_top_free_keys(keys, count);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_heap_keeps_best_in_order);
+  RUN_TEST(test_values_ranked_with_filter_and_cache);
+  RUN_TEST(test_list_keys_skips_values);
+  return UNITY_END();
+}
@@ -435,6 +435,109 @@ void test_index_def_key_ownership(void) {
   TEST_ASSERT_NULL(key_map);
 }
 
+void test_index_f64_key_preserves_order(void) {
+  const double values[] = {-1e300, -2.5, -1.0, -0.5, 0.0, 0.25, 1.0, 99.99,
+                           1e300};
+  size_t n = sizeof(values) / sizeof(values[0]);
+  for (size_t i = 1; i < n; i++) {
+    TEST_ASSERT_TRUE(index_f64_key(values[i - 1]) < index_f64_key(values[i]));
+  }
+  TEST_ASSERT_EQUAL_UINT64(index_f64_key(0.0), index_f64_key(-0.0));
+}
+
+void test_index_type_from_str(void) {
+  index_type_t type;
+  TEST_ASSERT_TRUE(index_type_from_str("f64", &type));
+  TEST_ASSERT_EQUAL(INDEX_TYPE_F64, type);
+  TEST_ASSERT_TRUE(index_type_from_str("str", &type));
+  TEST_ASSERT_EQUAL(INDEX_TYPE_STR, type);
+  TEST_ASSERT_TRUE(index_type_from_str("i64", &type));
+  TEST_ASSERT_EQUAL(INDEX_TYPE_I64, type);
+  TEST_ASSERT_TRUE(index_type_from_str("bsi", &type));
+  TEST_ASSERT_EQUAL(INDEX_TYPE_BSI, type);
+  TEST_ASSERT_FALSE(index_type_from_str("F64", &type));
+  TEST_ASSERT_FALSE(index_type_from_str(NULL, &type));
+}
+
+void test_index_bsi_value_and_slices(void) {
+  uint64_t value;
+  ast_literal_node_t num = {.type = AST_LITERAL_NUMBER, .number_value = 42};
+  TEST_ASSERT_TRUE(index_bsi_value(&num, &value));
+  TEST_ASSERT_EQUAL_UINT64(42, value);
+  num.number_value = -1;
+  TEST_ASSERT_FALSE(index_bsi_value(&num, &value));
+  ast_literal_node_t dec = {.type = AST_LITERAL_FLOAT, .float_value = 1.5};
+  TEST_ASSERT_FALSE(index_bsi_value(&dec, &value));
+
+  // Set bits low to high, then the existence slice
+  uint32_t slices[INDEX_BSI_SLICES + 1];
+  TEST_ASSERT_EQUAL_UINT32(4, index_bsi_slices(42, slices));
+  TEST_ASSERT_EQUAL_UINT32(1, slices[0]);
+  TEST_ASSERT_EQUAL_UINT32(3, slices[1]);
+  TEST_ASSERT_EQUAL_UINT32(5, slices[2]);
+  TEST_ASSERT_EQUAL_UINT32(INDEX_BSI_EXISTS, slices[3]);
+  TEST_ASSERT_EQUAL_UINT32(1, index_bsi_slices(0, slices));
+  TEST_ASSERT_EQUAL_UINT32(INDEX_BSI_EXISTS, slices[0]);
+}
+
+void test_index_map_with_bsi_has_no_db(void) {
+  index_write_reg_opts_t opts = {.src = INDEX_WRITE_DEFAULTS};
+  TEST_ASSERT_TRUE(index_write_registry(test_env, registry_db, &opts));
+  TEST_ASSERT_TRUE(index_open_registry(test_env, registry_db, &key_map));
+
+  index_def_t def = {.key = "amount", .type = INDEX_TYPE_BSI};
+  khash_t(key_index) *with_bsi = index_map_with(test_env, key_map, &def, false);
+  TEST_ASSERT_NOT_NULL(with_bsi);
+  index_t idx;
+  TEST_ASSERT_TRUE(index_get("amount", with_bsi, &idx));
+  TEST_ASSERT_EQUAL(INDEX_TYPE_BSI, idx.index_def.type);
+  TEST_ASSERT_EQUAL_UINT32(0, idx.index_db);
+
+  ast_literal_node_t num = {.type = AST_LITERAL_NUMBER, .number_value = 7};
+  db_key_t key;
+  TEST_ASSERT_FALSE(index_key_from_literal(INDEX_TYPE_BSI, &num, &key));
+
+  index_free_map(key_map);
+  key_map = with_bsi;
+}
+
+void test_index_map_with_copies_and_marks_building(void) {
+  index_write_reg_opts_t opts = {.src = INDEX_WRITE_DEFAULTS};
+  TEST_ASSERT_TRUE(index_write_registry(test_env, registry_db, &opts));
+  TEST_ASSERT_TRUE(index_open_registry(test_env, registry_db, &key_map));
+
+  index_def_t def = {.key = "amount", .type = INDEX_TYPE_F64};
+  khash_t(key_index) *building = index_map_with(test_env, key_map, &def, true);
+  TEST_ASSERT_NOT_NULL(building);
+
+  // The original map is unchanged
+  uint32_t count = 0;
+  index_t idx;
+  TEST_ASSERT_TRUE(index_get_count(key_map, &count));
+  TEST_ASSERT_EQUAL_UINT32(1, count);
+  TEST_ASSERT_FALSE(index_get("amount", key_map, &idx));
+
+  TEST_ASSERT_TRUE(index_get_count(building, &count));
+  TEST_ASSERT_EQUAL_UINT32(2, count);
+  TEST_ASSERT_TRUE(index_get("amount", building, &idx));
+  TEST_ASSERT_TRUE(idx.building);
+  TEST_ASSERT_EQUAL(INDEX_TYPE_F64, idx.index_def.type);
+  MDB_dbi amount_db = idx.index_db;
+  TEST_ASSERT_TRUE(index_get("ts", building, &idx));
+  TEST_ASSERT_FALSE(idx.building);
+
+  // Finishing only flips the flag, the db stays the same
+  khash_t(key_index) *done = index_map_with(test_env, building, &def, false);
+  TEST_ASSERT_NOT_NULL(done);
+  TEST_ASSERT_TRUE(index_get("amount", done, &idx));
+  TEST_ASSERT_FALSE(idx.building);
+  TEST_ASSERT_EQUAL_UINT32(amount_db, idx.index_db);
+
+  index_free_map(key_map);
+  index_free_map(building);
+  key_map = done;
+}
+
 int main(void) {
   UNITY_BEGIN();
 
@@ -466,6 +569,11 @@ int main(void) {
   RUN_TEST(test_multiple_indexes_lifecycle);
   RUN_TEST(test_index_write_defaults_idempotent);
   RUN_TEST(test_index_def_key_ownership);
+  RUN_TEST(test_index_f64_key_preserves_order);
+  RUN_TEST(test_index_type_from_str);
+  RUN_TEST(test_index_bsi_value_and_slices);
+  RUN_TEST(test_index_map_with_bsi_has_no_db);
+  RUN_TEST(test_index_map_with_copies_and_marks_building);
 
   return UNITY_END();
 }
\ No newline at end of file
@@ -0,0 +1,338 @@
+#include "core/bitmaps.h"
+#include "core/db.h"
+#include "engine/container/container.h"
+#include "engine/container/container_types.h"
+#include "engine/index/index.h"
+#include "engine/index_backfill/index_backfill.h"
+#include "engine/op/op.h"
+#include "engine/op_queue/op_queue.h"
+#include "engine/watermark/watermark.h"
+#include "log/log.h"
+#include "mpack.h"
+#include "unity.h"
+#include "uv.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TEST_DATA_DIR "test_backfill_data"
+#define TEST_CONTAINER_SIZE (16 * 1024 * 1024)
+#define WAIT_MAX_MS 5000
+
+static index_backfill_t bf;
+static op_queue_t *op_queue;
+
+static void remove_test_files(void) {
+  DIR *dir = opendir(TEST_DATA_DIR);
+  if (dir) {
+    struct dirent *ent;
+    char path[512];
+    while ((ent = readdir(dir)) != NULL) {
+      if (ent->d_name[0] == '.') {
+        continue;
+      }
+      snprintf(path, sizeof(path), "%s/%s", TEST_DATA_DIR, ent->d_name);
+      unlink(path);
+    }
+    closedir(dir);
+  }
+  rmdir(TEST_DATA_DIR);
+}
+
+void setUp(void) {
+  remove_test_files();
+  mkdir(TEST_DATA_DIR, 0700);
+  TEST_ASSERT_TRUE(container_init(8, TEST_DATA_DIR, TEST_CONTAINER_SIZE));
+  memset(&bf, 0, sizeof(bf));
+  op_queue = malloc(sizeof(op_queue_t));
+  TEST_ASSERT_NOT_NULL(op_queue);
+  TEST_ASSERT_TRUE(op_queue_init(op_queue));
+}
+
+void tearDown(void) {
+  op_queue_msg_t *msg;
+  while (op_queue_dequeue(op_queue, &msg)) {
+    op_queue_msg_free(msg);
+  }
+  op_queue_destroy(op_queue);
+  free(op_queue);
+  container_shutdown();
+  remove_test_files();
+}
+
+static eng_container_t *_get_user(const char *name) {
+  container_result_t cr = container_get_user(name, true, NULL);
+  TEST_ASSERT_TRUE(cr.success);
+  return cr.container;
+}
+
+static eng_container_t *_sys(void) {
+  container_result_t cr = container_get_system();
+  TEST_ASSERT_TRUE(cr.success);
+  return cr.container;
+}
+
+// Write events as the writer does, `amount` is skipped when NULL
+static void _put_event(eng_container_t *c, uint32_t id, const char *amount) {
+  char *data = NULL;
+  size_t size = 0;
+  mpack_writer_t writer;
+  mpack_writer_init_growable(&writer, &data, &size);
+  mpack_start_map(&writer, amount ? 3 : 2);
+  mpack_write_cstr(&writer, "id");
+  mpack_write_u32(&writer, id);
+  mpack_write_cstr(&writer, "entity");
+  mpack_write_cstr(&writer, "u1");
+  if (amount) {
+    mpack_write_cstr(&writer, "amount");
+    if (strchr(amount, '.')) {
+      mpack_write_double(&writer, strtod(amount, NULL));
+    } else if (amount[0] >= '0' && amount[0] <= '9') {
+      mpack_write_i64(&writer, strtoll(amount, NULL, 10));
+    } else {
+      mpack_write_cstr(&writer, amount);
+    }
+  }
+  mpack_finish_map(&writer);
+  TEST_ASSERT_EQUAL(mpack_ok, mpack_writer_destroy(&writer));
+
+  MDB_txn *txn = db_create_txn(c->env, false);
+  TEST_ASSERT_NOT_NULL(txn);
+  db_key_t key = {.type = DB_KEY_U32, .key.u32 = id};
+  TEST_ASSERT_EQUAL(DB_PUT_OK, db_put(c->data.usr->events_db, txn, &key,
+                                      data, size, false, false));
+  TEST_ASSERT_TRUE(db_commit_txn(txn));
+  free(data);
+}
+
+static void _add_global_index(const char *key, index_type_t type) {
+  eng_container_t *sys_c = _sys();
+  index_def_t def = {.key = (char *)key, .type = type};
+  TEST_ASSERT_EQUAL(DB_PUT_OK,
+                    index_add(&def, sys_c->env,
+                              sys_c->data.sys->index_registry_global_db));
+}
+
+static void _put_job(const char *job_key, uint32_t next_event_id) {
+  eng_container_t *sys_c = _sys();
+  MDB_txn *txn = db_create_txn(sys_c->env, false);
+  TEST_ASSERT_NOT_NULL(txn);
+  db_key_t key = {.type = DB_KEY_STRING, .key.s = (char *)job_key};
+  TEST_ASSERT_EQUAL(DB_PUT_OK,
+                    db_put(sys_c->data.sys->sys_dc_metadata_db, txn, &key,
+                           &next_event_id, sizeof(uint32_t), false, false));
+  TEST_ASSERT_TRUE(db_commit_txn(txn));
+}
+
+static uint32_t _job_count(void) {
+  index_backfill_status_t *jobs = NULL;
+  uint32_t count = 0;
+  TEST_ASSERT_TRUE(index_backfill_list(&jobs, &count));
+  index_backfill_free_list(jobs, count);
+  return count;
+}
+
+static void _start(void) {
+  index_backfill_config_t config = {
+      .chunk_events = 2,
+      .throttle_ms = 0,
+      .op_queues = op_queue,
+      .op_queue_total_count = 1};
+  TEST_ASSERT_TRUE(index_backfill_start(&bf, &config));
+}
+
+static void _run_until_idle(void) {
+  _start();
+  uint32_t waited = 0;
+  while (_job_count() > 0 && waited < WAIT_MAX_MS) {
+    uv_sleep(5);
+    waited += 5;
+  }
+  TEST_ASSERT_TRUE(index_backfill_stop(&bf));
+  TEST_ASSERT_EQUAL_UINT32(0, _job_count());
+}
+
+// Event ids of the index on `key`, in index key order
+static uint32_t _index_ids(eng_container_t *c, const char *key,
+                           uint32_t *ids_out, uint32_t max) {
+  index_t index;
+  TEST_ASSERT_TRUE(
+      index_get(key, atomic_load(&c->data.usr->key_to_index), &index));
+  TEST_ASSERT_FALSE(index.building);
+  MDB_txn *txn = db_create_txn(c->env, true);
+  MDB_cursor *cursor = db_cursor_open(txn, index.index_db);
+  TEST_ASSERT_NOT_NULL(cursor);
+  uint32_t n = 0;
+  db_cursor_entry_t entry;
+  db_cursor_get_result_t r = db_cursor_get(cursor, &entry, MDB_FIRST, NULL);
+  while (r == DB_CURSOR_OK && n < max) {
+    memcpy(&ids_out[n++], entry.value, sizeof(uint32_t));
+    r = db_cursor_get(cursor, &entry, MDB_NEXT, NULL);
+  }
+  db_cursor_close(cursor);
+  db_abort_txn(txn);
+  return n;
+}
+
+void test_backfill_indexes_existing_events(void) {
+  eng_container_t *c = _get_user("bf_existing");
+  _put_event(c, 1, "2.5");
+  _put_event(c, 2, "40");
+  _put_event(c, 3, NULL);
+  _put_event(c, 4, "3");
+  _put_event(c, 5, "abc");
+
+  _add_global_index("amount", INDEX_TYPE_F64);
+  TEST_ASSERT_TRUE(index_backfill_schedule(&bf, "amount"));
+
+  index_backfill_status_t *jobs = NULL;
+  uint32_t count = 0;
+  TEST_ASSERT_TRUE(index_backfill_list(&jobs, &count));
+  TEST_ASSERT_EQUAL_UINT32(1, count);
+  TEST_ASSERT_EQUAL_STRING("bf_existing", jobs[0].container_name);
+  TEST_ASSERT_EQUAL_STRING("amount", jobs[0].key);
+  TEST_ASSERT_EQUAL_UINT32(1, jobs[0].next_event_id);
+  index_backfill_free_list(jobs, count);
+
+  _run_until_idle();
+
+  // Values that are not numbers are skipped, as the writer does
+  uint32_t ids[8];
+  TEST_ASSERT_EQUAL_UINT32(3, _index_ids(c, "amount", ids, 8));
+  TEST_ASSERT_EQUAL_UINT32(1, ids[0]);
+  TEST_ASSERT_EQUAL_UINT32(4, ids[1]);
+  TEST_ASSERT_EQUAL_UINT32(2, ids[2]);
+
+  index_def_t def = {0};
+  TEST_ASSERT_TRUE(index_find_def(c->env, c->data.usr->index_registry_local_db,
+                                  "amount", &def));
+  TEST_ASSERT_EQUAL(INDEX_TYPE_F64, def.type);
+  free(def.key);
+  container_release(c);
+}
+
+void test_backfill_resumes_from_saved_progress(void) {
+  eng_container_t *c = _get_user("bf_resume");
+  for (uint32_t id = 1; id <= 5; id++) {
+    char amount[8];
+    snprintf(amount, sizeof(amount), "%u", 10 - id);
+    _put_event(c, id, amount);
+  }
+  _add_global_index("amount", INDEX_TYPE_I64);
+  _put_job("backfill|bf_resume|amount", 3);
+
+  _run_until_idle();
+
+  uint32_t ids[8];
+  TEST_ASSERT_EQUAL_UINT32(3, _index_ids(c, "amount", ids, 8));
+  TEST_ASSERT_EQUAL_UINT32(5, ids[0]);
+  TEST_ASSERT_EQUAL_UINT32(4, ids[1]);
+  TEST_ASSERT_EQUAL_UINT32(3, ids[2]);
+  container_release(c);
+}
+
+void test_backfill_sends_bsi_slices(void) {
+  eng_container_t *c = _get_user("bf_bsi");
+  _put_event(c, 1, "5");
+  _put_event(c, 2, "2.5");
+  _put_event(c, 3, "4");
+  _put_event(c, 4, NULL);
+  _put_event(c, 5, "1");
+
+  _add_global_index("amount", INDEX_TYPE_BSI);
+  TEST_ASSERT_TRUE(index_backfill_schedule(&bf, "amount"));
+  _run_until_idle();
+
+  // Slices are ORed per chunk, so collect them per slice key
+  bitmap_t *b0 = bitmap_create();
+  bitmap_t *b2 = bitmap_create();
+  bitmap_t *exists = bitmap_create();
+  op_queue_msg_t *msg;
+  while (op_queue_dequeue(op_queue, &msg)) {
+    TEST_ASSERT_EQUAL(OP_TYPE_OR, msg->op->op_type);
+    TEST_ASSERT_EQUAL_STRING("bf_bsi", msg->op->db_key.container_name);
+    const char *k = msg->op->db_key.db_key.key.s;
+    bitmap_t *target = strcmp(k, "bsi|amount|0") == 0    ? b0
+                       : strcmp(k, "bsi|amount|2") == 0  ? b2
+                       : strcmp(k, "bsi|amount|64") == 0 ? exists
+                                                         : NULL;
+    TEST_ASSERT_NOT_NULL_MESSAGE(target, k);
+    bitmap_or_inplace(target, msg->op->bm);
+    op_queue_msg_free(msg);
+  }
+
+  // 5 = 0b101, 4 = 0b100, 1 = 0b1, decimals are not indexed
+  TEST_ASSERT_EQUAL_UINT32(2, bitmap_get_cardinality(b0));
+  TEST_ASSERT_TRUE(bitmap_contains(b0, 1) && bitmap_contains(b0, 5));
+  TEST_ASSERT_EQUAL_UINT32(2, bitmap_get_cardinality(b2));
+  TEST_ASSERT_TRUE(bitmap_contains(b2, 1) && bitmap_contains(b2, 3));
+  TEST_ASSERT_EQUAL_UINT32(3, bitmap_get_cardinality(exists));
+  bitmap_free(b0);
+  bitmap_free(b2);
+  bitmap_free(exists);
+
+  index_t index;
+  TEST_ASSERT_TRUE(
+      index_get("amount", atomic_load(&c->data.usr->key_to_index), &index));
+  TEST_ASSERT_FALSE(index.building);
+  container_release(c);
+}
+
+void test_backfill_waits_for_queued_events(void) {
+  TEST_ASSERT_TRUE(watermark_init(1, 1, 1));
+  eng_container_t *c = _get_user("bf_queued");
+  _put_event(c, 1, "3");
+  // Event 2 is with a worker that encodes it without the index
+  wm_container_t *wm = watermark_add("bf_queued", 2);
+  uint32_t id = watermark_assign_begin(wm);
+  watermark_assign_end(wm, 0, id, true);
+  watermark_write_sent(wm, 0);
+
+  _add_global_index("amount", INDEX_TYPE_I64);
+  TEST_ASSERT_TRUE(index_backfill_schedule(&bf, "amount"));
+  _start();
+  uv_sleep(50);
+  TEST_ASSERT_EQUAL_UINT32(1, _job_count());
+
+  _put_event(c, id, "7");
+  watermark_processed(wm, 0, id);
+  watermark_write_committed(wm, 0);
+  uint32_t waited = 0;
+  while (_job_count() > 0 && waited < WAIT_MAX_MS) {
+    uv_sleep(5);
+    waited += 5;
+  }
+  TEST_ASSERT_TRUE(index_backfill_stop(&bf));
+
+  uint32_t ids[8];
+  TEST_ASSERT_EQUAL_UINT32(2, _index_ids(c, "amount", ids, 8));
+  TEST_ASSERT_EQUAL_UINT32(1, ids[0]);
+  TEST_ASSERT_EQUAL_UINT32(2, ids[1]);
+  container_release(c);
+  watermark_destroy();
+}
+
+void test_backfill_drops_job_for_missing_container(void) {
+  _add_global_index("amount", INDEX_TYPE_I64);
+  _put_job("backfill|bf_missing|amount", 1);
+  TEST_ASSERT_EQUAL_UINT32(1, _job_count());
+
+  _run_until_idle();
+
+  container_result_t cr = container_get_user("bf_missing", false, NULL);
+  TEST_ASSERT_FALSE(cr.success);
+}
+
+int main(void) {
+  log_global_init("config/zlog.conf");
+  UNITY_BEGIN();
+  RUN_TEST(test_backfill_indexes_existing_events);
+  RUN_TEST(test_backfill_resumes_from_saved_progress);
+  RUN_TEST(test_backfill_sends_bsi_slices);
+  RUN_TEST(test_backfill_waits_for_queued_events);
+  RUN_TEST(test_backfill_drops_job_for_missing_container);
+  return UNITY_END();
+}
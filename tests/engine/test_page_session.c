@@ -0,0 +1,134 @@
+#include "core/bitmaps.h"
+#include "engine/page_session/page_session.h"
+#include "unity.h"
+#include <stdint.h>
+#include <unistd.h>
+
+void setUp(void) {}
+
+void tearDown(void) { page_session_destroy(); }
+
+// Events 1..count
+static bitmap_t *_events(uint32_t count) {
+  bitmap_t *bm = bitmap_create();
+  for (uint32_t i = 1; i <= count; i++) {
+    bitmap_add(bm, i);
+  }
+  return bm;
+}
+
+// Bytes charged for a session of `_events(count)` in container "c"
+static size_t _session_bytes(uint32_t count) {
+  TEST_ASSERT_TRUE(page_session_init(1024 * 1024, 0));
+  TEST_ASSERT_NOT_EQUAL(0, page_session_put("c", 1, _events(count)));
+  page_session_stats_t stats;
+  page_session_get_stats(&stats);
+  page_session_destroy();
+  return stats.bytes;
+}
+
+void test_pages_through_kept_result(void) {
+  TEST_ASSERT_TRUE(page_session_init(1024 * 1024, 0));
+  uint64_t handle = page_session_put("c", 7, _events(25));
+  TEST_ASSERT_NOT_EQUAL(0, handle);
+  TEST_ASSERT_TRUE(handle <= (uint64_t)INT64_MAX);
+
+  uint32_t next = 0;
+  bitmap_t *page = page_session_page(handle, "c", 7, 10, 0, &next);
+  TEST_ASSERT_NOT_NULL(page);
+  TEST_ASSERT_EQUAL_UINT64(10, bitmap_get_cardinality(page));
+  TEST_ASSERT_EQUAL_UINT32(11, next);
+  bitmap_free(page);
+
+  page = page_session_page(handle, "c", 7, 10, next, &next);
+  TEST_ASSERT_TRUE(bitmap_contains(page, 20));
+  TEST_ASSERT_EQUAL_UINT32(21, next);
+  bitmap_free(page);
+
+  // The last page drops the session
+  page = page_session_page(handle, "c", 7, 10, next, &next);
+  TEST_ASSERT_EQUAL_UINT64(5, bitmap_get_cardinality(page));
+  TEST_ASSERT_EQUAL_UINT32(0, next);
+  bitmap_free(page);
+  TEST_ASSERT_NULL(page_session_page(handle, "c", 7, 10, 0, &next));
+
+  page_session_stats_t stats;
+  page_session_get_stats(&stats);
+  TEST_ASSERT_EQUAL_UINT64(3, stats.hits);
+  TEST_ASSERT_EQUAL_UINT64(1, stats.misses);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.sessions);
+  TEST_ASSERT_EQUAL_size_t(0, stats.bytes);
+}
+
+void test_other_container_or_query_misses(void) {
+  TEST_ASSERT_TRUE(page_session_init(1024 * 1024, 0));
+  uint64_t handle = page_session_put("c", 7, _events(25));
+  uint32_t next = 0;
+  TEST_ASSERT_NULL(page_session_page(handle, "d", 7, 10, 0, &next));
+  TEST_ASSERT_NULL(page_session_page(handle, "c", 8, 10, 0, &next));
+  TEST_ASSERT_NULL(page_session_page(handle + 1, "c", 7, 10, 0, &next));
+  bitmap_t *page = page_session_page(handle, "c", 7, 10, 0, &next);
+  TEST_ASSERT_NOT_NULL(page);
+  bitmap_free(page);
+}
+
+void test_evicts_least_recently_used(void) {
+  size_t bytes = _session_bytes(25);
+  TEST_ASSERT_TRUE(page_session_init(bytes * 2, 0));
+  uint64_t a = page_session_put("c", 1, _events(25));
+  uint64_t b = page_session_put("c", 1, _events(25));
+
+  // Using `a` leaves `b` the least recently used
+  uint32_t next = 0;
+  bitmap_t *page = page_session_page(a, "c", 1, 10, 0, &next);
+  bitmap_free(page);
+  uint64_t c = page_session_put("c", 1, _events(25));
+  TEST_ASSERT_NOT_EQUAL(0, c);
+
+  TEST_ASSERT_NULL(page_session_page(b, "c", 1, 10, 0, &next));
+  page = page_session_page(a, "c", 1, 10, 0, &next);
+  TEST_ASSERT_NOT_NULL(page);
+  bitmap_free(page);
+
+  page_session_stats_t stats;
+  page_session_get_stats(&stats);
+  TEST_ASSERT_EQUAL_UINT64(1, stats.evictions);
+  TEST_ASSERT_EQUAL_UINT32(2, stats.sessions);
+  TEST_ASSERT_EQUAL_size_t(bytes * 2, stats.bytes);
+}
+
+void test_too_large_not_kept(void) {
+  size_t bytes = _session_bytes(25);
+  TEST_ASSERT_TRUE(page_session_init(bytes - 1, 0));
+  TEST_ASSERT_EQUAL_UINT64(0, page_session_put("c", 1, _events(25)));
+}
+
+void test_unused_session_expires(void) {
+  TEST_ASSERT_TRUE(page_session_init(1024 * 1024, 20));
+  uint64_t handle = page_session_put("c", 1, _events(25));
+  usleep(40 * 1000);
+  uint32_t next = 0;
+  TEST_ASSERT_NULL(page_session_page(handle, "c", 1, 10, 0, &next));
+  page_session_stats_t stats;
+  page_session_get_stats(&stats);
+  TEST_ASSERT_EQUAL_UINT64(1, stats.expirations);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.sessions);
+}
+
+void test_disabled_frees_events(void) {
+  TEST_ASSERT_TRUE(page_session_init(0, 0));
+  TEST_ASSERT_EQUAL_UINT64(0, page_session_put("c", 1, _events(25)));
+  uint32_t next = 0;
+  TEST_ASSERT_NULL(page_session_page(1, "c", 1, 10, 0, &next));
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_pages_through_kept_result);
+  RUN_TEST(test_other_container_or_query_misses);
+  RUN_TEST(test_evicts_least_recently_used);
+  RUN_TEST(test_too_large_not_kept);
+  RUN_TEST(test_unused_session_expires);
+  RUN_TEST(test_disabled_frees_events);
+  return UNITY_END();
+}
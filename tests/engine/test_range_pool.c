@@ -0,0 +1,121 @@
+#include "engine/range_pool/range_pool.h"
+#include "unity.h"
+#include "uv.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define HELPERS 3
+#define PARTS 8
+
+typedef struct {
+  atomic_int runs[PARTS];
+  atomic_int on_caller[PARTS];
+  // Parts whose `on_caller` did not match their thread
+  atomic_int mismatched;
+  uv_thread_t caller;
+  uint32_t sleep_ms;
+} parts_t;
+
+static void _part(void *arg, uint32_t part, bool on_caller) {
+  parts_t *p = arg;
+  if (p->sleep_ms) {
+    uv_sleep(p->sleep_ms);
+  }
+  uv_thread_t self = uv_thread_self();
+  // Asserts only work on the test's thread
+  if (on_caller != (uv_thread_equal(&self, &p->caller) != 0)) {
+    atomic_fetch_add(&p->mismatched, 1);
+  }
+  atomic_fetch_add(&p->runs[part], 1);
+  if (on_caller) {
+    atomic_fetch_add(&p->on_caller[part], 1);
+  }
+}
+
+static void _run(parts_t *p, uint32_t num_parts) {
+  p->caller = uv_thread_self();
+  range_pool_run(_part, p, num_parts);
+  for (uint32_t i = 0; i < PARTS; i++) {
+    TEST_ASSERT_EQUAL_INT(i < num_parts ? 1 : 0, atomic_load(&p->runs[i]));
+  }
+  TEST_ASSERT_EQUAL_INT(1, atomic_load(&p->on_caller[0]));
+  TEST_ASSERT_EQUAL_INT(0, atomic_load(&p->mismatched));
+}
+
+void setUp(void) {}
+
+void tearDown(void) { range_pool_destroy(); }
+
+void test_runs_on_caller_without_pool(void) {
+  parts_t p;
+  memset(&p, 0, sizeof(p));
+  _run(&p, 4);
+  for (uint32_t i = 0; i < 4; i++) {
+    TEST_ASSERT_EQUAL_INT(1, atomic_load(&p.on_caller[i]));
+  }
+}
+
+void test_runs_every_part_once(void) {
+  TEST_ASSERT_TRUE(range_pool_init(HELPERS));
+  TEST_ASSERT_FALSE(range_pool_init(HELPERS));
+  for (uint32_t n = 1; n <= PARTS; n++) {
+    parts_t p;
+    memset(&p, 0, sizeof(p));
+    _run(&p, n);
+  }
+}
+
+void test_helpers_take_parts(void) {
+  TEST_ASSERT_TRUE(range_pool_init(HELPERS));
+  parts_t p;
+  memset(&p, 0, sizeof(p));
+  // Slow parts leave the helpers time to claim theirs
+  p.sleep_ms = 20;
+  _run(&p, HELPERS + 1);
+  int on_caller = 0;
+  for (uint32_t i = 0; i < HELPERS + 1; i++) {
+    on_caller += atomic_load(&p.on_caller[i]);
+  }
+  TEST_ASSERT_TRUE(on_caller < HELPERS + 1);
+}
+
+typedef struct {
+  parts_t parts;
+  uint32_t num_parts;
+} run_args_t;
+
+static void _run_thread(void *arg) {
+  run_args_t *a = arg;
+  a->parts.caller = uv_thread_self();
+  range_pool_run(_part, &a->parts, a->num_parts);
+}
+
+void test_concurrent_runs(void) {
+  TEST_ASSERT_TRUE(range_pool_init(HELPERS));
+  run_args_t runs[4];
+  uv_thread_t threads[4];
+  memset(runs, 0, sizeof(runs));
+  for (uint32_t i = 0; i < 4; i++) {
+    runs[i].num_parts = PARTS;
+    runs[i].parts.sleep_ms = 2;
+    TEST_ASSERT_EQUAL(0, uv_thread_create(&threads[i], _run_thread, &runs[i]));
+  }
+  for (uint32_t i = 0; i < 4; i++) {
+    uv_thread_join(&threads[i]);
+    for (uint32_t j = 0; j < PARTS; j++) {
+      TEST_ASSERT_EQUAL_INT(1, atomic_load(&runs[i].parts.runs[j]));
+    }
+    TEST_ASSERT_EQUAL_INT(0, atomic_load(&runs[i].parts.mismatched));
+  }
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_runs_on_caller_without_pool);
+  RUN_TEST(test_runs_every_part_once);
+  RUN_TEST(test_helpers_take_parts);
+  RUN_TEST(test_concurrent_runs);
+  return UNITY_END();
+}
@@ -0,0 +1,164 @@
+#include "core/bitmaps.h"
+#include "core/ebr.h"
+#include "engine/read_cache/read_cache.h"
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static ck_epoch_section_t section;
+
+// Serialized bitmap holding `value`
+static void *_ser_bitmap(uint32_t value, size_t *size_out) {
+  bitmap_t *bm = bitmap_create();
+  bitmap_add(bm, value);
+  void *buf = bitmap_serialize(bm, size_out);
+  bitmap_free(bm);
+  TEST_ASSERT_NOT_NULL(buf);
+  return buf;
+}
+
+static const bitmap_t *_put(const char *key, uint64_t seq, uint32_t value) {
+  size_t size = 0;
+  void *buf = _ser_bitmap(value, &size);
+  const bitmap_t *bm = read_cache_put(key, seq, buf, size);
+  free(buf);
+  return bm;
+}
+
+// Bytes charged for one of the entries used below
+static size_t _entry_bytes(void) {
+  TEST_ASSERT_TRUE(read_cache_init(1024 * 1024));
+  ebr_begin(&section);
+  TEST_ASSERT_NOT_NULL(_put("c|0|k0", 1, 1));
+  ebr_end(&section);
+  read_cache_stats_t stats;
+  read_cache_get_stats(&stats);
+  read_cache_destroy();
+  return stats.bytes;
+}
+
+void setUp(void) {}
+
+void tearDown(void) {
+  read_cache_destroy();
+  ebr_full_reclaim_blocking();
+}
+
+void test_get_before_init_misses(void) {
+  ebr_begin(&section);
+  TEST_ASSERT_NULL(read_cache_get("c|0|tag", 1));
+  TEST_ASSERT_NULL(_put("c|0|tag", 1, 7));
+  ebr_end(&section);
+}
+
+void test_put_then_get_outlives_source_buffer(void) {
+  TEST_ASSERT_TRUE(read_cache_init(1024 * 1024));
+  ebr_begin(&section);
+
+  TEST_ASSERT_NULL(read_cache_get("c|0|tag", 1));
+  const bitmap_t *put_bm = _put("c|0|tag", 1, 42);
+  TEST_ASSERT_NOT_NULL(put_bm);
+
+  const bitmap_t *bm = read_cache_get("c|0|tag", 1);
+  TEST_ASSERT_EQUAL_PTR(put_bm, bm);
+  TEST_ASSERT_TRUE(bitmap_contains((bitmap_t *)bm, 42));
+  TEST_ASSERT_EQUAL_UINT64(1, bitmap_get_cardinality(bm));
+  ebr_end(&section);
+
+  read_cache_stats_t stats;
+  read_cache_get_stats(&stats);
+  TEST_ASSERT_EQUAL_UINT64(1, stats.hits);
+  TEST_ASSERT_EQUAL_UINT64(1, stats.misses);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.entries);
+}
+
+void test_stale_seq_misses_and_newer_put_replaces(void) {
+  TEST_ASSERT_TRUE(read_cache_init(1024 * 1024));
+  ebr_begin(&section);
+
+  TEST_ASSERT_NOT_NULL(_put("c|0|tag", 5, 1));
+  TEST_ASSERT_NULL(read_cache_get("c|0|tag", 6));
+
+  TEST_ASSERT_NOT_NULL(_put("c|0|tag", 6, 2));
+  const bitmap_t *bm = read_cache_get("c|0|tag", 6);
+  TEST_ASSERT_NOT_NULL(bm);
+  TEST_ASSERT_TRUE(bitmap_contains((bitmap_t *)bm, 2));
+  TEST_ASSERT_FALSE(bitmap_contains((bitmap_t *)bm, 1));
+  TEST_ASSERT_NULL(read_cache_get("c|0|tag", 5));
+
+  // An older snapshot never replaces a newer entry
+  TEST_ASSERT_NULL(_put("c|0|tag", 5, 3));
+  TEST_ASSERT_NOT_NULL(read_cache_get("c|0|tag", 6));
+  ebr_end(&section);
+
+  read_cache_stats_t stats;
+  read_cache_get_stats(&stats);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.entries);
+}
+
+void test_same_seq_put_returns_existing(void) {
+  TEST_ASSERT_TRUE(read_cache_init(1024 * 1024));
+  ebr_begin(&section);
+  const bitmap_t *first = _put("c|0|tag", 1, 1);
+  TEST_ASSERT_NOT_NULL(first);
+  TEST_ASSERT_EQUAL_PTR(first, _put("c|0|tag", 1, 1));
+  ebr_end(&section);
+}
+
+void test_budget_is_respected(void) {
+  size_t entry_bytes = _entry_bytes();
+  TEST_ASSERT_TRUE(read_cache_init(entry_bytes * 4));
+  ebr_begin(&section);
+
+  char key[32];
+  for (uint32_t i = 0; i < 20; i++) {
+    snprintf(key, sizeof(key), "c|0|k%u", i % 10);
+    TEST_ASSERT_NOT_NULL(_put(key, 1, i));
+  }
+  ebr_end(&section);
+
+  read_cache_stats_t stats;
+  read_cache_get_stats(&stats);
+  TEST_ASSERT_EQUAL_UINT32(4, stats.entries);
+  TEST_ASSERT_TRUE(stats.bytes <= entry_bytes * 4);
+  TEST_ASSERT_EQUAL_UINT64(16, stats.evictions);
+}
+
+void test_clock_keeps_referenced_entries(void) {
+  size_t entry_bytes = _entry_bytes();
+  TEST_ASSERT_TRUE(read_cache_init(entry_bytes * 2));
+  ebr_begin(&section);
+
+  TEST_ASSERT_NOT_NULL(_put("c|0|k1", 1, 1));
+  TEST_ASSERT_NOT_NULL(_put("c|0|k2", 1, 2));
+  TEST_ASSERT_NOT_NULL(read_cache_get("c|0|k1", 1));
+
+  // k1 gets a second chance, k2 is evicted
+  TEST_ASSERT_NOT_NULL(_put("c|0|k3", 1, 3));
+  TEST_ASSERT_NOT_NULL(read_cache_get("c|0|k1", 1));
+  TEST_ASSERT_NULL(read_cache_get("c|0|k2", 1));
+  TEST_ASSERT_NOT_NULL(read_cache_get("c|0|k3", 1));
+  ebr_end(&section);
+}
+
+void test_value_larger_than_budget_is_not_cached(void) {
+  TEST_ASSERT_TRUE(read_cache_init(16));
+  ebr_begin(&section);
+  TEST_ASSERT_NULL(_put("c|0|tag", 1, 1));
+  TEST_ASSERT_NULL(read_cache_get("c|0|tag", 1));
+  ebr_end(&section);
+}
+
+int main(void) {
+  ebr_epoch_global_init();
+  UNITY_BEGIN();
+  RUN_TEST(test_get_before_init_misses);
+  RUN_TEST(test_put_then_get_outlives_source_buffer);
+  RUN_TEST(test_stale_seq_misses_and_newer_put_replaces);
+  RUN_TEST(test_same_seq_put_returns_existing);
+  RUN_TEST(test_budget_is_respected);
+  RUN_TEST(test_clock_keeps_referenced_entries);
+  RUN_TEST(test_value_larger_than_budget_is_not_cached);
+  return UNITY_END();
+}
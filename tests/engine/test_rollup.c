@@ -0,0 +1,171 @@
+#include "core/db.h"
+#include "engine/cmd_context/cmd_context.h"
+#include "engine/rollup/rollup.h"
+#include "lmdb.h"
+#include "query/ast.h"
+#include "query/parser.h"
+#include "query/tokenizer.h"
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// 2023-11-14T22:13:20.123Z, in ns
+#define ARRIVAL_TS_NS 1700000000123000000LL
+
+static MDB_env *test_env = NULL;
+static MDB_dbi meta_db;
+static char test_db_path[256];
+static _Atomic(rollup_set_t *) rollups;
+
+static ast_node_t *_parse(const char *input) {
+  queue_t *tokens = tok_tokenize((char *)input);
+  TEST_ASSERT_NOT_NULL(tokens);
+  parse_result_t *pr = parse(tokens);
+  queue_destroy(tokens);
+  TEST_ASSERT_TRUE_MESSAGE(pr->success, pr->error_message);
+  ast_node_t *ast = pr->ast;
+  parse_free_result(pr);
+  return ast;
+}
+
+static cmd_ctx_t *_event(const char *input) {
+  cmd_ctx_t *ctx = build_cmd_context(_parse(input), ARRIVAL_TS_NS);
+  TEST_ASSERT_NOT_NULL(ctx);
+  return ctx;
+}
+
+static const rollup_t *_add(const char *id) {
+  TEST_ASSERT_EQUAL(DB_PUT_OK, rollup_add(id, test_env, meta_db));
+  TEST_ASSERT_TRUE(rollup_publish(&rollups, id));
+  const rollup_t *r = rollup_find(atomic_load(&rollups), id);
+  TEST_ASSERT_NOT_NULL(r);
+  return r;
+}
+
+void setUp(void) {
+  srand((unsigned int)time(NULL));
+  snprintf(test_db_path, sizeof(test_db_path), "/tmp/test_rollup_%d_%d",
+           getpid(), rand());
+  test_env = db_create_env(test_db_path, 16 * 1024 * 1024, 4);
+  TEST_ASSERT_NOT_NULL(test_env);
+  TEST_ASSERT_TRUE(db_open(test_env, "meta", false, DB_DUP_NONE, &meta_db));
+  atomic_init(&rollups, NULL);
+}
+
+void tearDown(void) {
+  rollup_close_registry(&rollups);
+  if (test_env) {
+    db_close(test_env, meta_db);
+    db_env_close(test_env);
+    test_env = NULL;
+  }
+  char lock_path[300];
+  snprintf(lock_path, sizeof(lock_path), "%s-lock", test_db_path);
+  unlink(test_db_path);
+  unlink(lock_path);
+}
+
+void test_id_from_keys(void) {
+  ast_node_t *ast = _parse("create rollup in:c by:(action,country) bucket:1m");
+  cmd_ctx_t *cmd = build_cmd_context(ast, 0);
+  char id[64];
+  TEST_ASSERT_TRUE(rollup_id_into(id, sizeof(id), cmd->by_tag_value, 60000));
+  TEST_ASSERT_EQUAL_STRING("action,country|60000", id);
+  TEST_ASSERT_FALSE(rollup_id_into(id, 8, cmd->by_tag_value, 60000));
+  cmd_context_free(cmd);
+}
+
+void test_add_and_reopen(void) {
+  const rollup_t *r = _add("action,country|60000");
+  TEST_ASSERT_EQUAL_UINT32(2, r->num_keys);
+  TEST_ASSERT_EQUAL_STRING("action", r->keys[0]);
+  TEST_ASSERT_EQUAL_STRING("country", r->keys[1]);
+  TEST_ASSERT_EQUAL_UINT64(60000, r->bucket_ms);
+  _add("action|1000");
+  TEST_ASSERT_EQUAL(DB_PUT_KEY_EXISTS,
+                    rollup_add("action|1000", test_env, meta_db));
+
+  rollup_close_registry(&rollups);
+  TEST_ASSERT_TRUE(rollup_open_registry(test_env, meta_db, &rollups));
+  rollup_set_t *set = atomic_load(&rollups);
+  TEST_ASSERT_EQUAL_UINT32(2, set->count);
+  TEST_ASSERT_NOT_NULL(rollup_find(set, "action,country|60000"));
+  TEST_ASSERT_EQUAL_UINT64(1000,
+                           rollup_find(set, "action|1000")->bucket_ms);
+  TEST_ASSERT_NULL(rollup_find(set, "action|60000"));
+}
+
+void test_add_rejects_malformed_ids(void) {
+  TEST_ASSERT_EQUAL(DB_PUT_ERR, rollup_add("action", test_env, meta_db));
+  TEST_ASSERT_EQUAL(DB_PUT_ERR, rollup_add("|1000", test_env, meta_db));
+  TEST_ASSERT_EQUAL(DB_PUT_ERR, rollup_add("a,,b|1000", test_env, meta_db));
+  TEST_ASSERT_EQUAL(DB_PUT_ERR, rollup_add("a|0", test_env, meta_db));
+  TEST_ASSERT_EQUAL(DB_PUT_ERR, rollup_add("a|1m", test_env, meta_db));
+  TEST_ASSERT_EQUAL(DB_PUT_ERR,
+                    rollup_add("a,b,c,d,e|1000", test_env, meta_db));
+}
+
+void test_row_key_of_event(void) {
+  const rollup_t *r = _add("action,code|60000");
+  cmd_ctx_t *ev = _event("event in:c entity:u1 action:buy code:42 x:1");
+  char key[MAX_ROLLUP_ROW_KEY_LEN];
+  TEST_ASSERT_TRUE(rollup_row_key_into(key, sizeof(key), r, ev));
+  // 1700000000123 ms, in the minute from 1699999980000 (0x18bcfe519e0)
+  TEST_ASSERT_EQUAL_STRING("action,code|60000|0000018bcfe519e0|buy\x1f"
+                           "42",
+                           key);
+
+  uint64_t bucket;
+  const char *values;
+  size_t values_len;
+  TEST_ASSERT_TRUE(rollup_parse_row_key(r, key, strlen(key), &bucket, &values,
+                                        &values_len));
+  TEST_ASSERT_EQUAL_UINT64(1699999980000ULL, bucket);
+  TEST_ASSERT_EQUAL_size_t(6, values_len);
+  TEST_ASSERT_EQUAL_MEMORY("buy\x1f" "42", values, values_len);
+  cmd_context_free(ev);
+}
+
+void test_row_key_needs_every_key(void) {
+  const rollup_t *r = _add("action,country|60000");
+  cmd_ctx_t *ev = _event("event in:c entity:u1 action:buy");
+  char key[MAX_ROLLUP_ROW_KEY_LEN];
+  TEST_ASSERT_FALSE(rollup_row_key_into(key, sizeof(key), r, ev));
+  cmd_context_free(ev);
+}
+
+void test_bucket_key_bounds_rows(void) {
+  const rollup_t *r = _add("action|60000");
+  char low[MAX_ROLLUP_ROW_KEY_LEN];
+  TEST_ASSERT_TRUE(rollup_bucket_key_into(low, sizeof(low), r, 60000));
+  TEST_ASSERT_EQUAL_STRING("action|60000|000000000000ea60|", low);
+
+  uint64_t bucket;
+  const char *values;
+  size_t values_len;
+  TEST_ASSERT_TRUE(rollup_parse_row_key(r, low, strlen(low), &bucket, &values,
+                                        &values_len));
+  TEST_ASSERT_EQUAL_UINT64(60000, bucket);
+  TEST_ASSERT_EQUAL_size_t(0, values_len);
+  // Rows of another rollup sharing the prefix
+  const char *other = "action|600000|000000000000ea60|buy";
+  TEST_ASSERT_FALSE(rollup_parse_row_key(r, other, strlen(other), &bucket,
+                                         &values, &values_len));
+  const char *bad_hex = "action|60000|00000000000Xea60|buy";
+  TEST_ASSERT_FALSE(rollup_parse_row_key(r, bad_hex, strlen(bad_hex), &bucket,
+                                         &values, &values_len));
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_id_from_keys);
+  RUN_TEST(test_add_and_reopen);
+  RUN_TEST(test_add_rejects_malformed_ids);
+  RUN_TEST(test_row_key_of_event);
+  RUN_TEST(test_row_key_needs_every_key);
+  RUN_TEST(test_bucket_key_bounds_rows);
+  return UNITY_END();
+}
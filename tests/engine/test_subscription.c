@@ -0,0 +1,209 @@
+#include "engine/cmd_context/cmd_context.h"
+#include "engine/subscription/subscription.h"
+#include "query/ast.h"
+#include "query/parser.h"
+#include "query/tokenizer.h"
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int notified = 0;
+
+static void _notify(void *arg) {
+  (void)arg;
+  notified++;
+}
+
+static ast_node_t *_parse(const char *input) {
+  queue_t *tokens = tok_tokenize((char *)input);
+  TEST_ASSERT_NOT_NULL(tokens);
+  parse_result_t *pr = parse(tokens);
+  queue_destroy(tokens);
+  TEST_ASSERT_TRUE_MESSAGE(pr->success, pr->error_message);
+  ast_node_t *ast = pr->ast;
+  parse_free_result(pr);
+  return ast;
+}
+
+// Detaches the `where` expression of a command
+static ast_node_t *_where(const char *input) {
+  ast_node_t *ast = _parse(input);
+  ast_node_t *exp = NULL;
+  for (ast_node_t *t = ast->command.tags; t; t = t->next) {
+    if (t->tag.key_type == AST_TAG_KEY_RESERVED &&
+        t->tag.reserved_key == AST_KW_WHERE) {
+      exp = t->tag.value;
+      t->tag.value = NULL;
+    }
+  }
+  ast_free(ast);
+  TEST_ASSERT_NOT_NULL(exp);
+  return exp;
+}
+
+static sub_t *_subscribe(const char *container, const char *where_input,
+                         uint32_t capacity) {
+  sub_t *sub = sub_create(container, _where(where_input), capacity);
+  TEST_ASSERT_NOT_NULL(sub);
+  TEST_ASSERT_TRUE(sub_register(sub, _notify, NULL));
+  return sub;
+}
+
+static void _unsubscribe(sub_t *sub) {
+  sub_close(sub);
+  sub_release(sub);
+}
+
+static cmd_ctx_t *_event(const char *input) {
+  cmd_ctx_t *ctx = build_cmd_context(_parse(input), 0);
+  TEST_ASSERT_NOT_NULL(ctx);
+  return ctx;
+}
+
+// Match and deliver an event, as the worker and writer do
+static void _ingest(const char *container, const char *input,
+                    uint32_t event_id) {
+  cmd_ctx_t *ev = _event(input);
+  sub_push_t *push = sub_match(container, ev);
+  char data[32];
+  int len = snprintf(data, sizeof(data), "event-%u", event_id);
+  sub_push_deliver(push, event_id, data, (size_t)len);
+  cmd_context_free(ev);
+}
+
+void setUp(void) {
+  notified = 0;
+  TEST_ASSERT_TRUE(sub_registry_init());
+}
+
+void tearDown(void) { sub_registry_destroy(); }
+
+void test_match_filters_by_container_and_predicate(void) {
+  cmd_ctx_t *ev = _event("event in:logs entity:u1 status:error");
+  TEST_ASSERT_NULL(sub_match("logs", ev));
+
+  sub_t *errors = _subscribe("logs", "subscribe in:logs where:(status:error)",
+                             8);
+  sub_t *oks = _subscribe("logs", "subscribe in:logs where:(status:ok)", 8);
+  sub_t *other = _subscribe("metrics",
+                            "subscribe in:metrics where:(status:error)", 8);
+
+  sub_push_t *push = sub_match("logs", ev);
+  TEST_ASSERT_NOT_NULL(push);
+  TEST_ASSERT_EQUAL_UINT32(1, push->count);
+  TEST_ASSERT_EQUAL_PTR(errors, push->subs[0]);
+  sub_push_free(push);
+
+  _unsubscribe(errors);
+  _unsubscribe(oks);
+  _unsubscribe(other);
+  cmd_context_free(ev);
+}
+
+void test_deliver_buffers_in_order_and_notifies(void) {
+  sub_t *sub = _subscribe("logs", "subscribe in:logs where:(status:error)",
+                          8);
+
+  _ingest("logs", "event in:logs entity:u1 status:error", 1);
+  _ingest("logs", "event in:logs entity:u1 status:ok", 2);
+  _ingest("logs", "event in:logs entity:u2 status:error", 3);
+  TEST_ASSERT_EQUAL_INT(2, notified);
+
+  sub_event_t out[8];
+  bool overflowed = true;
+  uint32_t n = sub_drain(sub, out, 8, &overflowed);
+  TEST_ASSERT_FALSE(overflowed);
+  TEST_ASSERT_EQUAL_UINT32(2, n);
+  TEST_ASSERT_EQUAL_UINT32(1, out[0].id);
+  TEST_ASSERT_EQUAL_UINT32(3, out[1].id);
+  TEST_ASSERT_EQUAL_MEMORY("event-3", out[1].data, out[1].data_size);
+  for (uint32_t i = 0; i < n; i++) {
+    free(out[i].data);
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, sub_drain(sub, out, 8, &overflowed));
+
+  _unsubscribe(sub);
+}
+
+void test_drain_respects_max_and_wraps(void) {
+  sub_t *sub = _subscribe("logs", "subscribe in:logs where:(a:1)", 3);
+  sub_event_t out[3];
+
+  for (uint32_t round = 0; round < 3; round++) {
+    _ingest("logs", "event in:logs entity:u1 a:1", round * 2 + 1);
+    _ingest("logs", "event in:logs entity:u1 a:1", round * 2 + 2);
+    TEST_ASSERT_EQUAL_UINT32(1, sub_drain(sub, out, 1, NULL));
+    TEST_ASSERT_EQUAL_UINT32(round * 2 + 1, out[0].id);
+    free(out[0].data);
+    TEST_ASSERT_EQUAL_UINT32(1, sub_drain(sub, out, 3, NULL));
+    TEST_ASSERT_EQUAL_UINT32(round * 2 + 2, out[0].id);
+    free(out[0].data);
+  }
+
+  _unsubscribe(sub);
+}
+
+void test_full_buffer_marks_slow_consumer(void) {
+  sub_t *sub = _subscribe("logs", "subscribe in:logs where:(a:1)", 2);
+
+  _ingest("logs", "event in:logs entity:u1 a:1", 1);
+  _ingest("logs", "event in:logs entity:u1 a:1", 2);
+  _ingest("logs", "event in:logs entity:u1 a:1", 3);
+  // The overflow itself is signalled, later events are not
+  _ingest("logs", "event in:logs entity:u1 a:1", 4);
+  TEST_ASSERT_EQUAL_INT(3, notified);
+
+  sub_event_t out[4];
+  bool overflowed = false;
+  uint32_t n = sub_drain(sub, out, 4, &overflowed);
+  TEST_ASSERT_TRUE(overflowed);
+  TEST_ASSERT_EQUAL_UINT32(2, n);
+  for (uint32_t i = 0; i < n; i++) {
+    free(out[i].data);
+  }
+
+  _unsubscribe(sub);
+}
+
+void test_close_stops_in_flight_delivery(void) {
+  sub_t *sub = _subscribe("logs", "subscribe in:logs where:(a:1)", 4);
+  cmd_ctx_t *ev = _event("event in:logs entity:u1 a:1");
+
+  // Matched before the subscriber left, committed after
+  sub_push_t *push = sub_match("logs", ev);
+  TEST_ASSERT_NOT_NULL(push);
+  sub_close(sub);
+  TEST_ASSERT_NULL(sub_match("logs", ev));
+
+  sub_push_deliver(push, 1, "x", 1);
+  TEST_ASSERT_EQUAL_INT(0, notified);
+  sub_event_t out[1];
+  TEST_ASSERT_EQUAL_UINT32(0, sub_drain(sub, out, 1, NULL));
+
+  sub_release(sub);
+  cmd_context_free(ev);
+}
+
+void test_push_keeps_subscription_alive(void) {
+  sub_t *sub = _subscribe("logs", "subscribe in:logs where:(a:1)", 4);
+  cmd_ctx_t *ev = _event("event in:logs entity:u1 a:1");
+  sub_push_t *push = sub_match("logs", ev);
+
+  // The owner is gone, the push holds the last reference
+  _unsubscribe(sub);
+  sub_push_free(push);
+
+  cmd_context_free(ev);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_match_filters_by_container_and_predicate);
+  RUN_TEST(test_deliver_buffers_in_order_and_notifies);
+  RUN_TEST(test_drain_respects_max_and_wraps);
+  RUN_TEST(test_full_buffer_marks_slow_consumer);
+  RUN_TEST(test_close_stops_in_flight_delivery);
+  RUN_TEST(test_push_keeps_subscription_alive);
+  return UNITY_END();
+}
@@ -0,0 +1,144 @@
+#include "core/db.h"
+#include "engine/index/index.h"
+#include "engine/tag_stats/tag_stats.h"
+#include "lmdb.h"
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static MDB_env *test_env = NULL;
+static MDB_dbi stats_db;
+static MDB_dbi registry_db;
+static kh_key_index_t *key_map = NULL;
+static char test_db_path[256];
+
+void setUp(void) {
+  srand((unsigned int)time(NULL));
+  snprintf(test_db_path, sizeof(test_db_path), "/tmp/test_tag_stats_%d_%d",
+           getpid(), rand());
+  test_env = db_create_env(test_db_path, 16 * 1024 * 1024, 8);
+  TEST_ASSERT_NOT_NULL(test_env);
+  TEST_ASSERT_TRUE(db_open(test_env, "stats", false, DB_DUP_NONE, &stats_db));
+  TEST_ASSERT_TRUE(
+      db_open(test_env, "registry", false, DB_DUP_NONE, &registry_db));
+
+  // `amount` has a numeric index, `loc` does not
+  index_write_reg_opts_t opts = {.src = INDEX_WRITE_DEFAULTS};
+  TEST_ASSERT_TRUE(index_write_registry(test_env, registry_db, &opts));
+  index_def_t def = {.key = "amount", .type = INDEX_TYPE_I64};
+  TEST_ASSERT_EQUAL(DB_PUT_OK, index_add(&def, test_env, registry_db));
+  TEST_ASSERT_TRUE(index_open_registry(test_env, registry_db, &key_map));
+}
+
+void tearDown(void) {
+  index_close_registry(test_env, &key_map);
+  if (test_env) {
+    db_close(test_env, stats_db);
+    db_close(test_env, registry_db);
+    db_env_close(test_env);
+    test_env = NULL;
+  }
+  char lock_path[300];
+  snprintf(lock_path, sizeof(lock_path), "%s-lock", test_db_path);
+  unlink(test_db_path);
+  unlink(lock_path);
+}
+
+static void _put(const char *inv_key, uint64_t card) {
+  MDB_txn *txn = db_create_txn(test_env, false);
+  TEST_ASSERT_NOT_NULL(txn);
+  TEST_ASSERT_TRUE(
+      tag_stats_put_cardinality(txn, stats_db, key_map, inv_key, card));
+  TEST_ASSERT_TRUE(db_commit_txn(txn));
+}
+
+void test_bucket_bounds(void) {
+  TEST_ASSERT_EQUAL_UINT32(0, tag_stats_bucket(0.5));
+  TEST_ASSERT_EQUAL_UINT32(1, tag_stats_bucket(1));
+  TEST_ASSERT_EQUAL_UINT32(2, tag_stats_bucket(2));
+  TEST_ASSERT_EQUAL_UINT32(2, tag_stats_bucket(3.99));
+  TEST_ASSERT_EQUAL_UINT32(11, tag_stats_bucket(1024));
+  TEST_ASSERT_EQUAL_UINT32(TAG_STATS_HIST_BUCKETS - 1, tag_stats_bucket(1e300));
+  TEST_ASSERT_EQUAL_UINT64(0, tag_stats_bucket_min(0));
+  TEST_ASSERT_EQUAL_UINT64(1024, tag_stats_bucket_min(11));
+}
+
+void test_cardinality_and_key_counts(void) {
+  _put("loc:ca", 3);
+  _put("loc:ny", 1);
+  // Later flushes of a bitmap move the counts by the change
+  _put("loc:ca", 5);
+  _put("entity|7", 4);
+
+  MDB_txn *txn = db_create_txn(test_env, true);
+  uint64_t card = 0;
+  TEST_ASSERT_TRUE(tag_stats_get_cardinality(txn, stats_db, "loc:ca", &card));
+  TEST_ASSERT_EQUAL_UINT64(5, card);
+  TEST_ASSERT_TRUE(
+      tag_stats_get_cardinality(txn, stats_db, "entity|7", &card));
+  TEST_ASSERT_EQUAL_UINT64(4, card);
+  TEST_ASSERT_FALSE(tag_stats_get_cardinality(txn, stats_db, "loc:sf", &card));
+
+  tag_key_stats_t stats;
+  TEST_ASSERT_TRUE(tag_stats_get_key(txn, stats_db, "loc", &stats));
+  TEST_ASSERT_EQUAL_UINT64(2, stats.distinct);
+  TEST_ASSERT_EQUAL_UINT64(6, stats.events);
+  TEST_ASSERT_FALSE(stats.has_hist);
+  // Entity posting lists are not custom tags
+  TEST_ASSERT_FALSE(tag_stats_get_key(txn, stats_db, "entity", &stats));
+  db_abort_txn(txn);
+}
+
+void test_histogram_for_numeric_index(void) {
+  _put("amount:3", 2);
+  _put("amount:2", 1);
+  _put("amount:100", 4);
+  _put("amount:abc", 9);
+
+  MDB_txn *txn = db_create_txn(test_env, true);
+  tag_key_stats_t stats;
+  TEST_ASSERT_TRUE(tag_stats_get_key(txn, stats_db, "amount", &stats));
+  TEST_ASSERT_EQUAL_UINT64(4, stats.distinct);
+  TEST_ASSERT_EQUAL_UINT64(16, stats.events);
+  TEST_ASSERT_TRUE(stats.has_hist);
+  // Non-numeric values are counted but left out of the histogram
+  TEST_ASSERT_EQUAL_UINT64(3, stats.hist[tag_stats_bucket(2)]);
+  TEST_ASSERT_EQUAL_UINT64(4, stats.hist[tag_stats_bucket(100)]);
+  uint64_t total = 0;
+  for (uint32_t b = 0; b < TAG_STATS_HIST_BUCKETS; b++) {
+    total += stats.hist[b];
+  }
+  TEST_ASSERT_EQUAL_UINT64(7, total);
+  db_abort_txn(txn);
+}
+
+void test_list_in_key_order(void) {
+  _put("loc:ca", 1);
+  _put("amount:5", 2);
+  _put("view|errors", 3);
+
+  MDB_txn *txn = db_create_txn(test_env, true);
+  tag_stats_entry_t *entries = NULL;
+  uint32_t count = 0;
+  TEST_ASSERT_TRUE(tag_stats_list(txn, stats_db, &entries, &count));
+  db_abort_txn(txn);
+
+  TEST_ASSERT_EQUAL_UINT32(2, count);
+  TEST_ASSERT_EQUAL_STRING("amount", entries[0].key);
+  TEST_ASSERT_TRUE(entries[0].stats.has_hist);
+  TEST_ASSERT_EQUAL_STRING("loc", entries[1].key);
+  TEST_ASSERT_EQUAL_UINT64(1, entries[1].stats.events);
+  tag_stats_free_list(entries, count);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_bucket_bounds);
+  RUN_TEST(test_cardinality_and_key_counts);
+  RUN_TEST(test_histogram_for_numeric_index);
+  RUN_TEST(test_list_in_key_order);
+  return UNITY_END();
+}
@@ -1,3 +1,4 @@
+#include "core/data_constants.h"
 #include "engine/validator/validator.h"
 #include "query/ast.h"
 #include "query/parser.h"
@@ -98,7 +99,8 @@ void test_event_fails_duplicate_custom_keys(void) {
 void test_event_fails_with_where_clause(void) {
   // This checks that 'where' is caught by validator, even if parser accepts it
   check_validity("event in:logs entity:u1 where:(custom:1)", false,
-                 "`where` tag only supported for queries");
+                 "`where` tag only supported for queries, views and "
+                 "subscriptions");
 }
 
 void test_event_fails_with_key_clause(void) {
@@ -130,6 +132,80 @@ void test_query_fails_with_entity_tag(void) {
                  "Unexpected `entity` tag");
 }
 
+void test_query_valid_fields(void) {
+  check_validity("query in:logs where:(loc:ca) fields:(loc, price)", true,
+                 NULL);
+}
+
+void test_event_fails_with_fields_tag(void) {
+  check_validity("event in:logs entity:u1 fields:(loc)", false,
+                 "Unexpected `fields` tag");
+}
+
+void test_query_fails_duplicate_fields(void) {
+  check_validity("query in:logs where:(loc:ca) fields:(a) fields:(b)", false,
+                 "Duplicate `fields` tag");
+}
+
+void test_query_fails_too_many_fields(void) {
+  char query[512];
+  int len = snprintf(query, sizeof(query), "query in:logs where:(loc:ca) "
+                                           "fields:(f0");
+  for (int i = 1; i <= MAX_QUERY_FIELDS; i++) {
+    len += snprintf(query + len, sizeof(query) - len, ",f%d", i);
+  }
+  snprintf(query + len, sizeof(query) - len, ")");
+  check_validity(query, false, "Too many fields");
+}
+
+void test_query_valid_timeout(void) {
+  check_validity("query in:logs where:(loc:ca) timeout:500", true, NULL);
+}
+
+void test_event_fails_with_timeout_tag(void) {
+  check_validity("event in:logs entity:u1 timeout:500", false,
+                 "Unexpected `timeout` tag");
+}
+
+void test_query_fails_timeout_out_of_range(void) {
+  check_validity("query in:logs where:(loc:ca) timeout:0", false,
+                 "Value of `timeout` tag is out of range");
+  char query[128];
+  snprintf(query, sizeof(query), "query in:logs where:(loc:ca) timeout:%d",
+           MAX_QUERY_TIMEOUT_MS + 1);
+  check_validity(query, false, "Value of `timeout` tag is out of range");
+}
+
+void test_query_valid_sample(void) {
+  check_validity("query in:logs where:(loc:ca) sample:10", true, NULL);
+}
+
+void test_query_fails_sample_out_of_range(void) {
+  check_validity("query in:logs where:(loc:ca) sample:0", false,
+                 "Value of `sample` tag is out of range");
+  check_validity("query in:logs where:(loc:ca) sample:101", false,
+                 "Value of `sample` tag is out of range");
+  check_validity("event in:logs entity:u1 sample:10", false,
+                 "Unexpected `sample` tag");
+}
+
+void test_query_valid_agg(void) {
+  check_validity("query in:logs where:(loc:ca) agg:amount", true, NULL);
+}
+
+void test_query_fails_invalid_agg(void) {
+  check_validity("query in:logs where:(loc:ca) agg:amount agg:qty", false,
+                 "Duplicate `agg` tag");
+  check_validity("query in:logs where:(loc:ca) agg:5", false,
+                 "Value of `agg` tag must be a tag key");
+  check_validity("index key:amount agg:amount", false, "Unexpected tag");
+}
+
+void test_query_fails_non_numeric_timeout(void) {
+  check_validity("query in:logs where:(loc:ca) timeout:soon", false,
+                 "Value of `timeout` tag must be numeric");
+}
+
 // --- TEST GROUP 3: WHERE Clause Logic ---
 
 void test_where_valid_comparison_mixed_types(void) {
@@ -143,12 +219,29 @@ void test_where_fails_comparison_same_types_number(void) {
                  "Invalid comparison types");
 }
 
-void test_where_fails_comparison_same_types_string(void) {
-  // String > String
-  check_validity("query in:logs where:(loc > ca)", false,
+void test_where_valid_comparison_strings(void) {
+  // String key > string bound, read from a string index
+  check_validity("query in:logs where:(loc > ca)", true, NULL);
+  check_validity("query in:logs where:(loc <= \"new york\")", true, NULL);
+}
+
+void test_where_valid_comparison_decimal(void) {
+  check_validity("query in:logs where:(price > 9.99)", true, NULL);
+}
+
+void test_where_fails_comparison_without_key(void) {
+  check_validity("query in:logs where:(5 > 9.5)", false,
                  "Invalid comparison types");
 }
 
+void test_where_contains(void) {
+  check_validity("query in:logs where:(path ~ \"check out\")", true, NULL);
+  check_validity("query in:logs where:(path ~ 5)", false,
+                 "~ needs a string value");
+  check_validity("query in:logs where:(5 ~ path)", false,
+                 "~ needs a string value");
+}
+
 void test_where_valid_recursive_logic(void) {
   check_validity("query in:logs where:((loc:ca) AND (price > 10))", true, NULL);
 }
@@ -157,6 +250,10 @@ void test_where_valid_not_logic(void) {
   check_validity("query in:logs where:(NOT loc:ca)", true, NULL);
 }
 
+void test_where_valid_entity_tag(void) {
+  check_validity("query in:logs where:(entity:user1 AND loc:ca)", true, NULL);
+}
+
 // --- TEST GROUP 4: INDEX Command ---
 
 void test_index_valid(void) { check_validity("index key:price", true, NULL); }
@@ -165,10 +262,220 @@ void test_index_fails_unexpected_tag(void) {
   check_validity("index a:b", false, "Unexpected tag");
 }
 
+void test_index_valid_with_type(void) {
+  check_validity("index key:amount type:f64", true, NULL);
+  check_validity("index key:region type:str", true, NULL);
+  check_validity("index key:amount type:bsi", true, NULL);
+}
+
+void test_index_fails_unknown_type(void) {
+  check_validity("index key:amount type:foo", false,
+                 "Index type must be one of i64, f64, str, bsi");
+}
+
 void test_index_fails_with_in_tag(void) {
   check_validity("index key:price in:logs", false,
                  "Indexing specific containers is not supported yet. Indexes "
-                 "apply globally to new data containers.");
+                 "apply globally to all data containers.");
+}
+
+// --- CREATE VIEW Command ---
+
+void test_create_view_valid(void) {
+  check_validity("create view errors in:logs where:(status:error)", true,
+                 NULL);
+}
+
+void test_create_view_fails_missing_where(void) {
+  check_validity("create view errors in:logs", false,
+                 "`where` tag is required");
+}
+
+void test_create_view_fails_nested_view(void) {
+  check_validity("create view v2 in:logs where:(view:errors OR a:1)", false,
+                 "Views cannot reference other views");
+}
+
+void test_where_fails_invalid_view_name(void) {
+  check_validity("query in:logs where:(view:\"a b\")", false,
+                 "Invalid view name");
+}
+
+// --- SUBSCRIBE Command ---
+
+void test_subscribe_valid(void) {
+  check_validity("subscribe in:logs where:(status:error AND code:500)", true,
+                 NULL);
+}
+
+void test_subscribe_fails_missing_where(void) {
+  check_validity("subscribe in:logs", false, "`where` tag is required");
+}
+
+void test_subscribe_fails_with_view(void) {
+  check_validity("subscribe in:logs where:(view:errors)", false,
+                 "Subscriptions cannot reference views");
+}
+
+// --- SHOW Command ---
+
+void test_show_backfills_valid(void) {
+  check_validity("show backfills", true, NULL);
+}
+
+void test_show_stats_needs_in(void) {
+  check_validity("show stats in:logs", true, NULL);
+  check_validity("show stats", false, "`in` tag is required");
+  check_validity("show backfills in:logs", false, "Unexpected `in` tag");
+}
+
+void test_explain_and_profile_query(void) {
+  check_validity("explain query in:logs where:(a:1)", true, NULL);
+  check_validity("profile query in:logs where:(a:1) take:5", true, NULL);
+  check_validity("explain query where:(a:1)", false, "`in` tag is required");
+}
+
+void test_top_valid(void) {
+  check_validity("top country in:logs", true, NULL);
+  check_validity("top country n:5 in:logs where:(loc:ca) timeout:100", true,
+                 NULL);
+  check_validity("top country n:5", false, "`in` tag is required");
+  check_validity("top country n:0 in:logs", false,
+                 "Value of `n` tag is out of range");
+  check_validity("top country n:1001 in:logs", false,
+                 "Value of `n` tag is out of range");
+  check_validity("top country in:logs take:5", false, "Unexpected `take` tag");
+  check_validity("show keys in:logs", true, NULL);
+}
+
+void test_histogram_valid(void) {
+  check_validity("histogram in:logs where:(a:1) bucket:1m from:0 to:3600000",
+                 true, NULL);
+  check_validity("histogram in:logs where:(a:1) bucket:500 from:0 to:1000",
+                 true, NULL);
+  check_validity("histogram in:logs bucket:1m from:0 to:60000", false,
+                 "`where` tag is required");
+  check_validity("histogram in:logs where:(a:1) from:0 to:60000", false,
+                 "`bucket`, `from` and `to` tags are required");
+  check_validity("histogram in:logs where:(a:1) bucket:1w from:0 to:60000",
+                 false, "Invalid `bucket` duration");
+  check_validity("histogram in:logs where:(a:1) bucket:1m from:60000 to:0",
+                 false, "`from` and `to` must be timestamps, `from` first");
+  // A week of minutes is the most buckets
+  check_validity("histogram in:logs where:(a:1) bucket:1m from:0 to:604800000",
+                 true, NULL);
+  check_validity("histogram in:logs where:(a:1) bucket:1m from:0 to:604800001",
+                 false, "Too many buckets");
+}
+
+void test_rollup_valid(void) {
+  check_validity("create rollup in:shop by:(action,country) bucket:1m", true,
+                 NULL);
+  check_validity("rollup in:shop by:(action) bucket:1h from:0 to:3600000",
+                 true, NULL);
+  check_validity("create rollup in:shop bucket:1m", false,
+                 "`by` tag is required");
+  check_validity("create rollup in:shop by:(entity) bucket:1m", false,
+                 "Rollups count custom tags only");
+  check_validity("create rollup in:shop by:(a,b,a) bucket:1m", false,
+                 "Duplicate `by` key");
+  check_validity("create rollup in:shop by:(a,b,c,d,e) bucket:1m", false,
+                 "Too many `by` keys");
+  check_validity("create rollup in:shop by:(action)", false,
+                 "A `bucket` duration is required");
+  check_validity("rollup in:shop by:(action) bucket:1m from:60000 to:0", false,
+                 "`from` and `to` must be timestamps, `from` first");
+  check_validity("rollup in:shop by:(action) bucket:1m", false,
+                 "`from` and `to` must be timestamps, `from` first");
+  check_validity("query in:shop where:(a:1) by:(action)", false,
+                 "Unexpected `by` tag");
+}
+
+void test_funnel_valid(void) {
+  check_validity("funnel in:shop steps:(page:home, page:paid) within:30m",
+                 true, NULL);
+  check_validity(
+      "funnel in:shop steps:(page:home, page:paid) within:1000 timeout:50",
+      true, NULL);
+  check_validity("funnel in:shop steps:(page:home) within:30m", false,
+                 "A funnel has 2 to 16 steps");
+  check_validity("funnel in:shop steps:(page:home, page:paid)", false,
+                 "`steps` and `within` tags are required");
+  check_validity("funnel in:shop steps:(page:home, page:paid) within:soon",
+                 false, "Invalid `within` duration");
+  check_validity("funnel in:shop steps:(page:home, 5 > 3) within:1m", false,
+                 "Invalid comparison types");
+  check_validity("funnel in:shop where:(page:home) steps:(a:1, b:2) within:1m",
+                 false,
+                 "`where` tag only supported for queries, views and "
+                 "subscriptions");
+  check_validity("query in:shop steps:(a:1, b:2) where:(a:1)", false,
+                 "Unexpected `steps` tag");
+}
+
+void test_entities_valid(void) {
+  check_validity("entities of:(day1 AND day7:signups AND NOT day8)", true,
+                 NULL);
+  check_validity("entities of:(day1 OR day2) take:100 cursor:5 timeout:50",
+                 true, NULL);
+  check_validity("entities take:10", false, "`of` tag is required");
+  check_validity("entities in:day1 of:(day1)", false,
+                 "Unexpected `in` tag, containers are named in `of`");
+  check_validity("entities of:(NOT day1)", false,
+                 "NOT only applies to one side of AND");
+  check_validity("entities of:(NOT day1 AND NOT day2)", false,
+                 "NOT only applies to one side of AND");
+  check_validity("entities of:(day1 OR NOT day2)", false,
+                 "NOT only applies to one side of AND");
+  check_validity("entities of:(day1 AND amount > 5)", false,
+                 "Invalid entity set");
+  check_validity("entities of:(day1 AND 42)", false, "Invalid container name");
+  check_validity("entities of:(day1 AND view:paid)", false,
+                 "Invalid container name");
+  check_validity("query in:day1 of:(day1) where:(a:1)", false,
+                 "Unexpected `of` tag");
+  check_validity("entities of:(a AND b AND c AND d AND e AND f AND g AND h "
+                 "AND i AND j AND k AND l AND m AND n AND o AND p AND q)",
+                 false, "Too many containers in entity set");
+}
+
+void test_ids_only_valid(void) {
+  check_validity("query in:x where:(a:1) ids_only:true take:100", true, NULL);
+  check_validity("query in:x where:(a:1) ids_only:yes", false,
+                 "Value of `ids_only` tag must be true");
+  check_validity("query in:x where:(a:1) ids_only:true fields:(a)", false,
+                 "`ids_only` cannot be combined with `fields`, `agg` or "
+                 "EXPLAIN/PROFILE");
+  check_validity("top a in:x ids_only:true", false, "Unexpected tag");
+}
+
+void test_session_valid(void) {
+  check_validity("query in:x where:(a:1) session:new take:100", true, NULL);
+  check_validity("query in:x where:(a:1) session:1234 cursor:5", true, NULL);
+  check_validity("query in:x where:(a:1) session:0", false,
+                 "Value of `session` tag must be new or a session handle");
+  check_validity("query in:x where:(a:1) session:new session:new", false,
+                 "Duplicate `session` tag");
+  check_validity("query in:x where:(a:1) session:new agg:price", false,
+                 "`session` cannot be combined with `agg`, `sample` or "
+                 "EXPLAIN/PROFILE");
+}
+
+void test_after_valid(void) {
+  check_validity("query in:x where:(a:1) after:42", true, NULL);
+  check_validity("query in:x where:(a:1) after:0", false,
+                 "Value of `after` tag must be an event id");
+  check_validity("query in:x where:(a:1) after:abc", false,
+                 "Value of `after` tag must be an event id");
+  check_validity("query in:x where:(a:1) after:4294967296", false,
+                 "Value of `after` tag must be an event id");
+  check_validity("query in:x where:(a:1) after:1 after:2", false,
+                 "Duplicate `after` tag");
+  check_validity("top a in:x after:1", false, "Unexpected tag");
+}
+
+void test_show_fails_unknown_target(void) {
+  check_validity("show tables", false, "Unknown SHOW target");
 }
 
 // --- TEST GROUP 5: Edge Cases (Manual AST) ---
@@ -245,19 +552,60 @@ int main(void) {
   RUN_TEST(test_query_valid_minimal);
   RUN_TEST(test_query_fails_missing_where);
   RUN_TEST(test_query_fails_with_entity_tag);
+  RUN_TEST(test_query_valid_fields);
+  RUN_TEST(test_event_fails_with_fields_tag);
+  RUN_TEST(test_query_fails_duplicate_fields);
+  RUN_TEST(test_query_fails_too_many_fields);
+  RUN_TEST(test_query_valid_timeout);
+  RUN_TEST(test_event_fails_with_timeout_tag);
+  RUN_TEST(test_query_fails_timeout_out_of_range);
+  RUN_TEST(test_query_fails_non_numeric_timeout);
+  RUN_TEST(test_query_valid_sample);
+  RUN_TEST(test_query_fails_sample_out_of_range);
+  RUN_TEST(test_query_valid_agg);
+  RUN_TEST(test_query_fails_invalid_agg);
 
   // Where Logic Tests
   RUN_TEST(test_where_valid_comparison_mixed_types);
   RUN_TEST(test_where_fails_comparison_same_types_number);
-  RUN_TEST(test_where_fails_comparison_same_types_string);
+  RUN_TEST(test_where_valid_comparison_strings);
+  RUN_TEST(test_where_valid_comparison_decimal);
+  RUN_TEST(test_where_fails_comparison_without_key);
+  RUN_TEST(test_where_contains);
   RUN_TEST(test_where_valid_recursive_logic);
   RUN_TEST(test_where_valid_not_logic);
+  RUN_TEST(test_where_valid_entity_tag);
 
   // Index Tests
   RUN_TEST(test_index_valid);
   RUN_TEST(test_index_fails_unexpected_tag);
+  RUN_TEST(test_index_valid_with_type);
+  RUN_TEST(test_index_fails_unknown_type);
   RUN_TEST(test_index_fails_with_in_tag);
 
+  // Create View Tests
+  RUN_TEST(test_create_view_valid);
+  RUN_TEST(test_create_view_fails_missing_where);
+  RUN_TEST(test_create_view_fails_nested_view);
+  RUN_TEST(test_where_fails_invalid_view_name);
+
+  // Subscribe Tests
+  RUN_TEST(test_subscribe_valid);
+  RUN_TEST(test_subscribe_fails_missing_where);
+  RUN_TEST(test_subscribe_fails_with_view);
+  RUN_TEST(test_show_backfills_valid);
+  RUN_TEST(test_show_stats_needs_in);
+  RUN_TEST(test_show_fails_unknown_target);
+  RUN_TEST(test_explain_and_profile_query);
+  RUN_TEST(test_top_valid);
+  RUN_TEST(test_histogram_valid);
+  RUN_TEST(test_rollup_valid);
+  RUN_TEST(test_funnel_valid);
+  RUN_TEST(test_entities_valid);
+  RUN_TEST(test_ids_only_valid);
+  RUN_TEST(test_session_valid);
+  RUN_TEST(test_after_valid);
+
   // Manual / Defensive Tests
   RUN_TEST(test_fails_on_null_root);
   RUN_TEST(test_fails_on_entity_name_too_long);
@@ -0,0 +1,293 @@
+#include "core/db.h"
+#include "engine/cmd_context/cmd_context.h"
+#include "engine/view/view.h"
+#include "lmdb.h"
+#include "query/ast.h"
+#include "query/parser.h"
+#include "query/tokenizer.h"
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// 2023-11-14T22:13:20Z, in ns
+#define ARRIVAL_TS_NS 1700000000000000000LL
+
+static MDB_env *test_env = NULL;
+static MDB_dbi meta_db;
+static char test_db_path[256];
+static _Atomic(view_set_t *) views;
+
+static ast_node_t *_parse(const char *input) {
+  queue_t *tokens = tok_tokenize((char *)input);
+  TEST_ASSERT_NOT_NULL(tokens);
+  parse_result_t *pr = parse(tokens);
+  queue_destroy(tokens);
+  TEST_ASSERT_TRUE_MESSAGE(pr->success, pr->error_message);
+  ast_node_t *ast = pr->ast;
+  parse_free_result(pr);
+  return ast;
+}
+
+// Detaches the `where` expression of a query
+static ast_node_t *_where(const char *query) {
+  ast_node_t *ast = _parse(query);
+  ast_node_t *exp = NULL;
+  for (ast_node_t *t = ast->command.tags; t; t = t->next) {
+    if (t->tag.key_type == AST_TAG_KEY_RESERVED &&
+        t->tag.reserved_key == AST_KW_WHERE) {
+      exp = t->tag.value;
+      t->tag.value = NULL;
+    }
+  }
+  ast_free(ast);
+  TEST_ASSERT_NOT_NULL(exp);
+  return exp;
+}
+
+static bool _matches(const char *query, cmd_ctx_t *event) {
+  ast_node_t *where = _where(query);
+  bool m = view_matches(where, event, NULL);
+  ast_free(where);
+  return m;
+}
+
+static cmd_ctx_t *_event(const char *input) {
+  cmd_ctx_t *ctx = build_cmd_context(_parse(input), ARRIVAL_TS_NS);
+  TEST_ASSERT_NOT_NULL(ctx);
+  return ctx;
+}
+
+static void _encode(const char *query, char **data, size_t *size) {
+  ast_node_t *where = _where(query);
+  TEST_ASSERT_TRUE(view_encode_exp(where, data, size));
+  ast_free(where);
+}
+
+void setUp(void) {
+  srand((unsigned int)time(NULL));
+  snprintf(test_db_path, sizeof(test_db_path), "/tmp/test_view_%d_%d",
+           getpid(), rand());
+  test_env = db_create_env(test_db_path, 16 * 1024 * 1024, 4);
+  TEST_ASSERT_NOT_NULL(test_env);
+  TEST_ASSERT_TRUE(db_open(test_env, "meta", false, DB_DUP_NONE, &meta_db));
+  atomic_init(&views, NULL);
+}
+
+void tearDown(void) {
+  view_close_registry(&views);
+  if (test_env) {
+    db_close(test_env, meta_db);
+    db_env_close(test_env);
+    test_env = NULL;
+  }
+  char lock_path[300];
+  snprintf(lock_path, sizeof(lock_path), "%s-lock", test_db_path);
+  unlink(test_db_path);
+  unlink(lock_path);
+}
+
+void test_encode_decode_round_trip(void) {
+  const char *q = "query in:c where:((status:error OR code:500) AND "
+                  "entity:u1 AND ts > 5 AND price <= 9.99 AND "
+                  "service:\"check out\")";
+  char *data = NULL;
+  size_t size = 0;
+  _encode(q, &data, &size);
+
+  ast_node_t *decoded = view_decode_exp(data, size);
+  TEST_ASSERT_NOT_NULL(decoded);
+
+  // Re-encoding the decoded tree gives the same bytes
+  char *again = NULL;
+  size_t again_size = 0;
+  TEST_ASSERT_TRUE(view_encode_exp(decoded, &again, &again_size));
+  TEST_ASSERT_EQUAL_size_t(size, again_size);
+  TEST_ASSERT_EQUAL_MEMORY(data, again, size);
+
+  free(again);
+  free(data);
+  ast_free(decoded);
+}
+
+void test_decode_rejects_malformed(void) {
+  char *data = NULL;
+  size_t size = 0;
+  _encode("query in:c where:(a:1 AND b:2)", &data, &size);
+  TEST_ASSERT_NULL(view_decode_exp(data, size - 1));
+  const char garbage[] = {(char)0x93, 0x07, 0x01, 0x02};
+  TEST_ASSERT_NULL(view_decode_exp(garbage, sizeof(garbage)));
+  free(data);
+}
+
+void test_matches_tags_and_logic(void) {
+  cmd_ctx_t *ev = _event(
+      "event in:c entity:u1 status:error service:checkout code:500");
+
+  TEST_ASSERT_TRUE(_matches("query in:c where:(status:error)", ev));
+  TEST_ASSERT_TRUE(
+      _matches("query in:c where:(status:error AND service:checkout)", ev));
+  TEST_ASSERT_FALSE(
+      _matches("query in:c where:(status:error AND service:search)", ev));
+  TEST_ASSERT_TRUE(
+      _matches("query in:c where:(status:ok OR service:checkout)", ev));
+  TEST_ASSERT_TRUE(_matches("query in:c where:(code:500)", ev));
+  TEST_ASSERT_TRUE(_matches("query in:c where:(entity:u1)", ev));
+  TEST_ASSERT_FALSE(_matches("query in:c where:(entity:u2)", ev));
+  TEST_ASSERT_TRUE(
+      _matches("query in:c where:(status:error AND NOT service:search)", ev));
+  TEST_ASSERT_FALSE(
+      _matches("query in:c where:(status:error AND NOT code:500)", ev));
+
+  cmd_context_free(ev);
+}
+
+void test_matches_comparisons(void) {
+  cmd_ctx_t *ev = _event("event in:c entity:u1 amount:250 loc:ca");
+
+  TEST_ASSERT_TRUE(_matches("query in:c where:(amount > 100)", ev));
+  TEST_ASSERT_TRUE(_matches("query in:c where:(amount >= 250)", ev));
+  TEST_ASSERT_FALSE(_matches("query in:c where:(amount < 250)", ev));
+  TEST_ASSERT_TRUE(_matches("query in:c where:(amount <= 250)", ev));
+  // `ts` is the arrival time in ms
+  TEST_ASSERT_TRUE(_matches("query in:c where:(ts >= 1700000000000)", ev));
+  TEST_ASSERT_FALSE(_matches("query in:c where:(ts > 1700000000000)", ev));
+  // Missing or non-numeric values never match
+  TEST_ASSERT_FALSE(_matches("query in:c where:(price > 1)", ev));
+  TEST_ASSERT_FALSE(_matches("query in:c where:(loc > 1)", ev));
+
+  cmd_context_free(ev);
+}
+
+void test_matches_decimal_and_string_comparisons(void) {
+  cmd_ctx_t *ev = _event("event in:c entity:u1 price:9.99 qty:3 loc:ca");
+
+  TEST_ASSERT_TRUE(_matches("query in:c where:(price > 9.5)", ev));
+  TEST_ASSERT_FALSE(_matches("query in:c where:(price >= 10)", ev));
+  TEST_ASSERT_TRUE(_matches("query in:c where:(qty < 3.5)", ev));
+  TEST_ASSERT_TRUE(_matches("query in:c where:(price:9.99)", ev));
+  TEST_ASSERT_TRUE(_matches("query in:c where:(loc > az)", ev));
+  TEST_ASSERT_FALSE(_matches("query in:c where:(loc >= \"new york\")", ev));
+  TEST_ASSERT_TRUE(_matches("query in:c where:(loc ~ a)", ev));
+  TEST_ASSERT_FALSE(_matches("query in:c where:(loc ~ cal)", ev));
+  TEST_ASSERT_FALSE(_matches("query in:c where:(qty ~ \"3\")", ev));
+
+  cmd_context_free(ev);
+}
+
+// Matches `query` with `price` indexed as `type`
+static bool _matches_as(const char *query, cmd_ctx_t *event,
+                        index_type_t type) {
+  const char *key = "price";
+  kh_key_index_t *key_to_index = kh_init(key_index);
+  TEST_ASSERT_NOT_NULL(key_to_index);
+  int ret;
+  khiter_t k = kh_put(key_index, key_to_index, key, &ret);
+  kh_value(key_to_index, k) =
+      (index_t){.index_def = {.key = (char *)key, .type = type}};
+  ast_node_t *where = _where(query);
+  bool m = view_matches(where, event, key_to_index);
+  ast_free(where);
+  kh_destroy(key_index, key_to_index);
+  return m;
+}
+
+void test_matches_follow_index_type(void) {
+  cmd_ctx_t *dec = _event("event in:c entity:u1 price:7.5");
+  cmd_ctx_t *num = _event("event in:c entity:u1 price:7");
+
+  // Integer indexes hold no decimals, queries never see them
+  TEST_ASSERT_TRUE(_matches("query in:c where:(price > 5)", dec));
+  TEST_ASSERT_FALSE(
+      _matches_as("query in:c where:(price > 5)", dec, INDEX_TYPE_I64));
+  TEST_ASSERT_FALSE(
+      _matches_as("query in:c where:(price != 5)", dec, INDEX_TYPE_BSI));
+  TEST_ASSERT_TRUE(
+      _matches_as("query in:c where:(price > 5)", dec, INDEX_TYPE_F64));
+  // Decimal bounds are rounded
+  TEST_ASSERT_TRUE(
+      _matches_as("query in:c where:(price > 6.5)", num, INDEX_TYPE_I64));
+  TEST_ASSERT_FALSE(
+      _matches_as("query in:c where:(price >= 7.5)", num, INDEX_TYPE_I64));
+  TEST_ASSERT_TRUE(
+      _matches_as("query in:c where:(price <= 7.9)", num, INDEX_TYPE_I64));
+  TEST_ASSERT_FALSE(
+      _matches_as("query in:c where:(price = 7.5)", num, INDEX_TYPE_I64));
+  TEST_ASSERT_TRUE(
+      _matches_as("query in:c where:(price != 7.5)", num, INDEX_TYPE_I64));
+  // String indexes hold strings only
+  TEST_ASSERT_FALSE(
+      _matches_as("query in:c where:(price > 1)", num, INDEX_TYPE_STR));
+
+  cmd_context_free(dec);
+  cmd_context_free(num);
+}
+
+void test_registry_persists_and_reloads(void) {
+  char *data = NULL;
+  size_t size = 0;
+  _encode("query in:c where:(status:error)", &data, &size);
+
+  TEST_ASSERT_EQUAL(DB_PUT_OK, view_add("errors", data, size, test_env,
+                                        meta_db));
+  TEST_ASSERT_EQUAL(DB_PUT_KEY_EXISTS,
+                    view_add("errors", data, size, test_env, meta_db));
+  free(data);
+
+  // Other metadata keys are skipped
+  MDB_txn *txn = db_create_txn(test_env, false);
+  db_key_t other = {.type = DB_KEY_STRING, .key.s = "next_event_id"};
+  uint32_t v = 7;
+  TEST_ASSERT_EQUAL(DB_PUT_OK,
+                    db_put(meta_db, txn, &other, &v, sizeof(v), false, false));
+  TEST_ASSERT_TRUE(db_commit_txn(txn));
+
+  TEST_ASSERT_TRUE(view_open_registry(test_env, meta_db, &views));
+  view_set_t *set = atomic_load(&views);
+  TEST_ASSERT_EQUAL_UINT32(1, set->count);
+  const view_t *view = view_find(set, "errors");
+  TEST_ASSERT_NOT_NULL(view);
+  TEST_ASSERT_EQUAL_INT(AST_TAG_NODE, view->where->type);
+  TEST_ASSERT_NULL(view_find(set, "missing"));
+}
+
+void test_publish_keeps_older_sets_readable(void) {
+  TEST_ASSERT_TRUE(view_open_registry(test_env, meta_db, &views));
+  view_set_t *empty = atomic_load(&views);
+  TEST_ASSERT_EQUAL_UINT32(0, empty->count);
+
+  char *data = NULL;
+  size_t size = 0;
+  _encode("query in:c where:(a:1)", &data, &size);
+  TEST_ASSERT_TRUE(view_publish(&views, "v1", data, size));
+  view_set_t *first = atomic_load(&views);
+  TEST_ASSERT_TRUE(view_publish(&views, "v2", data, size));
+  free(data);
+
+  view_set_t *second = atomic_load(&views);
+  TEST_ASSERT_EQUAL_UINT32(2, second->count);
+  TEST_ASSERT_NOT_NULL(view_find(second, "v1"));
+  TEST_ASSERT_NOT_NULL(view_find(second, "v2"));
+
+  // A reader still holding an older set sees it unchanged
+  TEST_ASSERT_EQUAL_UINT32(0, empty->count);
+  TEST_ASSERT_EQUAL_UINT32(1, first->count);
+  TEST_ASSERT_NULL(view_find(first, "v2"));
+  TEST_ASSERT_EQUAL_PTR(view_find(first, "v1")->where,
+                        view_find(second, "v1")->where);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_encode_decode_round_trip);
+  RUN_TEST(test_decode_rejects_malformed);
+  RUN_TEST(test_matches_tags_and_logic);
+  RUN_TEST(test_matches_comparisons);
+  RUN_TEST(test_matches_decimal_and_string_comparisons);
+  RUN_TEST(test_matches_follow_index_type);
+  RUN_TEST(test_registry_persists_and_reloads);
+  RUN_TEST(test_publish_keeps_older_sets_readable);
+  return UNITY_END();
+}
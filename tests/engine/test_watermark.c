@@ -0,0 +1,194 @@
+#include "core/deadline.h"
+#include "engine/watermark/watermark.h"
+#include "unity.h"
+#include "uv.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CMD_QUEUES 2
+#define WORKERS 2
+#define OP_QUEUES 2
+
+void setUp(void) {
+  TEST_ASSERT_TRUE(watermark_init(CMD_QUEUES, WORKERS, OP_QUEUES));
+}
+
+void tearDown(void) { watermark_destroy(); }
+
+// Expires right away, so a wait only checks
+static deadline_t _expired(void) {
+  deadline_t d = {.expires_ns = 1, .alive = NULL};
+  return d;
+}
+
+static uint32_t _queue(wm_container_t *c, uint32_t cmd_queue) {
+  uint32_t id = watermark_assign_begin(c);
+  watermark_assign_end(c, cmd_queue, id, true);
+  return id;
+}
+
+void test_assigns_ids_in_order(void) {
+  wm_container_t *c = watermark_add("c", 5);
+  TEST_ASSERT_NOT_NULL(c);
+  TEST_ASSERT_EQUAL_PTR(c, watermark_find("c"));
+  TEST_ASSERT_EQUAL_STRING("c", watermark_container_name(c));
+  TEST_ASSERT_NULL(watermark_find("d"));
+
+  TEST_ASSERT_EQUAL_UINT32(5, _queue(c, 0));
+  // A failed enqueue gives its id back
+  uint32_t id = watermark_assign_begin(c);
+  watermark_assign_end(c, 1, id, false);
+  TEST_ASSERT_EQUAL_UINT32(6, _queue(c, 1));
+}
+
+void test_add_keeps_first(void) {
+  wm_container_t *c = watermark_add("c", 1);
+  TEST_ASSERT_EQUAL_PTR(c, watermark_add("c", 100));
+  TEST_ASSERT_EQUAL_UINT32(1, _queue(c, 0));
+}
+
+void test_unknown_container_is_reached(void) {
+  deadline_t d = _expired();
+  TEST_ASSERT_EQUAL(WATERMARK_REACHED, watermark_wait("none", 7, &d));
+}
+
+void test_ahead_of_assigned_ids(void) {
+  wm_container_t *c = watermark_add("c", 1);
+  _queue(c, 0);
+  deadline_t d = _expired();
+  TEST_ASSERT_EQUAL(WATERMARK_AHEAD, watermark_wait("c", 2, &d));
+}
+
+void test_waits_for_workers(void) {
+  wm_container_t *c = watermark_add("c", 1);
+  uint32_t a = _queue(c, 0);
+  uint32_t b = _queue(c, 1);
+  uint32_t later = _queue(c, 0);
+  deadline_t d = _expired();
+
+  TEST_ASSERT_EQUAL(WATERMARK_DEADLINE, watermark_wait("c", b, &d));
+  watermark_processed(c, 0, a);
+  TEST_ASSERT_EQUAL(WATERMARK_DEADLINE, watermark_wait("c", b, &d));
+  watermark_processed(c, 1, b);
+  // Queue 0 may hold ids up to `b` until it is past them
+  TEST_ASSERT_EQUAL(WATERMARK_DEADLINE, watermark_wait("c", b, &d));
+  watermark_processed(c, 0, later);
+  TEST_ASSERT_EQUAL(WATERMARK_REACHED, watermark_wait("c", b, &d));
+  TEST_ASSERT_EQUAL(WATERMARK_REACHED, watermark_wait("c", later, &d));
+}
+
+void test_waits_for_ops_and_writes(void) {
+  wm_container_t *c = watermark_add("c", 1);
+  uint32_t id = _queue(c, 0);
+  watermark_op_sent(c, 0, 1);
+  watermark_op_sent(c, 0, 1);
+  watermark_write_sent(c, 0);
+  watermark_processed(c, 0, id);
+  deadline_t d = _expired();
+
+  TEST_ASSERT_EQUAL(WATERMARK_DEADLINE, watermark_wait("c", id, &d));
+  watermark_op_applied(c, 0, 1);
+  watermark_op_applied(c, 0, 1);
+  TEST_ASSERT_EQUAL(WATERMARK_DEADLINE, watermark_wait("c", id, &d));
+  watermark_write_committed(c, 0);
+  TEST_ASSERT_EQUAL(WATERMARK_REACHED, watermark_wait("c", id, &d));
+
+  // Not from a worker, never waited for
+  watermark_op_sent(c, WATERMARK_NO_WORKER, 0);
+  watermark_write_sent(c, WATERMARK_NO_WORKER);
+  TEST_ASSERT_EQUAL(WATERMARK_REACHED, watermark_wait("c", id, &d));
+}
+
+void test_waits_for_queued_events(void) {
+  deadline_t d = _expired();
+  TEST_ASSERT_EQUAL(WATERMARK_REACHED, watermark_wait_queued("none", &d));
+  wm_container_t *c = watermark_add("c", 1);
+  TEST_ASSERT_EQUAL(WATERMARK_REACHED, watermark_wait_queued("c", &d));
+
+  uint32_t a = _queue(c, 0);
+  uint32_t b = _queue(c, 1);
+  watermark_op_sent(c, 1, 0);
+  watermark_processed(c, 0, a);
+  TEST_ASSERT_EQUAL(WATERMARK_DEADLINE, watermark_wait_queued("c", &d));
+  watermark_processed(c, 1, b);
+  TEST_ASSERT_EQUAL(WATERMARK_DEADLINE, watermark_wait_queued("c", &d));
+  watermark_op_applied(c, 1, 0);
+  TEST_ASSERT_EQUAL(WATERMARK_REACHED, watermark_wait_queued("c", &d));
+}
+
+void test_counts_ops_and_writes_per_container(void) {
+  wm_container_t *c = watermark_add("c", 1);
+  wm_container_t *busy = watermark_add("busy", 1);
+  uint32_t id = _queue(c, 0);
+  watermark_processed(c, 0, id);
+  watermark_op_sent(busy, 0, 0);
+  watermark_write_sent(busy, 1);
+  deadline_t d = _expired();
+
+  // Backlog of another container is not waited for
+  TEST_ASSERT_EQUAL(WATERMARK_REACHED, watermark_wait("c", id, &d));
+  watermark_op_sent(c, 1, 0);
+  TEST_ASSERT_EQUAL(WATERMARK_DEADLINE, watermark_wait("c", id, &d));
+  watermark_op_applied(busy, 0, 0);
+  TEST_ASSERT_EQUAL(WATERMARK_DEADLINE, watermark_wait("c", id, &d));
+  watermark_op_applied(c, 1, 0);
+  TEST_ASSERT_EQUAL(WATERMARK_REACHED, watermark_wait("c", id, &d));
+  // Not from an event of a container
+  watermark_op_sent(NULL, 0, 0);
+  watermark_write_sent(NULL, 0);
+  TEST_ASSERT_EQUAL(WATERMARK_REACHED, watermark_wait("c", id, &d));
+}
+
+typedef struct {
+  wm_container_t *c;
+  uint32_t event_id;
+} apply_args_t;
+
+static void _apply_later(void *arg) {
+  apply_args_t *a = arg;
+  uv_sleep(20);
+  watermark_processed(a->c, 0, a->event_id);
+  uv_sleep(20);
+  watermark_write_committed(a->c, 0);
+}
+
+void test_wakes_when_applied(void) {
+  wm_container_t *c = watermark_add("c", 1);
+  uint32_t id = _queue(c, 0);
+  watermark_write_sent(c, 0);
+  apply_args_t args = {.c = c, .event_id = id};
+  uv_thread_t thread;
+  TEST_ASSERT_EQUAL(0, uv_thread_create(&thread, _apply_later, &args));
+
+  deadline_t d;
+  deadline_init(&d, 10000, NULL);
+  uint64_t start = uv_hrtime();
+  TEST_ASSERT_EQUAL(WATERMARK_REACHED, watermark_wait("c", id, &d));
+  // Returns once committed, long before the deadline
+  TEST_ASSERT_TRUE(uv_hrtime() - start < 5000 * 1000000ULL);
+  uv_thread_join(&thread);
+}
+
+void test_waits_until_deadline(void) {
+  wm_container_t *c = watermark_add("c", 1);
+  uint32_t id = _queue(c, 0);
+  deadline_t d;
+  deadline_init(&d, 20, NULL);
+  TEST_ASSERT_EQUAL(WATERMARK_DEADLINE, watermark_wait("c", id, &d));
+  TEST_ASSERT_EQUAL(DEADLINE_EXPIRED, deadline_status(&d));
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_assigns_ids_in_order);
+  RUN_TEST(test_add_keeps_first);
+  RUN_TEST(test_unknown_container_is_reached);
+  RUN_TEST(test_ahead_of_assigned_ids);
+  RUN_TEST(test_waits_for_workers);
+  RUN_TEST(test_waits_for_ops_and_writes);
+  RUN_TEST(test_waits_for_queued_events);
+  RUN_TEST(test_counts_ops_and_writes_per_container);
+  RUN_TEST(test_wakes_when_applied);
+  RUN_TEST(test_waits_until_deadline);
+  return UNITY_END();
+}
@@ -11,6 +11,7 @@
 #include "mpack.h"
 #include "query/parser.h"
 #include "query/tokenizer.h"
+#include "roaring.h"
 
 // --- Constants ---
 
@@ -61,7 +62,7 @@ static api_response_t *run_command_at(const char *command_string, int64_t ts) {
   }
 
   // Pass the explicit timestamp (ns) to the engine
-  api_response_t *api_res = api_exec(parse_res->ast, ts);
+  api_response_t *api_res = api_exec(parse_res->ast, ts, NULL);
   parse_free_result(parse_res);
   return api_res;
 }
@@ -268,6 +269,25 @@ int suiteTearDown(int num_failures) {
   _safe_remove_db_file("query_take");
   _safe_remove_db_file("query_ts");
   _safe_remove_db_file("query_complex_ts");
+  _safe_remove_db_file("query_entity");
+  _safe_remove_db_file("query_fields");
+  _safe_remove_db_file("query_timeout");
+  _safe_remove_db_file("query_after");
+  _safe_remove_db_file("query_sample");
+  _safe_remove_db_file("query_view");
+  _safe_remove_db_file("query_range");
+  _safe_remove_db_file("query_bsi");
+  _safe_remove_db_file("query_stats");
+  _safe_remove_db_file("query_plan");
+  _safe_remove_db_file("query_scan");
+  _safe_remove_db_file("query_top");
+  _safe_remove_db_file("query_histogram");
+  _safe_remove_db_file("query_rollup");
+  _safe_remove_db_file("query_funnel");
+  _safe_remove_db_file("query_ent_d1");
+  _safe_remove_db_file("query_ent_d7");
+  _safe_remove_db_file("query_ids");
+  _safe_remove_db_file("query_session");
   return (num_failures > 0) ? 1 : 0;
 }
 
@@ -504,6 +524,875 @@ void test_QUERY_ComplexTsLogic_ShouldFilterCorrectly(void) {
   _assert_query_count(c, q4, 2);
 }
 
+void test_QUERY_EntityTimeline_ShouldReturnEntityEvents(void) {
+  const char *c = "query_entity";
+  _safe_remove_db_file(c);
+
+  const char *events[] = {
+      "EVENT in:query_entity entity:ent_timeline_a loc:ca",
+      "EVENT in:query_entity entity:ent_timeline_b loc:ca",
+      "EVENT in:query_entity entity:ent_timeline_a loc:ny",
+  };
+  for (size_t i = 0; i < sizeof(events) / sizeof(events[0]); i++) {
+    api_response_t *res = run_command(events[i]);
+    TEST_ASSERT_NOT_NULL(res);
+    TEST_ASSERT_TRUE_MESSAGE(res->is_ok, res->err_msg);
+    free_api_response(res);
+  }
+
+  _assert_query_count(c, "where:(entity:ent_timeline_a)", 2);
+  _assert_query_count(c, "where:(entity:ent_timeline_a AND loc:ca)", 1);
+  _assert_query_count(c, "where:(entity:ent_timeline_missing)", 0);
+}
+
+void test_QUERY_Fields_ShouldProjectTags(void) {
+  const char *c = "query_fields";
+  _safe_remove_db_file(c);
+
+  _write_event(c, "loc:ca env:prod user:matt");
+  _assert_query_count(c, "where:(loc:ca)", 1);
+
+  api_response_t *res =
+      run_command("QUERY in:query_fields where:(loc:ca) fields:(user, nope)");
+  _assert_count_val(res, 1);
+
+  api_obj_t *obj = &res->payload.list_obj.objects[0];
+  mpack_tree_t tree;
+  mpack_tree_init_data(&tree, obj->data, obj->data_size);
+  mpack_tree_parse(&tree);
+  mpack_node_t root = mpack_tree_root(&tree);
+  TEST_ASSERT_EQUAL_UINT32(3, mpack_node_map_count(root));
+  TEST_ASSERT_TRUE(mpack_node_map_contains_cstr(root, "id"));
+  TEST_ASSERT_TRUE(mpack_node_map_contains_cstr(root, "ts"));
+  TEST_ASSERT_TRUE(mpack_node_map_contains_cstr(root, "user"));
+  TEST_ASSERT_FALSE(mpack_node_map_contains_cstr(root, "loc"));
+  TEST_ASSERT_EQUAL(mpack_ok, mpack_tree_destroy(&tree));
+  free_api_response(res);
+}
+
+void test_QUERY_Timeout_ShouldBeAccepted(void) {
+  const char *c = "query_timeout";
+  _safe_remove_db_file(c);
+
+  _write_event(c, "loc:ca");
+  _assert_query_count(c, "where:(loc:ca)", 1);
+  _assert_query_count(c, "where:(loc:ca) timeout:5000", 1);
+}
+
+void test_QUERY_After_ShouldSeeAckedEvents(void) {
+  const char *c = "query_after";
+  _safe_remove_db_file(c);
+
+  uint32_t last = 0;
+  for (int i = 0; i < 50; i++) {
+    char buf[128];
+    snprintf(buf, sizeof(buf), "EVENT in:%s entity:after_ent_%d loc:ca", c,
+             i % 7);
+    api_response_t *res = run_command(buf);
+    TEST_ASSERT_NOT_NULL(res);
+    TEST_ASSERT_TRUE_MESSAGE(res->is_ok, res->err_msg);
+    TEST_ASSERT_EQUAL_STRING(c, res->payload.watermark.container_name);
+    TEST_ASSERT_GREATER_THAN_UINT32(last, res->payload.watermark.event_id);
+    last = res->payload.watermark.event_id;
+    free_api_response(res);
+  }
+
+  // No polling, the query waits for the events
+  char cmd[128];
+  snprintf(cmd, sizeof(cmd), "QUERY in:%s where:(loc:ca) take:100 after:%u", c,
+           last);
+  api_response_t *res = run_command(cmd);
+  _assert_count_val(res, 50);
+  free_api_response(res);
+
+  snprintf(cmd, sizeof(cmd), "QUERY in:%s where:(loc:ca) after:%u", c,
+           last + 1);
+  res = run_command(cmd);
+  TEST_ASSERT_NOT_NULL(res);
+  TEST_ASSERT_FALSE(res->is_ok);
+  free_api_response(res);
+}
+
+void test_QUERY_Sample_ShouldEstimateCount(void) {
+  const char *c = "query_sample";
+  _safe_remove_db_file(c);
+
+  for (int i = 0; i < 200; i++) {
+    _write_event(c, "loc:ca");
+  }
+  _assert_query_count(c, "where:(loc:ca)", 200);
+
+  api_response_t *res = run_command("QUERY in:query_sample where:(loc:ca) "
+                                    "sample:50");
+  TEST_ASSERT_NOT_NULL(res);
+  TEST_ASSERT_TRUE(res->is_ok);
+  api_response_type_list_obj_t *list = &res->payload.list_obj;
+  TEST_ASSERT_TRUE(list->sampled);
+  TEST_ASSERT_GREATER_THAN(0, list->count);
+  TEST_ASSERT_LESS_THAN(200, list->count);
+  // Every event matches, so the scaled count is exact
+  TEST_ASSERT_EQUAL_UINT64(200, list->estimated_count);
+  TEST_ASSERT_GREATER_THAN(0, list->count_error);
+  free_api_response(res);
+
+  res = run_command("QUERY in:query_sample where:(loc:ny) sample:50");
+  TEST_ASSERT_NOT_NULL(res);
+  TEST_ASSERT_TRUE(res->is_ok);
+  TEST_ASSERT_EQUAL_UINT32(0, res->payload.list_obj.count);
+  TEST_ASSERT_EQUAL_UINT64(0, res->payload.list_obj.estimated_count);
+  free_api_response(res);
+}
+
+void test_QUERY_View_ShouldBackfillAndMaintain(void) {
+  const char *c = "query_view";
+  _safe_remove_db_file(c);
+
+  _write_event(c, "status:error svc:api");
+  _write_event(c, "status:ok svc:api");
+
+  api_response_t *res =
+      run_command("CREATE VIEW errors in:query_view where:(status:error)");
+  TEST_ASSERT_NOT_NULL(res);
+  TEST_ASSERT_TRUE_MESSAGE(res->is_ok, res->err_msg);
+  free_api_response(res);
+
+  // Existing match is backfilled
+  _assert_query_count(c, "where:(view:errors)", 1);
+
+  // New events are matched at ingest
+  _write_event(c, "status:error svc:web");
+  _write_event(c, "status:ok svc:web");
+  _assert_query_count(c, "where:(view:errors)", 2);
+  _assert_query_count(c, "where:(view:errors AND svc:web)", 1);
+
+  res = run_command("CREATE VIEW errors in:query_view where:(status:ok)");
+  TEST_ASSERT_NOT_NULL(res);
+  TEST_ASSERT_FALSE(res->is_ok);
+  TEST_ASSERT_EQUAL_STRING("Duplicate view", res->err_msg);
+  free_api_response(res);
+
+  res = run_command("QUERY in:query_view where:(view:missing)");
+  TEST_ASSERT_NOT_NULL(res);
+  TEST_ASSERT_FALSE(res->is_ok);
+  free_api_response(res);
+}
+
+// Indexes apply to containers created after them and outlive the process
+static void _ensure_index(const char *cmd) {
+  api_response_t *res = run_command(cmd);
+  TEST_ASSERT_NOT_NULL(res);
+  if (!res->is_ok) {
+    TEST_ASSERT_EQUAL_STRING("Duplicate index", res->err_msg);
+  }
+  free_api_response(res);
+}
+
+void test_QUERY_DecimalAndStringRanges_ShouldUseIndexes(void) {
+  const char *c = "query_range";
+  _safe_remove_db_file(c);
+  _ensure_index("INDEX key:range_price type:f64");
+  _ensure_index("INDEX key:range_region type:str");
+
+  _write_event(c, "range_price:9.99 range_region:eu-west");
+  _write_event(c, "range_price:12 range_region:us-east");
+  _write_event(c, "range_price:12.5 range_region:us-west");
+  _write_event(c, "range_price:0.5 range_region:ap-south");
+
+  _assert_query_count(c, "where:(range_price > 9.99)", 2);
+  _assert_query_count(c, "where:(range_price >= 9.99)", 3);
+  _assert_query_count(c, "where:(range_price < 1)", 1);
+  _assert_query_count(c, "where:(range_price > 10 AND range_price < 12.5)",
+                      1);
+  _assert_query_count(c, "where:(range_price != 12)", 3);
+  _assert_query_count(c, "where:(range_region >= us)", 2);
+  _assert_query_count(c, "where:(range_region < \"eu-z\")", 2);
+
+  api_response_t *res = run_command("QUERY in:query_range where:"
+                                    "(range_region > 5)");
+  TEST_ASSERT_NOT_NULL(res);
+  TEST_ASSERT_FALSE(res->is_ok);
+  TEST_ASSERT_EQUAL_STRING("Comparison value does not match index type",
+                           res->err_msg);
+  free_api_response(res);
+}
+
+void test_QUERY_Bsi_ShouldCompareAndAggregate(void) {
+  const char *c = "query_bsi";
+  _safe_remove_db_file(c);
+  _ensure_index("INDEX key:bsi_amount type:bsi");
+
+  _write_event(c, "bsi_amount:5 svc:api");
+  _write_event(c, "bsi_amount:12 svc:api");
+  _write_event(c, "bsi_amount:40 svc:web");
+  _write_event(c, "bsi_amount:0 svc:web");
+  _write_event(c, "svc:web");
+
+  _assert_query_count(c, "where:(bsi_amount > 5)", 2);
+  _assert_query_count(c, "where:(bsi_amount <= 12)", 3);
+  _assert_query_count(c, "where:(bsi_amount = 12)", 1);
+  _assert_query_count(c, "where:(bsi_amount != 12)", 3);
+  _assert_query_count(c, "where:(bsi_amount >= 5 AND bsi_amount < 40)", 2);
+  _assert_query_count(c, "where:(bsi_amount > 4.5)", 3);
+
+  api_response_t *res = NULL;
+  for (int i = 0; i < POLL_RETRIES; i++) {
+    if (res)
+      free_api_response(res);
+    res = run_command("QUERY in:query_bsi where:(svc:web) agg:bsi_amount");
+    if (res && res->is_ok && res->payload.list_obj.agg_count == 2) {
+      break;
+    }
+    usleep(POLL_SLEEP_US);
+  }
+  TEST_ASSERT_NOT_NULL(res);
+  TEST_ASSERT_TRUE_MESSAGE(res->is_ok, res->err_msg);
+  api_response_type_list_obj_t *list = &res->payload.list_obj;
+  TEST_ASSERT_TRUE(list->has_agg);
+  // Events without a value are matched but not aggregated
+  TEST_ASSERT_EQUAL_UINT32(3, list->count);
+  TEST_ASSERT_EQUAL_UINT64(2, list->agg_count);
+  TEST_ASSERT_EQUAL_UINT64(40, list->agg_sum);
+  TEST_ASSERT_EQUAL_UINT64(0, list->agg_min);
+  TEST_ASSERT_EQUAL_UINT64(40, list->agg_max);
+  free_api_response(res);
+
+  res = run_command("QUERY in:query_bsi where:(svc:api) agg:svc");
+  TEST_ASSERT_NOT_NULL(res);
+  TEST_ASSERT_FALSE(res->is_ok);
+  TEST_ASSERT_EQUAL_STRING("Aggregates need a bsi index on the key",
+                           res->err_msg);
+  free_api_response(res);
+}
+
+// Reads `key`'s distinct and event counts from a `SHOW stats` response
+static bool _find_stats(api_response_t *res, const char *key,
+                        uint64_t *distinct, uint64_t *events,
+                        size_t *hist_len) {
+  bool found = false;
+  for (uint32_t i = 0; !found && i < res->payload.list_obj.count; i++) {
+    api_obj_t *obj = &res->payload.list_obj.objects[i];
+    mpack_tree_t tree;
+    mpack_tree_init_data(&tree, obj->data, obj->data_size);
+    mpack_tree_parse(&tree);
+    mpack_node_t root = mpack_tree_root(&tree);
+    char obj_key[64];
+    mpack_node_copy_cstr(mpack_node_map_cstr(root, "key"), obj_key,
+                         sizeof(obj_key));
+    if (strcmp(obj_key, key) == 0) {
+      found = true;
+      *distinct = mpack_node_u64(mpack_node_map_cstr(root, "distinct"));
+      *events = mpack_node_u64(mpack_node_map_cstr(root, "events"));
+      mpack_node_t hist = mpack_node_map_cstr_optional(root, "histogram");
+      *hist_len =
+          mpack_node_is_missing(hist) ? 0 : mpack_node_array_length(hist);
+    }
+    TEST_ASSERT_EQUAL(mpack_ok, mpack_tree_destroy(&tree));
+  }
+  return found;
+}
+
+void test_QUERY_ShowStats_ShouldCountTags(void) {
+  const char *c = "query_stats";
+  _safe_remove_db_file(c);
+  _ensure_index("INDEX key:stats_amount");
+
+  _write_event(c, "loc:ca stats_amount:3");
+  _write_event(c, "loc:ca stats_amount:100");
+  _write_event(c, "loc:ny stats_amount:2");
+
+  uint64_t distinct = 0, events = 0;
+  size_t hist_len = 0;
+  api_response_t *res = NULL;
+  // Stats are only written on flush, which takes longer than ops to apply
+  for (int i = 0; i < POLL_RETRIES * 20; i++) {
+    if (res)
+      free_api_response(res);
+    res = run_command("SHOW stats in:query_stats");
+    if (res && res->is_ok &&
+        _find_stats(res, "stats_amount", &distinct, &events, &hist_len) &&
+        events == 3 &&
+        _find_stats(res, "loc", &distinct, &events, &hist_len) &&
+        events == 3) {
+      break;
+    }
+    usleep(POLL_SLEEP_US);
+  }
+  TEST_ASSERT_NOT_NULL(res);
+  TEST_ASSERT_TRUE_MESSAGE(res->is_ok, res->err_msg);
+  TEST_ASSERT_TRUE(_find_stats(res, "loc", &distinct, &events, &hist_len));
+  TEST_ASSERT_EQUAL_UINT64(2, distinct);
+  TEST_ASSERT_EQUAL_UINT64(3, events);
+  TEST_ASSERT_EQUAL(0, hist_len);
+  TEST_ASSERT_TRUE(
+      _find_stats(res, "stats_amount", &distinct, &events, &hist_len));
+  TEST_ASSERT_EQUAL_UINT64(3, distinct);
+  TEST_ASSERT_EQUAL_UINT64(3, events);
+  // 2 and 3 share a bucket
+  TEST_ASSERT_EQUAL(2, hist_len);
+  free_api_response(res);
+
+  res = run_command("SHOW stats in:query_stats_missing");
+  TEST_ASSERT_NOT_NULL(res);
+  TEST_ASSERT_FALSE(res->is_ok);
+  free_api_response(res);
+}
+
+// Copies a string field of status object `i`
+static void _obj_str(api_response_t *res, uint32_t i, const char *field,
+                     char *buf, size_t size, uint64_t *count_out) {
+  api_obj_t *obj = &res->payload.list_obj.objects[i];
+  mpack_tree_t tree;
+  mpack_tree_init_data(&tree, obj->data, obj->data_size);
+  mpack_tree_parse(&tree);
+  mpack_node_t root = mpack_tree_root(&tree);
+  mpack_node_copy_cstr(mpack_node_map_cstr(root, field), buf, size);
+  if (count_out) {
+    *count_out = mpack_node_u64(mpack_node_map_cstr(root, "count"));
+  }
+  TEST_ASSERT_EQUAL(mpack_ok, mpack_tree_destroy(&tree));
+}
+
+// Reads an integer field of status object `i`
+static uint64_t _obj_u64(api_response_t *res, uint32_t i, const char *field) {
+  api_obj_t *obj = &res->payload.list_obj.objects[i];
+  mpack_tree_t tree;
+  mpack_tree_init_data(&tree, obj->data, obj->data_size);
+  mpack_tree_parse(&tree);
+  uint64_t value =
+      mpack_node_u64(mpack_node_map_cstr(mpack_tree_root(&tree), field));
+  TEST_ASSERT_EQUAL(mpack_ok, mpack_tree_destroy(&tree));
+  return value;
+}
+
+void test_QUERY_Top_ShouldRankValues(void) {
+  const char *c = "query_top";
+  _safe_remove_db_file(c);
+  _write_event(c, "country:us svc:api");
+  _write_event(c, "country:us svc:web");
+  _write_event(c, "country:us svc:web");
+  _write_event(c, "country:ca svc:api");
+  _write_event(c, "country:ca svc:api");
+  _write_event(c, "country:mx svc:web");
+
+  char value[32];
+  uint64_t count = 0;
+  api_response_t *res = NULL;
+  // TOP scans flushed values only
+  for (int i = 0; i < POLL_RETRIES * 20; i++) {
+    if (res)
+      free_api_response(res);
+    res = run_command("TOP country n:2 in:query_top");
+    if (res && res->is_ok && res->payload.list_obj.count == 2) {
+      uint64_t first = 0;
+      _obj_str(res, 0, "value", value, sizeof(value), &first);
+      _obj_str(res, 1, "value", value, sizeof(value), &count);
+      if (first == 3 && count == 2) {
+        break;
+      }
+    }
+    usleep(POLL_SLEEP_US);
+  }
+  TEST_ASSERT_NOT_NULL(res);
+  TEST_ASSERT_TRUE_MESSAGE(res->is_ok, res->err_msg);
+  TEST_ASSERT_EQUAL_UINT32(2, res->payload.list_obj.count);
+  _obj_str(res, 0, "value", value, sizeof(value), &count);
+  TEST_ASSERT_EQUAL_STRING("us", value);
+  TEST_ASSERT_EQUAL_UINT64(3, count);
+  _obj_str(res, 1, "value", value, sizeof(value), &count);
+  TEST_ASSERT_EQUAL_STRING("ca", value);
+  TEST_ASSERT_EQUAL_UINT64(2, count);
+  free_api_response(res);
+
+  // Ranked by events matching the filter
+  res = run_command("TOP country in:query_top where:(svc:api)");
+  TEST_ASSERT_NOT_NULL(res);
+  TEST_ASSERT_TRUE_MESSAGE(res->is_ok, res->err_msg);
+  TEST_ASSERT_EQUAL_UINT32(2, res->payload.list_obj.count);
+  _obj_str(res, 0, "value", value, sizeof(value), &count);
+  TEST_ASSERT_EQUAL_STRING("ca", value);
+  TEST_ASSERT_EQUAL_UINT64(2, count);
+  free_api_response(res);
+
+  res = NULL;
+  for (int i = 0; i < POLL_RETRIES * 20; i++) {
+    if (res)
+      free_api_response(res);
+    res = run_command("SHOW keys in:query_top");
+    if (res && res->is_ok && res->payload.list_obj.count == 2) {
+      break;
+    }
+    usleep(POLL_SLEEP_US);
+  }
+  TEST_ASSERT_NOT_NULL(res);
+  TEST_ASSERT_TRUE_MESSAGE(res->is_ok, res->err_msg);
+  TEST_ASSERT_EQUAL_UINT32(2, res->payload.list_obj.count);
+  _obj_str(res, 0, "key", value, sizeof(value), NULL);
+  TEST_ASSERT_EQUAL_STRING("country", value);
+  _obj_str(res, 1, "key", value, sizeof(value), NULL);
+  TEST_ASSERT_EQUAL_STRING("svc", value);
+  free_api_response(res);
+}
+
+void test_QUERY_Histogram_ShouldCountBuckets(void) {
+  const char *c = "query_histogram";
+  _safe_remove_db_file(c);
+  // One entity keeps events on one worker, so ids follow timestamps
+  const char *tags[] = {"svc:api", "svc:api", "svc:web",
+                        "svc:api", "svc:api", "svc:api", "svc:api"};
+  const int64_t offsets_ms[] = {0, 500, 1000, 1000, 1200, 1900, 2500};
+  int64_t t0_ns = _get_now_ns();
+  char buf[128];
+  for (int i = 0; i < 7; i++) {
+    snprintf(buf, sizeof(buf), "EVENT in:%s entity:hist_ent %s", c, tags[i]);
+    api_response_t *res = run_command_at(buf, t0_ns + offsets_ms[i] * 1000000);
+    TEST_ASSERT_NOT_NULL(res);
+    TEST_ASSERT_TRUE_MESSAGE(res->is_ok, res->err_msg);
+    free_api_response(res);
+  }
+
+  int64_t t0_ms = t0_ns / 1000000;
+  snprintf(buf, sizeof(buf),
+           "HISTOGRAM in:%s where:(svc:api) bucket:1s from:%ld to:%ld", c,
+           (long)t0_ms, (long)(t0_ms + 3000));
+  const uint64_t expected[] = {2, 3, 1};
+  api_response_t *res = NULL;
+  // Buckets are cut on flushed `ts` index entries
+  for (int i = 0; i < POLL_RETRIES * 20; i++) {
+    if (res)
+      free_api_response(res);
+    res = run_command(buf);
+    if (res && res->is_ok && res->payload.histogram.count == 3 &&
+        memcmp(res->payload.histogram.counts, expected, sizeof(expected)) ==
+            0) {
+      break;
+    }
+    usleep(POLL_SLEEP_US);
+  }
+  TEST_ASSERT_NOT_NULL(res);
+  TEST_ASSERT_TRUE_MESSAGE(res->is_ok, res->err_msg);
+  TEST_ASSERT_EQUAL(API_RESP_TYPE_HISTOGRAM, res->resp_type);
+  TEST_ASSERT_EQUAL_INT64(t0_ms, res->payload.histogram.from);
+  TEST_ASSERT_EQUAL_UINT64(1000, res->payload.histogram.bucket_ms);
+  TEST_ASSERT_EQUAL_UINT32(3, res->payload.histogram.count);
+  TEST_ASSERT_EQUAL_UINT64_ARRAY(expected, res->payload.histogram.counts, 3);
+  free_api_response(res);
+}
+
+void test_QUERY_Funnel_ShouldCountSteps(void) {
+  const char *c = "query_funnel";
+  _safe_remove_db_file(c);
+  // fu1 pays, fu2 stops at the cart, fu3 reaches the cart too late
+  const char *events[] = {"fu1 page:home", "fu2 page:home", "fu3 page:home",
+                          "fu1 page:cart", "fu2 page:cart", "fu1 page:paid",
+                          "fu3 page:cart"};
+  const int64_t offsets_s[] = {0, 0, 0, 60, 90, 120, 3600};
+  int64_t t0_ns = _get_now_ns();
+  char buf[128];
+  for (int i = 0; i < 7; i++) {
+    snprintf(buf, sizeof(buf), "EVENT in:%s entity:%s", c, events[i]);
+    api_response_t *res =
+        run_command_at(buf, t0_ns + offsets_s[i] * 1000000000LL);
+    TEST_ASSERT_NOT_NULL(res);
+    TEST_ASSERT_TRUE_MESSAGE(res->is_ok, res->err_msg);
+    free_api_response(res);
+  }
+
+  const uint64_t expected[] = {3, 2, 1};
+  uint64_t counts[3] = {0};
+  api_response_t *res = NULL;
+  // Funnels read flushed events
+  for (int i = 0; i < POLL_RETRIES * 20; i++) {
+    if (res)
+      free_api_response(res);
+    res = run_command("FUNNEL in:query_funnel steps:(page:home, page:cart, "
+                      "page:paid) within:30m");
+    if (res && res->is_ok && res->payload.list_obj.count == 3) {
+      for (uint32_t s = 0; s < 3; s++) {
+        counts[s] = _obj_u64(res, s, "entities");
+      }
+      if (memcmp(counts, expected, sizeof(expected)) == 0) {
+        break;
+      }
+    }
+    usleep(POLL_SLEEP_US);
+  }
+  TEST_ASSERT_NOT_NULL(res);
+  TEST_ASSERT_TRUE_MESSAGE(res->is_ok, res->err_msg);
+  TEST_ASSERT_EQUAL_UINT32(3, res->payload.list_obj.count);
+  TEST_ASSERT_EQUAL_UINT64_ARRAY(expected, counts, 3);
+  free_api_response(res);
+}
+
+// Polls an ENTITIES command until it counts `expected` entities
+static void _assert_entities_count(const char *cmd, uint64_t expected) {
+  api_response_t *res = NULL;
+  uint64_t count = 0;
+  // Reads flushed `entities` bitmaps
+  for (int i = 0; i < POLL_RETRIES * 20; i++) {
+    if (res)
+      free_api_response(res);
+    res = run_command(cmd);
+    if (res && res->is_ok && res->payload.list_obj.count == 1) {
+      count = _obj_u64(res, 0, "entities");
+      if (count == expected) {
+        break;
+      }
+    }
+    usleep(POLL_SLEEP_US);
+  }
+  TEST_ASSERT_NOT_NULL(res);
+  TEST_ASSERT_TRUE_MESSAGE(res->is_ok, res->err_msg);
+  TEST_ASSERT_EQUAL_UINT32(1, res->payload.list_obj.count);
+  TEST_ASSERT_EQUAL_UINT64(expected, count);
+  free_api_response(res);
+}
+
+void test_QUERY_Entities_ShouldCombineContainers(void) {
+  _safe_remove_db_file("query_ent_d1");
+  _safe_remove_db_file("query_ent_d7");
+  // Seen on day 1: a, b, c. Back on day 7: b (paid) and c
+  const char *events[] = {
+      "query_ent_d1 entity:ent_a page:home",
+      "query_ent_d1 entity:ent_b page:home",
+      "query_ent_d1 entity:ent_c page:home",
+      "query_ent_d7 entity:ent_b plan:paid",
+      "query_ent_d7 entity:ent_c plan:free"};
+  char buf[128];
+  for (int i = 0; i < 5; i++) {
+    snprintf(buf, sizeof(buf), "EVENT in:%s", events[i]);
+    api_response_t *res = run_command(buf);
+    TEST_ASSERT_NOT_NULL(res);
+    TEST_ASSERT_TRUE_MESSAGE(res->is_ok, res->err_msg);
+    free_api_response(res);
+  }
+
+  _assert_entities_count("ENTITIES of:(query_ent_d1 OR query_ent_d7)", 3);
+  _assert_entities_count("ENTITIES of:(query_ent_d1 AND query_ent_d7)", 2);
+  // Churned after day 1
+  _assert_entities_count("ENTITIES of:(query_ent_d1 AND NOT query_ent_d7)",
+                         1);
+
+  api_response_t *res =
+      run_command("CREATE VIEW paid in:query_ent_d7 where:(plan:paid)");
+  TEST_ASSERT_NOT_NULL(res);
+  TEST_ASSERT_TRUE_MESSAGE(res->is_ok, res->err_msg);
+  free_api_response(res);
+  _assert_entities_count("ENTITIES of:(query_ent_d1 AND query_ent_d7:paid)",
+                         1);
+
+  // Listed in pages of entity ids
+  res = run_command("ENTITIES of:(query_ent_d1 AND query_ent_d7:paid) take:5");
+  TEST_ASSERT_NOT_NULL(res);
+  TEST_ASSERT_TRUE_MESSAGE(res->is_ok, res->err_msg);
+  TEST_ASSERT_EQUAL_UINT32(1, res->payload.list_obj.count);
+  _obj_str(res, 0, "entity", buf, sizeof(buf), NULL);
+  TEST_ASSERT_EQUAL_STRING("ent_b", buf);
+  TEST_ASSERT_EQUAL_UINT32(0, res->payload.list_obj.next_cursor);
+  free_api_response(res);
+
+  res = run_command("ENTITIES of:(query_ent_d1) take:2");
+  TEST_ASSERT_NOT_NULL(res);
+  TEST_ASSERT_TRUE_MESSAGE(res->is_ok, res->err_msg);
+  TEST_ASSERT_EQUAL_UINT32(2, res->payload.list_obj.count);
+  uint32_t cursor = res->payload.list_obj.next_cursor;
+  TEST_ASSERT_TRUE(cursor > 0);
+  free_api_response(res);
+  snprintf(buf, sizeof(buf), "ENTITIES of:(query_ent_d1) take:2 cursor:%u",
+           cursor);
+  res = run_command(buf);
+  TEST_ASSERT_NOT_NULL(res);
+  TEST_ASSERT_TRUE_MESSAGE(res->is_ok, res->err_msg);
+  TEST_ASSERT_EQUAL_UINT32(1, res->payload.list_obj.count);
+  TEST_ASSERT_EQUAL_UINT32(0, res->payload.list_obj.next_cursor);
+  free_api_response(res);
+
+  res = run_command("ENTITIES of:(query_ent_d1 AND query_ent_missing)");
+  TEST_ASSERT_NOT_NULL(res);
+  TEST_ASSERT_FALSE(res->is_ok);
+  free_api_response(res);
+}
+
+// Decodes the portable roaring bitmap of an `ids_only` response
+static roaring_bitmap_t *_id_set(api_response_t *res) {
+  TEST_ASSERT_NOT_NULL(res);
+  TEST_ASSERT_TRUE_MESSAGE(res->is_ok, res->err_msg);
+  TEST_ASSERT_EQUAL(API_RESP_TYPE_ID_SET, res->resp_type);
+  roaring_bitmap_t *rb = roaring_bitmap_portable_deserialize_safe(
+      res->payload.id_set.bitmap, res->payload.id_set.bitmap_size);
+  TEST_ASSERT_NOT_NULL(rb);
+  TEST_ASSERT_EQUAL_UINT64(res->payload.id_set.count,
+                           roaring_bitmap_get_cardinality(rb));
+  return rb;
+}
+
+void test_QUERY_IdsOnly_ShouldReturnBitmap(void) {
+  const char *c = "query_ids";
+  _safe_remove_db_file(c);
+  _write_event(c, "svc:api");
+  _write_event(c, "svc:web");
+  _write_event(c, "svc:api");
+  _write_event(c, "svc:api");
+  _assert_query_count(c, "where:(svc:api)", 3);
+
+  api_response_t *res =
+      run_command("QUERY in:query_ids where:(svc:api) ids_only:true");
+  roaring_bitmap_t *all = _id_set(res);
+  TEST_ASSERT_EQUAL_UINT64(3, res->payload.id_set.count);
+  TEST_ASSERT_EQUAL_UINT32(0, res->payload.id_set.next_cursor);
+  free_api_response(res);
+
+  // Pages like event results
+  res = run_command("QUERY in:query_ids where:(svc:api) ids_only:true take:2");
+  roaring_bitmap_t *page = _id_set(res);
+  TEST_ASSERT_EQUAL_UINT64(2, res->payload.id_set.count);
+  TEST_ASSERT_TRUE(roaring_bitmap_is_subset(page, all));
+  TEST_ASSERT_EQUAL_UINT32(roaring_bitmap_maximum(all),
+                           res->payload.id_set.next_cursor);
+  free_api_response(res);
+  roaring_bitmap_free(page);
+  roaring_bitmap_free(all);
+}
+
+// Runs a page of a session query, returns its event count
+static uint32_t _session_page(const char *session, uint32_t cursor,
+                              uint64_t *session_out, uint32_t *next_out) {
+  char cmd[256];
+  int len = snprintf(cmd, sizeof(cmd),
+                     "QUERY in:query_session where:(svc:api) session:%s "
+                     "take:2",
+                     session);
+  if (cursor) {
+    snprintf(cmd + len, sizeof(cmd) - len, " cursor:%u", cursor);
+  }
+  api_response_t *res = run_command(cmd);
+  TEST_ASSERT_NOT_NULL(res);
+  TEST_ASSERT_TRUE_MESSAGE(res->is_ok, res->err_msg);
+  uint32_t count = res->payload.list_obj.count;
+  *session_out = res->payload.list_obj.session;
+  *next_out = res->payload.list_obj.next_cursor;
+  free_api_response(res);
+  return count;
+}
+
+void test_QUERY_Session_ShouldPageKeptResult(void) {
+  const char *c = "query_session";
+  _safe_remove_db_file(c);
+  for (int i = 0; i < 5; i++) {
+    _write_event(c, "svc:api");
+  }
+  _assert_query_count(c, "where:(svc:api)", 5);
+
+  uint64_t session = 0;
+  uint32_t next = 0;
+  TEST_ASSERT_EQUAL_UINT32(2, _session_page("new", 0, &session, &next));
+  TEST_ASSERT_NOT_EQUAL(0, session);
+  TEST_ASSERT_NOT_EQUAL(0, next);
+
+  // Later events are not in the kept result
+  _write_event(c, "svc:api");
+  _assert_query_count(c, "where:(svc:api)", 6);
+
+  char handle[32];
+  snprintf(handle, sizeof(handle), "%llu", (unsigned long long)session);
+  uint64_t later = 0;
+  TEST_ASSERT_EQUAL_UINT32(2, _session_page(handle, next, &later, &next));
+  TEST_ASSERT_EQUAL_UINT64(session, later);
+  // The last page ends the session
+  TEST_ASSERT_EQUAL_UINT32(1, _session_page(handle, next, &later, &next));
+  TEST_ASSERT_EQUAL_UINT64(0, later);
+  TEST_ASSERT_EQUAL_UINT32(0, next);
+
+  // A gone session evaluates again, and keeps a new result
+  TEST_ASSERT_EQUAL_UINT32(2, _session_page(handle, 0, &later, &next));
+  TEST_ASSERT_NOT_EQUAL(0, later);
+  TEST_ASSERT_NOT_EQUAL(session, later);
+}
+
+// Copies the `op` of a plan node
+static void _plan_op(mpack_node_t node, char *buf, size_t size) {
+  mpack_node_copy_cstr(mpack_node_map_cstr(node, "op"), buf, size);
+}
+
+void test_QUERY_ExplainAndProfile_ShouldReturnPlan(void) {
+  const char *c = "query_plan";
+  _safe_remove_db_file(c);
+  _write_event(c, "loc:ca svc:api");
+  _write_event(c, "loc:ca svc:web");
+  _assert_query_count(c, "where:(loc:ca AND svc:api)", 1);
+
+  api_response_t *res = run_command(
+      "EXPLAIN QUERY in:query_plan where:(loc:ca AND NOT svc:web)");
+  TEST_ASSERT_NOT_NULL(res);
+  TEST_ASSERT_TRUE_MESSAGE(res->is_ok, res->err_msg);
+  // Nothing is evaluated
+  TEST_ASSERT_EQUAL_UINT32(0, res->payload.list_obj.count);
+  TEST_ASSERT_FALSE(res->payload.list_obj.profiled);
+  TEST_ASSERT_NOT_NULL(res->payload.list_obj.plan);
+
+  char op[16];
+  mpack_tree_t tree;
+  mpack_tree_init_data(&tree, res->payload.list_obj.plan,
+                       res->payload.list_obj.plan_size);
+  mpack_tree_parse(&tree);
+  mpack_node_t root = mpack_node_map_cstr(mpack_tree_root(&tree), "root");
+  _plan_op(root, op, sizeof(op));
+  TEST_ASSERT_EQUAL_STRING("and", op);
+  mpack_node_t children = mpack_node_map_cstr(root, "children");
+  TEST_ASSERT_EQUAL_UINT32(2, mpack_node_array_length(children));
+  _plan_op(mpack_node_array_at(children, 1), op, sizeof(op));
+  TEST_ASSERT_EQUAL_STRING("andnot", op);
+  TEST_ASSERT_EQUAL(mpack_ok, mpack_tree_destroy(&tree));
+  free_api_response(res);
+
+  res = run_command("PROFILE QUERY in:query_plan where:(loc:ca AND svc:api)");
+  TEST_ASSERT_NOT_NULL(res);
+  TEST_ASSERT_TRUE_MESSAGE(res->is_ok, res->err_msg);
+  // Profiled queries still return their results
+  TEST_ASSERT_EQUAL_UINT32(1, res->payload.list_obj.count);
+  TEST_ASSERT_TRUE(res->payload.list_obj.profiled);
+
+  mpack_tree_init_data(&tree, res->payload.list_obj.plan,
+                       res->payload.list_obj.plan_size);
+  mpack_tree_parse(&tree);
+  mpack_node_t plan = mpack_tree_root(&tree);
+  TEST_ASSERT_TRUE(mpack_node_u64(mpack_node_map_cstr(plan, "eval_ns")) > 0);
+  TEST_ASSERT_TRUE(mpack_node_map_contains_cstr(plan, "fetch_ns"));
+  root = mpack_node_map_cstr(plan, "root");
+  TEST_ASSERT_EQUAL_UINT64(1,
+                           mpack_node_u64(mpack_node_map_cstr(root, "card")));
+  mpack_node_t leaf =
+      mpack_node_array_at(mpack_node_map_cstr(root, "children"), 0);
+  mpack_node_t reads = mpack_node_map_cstr(leaf, "reads");
+  uint64_t total = 0;
+  const char *sources[] = {"local_cache", "consumer_cache", "read_cache",
+                           "lmdb"};
+  for (size_t i = 0; i < 4; i++) {
+    total += mpack_node_u32(mpack_node_map_cstr(reads, sources[i]));
+  }
+  TEST_ASSERT_EQUAL_UINT64(1, total);
+  TEST_ASSERT_EQUAL(mpack_ok, mpack_tree_destroy(&tree));
+  free_api_response(res);
+}
+
+void test_QUERY_Rollup_ShouldCountPerBucket(void) {
+  const char *c = "query_rollup";
+  _safe_remove_db_file(c);
+  char buf[160];
+  snprintf(buf, sizeof(buf),
+           "CREATE ROLLUP in:%s by:(action,country) bucket:1s", c);
+  api_response_t *res = run_command(buf);
+  TEST_ASSERT_NOT_NULL(res);
+  TEST_ASSERT_TRUE_MESSAGE(res->is_ok, res->err_msg);
+  free_api_response(res);
+  res = run_command(buf);
+  TEST_ASSERT_NOT_NULL(res);
+  TEST_ASSERT_FALSE(res->is_ok);
+  TEST_ASSERT_EQUAL_STRING("Duplicate rollup", res->err_msg);
+  free_api_response(res);
+
+  // Start on a 2s boundary so reads cut the events into known buckets
+  int64_t now_ms = _get_now_ns() / 1000000;
+  int64_t t0_ms = now_ms - now_ms % 2000;
+  const char *tags[] = {"action:buy country:us", "action:buy country:us",
+                        "action:browse country:us", "action:buy country:us",
+                        "action:buy"};
+  const int64_t offsets_ms[] = {0, 500, 1200, 2100, 2200};
+  for (int i = 0; i < 5; i++) {
+    _write_event_at(c, tags[i], (t0_ms + offsets_ms[i]) * 1000000);
+  }
+
+  // Counts show up once the consumer flushed them
+  snprintf(buf, sizeof(buf),
+           "ROLLUP in:%s by:(action,country) bucket:2s from:%ld to:%ld", c,
+           (long)t0_ms, (long)(t0_ms + 4000));
+  res = NULL;
+  for (int i = 0; i < POLL_RETRIES * 20; i++) {
+    if (res)
+      free_api_response(res);
+    res = run_command(buf);
+    // Deltas of one bucket may be flushed apart, wait for all 4 events
+    uint64_t total = 0;
+    for (uint32_t j = 0; res && res->is_ok && j < res->payload.list_obj.count;
+         j++) {
+      total += _obj_u64(res, j, "count");
+    }
+    if (total == 4) {
+      break;
+    }
+    usleep(POLL_SLEEP_US);
+  }
+  _assert_count_val(res, 3);
+  // Event without `country` is not counted
+  const uint64_t buckets[] = {(uint64_t)t0_ms, (uint64_t)t0_ms,
+                              (uint64_t)t0_ms + 2000};
+  const char *actions[] = {"browse", "buy", "buy"};
+  const uint64_t counts[] = {1, 2, 1};
+  for (uint32_t i = 0; i < 3; i++) {
+    char value[16];
+    uint64_t count;
+    _obj_str(res, i, "action", value, sizeof(value), &count);
+    TEST_ASSERT_EQUAL_STRING(actions[i], value);
+    TEST_ASSERT_EQUAL_UINT64(counts[i], count);
+    TEST_ASSERT_EQUAL_UINT64(buckets[i], _obj_u64(res, i, "bucket"));
+    _obj_str(res, i, "country", value, sizeof(value), NULL);
+    TEST_ASSERT_EQUAL_STRING("us", value);
+  }
+  free_api_response(res);
+
+  // Reads need the same keys and a bucket the rollup's bucket divides
+  snprintf(buf, sizeof(buf),
+           "ROLLUP in:%s by:(action) bucket:2s from:%ld to:%ld", c,
+           (long)t0_ms, (long)(t0_ms + 4000));
+  res = run_command(buf);
+  TEST_ASSERT_NOT_NULL(res);
+  TEST_ASSERT_FALSE(res->is_ok);
+  free_api_response(res);
+  snprintf(buf, sizeof(buf),
+           "ROLLUP in:%s by:(action,country) bucket:1500 from:%ld to:%ld", c,
+           (long)t0_ms, (long)(t0_ms + 4000));
+  res = run_command(buf);
+  TEST_ASSERT_NOT_NULL(res);
+  TEST_ASSERT_FALSE(res->is_ok);
+  free_api_response(res);
+}
+
+void test_QUERY_Scan_ShouldMatchUnindexedKeys(void) {
+  const char *c = "query_scan";
+  _safe_remove_db_file(c);
+  _write_event(c, "loc:ca scan_page:checkout-pay scan_qty:5");
+  _write_event(c, "loc:ca scan_page:home scan_qty:50");
+  _write_event(c, "loc:ny scan_page:checkout scan_qty:500");
+  _write_event(c, "loc:ny scan_page:search");
+
+  _assert_query_count(c, "where:(scan_page ~ checkout)", 2);
+  _assert_query_count(c, "where:(scan_page = home)", 1);
+  _assert_query_count(c, "where:(scan_qty > 10)", 2);
+  // Events without the key never match
+  _assert_query_count(c, "where:(scan_qty != 5)", 2);
+  _assert_query_count(c, "where:(loc:ca AND scan_qty > 1 AND scan_qty < 100)",
+                      2);
+  _assert_query_count(c, "where:(loc:ny AND NOT (scan_page ~ check))", 1);
+
+  api_response_t *res = run_command(
+      "EXPLAIN QUERY in:query_scan where:(scan_page ~ pay AND loc:ca)");
+  TEST_ASSERT_NOT_NULL(res);
+  TEST_ASSERT_TRUE_MESSAGE(res->is_ok, res->err_msg);
+  char access[16];
+  mpack_tree_t tree;
+  mpack_tree_init_data(&tree, res->payload.list_obj.plan,
+                       res->payload.list_obj.plan_size);
+  mpack_tree_parse(&tree);
+  mpack_node_t root = mpack_node_map_cstr(mpack_tree_root(&tree), "root");
+  // Scans run after the tags narrowed the events
+  mpack_node_t scan =
+      mpack_node_array_at(mpack_node_map_cstr(root, "children"), 1);
+  mpack_node_copy_cstr(mpack_node_map_cstr(scan, "access"), access,
+                       sizeof(access));
+  TEST_ASSERT_EQUAL_STRING("scan", access);
+  TEST_ASSERT_EQUAL(mpack_ok, mpack_tree_destroy(&tree));
+  free_api_response(res);
+}
+
 int main(void) {
   suiteSetUp();
 
@@ -524,6 +1413,24 @@ int main(void) {
   RUN_TEST(test_QUERY_Take_ShouldLimitResults);
   RUN_TEST(test_QUERY_TsRange_ShouldFilterByTime);
   RUN_TEST(test_QUERY_ComplexTsLogic_ShouldFilterCorrectly);
+  RUN_TEST(test_QUERY_EntityTimeline_ShouldReturnEntityEvents);
+  RUN_TEST(test_QUERY_Fields_ShouldProjectTags);
+  RUN_TEST(test_QUERY_Timeout_ShouldBeAccepted);
+  RUN_TEST(test_QUERY_After_ShouldSeeAckedEvents);
+  RUN_TEST(test_QUERY_Sample_ShouldEstimateCount);
+  RUN_TEST(test_QUERY_View_ShouldBackfillAndMaintain);
+  RUN_TEST(test_QUERY_DecimalAndStringRanges_ShouldUseIndexes);
+  RUN_TEST(test_QUERY_Bsi_ShouldCompareAndAggregate);
+  RUN_TEST(test_QUERY_ShowStats_ShouldCountTags);
+  RUN_TEST(test_QUERY_ExplainAndProfile_ShouldReturnPlan);
+  RUN_TEST(test_QUERY_Scan_ShouldMatchUnindexedKeys);
+  RUN_TEST(test_QUERY_Top_ShouldRankValues);
+  RUN_TEST(test_QUERY_Histogram_ShouldCountBuckets);
+  RUN_TEST(test_QUERY_Rollup_ShouldCountPerBucket);
+  RUN_TEST(test_QUERY_Funnel_ShouldCountSteps);
+  RUN_TEST(test_QUERY_Entities_ShouldCombineContainers);
+  RUN_TEST(test_QUERY_IdsOnly_ShouldReturnBitmap);
+  RUN_TEST(test_QUERY_Session_ShouldPageKeptResult);
 
   int result = UNITY_END();
   usleep(100000);
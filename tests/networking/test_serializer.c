@@ -128,6 +128,7 @@ void test_SerializerEncodeErr_ShouldWrapMessage(void) {
 void test_ApiResp_Ack_ShouldProduceSimpleOk(void) {
   // Arrange
   api_response_t resp;
+  memset(&resp, 0, sizeof(resp));
   resp.is_ok = true;
   resp.resp_type = API_RESP_TYPE_ACK;
 
@@ -140,6 +141,30 @@ void test_ApiResp_Ack_ShouldProduceSimpleOk(void) {
   assert_msgpack_is_ack(sr.response, sr.response_size);
 }
 
+void test_ApiResp_Ack_WithWatermark_ShouldWriteEventId(void) {
+  api_response_t resp;
+  memset(&resp, 0, sizeof(resp));
+  resp.is_ok = true;
+  resp.resp_type = API_RESP_TYPE_ACK;
+  resp.payload.watermark.container_name = "mydb";
+  resp.payload.watermark.event_id = 42;
+
+  serializer_encode_api_resp(&resp, &sr);
+
+  TEST_ASSERT_TRUE(sr.success);
+  assert_msgpack_is_ack(sr.response, sr.response_size);
+  mpack_tree_t tree;
+  mpack_tree_init_data(&tree, sr.response, sr.response_size);
+  mpack_tree_parse(&tree);
+  mpack_node_t data = mpack_node_map_cstr(mpack_tree_root(&tree), "data");
+  char *in = mpack_node_cstr_alloc(mpack_node_map_cstr(data, "in"), 16);
+  TEST_ASSERT_EQUAL_STRING("mydb", in);
+  free(in);
+  TEST_ASSERT_EQUAL_UINT32(
+      42, mpack_node_u32(mpack_node_map_cstr(data, "event_id")));
+  TEST_ASSERT_TRUE(mpack_tree_destroy(&tree) == mpack_ok);
+}
+
 // 3. Test API Response: List of U32
 void test_ApiResp_ListU32_ShouldStitchNestedData(void) {
   // Arrange
@@ -187,6 +212,154 @@ void test_ApiResp_ListU32_EmptyList_ShouldReturnEmptyArray(void) {
   mpack_tree_destroy(&tree);
 }
 
+void test_ApiResp_Histogram_ShouldWriteCounts(void) {
+  uint64_t counts[] = {3, 0, 7};
+  api_response_t resp;
+  memset(&resp, 0, sizeof(resp));
+  resp.is_ok = true;
+  resp.resp_type = API_RESP_TYPE_HISTOGRAM;
+  resp.payload.histogram.from = 60000;
+  resp.payload.histogram.bucket_ms = 1000;
+  resp.payload.histogram.counts = counts;
+  resp.payload.histogram.count = 3;
+
+  serializer_encode_api_resp(&resp, &sr);
+  TEST_ASSERT_TRUE(sr.success);
+
+  mpack_tree_t tree;
+  mpack_tree_init_data(&tree, sr.response, sr.response_size);
+  mpack_tree_parse(&tree);
+  mpack_node_t data = mpack_node_map_cstr(mpack_tree_root(&tree), "data");
+  TEST_ASSERT_EQUAL_INT64(60000,
+                          mpack_node_i64(mpack_node_map_cstr(data, "from")));
+  TEST_ASSERT_EQUAL_UINT64(
+      1000, mpack_node_u64(mpack_node_map_cstr(data, "bucket_ms")));
+  mpack_node_t arr = mpack_node_map_cstr(data, "counts");
+  TEST_ASSERT_EQUAL_UINT32(3, mpack_node_array_length(arr));
+  for (uint32_t i = 0; i < 3; i++) {
+    TEST_ASSERT_EQUAL_UINT64(counts[i],
+                             mpack_node_u64(mpack_node_array_at(arr, i)));
+  }
+  TEST_ASSERT_EQUAL(mpack_ok, mpack_tree_destroy(&tree));
+}
+
+void test_ApiResp_IdSet_ShouldWriteBitmapBytes(void) {
+  char bitmap[] = {0x3a, 0x30, 0x00, 0x00, 0x01};
+  api_response_t resp;
+  memset(&resp, 0, sizeof(resp));
+  resp.is_ok = true;
+  resp.resp_type = API_RESP_TYPE_ID_SET;
+  resp.payload.id_set.bitmap = bitmap;
+  resp.payload.id_set.bitmap_size = sizeof(bitmap);
+  resp.payload.id_set.count = 12;
+  resp.payload.id_set.next_cursor = 40;
+
+  serializer_encode_api_resp(&resp, &sr);
+  TEST_ASSERT_TRUE(sr.success);
+
+  mpack_tree_t tree;
+  mpack_tree_init_data(&tree, sr.response, sr.response_size);
+  mpack_tree_parse(&tree);
+  mpack_node_t data = mpack_node_map_cstr(mpack_tree_root(&tree), "data");
+  TEST_ASSERT_EQUAL_UINT64(12,
+                           mpack_node_u64(mpack_node_map_cstr(data, "count")));
+  TEST_ASSERT_EQUAL_UINT32(
+      40, mpack_node_u32(mpack_node_map_cstr(data, "next_cursor")));
+  mpack_node_t ids = mpack_node_map_cstr(data, "ids");
+  TEST_ASSERT_EQUAL(mpack_type_bin, mpack_node_type(ids));
+  TEST_ASSERT_EQUAL_UINT32(sizeof(bitmap), mpack_node_bin_size(ids));
+  TEST_ASSERT_EQUAL_MEMORY(bitmap, mpack_node_bin_data(ids), sizeof(bitmap));
+  TEST_ASSERT_EQUAL(mpack_ok, mpack_tree_destroy(&tree));
+}
+
+void test_ApiResp_ListObj_WithAgg_ShouldWriteAggMap(void) {
+  api_response_t resp;
+  memset(&resp, 0, sizeof(resp));
+  resp.is_ok = true;
+  resp.resp_type = API_RESP_TYPE_LIST_OBJ;
+  resp.payload.list_obj.has_agg = true;
+  resp.payload.list_obj.agg_count = 3;
+  resp.payload.list_obj.agg_sum = 60;
+  resp.payload.list_obj.agg_min = 5;
+  resp.payload.list_obj.agg_max = 40;
+
+  serializer_encode_api_resp(&resp, &sr);
+  TEST_ASSERT_TRUE(sr.success);
+
+  mpack_tree_t tree;
+  mpack_tree_init_data(&tree, sr.response, sr.response_size);
+  mpack_tree_parse(&tree);
+  mpack_node_t data = mpack_node_map_cstr(mpack_tree_root(&tree), "data");
+  mpack_node_t agg = mpack_node_map_cstr(data, "agg");
+  TEST_ASSERT_EQUAL_UINT64(3,
+                           mpack_node_u64(mpack_node_map_cstr(agg, "count")));
+  TEST_ASSERT_EQUAL_UINT64(60,
+                           mpack_node_u64(mpack_node_map_cstr(agg, "sum")));
+  TEST_ASSERT_EQUAL_UINT64(5,
+                           mpack_node_u64(mpack_node_map_cstr(agg, "min")));
+  TEST_ASSERT_EQUAL_UINT64(40,
+                           mpack_node_u64(mpack_node_map_cstr(agg, "max")));
+  TEST_ASSERT_EQUAL_UINT32(
+      0, mpack_node_array_length(mpack_node_map_cstr(data, "objects")));
+  TEST_ASSERT_TRUE(mpack_tree_destroy(&tree) == mpack_ok);
+}
+
+void test_ApiResp_ListObj_WithSession_ShouldWriteHandle(void) {
+  api_response_t resp;
+  memset(&resp, 0, sizeof(resp));
+  resp.is_ok = true;
+  resp.resp_type = API_RESP_TYPE_LIST_OBJ;
+  resp.payload.list_obj.next_cursor = 11;
+  resp.payload.list_obj.session = 0x1234567890ULL;
+
+  serializer_encode_api_resp(&resp, &sr);
+  TEST_ASSERT_TRUE(sr.success);
+
+  mpack_tree_t tree;
+  mpack_tree_init_data(&tree, sr.response, sr.response_size);
+  mpack_tree_parse(&tree);
+  mpack_node_t data = mpack_node_map_cstr(mpack_tree_root(&tree), "data");
+  TEST_ASSERT_EQUAL_UINT64(
+      0x1234567890ULL, mpack_node_u64(mpack_node_map_cstr(data, "session")));
+  TEST_ASSERT_EQUAL_UINT32(
+      11, mpack_node_u32(mpack_node_map_cstr(data, "next_cursor")));
+  TEST_ASSERT_EQUAL(mpack_ok, mpack_tree_destroy(&tree));
+}
+
+void test_ApiResp_ListObj_WithPlan_ShouldWritePlanAndTiming(void) {
+  char *plan = NULL;
+  size_t plan_size = 0;
+  mpack_writer_t writer;
+  mpack_writer_init_growable(&writer, &plan, &plan_size);
+  mpack_start_map(&writer, 1);
+  mpack_write_cstr(&writer, "truncated");
+  mpack_write_bool(&writer, false);
+  mpack_finish_map(&writer);
+  TEST_ASSERT_EQUAL(mpack_ok, mpack_writer_destroy(&writer));
+
+  api_response_t resp;
+  memset(&resp, 0, sizeof(resp));
+  resp.is_ok = true;
+  resp.resp_type = API_RESP_TYPE_LIST_OBJ;
+  resp.payload.list_obj.plan = plan;
+  resp.payload.list_obj.plan_size = plan_size;
+  resp.payload.list_obj.profiled = true;
+
+  serializer_encode_api_resp(&resp, &sr);
+  TEST_ASSERT_TRUE(sr.success);
+
+  mpack_tree_t tree;
+  mpack_tree_init_data(&tree, sr.response, sr.response_size);
+  mpack_tree_parse(&tree);
+  mpack_node_t data = mpack_node_map_cstr(mpack_tree_root(&tree), "data");
+  mpack_node_t plan_node = mpack_node_map_cstr(data, "plan");
+  TEST_ASSERT_FALSE(
+      mpack_node_bool(mpack_node_map_cstr(plan_node, "truncated")));
+  TEST_ASSERT_TRUE(mpack_node_map_contains_cstr(data, "serialize_ns"));
+  TEST_ASSERT_TRUE(mpack_tree_destroy(&tree) == mpack_ok);
+  free(plan);
+}
+
 // 4. Test API Response: Errors (Logic Check)
 void test_ApiResp_Error_ShouldSetStructError_NotGenerateBytes(void) {
   // Note: based on your current implementation of serializer_encode_api_resp,
@@ -223,8 +396,14 @@ int main(void) {
   RUN_TEST(test_SerializerEncode_StatusOnly_ShouldReturnStatusMap);
   RUN_TEST(test_SerializerEncodeErr_ShouldWrapMessage);
   RUN_TEST(test_ApiResp_Ack_ShouldProduceSimpleOk);
+  RUN_TEST(test_ApiResp_Ack_WithWatermark_ShouldWriteEventId);
   RUN_TEST(test_ApiResp_ListU32_ShouldStitchNestedData);
   RUN_TEST(test_ApiResp_ListU32_EmptyList_ShouldReturnEmptyArray);
+  RUN_TEST(test_ApiResp_Histogram_ShouldWriteCounts);
+  RUN_TEST(test_ApiResp_IdSet_ShouldWriteBitmapBytes);
+  RUN_TEST(test_ApiResp_ListObj_WithAgg_ShouldWriteAggMap);
+  RUN_TEST(test_ApiResp_ListObj_WithSession_ShouldWriteHandle);
+  RUN_TEST(test_ApiResp_ListObj_WithPlan_ShouldWritePlanAndTiming);
   RUN_TEST(test_ApiResp_Error_ShouldSetStructError_NotGenerateBytes);
   RUN_TEST(test_ApiResp_InvalidInput_ShouldFailGracefully);
 
@@ -310,6 +310,29 @@ void test_where_single_tag(void) {
   parse_free_result(result);
 }
 
+void test_where_entity_tag(void) {
+  parse_result_t *result =
+      _parse_string("query in:test_c where:(entity:user123 AND loc:ca)");
+  _assert_success(result);
+
+  ast_node_t *where = _find_tag_by_key(result->ast, AST_KW_WHERE)->tag.value;
+  TEST_ASSERT_EQUAL(AST_LOGICAL_NODE, where->type);
+  ast_node_t *ent = where->logical.left_operand;
+  // `entity` inside an expression is a reserved tag node
+  TEST_ASSERT_EQUAL(AST_TAG_NODE, ent->type);
+  TEST_ASSERT_EQUAL(AST_TAG_KEY_RESERVED, ent->tag.key_type);
+  TEST_ASSERT_EQUAL(AST_KW_ENTITY, ent->tag.reserved_key);
+  TEST_ASSERT_EQUAL_STRING("user123", ent->tag.value->literal.string_value);
+
+  parse_free_result(result);
+}
+
+void test_where_entity_without_value_fails(void) {
+  parse_result_t *result = _parse_string("query in:test_c where:(entity)");
+  TEST_ASSERT_FALSE(result->success);
+  parse_free_result(result);
+}
+
 void test_where_quotes(void) {
   parse_result_t *result = _parse_string("query in:test_c where:(loc:\"ca\")");
   _assert_success(result);
@@ -385,6 +408,57 @@ void test_where_comparison2(void) {
   parse_free_result(result);
 }
 
+void test_where_comparison_decimal_and_string(void) {
+  parse_result_t *result = _parse_string(
+      "QUERY in:orders where:(amount >= 9.99 AND region < \"us-west\")");
+  _assert_success(result);
+
+  ast_node_t *where = _find_tag_by_key(result->ast, AST_KW_WHERE)->tag.value;
+  ast_node_t *left = where->logical.left_operand;
+  TEST_ASSERT_EQUAL(AST_COMPARISON_NODE, left->type);
+  TEST_ASSERT_EQUAL(AST_LITERAL_FLOAT, left->comparison.right->literal.type);
+  TEST_ASSERT_TRUE(left->comparison.right->literal.float_value == 9.99);
+  TEST_ASSERT_EQUAL_STRING("9.99",
+                           left->comparison.right->literal.string_value);
+
+  ast_node_t *right = where->logical.right_operand;
+  TEST_ASSERT_EQUAL(AST_COMPARISON_NODE, right->type);
+  TEST_ASSERT_EQUAL(AST_LITERAL_STRING, right->comparison.right->literal.type);
+  TEST_ASSERT_EQUAL_STRING("us-west",
+                           right->comparison.right->literal.string_value);
+
+  parse_free_result(result);
+}
+
+void test_where_contains(void) {
+  parse_result_t *result =
+      _parse_string("QUERY in:web where:(path ~ checkout AND ts > 5)");
+  _assert_success(result);
+
+  ast_node_t *where = _find_tag_by_key(result->ast, AST_KW_WHERE)->tag.value;
+  ast_node_t *left = where->logical.left_operand;
+  TEST_ASSERT_EQUAL(AST_COMPARISON_NODE, left->type);
+  TEST_ASSERT_EQUAL(AST_OP_CONTAINS, left->comparison.op);
+  TEST_ASSERT_EQUAL_STRING("path", left->comparison.left->literal.string_value);
+  TEST_ASSERT_EQUAL_STRING("checkout",
+                           left->comparison.right->literal.string_value);
+
+  parse_free_result(result);
+}
+
+void test_event_decimal_tag_value(void) {
+  parse_result_t *result =
+      _parse_string("event in:orders entity:u1 amount:99.99");
+  _assert_success(result);
+
+  ast_node_t *tag = _find_tag_by_custom_key(result->ast, "amount");
+  TEST_ASSERT_NOT_NULL(tag);
+  TEST_ASSERT_EQUAL(AST_LITERAL_FLOAT, tag->tag.value->literal.type);
+  TEST_ASSERT_EQUAL_STRING("99.99", tag->tag.value->literal.string_value);
+
+  parse_free_result(result);
+}
+
 void test_where_comparison_tag(void) {
   // semantically invalid because of `action:login > 3` but grammatically valid
   parse_result_t *result = _parse_string(
@@ -484,6 +558,223 @@ void test_parser_fails_on_no_where_value4(void) {
   parse_free_result(result);
 }
 
+void test_query_fields_success(void) {
+  parse_result_t *result =
+      _parse_string("query in:metrics fields:(color, \"page path\", entity)");
+  _assert_success(result);
+
+  ast_node_t *fields_tag = _find_tag_by_key(result->ast, AST_KW_FIELDS);
+  TEST_ASSERT_NOT_NULL(fields_tag);
+  ast_node_t *f = fields_tag->tag.value;
+  TEST_ASSERT_EQUAL_STRING("color", f->literal.string_value);
+  f = f->next;
+  TEST_ASSERT_EQUAL_STRING("page path", f->literal.string_value);
+  f = f->next;
+  TEST_ASSERT_EQUAL_STRING("entity", f->literal.string_value);
+  TEST_ASSERT_NULL(f->next);
+
+  parse_free_result(result);
+}
+
+void test_query_fields_fails_on_bad_list(void) {
+  const char *inputs[] = {
+      "query in:metrics fields:()",      "query in:metrics fields:(a,)",
+      "query in:metrics fields:(a b)",   "query in:metrics fields:(a,",
+      "query in:metrics fields:color",   "query in:metrics fields:(a,,b)",
+  };
+  for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+    parse_result_t *result = _parse_string(inputs[i]);
+    _assert_error(result);
+    parse_free_result(result);
+  }
+}
+
+void test_create_view_success(void) {
+  parse_result_t *result =
+      _parse_string("create view errors in:metrics where:(status:error)");
+  _assert_success(result);
+  TEST_ASSERT_EQUAL(AST_CMD_CREATE_VIEW, result->ast->command.type);
+
+  ast_node_t *view_tag = _find_tag_by_key(result->ast, AST_KW_VIEW);
+  TEST_ASSERT_NOT_NULL(view_tag);
+  TEST_ASSERT_EQUAL_STRING("errors", view_tag->tag.value->literal.string_value);
+  TEST_ASSERT_NOT_NULL(_find_tag_by_key(result->ast, AST_KW_IN));
+  TEST_ASSERT_NOT_NULL(_find_tag_by_key(result->ast, AST_KW_WHERE));
+
+  parse_free_result(result);
+}
+
+void test_subscribe_success(void) {
+  parse_result_t *result =
+      _parse_string("subscribe in:metrics where:(status:error)");
+  _assert_success(result);
+  TEST_ASSERT_EQUAL(AST_CMD_SUBSCRIBE, result->ast->command.type);
+  TEST_ASSERT_NOT_NULL(_find_tag_by_key(result->ast, AST_KW_IN));
+  TEST_ASSERT_NOT_NULL(_find_tag_by_key(result->ast, AST_KW_WHERE));
+  parse_free_result(result);
+}
+
+void test_create_view_fails_without_name(void) {
+  const char *inputs[] = {
+      "create in:metrics where:(a:1)",
+      "create view",
+      "create view (a:1)",
+  };
+  for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+    parse_result_t *result = _parse_string(inputs[i]);
+    _assert_error(result);
+    parse_free_result(result);
+  }
+}
+
+void test_show_success(void) {
+  parse_result_t *result = _parse_string("show backfills");
+  _assert_success(result);
+  TEST_ASSERT_EQUAL(AST_CMD_SHOW, result->ast->command.type);
+  ast_node_t *target = _find_tag_by_key(result->ast, AST_KW_TARGET);
+  TEST_ASSERT_NOT_NULL(target);
+  TEST_ASSERT_EQUAL_STRING("backfills",
+                           target->tag.value->literal.string_value);
+  parse_free_result(result);
+}
+
+void test_show_fails_without_target(void) {
+  const char *inputs[] = {"show", "show in:metrics", "show 5"};
+  for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+    parse_result_t *result = _parse_string(inputs[i]);
+    _assert_error(result);
+    parse_free_result(result);
+  }
+}
+
+void test_explain_and_profile_prefix_query(void) {
+  const char *inputs[] = {"explain query in:metrics where:(loc:ca)",
+                          "profile query in:metrics where:(loc:ca)"};
+  const char *modes[] = {"explain", "profile"};
+  for (size_t i = 0; i < 2; i++) {
+    parse_result_t *result = _parse_string(inputs[i]);
+    _assert_success(result);
+    TEST_ASSERT_EQUAL(AST_CMD_QUERY, result->ast->command.type);
+    ast_node_t *plan = _find_tag_by_key(result->ast, AST_KW_PLAN);
+    TEST_ASSERT_NOT_NULL(plan);
+    TEST_ASSERT_EQUAL_STRING(modes[i], plan->tag.value->literal.string_value);
+    parse_free_result(result);
+  }
+
+  parse_result_t *result = _parse_string("explain show backfills");
+  _assert_error(result);
+  parse_free_result(result);
+}
+
+void test_top_key_lead_tag(void) {
+  parse_result_t *result =
+      _parse_string("top country n:5 in:metrics where:(loc:ca)");
+  _assert_success(result);
+  TEST_ASSERT_EQUAL(AST_CMD_TOP, result->ast->command.type);
+  ast_node_t *key = _find_tag_by_key(result->ast, AST_KW_KEY);
+  TEST_ASSERT_NOT_NULL(key);
+  TEST_ASSERT_EQUAL_STRING("country", key->tag.value->literal.string_value);
+  parse_free_result(result);
+
+  result = _parse_string("top in:metrics");
+  _assert_error(result);
+  parse_free_result(result);
+}
+
+void test_histogram_command(void) {
+  parse_result_t *result = _parse_string(
+      "histogram in:metrics where:(loc:ca) bucket:1m from:0 to:60000");
+  _assert_success(result);
+  TEST_ASSERT_EQUAL(AST_CMD_HISTOGRAM, result->ast->command.type);
+  ast_node_t *bucket = ast_find_custom_tag(&result->ast->command, "bucket");
+  TEST_ASSERT_NOT_NULL(bucket);
+  TEST_ASSERT_EQUAL_STRING("1m", bucket->tag.value->literal.string_value);
+  parse_free_result(result);
+}
+
+void test_funnel_step_list(void) {
+  parse_result_t *result = _parse_string(
+      "funnel in:shop steps:(page:home, (page:cart AND NOT coupon:yes), "
+      "page:paid) within:30m");
+  _assert_success(result);
+  TEST_ASSERT_EQUAL(AST_CMD_FUNNEL, result->ast->command.type);
+  ast_node_t *steps = _find_tag_by_key(result->ast, AST_KW_STEPS);
+  TEST_ASSERT_NOT_NULL(steps);
+  ast_node_t *step = steps->tag.value;
+  TEST_ASSERT_EQUAL(AST_TAG_NODE, step->type);
+  TEST_ASSERT_EQUAL_STRING("page", step->tag.custom_key);
+  step = step->next;
+  TEST_ASSERT_EQUAL(AST_LOGICAL_NODE, step->type);
+  step = step->next;
+  TEST_ASSERT_EQUAL_STRING("paid", step->tag.value->literal.string_value);
+  TEST_ASSERT_NULL(step->next);
+  parse_free_result(result);
+
+  const char *bad[] = {"funnel in:shop steps:(page:home, ) within:1m",
+                       "funnel in:shop steps:(page:home page:cart) within:1m",
+                       "funnel in:shop steps:(page:home, page:cart"};
+  for (int i = 0; i < 3; i++) {
+    result = _parse_string(bad[i]);
+    _assert_error(result);
+    parse_free_result(result);
+  }
+}
+
+void test_entities_set_expression(void) {
+  parse_result_t *result = _parse_string(
+      "entities of:(day1 AND day7:signups AND NOT day8) take:10");
+  _assert_success(result);
+  TEST_ASSERT_EQUAL(AST_CMD_ENTITIES, result->ast->command.type);
+  ast_node_t *of = _find_tag_by_key(result->ast, AST_KW_OF);
+  TEST_ASSERT_NOT_NULL(of);
+  // ((day1 AND day7:signups) AND NOT day8)
+  ast_node_t *exp = of->tag.value;
+  TEST_ASSERT_EQUAL(AST_LOGICAL_NODE, exp->type);
+  TEST_ASSERT_EQUAL(AST_NOT_NODE, exp->logical.right_operand->type);
+  ast_node_t *view = exp->logical.left_operand->logical.right_operand;
+  TEST_ASSERT_EQUAL(AST_TAG_NODE, view->type);
+  TEST_ASSERT_EQUAL_STRING("day7", view->tag.custom_key);
+  TEST_ASSERT_EQUAL_STRING("signups", view->tag.value->literal.string_value);
+  parse_free_result(result);
+
+  result = _parse_string("entities of:day1");
+  _assert_error(result);
+  parse_free_result(result);
+}
+
+void test_rollup_commands(void) {
+  parse_result_t *result =
+      _parse_string("CREATE ROLLUP in:shop by:(action,country) bucket:1m");
+  _assert_success(result);
+  TEST_ASSERT_EQUAL(AST_CMD_CREATE_ROLLUP, result->ast->command.type);
+  ast_node_t *by = _find_tag_by_key(result->ast, AST_KW_BY);
+  TEST_ASSERT_NOT_NULL(by);
+  TEST_ASSERT_EQUAL_STRING("action", by->tag.value->literal.string_value);
+  TEST_ASSERT_EQUAL_STRING("country",
+                           by->tag.value->next->literal.string_value);
+  TEST_ASSERT_NULL(by->tag.value->next->next);
+  parse_free_result(result);
+
+  result = _parse_string(
+      "rollup in:shop by:(action) bucket:1h from:1000 to:2000");
+  _assert_success(result);
+  TEST_ASSERT_EQUAL(AST_CMD_ROLLUP, result->ast->command.type);
+  TEST_ASSERT_NOT_NULL(_find_tag_by_key(result->ast, AST_KW_BY));
+  parse_free_result(result);
+
+  // `by` takes a parenthesized list
+  result = _parse_string("rollup in:shop by:action bucket:1h");
+  _assert_error(result);
+  parse_free_result(result);
+}
+
+void test_where_view_tag(void) {
+  parse_result_t *result =
+      _parse_string("query in:metrics where:(view:errors AND loc:ca)");
+  _assert_success(result);
+  parse_free_result(result);
+}
+
 int main(void) {
   UNITY_BEGIN();
 
@@ -506,17 +797,38 @@ int main(void) {
   RUN_TEST(test_query_success_literal_different_order);
   RUN_TEST(test_query_success_missing_where);
   RUN_TEST(test_query_success_duplicate_in);
+  RUN_TEST(test_query_fields_success);
+  RUN_TEST(test_query_fields_fails_on_bad_list);
+
+  // --- CREATE VIEW Command Tests ---
+  RUN_TEST(test_create_view_success);
+  RUN_TEST(test_create_view_fails_without_name);
+  RUN_TEST(test_where_view_tag);
+  RUN_TEST(test_subscribe_success);
+  RUN_TEST(test_show_success);
+  RUN_TEST(test_show_fails_without_target);
+  RUN_TEST(test_explain_and_profile_prefix_query);
+  RUN_TEST(test_top_key_lead_tag);
+  RUN_TEST(test_histogram_command);
+  RUN_TEST(test_funnel_step_list);
+  RUN_TEST(test_entities_set_expression);
+  RUN_TEST(test_rollup_commands);
 
   // --- Expression Parsing & Comparison Tests ---
   RUN_TEST(test_where_precedence);
   RUN_TEST(test_where_parentheses_override);
   RUN_TEST(test_where_not_operator);
   RUN_TEST(test_where_single_tag);
+  RUN_TEST(test_where_entity_tag);
+  RUN_TEST(test_where_entity_without_value_fails);
   RUN_TEST(test_where_quotes);
 
   // Comparison Tests
   RUN_TEST(test_where_comparison);
   RUN_TEST(test_where_comparison2);
+  RUN_TEST(test_where_comparison_decimal_and_string);
+  RUN_TEST(test_where_contains);
+  RUN_TEST(test_event_decimal_tag_value);
   RUN_TEST(test_where_comparison_tag);
   RUN_TEST(test_where_comparison_tag2);
 
@@ -285,7 +285,7 @@ void test_tokenize_quoted_strings(void) {
 // Test mix of all token types in one input
 void test_tokenize_all_token_types(void) {
   char input[] = "event in id ( ) : \"str\" 42 and or not query >= > <= < = "
-                 "!= identifier";
+                 "!= ~ identifier";
   queue_t *tokens = tok_tokenize(input);
   TEST_ASSERT_NOT_NULL(tokens);
   assert_next_token(tokens, TOKEN_CMD_EVENT, NULL, 0);
@@ -306,6 +306,7 @@ void test_tokenize_all_token_types(void) {
   assert_next_token(tokens, TOKEN_OP_LT, NULL, 0);
   assert_next_token(tokens, TOKEN_OP_EQ, NULL, 0);
   assert_next_token(tokens, TOKEN_OP_NEQ, NULL, 0);
+  assert_next_token(tokens, TOKEN_OP_CONTAINS, NULL, 0);
   assert_next_token(tokens, TOKEN_IDENTIFER, "identifier", 0);
   tok_clear_all(tokens);
   queue_destroy(tokens);
@@ -352,6 +353,52 @@ void test_tokenize_new_keywords(void) {
 
 // Test mixed case for new keywords (tokenizer should normalize to lowercase for
 // keywords)
+void test_tokenize_fields_list(void) {
+  char input[] = "FIELDS:(a, \"b c\")";
+  queue_t *tokens = tok_tokenize(input);
+
+  TEST_ASSERT_NOT_NULL(tokens);
+
+  assert_next_token(tokens, TOKEN_KW_FIELDS, NULL, 0);
+  assert_next_token(tokens, TOKEN_SYM_COLON, NULL, 0);
+  assert_next_token(tokens, TOKEN_SYM_LPAREN, NULL, 0);
+  assert_next_token(tokens, TOKEN_IDENTIFER, "a", 0);
+  assert_next_token(tokens, TOKEN_SYM_COMMA, NULL, 0);
+  assert_next_token(tokens, TOKEN_LITERAL_STRING, "b c", 0);
+  assert_next_token(tokens, TOKEN_SYM_RPAREN, NULL, 0);
+
+  tok_clear_all(tokens);
+  queue_destroy(tokens);
+}
+
+void test_tokenize_sample(void) {
+  char input[] = "sample:5";
+  queue_t *tokens = tok_tokenize(input);
+
+  TEST_ASSERT_NOT_NULL(tokens);
+
+  assert_next_token(tokens, TOKEN_KW_SAMPLE, NULL, 0);
+  assert_next_token(tokens, TOKEN_SYM_COLON, NULL, 0);
+  assert_next_token(tokens, TOKEN_LITERAL_NUMBER, NULL, 5);
+
+  tok_clear_all(tokens);
+  queue_destroy(tokens);
+}
+
+void test_tokenize_timeout(void) {
+  char input[] = "TIMEOUT:250";
+  queue_t *tokens = tok_tokenize(input);
+
+  TEST_ASSERT_NOT_NULL(tokens);
+
+  assert_next_token(tokens, TOKEN_KW_TIMEOUT, NULL, 0);
+  assert_next_token(tokens, TOKEN_SYM_COLON, NULL, 0);
+  assert_next_token(tokens, TOKEN_LITERAL_NUMBER, NULL, 250);
+
+  tok_clear_all(tokens);
+  queue_destroy(tokens);
+}
+
 void test_tokenize_new_keywords_mixed_case(void) {
   char input[] = "Entity TAKE CurSor WHERE BY HaViNg COUNT";
   queue_t *tokens = tok_tokenize(input);
@@ -396,6 +443,32 @@ void test_tokenize_int64_overflow(void) {
   TEST_ASSERT_NULL(tokens);
 }
 
+void test_tokenize_decimal_numbers(void) {
+  char input[] = "99.99 0.5 1.2.3 .5 7.";
+  queue_t *tokens = tok_tokenize(input);
+  TEST_ASSERT_NOT_NULL(tokens);
+
+  token_t *t = queue_dequeue(tokens);
+  TEST_ASSERT_EQUAL(TOKEN_LITERAL_FLOAT, t->type);
+  // The source text is kept so tag keys stay as written
+  TEST_ASSERT_EQUAL_STRING("99.99", t->text_value);
+  TEST_ASSERT_TRUE(t->float_value == 99.99);
+  tok_free(t);
+
+  t = queue_dequeue(tokens);
+  TEST_ASSERT_EQUAL(TOKEN_LITERAL_FLOAT, t->type);
+  TEST_ASSERT_TRUE(t->float_value == 0.5);
+  tok_free(t);
+
+  // Anything else with a dot stays an identifier
+  assert_next_token(tokens, TOKEN_IDENTIFER, "1.2.3", 0);
+  assert_next_token(tokens, TOKEN_IDENTIFER, ".5", 0);
+  assert_next_token(tokens, TOKEN_IDENTIFER, "7.", 0);
+
+  tok_clear_all(tokens);
+  queue_destroy(tokens);
+}
+
 // Main function to run the tests
 int main(void) {
   UNITY_BEGIN();
@@ -419,8 +492,12 @@ int main(void) {
   RUN_TEST(test_tokenize_whitespace_only);
   RUN_TEST(test_tokenize_new_keywords);
   RUN_TEST(test_tokenize_new_keywords_mixed_case);
+  RUN_TEST(test_tokenize_fields_list);
+  RUN_TEST(test_tokenize_timeout);
+  RUN_TEST(test_tokenize_sample);
   RUN_TEST(test_tokenize_large_int64_values);
   RUN_TEST(test_tokenize_int64_overflow);
+  RUN_TEST(test_tokenize_decimal_numbers);
 
   return UNITY_END();
 }
\ No newline at end of file